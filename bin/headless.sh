@@ -0,0 +1,31 @@
+#!/bin/sh
+
+#
+# USAGE
+#
+#   headless [app] [options for lnx_eden_headless]
+#
+#   e.g. headless lit -frames 1200 -warmup 60 -budget 16.6
+#
+#   Builds code/app_[app].cpp and the headless host into build/ and 
+#   runs it there, so the app's assets have to be packed into build/ first. 
+#   Exits with whatever the host exits with (2 is over budget).
+#
+
+me=$(dirname $0)
+root_dir=$me/..
+code_dir=$root_dir/code
+build_dir=$root_dir/build
+app=$1
+
+shift
+
+compiler_flags="-std=c++17 -O2 -march=native -g -DEDEN_DEBUG=1 -Wall -Wno-unused-function -Wno-parentheses -Wno-macro-redefined -Wno-deprecated-declarations -Wno-missing-braces"
+
+mkdir -p $build_dir
+
+clang++ $compiler_flags -fPIC -shared $code_dir/app_$app.cpp -o $build_dir/eden_$app.so || exit 1
+clang++ $compiler_flags $code_dir/lnx_eden_headless.cpp -o $build_dir/lnx_eden_headless -ldl -lpthread || exit 1
+
+cd $build_dir
+./lnx_eden_headless -app ./eden_$app.so -csv headless_$app.csv "$@"
@@ -36,12 +36,15 @@ eden_get_config_sig(eden_get_config)
   ret.profiler_enabled = true;
   ret.profiler_max_entries = 8;
   ret.profiler_max_snapshots_per_entry = 120;
+  ret.profiler_max_threads = 32;
+  ret.profiler_max_events_per_thread = 1 << 14;
 
   ret.texture_queue_size = megabytes(5);
   ret.render_command_size = megabytes(100);
   ret.max_textures = 1;
   ret.max_texture_payloads = 1;
   ret.max_elements = 4096;
+  ret.gfx_frames_in_flight = 2;
 
   ret.speaker_enabled = false;
 
@@ -51,6 +51,7 @@
 #define LIT_LIGHT_EMITTER_ANIME_SPEED 2.f
 #define LIT_LIGHT_EMITTER_COLOR rgba_set(1.f, 1.f, 1.f, 0.75f) 
 #define LIT_LIGHT_EMITTER_GLOW_COLOR rgba_set(1.f, 1.f, 1.f, 0.5f) 
+#define LIT_LIGHT_RANGE_ANGLE_MARGIN 0.01f // must cover the offset rays in lit_gen_light_intersections()
 
 // Player
 #define LIT_PLAYER_RADIUS 16.f
@@ -125,6 +126,10 @@ struct lit_game_edge_t {
   //b32_t is_disabled;
   v2f_t start_pt;
   v2f_t end_pt;
+
+  // @note: Set whenever the edge moves. Cleared once the lights
+  // that it could affect are marked dirty.
+  b32_t is_dirty;
 };
 
 struct lit_game_double_edge_t {
@@ -161,6 +166,10 @@ struct lit_game_light_t {
 
   u32_t intersection_count;
   lit_light_intersection_t intersections[512];
+
+  // @note: Set whenever the light or an edge in its range moves.
+  // Lights that are not dirty keep last frame's triangles.
+  b32_t is_dirty;
 };
 
 
@@ -270,6 +279,11 @@ struct lit_game_animator_patrol_point_t {
 
 struct lit_game_animator_t {
   lit_game_animator_type_t type;
+
+  // @note: Set to true whenever 'point' moves, if it belongs to 
+  // something that cares (e.g. an edge). Can be null.
+  b32_t* dirty_flag;
+
   union {
     lit_game_animator_rotate_point_t rotate_point;
     lit_game_animator_patrol_point_t move_point;
@@ -289,8 +303,12 @@ struct lit_game_t {
   u32_t edge_count;
   lit_game_edge_t edges[256];
 
+  // @note: These mirror 'edges' for raycasting; memory is from the mode arena.
+  seg2_soa_t edge_segs;
+
   u32_t light_count;
   lit_game_light_t lights[32];
+  u32_t regenerated_light_count; // for the inspector
 
   u32_t sensor_count;
   lit_game_sensor_t sensors[128];
@@ -757,11 +775,12 @@ lit_game_animator_push_patrol_point_waypoint(
 }
 
 static lit_game_animator_t*
-lit_game_animator_begin_patrol_point(lit_game_t* m, f32_t duration_per_waypoint, v2f_t* point) 
+lit_game_animator_begin_patrol_point(lit_game_t* m, f32_t duration_per_waypoint, v2f_t* point, b32_t* dirty_flag = nullptr) 
 {
   assert(m->animator_count < array_count(m->animators));
   auto* anim = m->animators + m->animator_count++;
   anim->type = LIT_ANIMATOR_TYPE_PATROL_POINT;
+  anim->dirty_flag = dirty_flag;
 
   auto* a = &anim->move_point;
   a->timer = 0.f;
@@ -792,11 +811,13 @@ lit_game_animator_push_rotate_point(
     lit_game_t* m,
     v2f_t* pt_to_rotate,
     v2f_t* pt_of_rotation,
-    f32_t speed) 
+    f32_t speed,
+    b32_t* dirty_flag = nullptr) 
 {
   assert(m->animator_count < array_count(m->animators));
   auto* anim = m->animators + m->animator_count++;
   anim->type = LIT_ANIMATOR_TYPE_ROTATE_POINT;
+  anim->dirty_flag = dirty_flag;
 
   auto* a = &anim->rotate_point;
   a->speed = speed;
@@ -809,6 +830,8 @@ lit_game_animator_push_rotate_point(
 
 static void 
 lit_game_animate(lit_game_animator_t* animator, f32_t dt) {
+  v2f_t* point = nullptr;
+  v2f_t old_point = {};
   switch(animator->type) {
     case LIT_ANIMATOR_TYPE_PATROL_POINT:{
       auto* a = &animator->move_point;
@@ -822,15 +845,25 @@ lit_game_animate(lit_game_animator_t* animator, f32_t dt) {
       }
 
       f32_t alpha = f32_ease_inout_sine(a->timer/a->duration);
+      point = a->point;
+      old_point = *point;
       *a->point = v2f_lerp(a->start, a->end, alpha);
     } break;
     case LIT_ANIMATOR_TYPE_ROTATE_POINT: {
       auto* a = &animator->rotate_point;
       a->delta = v2f_rotate(a->delta, a->speed * dt);
+      point = a->point;
+      old_point = *point;
       dref(a->point) = dref(a->point_of_rotation) + a->delta;
     } break;
 
   }
+
+  if (animator->dirty_flag && point && 
+      (point->x != old_point.x || point->y != old_point.y)) 
+  {
+    dref(animator->dirty_flag) = true;
+  }
 }
 
 static void
@@ -866,6 +899,7 @@ lit_game_push_edge(lit_game_t* m, f32_t min_x, f32_t min_y, f32_t max_x, f32_t m
   lit_game_calc_ghost_edge_line(edge, &p0, &p1);
   edge->start_pt = p0;
   edge->end_pt = p1;
+  edge->is_dirty = true;
 
   return edge;
 }
@@ -914,13 +948,13 @@ lit_game_push_rotating_double_edge(
   auto edges = lit_game_push_double_edge(g, min_x, min_y, max_x, max_y);
 
   if (pt_of_rotation_for_min) {
-    lit_game_animator_push_rotate_point(g, &edges.e1->start_pt, pt_of_rotation_for_min, speed_for_min);
-    lit_game_animator_push_rotate_point(g, &edges.e2->end_pt, pt_of_rotation_for_min, speed_for_min);
+    lit_game_animator_push_rotate_point(g, &edges.e1->start_pt, pt_of_rotation_for_min, speed_for_min, &edges.e1->is_dirty);
+    lit_game_animator_push_rotate_point(g, &edges.e2->end_pt, pt_of_rotation_for_min, speed_for_min, &edges.e2->is_dirty);
   }
 
   if (pt_of_rotation_for_max) {
-    lit_game_animator_push_rotate_point(g, &edges.e1->end_pt, pt_of_rotation_for_max, speed_for_max);
-    lit_game_animator_push_rotate_point(g, &edges.e2->start_pt, pt_of_rotation_for_max, speed_for_max);
+    lit_game_animator_push_rotate_point(g, &edges.e1->end_pt, pt_of_rotation_for_max, speed_for_max, &edges.e1->is_dirty);
+    lit_game_animator_push_rotate_point(g, &edges.e2->start_pt, pt_of_rotation_for_max, speed_for_max, &edges.e2->is_dirty);
   }
 }
 
@@ -938,13 +972,13 @@ lit_game_begin_patrolling_double_edge(lit_game_t* g, f32_t min_x, f32_t min_y, f
   //
   auto edges = lit_game_push_double_edge(g, min_x, min_y, max_x, max_y);
   g->selected_animator_for_double_edge_min[0] = 
-    lit_game_animator_begin_patrol_point(g, duration_per_waypoint, &edges.e1->start_pt);
+    lit_game_animator_begin_patrol_point(g, duration_per_waypoint, &edges.e1->start_pt, &edges.e1->is_dirty);
   g->selected_animator_for_double_edge_min[1] = 
-    lit_game_animator_begin_patrol_point(g, duration_per_waypoint, &edges.e2->end_pt);
+    lit_game_animator_begin_patrol_point(g, duration_per_waypoint, &edges.e2->end_pt, &edges.e2->is_dirty);
   g->selected_animator_for_double_edge_max[0] = 
-    lit_game_animator_begin_patrol_point(g, duration_per_waypoint, &edges.e1->end_pt);
+    lit_game_animator_begin_patrol_point(g, duration_per_waypoint, &edges.e1->end_pt, &edges.e1->is_dirty);
   g->selected_animator_for_double_edge_max[1] = 
-    lit_game_animator_begin_patrol_point(g, duration_per_waypoint, &edges.e2->start_pt);
+    lit_game_animator_begin_patrol_point(g, duration_per_waypoint, &edges.e2->start_pt, &edges.e2->is_dirty);
 }
 
 static void
@@ -1001,58 +1035,11 @@ lit_game_push_light(lit_game_t* m, f32_t pos_x, f32_t pos_y, u32_t color, f32_t
   light->dir.x = f32_cos(rad);
   light->dir.y = f32_sin(rad);
   light->half_angle = f32_deg_to_rad(angle/2.f);
+  light->is_dirty = true;
 
   return light;
 }
 
-// Returns F32_INFINITY() if cannot find
-static f32_t
-lit_game_get_ray_intersection_time_wrt_edges(
-    v2f_t ray_origin, 
-    v2f_t ray_dir,
-    lit_game_edge_t* edges,
-    u32_t edge_count,
-    b32_t clamp_to_ray_max = false)
-{
-  f32_t lowest_t1 = clamp_to_ray_max ? 1.f : F32_INFINITY;
-
-  for(u32_t edge_index = 0; edge_index < edge_count; ++edge_index)
-  {
-    lit_game_edge_t* edge = edges + edge_index;
-
-
-    //if (edge->is_disabled) continue;
-
-    v2f_t edge_ray_origin = edge->start_pt;
-    v2f_t edge_ray_dir = edge->end_pt - edge->start_pt;
-    
-    // Check for parallel
-    v2f_t ray_normal = {};
-    ray_normal.x = ray_dir.y;
-    ray_normal.y = -ray_dir.x;
-
-
-    if (!f32_is_close(v2f_dot(ray_normal, edge_ray_dir), 0.f)) {
-      f32_t t2 = 
-        (ray_dir.x*(edge_ray_origin.y - ray_origin.y) + 
-         ray_dir.y*(ray_origin.x - edge_ray_origin.x))/
-        (edge_ray_dir.x*ray_dir.y - edge_ray_dir.y*ray_dir.x);
-
-      f32_t t1 = (edge_ray_origin.x + edge_ray_dir.x * t2 - ray_origin.x)/ray_dir.x;
-
-      if (0.f < t1 && 
-          0.f < t2 && 
-          t2 < 1.f)
-      {
-
-        if (t1 < lowest_t1) {
-          lowest_t1 = t1;
-        }
-      }
-    }
-  }
-  return lowest_t1;
-}
 static void
 lit_game_push_triangle(lit_game_light_t* l, v2f_t p0, v2f_t p1, v2f_t p2, u32_t color) {
   assert(l->triangle_count < array_count(l->triangles));
@@ -1063,15 +1050,37 @@ lit_game_push_triangle(lit_game_light_t* l, v2f_t p0, v2f_t p1, v2f_t p2, u32_t
 }
 
 
+// Finds the intersection time of every ray, all of which start from ray_origin.
+// ray_ts holds each ray's max time going in (F32_INFINITY() if it's unbounded).
+static void
+lit_game_cast_rays(
+    v2f_t ray_origin, 
+    v2f_t* ray_dirs,
+    f32_t* ray_ts,
+    u32_t ray_count,
+    seg2_soa_t* edge_segs)
+{
+  assert(edge_segs);
+  bonk_rays2_segs2(ray_origin, ray_dirs, ray_ts, ray_count, edge_segs);
+}
+
 static void
 lit_gen_light_intersections(lit_game_light_t* l,
     lit_game_edge_t* edges,
     u32_t edge_count,
+    seg2_soa_t* edge_segs,
     arena_t* tmp_arena)
 {
   //moe_profile_block(light_generation);
   arena_set_revert_point(tmp_arena);
 
+  // @note: We gather all the rays first and cast them in one go,
+  // which lets lit_game_cast_rays() do them in packets. 
+  // ray_dirs[i] and ray_ts[i] belong to l->intersections[i].
+  v2f_t* ray_dirs = arena_push_arr(v2f_t, tmp_arena, array_count(l->intersections));
+  f32_t* ray_ts = arena_push_arr(f32_t, tmp_arena, array_count(l->intersections));
+  assert(ray_dirs && ray_ts);
+
   lit_game_light_type_t light_type = LIT_LIGHT_TYPE_POINT;
   if (l->half_angle < PI_32/2) {
     light_type = LIT_LIGHT_TYPE_DIRECTIONAL; 
@@ -1112,13 +1121,11 @@ lit_gen_light_intersections(lit_game_light_t* l,
       }
 
 
-      v2f_t light_ray_dir = v2f_rotate(ep - l->pos, offset_angle);
-
-      f32_t t = lit_game_get_ray_intersection_time_wrt_edges(l->pos, light_ray_dir, edges, edge_count, offset_index == 0);
-
       assert(l->intersection_count < array_count(l->intersections));
+      ray_dirs[l->intersection_count] = v2f_rotate(ep - l->pos, offset_angle);
+      ray_ts[l->intersection_count] = (offset_index == 0) ? 1.f : F32_INFINITY;
       lit_light_intersection_t* intersection = l->intersections + l->intersection_count++;
-      intersection->pt = (t == F32_INFINITY) ? ep : l->pos + t*light_ray_dir;
+      intersection->pt = ep; // for when the ray hits nothing
       intersection->is_shell = false;
     }
   }
@@ -1137,16 +1144,24 @@ lit_gen_light_intersections(lit_game_light_t* l,
       dirs[0] = v2f_rotate(l->dir, l->half_angle + offset_angle);
       dirs[1] = v2f_rotate(l->dir, -l->half_angle + offset_angle);
       for (u32_t i = 0; i < 2; ++i) {
-        f32_t t = lit_game_get_ray_intersection_time_wrt_edges(l->pos, dirs[i], edges, edge_count);
-
         assert(l->intersection_count < array_count(l->intersections));
+        ray_dirs[l->intersection_count] = dirs[i];
+        ray_ts[l->intersection_count] = F32_INFINITY;
         lit_light_intersection_t* intersection = l->intersections + l->intersection_count++;
-        intersection->pt = l->pos + t*dirs[i];
         intersection->is_shell = true;
       }
     }
   }
 
+  lit_game_cast_rays(l->pos, ray_dirs, ray_ts, l->intersection_count, edge_segs);
+  for (u32_t its_id = 0; its_id < l->intersection_count; ++its_id) {
+    lit_light_intersection_t* its = l->intersections + its_id;
+    f32_t t = ray_ts[its_id];
+    if (its->is_shell || t != F32_INFINITY) {
+      its->pt = l->pos + t*ray_dirs[its_id];
+    }
+  }
+
   if (l->intersection_count > 0) {
     sort_entry_t* sorted_its = arena_push_arr(sort_entry_t, tmp_arena, l->intersection_count);
     assert(sorted_its);
@@ -1224,20 +1239,71 @@ lit_gen_light_intersections(lit_game_light_t* l,
 }
 
 
+// @note: Each light only reads the edges and writes to itself,
+// so every light gets its own task with its own scratch arena.
+// The scratch has to fit everything lit_gen_light_intersections()
+// pushes for a light with every intersection used.
+#define LIT_LIGHT_SCRATCH_SIZE \
+  (array_count(((lit_game_light_t*)0)->intersections) * (sizeof(v2f_t) + sizeof(f32_t) + sizeof(sort_entry_t)) + 64)
+
+struct lit_gen_light_task_t {
+  lit_game_light_t* light;
+  lit_game_edge_t* edges;
+  u32_t edge_count;
+  seg2_soa_t* edge_segs;
+  arena_t scratch;
+};
+
 static void
+lit_gen_light_task(void* data) {
+  auto* task = (lit_gen_light_task_t*)data;
+  lit_profile_block(light_task);
+  lit_gen_light_intersections(task->light, task->edges, task->edge_count, task->edge_segs, &task->scratch);
+}
+
+// Generates all dirty lights in parallel if the platform gives us tasks.
+// All lights are done by the time this returns.
+//
+// Returns the number of lights that were regenerated.
+static u32_t
 lit_gen_lights(
     lit_game_light_t* lights, 
     u32_t light_count,
     lit_game_edge_t* edges,
     u32_t edge_count,
-    arena_t* tmp_arena)  {
-  // Update all lights
+    seg2_soa_t* edge_segs,
+    arena_t* tmp_arena)  
+{
+  arena_set_revert_point(tmp_arena);
+
+  u32_t task_count = 0;
+  auto* tasks = arena_push_arr(lit_gen_light_task_t, tmp_arena, light_count);
+  assert(tasks);
   for(u32_t light_index = 0; light_index < light_count; ++light_index)
   {
     lit_game_light_t* light = lights + light_index;
-    lit_gen_light_intersections(light, edges, edge_count, tmp_arena);
+    if (!light->is_dirty) continue;
+    light->is_dirty = false;
+
+    lit_gen_light_task_t* task = tasks + task_count++;
+    task->light = light;
+    task->edges = edges;
+    task->edge_count = edge_count;
+    task->edge_segs = edge_segs;
+    b32_t ok = arena_push_partition(tmp_arena, &task->scratch, LIT_LIGHT_SCRATCH_SIZE);
+    assert(ok);
+    (void)ok;
+
+    if (eden->add_task)
+      eden_add_task(lit_gen_light_task, task);
+    else 
+      lit_gen_light_task(task);
   }
 
+  if (task_count > 0 && eden->complete_all_tasks) 
+    eden_complete_all_tasks();
+
+  return task_count;
 }
 
 static void
@@ -1353,6 +1419,7 @@ static void
 lit_game_player_release_light(lit_game_t* g) {
   lit_game_player_t* player = &g->player;
   if (player->held_light) {
+    player->held_light->is_dirty = true;
     eden_speaker_play(ASSET_SOUND_PUTDOWN, false, 0.5f);
   }
 
@@ -1388,6 +1455,7 @@ lit_game_player_hold_nearest_light_if_empty_handed(
   if (player->light_hold_mode == LIT_PLAYER_LIGHT_HOLD_MODE_NONE) {
     if (player->nearest_light) {          
       player->held_light = player->nearest_light;
+      player->held_light->is_dirty = true;
       player->old_light_pos = player->nearest_light->pos;
       player->light_retrival_time = 0.f;
       player->light_hold_mode = light_hold_mode;
@@ -1466,15 +1534,21 @@ lit_game_update_player(lit_game_t* g, f32_t dt)
           player->light_retrival_time = LIT_PLAYER_LIGHT_RETRIEVE_DURATION;
         }
         f32_t ratio = player->light_retrival_time / LIT_PLAYER_LIGHT_RETRIEVE_DURATION; 
+        v2f_t old_pos = player->held_light->pos;
         player->held_light->pos.x = f32_lerp(player->old_light_pos.x, player->pos.x, ratio) ;
         player->held_light->pos.y = f32_lerp(player->old_light_pos.y, player->pos.y,  ratio) ;
+        if (old_pos.x != player->held_light->pos.x || old_pos.y != player->held_light->pos.y) 
+          player->held_light->is_dirty = true;
       }
     } break;
     case LIT_PLAYER_LIGHT_HOLD_MODE_ROTATE: {
       if (player->held_light != nullptr) {
         f32_t mouse_delta = player->pos.x - player->locked_pos_x;
-        player->held_light->dir = 
-          v2f_rotate(player->held_light->dir, LIT_PLAYER_ROTATE_SPEED * dt * mouse_delta );
+        if (mouse_delta != 0.f) {
+          player->held_light->dir = 
+            v2f_rotate(player->held_light->dir, LIT_PLAYER_ROTATE_SPEED * dt * mouse_delta );
+          player->held_light->is_dirty = true;
+        }
       }
     } break;
   }
@@ -1774,14 +1848,72 @@ lit_game_render_sensors(lit_game_t* g) {
   }
 }
 
+// Returns true if the segment could be hit by any of the light's rays.
+// @note: This is conservative; it only rules out segments that are
+// fully on the outside of one of the sides of a directional light's cone. 
+// The cone is widened a little to cover the offset rays.
+static b32_t
+lit_game_is_segment_in_light_range(lit_game_light_t* l, v2f_t p0, v2f_t p1) {
+  f32_t half_angle = l->half_angle + LIT_LIGHT_RANGE_ANGLE_MARGIN;
+  if (half_angle >= PI_32/2) 
+    return true;
+
+  v2f_t left = v2f_rotate(l->dir, half_angle);
+  v2f_t right = v2f_rotate(l->dir, -half_angle);
+  v2f_t d0 = p0 - l->pos;
+  v2f_t d1 = p1 - l->pos;
+  if (v2f_cross(right, d0) < 0.f && v2f_cross(right, d1) < 0.f) 
+    return false;
+  if (v2f_cross(left, d0) > 0.f && v2f_cross(left, d1) > 0.f) 
+    return false;
+  return true;
+}
+
+// @note: Edges are moved around by the animators through pointers,
+// which mark them dirty. Every light that could see a dirty edge, 
+// either where it was or where it is now, is marked dirty too. 
+// Then only the dirty edges are resynced.
+//
+static void
+lit_game_sync_edges(lit_game_t* g) {
+  seg2_soa_t* segs = &g->edge_segs;
+  segs->count = g->edge_count;
+  for(u32_t edge_index = 0; edge_index < g->edge_count; ++edge_index)
+  {
+    lit_game_edge_t* edge = g->edges + edge_index;
+    if (!edge->is_dirty) continue;
+    edge->is_dirty = false;
+
+    // The SoA still has where the edge was last frame
+    v2f_t old_start = v2f_set(segs->start_x[edge_index], segs->start_y[edge_index]);
+    v2f_t old_end = old_start + v2f_set(segs->delta_x[edge_index], segs->delta_y[edge_index]);
+    for(u32_t light_index = 0; light_index < g->light_count; ++light_index) 
+    {
+      lit_game_light_t* light = g->lights + light_index;
+      if (light->is_dirty) continue;
+      if (lit_game_is_segment_in_light_range(light, old_start, old_end) ||
+          lit_game_is_segment_in_light_range(light, edge->start_pt, edge->end_pt))
+      {
+        light->is_dirty = true;
+      }
+    }
+
+    seg2_soa_set(segs, edge_index, edge->start_pt, edge->end_pt);
+  }
+}
+
 static void
 lit_game_generate_light(lit_game_t* g) {
+  lit_game_sync_edges(g);
+  g->regenerated_light_count = 
+    lit_gen_lights(g->lights, g->light_count, g->edges, g->edge_count, &g->edge_segs, &lit->frame_arena);
+  eden_inspect_u32(regenerated_lights, g->regenerated_light_count);
+
+#if LIT_DEBUG_LINES
   for(u32_t light_index = 0; light_index < g->light_count; ++light_index)
   {
     lit_game_light_t* light = g->lights + light_index;
-    lit_gen_light_intersections(light, g->edges, g->edge_count, &lit->frame_arena);
 
-#if LIT_DEBUG_LINES
     // Generate debug lines
     for (u32_t intersection_index = 0;
         intersection_index < light->intersection_count;
@@ -1791,8 +1923,8 @@ lit_game_generate_light(lit_game_t* g) {
       v2f_t p1 = light->intersections[intersection_index].pt;
       eden_draw_line(p0, p1, 1.f, rgba_hex(0xFFFFFFFF));
     }
-#endif
   }
+#endif
 }
 
 //
@@ -3475,6 +3607,12 @@ lit_game_init()
   lit_game_t* g = &lit->eden;
   rng_init(&g->rng, 65535); // don't really need to be strict 
 
+  if (!seg2_soa_init(&g->edge_segs, array_count(g->edges), &lit->mode_arena)) 
+  {
+    eden->is_running = false;
+    return;
+  }
+
 #if LIT_DEBUG_FREEZE
   g->freeze = false;
 #endif
@@ -3757,6 +3895,7 @@ eden_update_and_render_sig(eden_update_and_render)
   if (lit->next_mode != lit->mode || eden_is_dll_reloaded()) 
   {
     lit->mode = lit->next_mode;
+    arena_clear(&lit->mode_arena);
     
     switch(lit->mode) {
       case LIT_MODE_SPLASH: {
@@ -3851,12 +3990,15 @@ eden_get_config_sig(eden_get_config)
   ret.profiler_enabled = true;
   ret.profiler_max_entries = 8;
   ret.profiler_max_snapshots_per_entry = 120;
+  ret.profiler_max_threads = 32;
+  ret.profiler_max_events_per_thread = 1 << 14;
 
   ret.texture_queue_size = megabytes(5);
   ret.max_commands = 2048;
   ret.max_textures = 1;
   ret.max_texture_payloads = 1;
   ret.max_elements = 4096;
+  ret.gfx_frames_in_flight = 2;
 
   ret.speaker_enabled = true;
   ret.speaker_samples_per_second = 48000;
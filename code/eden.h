@@ -9,6 +9,7 @@
 //
 // FLAGS
 //   EDEN_USE_OPENGL - Flag to enable opengl code used to run the eden
+//   EDEN_USE_NULL_GFX - Flag to enable the gfx backend that draws nothing (for headless hosts)
 //
 //
 
@@ -27,6 +28,10 @@
 # include "eden_gfx_opengl.h"
 #endif // EDEN_USE_OPENGL
 
+#if EDEN_USE_NULL_GFX
+# include "eden_gfx_null.h"
+#endif // EDEN_USE_NULL_GFX
+
 
 #include "eden_console.h"
 //
@@ -125,6 +130,10 @@ static void eden_globalize(eden_t* e) { eden = e; }
 #if EDEN_USE_OPENGL
 # include "eden_gfx_opengl.cpp"
 #endif // EDEN_USE_OPENGL
+
+#if EDEN_USE_NULL_GFX
+# include "eden_gfx_null.cpp"
+#endif // EDEN_USE_NULL_GFX
        
 #include "eden_input.cpp"
 #include "eden_assets.cpp"
@@ -149,6 +158,10 @@ struct eden_config_t
   b32_t profiler_enabled;
   u32_t profiler_max_entries;
   u32_t profiler_max_snapshots_per_entry;
+  // @note: for the trace; 0 turns it off. Every thread that profiles
+  // takes one, and the host and the app count separately.
+  u32_t profiler_max_threads;
+  u32_t profiler_max_events_per_thread;
 
   usz_t texture_queue_size;
   u32_t max_textures;
@@ -156,6 +169,11 @@ struct eden_config_t
   usz_t max_texture_payloads; 
   usz_t max_elements;
 
+  // @note: how many frames the CPU can queue up before it has to 
+  // wait for the GPU. 2 is a good default. Higher values might give
+  // better throughput at the cost of latency.
+  u32_t gfx_frames_in_flight;
+
   b32_t speaker_enabled;
   u32_t speaker_samples_per_second;
   u16_t speaker_bits_per_sample;
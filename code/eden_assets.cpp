@@ -1,4 +1,6 @@
 
+static_assert(sizeof(eden_asset_font_glyph_t) == sizeof(asset_file_font_glyph_t), "glyph layouts must match");
+
 static b32_t
 eden_assets_init(
     u32_t bitmap_count,
@@ -9,6 +11,7 @@ eden_assets_init(
     arena_t* arena)
 {
   eden_assets_t* assets = &eden->assets;
+  assets->file_mapping = buf_bad();
 
   // Allocation for assets
   assets->bitmap_count = bitmap_count;
@@ -37,17 +40,290 @@ eden_assets_init(
   
   assets->shader_count = shader_count;
   if (assets->shader_count > 0) {
-    assets->shaders = arena_push_arr(eden_asset_shader_t, arena, assets->sound_count);
-    if (!assets->sounds) return false;
+    assets->shaders = arena_push_arr(eden_asset_shader_t, arena, assets->shader_count);
+    if (!assets->shaders) return false;
   }
   return true;
 }
 
+// 
+// Returns nullptr if [offset, offset + size) is not inside the mapping
+//
+static u8_t*
+_eden_assets_get_from_file_mapping(buf_t mapping, umi_t offset, umi_t size) 
+{
+  if (offset > mapping.size || size > mapping.size - offset) 
+    return nullptr;
+  return mapping.e + offset;
+}
+
+//
+// @mark: Loading tasks
+//
+// Sounds, bitmaps and fonts are loaded by tasks on eden's task queue.
+// Anything that is not thread-safe (pushing onto the arena and the 
+// texture queue) is done on the main thread before the tasks are 
+// added; each task gets its own arena partition and, for bitmaps, 
+// a texture payload that is already reserved.
+//
+// If the file is mapped, tasks read from the mapping. Otherwise,
+// each task opens its own handle to the file so that reads don't 
+// get serialized on a single handle.
+//
+
+struct _eden_assets_task_t {
+  const char* filename;
+  buf_t file_mapping;
+  arena_t arena;
+
+  u32_t asset_index;
+  union {
+    asset_file_sound_t* file_sound;
+    asset_file_bitmap_t* file_bitmap;
+    asset_file_font_t* file_font;
+  };
+  eden_gfx_texture_payload_t* payload;
+
+  b32_t ok;
+  u64_t bytes;
+  u64_t start_time;
+  u64_t end_time;
+};
+
+static b32_t
+_eden_assets_task_read(
+    _eden_assets_task_t* task, 
+    file_t* file, 
+    void* dest, 
+    usz_t size, 
+    usz_t offset)
+{
+  if (buf_valid(task->file_mapping)) 
+  {
+    u8_t* src = _eden_assets_get_from_file_mapping(task->file_mapping, offset, size);
+    if (!src) return false;
+    memory_copy(dest, src, size);
+    return true;
+  }
+  return file_read(file, dest, size, offset);
+}
+
+static void 
+_eden_assets_load_sound_task(void* data)
+{
+  auto* task = (_eden_assets_task_t*)data;
+  task->start_time = clock_time();
+  defer { task->end_time = clock_time(); };
+
+  asset_file_sound_t* file_sound = task->file_sound;
+  eden_asset_sound_t* s = eden->assets.sounds + task->asset_index;
+  s->data_size = file_sound->data_size;
+  task->bytes = s->data_size;
+
+  if (buf_valid(task->file_mapping)) 
+  {
+    s->data = _eden_assets_get_from_file_mapping(task->file_mapping, file_sound->offset_to_data, s->data_size);
+    task->ok = (s->data != nullptr);
+    return;
+  }
+
+  s->data = arena_push_arr(u8_t, &task->arena, s->data_size);
+  if (!s->data) 
+    return;
+
+  file_t file;
+  if (!file_open(&file, task->filename, FILE_ACCESS_READ)) 
+    return;
+  defer { file_close(&file); };
+
+  task->ok = file_read(&file, s->data, s->data_size, file_sound->offset_to_data);
+}
+
+static void 
+_eden_assets_load_bitmap_task(void* data)
+{
+  auto* task = (_eden_assets_task_t*)data;
+  task->start_time = clock_time();
+  defer { task->end_time = clock_time(); };
+
+  asset_file_bitmap_t* file_bitmap = task->file_bitmap;
+  u32_t bitmap_size = file_bitmap->width * file_bitmap->height * 4;
+  task->bytes = bitmap_size;
+
+  file_t file = {};
+  if (!buf_valid(task->file_mapping))
+  {
+    if (!file_open(&file, task->filename, FILE_ACCESS_READ)) 
+      return;
+  }
+  defer { file_close(&file); };
+
+  task->ok = _eden_assets_task_read(
+      task, 
+      &file, 
+      task->payload->texture_data, 
+      bitmap_size, 
+      file_bitmap->offset_to_data);
+}
+
+static void 
+_eden_assets_load_font_task(void* data)
+{
+  auto* task = (_eden_assets_task_t*)data;
+  task->start_time = clock_time();
+  defer { task->end_time = clock_time(); };
+
+  asset_file_font_t* file_font = task->file_font;
+  eden_asset_font_t* f = eden->assets.fonts + task->asset_index;
+
+  u32_t glyph_count = file_font->glyph_count;
+  u32_t highest_codepoint = file_font->highest_codepoint;
+  usz_t glyphs_size = sizeof(eden_asset_font_glyph_t)*glyph_count;
+  usz_t kernings_size = sizeof(f32_t)*glyph_count*glyph_count;
+  usz_t offset_to_kernings = file_font->offset_to_data + glyphs_size;
+  task->bytes = glyphs_size + kernings_size;
+
+  eden_asset_font_glyph_t* glyphs = nullptr;
+  f32_t* kernings = nullptr;
+
+  if (buf_valid(task->file_mapping)) 
+  {
+    glyphs = (eden_asset_font_glyph_t*)
+      _eden_assets_get_from_file_mapping(task->file_mapping, file_font->offset_to_data, glyphs_size);
+    kernings = (f32_t*)
+      _eden_assets_get_from_file_mapping(task->file_mapping, offset_to_kernings, kernings_size);
+    if (!glyphs || !kernings) 
+      return;
+  }
+  else 
+  {
+    glyphs = arena_push_arr(eden_asset_font_glyph_t, &task->arena, glyph_count);
+    kernings = arena_push_arr(f32_t, &task->arena, glyph_count*glyph_count);
+    if (!glyphs || !kernings) 
+      return;
+
+    file_t file;
+    if (!file_open(&file, task->filename, FILE_ACCESS_READ)) 
+      return;
+    defer { file_close(&file); };
+
+    // @note: The glyph layouts are the same so we can read them all in one go
+    if (!file_read(&file, glyphs, glyphs_size, file_font->offset_to_data)) 
+      return;
+    if (!file_read(&file, kernings, kernings_size, offset_to_kernings)) 
+      return;
+  }
+
+  u16_t* codepoint_map = arena_push_arr(u16_t, &task->arena, highest_codepoint + 1);
+  if(!codepoint_map) 
+    return;
+
+  for(u16_t glyph_index = 0; 
+      glyph_index < glyph_count;
+      ++glyph_index)
+  {
+    u32_t codepoint = glyphs[glyph_index].codepoint;
+    if (codepoint > highest_codepoint) 
+      return;
+    codepoint_map[codepoint] = glyph_index;
+  }
+
+  f->bitmap_asset_id = (eden_asset_bitmap_id_t)file_font->bitmap_asset_id;
+  f->line_gap = file_font->line_gap;
+  f->ascent = file_font->ascent;
+  f->descent = file_font->descent;
+  f->glyphs = glyphs;
+  f->codepoint_map = codepoint_map;
+  f->kernings = kernings;
+  f->highest_codepoint = highest_codepoint;
+  f->glyph_count = glyph_count;
+
+  task->ok = true;
+}
+
+//
+// Runs the task inline if the platform did not give us a task queue.
+//
+static void
+_eden_assets_add_task(eden_task_callback_f* callback, _eden_assets_task_t* task)
+{
+  if (!eden->add_task) 
+  {
+    callback(task);
+    return;
+  }
+
+  eden_add_task(callback, task);
+}
+
+static b32_t
+_eden_assets_gather_section_stats(
+    eden_assets_section_stats_t* stats,
+    _eden_assets_task_t* tasks, 
+    u32_t task_count)
+{
+  b32_t ok = true;
+  u64_t first_start = U64_MAX;
+  u64_t last_end = 0;
+  u64_t busy = 0;
+
+  stats->count = task_count;
+  stats->bytes = 0;
+  for (u32_t task_index = 0; task_index < task_count; ++task_index)
+  {
+    _eden_assets_task_t* task = tasks + task_index;
+    ok &= task->ok;
+    stats->bytes += task->bytes;
+    busy += task->end_time - task->start_time;
+    first_start = min_of(first_start, task->start_time);
+    last_end = max_of(last_end, task->end_time);
+  }
+  stats->busy_secs = (f32_t)busy / clock_resolution();
+  stats->wall_secs = task_count ? (f32_t)(last_end - first_start) / clock_resolution() : 0.f;
+
+  return ok;
+}
+
+// 
+// Reads a table of file structs, either by pointing into 
+// the mapping or by reading it into the arena.
+//
+static void*
+_eden_assets_read_table(
+    file_t* file, 
+    buf_t mapping, 
+    umi_t offset, 
+    usz_t size, 
+    arena_t* arena)
+{
+  if (buf_valid(mapping)) 
+    return _eden_assets_get_from_file_mapping(mapping, offset, size);
+
+  void* ret = arena_push_size(arena, size, 16);
+  if (!ret) return nullptr;
+  if (!file_read(file, ret, size, offset)) return nullptr;
+  return ret;
+}
+
+//
+// If 'map_file' is true, the whole file is memory-mapped once and 
+// sounds, shaders, glyphs and kernings will point straight into the 
+// mapping instead of being read into 'arena'. Bitmaps still have to 
+// be copied into the texture queue. The mapping lives until 
+// eden_assets_unmap_file() is called.
+//
+// Sounds, bitmaps and fonts are loaded in parallel with eden's tasks
+// API. The time taken for each section can be found in 
+// eden_assets_t::load_stats after this returns.
+//
 static b32_t 
 eden_assets_init_from_file(
     const char* filename, 
-    arena_t* arena) 
+    arena_t* arena,
+    b32_t map_file = false) 
 {
+  u64_t start_time = clock_time();
+
   eden_assets_t* assets = &eden->assets;
   file_t file;
   if(!file_open(
@@ -59,211 +335,276 @@ eden_assets_init_from_file(
   }
   defer { file_close(&file); };
 
+  buf_t mapping = buf_bad();
+  if (map_file) 
+  {
+    mapping = file_map(&file);
+    if (!buf_valid(mapping)) 
+      return false;
+  }
+  b32_t ok = false;
+  defer { 
+    if (!ok && buf_valid(mapping)) 
+      file_unmap(mapping); 
+  };
 
   // Read header
-  asset_file_header_t asset_file_header = {};
-  file_read(&file, &asset_file_header, sizeof(asset_file_header_t), 0);
-  if (asset_file_header.signature != ASSET_FILE_SIGNATURE) 
+  auto* header = (asset_file_header_t*)
+    _eden_assets_read_table(&file, mapping, 0, sizeof(asset_file_header_t), arena);
+  if (!header || header->signature != ASSET_FILE_SIGNATURE) 
   {
     return false;
   }
 
   if(!eden_assets_init(
-        asset_file_header.bitmap_count, 
-        asset_file_header.sprite_count,
-        asset_file_header.font_count,
-        asset_file_header.sound_count,
-        asset_file_header.shader_count,
+        header->bitmap_count, 
+        header->sprite_count,
+        header->font_count,
+        header->sound_count,
+        header->shader_count,
         arena)) 
   {
     return false;
   }
 
-
   // 
-  // Read sounds
+  // Shaders and sprites are small so we just do them here.
   //
-  for(u32_t sound_index = 0;
-      sound_index < assets->sound_count;
-      ++sound_index)
+  if (assets->shader_count > 0) 
   {
-    umi_t offset_to_sound = asset_file_header.offset_to_sounds + sizeof(asset_file_sound_t) * sound_index; 
-    asset_file_sound_t file_sound = {};
-    if (!file_read(&file, &file_sound, sizeof(asset_file_sound_t), offset_to_sound)) 
+    auto* file_shaders = (asset_file_shader_t*)
+      _eden_assets_read_table(&file, mapping, header->offset_to_shaders, sizeof(asset_file_shader_t) * assets->shader_count, arena);
+    if (!file_shaders) 
       return false;
 
-    eden_asset_sound_t* s = assets->sounds + sound_index;
-    s->data_size = file_sound.data_size;
-    s->data = arena_push_arr(u8_t, arena, s->data_size);
-    if (!s->data) 
-      return false;
-
-    if (!file_read(&file, s->data, s->data_size, file_sound.offset_to_data))
-      return false;
+    for(u32_t shader_index = 0;
+        shader_index < assets->shader_count;
+        ++shader_index)
+    {
+      asset_file_shader_t* file_shader = file_shaders + shader_index;
+      eden_asset_shader_t* s = assets->shaders + shader_index;
+      if (buf_valid(mapping)) 
+      {
+        u8_t* code = _eden_assets_get_from_file_mapping(mapping, file_shader->offset_to_data, file_shader->length);
+        if (!code) 
+          return false;
+        s->code = buf_set(code, file_shader->length);
+      }
+      else 
+      {
+        s->code = arena_push_buffer(arena, file_shader->length, 16);
+        if (!buf_valid(s->code)) 
+          return false;
+        if (!file_read(&file, s->code.e, s->code.size, file_shader->offset_to_data))
+          return false;
+      }
+    }
   }
 
-  // 
-  // Read shaders
-  //
-  for(u32_t shader_index = 0;
-      shader_index < assets->shader_count;
-      ++shader_index)
+  if (assets->sprite_count > 0) 
   {
-    umi_t offset_to_shader = asset_file_header.offset_to_shaders + sizeof(asset_file_shader_t) * shader_index; 
-    asset_file_shader_t file_shader = {};
-    if (!file_read(&file, &file_shader, sizeof(asset_file_shader_t), offset_to_shader)) 
+    auto* file_sprites = (asset_file_sprite_t*)
+      _eden_assets_read_table(&file, mapping, header->offset_to_sprites, sizeof(asset_file_sprite_t) * assets->sprite_count, arena);
+    if (!file_sprites) 
       return false;
 
-    eden_asset_shader_t* s = assets->shaders + shader_index;
-    s->code = arena_push_buffer(arena, file_shader.length, 16);
-    if (!buf_valid(s->code)) 
-      return false;
-
-    if (!file_read(&file, s->code.e, s->code.size, file_shader.offset_to_data))
-      return false;
+    for(u32_t sprite_index = 0;
+        sprite_index < assets->sprite_count;
+        ++sprite_index)
+    {
+      asset_file_sprite_t* file_sprite = file_sprites + sprite_index;
+      eden_asset_sprite_t* s = assets->sprites + sprite_index;
+
+      s->bitmap_asset_id = (eden_asset_bitmap_id_t)file_sprite->bitmap_asset_id;
+      s->texel_x0 = file_sprite->texel_x0;
+      s->texel_y0 = file_sprite->texel_y0;
+      s->texel_x1 = file_sprite->texel_x1;
+      s->texel_y1 = file_sprite->texel_y1;
+    }
   }
-  // 
-  // Read sprites
+
+  //
+  // Prepare the tasks for sounds, bitmaps and fonts
   //
-  for(u32_t sprite_index = 0;
-      sprite_index < assets->sprite_count;
-      ++sprite_index)
+  u32_t task_count = assets->sound_count + assets->bitmap_count + assets->font_count;
+  _eden_assets_task_t* tasks = nullptr;
+  if (task_count > 0) 
   {
-    umi_t offset_to_sprite = asset_file_header.offset_to_sprites + sizeof(asset_file_sprite_t) * sprite_index; 
-    asset_file_sprite_t file_sprite = {};
-    if (!file_read(&file, &file_sprite, sizeof(asset_file_sprite_t), offset_to_sprite))
+    tasks = arena_push_arr_zero(_eden_assets_task_t, arena, task_count);
+    if (!tasks) 
       return false;
-    eden_asset_sprite_t* s = assets->sprites + sprite_index;
+  }
+  _eden_assets_task_t* sound_tasks = tasks;
+  _eden_assets_task_t* bitmap_tasks = sound_tasks + assets->sound_count;
+  _eden_assets_task_t* font_tasks = bitmap_tasks + assets->bitmap_count;
 
-    s->bitmap_asset_id = (eden_asset_bitmap_id_t)file_sprite.bitmap_asset_id;
-    s->texel_x0 = file_sprite.texel_x0;
-    s->texel_y0 = file_sprite.texel_y0;
-    s->texel_x1 = file_sprite.texel_x1;
-    s->texel_y1 = file_sprite.texel_y1;
+  for (u32_t task_index = 0; task_index < task_count; ++task_index) 
+  {
+    tasks[task_index].filename = filename;
+    tasks[task_index].file_mapping = mapping;
   }
 
-  // 
-  // Read bitmaps
-  //
-  for(u32_t bitmap_index = 0;
-      bitmap_index < assets->bitmap_count;
-      ++bitmap_index)
+  if (assets->sound_count > 0) 
   {
-    umi_t offset_to_bitmap = asset_file_header.offset_to_bitmaps + sizeof(asset_file_bitmap_t) * bitmap_index; 
-    asset_file_bitmap_t file_bitmap = {};
-    if (!file_read(&file, &file_bitmap, sizeof(asset_file_bitmap_t), offset_to_bitmap)) {
+    auto* file_sounds = (asset_file_sound_t*)
+      _eden_assets_read_table(&file, mapping, header->offset_to_sounds, sizeof(asset_file_sound_t) * assets->sound_count, arena);
+    if (!file_sounds) 
       return false;
-    }
 
-    eden_asset_bitmap_t* b = assets->bitmaps + bitmap_index;
-    b->renderer_texture_handle = 0;
-    b->width = file_bitmap.width;
-    b->height = file_bitmap.height;
-
-    u32_t bitmap_size = b->width * b->height * 4;
-    eden_gfx_texture_payload_t* payload = eden_add_texture_begin(eden, bitmap_size);
-    if (!payload) return false;
-    payload->texture_index = b->renderer_texture_handle;
-    payload->texture_width = file_bitmap.width;
-    payload->texture_height = file_bitmap.height;
-    if (!file_read(
-        &file, 
-        payload->texture_data,
-        bitmap_size, 
-        file_bitmap.offset_to_data))
+    for(u32_t sound_index = 0;
+        sound_index < assets->sound_count;
+        ++sound_index)
     {
-      eden_add_texture_cancel(eden, payload);
-      return false;
-    }
+      _eden_assets_task_t* task = sound_tasks + sound_index;
+      task->asset_index = sound_index;
+      task->file_sound = file_sounds + sound_index;
 
-    b->renderer_texture_handle = eden_add_texture_end(eden, payload);
+      // Sound data goes straight into the partition
+      if (!buf_valid(mapping)) 
+      {
+        if (!arena_push_partition(arena, &task->arena, task->file_sound->data_size, 16))
+          return false;
+      }
+    }
   }
 
-  for(u32_t font_index = 0;
-      font_index < assets->font_count;
-      ++font_index)
+  if (assets->font_count > 0) 
   {
-    umi_t offset_to_fonts = asset_file_header.offset_to_fonts + sizeof(asset_file_font_t) * font_index; 
-    asset_file_font_t file_font = {};
-    if (!file_read(&file, &file_font, sizeof(asset_file_font_t), offset_to_fonts)) 
+    auto* file_fonts = (asset_file_font_t*)
+      _eden_assets_read_table(&file, mapping, header->offset_to_fonts, sizeof(asset_file_font_t) * assets->font_count, arena);
+    if (!file_fonts) 
       return false;
 
-    eden_asset_font_t* f = assets->fonts + font_index;
-
-    u32_t glyph_count = file_font.glyph_count;
-    u32_t highest_codepoint = file_font.highest_codepoint;
-
-    u16_t* codepoint_map = arena_push_arr(u16_t, arena, highest_codepoint);
-    if(!codepoint_map) return false;
-
-    eden_asset_font_glyph_t* glyphs = arena_push_arr(eden_asset_font_glyph_t, arena, glyph_count);
-    if(!glyphs) return false;
-
-    f32_t* kernings = arena_push_arr(f32_t, arena, glyph_count*glyph_count);
-    if (!kernings) return false;
-
-    f->bitmap_asset_id = (eden_asset_bitmap_id_t)file_font.bitmap_asset_id;
-    f->line_gap = file_font.line_gap;
-    f->ascent = file_font.ascent;
-    f->descent = file_font.descent;
+    for(u32_t font_index = 0;
+        font_index < assets->font_count;
+        ++font_index)
+    {
+      _eden_assets_task_t* task = font_tasks + font_index;
+      asset_file_font_t* file_font = file_fonts + font_index;
+      task->asset_index = font_index;
+      task->file_font = file_font;
+
+      // codepoint map + (glyphs + kernings if we are not mapped) + some room for alignment
+      usz_t partition_size = sizeof(u16_t) * (file_font->highest_codepoint + 1) + 64;
+      if (!buf_valid(mapping)) 
+      {
+        partition_size += sizeof(eden_asset_font_glyph_t) * file_font->glyph_count;
+        partition_size += sizeof(f32_t) * file_font->glyph_count * file_font->glyph_count;
+      }
+      if (!arena_push_partition(arena, &task->arena, partition_size, 16))
+        return false;
+    }
+  }
 
+  // @note: Payloads are reserved last so that we don't have to
+  // cancel them if anything before this fails.
+  if (assets->bitmap_count > 0) 
+  {
+    auto* file_bitmaps = (asset_file_bitmap_t*)
+      _eden_assets_read_table(&file, mapping, header->offset_to_bitmaps, sizeof(asset_file_bitmap_t) * assets->bitmap_count, arena);
+    if (!file_bitmaps) 
+      return false;
 
-    for(u16_t glyph_index = 0; 
-        glyph_index < glyph_count;
-        ++glyph_index)
+    for(u32_t bitmap_index = 0;
+        bitmap_index < assets->bitmap_count;
+        ++bitmap_index)
     {
-      umi_t glyph_data_offset = 
-        file_font.offset_to_data + 
-        sizeof(asset_file_font_glyph_t)*glyph_index;
-
-      asset_file_font_glyph_t file_glyph = {};
-      if (!file_read(
-          &file, 
-          &file_glyph,
-          sizeof(asset_file_font_glyph_t), 
-          glyph_data_offset)) 
+      _eden_assets_task_t* task = bitmap_tasks + bitmap_index;
+      asset_file_bitmap_t* file_bitmap = file_bitmaps + bitmap_index;
+      task->asset_index = bitmap_index;
+      task->file_bitmap = file_bitmap;
+
+      eden_asset_bitmap_t* b = assets->bitmaps + bitmap_index;
+      b->renderer_texture_handle = 0;
+      b->width = file_bitmap->width;
+      b->height = file_bitmap->height;
+
+      u32_t bitmap_size = b->width * b->height * 4;
+      eden_gfx_texture_payload_t* payload = eden_add_texture_begin(eden, bitmap_size);
+      if (!payload) 
       {
+        for (u32_t i = 0; i < bitmap_index; ++i)
+          eden_add_texture_cancel(eden, bitmap_tasks[i].payload);
         return false;
       }
+      payload->texture_index = b->renderer_texture_handle;
+      payload->texture_width = file_bitmap->width;
+      payload->texture_height = file_bitmap->height;
+      task->payload = payload;
+    }
+  }
 
-      eden_asset_font_glyph_t* glyph = glyphs + glyph_index;
-      glyph->texel_x0 = file_glyph.texel_x0;
-      glyph->texel_y0 = file_glyph.texel_y0;
-      glyph->texel_x1 = file_glyph.texel_x1;
-      glyph->texel_y1 = file_glyph.texel_y1;
+  //
+  // Run everything and wait for it to be done
+  //
+  for (u32_t i = 0; i < assets->sound_count; ++i) 
+    _eden_assets_add_task(_eden_assets_load_sound_task, sound_tasks + i);
+  for (u32_t i = 0; i < assets->bitmap_count; ++i) 
+    _eden_assets_add_task(_eden_assets_load_bitmap_task, bitmap_tasks + i);
+  for (u32_t i = 0; i < assets->font_count; ++i) 
+    _eden_assets_add_task(_eden_assets_load_font_task, font_tasks + i);
+  if (eden->complete_all_tasks) 
+    eden_complete_all_tasks();
+
+  eden_assets_load_stats_t* stats = &assets->load_stats;
+  b32_t sounds_ok = _eden_assets_gather_section_stats(&stats->sounds, sound_tasks, assets->sound_count);
+  b32_t bitmaps_ok = _eden_assets_gather_section_stats(&stats->bitmaps, bitmap_tasks, assets->bitmap_count);
+  b32_t fonts_ok = _eden_assets_gather_section_stats(&stats->fonts, font_tasks, assets->font_count);
+
+  // Hand the textures over to the platform
+  for(u32_t bitmap_index = 0;
+      bitmap_index < assets->bitmap_count;
+      ++bitmap_index)
+  {
+    _eden_assets_task_t* task = bitmap_tasks + bitmap_index;
+    if (bitmaps_ok) 
+      assets->bitmaps[bitmap_index].renderer_texture_handle = eden_add_texture_end(eden, task->payload);
+    else 
+      eden_add_texture_cancel(eden, task->payload);
+  }
 
+  stats->total_secs = (f32_t)(clock_time() - start_time) / clock_resolution();
 
-      glyph->box_x0 = file_glyph.box_x0;
-      glyph->box_y0 = file_glyph.box_y0;
-      glyph->box_x1 = file_glyph.box_x1;
-      glyph->box_y1 = file_glyph.box_y1;
+  ok = sounds_ok && bitmaps_ok && fonts_ok;
+  if (ok) 
+    assets->file_mapping = mapping;
+  return ok;
+}
 
-      glyph->horizontal_advance = file_glyph.horizontal_advance;
-      codepoint_map[file_glyph.codepoint] = glyph_index;
-    }
+static void
+eden_assets_log_load_stats()
+{
+  if (!eden->debug_log) return;
 
-    // Horizontal advances
-    {
-      umi_t kernings_data_offset = 
-        file_font.offset_to_data + 
-        sizeof(asset_file_font_glyph_t)*glyph_count;
-
-      file_read(
-          &file, 
-          kernings,
-          sizeof(f32_t)*glyph_count*glyph_count, 
-          kernings_data_offset);
-
-      f->glyphs = glyphs;
-      f->codepoint_map = codepoint_map;
-      f->kernings = kernings;
-      f->highest_codepoint = highest_codepoint;
-      f->glyph_count = glyph_count;
-    }
-  }
+  eden_assets_load_stats_t* stats = &eden->assets.load_stats;
+  struct { const char* name; eden_assets_section_stats_t* section; } sections[] = {
+    { "sounds",  &stats->sounds },
+    { "bitmaps", &stats->bitmaps },
+    { "fonts",   &stats->fonts },
+  };
 
-  return true;
+  eden_debug_log("[assets] loaded in %.2fms\n", stats->total_secs * 1000.f);
+  for_arr(section_index, sections) 
+  {
+    eden_assets_section_stats_t* s = sections[section_index].section;
+    eden_debug_log("[assets]   %-8s count: %5u, size: %9.2fMB, wall: %8.2fms, busy: %8.2fms\n",
+        sections[section_index].name,
+        s->count,
+        (f64_t)s->bytes / megabytes(1),
+        s->wall_secs * 1000.f,
+        s->busy_secs * 1000.f);
+  }
+}
 
+static void
+eden_assets_unmap_file()
+{
+  eden_assets_t* assets = &eden->assets;
+  if (buf_valid(assets->file_mapping)) 
+  {
+    file_unmap(assets->file_mapping);
+    assets->file_mapping = buf_bad();
+  }
 }
 
 static f32_t
@@ -36,6 +36,8 @@ struct eden_asset_shader_t {
   buf_t code;
 };
 
+// @note: This has the same layout as asset_file_font_glyph_t 
+// so that glyphs can be used straight from the asset file.
 struct eden_asset_font_glyph_t {
   u32_t texel_x0, texel_y0;
   u32_t texel_x1, texel_y1;
@@ -43,6 +45,7 @@ struct eden_asset_font_glyph_t {
   f32_t box_x0, box_y0;
   f32_t box_x1, box_y1;
 
+  u32_t codepoint;
   f32_t horizontal_advance;
 
 };
@@ -69,6 +72,20 @@ struct eden_asset_font_t
   f32_t* kernings;
 };
 
+struct eden_assets_section_stats_t {
+  u32_t count;
+  u64_t bytes;
+  f32_t wall_secs; // from the first task starting to the last task ending
+  f32_t busy_secs; // sum of the time spent in each task
+};
+
+struct eden_assets_load_stats_t {
+  eden_assets_section_stats_t sounds;
+  eden_assets_section_stats_t bitmaps;
+  eden_assets_section_stats_t fonts;
+  f32_t total_secs;
+};
+
 struct eden_assets_t {
   eden_gfx_texture_queue_t* texture_queue;
 
@@ -86,6 +103,14 @@ struct eden_assets_t {
 
   u32_t shader_count;
   eden_asset_shader_t* shaders;
+
+  // @note: Only valid if the assets are initialized with 
+  // the file mapped. Sounds, shaders, glyphs and kernings
+  // will point into this.
+  buf_t file_mapping;
+
+  // Timings of the last eden_assets_init_from_file()
+  eden_assets_load_stats_t load_stats;
 };
 
 #endif // __EDEN_ASSETS_H__
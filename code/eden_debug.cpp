@@ -7,7 +7,7 @@ _eden_debug_get_element_from_record(eden_debug_t* d, eden_debug_record_t* record
   eden_debug_element_t* ret = nullptr;
   for(eden_debug_element_t* itr = d->hashed_elements[index];
       itr;
-      itr = itr->next_in_link)
+      itr = itr->next_in_hash)
   {
     if (itr->guid == record->guid)
     {
@@ -32,42 +32,122 @@ _eden_debug_get_element_from_record(eden_debug_t* d, eden_debug_record_t* record
 }
 
 
+// Returns nullptr if the record buffer is full.
+// Call _eden_debug_commit_record() once the record is filled in.
 static eden_debug_record_t*
 _eden_debug_add_record(const char* name, eden_debug_type_t type)
 {
   eden_debug_t* d = &eden->debug;
-  eden_debug_record_t* ret = d->records + d->record_count++;
+  eden_debug_record_buffer_t* buffer = d->record_buffers + u32_atomic_load(&d->write_buffer_index);
+  u32_t record_index = u32_atomic_add(&buffer->record_count, 1);
+  if (record_index >= buffer->record_cap) 
+    return nullptr;
+
+  eden_debug_record_t* ret = buffer->records + record_index;
   ret->name = name;
   ret->guid = name;
+  ret->type = type;
   return ret;
 }
 
+static void
+_eden_debug_commit_record(eden_debug_record_t* record) 
+{
+  u32_atomic_store(&record->is_ready, true);
+}
+
 static void
 eden_inspect(const char* name, u32_t u32)
 {
   eden_debug_record_t* record = _eden_debug_add_record(name, EDEN_DEBUG_TYPE_U32); 
+  if (!record) return;
   record->inspect_u32 = u32;
+  _eden_debug_commit_record(record);
 }
 
 static void
 eden_inspect(const char* name, f32_t f32)
 {
   eden_debug_record_t* record = _eden_debug_add_record(name, EDEN_DEBUG_TYPE_F32); 
+  if (!record) return;
   record->inspect_f32 = f32;
+  _eden_debug_commit_record(record);
 }
 
 static void
 eden_inspect(const char* name, s32_t s32)
 {
   eden_debug_record_t* record = _eden_debug_add_record(name, EDEN_DEBUG_TYPE_S32); 
+  if (!record) return;
   record->inspect_s32 = s32;
+  _eden_debug_commit_record(record);
 }
 
 static void
 eden_inspect(const char* name, v2f_t v2f)
 {
   eden_debug_record_t* record = _eden_debug_add_record(name, EDEN_DEBUG_TYPE_V2F); 
+  if (!record) return;
   record->inspect_v2f = v2f;
+  _eden_debug_commit_record(record);
+}
+
+static b32_t
+_eden_debug_alloc_record_buffer(eden_debug_t* d, eden_debug_record_buffer_t* buffer, u32_t record_cap) 
+{
+  buffer->records = arena_push_arr_zero(eden_debug_record_t, &d->arena, record_cap);
+  buffer->record_cap = buffer->records ? record_cap : 0;
+  buffer->record_count = 0;
+  return buffer->records != nullptr;
+}
+
+// @note: Only when nobody is adding records!
+static void
+eden_debug_end_frame(eden_debug_t* d) 
+{
+  u32_t read_buffer_index = d->write_buffer_index;
+  eden_debug_record_buffer_t* read_buffer = d->record_buffers + read_buffer_index;
+  eden_debug_record_buffer_t* write_buffer = d->record_buffers + (read_buffer_index ^ 1);
+
+  d->overflow_count = 0;
+  if (read_buffer->record_count > read_buffer->record_cap) {
+    d->overflow_count = read_buffer->record_count - read_buffer->record_cap;
+    d->total_overflow_count += d->overflow_count;
+  }
+
+  // @note: The old memory is not reused; growing is rare and the 
+  // arena is big.
+  u32_t needed_cap = read_buffer->record_count; 
+  if (needed_cap > write_buffer->record_cap && write_buffer->record_cap < EDEN_DEBUG_MAX_RECORD_CAP) {
+    u32_t new_cap = max_of(write_buffer->record_cap, (u32_t)EDEN_DEBUG_INITIAL_RECORD_CAP);
+    while (new_cap < needed_cap && new_cap < EDEN_DEBUG_MAX_RECORD_CAP) new_cap *= 2;
+    eden_debug_record_buffer_t grown = {};
+    if (_eden_debug_alloc_record_buffer(d, &grown, min_of(new_cap, (u32_t)EDEN_DEBUG_MAX_RECORD_CAP))) 
+      *write_buffer = grown;
+  }
+
+  for (u32_t record_index = 0; record_index < min_of(write_buffer->record_count, write_buffer->record_cap); ++record_index)
+    write_buffer->records[record_index].is_ready = false;
+  write_buffer->record_count = 0;
+
+  u32_atomic_store(&d->write_buffer_index, read_buffer_index ^ 1);
+}
+
+// Puts the records of the last frame into their elements
+static void
+eden_debug_process_records(eden_debug_t* d) 
+{
+  eden_debug_record_buffer_t* buffer = d->record_buffers + (d->write_buffer_index ^ 1);
+  u32_t record_count = min_of(buffer->record_count, buffer->record_cap);
+  for(u32_t record_index = 0; 
+      record_index < record_count; 
+      ++record_index)
+  {
+    eden_debug_record_t* record = buffer->records + record_index;
+    if (!u32_atomic_load(&record->is_ready)) continue;
+    eden_debug_element_t* element = _eden_debug_get_element_from_record(d, record);
+    element->stored_record = dref(record);
+  }
 }
 
 
@@ -82,16 +162,9 @@ eden_debug_update_and_render(
 {
   auto* debug = &eden->debug;
 
-
-  // For each record, get the element and add the record to the element
-  for(u32_t record_index = 0; 
-      record_index < debug->record_count; 
-      ++record_index)
-  {
-    eden_debug_record_t* record = debug->records + record_index;
-    eden_debug_element_t* element = _eden_debug_get_element_from_record(debug, record);
-    element->stored_record = dref(record);
-  }
+  // @note: these are the records of the last frame, so this 
+  // never waits on anyone adding records for this frame.
+  eden_debug_process_records(debug);
 
 
   //
@@ -173,9 +246,18 @@ eden_debug_update_and_render(
     ++line_num;
   }
 
-  // always clear records
-  debug->record_count = 0;
-
+  if (debug->total_overflow_count) {
+    bufio_clear(&sb);
+    bufio_push_fmt(&sb, buf_from_lit("[%15s] %7u (%u total)"), 
+        "dropped records", debug->overflow_count, (u32_t)debug->total_overflow_count);
+    eden_draw_text(
+        font, 
+        sb.str, 
+        rgba_hex(0xFF0000FF), 
+        v2f_set(0.f, font_height * line_num),
+        font_height, 
+        v2f_set(0.f, 0.f));
+  }
 }
 
 static b32_t 
@@ -183,7 +265,13 @@ eden_debug_init(eden_debug_t* debug)
 {
   if (!arena_alloc(&debug->arena, gigabytes(1)))
     return false;
-  debug->record_count = 0;
+  for_arr(buffer_index, debug->record_buffers) {
+    if (!_eden_debug_alloc_record_buffer(debug, debug->record_buffers + buffer_index, EDEN_DEBUG_INITIAL_RECORD_CAP))
+      return false;
+  }
+  debug->write_buffer_index = 0;
+  debug->overflow_count = 0;
+  debug->total_overflow_count = 0;
   debug->linked_elements = nullptr;
   return true;
 }
@@ -26,6 +26,8 @@ struct eden_debug_record_t
   const char* name;
 
   eden_debug_type_t type;
+  u32_t is_ready; // set last, once the rest of the record is written
+
   union {
     // variable inspection
     u32_t inspect_u32;
@@ -59,12 +61,37 @@ struct eden_debug_element_t
 };
 
 
+//
+// @note: Records can be added from any thread. A thread reserves a 
+// slot with an atomic add and marks the record as ready once it's 
+// written. There are two buffers: one is written to during the frame
+// and the other one, written to during the last frame, is processed.
+// eden_debug_end_frame() swaps them, and has to be called when 
+// nobody is adding records, i.e. at the end of the frame after all 
+// tasks are done.
+//
+// Records that don't fit are dropped and counted. When that happens,
+// the buffer grows into the arena at the next swap.
+//
+#define EDEN_DEBUG_INITIAL_RECORD_CAP (1024)
+#define EDEN_DEBUG_MAX_RECORD_CAP     (1024 * 64)
+
+struct eden_debug_record_buffer_t 
+{
+  eden_debug_record_t* records;
+  u32_t record_cap;
+  u32_t record_count; // reserved so far; can go past record_cap
+};
+
 struct eden_debug_t 
 {
   arena_t arena; 
 
-  u32_t record_count;
-  eden_debug_record_t records[1024];
+  eden_debug_record_buffer_t record_buffers[2];
+  u32_t write_buffer_index;
+  
+  u32_t overflow_count;         // records dropped in the last frame
+  u64_t total_overflow_count;
 
   eden_debug_element_t* hashed_elements[1024];
   eden_debug_element_t* linked_elements; // for iteration
@@ -6,6 +6,7 @@ eden_gfx_push_command(eden_gfx_t* g, eden_gfx_command_type_t type)
   assert(g->command_count < g->command_cap);
   eden_gfx_command_t* cmd = g->commands + g->command_count++;
   cmd->type = type;
+  cmd->layer = g->current_layer;
   return cmd;
 }
 
@@ -65,6 +66,12 @@ eden_gfx_push_test_command(eden_gfx_t* g)
   eden_gfx_push_command(g, EDEN_GFX_COMMAND_TYPE_TEST);
 }
 
+static void 
+eden_gfx_push_barrier_command(eden_gfx_t* g)
+{
+  eden_gfx_push_command(g, EDEN_GFX_COMMAND_TYPE_BARRIER);
+}
+
 static void 
 eden_gfx_push_blend_command(
     eden_gfx_t* g, 
@@ -115,6 +122,117 @@ static void
 eden_gfx_clear_commands(eden_gfx_t* g) 
 {
   g->command_count = 0;
+  g->current_layer = 0;
+}
+
+static void
+eden_gfx_set_layer(eden_gfx_t* g, u32_t layer)
+{
+  g->current_layer = layer;
+}
+
+static b32_t
+_eden_gfx_is_same_blend(eden_gfx_t* g, u32_t lhs_index, u32_t rhs_index)
+{
+  if (lhs_index == U32_MAX || rhs_index == U32_MAX) 
+    return lhs_index == rhs_index;
+
+  eden_gfx_command_blend_t* lhs = &g->commands[lhs_index].blend;
+  eden_gfx_command_blend_t* rhs = &g->commands[rhs_index].blend;
+  return lhs->src == rhs->src && lhs->dst == rhs->dst;
+}
+
+// @note: The key has to fit in a f32_t's mantissa (24 bits) 
+// so that it survives being turned into a float for sort_radix().
+// From most to least significant:
+//   8 bits of layer, 7 bits of blend state, 8 bits of texture, 1 bit of draw mode.
+static f32_t
+_eden_gfx_get_sort_key(eden_gfx_t* g, eden_gfx_command_t* cmd, u32_t blend_index) 
+{
+  u32_t layer = min_of(cmd->layer, (u32_t)EDEN_GFX_SORT_MAX_LAYER);
+
+  u32_t blend = 0;
+  if (blend_index != U32_MAX) {
+    eden_gfx_command_blend_t* b = &g->commands[blend_index].blend;
+    blend = 1 + (u32_t)b->src * (EDEN_GFX_BLEND_TYPE_INV_DST_COLOR + 1) + (u32_t)b->dst;
+  }
+
+  u32_t texture = 0;
+  u32_t mode = 0;
+  if (cmd->type == EDEN_GFX_COMMAND_TYPE_SPRITE) {
+    texture = min_of(cmd->sprite.texture_index + 1, (u32_t)EDEN_GFX_SORT_MAX_TEXTURE);
+  }
+  else if (cmd->type == EDEN_GFX_COMMAND_TYPE_TRIANGLE) {
+    mode = 1;
+  }
+
+  u32_t key = (layer << 16) | (blend << 9) | (texture << 1) | mode;
+  return (f32_t)key;
+}
+
+static void
+_eden_gfx_sort_and_emit_run(eden_gfx_t* g, u32_t entry_count, u32_t* last_blend_index)
+{
+  if (entry_count == 0) return;
+
+  eden_gfx_sorter_t* s = &g->sorter;
+  sort_radix(s->entries, entry_count, &s->arena);
+
+  for (u32_t entry_index = 0; entry_index < entry_count; ++entry_index) 
+  {
+    u32_t cmd_index = s->entries[entry_index].index;
+    u32_t blend_index = s->blend_indices[cmd_index];
+    if (!_eden_gfx_is_same_blend(g, blend_index, *last_blend_index)) {
+      s->order[s->order_count++] = blend_index;
+      (*last_blend_index) = blend_index;
+    }
+    s->order[s->order_count++] = cmd_index;
+  }
+}
+
+// Fills up g->sorter.order. See the notes on eden_gfx_sorter_t.
+static void
+eden_gfx_sort_commands(eden_gfx_t* g) 
+{
+  eden_gfx_sorter_t* s = &g->sorter;
+  s->order_count = 0;
+
+  // @note: 'current' is the blend state the commands are submitted under.
+  // 'last' is the blend state that the emitted commands will leave us in.
+  u32_t current_blend_index = U32_MAX;
+  u32_t last_blend_index = U32_MAX;
+  u32_t entry_count = 0;
+
+  for (u32_t cmd_index = 0; cmd_index < g->command_count; ++cmd_index) 
+  {
+    eden_gfx_command_t* cmd = g->commands + cmd_index;
+    switch(cmd->type) {
+      case EDEN_GFX_COMMAND_TYPE_BLEND: {
+        current_blend_index = cmd_index;
+      } break;
+      case EDEN_GFX_COMMAND_TYPE_TRIANGLE:
+      case EDEN_GFX_COMMAND_TYPE_RECT:
+      case EDEN_GFX_COMMAND_TYPE_SPRITE: {
+        s->blend_indices[cmd_index] = current_blend_index;
+        sort_entry_t* entry = s->entries + entry_count++;
+        entry->index = cmd_index;
+        entry->key = _eden_gfx_get_sort_key(g, cmd, current_blend_index);
+      } break;
+      default: {
+        // barrier
+        _eden_gfx_sort_and_emit_run(g, entry_count, &last_blend_index);
+        entry_count = 0;
+        s->order[s->order_count++] = cmd_index;
+      } break;
+    }
+  }
+  _eden_gfx_sort_and_emit_run(g, entry_count, &last_blend_index);
+
+  // Leave the blend state the way the game left it, since that 
+  // carries over to the next frame.
+  if (!_eden_gfx_is_same_blend(g, current_blend_index, last_blend_index)) {
+    s->order[s->order_count++] = current_blend_index;
+  }
 }
 
 static b32_t 
@@ -132,6 +250,24 @@ eden_gfx_init(
     g->command_cap = max_commands;
     g->command_count = 0;
     g->commands = arena_push_arr(eden_gfx_command_t, arena, max_commands);
+    if (!g->commands) return false;
+  }
+
+  // sorter
+  {
+    eden_gfx_sorter_t* s = &g->sorter;
+    s->order = arena_push_arr(u32_t, arena, max_commands * 2);
+    if (!s->order) return false;
+    s->entries = arena_push_arr(sort_entry_t, arena, max_commands);
+    if (!s->entries) return false;
+    s->blend_indices = arena_push_arr(u32_t, arena, max_commands);
+    if (!s->blend_indices) return false;
+    // @note: sort_radix() also needs room for its histograms.
+    if (!arena_push_partition(arena, &s->arena, sizeof(sort_entry_t) * max_commands + kilobytes(64))) 
+      return false;
+    s->order_count = 0;
+    g->is_sorting_enabled = false;
+    g->current_layer = 0;
   }
 
   // textures
@@ -76,6 +76,7 @@ enum eden_gfx_command_type_t {
   EDEN_GFX_COMMAND_TYPE_SPRITE,
   EDEN_GFX_COMMAND_TYPE_BLEND,
   EDEN_GFX_COMMAND_TYPE_VIEW,
+  EDEN_GFX_COMMAND_TYPE_BARRIER, // stops sorting from moving commands across it
 #if 0
   EDEN_GFX_COMMAND_TYPE_ADVANCE_DEPTH,
   EDEN_GFX_COMMAND_TYPE_DELETE_TEXTURE,
@@ -144,6 +145,7 @@ struct eden_gfx_command_sprite_t {
 
 struct eden_gfx_command_t {
   eden_gfx_command_type_t type; 
+  u32_t layer; 
   union 
   {
     eden_gfx_command_rect_t rect;
@@ -163,11 +165,48 @@ enum eden_blend_preset_type_t {
   EDEN_BLEND_PRESET_TYPE_MULTIPLY,
 };
 
+//
+// Command sorting
+//
+// @note: This is opt-in. When enabled, the draw commands between 
+// 'barriers' are reordered by layer, then blend state, then texture,
+// so that the backend can batch them into fewer draw calls. 
+// Commands with the same key keep the order they were submitted in.
+//
+// Barriers are VIEW, CLEAR and BARRIER commands, which stay where 
+// they are. BLEND commands are dropped and put back in front of the 
+// first command that needs a different blend state than the last one.
+// 
+// This means that within a layer, draw commands that are not 
+// separated by a barrier must not care about the order they are drawn in.
+//
+#define EDEN_GFX_SORT_MAX_LAYER   0xFF
+#define EDEN_GFX_SORT_MAX_TEXTURE 0xFF
+
+struct eden_gfx_sorter_t {
+  // Indices of commands in the order they should be executed.
+  // Can be up to twice the number of commands because of BLEND commands.
+  u32_t* order;
+  u32_t order_count;
+
+  sort_entry_t* entries;
+
+  // @note: Blend command that each command was submitted under.
+  // U32_MAX if there was none.
+  u32_t* blend_indices;
+
+  arena_t arena; // for sort_radix()
+};
+
 struct eden_gfx_t {
   u32_t command_cap;
   u32_t command_count;
   eden_gfx_command_t* commands;
 
+  b32_t is_sorting_enabled;
+  u32_t current_layer;
+  eden_gfx_sorter_t sorter;
+
   eden_gfx_texture_queue_t texture_queue;
   usz_t max_textures;
   eden_blend_preset_type_t current_blend_preset;
@@ -0,0 +1,154 @@
+static b32_t
+eden_null_gfx_init(
+    eden_t* eden,
+    usz_t texture_queue_size,
+    usz_t max_commands,
+    usz_t max_textures,
+    usz_t max_payloads)
+{
+  auto* gfx = &eden->gfx;
+  auto* null_gfx = (eden_null_gfx_t*)gfx->platform_data;
+
+  return eden_gfx_init(
+      gfx, 
+      &null_gfx->arena,
+      texture_queue_size,
+      max_commands,
+      max_textures,
+      max_payloads);
+}
+
+// @note: Same as eden_opengl_process_texture_queue() minus the uploading
+static void
+eden_null_gfx_process_texture_queue(eden_gfx_t* gfx) {
+  auto* null_gfx = (eden_null_gfx_t*)gfx->platform_data;
+
+  eden_gfx_texture_queue_t* textures = &gfx->texture_queue;
+  while(textures->payload_count) {
+    eden_gfx_texture_payload_t* payload = textures->payloads + textures->first_payload_index;
+    if (payload->state == EDEN_GFX_TEXTURE_PAYLOAD_STATE_LOADING) 
+      break;
+
+    if (payload->state == EDEN_GFX_TEXTURE_PAYLOAD_STATE_READY)
+      ++null_gfx->texture_count;
+
+    textures->transfer_memory_start = payload->transfer_memory_end;
+
+    ++textures->first_payload_index;
+    if (textures->first_payload_index > textures->payload_cap) {
+      textures->first_payload_index = 0;
+    }
+    --textures->payload_count;
+  }
+}
+
+static void
+eden_null_gfx_begin_frame(eden_gfx_t* gfx) 
+{
+  eden_gfx_clear_commands(gfx);  
+}
+
+// @note: A batch is broken up by anything that isn't a draw, or by a draw 
+// with a different texture or draw mode, just like the OpenGL batch.
+static void
+_eden_null_gfx_end_batch(eden_null_gfx_t* null_gfx) 
+{
+  if (null_gfx->is_batch_open) {
+    ++null_gfx->batch_count;
+    null_gfx->is_batch_open = false;
+  }
+}
+
+static void
+_eden_null_gfx_push_draw(eden_null_gfx_t* null_gfx, eden_gfx_command_type_t type, u32_t texture_index) 
+{
+  // rects and sprites are both quads
+  if (type == EDEN_GFX_COMMAND_TYPE_RECT) 
+    type = EDEN_GFX_COMMAND_TYPE_SPRITE;
+
+  if (null_gfx->is_batch_open && 
+      (null_gfx->last_draw_type != type || null_gfx->last_texture_index != texture_index)) 
+  {
+    _eden_null_gfx_end_batch(null_gfx);
+  }
+  null_gfx->is_batch_open = true;
+  null_gfx->last_draw_type = type;
+  null_gfx->last_texture_index = texture_index;
+  ++null_gfx->draw_count;
+}
+
+static u64_t
+_eden_null_gfx_hash_command(eden_gfx_command_t* entry, u64_t hash) 
+{
+  hash = hash_fnv1a_64(&entry->type, sizeof(entry->type), hash);
+  hash = hash_fnv1a_64(&entry->layer, sizeof(entry->layer), hash);
+  switch(entry->type) {
+    case EDEN_GFX_COMMAND_TYPE_TRIANGLE: 
+      return hash_fnv1a_64(&entry->tri, sizeof(entry->tri), hash);
+    case EDEN_GFX_COMMAND_TYPE_RECT: 
+      return hash_fnv1a_64(&entry->rect, sizeof(entry->rect), hash);
+    case EDEN_GFX_COMMAND_TYPE_SPRITE: 
+      return hash_fnv1a_64(&entry->sprite, sizeof(entry->sprite), hash);
+    case EDEN_GFX_COMMAND_TYPE_VIEW: 
+      return hash_fnv1a_64(&entry->view, sizeof(entry->view), hash);
+    case EDEN_GFX_COMMAND_TYPE_BLEND: 
+      return hash_fnv1a_64(&entry->blend, sizeof(entry->blend), hash);
+    case EDEN_GFX_COMMAND_TYPE_CLEAR: 
+      return hash_fnv1a_64(&entry->clear, sizeof(entry->clear), hash);
+    case EDEN_GFX_COMMAND_TYPE_BARRIER: 
+    case EDEN_GFX_COMMAND_TYPE_TEST: 
+      return hash;
+  }
+  return hash;
+}
+
+static void
+eden_null_gfx_end_frame(eden_gfx_t* gfx) 
+{
+  auto* null_gfx = (eden_null_gfx_t*)gfx->platform_data;
+
+  null_gfx->draw_count = 0;
+  null_gfx->batch_count = 0;
+  null_gfx->texture_count = 0;
+  null_gfx->is_batch_open = false;
+  null_gfx->hash = hash_fnv1a_64(nullptr, 0);
+
+  eden_null_gfx_process_texture_queue(gfx);
+
+  u32_t* order = nullptr;
+  u32_t order_count = gfx->command_count;
+  if (gfx->is_sorting_enabled) {
+    eden_gfx_sort_commands(gfx);
+    order = gfx->sorter.order;
+    order_count = gfx->sorter.order_count;
+  }
+  null_gfx->command_count = order_count;
+
+  // @note: blank textures are drawn with U32_MAX, which no sprite can have
+  for (u32_t order_index = 0; 
+       order_index < order_count; 
+       ++order_index) 
+  {
+    u32_t cmd_index = order ? order[order_index] : order_index;
+    eden_gfx_command_t* entry = gfx->commands + cmd_index;
+    null_gfx->hash = _eden_null_gfx_hash_command(entry, null_gfx->hash);
+    switch(entry->type) {
+      case EDEN_GFX_COMMAND_TYPE_TRIANGLE: 
+      case EDEN_GFX_COMMAND_TYPE_RECT: {
+        _eden_null_gfx_push_draw(null_gfx, entry->type, U32_MAX);
+      } break;
+      case EDEN_GFX_COMMAND_TYPE_SPRITE: {
+        _eden_null_gfx_push_draw(null_gfx, entry->type, entry->sprite.texture_index);
+      } break;
+      case EDEN_GFX_COMMAND_TYPE_VIEW: 
+      case EDEN_GFX_COMMAND_TYPE_BLEND: {
+        _eden_null_gfx_end_batch(null_gfx);
+      } break;
+      case EDEN_GFX_COMMAND_TYPE_CLEAR: 
+      case EDEN_GFX_COMMAND_TYPE_BARRIER: 
+      case EDEN_GFX_COMMAND_TYPE_TEST: {
+      } break;
+    }
+  }
+  _eden_null_gfx_end_batch(null_gfx);
+}
@@ -0,0 +1,33 @@
+#ifndef EDEN_GFX_NULL_H
+#define EDEN_GFX_NULL_H
+
+//
+// A gfx backend that doesn't draw anything.
+//
+// It still consumes the command list and the texture queue the same way 
+// the real backends do, so apps run as if they were on a real backend.
+// Used by headless hosts.
+//
+
+struct eden_null_gfx_t 
+{
+  arena_t arena;
+
+  // stats for the last frame
+  u32_t command_count;
+  u32_t draw_count;     // triangles, rects and sprites
+  u32_t batch_count;    // how many batches a real backend would have flushed
+  u32_t texture_count;  // texture payloads consumed
+
+  // @note: hash of every command in the order a real backend would 
+  // have drawn them. If two runs with the same input have the same 
+  // hashes, they drew the same thing.
+  u64_t hash;
+
+  // @note: used to count batches
+  eden_gfx_command_type_t last_draw_type;
+  u32_t last_texture_index;
+  b32_t is_batch_open;
+};
+
+#endif // EDEN_GFX_NULL_H
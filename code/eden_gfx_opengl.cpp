@@ -140,7 +140,7 @@ eden_opengl_add_predefined_textures(eden_opengl_t* ogl) {
 
 
 static b32_t 
-eden_opengl_batch_init(eden_opengl_t* ogl, arena_t* arena, usz_t element_count)
+eden_opengl_batch_init(eden_opengl_t* ogl, arena_t* arena, usz_t element_count, u32_t frames_in_flight)
 {
   eden_opengl_batch_t* batch = &ogl->batch;
 
@@ -197,17 +197,13 @@ eden_opengl_batch_init(eden_opengl_t* ogl, arena_t* arena, usz_t element_count)
 
   batch->element_count = element_count;
 
-  // one element has 4 vertices, uvs, and colors (one for each vertex)
+  // one element has 4 vertices
   batch->vertex_count = batch->element_count*4; 
-  batch->vertices = arena_push_arr(v3f_t, arena, batch->vertex_count); 
-  batch->colors = arena_push_arr(rgba_t, arena, batch->vertex_count); 
-  batch->uvs = arena_push_arr(v2f_t, arena, batch->vertex_count); 
 
   // one element has 6 indices
   batch->index_count = batch->element_count*6;
   batch->indices = arena_push_arr(u32_t, arena, batch->index_count); 
-
-  if (!batch->vertices || !batch->colors || !batch->uvs || !batch->indices) 
+  if (!batch->indices) 
   {
     return false;
   }
@@ -226,37 +222,86 @@ eden_opengl_batch_init(eden_opengl_t* ogl, arena_t* arena, usz_t element_count)
     batch->indices[index_index+5] = 4*element_index+3;
   }
 
-  ogl->glGenVertexArrays(1, &batch->vao);
-  ogl->glBindVertexArray(batch->vao);
-
-  // buffer for vertices (shader location = 0)
-  ogl->glGenBuffers(1, &batch->vbo_vertices); 
-  ogl->glBindBuffer(GL_ARRAY_BUFFER, batch->vbo_vertices);
-  ogl->glBufferData(GL_ARRAY_BUFFER, batch->vertex_count*sizeof(dref(batch->vertices)), batch->vertices, GL_DYNAMIC_DRAW);
-  ogl->glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(v3f_t), 0);
-  ogl->glEnableVertexAttribArray(0); 
-
-  // buffer for UVs (shader-location = 1)
-  ogl->glGenBuffers(1, &batch->vbo_uvs);
-  ogl->glBindBuffer(GL_ARRAY_BUFFER, batch->vbo_uvs);
-  ogl->glBufferData(GL_ARRAY_BUFFER, batch->vertex_count*sizeof(dref(batch->uvs)), batch->uvs, GL_DYNAMIC_DRAW);
-  ogl->glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(v2f_t), 0);
-  ogl->glEnableVertexAttribArray(1);
-
-  // buffer for colors (shader-location = 2)
-  ogl->glGenBuffers(1, &batch->vbo_colors);
-  ogl->glBindBuffer(GL_ARRAY_BUFFER, batch->vbo_colors);
-  ogl->glBufferData(GL_ARRAY_BUFFER, batch->vertex_count*sizeof(dref(batch->colors)), batch->colors, GL_DYNAMIC_DRAW);
-  ogl->glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, sizeof(rgba_t), 0);
-  ogl->glEnableVertexAttribArray(2);
+  //
+  // Vertex buffer
+  //
+  // @note: Each frame in flight gets its own region of one big
+  // persistently mapped buffer, and a fence tells us when the GPU
+  // is done reading a region so that we can write to it again.
+  //
+  // If we can't map the buffer, there is only one region and we orphan
+  // it at the start of every frame instead, which lets the driver hand
+  // us fresh memory while the GPU is still reading the old one.
+  //
+  batch->frames_in_flight = clamp_of(frames_in_flight, 1, EDEN_OPENGL_MAX_FRAMES_IN_FLIGHT);
+  batch->frame_index = 0;
+  batch->region_index = 0;
+  batch->fence_wait_count = 0;
+  for_arr(fence_index, batch->fences)
+    batch->fences[fence_index] = nullptr;
+
+  usz_t region_size = sizeof(eden_opengl_vertex_t)*batch->vertex_count;
+
+  batch->is_persistent = 
+    ogl->glMapNamedBufferRange && 
+    ogl->glFenceSync && 
+    ogl->glClientWaitSync && 
+    ogl->glDeleteSync;
+
+  if (batch->is_persistent) 
+  {
+    GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    usz_t size = region_size*batch->frames_in_flight;
+    ogl->glCreateBuffers(1, &batch->vbo);
+    ogl->glNamedBufferStorage(batch->vbo, size, nullptr, flags);
+    batch->mapped = (eden_opengl_vertex_t*)ogl->glMapNamedBufferRange(batch->vbo, 0, size, flags);
+    if (!batch->mapped) 
+    {
+      // @note: the storage of 'vbo' is immutable, so it cannot be resized
+      // for orphaning. Delete it and make a new one below.
+      ogl->glDeleteBuffers(1, &batch->vbo);
+      batch->vbo = 0;
+      batch->is_persistent = false;
+    }
+  }
 
-  // buffer for indices 
-  ogl->glGenBuffers(1, &batch->vbo_indices);
-  ogl->glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, batch->vbo_indices);
-  ogl->glBufferData(GL_ELEMENT_ARRAY_BUFFER, batch->index_count*sizeof(dref(batch->indices)), batch->indices, GL_STATIC_DRAW);
+  if (!batch->is_persistent)
+  {
+    batch->frames_in_flight = 1;
+    batch->staging = arena_push_arr(eden_opengl_vertex_t, arena, batch->vertex_count);
+    if (!batch->staging) 
+    {
+      return false;
+    }
+    ogl->glCreateBuffers(1, &batch->vbo);
+    ogl->glNamedBufferData(batch->vbo, region_size, nullptr, GL_STREAM_DRAW);
+  }
+
+  //
+  // Vertex array
+  //
+  ogl->glCreateVertexArrays(1, &batch->vao);
+  ogl->glVertexArrayVertexBuffer(batch->vao, 0, batch->vbo, 0, sizeof(eden_opengl_vertex_t));
+
+  // position (shader location = 0)
+  ogl->glEnableVertexArrayAttrib(batch->vao, 0); 
+  ogl->glVertexArrayAttribFormat(batch->vao, 0, 3, GL_FLOAT, GL_FALSE, offset_of(eden_opengl_vertex_t, pos));
+  ogl->glVertexArrayAttribBinding(batch->vao, 0, 0);
 
-  ogl->glBindBuffer(GL_ARRAY_BUFFER, 0);
-  ogl->glBindVertexArray(0);
+  // uv (shader location = 1)
+  ogl->glEnableVertexArrayAttrib(batch->vao, 1); 
+  ogl->glVertexArrayAttribFormat(batch->vao, 1, 2, GL_FLOAT, GL_FALSE, offset_of(eden_opengl_vertex_t, uv));
+  ogl->glVertexArrayAttribBinding(batch->vao, 1, 0);
+
+  // color (shader location = 2)
+  ogl->glEnableVertexArrayAttrib(batch->vao, 2); 
+  ogl->glVertexArrayAttribFormat(batch->vao, 2, 4, GL_FLOAT, GL_FALSE, offset_of(eden_opengl_vertex_t, color));
+  ogl->glVertexArrayAttribBinding(batch->vao, 2, 0);
+
+  // buffer for indices 
+  ogl->glCreateBuffers(1, &batch->vbo_indices);
+  ogl->glNamedBufferStorage(batch->vbo_indices, batch->index_count*sizeof(dref(batch->indices)), batch->indices, 0);
+  ogl->glVertexArrayElementBuffer(batch->vao, batch->vbo_indices);
 
   return true;
 }
@@ -268,7 +313,8 @@ eden_opengl_init(
     usz_t max_commands,
     usz_t max_textures,
     usz_t max_payloads,
-    usz_t max_elements)
+    usz_t max_elements,
+    u32_t frames_in_flight)
 {	
   auto* gfx = &eden->gfx;
   auto* ogl = (eden_opengl_t*)gfx->platform_data;
@@ -295,7 +341,8 @@ eden_opengl_init(
   // init batch
   eden_opengl_add_predefined_textures(ogl);
   eden_opengl_delete_all_textures(ogl);
-  eden_opengl_batch_init(ogl, &ogl->arena, max_elements);
+  if (!eden_opengl_batch_init(ogl, &ogl->arena, max_elements, frames_in_flight))
+    return false;
 
   return true;
 }
@@ -433,37 +480,20 @@ eden_opengl_flush_batch(eden_opengl_t* ogl)
 {
   eden_opengl_batch_t* batch = &ogl->batch;
   usz_t vertices_to_draw = batch->vertex_index_ope - batch->vertex_index_start;
+  ++ogl->flush_count;
   if (vertices_to_draw > 0)
   {
-    //
-    // vertices
-    //
-    ogl->glBindBuffer(GL_ARRAY_BUFFER, batch->vbo_vertices);
-    ogl->glBufferSubData(
-        GL_ARRAY_BUFFER, 
-        sizeof(dref(batch->vertices))*batch->vertex_index_start, 
-        sizeof(dref(batch->vertices))*vertices_to_draw, 
-        (GLvoid*)(batch->vertices + batch->vertex_index_start));
+    ++ogl->draw_count;
 
-    //
-    // uvs
-    //
-    ogl->glBindBuffer(GL_ARRAY_BUFFER, batch->vbo_uvs);
-    ogl->glBufferSubData(
-        GL_ARRAY_BUFFER, 
-        sizeof(dref(batch->uvs))*batch->vertex_index_start, 
-        sizeof(dref(batch->uvs))*vertices_to_draw, 
-        (GLvoid*)(batch->uvs + batch->vertex_index_start));
-
-    //
-    // colors
-    //
-    ogl->glBindBuffer(GL_ARRAY_BUFFER, batch->vbo_colors);
-    ogl->glBufferSubData(
-        GL_ARRAY_BUFFER, 
-        sizeof(dref(batch->colors))*batch->vertex_index_start, 
-        sizeof(dref(batch->colors))*vertices_to_draw, 
-        (GLvoid*)(batch->colors + batch->vertex_index_start));
+    // @note: a persistently mapped buffer already has the vertices
+    if (!batch->is_persistent)
+    {
+      ogl->glNamedBufferSubData(
+          batch->vbo,
+          sizeof(eden_opengl_vertex_t)*batch->vertex_index_start, 
+          sizeof(eden_opengl_vertex_t)*vertices_to_draw, 
+          (GLvoid*)(batch->vertices + batch->vertex_index_start));
+    }
 
     //
     // Draw!
@@ -501,10 +531,58 @@ eden_opengl_flush_batch(eden_opengl_t* ogl)
     batch->vertex_index_start = batch->vertex_index_ope;
   }
 }
+// @note: Blocks until the GPU is done with the region we are about to
+// write to, which only happens if we are more than 'frames_in_flight' 
+// frames ahead of it.
+static void
+eden_opengl_batch_wait_for_region(eden_opengl_t* ogl, u32_t region_index)
+{
+  eden_opengl_batch_t* batch = &ogl->batch;
+  GLsync fence = batch->fences[region_index];
+  if (!fence) return;
+
+  GLenum result = ogl->glClientWaitSync(fence, 0, 0);
+  if (result == GL_TIMEOUT_EXPIRED)
+  {
+    ++batch->fence_wait_count;
+    do {
+      result = ogl->glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, EDEN_OPENGL_FENCE_TIMEOUT);
+    } while(result == GL_TIMEOUT_EXPIRED);
+  }
+  ogl->glDeleteSync(fence);
+  batch->fences[region_index] = nullptr;
+}
+
 static void
 eden_opengl_batch_begin(eden_opengl_t* ogl) 
 {
   eden_opengl_batch_t* batch = &ogl->batch;
+  if (batch->is_persistent)
+  {
+    batch->region_index = batch->frame_index % batch->frames_in_flight;
+    eden_opengl_batch_wait_for_region(ogl, batch->region_index);
+
+    usz_t first_vertex = batch->region_index*batch->vertex_count;
+    batch->vertices = batch->mapped + first_vertex;
+    ogl->glVertexArrayVertexBuffer(
+        batch->vao, 
+        0, 
+        batch->vbo, 
+        first_vertex*sizeof(eden_opengl_vertex_t), 
+        sizeof(eden_opengl_vertex_t));
+  }
+  else
+  {
+    // orphan
+    batch->region_index = 0;
+    batch->vertices = batch->staging;
+    ogl->glNamedBufferData(
+        batch->vbo, 
+        batch->vertex_count*sizeof(eden_opengl_vertex_t), 
+        nullptr, 
+        GL_STREAM_DRAW);
+  }
+
   batch->current_texture = 0;
   batch->vertex_index_start = 0;
   batch->vertex_index_ope = 0;
@@ -537,6 +615,33 @@ eden_opengl_batch_update_and_flush_if_required(
   batch->current_texture = incoming_texture;
 }
 
+//
+// @note: These only write vertices and don't touch GL at all
+//
+static void
+eden_opengl_pack_triangle(
+    eden_opengl_vertex_t* dst,
+    v3f_t p0, v3f_t p1, v3f_t p2,
+    v2f_t uv0, v2f_t uv1, v2f_t uv2,
+    rgba_t c0, rgba_t c1, rgba_t c2)
+{
+  dst[0].pos = p0; dst[0].uv = uv0; dst[0].color = c0;
+  dst[1].pos = p1; dst[1].uv = uv1; dst[1].color = c1;
+  dst[2].pos = p2; dst[2].uv = uv2; dst[2].color = c2;
+}
+
+static void
+eden_opengl_pack_quad(
+    eden_opengl_vertex_t* dst,
+    v3f_t p0, v3f_t p1, v3f_t p2, v3f_t p3,
+    v2f_t uv0, v2f_t uv1, v2f_t uv2, v2f_t uv3,
+    rgba_t c0, rgba_t c1, rgba_t c2, rgba_t c3)
+{
+  dst[0].pos = p0; dst[0].uv = uv0; dst[0].color = c0;
+  dst[1].pos = p1; dst[1].uv = uv1; dst[1].color = c1;
+  dst[2].pos = p2; dst[2].uv = uv2; dst[2].color = c2;
+  dst[3].pos = p3; dst[3].uv = uv3; dst[3].color = c3;
+}
 
 static void
 eden_opengl_batch_push_triangle(
@@ -549,17 +654,12 @@ eden_opengl_batch_push_triangle(
   eden_opengl_batch_t* batch = &ogl->batch;
   eden_opengl_batch_update_and_flush_if_required(ogl, EDEN_GFX_OPENGL_DRAW_MODE_TRIANGLES, texture);
 
-  batch->vertices[batch->vertex_index_ope+0] = p0;
-  batch->vertices[batch->vertex_index_ope+1] = p1;
-  batch->vertices[batch->vertex_index_ope+2] = p2;
-
-  batch->uvs[batch->vertex_index_ope+0] = uv0;
-  batch->uvs[batch->vertex_index_ope+1] = uv1;
-  batch->uvs[batch->vertex_index_ope+2] = uv2;
-
-  batch->colors[batch->vertex_index_ope+0] = c0; 
-  batch->colors[batch->vertex_index_ope+1] = c1; 
-  batch->colors[batch->vertex_index_ope+2] = c2; 
+  assert(batch->vertex_index_ope + 3 <= batch->vertex_count);
+  eden_opengl_pack_triangle(
+      batch->vertices + batch->vertex_index_ope,
+      p0, p1, p2,
+      uv0, uv1, uv2,
+      c0, c1, c2);
 
   batch->vertex_index_ope += 3;
 }
@@ -576,20 +676,12 @@ eden_opengl_batch_push_quad(
   eden_opengl_batch_t* batch = &ogl->batch;
   eden_opengl_batch_update_and_flush_if_required(ogl, EDEN_GFX_OPENGL_DRAW_MODE_QUADS, texture);
 
-  batch->vertices[batch->vertex_index_ope+0] = p0;
-  batch->vertices[batch->vertex_index_ope+1] = p1;
-  batch->vertices[batch->vertex_index_ope+2] = p2;
-  batch->vertices[batch->vertex_index_ope+3] = p3;
-
-  batch->uvs[batch->vertex_index_ope+0] = uv0;
-  batch->uvs[batch->vertex_index_ope+1] = uv1;
-  batch->uvs[batch->vertex_index_ope+2] = uv2;
-  batch->uvs[batch->vertex_index_ope+3] = uv3;
-
-  batch->colors[batch->vertex_index_ope+0] = c0;
-  batch->colors[batch->vertex_index_ope+1] = c1;
-  batch->colors[batch->vertex_index_ope+2] = c2;
-  batch->colors[batch->vertex_index_ope+3] = c3;
+  assert(batch->vertex_index_ope + 4 <= batch->vertex_count);
+  eden_opengl_pack_quad(
+      batch->vertices + batch->vertex_index_ope,
+      p0, p1, p2, p3,
+      uv0, uv1, uv2, uv3,
+      c0, c1, c2, c3);
 
   batch->vertex_index_ope += 4;
 }
@@ -612,29 +704,14 @@ eden_opengl_batch_push_mvp(eden_opengl_t* ogl, m44f_t mvp)
 static void
 eden_opengl_batch_end(eden_opengl_t* ogl)
 {
+  eden_opengl_batch_t* batch = &ogl->batch;
   eden_opengl_flush_batch(ogl);
 
-  memory_zero(ogl->batch.vertices, sizeof(v3f_t)*ogl->batch.vertex_count);
-  memory_zero(ogl->batch.uvs, sizeof(v2f_t)*ogl->batch.vertex_count);
-  memory_zero(ogl->batch.colors, sizeof(rgba_t)*ogl->batch.vertex_count);
-
-#if 0
-    ogl->glBufferSubData(
-        GL_ARRAY_BUFFER, 
-        0,
-        sizeof(v3f_t)*ogl->batch.vertex_count, 
-        (GLvoid*)(ogl->batch.vertices));
-    ogl->glBufferSubData(
-        GL_ARRAY_BUFFER, 
-        0,
-        sizeof(v2f_t)*ogl->batch.vertex_count, 
-        (GLvoid*)(ogl->batch.uvs));
-    ogl->glBufferSubData(
-        GL_ARRAY_BUFFER, 
-        0,
-        sizeof(rgba_t)*ogl->batch.vertex_count, 
-        (GLvoid*)(ogl->batch.colors));
-#endif
+  if (batch->is_persistent)
+  {
+    batch->fences[batch->region_index] = ogl->glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  }
+  ++batch->frame_index;
 }
 
 
@@ -647,11 +724,24 @@ eden_opengl_end_frame(eden_gfx_t* gfx) {
   eden_opengl_align_viewport(ogl);
   eden_opengl_process_texture_queue(gfx);
   eden_opengl_batch_begin(ogl);
+  ogl->flush_count = 0;
+  ogl->draw_count = 0;
+
+  u32_t* order = nullptr;
+  u32_t order_count = gfx->command_count;
+  if (gfx->is_sorting_enabled) {
+    eden_profile_begin(gfx_sort);
+    eden_gfx_sort_commands(gfx);
+    eden_profile_end(gfx_sort);
+    order = gfx->sorter.order;
+    order_count = gfx->sorter.order_count;
+  }
 
-  for (u32_t cmd_index = 0; 
-       cmd_index < gfx->command_count; 
-       ++cmd_index) 
+  for (u32_t order_index = 0; 
+       order_index < order_count; 
+       ++order_index) 
   {
+    u32_t cmd_index = order ? order[order_index] : order_index;
     eden_gfx_command_t* entry = gfx->commands + cmd_index;
     switch(entry->type) {
       case EDEN_GFX_COMMAND_TYPE_VIEW: {
@@ -791,9 +881,13 @@ eden_opengl_end_frame(eden_gfx_t* gfx) {
         eden_gfx_command_blend_t* data = &entry->blend;
         eden_opengl_set_blend_mode(ogl, data->src, data->dst);
       } break;
+      case EDEN_GFX_COMMAND_TYPE_BARRIER: 
       case EDEN_GFX_COMMAND_TYPE_TEST: {
       } break;
     }
   }
   eden_opengl_batch_end(ogl);
+
+  eden_profile_count(gfx_flushes, ogl->flush_count);
+  eden_profile_count(gfx_draws, ogl->draw_count);
 }
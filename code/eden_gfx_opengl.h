@@ -32,6 +32,15 @@
 #define GL_DEBUG_OUTPUT_SYNCHRONOUS     0x8242
 #define GL_FLOAT                        0x1406
 #define GL_DYNAMIC_STORAGE_BIT          0x0100
+#define GL_MAP_WRITE_BIT                0x0002
+#define GL_MAP_PERSISTENT_BIT           0x0040
+#define GL_MAP_COHERENT_BIT             0x0080
+#define GL_SYNC_GPU_COMMANDS_COMPLETE   0x9117
+#define GL_SYNC_FLUSH_COMMANDS_BIT      0x00000001
+#define GL_ALREADY_SIGNALED             0x911A
+#define GL_TIMEOUT_EXPIRED              0x911B
+#define GL_CONDITION_SATISFIED          0x911C
+#define GL_WAIT_FAILED                  0x911D
 #define GL_TEXTURE_2D                   0x0DE1
 #define GL_FRAGMENT_SHADER              0x8B30
 #define GL_VERTEX_SHADER                0x8B31
@@ -89,6 +98,8 @@ typedef b8_t   GLboolean;
 typedef f32_t  GLfloat;
 typedef f64_t  GLdouble;
 typedef void   GLvoid;
+typedef u64_t  GLuint64;
+typedef struct __GLsync* GLsync;
 typedef void (GLDEBUGPROC)(GLenum source,
     GLenum type,
     GLuint id,
@@ -112,6 +123,7 @@ typedef void    eden_opengl_glDeleteShader(GLuint program);
 typedef void    eden_opengl_glClear(GLbitfield mask);
 typedef void    eden_opengl_glClearColor(GLclampf r, GLclampf g, GLclampf b, GLclampf a);
 typedef void    eden_opengl_glCreateBuffers(GLsizei n, GLuint* buffers);
+typedef void    eden_opengl_glDeleteBuffers(GLsizei n, const GLuint* buffers);
 typedef void    eden_opengl_glNamedBufferStorage(GLuint buffer, GLsizeiptr size, const void* data, GLbitfield flags);
 typedef void    eden_opengl_glCreateVertexArrays(GLsizei n, GLuint* arrays);
 typedef void    eden_opengl_glVertexArrayVertexBuffer(GLuint vaobj, GLuint bindingindex, GLuint buffer, GLintptr offset, GLsizei stride);
@@ -153,6 +165,12 @@ typedef void    eden_opengl_glBindVertexArray(GLuint array);
 typedef void    eden_opengl_glDrawElements(GLenum mode, GLsizei count, GLenum type, const void* indices);
 typedef void    eden_opengl_glClearDepth(GLdouble depth);
 typedef GLenum  eden_opengl_glGetError();
+typedef void    eden_opengl_glNamedBufferData(GLuint buffer, GLsizeiptr size, const void* data, GLenum usage);
+typedef void*   eden_opengl_glMapNamedBufferRange(GLuint buffer, GLintptr offset, GLsizeiptr length, GLbitfield access);
+typedef GLboolean eden_opengl_glUnmapNamedBuffer(GLuint buffer);
+typedef GLsync  eden_opengl_glFenceSync(GLenum condition, GLbitfield flags);
+typedef GLenum  eden_opengl_glClientWaitSync(GLsync sync, GLbitfield flags, GLuint64 timeout);
+typedef void    eden_opengl_glDeleteSync(GLsync sync);
 
 
 enum{ 
@@ -251,26 +269,52 @@ enum eden_opengl_draw_mode_t
   EDEN_GFX_OPENGL_DRAW_MODE_TRIANGLES,
 };
 
+// @note: One vertex as the batch shader sees it.
+// Everything a vertex needs is kept together so that a flush is one
+// contiguous range in one buffer.
+struct eden_opengl_vertex_t 
+{
+  v3f_t pos;    // shader location = 0
+  v2f_t uv;     // shader location = 1
+  rgba_t color; // shader location = 2
+};
+
+// @note: How many frames the CPU can be ahead of the GPU.
+// Each frame writes its vertices into its own region of the vertex buffer.
+#define EDEN_OPENGL_MAX_FRAMES_IN_FLIGHT 4
+
+// @note: in nanoseconds
+#define EDEN_OPENGL_FENCE_TIMEOUT 1000000000ull
+
 struct eden_opengl_batch_t 
 {
   // @note: how many elements we are supposed to have.
   // based on this number, we will decide how big out buffers will be
   usz_t element_count;
 
-  v3f_t* vertices;
-  v2f_t* uvs;
-  rgba_t* colors;
-  usz_t vertex_count;
+  // @note: where this frame's vertices are written to. 
+  // Points into 'mapped' if the buffer is persistently mapped,
+  // otherwise it points to 'staging'.
+  eden_opengl_vertex_t* vertices;
+  usz_t vertex_count; // per frame
 
   u32_t* indices;
   usz_t index_count;
 
   GLuint vao;
-  GLuint vbo_vertices;
-  GLuint vbo_uvs;
-  GLuint vbo_colors;
+  GLuint vbo;
   GLuint vbo_indices;
 
+  // streaming
+  b32_t is_persistent;
+  eden_opengl_vertex_t* mapped; // all regions, if persistent
+  eden_opengl_vertex_t* staging; // if not persistent
+  u32_t frames_in_flight;
+  u32_t frame_index;
+  u32_t region_index;
+  GLsync fences[EDEN_OPENGL_MAX_FRAMES_IN_FLIGHT];
+  u32_t fence_wait_count; // times we had to wait on the GPU
+
   GLuint shader;
   GLuint current_texture;
 
@@ -287,6 +331,7 @@ struct eden_opengl_batch_t
 static_assert(sizeof(v3f_t) == sizeof(GLfloat)*3);
 static_assert(sizeof(v2f_t) == sizeof(GLfloat)*2);
 static_assert(sizeof(rgba_t) == sizeof(GLfloat)*4);
+static_assert(sizeof(eden_opengl_vertex_t) == sizeof(GLfloat)*9);
 
 struct eden_opengl_t 
 {
@@ -310,6 +355,10 @@ struct eden_opengl_t
   eden_opengl_texture_t dummy_texture;
   eden_opengl_texture_t blank_texture;
 
+  // stats for the last frame
+  u32_t flush_count; // times the batch was broken up
+  u32_t draw_count;  // actual draw calls
+
   eden_opengl_glEnable* glEnable;
   eden_opengl_glDisable* glDisable;
   eden_opengl_glViewport* glViewport;
@@ -322,6 +371,7 @@ struct eden_opengl_t
   eden_opengl_glClear* glClear;
   eden_opengl_glClearColor* glClearColor;
   eden_opengl_glCreateBuffers* glCreateBuffers;
+  eden_opengl_glDeleteBuffers* glDeleteBuffers;
   eden_opengl_glNamedBufferStorage* glNamedBufferStorage;
   eden_opengl_glCreateVertexArrays* glCreateVertexArrays;
   eden_opengl_glVertexArrayVertexBuffer* glVertexArrayVertexBuffer;
@@ -363,6 +413,15 @@ struct eden_opengl_t
   eden_opengl_glDrawElements* glDrawElements;
   eden_opengl_glGetError* glGetError;
   eden_opengl_glBufferSubData* glBufferSubData;
+  eden_opengl_glNamedBufferData* glNamedBufferData;
+
+  // @note: optional; without these we fall back to orphaning the
+  // vertex buffer every frame.
+  eden_opengl_glMapNamedBufferRange* glMapNamedBufferRange;
+  eden_opengl_glUnmapNamedBuffer* glUnmapNamedBuffer;
+  eden_opengl_glFenceSync* glFenceSync;
+  eden_opengl_glClientWaitSync* glClientWaitSync;
+  eden_opengl_glDeleteSync* glDeleteSync;
 
   void* platform_data;
 };
@@ -50,3 +50,198 @@ eden_get_input_characters() {
 
   return ret;
 }
+
+//
+// @mark: Input recording and playback
+//
+static_assert(EDEN_BUTTON_CODE_MAX <= 128);
+static_assert(array_count(((eden_input_t*)0)->chars) <= 255);
+
+static void
+eden_input_recorder_init(eden_input_recorder_t* rec, buf_t memory) 
+{
+  stream_init(&rec->stream, memory);
+  rec->frame_count = 0;
+  rec->is_full = false;
+  rec->last = {};
+
+  // @note: header is filled in when we save
+  eden_input_record_header_t header = {};
+  if (memory.size >= sizeof(header))
+    stream_write_block(&rec->stream, &header, sizeof(header));
+  else 
+    rec->is_full = true;
+}
+
+// Returns false if there is no more space to record
+static b32_t
+eden_input_recorder_record(eden_input_recorder_t* rec, eden_input_t* input) 
+{
+  if (rec->is_full) return false;
+
+  u8_t flags = 0;
+  u8_t changed_buttons[EDEN_BUTTON_CODE_MAX];
+  u8_t changed_button_count = 0;
+  for (u32_t code = 0; code < EDEN_BUTTON_CODE_MAX; ++code) {
+    if (input->buttons[code].now != rec->last.buttons[code].now) 
+      changed_buttons[changed_button_count++] = (u8_t)(code | (input->buttons[code].now << 7));
+  }
+  if (changed_button_count) 
+    flags |= EDEN_INPUT_RECORD_FLAG_BUTTONS;
+  if (input->mouse_pos.x != rec->last.mouse_pos.x || input->mouse_pos.y != rec->last.mouse_pos.y)
+    flags |= EDEN_INPUT_RECORD_FLAG_MOUSE_POS;
+  if (input->mouse_scroll_delta != 0)
+    flags |= EDEN_INPUT_RECORD_FLAG_SCROLL;
+  if (input->char_count != 0)
+    flags |= EDEN_INPUT_RECORD_FLAG_CHARS;
+  if (input->delta_time != rec->last.delta_time)
+    flags |= EDEN_INPUT_RECORD_FLAG_DELTA_TIME;
+
+  // worst case size of this record
+  usz_t size = 1 + 1 + changed_button_count + sizeof(v2f_t) + sizeof(s32_t) + 1 + input->char_count + sizeof(f32_t);
+  if (rec->stream.pos + size > rec->stream.contents.size) {
+    rec->is_full = true;
+    return false;
+  }
+
+  stream_write_block(&rec->stream, &flags, 1);
+  if (flags & EDEN_INPUT_RECORD_FLAG_BUTTONS) {
+    stream_write_block(&rec->stream, &changed_button_count, 1);
+    stream_write_block(&rec->stream, changed_buttons, changed_button_count);
+  }
+  if (flags & EDEN_INPUT_RECORD_FLAG_MOUSE_POS) {
+    stream_write_block(&rec->stream, &input->mouse_pos.x, sizeof(f32_t));
+    stream_write_block(&rec->stream, &input->mouse_pos.y, sizeof(f32_t));
+  }
+  if (flags & EDEN_INPUT_RECORD_FLAG_SCROLL) {
+    stream_write_block(&rec->stream, &input->mouse_scroll_delta, sizeof(s32_t));
+  }
+  if (flags & EDEN_INPUT_RECORD_FLAG_CHARS) {
+    u8_t char_count = (u8_t)input->char_count;
+    stream_write_block(&rec->stream, &char_count, 1);
+    stream_write_block(&rec->stream, input->chars, char_count);
+  }
+  if (flags & EDEN_INPUT_RECORD_FLAG_DELTA_TIME) {
+    stream_write_block(&rec->stream, &input->delta_time, sizeof(f32_t));
+  }
+
+  rec->last = *input;
+  ++rec->frame_count;
+  return true;
+}
+
+// @note: The recording is the stream's memory from the start to 'pos'.
+static buf_t
+eden_input_recorder_get_recording(eden_input_recorder_t* rec) 
+{
+  eden_input_record_header_t header = {};
+  header.signature = EDEN_INPUT_RECORD_SIGNATURE;
+  header.version = EDEN_INPUT_RECORD_VERSION;
+  header.button_count = EDEN_BUTTON_CODE_MAX;
+  header.frame_count = rec->frame_count;
+  memory_copy(rec->stream.contents.e, &header, sizeof(header));
+
+  return buf_set(rec->stream.contents.e, rec->stream.pos);
+}
+
+static b32_t
+eden_input_recorder_save(eden_input_recorder_t* rec, const char* filename) 
+{
+  if (rec->stream.contents.size < sizeof(eden_input_record_header_t))
+    return false;
+  return file_write_from_buffer(filename, eden_input_recorder_get_recording(rec));
+}
+
+static b32_t
+eden_input_player_init(eden_input_player_t* player, buf_t recording)
+{
+  stream_init(&player->stream, recording);
+  player->frame_index = 0;
+  player->frame_count = 0;
+  player->last = {};
+
+  auto* header = stream_consume(eden_input_record_header_t, &player->stream);
+  if (!header ||
+      header->signature != EDEN_INPUT_RECORD_SIGNATURE || 
+      header->version != EDEN_INPUT_RECORD_VERSION ||
+      header->button_count != EDEN_BUTTON_CODE_MAX)
+  {
+    return false;
+  }
+  player->frame_count = header->frame_count;
+  return true;
+}
+
+static b32_t
+eden_input_player_load(eden_input_player_t* player, const char* filename, arena_t* arena)
+{
+  buf_t recording = file_read_into_buffer(filename, arena);
+  if (!buf_valid(recording)) 
+    return false;
+  return eden_input_player_init(player, recording);
+}
+
+static b32_t
+eden_input_player_is_done(eden_input_player_t* player)
+{
+  return player->frame_index >= player->frame_count;
+}
+
+// Overwrites 'input' with the next frame's input, the same way the 
+// platform would have updated it. Returns false if there is nothing 
+// left to play or if the recording is broken.
+static b32_t
+eden_input_player_play(eden_input_player_t* player, eden_input_t* input) 
+{
+  if (eden_input_player_is_done(player)) return false;
+
+  stream_t* s = &player->stream;
+  eden_input_t* last = &player->last;
+
+  u8_t* flags = stream_consume(u8_t, s);
+  if (!flags) return false;
+
+  for (u32_t code = 0; code < EDEN_BUTTON_CODE_MAX; ++code) 
+    last->buttons[code].before = last->buttons[code].now;
+  last->mouse_scroll_delta = 0;
+  last->char_count = 0;
+
+  if (*flags & EDEN_INPUT_RECORD_FLAG_BUTTONS) {
+    u8_t* count = stream_consume(u8_t, s);
+    u8_t* changes = count ? stream_consume_block(s, *count) : nullptr;
+    if (!changes) return false;
+    for (u32_t i = 0; i < *count; ++i) {
+      u32_t code = changes[i] & 0x7F;
+      if (code >= EDEN_BUTTON_CODE_MAX) return false;
+      last->buttons[code].now = changes[i] >> 7;
+    }
+  }
+  if (*flags & EDEN_INPUT_RECORD_FLAG_MOUSE_POS) {
+    f32_t* pos = (f32_t*)stream_consume_block(s, sizeof(f32_t)*2);
+    if (!pos) return false;
+    memory_copy(&last->mouse_pos.x, pos + 0, sizeof(f32_t));
+    memory_copy(&last->mouse_pos.y, pos + 1, sizeof(f32_t));
+  }
+  if (*flags & EDEN_INPUT_RECORD_FLAG_SCROLL) {
+    u8_t* delta = stream_consume_block(s, sizeof(s32_t));
+    if (!delta) return false;
+    memory_copy(&last->mouse_scroll_delta, delta, sizeof(s32_t));
+  }
+  if (*flags & EDEN_INPUT_RECORD_FLAG_CHARS) {
+    u8_t* count = stream_consume(u8_t, s);
+    if (!count || *count > array_count(last->chars)) return false;
+    u8_t* chars = stream_consume_block(s, *count);
+    if (!chars) return false;
+    memory_copy(last->chars, chars, *count);
+    last->char_count = *count;
+  }
+  if (*flags & EDEN_INPUT_RECORD_FLAG_DELTA_TIME) {
+    u8_t* dt = stream_consume_block(s, sizeof(f32_t));
+    if (!dt) return false;
+    memory_copy(&last->delta_time, dt, sizeof(f32_t));
+  }
+
+  *input = *last;
+  ++player->frame_index;
+  return true;
+}
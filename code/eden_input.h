@@ -100,3 +100,54 @@ struct eden_input_t {
   // @todo(Momo): not sure if this should even be here
   f32_t delta_time; //aka dt
 };
+
+//
+// Input recording and playback
+//
+// @note: For the platform layer. A recording is a header followed by 
+// one record per frame, and each record only has what changed since
+// the frame before:
+//
+//   u8 flags                                     (eden_input_record_flag_t)
+//   u8 count, count * u8 (code | now << 7)       if BUTTONS
+//   f32 x, f32 y                                 if MOUSE_POS
+//   s32 delta                                    if SCROLL
+//   u8 count, count * u8                         if CHARS
+//   f32 delta_time                               if DELTA_TIME
+//
+// so a frame where nothing happens is one byte. 
+//
+// The recorder and the player both start from a zeroed eden_input_t,
+// so a recording should start on the app's first frame.
+//
+#define EDEN_INPUT_RECORD_SIGNATURE  u32_endian_swap(0x45494E50) // 'EINP'
+#define EDEN_INPUT_RECORD_VERSION    1
+
+enum eden_input_record_flag_t {
+  EDEN_INPUT_RECORD_FLAG_BUTTONS    = (1 << 0),
+  EDEN_INPUT_RECORD_FLAG_MOUSE_POS  = (1 << 1),
+  EDEN_INPUT_RECORD_FLAG_SCROLL     = (1 << 2),
+  EDEN_INPUT_RECORD_FLAG_CHARS      = (1 << 3),
+  EDEN_INPUT_RECORD_FLAG_DELTA_TIME = (1 << 4),
+};
+
+struct eden_input_record_header_t {
+  u32_t signature;
+  u32_t version;
+  u32_t button_count; // EDEN_BUTTON_CODE_MAX of whoever recorded
+  u32_t frame_count;
+};
+
+struct eden_input_recorder_t {
+  stream_t stream;
+  u32_t frame_count;
+  b32_t is_full; // stops recording
+  eden_input_t last;
+};
+
+struct eden_input_player_t {
+  stream_t stream;
+  u32_t frame_count;
+  u32_t frame_index;
+  eden_input_t last;
+};
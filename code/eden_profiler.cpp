@@ -6,18 +6,19 @@ _eden_profiler_init_block(
     const char* filename, 
     u32_t line,
     const char* function_name,
-    const char* block_name = 0) 
+    const char* block_name) 
 {
-  if (p->entry_count < p->entry_cap) {
-    eden_profiler_entry_t* entry = p->entries + p->entry_count++;
+  // @note: any thread can get here first
+  u32_t entry_index = u32_atomic_add(&p->entry_count, 1);
+  if (entry_index < p->entry_cap) {
+    eden_profiler_entry_t* entry = p->entries + entry_index;
     entry->filename = filename;
     entry->block_name = block_name ? block_name : function_name;
     entry->line = line;
-    entry->start_cycles = (u32_t)clock_time();
-    entry->start_hits = 1;
     entry->flag_for_reset = false;
     return entry;
   }
+  u32_atomic_add(&p->entry_count, (u32_t)-1);
 
   return nullptr;
 }
@@ -53,19 +54,138 @@ eden_profiler_end_stat(eden_profiler_stat_t* stat) {
   }
 }
 
+//
+// @mark: Tracing
+//
+
+// @note: Each module that includes eden has its own copy of these, 
+// so a thread that profiles in both the app and the platform has a
+// ring for each. They have the same os_thread_id so the trace shows 
+// them as one thread.
+static thread_local eden_profiler_t* _eden_profiler_thread_owner = nullptr;
+static thread_local eden_profiler_thread_t* _eden_profiler_thread = nullptr;
+
+static eden_profiler_thread_t*
+_eden_profiler_claim_thread(eden_profiler_t* p) 
+{
+  eden_profiler_thread_t* ret = nullptr;
+  if (p->event_cap > 0) {
+    u32_t thread_index = u32_atomic_add(&p->thread_count, 1);
+    if (thread_index < p->thread_cap) {
+      ret = p->threads + thread_index;
+      ret->os_thread_id = thread_get_id();
+    }
+  }
+
+  // @note: threads that don't get a ring never ask again
+  _eden_profiler_thread_owner = p;
+  _eden_profiler_thread = ret;
+  return ret;
+}
+
+static inline eden_profiler_thread_t*
+_eden_profiler_get_thread(eden_profiler_t* p) 
+{
+  if (_eden_profiler_thread_owner == p) 
+    return _eden_profiler_thread;
+  return _eden_profiler_claim_thread(p);
+}
+
+static u32_t
+eden_profiler_get_thread_count(eden_profiler_t* p) {
+  return min_of(u32_atomic_load(&p->thread_count), p->thread_cap);
+}
+
+// @note: Only when nobody is profiling. The threads keep their rings.
 static void
+eden_profiler_clear_trace(eden_profiler_t* p) {
+  u32_t thread_count = eden_profiler_get_thread_count(p);
+  for (u32_t thread_index = 0; thread_index < thread_count; ++thread_index) {
+    eden_profiler_thread_t* t = p->threads + thread_index;
+    t->event_count = 0;
+    t->dropped_count = 0;
+  }
+  p->frame_count = 0;
+  p->start_cycles = clock_cycles();
+  p->start_time = clock_time();
+}
+
+static void 
+eden_profiler_mark_frame(eden_profiler_t* p) 
+{
+  eden_profiler_thread_t* t = _eden_profiler_get_thread(p);
+  ++p->frame_count;
+  if (!t) return;
+
+  eden_profiler_event_t* e = t->events + (t->event_count++ & (p->event_cap - 1));
+  e->begin = e->end = clock_cycles();
+  e->name = nullptr;
+  e->parent = U64_MAX;
+  e->depth = 0;
+}
+
+static f64_t
+eden_profiler_get_cycles_per_second(eden_profiler_t* p) 
+{
+  u64_t cycles = clock_cycles() - p->start_cycles;
+  u64_t time = clock_time() - p->start_time;
+  if (time == 0) return (f64_t)clock_resolution();
+  return (f64_t)cycles * (f64_t)clock_resolution() / (f64_t)time;
+}
+
+//
+// @mark: Blocks
+//
+static eden_profiler_scope_t
 _eden_profiler_begin_block(eden_profiler_t* p, eden_profiler_entry_t* entry) 
 {
-  entry->start_cycles = (u32_t)clock_time();
-  entry->start_hits = 1;
+  eden_profiler_scope_t ret;
+  ret.thread = entry ? _eden_profiler_get_thread(p) : nullptr;
+  ret.event = U64_MAX;
+
+  eden_profiler_event_t* e = nullptr;
+  if (ret.thread) {
+    eden_profiler_thread_t* t = ret.thread;
+    ret.event = t->event_count++;
+    ret.parent = t->open_event;
+    e = t->events + (ret.event & (p->event_cap - 1));
+    e->end = 0;
+    e->name = entry->block_name;
+    e->parent = ret.parent;
+    e->depth = t->depth++;
+    t->open_event = ret.event;
+  }
+
+  ret.begin = clock_cycles();
+  if (e) e->begin = ret.begin;
+  return ret;
 }
 
 static void
-_eden_profiler_end_block(eden_profiler_t* p, eden_profiler_entry_t* entry) {
-  u64_t delta = ((u32_t)clock_time() - entry->start_cycles) | ((u64_t)(entry->start_hits)) << 32;
-  u64_atomic_add(&entry->hits_and_cycles, delta);
+_eden_profiler_end_block(eden_profiler_t* p, eden_profiler_entry_t* entry, eden_profiler_scope_t* scope) 
+{
+  u64_t end = clock_cycles();
+  if (!entry) return;
+
+  u64_atomic_add(&entry->cycles, end - scope->begin);
+  u64_atomic_add(&entry->hits, 1);
+
+  eden_profiler_thread_t* t = scope->thread;
+  if (t) {
+    --t->depth;
+    t->open_event = scope->parent;
+    if (t->event_count - scope->event <= p->event_cap) 
+      t->events[scope->event & (p->event_cap - 1)].end = end;
+    else 
+      ++t->dropped_count;
+  }
 }
 
+static void
+_eden_profiler_count(eden_profiler_t* p, eden_profiler_entry_t* entry, u32_t amount) {
+  if (!entry) return;
+  u64_atomic_add(&entry->hits, amount);
+}
 
 static void 
 eden_profiler_reset(eden_profiler_t* p) {
@@ -79,23 +199,48 @@ eden_profiler_reset(eden_profiler_t* p) {
   p->entry_count = 0;
 }
 
+// @note: 'max_events_per_thread' is rounded up to a power of 2. 
+// Tracing is off if it or 'max_threads' is 0.
 static b32_t 
 eden_profiler_init(
     eden_profiler_t* p, 
     arena_t* arena,
     u32_t max_entries,
-    u32_t max_snapshots_per_entry)
+    u32_t max_snapshots_per_entry,
+    u32_t max_threads,
+    u32_t max_events_per_thread)
 {
   p->entry_cap = max_entries;
   p->entry_snapshot_count = max_snapshots_per_entry;
-  p->entries = arena_push_arr(eden_profiler_entry_t, arena, p->entry_cap);
+  p->entries = arena_push_arr_zero(eden_profiler_entry_t, arena, p->entry_cap);
   if (!p->entries) return false;
 
   for (u32_t i = 0; i < p->entry_cap; ++i) {
-    p->entries[i].snapshots = arena_push_arr(eden_profiler_snapshot_t, arena, max_snapshots_per_entry);
+    p->entries[i].snapshots = arena_push_arr_zero(eden_profiler_snapshot_t, arena, max_snapshots_per_entry);
     if(!p->entries[i].snapshots) return false;
   }
   eden_profiler_reset(p);
+
+  p->thread_count = 0;
+  p->thread_cap = 0;
+  p->event_cap = 0;
+  p->threads = nullptr;
+  if (max_threads > 0 && max_events_per_thread > 0) {
+    u32_t event_cap = 1;
+    while (event_cap < max_events_per_thread) event_cap <<= 1;
+
+    p->threads = arena_push_arr_zero(eden_profiler_thread_t, arena, max_threads);
+    if (!p->threads) return false;
+    for (u32_t i = 0; i < max_threads; ++i) {
+      p->threads[i].open_event = U64_MAX;
+      p->threads[i].events = arena_push_arr(eden_profiler_event_t, arena, event_cap);
+      if (!p->threads[i].events) return false;
+    }
+    p->thread_cap = max_threads;
+    p->event_cap = event_cap;
+  }
+  eden_profiler_clear_trace(p);
+
   return true;
 }
 
@@ -105,12 +250,9 @@ eden_profiler_update_entries(eden_profiler_t* p) {
   for(u32_t entry_id = 0; entry_id < p->entry_count; ++entry_id)
   {
     eden_profiler_entry_t* itr = p->entries + entry_id;
-    u64_t hits_and_cycles = u64_atomic_assign(&itr->hits_and_cycles, 0);
-    u32_t hits = (u32_t)(hits_and_cycles >> 32);
-    u32_t cycles = (u32_t)(hits_and_cycles & 0xFFFFFFFF);
     
-    itr->snapshots[p->snapshot_index].hits = hits;
-    itr->snapshots[p->snapshot_index].cycles = cycles;
+    itr->snapshots[p->snapshot_index].hits = u64_atomic_assign(&itr->hits, 0);
+    itr->snapshots[p->snapshot_index].cycles = u64_atomic_assign(&itr->cycles, 0);
   }
   ++p->snapshot_index;
   if(p->snapshot_index >= p->entry_snapshot_count) {
@@ -118,6 +260,106 @@ eden_profiler_update_entries(eden_profiler_t* p) {
   }
 }
 
+//
+// @mark: Chrome trace export
+//
+// @note: Writes the Trace Event Format that chrome://tracing and 
+// ui.perfetto.dev open. Blocks are complete ("X") events and frame
+// markers are global instant ("i") events. Only events still in the 
+// rings are written, so this is the last few frames of every thread.
+//
+// Like reading the rings, only call this when nobody is profiling.
+//
+struct _eden_profiler_trace_writer_t {
+  file_t file;
+  usz_t offset;
+  bufio_t buffer;
+  b32_t is_ok;
+};
+
+static void
+_eden_profiler_trace_flush(_eden_profiler_trace_writer_t* w) {
+  if (w->is_ok && w->buffer.str.size > 0) {
+    w->is_ok = file_write(&w->file, w->buffer.str.e, w->buffer.str.size, w->offset);
+    w->offset += w->buffer.str.size;
+  }
+  bufio_clear(&w->buffer);
+}
+
+// @note: Chrome wants microseconds; we give it nanosecond precision.
+static void
+_eden_profiler_trace_push_us(bufio_t* b, f64_t ns) {
+  u64_t whole_ns = (u64_t)(ns + 0.5);
+  bufio_push_u64(b, whole_ns / 1000);
+  bufio_push_c8(b, '.');
+  u32_t frac = (u32_t)(whole_ns % 1000);
+  bufio_push_c8(b, (c8_t)('0' + frac / 100));
+  bufio_push_c8(b, (c8_t)('0' + (frac / 10) % 10));
+  bufio_push_c8(b, (c8_t)('0' + frac % 10));
+}
+
+static b32_t
+eden_profiler_export_trace(eden_profiler_t* p, const char* filename, arena_t* arena) 
+{
+  arena_set_revert_point(arena);
+
+  _eden_profiler_trace_writer_t w = {};
+  buf_t memory = arena_push_buffer(arena, kilobytes(64));
+  if (!buf_valid(memory)) return false;
+  bufio_init(&w.buffer, memory);
+  if (!file_open(&w.file, filename, FILE_ACCESS_CREATE)) return false;
+  defer { file_close(&w.file); };
+  w.is_ok = true;
+
+  f64_t ns_per_cycle = 1000000000.0 / eden_profiler_get_cycles_per_second(p);
+  const usz_t max_event_size = 256;
+  b32_t is_first = true;
+
+  bufio_push_cstr(&w.buffer, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+
+  u32_t thread_count = eden_profiler_get_thread_count(p);
+  for (u32_t thread_index = 0; thread_index < thread_count; ++thread_index) {
+    eden_profiler_thread_t* t = p->threads + thread_index;
+
+    u64_t first_event = t->event_count > p->event_cap ? t->event_count - p->event_cap : 0;
+    for (u64_t event_index = first_event; event_index < t->event_count; ++event_index) {
+      eden_profiler_event_t* e = t->events + (event_index & (p->event_cap - 1));
+
+      // still open, or from before the last clear
+      if (e->end < e->begin || e->begin < p->start_cycles) continue; 
+
+      if (bufio_remaining(&w.buffer) < max_event_size) 
+        _eden_profiler_trace_flush(&w);
+
+      if (!is_first) bufio_push_cstr(&w.buffer, ",\n");
+      is_first = false;
+
+      if (e->name) {
+        bufio_push_cstr(&w.buffer, "{\"name\":\"");
+        bufio_push_cstr(&w.buffer, e->name);
+        bufio_push_cstr(&w.buffer, "\",\"ph\":\"X\",\"ts\":");
+        _eden_profiler_trace_push_us(&w.buffer, (f64_t)(e->begin - p->start_cycles) * ns_per_cycle);
+        bufio_push_cstr(&w.buffer, ",\"dur\":");
+        _eden_profiler_trace_push_us(&w.buffer, (f64_t)(e->end - e->begin) * ns_per_cycle);
+        bufio_push_cstr(&w.buffer, ",\"args\":{\"depth\":");
+        bufio_push_u32(&w.buffer, e->depth);
+        bufio_push_cstr(&w.buffer, "}");
+      }
+      else {
+        bufio_push_cstr(&w.buffer, "{\"name\":\"frame\",\"ph\":\"i\",\"s\":\"g\",\"ts\":");
+        _eden_profiler_trace_push_us(&w.buffer, (f64_t)(e->begin - p->start_cycles) * ns_per_cycle);
+      }
+      bufio_push_cstr(&w.buffer, ",\"pid\":1,\"tid\":");
+      bufio_push_u32(&w.buffer, t->os_thread_id);
+      bufio_push_cstr(&w.buffer, "}");
+    }
+  }
+  bufio_push_cstr(&w.buffer, "\n]}\n");
+  _eden_profiler_trace_flush(&w);
+
+  return w.is_ok;
+}
+
 static void 
 eden_profile_update_and_render(
     f32_t font_height,
@@ -1,8 +1,8 @@
 #if EDEN_DEBUG
 struct eden_profiler_snapshot_t 
 {
-  u32_t hits;
-  u32_t cycles;
+  u64_t hits;
+  u64_t cycles;
 };
 
 struct eden_profiler_stat_t 
@@ -18,19 +18,58 @@ struct eden_profiler_entry_t
   u32_t line;
   const char* filename;
   const char* block_name;
-  u64_t hits_and_cycles;
+
+  // @note: Added to atomically by whichever thread runs the block, and
+  // taken out every frame by eden_profiler_update_entries().
+  u64_t cycles;
+  u64_t hits;
   
   eden_profiler_snapshot_t* snapshots;
-  
-  // @note: For initialization of entry. 
-  // Maybe it shouldn't be stored here
-  // but on where they called it? 
-  // i.e. use a functor that wraps?
-  u32_t start_cycles;
-  u32_t start_hits;
   b32_t flag_for_reset;
 };
 
+//
+// Tracing
+//
+// @note: Every thread that profiles claims a ring of events the first 
+// time it begins a block, so recording never needs a lock. Each block 
+// is an event that is claimed when it begins and filled in when it ends.
+// Events know their parent, so a thread's events form a tree.
+// Frame markers are events without a name.
+// 
+// The rings must only be read when no other thread is profiling, 
+// e.g. at the end of a frame after all tasks are done.
+//
+struct eden_profiler_event_t 
+{
+  u64_t begin;        // clock_cycles()
+  u64_t end;          // 0 if the block has not ended
+  const char* name;   // nullptr for frame markers
+  u64_t parent;       // event number of the parent, U64_MAX if none
+  u32_t depth;        // 0 for blocks without a parent
+};
+
+struct eden_profiler_thread_t 
+{
+  u32_t os_thread_id;
+  u32_t depth;
+  u64_t open_event;     // event number of the innermost block, U64_MAX if none
+
+  // @note: events are numbered from 0 and the ring holds the last
+  // 'event_cap' of them. 
+  u64_t event_count; 
+  u64_t dropped_count;  // blocks that ended after their event was overwritten
+  eden_profiler_event_t* events;
+};
+
+// @note: Lives on the stack of whoever is running the block
+struct eden_profiler_scope_t 
+{
+  u64_t begin;
+  u64_t event;
+  u64_t parent;
+  eden_profiler_thread_t* thread;
+};
 
 struct eden_profiler_t {
   u32_t entry_snapshot_count;
@@ -38,6 +77,17 @@ struct eden_profiler_t {
   u32_t entry_cap;
   eden_profiler_entry_t* entries;
   u32_t snapshot_index;
+
+  // tracing
+  u32_t thread_count;         // claimed so far; can go past thread_cap
+  u32_t thread_cap;
+  u32_t event_cap;            // per thread, power of 2; 0 means no tracing
+  eden_profiler_thread_t* threads;
+  u32_t frame_count;
+
+  // @note: for converting clock_cycles() into time
+  u64_t start_cycles;
+  u64_t start_time;
 };
 
 #define eden_profile_begin(name) \
@@ -45,19 +95,41 @@ struct eden_profiler_t {
   if (_profiler_block_##name == 0 || _profiler_block_##name->flag_for_reset) {\
     _profiler_block_##name = _eden_profiler_init_block(&eden->profiler, __FILE__, __LINE__, __FUNCTION__, #name);  \
   }\
-  _eden_profiler_begin_block(&eden->profiler, _profiler_block_##name)\
+  eden_profiler_scope_t _profiler_scope_##name = _eden_profiler_begin_block(&eden->profiler, _profiler_block_##name)
 
 #define eden_profile_end(name) \
-  _eden_profiler_end_block(&eden->profiler, _profiler_block_##name) 
+  _eden_profiler_end_block(&eden->profiler, _profiler_block_##name, &_profiler_scope_##name) 
 
 #define eden_profile_block(name) \
   eden_profile_begin(name); \
   defer {eden_profile_end(name);} 
 
+// @note: For things that are counted instead of timed, 
+// like draw calls. The amount shows up as hits.
+#define eden_profile_count(name, amount) \
+  static eden_profiler_entry_t* _profiler_count_##name = 0; \
+  if (_profiler_count_##name == 0 || _profiler_count_##name->flag_for_reset) {\
+    _profiler_count_##name = _eden_profiler_init_block(&eden->profiler, __FILE__, __LINE__, __FUNCTION__, #name);  \
+  }\
+  _eden_profiler_count(&eden->profiler, _profiler_count_##name, amount)
+
+// @note: Call once at the start of every frame, from the main thread 
+#define eden_profile_frame() \
+  eden_profiler_mark_frame(&eden->profiler)
+
+// @note: So that the macros can be used in files included before eden_profiler.cpp 
+static eden_profiler_entry_t* _eden_profiler_init_block(eden_profiler_t* p, const char* filename, u32_t line, const char* function_name, const char* block_name = 0);
+static eden_profiler_scope_t _eden_profiler_begin_block(eden_profiler_t* p, eden_profiler_entry_t* entry);
+static void _eden_profiler_end_block(eden_profiler_t* p, eden_profiler_entry_t* entry, eden_profiler_scope_t* scope);
+static void _eden_profiler_count(eden_profiler_t* p, eden_profiler_entry_t* entry, u32_t amount);
+static void eden_profiler_mark_frame(eden_profiler_t* p);
+
 #else
 
 #define eden_profile_begin(name) { #name; }
 #define eden_profile_end(name)
 #define eden_profile_block(name)
+#define eden_profile_count(name, amount)
+#define eden_profile_frame()
 
 #endif // EDEN_DEBUG
@@ -62,6 +62,28 @@ eden_draw_tri(v2f_t p0, v2f_t p1, v2f_t p2, rgba_t colors)
 }
 
 
+// @note: Only matters if draw sorting is enabled. 
+// Higher layers are drawn on top. Resets to 0 every frame.
+static void
+eden_set_layer(u32_t layer)
+{
+  eden_gfx_set_layer(&eden->gfx, layer);
+}
+
+// @note: Only matters if draw sorting is enabled.
+// Draw commands are never sorted across a barrier.
+static void
+eden_draw_barrier()
+{
+  eden_gfx_push_barrier_command(&eden->gfx);
+}
+
+static void
+eden_set_draw_sorting(b32_t enabled)
+{
+  eden->gfx.is_sorting_enabled = enabled;
+}
+
 static void
 eden_gfx_test() 
 {
@@ -0,0 +1,558 @@
+//
+// DESCRIPTION
+//   This is the eden engine on linux without a window, GPU or speakers.
+//
+//   It loads an app module, runs it for a fixed number of frames with a
+//   fixed delta time and as fast as it can, and writes how long every frame
+//   took and how many commands it pushed into a CSV file.
+//
+//   It can also record the input it gives the app, or replay input 
+//   recorded by any eden host. Every frame's commands are hashed, so a 
+//   replay can be used to check that a change didn't change what gets 
+//   drawn.
+//
+//   This is for profiling apps (perf, valgrind) and as a frame time
+//   regression check on machines without a display.
+//
+// USAGE
+//   lnx_eden_headless [options]
+//     -app <path>       app module to load (default: ./eden.so)
+//     -frames <n>       number of frames to run (default: 600)
+//     -dt <secs>        delta time of every frame (default: 1/target_frame_rate)
+//     -warmup <n>       frames to leave out of the summary (default: 0)
+//     -csv <path>       per-frame timings (default: headless.csv)
+//     -budget <ms>      fail if the 95th percentile frame takes longer than this
+//     -workers <n>      override the app's max_workers
+//     -record <path>    save the input of every frame
+//     -play <path>      replay recorded input; -dt is ignored and the
+//                       default number of frames is all of them
+//     -trace <path>     write the last frames as a Chrome trace (EDEN_DEBUG only)
+//
+//   The app module and this host have to agree on EDEN_DEBUG, e.g.
+//     g++ -std=c++17 -O2 -fPIC -shared -DEDEN_DEBUG=1 code/app_lit.cpp -o eden.so
+//     g++ -std=c++17 -O2 -DEDEN_DEBUG=1 code/lnx_eden_headless.cpp -o lnx_eden_headless -ldl -lpthread
+//
+//   Assets are loaded relative to the working directory, just like on w32.
+//
+
+#ifndef EDEN_USE_NULL_GFX
+# define EDEN_USE_NULL_GFX 1
+#endif
+
+#include <dlfcn.h>
+#include <stdio.h>
+#include <stdarg.h>
+
+#include "eden.h"
+
+//
+// @mark: State
+//
+struct lnx_headless_frame_t {
+  f64_t update_ms;  // eden_update_and_render()
+  f64_t audio_ms;   // mixing
+  f64_t gfx_ms;     // consuming the commands
+  f64_t total_ms;
+
+  u32_t command_count;
+  u32_t draw_count;
+  u32_t batch_count;
+  u64_t hash;
+};
+
+struct lnx_headless_state_t {
+  f32_t eden_width;
+  f32_t eden_height;
+
+  // @note: eden's tasks are run on momo's job system.
+  // Only the main thread adds tasks, so one counter is enough.
+  job_system_t jobs;
+  job_counter_t task_counter;
+
+  arena_t arena;
+};
+static lnx_headless_state_t* lnx_state;
+
+//
+// @mark: Options
+//
+struct lnx_headless_options_t {
+  const char* app_path;
+  const char* csv_path;
+  u32_t frame_count;
+  u32_t warmup_count;
+  f32_t delta_time;     // 0 means 1/target_frame_rate
+  f64_t budget_ms;      // 0 means no budget
+  u32_t worker_count;   // U32_MAX means whatever the app wants
+  const char* record_path;
+  const char* play_path;
+  const char* trace_path;
+  b32_t is_frame_count_set;
+};
+
+static b32_t
+lnx_headless_is_arg(const char* arg, const char* name) {
+  return cstr_len(arg) == cstr_len(name) && cstr_compare(arg, name);
+}
+
+static b32_t
+lnx_headless_parse_options(lnx_headless_options_t* opts, int argc, char** argv) {
+  opts->app_path = "./eden.so";
+  opts->csv_path = "headless.csv";
+  opts->frame_count = 600;
+  opts->warmup_count = 0;
+  opts->delta_time = 0.f;
+  opts->budget_ms = 0.0;
+  opts->worker_count = U32_MAX;
+  opts->record_path = nullptr;
+  opts->play_path = nullptr;
+  opts->trace_path = nullptr;
+  opts->is_frame_count_set = false;
+
+  for (int arg_index = 1; arg_index < argc; ++arg_index) {
+    const char* arg = argv[arg_index];
+
+    // every option has a value
+    if (arg_index + 1 >= argc) {
+      printf("[headless] missing value for %s\n", arg);
+      return false;
+    }
+    const char* value = argv[++arg_index];
+
+    if (lnx_headless_is_arg(arg, "-app")) opts->app_path = value;
+    else if (lnx_headless_is_arg(arg, "-csv")) opts->csv_path = value;
+    else if (lnx_headless_is_arg(arg, "-frames")) {
+      opts->frame_count = cstr_to_u32(value);
+      opts->is_frame_count_set = true;
+    }
+    else if (lnx_headless_is_arg(arg, "-warmup")) opts->warmup_count = cstr_to_u32(value);
+    else if (lnx_headless_is_arg(arg, "-dt")) opts->delta_time = (f32_t)cstr_to_f64(value);
+    else if (lnx_headless_is_arg(arg, "-budget")) opts->budget_ms = cstr_to_f64(value);
+    else if (lnx_headless_is_arg(arg, "-workers")) opts->worker_count = cstr_to_u32(value);
+    else if (lnx_headless_is_arg(arg, "-record")) opts->record_path = value;
+    else if (lnx_headless_is_arg(arg, "-play")) opts->play_path = value;
+    else if (lnx_headless_is_arg(arg, "-trace")) opts->trace_path = value;
+    else {
+      printf("[headless] unknown option %s\n", arg);
+      return false;
+    }
+  }
+
+  return true;
+}
+
+static b32_t
+lnx_headless_check_frame_count(lnx_headless_options_t* opts) {
+  if (opts->frame_count == 0 || opts->warmup_count >= opts->frame_count) {
+    printf("[headless] need more frames than warmup frames\n");
+    return false;
+  }
+  return true;
+}
+
+//
+// @mark: App functions
+//
+static
+eden_debug_log_sig(lnx_headless_log)
+{
+  va_list args;
+  va_start(args, fmt);
+  vprintf(fmt, args);
+  va_end(args);
+}
+
+static eden_show_cursor_sig(lnx_headless_show_cursor) {}
+static eden_hide_cursor_sig(lnx_headless_hide_cursor) {}
+static eden_lock_cursor_sig(lnx_headless_lock_cursor) {}
+static eden_unlock_cursor_sig(lnx_headless_unlock_cursor) {}
+
+static
+eden_set_design_dimensions_sig(lnx_headless_set_design_dimensions)
+{
+  assert(width > 0.f && height > 0.f);
+  lnx_state->eden_width = width;
+  lnx_state->eden_height = height;
+}
+
+static
+eden_add_task_sig(lnx_headless_add_task)
+{
+  job_add(&lnx_state->jobs, callback, data, &lnx_state->task_counter);
+}
+
+static
+eden_complete_all_tasks_sig(lnx_headless_complete_all_tasks)
+{
+  // @note: This makes the main thread participate in the work
+  // until every task added so far is done.
+  job_wait(&lnx_state->jobs, &lnx_state->task_counter);
+}
+
+//
+// @mark: Input
+//
+// @note: Nobody is pressing anything.
+//
+static void
+lnx_headless_update_input(eden_input_t* input, f32_t delta_time)
+{
+  for (u32_t i = 0; i < array_count(input->buttons); ++i)
+  {
+    input->buttons[i].before = input->buttons[i].now;
+  }
+  input->char_count = 0;
+  input->mouse_scroll_delta = 0;
+  input->delta_time = delta_time;
+}
+
+//
+// @mark: Audio
+//
+// @note: Mixes into a buffer that nobody listens to. We mix exactly
+// one frame worth of samples every frame so that runs are repeatable.
+//
+static b32_t
+lnx_headless_speaker_load(eden_speaker_t* speaker, eden_config_t* config, f32_t delta_time, arena_t* arena)
+{
+  if (!eden_speaker_init(speaker, config->speaker_bitrate_type, config->speaker_max_sounds, arena))
+    return false;
+
+  speaker->device_samples_per_second = config->speaker_samples_per_second;
+  speaker->device_bits_per_sample = config->speaker_bits_per_sample;
+  speaker->device_channels = config->speaker_channels;
+  speaker->sample_count = (u32_t)f32_ceil(config->speaker_samples_per_second * delta_time);
+
+  usz_t bytes_per_sample = speaker->device_bits_per_sample/8;
+  speaker->samples = arena_push_arr(u8_t, arena, speaker->sample_count * speaker->device_channels * bytes_per_sample);
+  return speaker->samples != nullptr;
+}
+
+//
+// @mark: Report
+//
+static b32_t
+lnx_headless_write_csv(const char* path, lnx_headless_frame_t* frames, u32_t frame_count)
+{
+  FILE* file = fopen(path, "w");
+  if (!file) return false;
+  defer { fclose(file); };
+
+  fprintf(file, "frame,update_ms,audio_ms,gfx_ms,total_ms,commands,draws,batches,hash\n");
+  for (u32_t frame_index = 0; frame_index < frame_count; ++frame_index) {
+    lnx_headless_frame_t* f = frames + frame_index;
+    fprintf(file, "%u,%.4f,%.4f,%.4f,%.4f,%u,%u,%u,%016llx\n",
+        frame_index, f->update_ms, f->audio_ms, f->gfx_ms, f->total_ms,
+        f->command_count, f->draw_count, f->batch_count, (unsigned long long)f->hash);
+  }
+  return true;
+}
+
+// Returns the 95th percentile of the total frame time
+static f64_t
+lnx_headless_print_summary(lnx_headless_frame_t* frames, u32_t frame_count, arena_t* arena)
+{
+  arena_set_revert_point(arena);
+  sort_entry_t* entries = arena_push_arr(sort_entry_t, arena, frame_count);
+  assert(entries);
+
+  f64_t sum_update = 0.0, sum_audio = 0.0, sum_gfx = 0.0, sum_total = 0.0;
+  u64_t sum_commands = 0;
+  u32_t max_commands = 0;
+  for (u32_t frame_index = 0; frame_index < frame_count; ++frame_index) {
+    lnx_headless_frame_t* f = frames + frame_index;
+    sum_update += f->update_ms;
+    sum_audio += f->audio_ms;
+    sum_gfx += f->gfx_ms;
+    sum_total += f->total_ms;
+    sum_commands += f->command_count;
+    max_commands = max_of(max_commands, f->command_count);
+
+    entries[frame_index].key = (f32_t)f->total_ms;
+    entries[frame_index].index = frame_index;
+  }
+  sort_radix(entries, frame_count, arena);
+
+  f64_t p50 = frames[entries[frame_count/2].index].total_ms;
+  f64_t p95 = frames[entries[(frame_count*95)/100].index].total_ms;
+  f64_t p99 = frames[entries[(frame_count*99)/100].index].total_ms;
+  f64_t max = frames[entries[frame_count-1].index].total_ms;
+
+  printf("[headless] %u frames\n", frame_count);
+  printf("[headless] mean (ms): update %.3f, audio %.3f, gfx %.3f, total %.3f\n",
+      sum_update/frame_count, sum_audio/frame_count, sum_gfx/frame_count, sum_total/frame_count);
+  printf("[headless] total (ms): p50 %.3f, p95 %.3f, p99 %.3f, max %.3f\n", p50, p95, p99, max);
+  printf("[headless] commands: mean %.1f, max %u\n", (f64_t)sum_commands/frame_count, max_commands);
+
+  return p95;
+}
+
+// @note: Hash of every frame's hash, warmup frames included. 
+// Same input and same output gives the same hash.
+static u64_t
+lnx_headless_hash_frames(lnx_headless_frame_t* frames, u32_t frame_count) 
+{
+  u64_t hash = hash_fnv1a_64(nullptr, 0);
+  for (u32_t frame_index = 0; frame_index < frame_count; ++frame_index) 
+    hash = hash_fnv1a_64(&frames[frame_index].hash, sizeof(u64_t), hash);
+  return hash;
+}
+
+static f64_t
+lnx_headless_ms_elapsed(u64_t start, u64_t end) {
+  return (f64_t)(end - start) * 1000.0 / clock_resolution();
+}
+
+//
+// @mark: Entry Point
+//
+int
+main(int argc, char** argv)
+{
+  lnx_headless_options_t opts;
+  if (!lnx_headless_parse_options(&opts, argc, argv))
+    return 1;
+
+  lnx_state = arena_alloc_bootstrap(lnx_headless_state_t, arena, gigabytes(1));
+  if (!lnx_state) return 1;
+  lnx_state->eden_width = 1.f;
+  lnx_state->eden_height = 1.f;
+  arena_t* platform_arena = &lnx_state->arena;
+
+  //
+  // Load eden functions
+  //
+  eden_functions_t eden_functions = {};
+  void* module = dlopen(opts.app_path, RTLD_NOW | RTLD_LOCAL);
+  if (!module) {
+    printf("[headless] cannot load %s: %s\n", opts.app_path, dlerror());
+    return 1;
+  }
+  defer { dlclose(module); };
+  for_arr(function_index, eden_function_names) {
+    void* function = dlsym(module, eden_function_names[function_index]);
+    if (!function) {
+      printf("[headless] cannot find %s in %s\n", eden_function_names[function_index], opts.app_path);
+      return 1;
+    }
+    ((void**)&eden_functions)[function_index] = function;
+  }
+
+  //
+  // Input recording
+  //
+  eden_input_player_t player = {};
+  if (opts.play_path) {
+    if (!eden_input_player_load(&player, opts.play_path, platform_arena)) {
+      printf("[headless] cannot load input recording from %s\n", opts.play_path);
+      return 1;
+    }
+    if (!opts.is_frame_count_set) 
+      opts.frame_count = player.frame_count;
+  }
+  if (!lnx_headless_check_frame_count(&opts))
+    return 1;
+
+  eden_input_recorder_t recorder = {};
+  if (opts.record_path) {
+    buf_t memory = arena_push_buffer(platform_arena, megabytes(64), 16);
+    if (!buf_valid(memory)) return 1;
+    eden_input_recorder_init(&recorder, memory);
+  }
+
+  eden_config_t config = eden_functions.get_config();
+  f32_t delta_time = opts.delta_time > 0.f ? opts.delta_time : 1.f/(f32_t)config.target_frame_rate;
+
+  eden_t* eden = arena_push_zero(eden_t, platform_arena);
+  if (!eden) return 1;
+  eden_globalize(eden);
+  eden->is_running = true;
+  eden->show_cursor = lnx_headless_show_cursor;
+  eden->lock_cursor = lnx_headless_lock_cursor;
+  eden->hide_cursor = lnx_headless_hide_cursor;
+  eden->unlock_cursor = lnx_headless_unlock_cursor;
+  eden->debug_log = lnx_headless_log;
+  eden->add_task = lnx_headless_add_task;
+  eden->complete_all_tasks = lnx_headless_complete_all_tasks;
+  eden->set_design_dimensions = lnx_headless_set_design_dimensions;
+
+  // @note: The main thread is a worker too, and there is no point
+  // having more workers than there are cores.
+  u32_t worker_count = opts.worker_count != U32_MAX ?
+    opts.worker_count :
+    min_of(config.max_workers, thread_get_hardware_count() - 1);
+  if (!job_system_init(&lnx_state->jobs, worker_count, 1024, platform_arena)) {
+    printf("[headless] cannot create job system\n");
+    return 1;
+  }
+  defer { job_system_free(&lnx_state->jobs); };
+
+  //
+  // Null gfx
+  //
+  auto* null_gfx = arena_alloc_bootstrap_zero(eden_null_gfx_t, arena, gigabytes(1));
+  if (!null_gfx) return 1;
+  eden->gfx.platform_data = null_gfx;
+  defer { arena_free(&null_gfx->arena); };
+  if (!eden_null_gfx_init(
+        eden,
+        config.texture_queue_size,
+        config.max_commands,
+        config.max_textures,
+        config.max_texture_payloads))
+  {
+    printf("[headless] cannot init gfx\n");
+    return 1;
+  }
+
+  if (config.speaker_enabled) {
+    if (!lnx_headless_speaker_load(&eden->speaker, &config, delta_time, platform_arena)) {
+      printf("[headless] cannot init speaker\n");
+      return 1;
+    }
+  }
+
+  //
+  // Init debug stuff
+  //
+#if EDEN_DEBUG
+  if (!eden_debug_init(&eden->debug))
+  {
+    printf("[headless] cannot init debugger\n");
+    return 1;
+  }
+
+  if (!eden_profiler_init(
+        &eden->profiler,
+        platform_arena,
+        config.profiler_max_entries,
+        config.profiler_max_snapshots_per_entry,
+        config.profiler_max_threads,
+        config.profiler_max_events_per_thread))
+  {
+    printf("[headless] cannot init profiler\n");
+    return 1;
+  }
+
+  if (!eden_inspector_init(
+        &eden->inspector,
+        platform_arena,
+        config.inspector_max_entries))
+  {
+    printf("[headless] cannot init inspector\n");
+    return 1;
+  }
+#endif // EDEN_DEBUG
+
+  lnx_headless_frame_t* frames = arena_push_arr_zero(lnx_headless_frame_t, platform_arena, opts.frame_count);
+  if (!frames) return 1;
+
+  printf("[headless] running %s for %u frames at %f secs per frame with %u workers\n",
+      opts.app_path, opts.frame_count, delta_time, worker_count);
+
+  //
+  // Eden loop
+  //
+  u32_t frame_count = 0;
+  while (eden->is_running && 
+         frame_count < opts.frame_count && 
+         !(opts.play_path && eden_input_player_is_done(&player)))
+  {
+#if EDEN_DEBUG
+    eden_profiler_reset(&eden->profiler);
+#endif // EDEN_DEBUG
+    eden_profile_frame();
+
+    lnx_headless_frame_t* frame = frames + frame_count++;
+    u64_t frame_start = clock_time();
+
+    eden_null_gfx_begin_frame(&eden->gfx);
+    if (opts.play_path) {
+      if (!eden_input_player_play(&player, &eden->input)) {
+        printf("[headless] input recording is broken at frame %u\n", player.frame_index);
+        return 1;
+      }
+    }
+    else {
+      lnx_headless_update_input(&eden->input, delta_time);
+    }
+    if (opts.record_path) 
+      eden_input_recorder_record(&recorder, &eden->input);
+
+    u64_t update_start = clock_time();
+    eden_functions.update_and_render(eden);
+    u64_t update_end = clock_time();
+
+    if (config.speaker_enabled)
+      eden_speaker_update(eden);
+    u64_t audio_end = clock_time();
+
+#if EDEN_DEBUG
+    if (config.profiler_enabled)
+      eden_profiler_update_entries(&eden->profiler);
+
+    if (config.inspector_enabled)
+      eden_inspector_clear(&eden->inspector);
+
+    eden_debug_end_frame(&eden->debug);
+#endif // EDEN_DEBUG
+
+    u64_t gfx_start = clock_time();
+    eden_null_gfx_end_frame(&eden->gfx);
+    u64_t frame_end = clock_time();
+
+    frame->update_ms = lnx_headless_ms_elapsed(update_start, update_end);
+    frame->audio_ms = lnx_headless_ms_elapsed(update_end, audio_end);
+    frame->gfx_ms = lnx_headless_ms_elapsed(gfx_start, frame_end);
+    frame->total_ms = lnx_headless_ms_elapsed(frame_start, frame_end);
+    frame->command_count = null_gfx->command_count;
+    frame->draw_count = null_gfx->draw_count;
+    frame->batch_count = null_gfx->batch_count;
+    frame->hash = null_gfx->hash;
+  }
+
+  if (opts.record_path) {
+    if (recorder.is_full) 
+      printf("[headless] input recording is full; only %u frames recorded\n", recorder.frame_count);
+    if (!eden_input_recorder_save(&recorder, opts.record_path)) {
+      printf("[headless] cannot write %s\n", opts.record_path);
+      return 1;
+    }
+    printf("[headless] recorded %u frames of input to %s\n", recorder.frame_count, opts.record_path);
+  }
+
+#if EDEN_DEBUG
+  if (opts.trace_path) {
+    if (!eden_profiler_export_trace(&eden->profiler, opts.trace_path, platform_arena)) {
+      printf("[headless] cannot write %s\n", opts.trace_path);
+      return 1;
+    }
+    printf("[headless] wrote %s\n", opts.trace_path);
+  }
+#endif // EDEN_DEBUG
+
+  if (frame_count <= opts.warmup_count) {
+    printf("[headless] app exited after %u frames\n", frame_count);
+    return 1;
+  }
+
+  if (!lnx_headless_write_csv(opts.csv_path, frames, frame_count)) {
+    printf("[headless] cannot write %s\n", opts.csv_path);
+    return 1;
+  }
+  printf("[headless] wrote %s\n", opts.csv_path);
+
+  f64_t p95 = lnx_headless_print_summary(
+      frames + opts.warmup_count,
+      frame_count - opts.warmup_count,
+      platform_arena);
+  printf("[headless] output hash: %016llx\n", 
+      (unsigned long long)lnx_headless_hash_frames(frames, frame_count));
+
+  if (opts.budget_ms > 0.0 && p95 > opts.budget_ms) {
+    printf("[headless] over budget! p95 %.3f ms > %.3f ms\n", p95, opts.budget_ms);
+    return 2;
+  }
+
+  return 0;
+}
@@ -6,6 +6,10 @@
 //
 // FLAGS
 //   MOMO_ASSERTIVE - Enables/Disables asserts. Default is 1 (enabled)
+//   MOMO_SSE2      - Enables/Disables SSE2 code paths. Default is on for 
+//                    x64 or when the compiler targets SSE2.
+//   MOMO_AVX2      - Enables/Disables AVX2 code paths. Default is on when
+//                    the compiler targets AVX2 (e.g. -march=native, /arch:AVX2)
 //
 
 
@@ -91,6 +95,33 @@
 # define ARCH_ARM 0
 #endif 
 
+//
+// SIMD 
+//
+#if !defined(MOMO_SSE2)
+# if ARCH_X64 || defined(__SSE2__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#  define MOMO_SSE2 1
+# else
+#  define MOMO_SSE2 0
+# endif
+#endif
+
+#if !defined(MOMO_AVX2)
+# if defined(__AVX2__)
+#  define MOMO_AVX2 1
+# else
+#  define MOMO_AVX2 0
+# endif
+#endif
+
+#if MOMO_SSE2 || MOMO_AVX2
+# if COMPILER_MSVC
+#  include <intrin.h>
+# else
+#  include <immintrin.h>
+# endif
+#endif
+
 //
 // Export helpers
 //
@@ -101,9 +132,9 @@
 #if COMPILER_MSVC
 # define exported c_link __declspec(dllexport)
 #elif COMPILER_GCC
-# define exported __attribute__((visibility("default")))  
+# define exported c_link __attribute__((visibility("default")))
 #elif COMPILER_CLANG
-# define exported __attribute__((visibility("default")))  
+# define exported c_link __attribute__((visibility("default")))
 #else
 # warning "[momo] 'exported' not defined for this compiler"
 #endif
@@ -553,6 +584,90 @@ struct rp_rect_t
   void* user_data;
 };
 
+//
+// @mark:(Bonk)
+//
+// 2D segments in SoA form, for testing many of them at once with SIMD.
+// 'cap' is always a multiple of 8 and the arrays are 32-byte aligned.
+//
+struct seg2_soa_t {
+  u32_t count;
+  u32_t cap;
+  f32_t* start_x;
+  f32_t* start_y;
+  f32_t* delta_x;
+  f32_t* delta_y;
+};
+
+//
+// @mark:(BVH2)
+//
+// Bounding volume hierarchy over 2D line segments, for raycasting.
+// Segments are set with bvh2_set_segment() and bvh2_update() decides
+// whether to rebuild, refit the existing tree or do nothing at all.
+//
+struct bvh2_node_t {
+  v2f_t min;
+  v2f_t max;
+  u32_t first; // leaf: first slot in 'leaf_segs'; otherwise: left child (right child is first+1)
+  u32_t count; // 0 if not a leaf
+};
+
+struct bvh2_t {
+  u32_t segment_cap;
+  u32_t segment_count;
+  v2f_t* starts;
+  v2f_t* ends;
+  u32_t* indices; 
+
+  u32_t node_count;
+  bvh2_node_t* nodes;
+
+  // @note: Every leaf gets 4 slots here (padded with segments that can't 
+  // be hit) so that a leaf can be tested with a single SIMD kernel call.
+  seg2_soa_t leaf_segs; 
+  u32_t* leaf_seg_indices; // which segment is in which slot
+
+  b32_t is_built;
+  b32_t is_dirty;
+  f32_t built_cost; // sum of node perimeters right after the last build
+
+  // stats
+  u32_t build_count;
+  u32_t refit_count;
+};
+
+//
+// @mark:(Hashmap)
+//
+// Open addressing hash map in the style of SwissTable. Every slot has 
+// a control byte that says if it's empty, deleted, or holds a key 
+// whose hash has these low 7 bits. Lookups compare the control bytes 
+// of 16 slots at once (with SSE2) and only compare the keys whose 
+// 7 bits match.
+//
+// Memory comes from an arena. Growing pushes new arrays and leaves 
+// the old ones in the arena, so a map that grows a lot should have 
+// an arena to itself or be initialized with enough room.
+//
+// Keys are hashed with hashmap_hash() and compared with 
+// hashmap_is_same_key(), which are overloaded for integers, c-strings
+// and buf_t. Overload both for other key types. String keys are not 
+// copied and have to outlive the map.
+//
+#define HASHMAP_GROUP_SIZE 16
+
+template<typename K, typename V>
+struct hashmap_t {
+  u8_t* ctrls;       // cap + HASHMAP_GROUP_SIZE - 1; the tail mirrors the head
+  K* keys;
+  V* values;
+  u32_t cap;         // power of 2, at least HASHMAP_GROUP_SIZE
+  u32_t count;
+  u32_t growth_left; // empty slots we can still fill before we grow
+  arena_t* arena;
+};
+
 //
 // @mark:(Clex)
 //
@@ -639,6 +754,7 @@ struct json_array_t
 {
   json_array_node_t* head;
   json_array_node_t* tail;
+  u32_t count;
 };
 
 // @note: Represents a JSON element, which is a string.
@@ -668,10 +784,17 @@ enum json_value_type_t
   JSON_VALUE_TYPE_OBJECT,
 };
 
-// An object contains a bunch of entries
+// @note: An object contains a bunch of entries, in the order they 
+// appear in the text. Objects with a lot of entries also get a hashmap 
+// of their keys so that lookups don't have to go through all of them.
+#define JSON_OBJECT_INDEX_THRESHOLD 8
+struct _json_entry_t;
 struct json_object_t 
 {
-  struct _json_entry_t* head; // points to the first entry
+  _json_entry_t* head; // points to the first entry
+  _json_entry_t* tail;
+  u32_t count;
+  hashmap_t<buf_t, _json_entry_t*>* index; // only if count > JSON_OBJECT_INDEX_THRESHOLD
 };
 
 struct json_value_t 
@@ -692,15 +815,17 @@ struct json_array_node_t
 
 struct json_t 
 {
-  // for tokenizing
   buf_t text;
-  umi_t at;
 
   // The 'root' item in a JSON file is an object type.
   json_object_t root;
+
+  // If json_read() fails, roughly where in the text it failed.
+  usz_t error_at;
 };
 
 
+
 enum file_access_t {
   FILE_ACCESS_READ,   // Only reads the file, does not write
   FILE_ACCESS_CREATE, // Creates or truncates a file for writing, as if it's new
@@ -708,6 +833,72 @@ enum file_access_t {
 };
 struct file_t;  // @note: Implementation is different depending on OS
 
+// @note: A pull reader for JSON that comes in chunks, for documents 
+// that are too big to keep in memory. Feed it chunks (or give it a 
+// file) and call json_reader_next() until it says it needs more.
+//
+// Event strings point into the chunk when the whole token is in it, 
+// and into the scratch buffer when it was split across chunks, so the 
+// scratch buffer decides how long a split token can be. Either way, 
+// they are only good until the next json_reader_next() or 
+// json_reader_feed().
+//
+// Accepts the same text as json_read(), except that the root can be
+// any value. Strings are not unescaped.
+//
+#define JSON_READER_MAX_DEPTH 1024
+
+enum json_event_type_t {
+  JSON_EVENT_TYPE_NEED_MORE, // feed another chunk, or call json_reader_finish()
+  JSON_EVENT_TYPE_BEGIN_OBJECT,
+  JSON_EVENT_TYPE_END_OBJECT,
+  JSON_EVENT_TYPE_BEGIN_ARRAY,
+  JSON_EVENT_TYPE_END_ARRAY,
+  JSON_EVENT_TYPE_KEY,
+  JSON_EVENT_TYPE_STRING,
+  JSON_EVENT_TYPE_NUMBER,
+  JSON_EVENT_TYPE_TRUE,
+  JSON_EVENT_TYPE_FALSE,
+  JSON_EVENT_TYPE_NULL,
+  JSON_EVENT_TYPE_END,       // the document is done
+  JSON_EVENT_TYPE_ERROR,
+};
+
+struct json_event_t {
+  json_event_type_t type;
+  buf_t str; // for keys, strings, numbers and literals
+};
+
+struct json_reader_t {
+  // current chunk
+  const u8_t* chunk;
+  usz_t chunk_size;
+  usz_t chunk_at;
+  u64_t chunk_offset; // of the current chunk in the whole text
+  b32_t is_finished;  // no more chunks after this one
+
+  // optional file to pull chunks from
+  file_t* file;
+  buf_t file_chunk;
+  u64_t file_size;
+  u64_t file_offset;
+
+  // the token we are in the middle of
+  u32_t token;       // _JSON_READER_TOKEN_*
+  usz_t token_start; // in the current chunk
+  u32_t escape;      // in strings; 1 after a backslash, then 2 to 5 for \u digits
+  b32_t is_key;
+  b32_t is_split;    // started in an earlier chunk, so it's in the scratch buffer
+  buf_t scratch;
+  usz_t scratch_size;
+
+  u32_t expect;      // _JSON_READER_EXPECT_*
+  u32_t depth;
+  u64_t is_object[JSON_READER_MAX_DEPTH/64]; // one bit per level
+
+  u64_t error_at;
+};
+
 //
 // @mark: Functions
 //
@@ -757,6 +948,12 @@ static json_element_t* json_get_element(json_value_t* val);
 static json_array_t* json_get_array(json_value_t* val);
 static json_object_t* json_get_object(json_value_t* val);
 
+static void         json_reader_init(json_reader_t* r, buf_t scratch);
+static void         json_reader_feed(json_reader_t* r, const u8_t* chunk, usz_t chunk_size);
+static void         json_reader_finish(json_reader_t* r);
+static b32_t        json_reader_set_file(json_reader_t* r, file_t* file, buf_t chunk_memory);
+static json_event_t json_reader_next(json_reader_t* r);
+
 #define digit_to_ascii(d) ((d) + '0')
 #define ascii_to_digit(a) ((a) - '0')
 static b32_t u8_is_whitespace(u8_t c);
@@ -779,7 +976,8 @@ static b32_t u8_is_readable(u8_t c);
 #define memory_copy_array(d,s)   memory_copy((d), (s), sizeof(d))
 #define memory_copy_range(d,s,n) memory_copy((d), (s), sizeof(*(d)) * (n))
 
-static void     memory_copy(void* dest, const void* src, usz_t size);
+static void     memory_copy(void* dest, const void* src, usz_t size); // ranges must not overlap; use memory_move()
+static void     memory_move(void* dest, const void* src, usz_t size); // overlap-safe
 static void     memory_zero(void* dest, usz_t size);
 static b32_t    memory_is_same(const void* lhs, const void* rhs, usz_t size);
 static void     memory_swap(void* lhs, void* rhs, usz_t size);
@@ -911,11 +1109,20 @@ static u16_t u16_endian_swap(u16_t value);
 static u32_t u32_factorial(u32_t x);
 static u32_t u32_atomic_compare_assign(u32_t volatile* value, u32_t new_value, u32_t expected_value);
 static u32_t u32_atomic_add(u32_t volatile* value, u32_t to_add);
+static u32_t u32_atomic_load(u32_t volatile* value); // acquire
+static void  u32_atomic_store(u32_t volatile* value, u32_t new_value); // release
 static u32_t u32_endian_swap(u32_t value);
+static u32_t u32_ctz(u32_t value); // undefined for 0
+static u32_t u32_clz(u32_t value); // undefined for 0
 
 static u64_t u64_factorial(u64_t x);
 static u64_t u64_atomic_assign(u64_t volatile* value, u64_t new_value);
 static u64_t u64_atomic_add(u64_t volatile* value, u64_t to_add);
+static u64_t u64_atomic_compare_assign(u64_t volatile* value, u64_t new_value, u64_t expected_value);
+static u64_t u64_atomic_load(u64_t volatile* value); // acquire
+static void  u64_atomic_store(u64_t volatile* value, u64_t new_value); // release
+static u32_t u64_ctz(u64_t value); // undefined for 0
+static void  atomic_fence(); // full sequentially-consistent fence
 
 static usz_t cstr_len(const c8_t* str); 
 static void  cstr_copy(c8_t * dest, const c8_t* src); 
@@ -930,6 +1137,9 @@ static void  cstr_itoa(c8_t* dest, s32_t num);
 static u32_t cstr_len_if(const char* str, b32_t (*pred)(char));
 
 static u32_t hash_djb2(const c8_t* str);
+static u64_t hash_fnv1a_64(const void* data, usz_t size, u64_t hash = 0xCBF29CE484222325);
+static u64_t hash_wy64(const void* data, usz_t size, u64_t seed = 0);
+static u64_t hash_u64(u64_t value);
 
 //
 // @note: Singly Linked List
@@ -1065,6 +1275,27 @@ static rgb_t  hsl_to_rgb(hsl_t c);
 
 static b32_t bonk_tri2_pt2(v2f_t tp0, v2f_t tp1, v2f_t tp2, v2f_t pt); 
 
+// The ray-vs-segment functions below return the lowest t in (0, max_t) where
+// ray_origin + t*ray_dir hits a segment (strictly between its end points),
+// or max_t if nothing is hit. Segments parallel to the ray are never hit.
+// The SIMD versions give exactly the same results as the scalar one.
+static f32_t bonk_ray2_seg2(v2f_t ray_origin, v2f_t ray_dir, v2f_t seg_start, v2f_t seg_delta, f32_t max_t);
+static f32_t bonk_ray2_segs2(v2f_t ray_origin, v2f_t ray_dir, seg2_soa_t* segs, u32_t first, u32_t count, f32_t max_t); // 1 ray vs 8 (AVX2) or 4 (SSE2) segments per step
+static void  bonk_rays2_segs2(v2f_t ray_origin, const v2f_t* ray_dirs, f32_t* ray_ts, u32_t ray_count, seg2_soa_t* segs); // 8 or 4 rays vs 1 segment per step; ray_ts is max_t in, result out
+
+static b32_t seg2_soa_init(seg2_soa_t* segs, u32_t cap, arena_t* arena);
+static void  seg2_soa_set(seg2_soa_t* segs, u32_t index, v2f_t start, v2f_t end);
+
+static b32_t bvh2_init(bvh2_t* bvh, u32_t segment_cap, arena_t* arena);
+static void  bvh2_clear(bvh2_t* bvh);
+static void  bvh2_set_segment(bvh2_t* bvh, u32_t index, v2f_t start, v2f_t end);
+static void  bvh2_update(bvh2_t* bvh);
+static void  bvh2_build(bvh2_t* bvh);
+static void  bvh2_refit(bvh2_t* bvh);
+static f32_t bvh2_raycast(bvh2_t* bvh, v2f_t ray_origin, v2f_t ray_dir, f32_t max_t);
+// Returns the lowest t in (0, max_t) where ray_origin + t*ray_dir hits a 
+// segment (only counting hits strictly inside the segment), or max_t if nothing is hit.
+
 static void  rng_init(rng_t* r, u32_t seed);
 static u32_t rng_next(rng_t* r);
 static u32_t rng_choice(rng_t* r, u32_t choice_count);
@@ -1076,11 +1307,39 @@ static u32_t rng_range_u32(rng_t* r, u32_t min, u32_t max);
 static v2f_t rng_unit_circle(rng_t* r);
 
 // @note: These are for sort entries, which we should try to default to.
+struct job_system_t;
 static void sort_quick(sort_entry_t* entries, u32_t entry_count);
-static void sort_radix(sort_entry_t* entries, u32_t entry_count, arena_t* arena);
+static void sort_radix(sort_entry_t* entries, u32_t entry_count, arena_t* arena, job_system_t* js = nullptr);
+
+// @note: Stable LSD radix sorts on 'keys'. If 'values' is not null, it 
+// is moved along with the keys. Scratch memory comes from 'arena' and 
+// is given back after. If 'js' is given, big inputs are split across 
+// its workers. Returns false if the arena runs out.
+static b32_t sort_radix_u32(u32_t* keys, u32_t* values, u32_t count, arena_t* arena, job_system_t* js = nullptr);
+static b32_t sort_radix_s32(s32_t* keys, u32_t* values, u32_t count, arena_t* arena, job_system_t* js = nullptr);
+static b32_t sort_radix_f32(f32_t* keys, u32_t* values, u32_t count, arena_t* arena, job_system_t* js = nullptr);
+static b32_t sort_radix_u64(u64_t* keys, u32_t* values, u32_t count, arena_t* arena, job_system_t* js = nullptr);
+static b32_t sort_radix_s64(s64_t* keys, u32_t* values, u32_t count, arena_t* arena, job_system_t* js = nullptr);
+static b32_t sort_radix_f64(f64_t* keys, u32_t* values, u32_t count, arena_t* arena, job_system_t* js = nullptr);
+
+// @note: Sorts 'arr' with 'less(const T& lhs, const T& rhs)', which is usually a lambda.
+// Not stable. sort_merge() quick sorts chunks in parallel and merges them, using
+// 'count' elements of scratch from 'arena'. Returns false if the arena runs out.
+template<typename T, typename F> static void  sort_quick(T* arr, u32_t count, F less);
+template<typename T, typename F> static b32_t sort_merge(T* arr, u32_t count, F less, arena_t* arena, job_system_t* js = nullptr);
 
 #define sort_quick_generic_predicate_sig(name) b32_t name(const void* lhs, const void* rhs)
-#define sort_quick_generic(arr, count, predicate) _sort_quick_generic(arr, count, sizeof(*(arr)), predicate)
+#define sort_quick_generic(arr, count, predicate) sort_quick(arr, count, [](const auto& lhs, const auto& rhs) -> b32_t { return predicate(&lhs, &rhs); })
+
+//
+// @mark:(Hashmap)
+//
+template<typename K, typename V> static b32_t hashmap_init(hashmap_t<K,V>* m, arena_t* arena, u32_t initial_cap = HASHMAP_GROUP_SIZE);
+template<typename K, typename V> static V*    hashmap_get(hashmap_t<K,V>* m, K key);
+template<typename K, typename V> static V*    hashmap_set(hashmap_t<K,V>* m, K key, V value); // nullptr if out of memory
+template<typename K, typename V> static b32_t hashmap_remove(hashmap_t<K,V>* m, K key);
+template<typename K, typename V> static void  hashmap_clear(hashmap_t<K,V>* m);
+template<typename K, typename V> static b32_t hashmap_is_slot_used(hashmap_t<K,V>* m, u32_t slot); // for iterating over [0, cap)
 
 //
 // @mark:(CRC)
@@ -1091,10 +1350,40 @@ static void  crc8_init_table(crc8_table_t* table, u8_t polynomial);
 static u32_t crc32_slow(u8_t* data, u32_t data_size, u32_t start_register, u32_t polynomial);
 static u32_t crc16_slow(u8_t* data, u32_t data_size, u16_t start_register, u16_t polynomial);
 static u32_t crc8_slow(u8_t* data, u32_t data_size, u16_t start_register, u16_t polynomial);
-static u32_t crc32(u8_t* data, u32_t data_size, u16_t start_register, crc32_table_t* table);
+static u32_t crc32(u8_t* data, u32_t data_size, u32_t start_register, crc32_table_t* table);
 static u32_t crc16(u8_t* data, u32_t data_size, u16_t start_register, crc16_table_t* table);
 static u32_t crc8(u8_t* data, u32_t data_size, u8_t start_register, crc8_table_t* table);
 
+// @note: CRC-32 as used by zlib, gzip and PNG, and CRC-32C (Castagnoli).
+// To checksum data in pieces, pass the previous result as 'crc'.
+// These pick the fastest path that the CPU supports.
+static u32_t crc32_ieee(const void* data, usz_t size, u32_t crc = 0);
+static u32_t crc32c(const void* data, usz_t size, u32_t crc = 0);
+
+//
+// @mark:(Zlib)
+//
+// @note: Decompresses a zlib stream (RFC 1950) into 'dest', which must be
+// big enough to hold all of it. 'out_size' gets the number of bytes written.
+// Returns false if the data is bad, truncated or does not fit.
+// zlib_inflate_raw() does the same for bare DEFLATE data (RFC 1951).
+static b32_t zlib_inflate(buf_t dest, buf_t src, usz_t* out_size = nullptr);
+static b32_t zlib_inflate_raw(buf_t dest, buf_t src, usz_t* out_size = nullptr);
+
+// @note: Compresses 'src' into a zlib stream in 'dest' at 'level' 0-9, like
+// zlib's levels; 0 stores it as is. 'dest' must have zlib_deflate_bound()
+// bytes. Returns false if it does not, or if 'scratch' runs out.
+// About 320KB of 'scratch' is used, per worker if there is a job system.
+//
+// The input is compressed in independent chunks of 256KB, each allowed to
+// refer back into the 32KB before it. With 'js' the chunks are compressed
+// in parallel; the output is the same either way.
+static usz_t zlib_deflate_bound(usz_t size);
+static b32_t zlib_deflate(buf_t dest, buf_t src, u32_t level, arena_t* scratch, usz_t* out_size = nullptr, job_system_t* js = nullptr);
+
+// @note: To checksum data in pieces, pass the previous result as 'adler'.
+static u32_t adler32(const void* data, usz_t size, u32_t adler = 1);
+
 // 
 // @mark:(Strings)
 //
@@ -1177,8 +1466,8 @@ static b32_t    arena_grow_buffer(arena_t* a, buf_t* str, usz_t new_size);
 #define arena_push_arr_zero(t,b,n)         (t*)arena_push_size_zero(b, sizeof(t)*(n),alignof(t))
 #define arena_push_zero_align(t,b,a)       (t*)arena_push_size_zero(b, sizeof(t), a)
 #define arena_push_zero(t,b)               (t*)arena_push_size_zero(b, sizeof(t), alignof(t))
-#define arena_alloc_bootstrap(t,m,...)        (t*)arena_alloc_bootstrap_size(sizeof(t), offsetof(t,m), __VA_ARGS__)
-#define arena_alloc_bootstrap_zero(t,m,...)   (t*)arena_alloc_bootstrap_size_zero(sizeof(t), offsetof(t,m), __VA_ARGS__)
+#define arena_alloc_bootstrap(t,m,...)        (t*)arena_alloc_bootstrap_size(sizeof(t), offsetof(t,m), ##__VA_ARGS__)
+#define arena_alloc_bootstrap_zero(t,m,...)   (t*)arena_alloc_bootstrap_size_zero(sizeof(t), offsetof(t,m), ##__VA_ARGS__)
 
 static arena_marker_t arena_mark(arena_t* a);
 static void arena_revert(arena_marker_t marker);
@@ -1229,7 +1518,13 @@ static void ttf_get_glyph_bitmap_box(const ttf_t* ttf, u32_t glyph_index, f32_t
 
 static b32_t     png_read(png_t* png, buf_t png_contents);
 static u32_t*    png_rasterize(png_t* png, u32_t* out_w, u32_t* out_h, arena_t* arena); 
-static buf_t     png_write(u8_t* pixels, u32_t width, u32_t height, arena_t* arena);
+static b32_t     png_rasterize_into_buffer(png_t* png, u8_t* dest, u32_t pitch, arena_t* scratch);
+// Decodes straight into 'dest', which must have room for png->height rows of
+// png->width rgba_t pixels, 'pitch' bytes apart (0 if they are packed).
+// Only about 100KB and two rows are taken from 'scratch' while decoding.
+static buf_t     png_write(u32_t* pixels, u32_t width, u32_t height, arena_t* arena, u32_t level = 6, job_system_t* js = nullptr);
+// Compresses at zlib 'level' 0-9, see zlib_deflate(). Each row is filtered
+// with whichever filter looks like it compresses best.
 
 static b32_t rp_pack(
     rp_rect_t* rects, 
@@ -1252,9 +1547,12 @@ static b32_t  file_open(file_t* fp, const char* filename, file_access_t access_t
 static b32_t  file_read(file_t* fp, void* dest, usz_t size, usz_t offset);
 static b32_t  file_write(file_t* fp, const void* src, usz_t size, usz_t offset);
 static u64_t  file_get_size(file_t* fp);
+static buf_t  file_map(file_t* fp); // read-only; the file can be closed after mapping
+static void   file_unmap(buf_t mapping);
 
 static u64_t  clock_time();
 static u64_t  clock_resolution();
+static u64_t  clock_cycles(); // cheap but the rate is unknown; see definition
 
 struct socket_t;
 static b32_t  socket_system_begin();
@@ -1267,6 +1565,42 @@ static buf_t  socket_receive(socket_t* s, buf_t buffer);
 
 static void doze(u32_t ms_to_doze);
 
+typedef void thread_callback_f(void* ctx);
+struct thread_t;
+static b32_t  thread_begin(thread_t* t, thread_callback_f* callback, void* ctx);
+static void   thread_join(thread_t* t);
+static void   thread_yield();
+static u32_t  thread_get_hardware_count();
+static u32_t  thread_get_id();
+
+struct semaphore_t;
+static b32_t  semaphore_init(semaphore_t* s, u32_t initial_count);
+static void   semaphore_free(semaphore_t* s);
+static void   semaphore_wait(semaphore_t* s);
+static void   semaphore_signal(semaphore_t* s, u32_t count = 1);
+
+//
+// @mark:(Jobs)
+//
+// A work-stealing job system. Every worker owns a lock-free (Chase-Lev)
+// deque of jobs; the owner pushes and pops at the bottom while idle 
+// workers steal from the top. The thread that calls job_system_init() 
+// is worker 0 and only runs jobs while it is inside job_wait().
+//
+// Jobs can add more jobs (child jobs) from within their callback. 
+// A job_counter_t counts outstanding jobs; job_wait() helps run jobs
+// until the counter reaches zero, so waiting inside a job is fine.
+// Threads outside the job system can wait too; they only steal.
+//
+typedef void job_callback_f(void* data);
+struct job_counter_t { u32_t volatile value; };
+struct job_system_t;
+static b32_t  job_system_init(job_system_t* js, u32_t thread_count, u32_t max_jobs_per_worker, arena_t* arena);
+static void   job_system_free(job_system_t* js);
+static void   job_add(job_system_t* js, job_callback_f* callback, void* data, job_counter_t* counter = nullptr);
+static void   job_wait(job_system_t* js, job_counter_t* counter);
+static b32_t  job_is_done(job_counter_t* counter);
+
 //
 // @mark: Implementation
 //
@@ -1299,6 +1633,16 @@ struct socket_t {
   SOCKET sock;
 };
 
+struct thread_t {
+  HANDLE handle;
+  thread_callback_f* callback;
+  void* ctx;
+};
+
+struct semaphore_t {
+  HANDLE handle;
+};
+
 //
 // @note: my god windows why you make me do this.
 //
@@ -1430,6 +1774,67 @@ doze(u32_t ms_to_doze) {
   Sleep(ms_to_doze);
 }
 
+static DWORD WINAPI 
+_thread_entry(LPVOID param) {
+  thread_t* t = (thread_t*)param;
+  t->callback(t->ctx);
+  return 0;
+}
+
+static b32_t
+thread_begin(thread_t* t, thread_callback_f* callback, void* ctx) {
+  t->callback = callback;
+  t->ctx = ctx;
+  t->handle = CreateThread(0, 0, _thread_entry, t, 0, 0);
+  return t->handle != NULL;
+}
+
+static void
+thread_join(thread_t* t) {
+  WaitForSingleObject(t->handle, INFINITE);
+  CloseHandle(t->handle);
+  t->handle = NULL;
+}
+
+static void
+thread_yield() {
+  SwitchToThread();
+}
+
+static u32_t
+thread_get_hardware_count() {
+  SYSTEM_INFO info;
+  GetSystemInfo(&info);
+  return (u32_t)info.dwNumberOfProcessors;
+}
+
+static u32_t
+thread_get_id() {
+  return (u32_t)GetCurrentThreadId();
+}
+
+static b32_t
+semaphore_init(semaphore_t* s, u32_t initial_count) {
+  s->handle = CreateSemaphoreEx(0, initial_count, 0x7FFFFFFF, 0, 0, SEMAPHORE_ALL_ACCESS);
+  return s->handle != NULL;
+}
+
+static void
+semaphore_free(semaphore_t* s) {
+  CloseHandle(s->handle);
+  s->handle = NULL;
+}
+
+static void
+semaphore_wait(semaphore_t* s) {
+  WaitForSingleObjectEx(s->handle, INFINITE, FALSE);
+}
+
+static void
+semaphore_signal(semaphore_t* s, u32_t count) {
+  ReleaseSemaphore(s->handle, count, 0);
+}
+
 static void
 file_close(file_t* fp) 
 {
@@ -1526,6 +1931,28 @@ file_get_size(file_t* fp) {
   return ret;
 }
 
+static buf_t
+file_map(file_t* fp) {
+  u64_t size = file_get_size(fp);
+  if (size == 0) return buf_bad();
+
+  HANDLE mapping = CreateFileMapping(fp->handle, NULL, PAGE_READONLY, 0, 0, NULL);
+  if (!mapping) return buf_bad();
+
+  // @note: The view holds a reference to the mapping object, 
+  // so we don't need to keep the handle around.
+  void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+  CloseHandle(mapping);
+  if (!view) return buf_bad();
+
+  return buf_set((u8_t*)view, size);
+}
+
+static void
+file_unmap(buf_t mapping) {
+  UnmapViewOfFile(mapping.e);
+}
+
 static buf_t
 memory_reserve(usz_t size) {
   return buf_set(
@@ -1693,12 +2120,18 @@ static inline LONG w32_rect_height(RECT r) { return r.bottom - r.top; }
 
 # include <sys/mman.h> // mmap, munmap
 # include <sys/times.h> // times 
+# include <time.h> // clock_gettime
 # include <fcntl.h> // open 
 # include <unistd.h> // write, read, close, sysconf
 # include <sys/types.h>
 # include <sys/socket.h>
 # include <netinet/in.h>
 # include <netdb.h>
+# include <pthread.h> // pthread_create, pthread_join
+# include <semaphore.h> // sem_init, sem_wait, sem_post
+# include <sched.h> // sched_yield
+# include <sys/syscall.h> // SYS_gettid
+# include <errno.h> // EINTR
 
 struct file_t {
   int handle;
@@ -1710,6 +2143,16 @@ struct socket_t {
   int sock;
 };
 
+struct thread_t {
+  pthread_t handle;
+  thread_callback_f* callback;
+  void* ctx;
+};
+
+struct semaphore_t {
+  sem_t handle;
+};
+
 static b32_t 
 socket_system_begin() 
 {
@@ -1781,6 +2224,64 @@ doze(u32_t ms_to_doze)
   usleep(ms_to_doze * 1000);
 }
 
+static void*
+_thread_entry(void* param) {
+  thread_t* t = (thread_t*)param;
+  t->callback(t->ctx);
+  return 0;
+}
+
+static b32_t
+thread_begin(thread_t* t, thread_callback_f* callback, void* ctx) {
+  t->callback = callback;
+  t->ctx = ctx;
+  return pthread_create(&t->handle, 0, _thread_entry, t) == 0;
+}
+
+static void
+thread_join(thread_t* t) {
+  pthread_join(t->handle, 0);
+}
+
+static void
+thread_yield() {
+  sched_yield();
+}
+
+static u32_t
+thread_get_hardware_count() {
+  long count = sysconf(_SC_NPROCESSORS_ONLN);
+  return count > 0 ? (u32_t)count : 1;
+}
+
+static u32_t
+thread_get_id() {
+  return (u32_t)syscall(SYS_gettid);
+}
+
+static b32_t
+semaphore_init(semaphore_t* s, u32_t initial_count) {
+  return sem_init(&s->handle, 0, initial_count) == 0;
+}
+
+static void
+semaphore_free(semaphore_t* s) {
+  sem_destroy(&s->handle);
+}
+
+static void
+semaphore_wait(semaphore_t* s) {
+  // @note: sem_wait() can be interrupted by signals
+  while(sem_wait(&s->handle) != 0 && errno == EINTR);
+}
+
+static void
+semaphore_signal(semaphore_t* s, u32_t count) {
+  for(u32_t i = 0; i < count; ++i) {
+    sem_post(&s->handle);
+  }
+}
+
 static void
 file_close(file_t* fp) 
 {
@@ -1802,14 +2303,16 @@ file_open(
       flags = O_RDONLY;
       break;
     case FILE_ACCESS_CREATE:
-      flags = O_CREAT | O_RDWR;
+      // @note: truncate, like CREATE_ALWAYS on w32
+      flags = O_CREAT | O_TRUNC | O_RDWR;
       break;
     case FILE_ACCESS_MODIFY:
       flags = O_RDWR;
       break;
   }
 
-  int handle = open(filename, flags);
+  // @note: the mode is required with O_CREAT
+  int handle = open(filename, flags, 0644);
   if (handle == -1) 
     return false;
 
@@ -1817,27 +2320,36 @@ file_open(
   return true;
 }
 
+// @note: pread/pwrite do not touch the file's offset so, like 
+// the windows version, these are safe to call from multiple threads.
 static b32_t
 file_read(file_t* fp, void* dest, usz_t size, usz_t offset) {
   assert(fp->handle != 1);
-  if (lseek(fp->handle, offset, SEEK_SET) == -1) {
-    return false;
-  }
-  if (read(fp->handle, dest, size) == -1) {
-    return false;
+  u8_t* p = (u8_t*)dest;
+  while (size > 0) {
+    ssize_t bytes_read = pread(fp->handle, p, size, offset);
+    if (bytes_read <= 0) {
+      return false;
+    }
+    p += bytes_read;
+    size -= bytes_read;
+    offset += bytes_read;
   }
-
   return true;
 }
 
 static b32_t
 file_write(file_t* fp, const void* src, usz_t size, usz_t offset) 
 {
-  if (lseek(fp->handle, offset, SEEK_SET) == -1) {
-    return false;
-  }
-  if (write(fp->handle, src, size) == -1) {
-    return false;
+  const u8_t* p = (const u8_t*)src;
+  while (size > 0) {
+    ssize_t bytes_wrote = pwrite(fp->handle, p, size, offset);
+    if (bytes_wrote <= 0) {
+      return false;
+    }
+    p += bytes_wrote;
+    size -= bytes_wrote;
+    offset += bytes_wrote;
   }
   return true;
 }
@@ -1850,6 +2362,23 @@ file_get_size(file_t* fp) {
   return lseek(fp->handle, 0, SEEK_END);
 }
 
+static buf_t
+file_map(file_t* fp) {
+  u64_t size = file_get_size(fp);
+  if (size == 0) return buf_bad();
+
+  // @note: The mapping stays valid even after the file is closed.
+  void* view = mmap(0, size, PROT_READ, MAP_PRIVATE, fp->handle, 0);
+  if (view == MAP_FAILED) return buf_bad();
+
+  return buf_set((u8_t*)view, size);
+}
+
+static void
+file_unmap(buf_t mapping) {
+  munmap(mapping.e, mapping.size);
+}
+
 // @note(momo): Apparently linux already handles committing and reserving 
 // for the user already so there is no need to commit/reserve?
 static buf_t
@@ -1866,7 +2395,12 @@ memory_reserve(usz_t size) {
 
 static b32_t
 memory_commit(buf_t blk) {
-  return mprotect(blk.e, blk.size, PROT_READ | PROT_WRITE) == 0;
+  // @note: Unlike VirtualAlloc, mprotect does not round the address 
+  // down to the page boundary for us, and fails if it's not aligned.
+  umi_t page_size = (umi_t)sysconf(_SC_PAGESIZE);
+  umi_t start = align_down_pow2(ptr_to_umi(blk.e), page_size);
+  umi_t end = ptr_to_umi(blk.e) + blk.size;
+  return mprotect(umi_to_ptr(start), end - start, PROT_READ | PROT_WRITE) == 0;
 }
 
 
@@ -1888,19 +2422,38 @@ memory_free(buf_t blk) {
   munmap(blk.e, blk.size);
 }
 
+// @note: times() only ticks at _SC_CLK_TCK (usually 100Hz), which is 
+// too coarse for profiling anything, so we use the monotonic clock instead.
 static u64_t
 clock_time() {
-  tms time;
-  return times(&time);
+  timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (u64_t)ts.tv_sec * 1000000000 + (u64_t)ts.tv_nsec;
 }
 
 static u64_t 
 clock_resolution() {
-  u64_t ret = sysconf(_SC_CLK_TCK);
-  return ret;
+  return 1000000000;
 }
 #endif // OS_WINDOWS
 
+// @note: For profiling. On x86 this is the TSC, which is a lot cheaper 
+// to read than clock_time() and ticks at a constant rate on anything 
+// recent, but we don't know what that rate is. Sample clock_time() 
+// alongside it to find out.
+static u64_t
+clock_cycles() {
+#if ARCH_X86 || ARCH_X64
+# if COMPILER_MSVC
+  return __rdtsc();
+# else
+  return __builtin_ia32_rdtsc();
+# endif
+#else
+  return clock_time();
+#endif
+}
+
 static f32_t 
 clock_secs_elapsed(u64_t start, u64_t end) 
 {
@@ -1948,561 +2501,932 @@ file_write_from_buffer(const char* filename, buf_t buffer) {
 }
 
 //
-// @mark:(Foolish)
-//
-#ifdef MOMO_FOOLISH // FOOLISH
-#include <stdlib.h>
-#include <stdio.h>
-// These are foolish methods that should ideally not make 
-// it into any SERIOUS projects. They are meant to be dumb
-// but convienient for trying stuff out.
+// @mark:(Jobs)
 //
-// @todo: Make this serious
+struct _job_t {
+  job_callback_f* callback;
+  void* data;
+  job_counter_t* counter;
+};
 
-static buf_t 
-foolish_allocate_memory(usz_t size) {
-  return buf_set((u8_t*)malloc(size), size);
-}
+// @note: Chase-Lev deque. 'top' and 'bottom' only ever grow so 
+// we never need to worry about them wrapping around. They are kept 
+// in seperate cache lines so that thieves hammering 'top' do not
+// slow down the owner working on 'bottom'.
+struct _job_deque_t {
+  alignas(64) u64_t volatile top;
+  alignas(64) u64_t volatile bottom;
+  alignas(64) _job_t* jobs;
+  u64_t mask;
+};
 
-static void
-foolish_free_memory(buf_t blk) {
-  free(blk.e);
-}
+struct _job_worker_t {
+  _job_deque_t deque;
+  job_system_t* js;
+  u32_t index;
+  u32_t rng_state;
+  thread_t thread;
+};
 
-static arena_t 
-foolish_allocate_arena(usz_t size) {
-  arena_t ret = {};
-  arena_init(&ret, foolish_allocate_memory(size));
-  return ret;
-}
+struct job_system_t {
+  _job_worker_t* workers;
+  u32_t worker_count; // includes the thread that called job_system_init()
+  u32_t thread_count; // threads that we actually started
 
-static b32_t
-foolish_write_buf_to_file(const char* filename, buf_t buffer) {
-  FILE *file = fopen(filename, "wb");
-  if (!file) return false;
-  defer { fclose(file); };
+  semaphore_t semaphore;
+  u32_t volatile sleeper_count;
+  u32_t volatile is_running;
+};
 
-  fwrite(buffer.e, 1, buffer.size, file);
+static thread_local _job_worker_t* _job_current_worker = nullptr;
+
+// @note: Only the owner of the deque may call this.
+static b32_t
+_job_deque_push(_job_deque_t* d, _job_t* job) {
+  u64_t b = d->bottom;
+  u64_t t = u64_atomic_load(&d->top);
+  if (b - t > d->mask) {
+    return false; // full
+  }
+  d->jobs[b & d->mask] = *job;
+  u64_atomic_store(&d->bottom, b + 1);
   return true;
 }
 
+// @note: Only the owner of the deque may call this.
+static b32_t
+_job_deque_pop(_job_deque_t* d, _job_t* job) {
+  u64_t b = d->bottom - 1;
+  u64_atomic_store(&d->bottom, b);
+  atomic_fence();
+  u64_t t = u64_atomic_load(&d->top);
+
+  if ((s64_t)(b - t) < 0) {
+    // empty
+    u64_atomic_store(&d->bottom, b + 1);
+    return false;
+  }
 
-static buf_t 
-foolish_read_file_into_buffer(const char* filename, b32_t null_terminate = false) {
-  FILE *file = fopen(filename, "rb");
+  *job = d->jobs[b & d->mask];
+  if (t != b) {
+    return true;
+  }
 
-  if (!file) return buf_set(0,0);
-  defer { fclose(file); };
+  // @note: This is the last job, so we race with the thieves for it.
+  b32_t won = u64_atomic_compare_assign(&d->top, t + 1, t) == t;
+  u64_atomic_store(&d->bottom, b + 1);
+  return won;
+}
 
-  fseek(file, 0, SEEK_END);
-  usz_t file_size = ftell(file) ;
-  fseek(file, 0, SEEK_SET);
+// @note: Any thread may call this.
+static b32_t
+_job_deque_steal(_job_deque_t* d, _job_t* job) {
+  u64_t t = u64_atomic_load(&d->top);
+  atomic_fence();
+  u64_t b = u64_atomic_load(&d->bottom);
+  if ((s64_t)(b - t) <= 0) {
+    return false;
+  }
 
+  // @note: The slot cannot be overwritten by the owner until 'top' 
+  // moves past it, in which case the compare below fails anyway.
+  *job = d->jobs[t & d->mask];
+  return u64_atomic_compare_assign(&d->top, t + 1, t) == t;
+}
 
-  buf_t ret = memory_allocate(file_size + null_terminate);
-  usz_t read_amount = fread(ret.e, 1, file_size, file);
+static void
+_job_run(_job_t* job) {
+  job->callback(job->data);
+  if (job->counter) {
+    u32_atomic_add(&job->counter->value, (u32_t)-1);
+  }
+}
 
-  if(read_amount != file_size) return buf_bad();
+// @note: Tries every worker once, going around from 'start'.
+// Pass js->worker_count as 'skip_index' to skip nobody.
+static b32_t
+_job_steal(job_system_t* js, u32_t start, u32_t skip_index, _job_t* job) {
+  for (u32_t i = 0; i < js->worker_count; ++i) {
+    u32_t victim_index = (start + i) % js->worker_count;
+    if (victim_index == skip_index) continue;
+    if (_job_deque_steal(&js->workers[victim_index].deque, job)) {
+      return true;
+    }
+  }
+  return false;
+}
 
-  if (null_terminate) ret.e[file_size] = 0;  
+static b32_t
+_job_find(_job_worker_t* w, _job_t* job) {
+  if (_job_deque_pop(&w->deque, job)) {
+    return true;
+  }
 
-  return ret;
+  job_system_t* js = w->js;
+  if (js->worker_count <= 1) {
+    return false;
+  }
+
+  // @note: Start stealing from a random victim so that thieves 
+  // don't all gang up on the same worker.
+  w->rng_state ^= w->rng_state << 13;
+  w->rng_state ^= w->rng_state >> 17;
+  w->rng_state ^= w->rng_state << 5;
+  u32_t start = w->rng_state % js->worker_count;
+  return _job_steal(js, start, w->index, job);
 }
 
 static void
-foolish_free_buffer(buf_t buffer) {
-  memory_free(buffer);
-}
-
-#endif // FOOLISH
-
-enum _json_token_type_t {
-  _JSON_TOKEN_TYPE_UNKNOWN,
-  _JSON_TOKEN_TYPE_COLON,
-  _JSON_TOKEN_TYPE_OPEN_BRACKET,
-  _JSON_TOKEN_TYPE_CLOSE_BRACKET,
-  _JSON_TOKEN_TYPE_OPEN_BRACE,
-  _JSON_TOKEN_TYPE_CLOSE_BRACE,
-  _JSON_TOKEN_TYPE_COMMA,
-
-  _JSON_TOKEN_TYPE_STRING,
-  _JSON_TOKEN_TYPE_NULL,
-#if 0
-  _JSON_TOKEN_TYPE_UNSIGNED_INTEGER,
-  _JSON_TOKEN_TYPE_FLOATING_POINT,
-  _JSON_TOKEN_TYPE_SIGNED_INTEGER,
-#endif
-  _JSON_TOKEN_TYPE_NUMBER,
-#if 0
-  _JSON_TOKEN_TYPE_BOOLEAN,
-#endif
-  _JSON_TOKEN_TYPE_TRUE,
-  _JSON_TOKEN_TYPE_FALSE,
-
-  _JSON_TOKEN_TYPE_EOF,
-};
-
-enum  _json_expect_type_t {
-  _JSON_EXPECT_TYPE_OPEN,
-  _JSON_EXPECT_TYPE_KEY_OR_CLOSE,
-  _JSON_EXPECT_TYPE_VALUE,
-  _JSON_EXPECT_TYPE_COMMA_OR_CLOSE,
-  _JSON_EXPECT_TYPE_COLON,
-};
-
-struct _json_entry_t {
-  json_key_t key;
-  json_value_t value;
-
-  // For simplified BST data structure.
-  _json_entry_t* left;
-  _json_entry_t* right;
-};
-
-struct _json_token_t {
-  _json_token_type_t type;
-  u8_t* at;
-  usz_t size;
-};
-
-static b32_t _json_parse_object(json_object_t*, json_t* t, arena_t* ba);
-static b32_t _json_set_value_based_on_token(json_t* t, json_value_t* value,  _json_token_t token, arena_t* ba);
-
-
-static void
-_json_append_array(json_array_t* arr, json_array_node_t* node) {
-  sll_append(arr->head, arr->tail, node); 
-}
-
+_job_worker_loop(void* ctx) {
+  _job_worker_t* w = (_job_worker_t*)ctx;
+  job_system_t* js = w->js;
+  _job_current_worker = w;
+
+  while(u32_atomic_load(&js->is_running)) {
+    _job_t job;
+    if (_job_find(w, &job)) {
+      _job_run(&job);
+      continue;
+    }
 
-static void
-_json_eat_ignorables(json_t* t) {
-  for (;;) {
-    if(u8_is_whitespace(t->text.e[t->at])) {
-      ++t->at;
+    // @note: Spin for a bit before going to sleep; jobs tend to come in bursts.
+    b32_t found = false;
+    for (u32_t spin = 0; spin < 64 && !found; ++spin) {
+      thread_yield();
+      found = _job_find(w, &job);
     }
-    else if(t->text.e[t->at] == '/' && t->text.e[t->at+1] == '/') {
-      t->at += 2;
-      while(t->text.e[t->at] != '\n' && t->text.e[t->at] != '\r') {
-        ++t->at;
-      }
+    if (found) {
+      _job_run(&job);
+      continue;
     }
-    else if(t->text.e[t->at] == '/' && t->text.e[t->at+1] == '*') {
-      t->at += 2;
 
+    // @note: We announce that we are going to sleep BEFORE checking for 
+    // jobs one last time. job_add() pushes BEFORE checking for sleepers.
+    // With a full fence on both sides, at least one of us will see the other.
+    u32_atomic_add(&js->sleeper_count, 1);
+    atomic_fence();
+    if (_job_find(w, &job)) {
+      u32_atomic_add(&js->sleeper_count, (u32_t)-1);
+      _job_run(&job);
+      continue;
     }
-    else {
-      break;
+    if (u32_atomic_load(&js->is_running)) {
+      semaphore_wait(&js->semaphore);
     }
+    u32_atomic_add(&js->sleeper_count, (u32_t)-1);
   }
 }
 
-static _json_token_t
-_json_next_token(json_t* t) {
-  _json_eat_ignorables(t);
-
-  _json_token_t ret = {};
-  ret.at = t->text.e + t->at;
-  ret.type = _JSON_TOKEN_TYPE_UNKNOWN;
-
-  switch(t->text.e[t->at]) {
-    case '\0': {
-      ret.type = _JSON_TOKEN_TYPE_EOF; 
-      ret.size = 1;
-      ++t->at;
-    } break;
-    case '[': {
-      ret.type = _JSON_TOKEN_TYPE_OPEN_BRACKET; 
-      ret.size = 1;
-      ++t->at;
-    } break;
-    case ']': {
-      ret.type = _JSON_TOKEN_TYPE_CLOSE_BRACKET; 
-      ret.size = 1;
-      ++t->at;
-    } break;
-    case '{': {
-      ret.type = _JSON_TOKEN_TYPE_OPEN_BRACE; 
-      ret.size = 1;
-      ++t->at;
-    } break;
-    case '}': {
-      ret.type = _JSON_TOKEN_TYPE_CLOSE_BRACE; 
-      ret.size = 1;
-      ++t->at;
-    } break;
-    case ',': {
-      ret.type = _JSON_TOKEN_TYPE_COMMA;
-      ret.size = 1;
-      ++t->at;
-    } break;
-    case ':': { 
-      ret.type = _JSON_TOKEN_TYPE_COLON; 
-      ret.size = 1;
-      ++t->at;
-    } break;
-    case 't':{
-      if(t->text.size - t->at >= 4 &&
-          t->text.e[t->at+1] == 'r' && 
-          t->text.e[t->at+2] == 'u' && 
-          t->text.e[t->at+3] == 'e')
-      {
-        ret.type = _JSON_TOKEN_TYPE_TRUE;
-        ret.size = 4;
-        t->at += 4;
-      }
-      else {
-        ++t->at;
-      }
-    } break;
-    case 'f': {
-      if(t->text.size - t->at >= 5 &&
-          t->text.e[t->at+1] == 'a' && 
-          t->text.e[t->at+2] == 'l' && 
-          t->text.e[t->at+3] == 's' &&
-          t->text.e[t->at+4] == 'e')
-      {
-        ret.type = _JSON_TOKEN_TYPE_FALSE;
-        ret.size = 5;
-        t->at += 5;
-      }
-      else {
-        ++t->at;
-      }
-
-    } break;
-    case 'n': {
-      if ((t->text.size - t->at) >= 4 && 
-          t->text.e[t->at+1] == 'u' && 
-          t->text.e[t->at+2] == 'l' && 
-          t->text.e[t->at+3] == 'l')
-      {
-        ret.type = _JSON_TOKEN_TYPE_NULL;
-        t->at += 4;
-        ret.size = 4;
-      }
-      else {
-        ++t->at;
-      }
-
-    } break;
-
-    case '"': // strings
-      {
-        ++t->at; // move past the initial double quote
-        ret.at = t->text.e + t->at;
-        while(t->text.e[t->at] &&
-            t->text.e[t->at] != '"') 
-        {
-          if(t->text.e[t->at] == '\\' && 
-              t->text.e[t->at+1]) 
-          {
-            ++t->at;
-            ++ret.size;
-          }
-          ++t->at;
-          ++ret.size;
-        }
-        ret.type = _JSON_TOKEN_TYPE_STRING;
-        ++t->at;
-      } break;
+static void
+_job_system_stop(job_system_t* js) {
+  u32_atomic_store(&js->is_running, false);
+  semaphore_signal(&js->semaphore, js->thread_count);
+  for (u32_t i = 0; i < js->thread_count; ++i) {
+    thread_join(&js->workers[i+1].thread);
+  }
+  js->thread_count = 0;
+  semaphore_free(&js->semaphore);
 
-    default: {
-      // Unsigned integer
-      if (u8_is_digit(t->text.e[t->at])) {
-        while(true)
-        {
-          // @todo check for double dots?
-          if (t->text.e[t->at] == '.') {
-          }
-          else if (!u8_is_digit(t->text.e[t->at])) {
-            break;
-          }
-          ++ret.size;
-          ++t->at;
-        }
-        ret.type = _JSON_TOKEN_TYPE_NUMBER;
-      }
+  if (_job_current_worker == &js->workers[0]) {
+    _job_current_worker = nullptr;
+  }
+}
 
-      // Signed integer
-      else if ((t->text.size - t->at) >= 2 && 
-          t->text.e[t->at] == '-' && 
-          u8_is_digit(t->text.e[t->at+1])) 
-      {
-        ++t->at; // keeps the negative sign
-        while(true)
-        {
-          // @todo check for double dots?
-          if (t->text.e[t->at] == '.') {
-          }
-          else if (!u8_is_digit(t->text.e[t->at])) {
-            break;
-          }
-          ++ret.size;
-          ++t->at;
-        }
-        ret.type = _JSON_TOKEN_TYPE_NUMBER;
-      }      
-      else {
-        ++t->at;
-      }
+static b32_t
+job_system_init(job_system_t* js, u32_t thread_count, u32_t max_jobs_per_worker, arena_t* arena) {
+  js->worker_count = thread_count + 1;
+  js->thread_count = 0;
+  js->workers = arena_push_arr_zero(_job_worker_t, arena, js->worker_count);
+  if (!js->workers) return false;
+
+  u64_t cap = 1;
+  while(cap < max_jobs_per_worker) cap <<= 1;
+
+  for (u32_t i = 0; i < js->worker_count; ++i) {
+    _job_worker_t* w = js->workers + i;
+    w->deque.jobs = arena_push_arr(_job_t, arena, cap);
+    if (!w->deque.jobs) return false;
+    w->deque.mask = cap - 1;
+    w->deque.top = 0;
+    w->deque.bottom = 0;
+    w->js = js;
+    w->index = i;
+    w->rng_state = 0x9E3779B9 * (i + 1);
+  }
+
+  if (!semaphore_init(&js->semaphore, 0)) return false;
+  js->sleeper_count = 0;
+  js->is_running = true;
+  _job_current_worker = &js->workers[0];
+
+  for (u32_t i = 1; i < js->worker_count; ++i) {
+    if (!thread_begin(&js->workers[i].thread, _job_worker_loop, js->workers + i)) {
+      _job_system_stop(js);
+      return false;
     }
+    ++js->thread_count;
   }
 
-  return ret;
+  return true;
+}
 
+static void
+job_system_free(job_system_t* js) {
+  _job_system_stop(js);
 }
 
+static void
+job_add(job_system_t* js, job_callback_f* callback, void* data, job_counter_t* counter) {
+  if (counter) {
+    u32_atomic_add(&counter->value, 1);
+  }
 
+  _job_t job = { callback, data, counter };
+  _job_worker_t* w = _job_current_worker;
 
-static b32_t
-_json_insert_entry(json_t* t, _json_entry_t** entry, _json_entry_t* new_entry) {
-  if ((*entry) == nullptr) {
-    (*entry) = new_entry; 
-    return true;
+  // @note: If we are not one of the job system's threads or our deque is
+  // full, just run the job right here. 
+  if (!w || w->js != js || !_job_deque_push(&w->deque, &job)) {
+    _job_run(&job);
+    return;
   }
-  else {
-    _json_entry_t* itr = (*entry);
-    while(itr != nullptr) {
-      buf_t lhs = buf_set(itr->key.at, itr->key.size);
-      buf_t rhs = buf_set(new_entry->key.at, new_entry->key.size);
-
-      smi_t cmp = buf_compare_lexographically(lhs, rhs);
-      if (cmp > 0) {
-        if (itr->left == nullptr) {
-          itr->left = new_entry;
-          return true;
-        }
-        else {
-          itr = itr->left;
-        }
-      }
-      else if (cmp < 0) {
-        if (itr->right == nullptr) {
-          itr->right = new_entry;
-          return true;
-        }
-        else {
-          itr = itr->right;
-        }
-      }
-      else {
-        return false;
-      }
-    }
-    return false;
+
+  atomic_fence();
+  if (u32_atomic_load(&js->sleeper_count) > 0) {
+    semaphore_signal(&js->semaphore, 1);
   }
 }
 
 static b32_t
-_json_parse_array(json_array_t* arr, json_t* t, arena_t* ba) {
-  b32_t is_done = false;
-  u32_t expect_type = _JSON_EXPECT_TYPE_OPEN;
-  b32_t error = false;
-
-
-  while(!is_done) {
-    _json_token_t token = _json_next_token(t);
-
-    if (expect_type == _JSON_EXPECT_TYPE_OPEN) {
-      json_value_t v = {};
-      if(_json_set_value_based_on_token(t, &v, token, ba)) {
-        json_array_node_t* array_node = arena_push(json_array_node_t, ba); 
-        if (array_node) {
-          array_node->value = v;
-          _json_append_array(arr, array_node);
+job_is_done(job_counter_t* counter) {
+  return u32_atomic_load(&counter->value) == 0;
+}
 
-        }
-        else {
-          is_done = true;
-          error = true;
-        }
-      }
-      else {
-        is_done = true;
-        error = true;
-      }
-      expect_type = _JSON_EXPECT_TYPE_KEY_OR_CLOSE;
+static void
+job_wait(job_system_t* js, job_counter_t* counter) {
+  _job_worker_t* w = _job_current_worker;
+  if (w && w->js != js) w = nullptr;
+
+  // @note: A thread that is not one of our workers has no deque,
+  // but it can still steal jobs from the workers' deques.
+  while(!job_is_done(counter)) {
+    _job_t job;
+    b32_t found = w ? _job_find(w, &job) : _job_steal(js, 0, js->worker_count, &job);
+    if (found) {
+      _job_run(&job);
     }
-    else if (expect_type == _JSON_EXPECT_TYPE_KEY_OR_CLOSE) {
-      if (token.type == _JSON_TOKEN_TYPE_COMMA) {
-        expect_type = _JSON_EXPECT_TYPE_OPEN;
-      }
-      else if (token.type == _JSON_TOKEN_TYPE_CLOSE_BRACKET) {
-        is_done = true;
-      }
-      else {
-        is_done = true;
-        error = true;
-      }
+    else {
+      thread_yield();
     }
   }
+}
+
+//
+// @mark:(Foolish)
+//
+#ifdef MOMO_FOOLISH // FOOLISH
+#include <stdlib.h>
+#include <stdio.h>
+// These are foolish methods that should ideally not make 
+// it into any SERIOUS projects. They are meant to be dumb
+// but convienient for trying stuff out.
+//
+// @todo: Make this serious
 
-  return !error;
+static buf_t 
+foolish_allocate_memory(usz_t size) {
+  return buf_set((u8_t*)malloc(size), size);
 }
 
-static b32_t 
-_json_set_value_based_on_token(
-    json_t* t, 
-    json_value_t* value, 
-    _json_token_t token, 
-    arena_t* ba) 
-{
-  b32_t error = false;
-  if (token.type == _JSON_TOKEN_TYPE_NUMBER) {
-    value->type = JSON_VALUE_TYPE_NUMBER;
-    value->element.at = token.at;
-    value->element.size = token.size;
-  }
-  else if(token.type == _JSON_TOKEN_TYPE_STRING) 
-  {
-    value->type = JSON_VALUE_TYPE_STRING;
-    value->element.at = token.at;
-    value->element.size = token.size;
-  }
-  else if (token.type == _JSON_TOKEN_TYPE_NULL) {
-    value->type = JSON_VALUE_TYPE_NULL;
-    value->element.at = token.at;
-    value->element.size = token.size;
-  }
-  else if (token.type == _JSON_TOKEN_TYPE_FALSE) {
-    value->type = JSON_VALUE_TYPE_FALSE;
-    value->element.at = token.at;
-    value->element.size = token.size;
-  }
-  else if (token.type == _JSON_TOKEN_TYPE_TRUE) {
-    value->type = JSON_VALUE_TYPE_TRUE;
-    value->element.at = token.at;
-    value->element.size = token.size;
-  }
-  else if (token.type == _JSON_TOKEN_TYPE_OPEN_BRACE) { // Parse json object
-    if (_json_parse_object(&value->object, t, ba)) {
-      value->type = JSON_VALUE_TYPE_OBJECT;
-    }
-    else {
-      error = true; 
-    }
-  }
-  else if (token.type == _JSON_TOKEN_TYPE_OPEN_BRACKET) {
-    if (_json_parse_array(&value->array, t, ba)) {
-      value->type = JSON_VALUE_TYPE_ARRAY;
-    }
-    else {
-      error = true;
-    }
-  }
-  return !error;
+static void
+foolish_free_memory(buf_t blk) {
+  free(blk.e);
 }
 
-static b32_t  
-_json_parse_object(json_object_t* obj, json_t* t, arena_t* ba) {
-  _json_entry_t* entry = nullptr;
-  _json_expect_type_t expect_type = _JSON_EXPECT_TYPE_KEY_OR_CLOSE; 
-  b32_t is_done = false;
+static arena_t 
+foolish_allocate_arena(usz_t size) {
+  arena_t ret = {};
+  arena_init(&ret, foolish_allocate_memory(size));
+  return ret;
+}
 
-  _json_entry_t* current_entry = nullptr;
+static b32_t
+foolish_write_buf_to_file(const char* filename, buf_t buffer) {
+  FILE *file = fopen(filename, "wb");
+  if (!file) return false;
+  defer { fclose(file); };
 
-  while(!is_done) {
-    _json_token_t token = _json_next_token(t);
-    if (token.type == _JSON_TOKEN_TYPE_UNKNOWN) return false;
+  fwrite(buffer.e, 1, buffer.size, file);
+  return true;
+}
 
-    switch(expect_type) {
-      case _JSON_EXPECT_TYPE_KEY_OR_CLOSE: {
-        if (token.type == _JSON_TOKEN_TYPE_STRING) {
-          current_entry = arena_push(_json_entry_t, ba);
-          if (!current_entry) {
-            is_done = true;
-          }
-          else {
-            current_entry->key.at = token.at;
-            current_entry->key.size = token.size;
-            expect_type = _JSON_EXPECT_TYPE_COLON;
-          }
-        }
-        else if(token.type == _JSON_TOKEN_TYPE_CLOSE_BRACE) {
-          is_done = true;
-        }
-        else {
-          return false;
-        }
-      } break;
-      case _JSON_EXPECT_TYPE_COLON: {
-        if ( token.type == _JSON_TOKEN_TYPE_COLON ) {
-          expect_type = _JSON_EXPECT_TYPE_VALUE; 
-        }
-        else {
-          return false;
-        }
-      } break;
-      case _JSON_EXPECT_TYPE_VALUE: {
-        if (_json_set_value_based_on_token(t, &current_entry->value, token, ba)) {
-          _json_insert_entry(t, &entry, current_entry);
-        }
-        else {
-          return false;
-        }
 
-        expect_type = _JSON_EXPECT_TYPE_COMMA_OR_CLOSE;
+static buf_t 
+foolish_read_file_into_buffer(const char* filename, b32_t null_terminate = false) {
+  FILE *file = fopen(filename, "rb");
 
+  if (!file) return buf_set(0,0);
+  defer { fclose(file); };
 
-      } break;
-      case _JSON_EXPECT_TYPE_COMMA_OR_CLOSE:{
-        if (token.type == _JSON_TOKEN_TYPE_COMMA) {
-          expect_type = _JSON_EXPECT_TYPE_KEY_OR_CLOSE;
-        }
-        if (token.type == _JSON_TOKEN_TYPE_CLOSE_BRACE) {
-          is_done = true; 
-        }
-      } break;
-      case _JSON_EXPECT_TYPE_OPEN: {} break;
-    }
-  }
+  fseek(file, 0, SEEK_END);
+  usz_t file_size = ftell(file) ;
+  fseek(file, 0, SEEK_SET);
 
-  obj->head = entry; 
-  return true;
-}
 
-#if JSON_DEBUG 
-#include <stdio.h>
+  buf_t ret = memory_allocate(file_size + null_terminate);
+  usz_t read_amount = fread(ret.e, 1, file_size, file);
 
-static u32_t sccount = 0;
-static void _json_print_entries_in_order(json_t* t,  _json_entry_t* entry);
+  if(read_amount != file_size) return buf_bad();
 
-static void
-_json_print_token(json_t* t, _json_token_t token)  {
-#if 0
-  switch(token.type) {
-    case _JSON_TOKEN_TYPE_OPEN_PAREN: 
-    case _JSON_TOKEN_TYPE_CLOSE_PAREN:
-    case _JSON_TOKEN_TYPE_SEMICOLON:
-    case _JSON_TOKEN_TYPE_COLON:
-    case _JSON_TOKEN_TYPE_COMMA:
-    case _JSON_TOKEN_TYPE_OPEN_BRACKET:
-    case _JSON_TOKEN_TYPE_CLOSE_BRACKET:
-    case _JSON_TOKEN_TYPE_OPEN_BRACE:
-    case _JSON_TOKEN_TYPE_CLOSE_BRACE:{
-      printf("token: ");
-    } break;
-    case _JSON_TOKEN_TYPE_IDENTIFIER: {
-      printf("identifier: ");
-    } break;
-    case _JSON_TOKEN_TYPE_STRING: {
-      printf("string: ");
-    } break;
-    case _JSON_TOKEN_TYPE_EOF: {
-      printf("eof");
-    } break;
-    case _JSON_TOKEN_TYPE_UNKNOWN: {
-      printf("unknown: ");
-    } break;
+  if (null_terminate) ret.e[file_size] = 0;  
 
-  }
-#endif 
-  for(umi_t i = 0; i < token.size; ++i) {
-    printf("%c", token.at[i]);
-  }
+  return ret;
 }
 
+static void
+foolish_free_buffer(buf_t buffer) {
+  memory_free(buffer);
+}
+
+#endif // FOOLISH
+
+//
+// @note: json_read() works in two stages, like simdjson.
+//
+// The first stage (_json_scan) goes through the text 64 bytes at a time 
+// and finds the 'structural' characters: brackets, braces, colons, 
+// commas, the quotes around strings, and the first character of every
+// number, true, false and null. It works out which bytes are in strings
+// with bit tricks on 64-bit masks instead of going byte by byte, and it
+// checks the insides of strings (control characters and escapes) while
+// it's at it. It writes the positions of the structural characters into
+// a fixed size buffer, which the second stage empties before asking for
+// more, so the memory used doesn't depend on the size of the text.
+//
+// The second stage (_json_build_*) walks those positions and builds the 
+// values in the arena. It only looks at the text to check numbers and 
+// literals.
+//
+// On top of RFC 8259, we accept // and /* */ comments and trailing 
+// commas, since most of our JSON files are written by hand. Comments 
+// are rare enough that once we see a '/' outside of a string, the rest 
+// of the text is scanned byte by byte. 
+//
+// Strings are not unescaped; json_element_t points at the text between
+// the quotes. The root has to be an object. Trailing zeroes are ignored 
+// so that a null-terminated buffer can be passed in with its terminator.
+//
+#define _JSON_MAX_DEPTH 1024
+#define _JSON_SCAN_BLOCK_SIZE 64
+#define _JSON_SCAN_INDEX_CAP 4096 // multiple of _JSON_SCAN_BLOCK_SIZE
+
+struct _json_entry_t {
+  json_key_t key;
+  json_value_t value;
+  _json_entry_t* next;
+};
+typedef hashmap_t<buf_t, _json_entry_t*> _json_index_t;
+
+// @note: Each bit in these masks is a byte in the block.
+struct _json_scan_masks_t {
+  u64_t quote;
+  u64_t backslash;
+  u64_t op;         // {}[]:,
+  u64_t whitespace;
+  u64_t control;    // below 0x20
+  u64_t slash;
+};
+
+struct _json_scanner_t {
+  const u8_t* text;
+  usz_t size;
+  usz_t pos;        // start of the next block to scan
+
+  // carried over from the previous block
+  u64_t prev_in_string; // all 1s or all 0s
+  u64_t prev_escaped;   // 1 if the first byte of the next block is escaped
+  u64_t prev_scalar;    // 1 if the last byte of the previous block is part of a number or literal
+
+  b32_t is_byte_by_byte;
+  u32_t comment;        // _JSON_COMMENT_*
+
+  u32_t* indices;
+  u32_t index_count;
+  u32_t index_at;
+  b32_t is_error;
+  usz_t error_at;
+};
+
+enum {
+  _JSON_COMMENT_NONE,
+  _JSON_COMMENT_LINE,
+  _JSON_COMMENT_BLOCK,
+};
+
+static void
+_json_append_array(json_array_t* arr, json_array_node_t* node) {
+  sll_append(arr->head, arr->tail, node); 
+}
+
+static b32_t
+_json_is_hex(u8_t c) {
+  return u8_is_digit(c) || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F');
+}
+
+static b32_t
+_json_is_whitespace(u8_t c) {
+  return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+static b32_t
+_json_is_op(u8_t c) {
+  return c == '{' || c == '}' || c == '[' || c == ']' || c == ':' || c == ',';
+}
+
+static void
+_json_scan_error(_json_scanner_t* s, usz_t at) {
+  if (!s->is_error) {
+    s->is_error = true;
+    s->error_at = at;
+  }
+}
+
+// @note: Checks the escape sequence whose first character after the 
+// backslash is at 'at'.
+static b32_t
+_json_scan_is_valid_escape(_json_scanner_t* s, usz_t at) {
+  if (at >= s->size) return false;
+  switch(s->text[at]) {
+    case '"': case '\\': case '/': 
+    case 'b': case 'f': case 'n': case 'r': case 't': 
+      return true;
+    case 'u': 
+      return at + 4 < s->size &&
+        _json_is_hex(s->text[at+1]) && _json_is_hex(s->text[at+2]) &&
+        _json_is_hex(s->text[at+3]) && _json_is_hex(s->text[at+4]);
+  }
+  return false;
+}
+
+static _json_scan_masks_t
+_json_scan_classify(const u8_t* block) {
+  _json_scan_masks_t ret = {};
+#if MOMO_SSE2
+  const __m128i quote = _mm_set1_epi8('"');
+  const __m128i backslash = _mm_set1_epi8('\\');
+  const __m128i slash = _mm_set1_epi8('/');
+  const __m128i open_brace = _mm_set1_epi8('{');
+  const __m128i close_brace = _mm_set1_epi8('}');
+  const __m128i colon = _mm_set1_epi8(':');
+  const __m128i comma = _mm_set1_epi8(',');
+  const __m128i space = _mm_set1_epi8(' ');
+  const __m128i tab = _mm_set1_epi8('\t');
+  const __m128i newline = _mm_set1_epi8('\n');
+  const __m128i carriage = _mm_set1_epi8('\r');
+  const __m128i lowercase_bit = _mm_set1_epi8(0x20);
+  const __m128i max_control = _mm_set1_epi8(0x1F);
+  for (u32_t i = 0; i < 4; ++i) {
+    __m128i c = _mm_loadu_si128((const __m128i*)(block + i * 16));
+    u32_t shift = i * 16;
+
+    // @note: '[' | 0x20 == '{' and ']' | 0x20 == '}', and ':' and ',' 
+    // already have that bit set.
+    __m128i lower = _mm_or_si128(c, lowercase_bit);
+    __m128i op = _mm_or_si128(
+        _mm_or_si128(_mm_cmpeq_epi8(lower, open_brace), _mm_cmpeq_epi8(lower, close_brace)),
+        _mm_or_si128(_mm_cmpeq_epi8(c, colon), _mm_cmpeq_epi8(c, comma)));
+    __m128i ws = _mm_or_si128(
+        _mm_or_si128(_mm_cmpeq_epi8(c, space), _mm_cmpeq_epi8(c, tab)),
+        _mm_or_si128(_mm_cmpeq_epi8(c, newline), _mm_cmpeq_epi8(c, carriage)));
+    __m128i control = _mm_cmpeq_epi8(_mm_max_epu8(c, max_control), max_control);
+
+    ret.quote |= (u64_t)(u32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(c, quote)) << shift;
+    ret.backslash |= (u64_t)(u32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(c, backslash)) << shift;
+    ret.slash |= (u64_t)(u32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(c, slash)) << shift;
+    ret.op |= (u64_t)(u32_t)_mm_movemask_epi8(op) << shift;
+    ret.whitespace |= (u64_t)(u32_t)_mm_movemask_epi8(ws) << shift;
+    ret.control |= (u64_t)(u32_t)_mm_movemask_epi8(control) << shift;
+  }
+#else
+  for (u32_t i = 0; i < _JSON_SCAN_BLOCK_SIZE; ++i) {
+    u8_t c = block[i];
+    u64_t bit = 1ull << i;
+    if (c == '"') ret.quote |= bit;
+    if (c == '\\') ret.backslash |= bit;
+    if (c == '/') ret.slash |= bit;
+    if (_json_is_op(c)) ret.op |= bit;
+    if (_json_is_whitespace(c)) ret.whitespace |= bit;
+    if (c < 0x20) ret.control |= bit;
+  }
+#endif
+  return ret;
+}
+
+// @note: Returns the bits of the characters that come right after an
+// odd number of backslashes, i.e. the characters that are escaped.
+// This is simdjson's find_escaped().
+static u64_t
+_json_scan_find_escaped(_json_scanner_t* s, u64_t backslash) {
+  if (!backslash) {
+    u64_t escaped = s->prev_escaped;
+    s->prev_escaped = 0;
+    return escaped;
+  }
+  backslash &= ~s->prev_escaped;
+  u64_t follows_escape = backslash << 1 | s->prev_escaped;
+  const u64_t even_bits = 0x5555555555555555ull;
+  u64_t odd_sequence_starts = backslash & ~even_bits & ~follows_escape;
+  u64_t sequences_starting_on_even_bits = odd_sequence_starts + backslash;
+  s->prev_escaped = sequences_starting_on_even_bits < odd_sequence_starts;
+  u64_t invert_mask = sequences_starting_on_even_bits << 1;
+  return (even_bits ^ invert_mask) & follows_escape;
+}
+
+// @note: Each bit becomes the xor of itself and all the bits below it,
+// so everything from an opening quote up to (but not including) the 
+// closing quote is set.
+static u64_t
+_json_scan_prefix_xor(u64_t bits) {
+  bits ^= bits << 1;
+  bits ^= bits << 2;
+  bits ^= bits << 4;
+  bits ^= bits << 8;
+  bits ^= bits << 16;
+  bits ^= bits << 32;
+  return bits;
+}
+
+// @note: Returns false if the block has a '/' outside of a string, 
+// in which case nothing is written and the scanner's state is left 
+// as it was before the block.
+static b32_t
+_json_scan_block(_json_scanner_t* s, const u8_t* block, usz_t block_pos) {
+  _json_scan_masks_t m = _json_scan_classify(block);
+
+  u64_t prev_escaped = s->prev_escaped;
+  u64_t escaped = _json_scan_find_escaped(s, m.backslash);
+  u64_t quote = m.quote & ~escaped;
+  u64_t in_string = _json_scan_prefix_xor(quote) ^ s->prev_in_string;
+  u64_t string_span = in_string | quote; 
+  u64_t string_insides = in_string & ~quote;
+
+  if (m.slash & ~string_span) {
+    s->prev_escaped = prev_escaped;
+    return false;
+  }
+
+  if (m.control & string_insides) {
+    _json_scan_error(s, block_pos + u64_ctz(m.control & string_insides));
+  }
+  for (u64_t bits = escaped & string_insides; bits; bits &= bits - 1) {
+    usz_t at = block_pos + u64_ctz(bits);
+    if (!_json_scan_is_valid_escape(s, at)) 
+      _json_scan_error(s, at);
+  }
+
+  u64_t scalar = ~(m.op | m.whitespace | string_span);
+  u64_t scalar_start = scalar & ~(scalar << 1 | s->prev_scalar);
+  u64_t structurals = (m.op & ~string_span) | quote | scalar_start;
+
+  s->prev_in_string = (u64_t)((s64_t)in_string >> 63);
+  s->prev_scalar = scalar >> 63;
+
+  u32_t* indices = s->indices + s->index_count;
+  u32_t count = 0;
+  for (; structurals; structurals &= structurals - 1) {
+    indices[count++] = (u32_t)(block_pos + u64_ctz(structurals));
+  }
+  s->index_count += count;
+  return true;
+}
+
+// @note: The slow path, for when there are comments. Same output as 
+// _json_scan_block(), plus it skips comments.
+static void
+_json_scan_block_byte_by_byte(_json_scanner_t* s, usz_t block_pos) {
+  b32_t in_string = s->prev_in_string != 0;
+  b32_t escaped = s->prev_escaped != 0;
+  b32_t prev_scalar = s->prev_scalar != 0;
+  usz_t end = min_of(block_pos + _JSON_SCAN_BLOCK_SIZE, s->size);
+
+  for (usz_t at = block_pos; at < end; ++at) {
+    u8_t c = s->text[at];
+    if (s->comment == _JSON_COMMENT_LINE) {
+      if (c == '\n' || c == '\r') s->comment = _JSON_COMMENT_NONE;
+      prev_scalar = false;
+      continue;
+    }
+    if (s->comment == _JSON_COMMENT_BLOCK) {
+      if (c == '*' && at + 1 < s->size && s->text[at+1] == '/') {
+        s->comment = _JSON_COMMENT_NONE;
+        ++at;
+        // @note: the '/' could be the first byte of the next block
+        if (at >= end) end = at + 1;
+      }
+      prev_scalar = false;
+      continue;
+    }
+
+    // @note: Like in _json_scan_block(), a backslash escapes the next
+    // character even outside of strings, where it's an error anyway.
+    b32_t is_escaped = escaped;
+    escaped = !is_escaped && c == '\\';
+
+    if (in_string) {
+      if (is_escaped) {
+        if (!_json_scan_is_valid_escape(s, at)) _json_scan_error(s, at);
+      }
+      else if (c == '"') {
+        in_string = false;
+        s->indices[s->index_count++] = (u32_t)at;
+      }
+      else if (c < 0x20) _json_scan_error(s, at);
+      prev_scalar = false;
+    }
+    else if (c == '"' && !is_escaped) {
+      in_string = true;
+      s->indices[s->index_count++] = (u32_t)at;
+      prev_scalar = false;
+    }
+    else if (c == '/') {
+      if (at + 1 < s->size && (s->text[at+1] == '/' || s->text[at+1] == '*')) {
+        s->comment = s->text[at+1] == '/' ? _JSON_COMMENT_LINE : _JSON_COMMENT_BLOCK;
+        ++at;
+        if (at >= end) end = at + 1;
+      }
+      else {
+        _json_scan_error(s, at);
+      }
+      prev_scalar = false;
+    }
+    else if (_json_is_op(c)) {
+      s->indices[s->index_count++] = (u32_t)at;
+      prev_scalar = false;
+    }
+    else if (_json_is_whitespace(c)) {
+      prev_scalar = false;
+    }
+    else {
+      if (!prev_scalar) s->indices[s->index_count++] = (u32_t)at;
+      prev_scalar = true;
+    }
+  }
+
+  s->prev_in_string = in_string ? U64_MAX : 0;
+  s->prev_escaped = escaped;
+  s->prev_scalar = prev_scalar;
+  s->pos = end;
+}
+
+// @note: Refills the scanner's indices. At the end of the text, the 
+// size of the text is added as a stand-in for the end.
+static void
+_json_scan(_json_scanner_t* s) {
+  s->index_count = 0;
+  s->index_at = 0;
+
+  // @note: leave room for a whole block since every byte can be structural
+  while (s->pos < s->size && s->index_count + _JSON_SCAN_BLOCK_SIZE <= _JSON_SCAN_INDEX_CAP) {
+    if (!s->is_byte_by_byte) {
+      const u8_t* block = s->text + s->pos;
+      u8_t padded[_JSON_SCAN_BLOCK_SIZE];
+      if (s->size - s->pos < _JSON_SCAN_BLOCK_SIZE) {
+        for (u32_t i = 0; i < _JSON_SCAN_BLOCK_SIZE; ++i)
+          padded[i] = s->pos + i < s->size ? s->text[s->pos + i] : ' ';
+        block = padded;
+      }
+      if (_json_scan_block(s, block, s->pos)) {
+        s->pos += _JSON_SCAN_BLOCK_SIZE;
+        continue;
+      }
+      s->is_byte_by_byte = true;
+    }
+    _json_scan_block_byte_by_byte(s, s->pos);
+  }
+
+  if (s->pos >= s->size) {
+    if (s->prev_in_string) _json_scan_error(s, s->size);
+    if (s->comment == _JSON_COMMENT_BLOCK) _json_scan_error(s, s->size);
+    s->indices[s->index_count++] = (u32_t)s->size;
+  }
+}
+
+static void
+_json_scan_begin(_json_scanner_t* s, const u8_t* text, usz_t size, u32_t* indices) {
+  *s = {};
+  s->text = text;
+  s->size = size;
+  s->indices = indices;
+}
+
+static usz_t
+_json_scan_next(_json_scanner_t* s) {
+  if (s->index_at == s->index_count) {
+    // @note: keep on returning the end once we are there
+    if (s->pos >= s->size && s->index_count > 0) 
+      return s->size;
+    _json_scan(s);
+  }
+  return s->indices[s->index_at++];
+}
+
+struct _json_builder_t {
+  _json_scanner_t scanner;
+  arena_t* arena;
+  b32_t is_error;
+  usz_t error_at;
+};
+
+static b32_t
+_json_build_fail(_json_builder_t* b, usz_t at) {
+  if (!b->is_error) {
+    b->is_error = true;
+    b->error_at = at;
+  }
+  return false;
+}
+
+// @note: a number or literal has to be followed by something that 
+// ends it, otherwise "truex" and "1x" would be accepted
+static b32_t
+_json_build_is_end_of_scalar(_json_builder_t* b, usz_t at) {
+  if (at >= b->scanner.size) return true;
+  u8_t c = b->scanner.text[at];
+  return _json_is_whitespace(c) || _json_is_op(c) || c == '"' || c == '/';
+}
+
+static b32_t
+_json_build_literal(_json_builder_t* b, usz_t at, const c8_t* literal, usz_t literal_size) {
+  if (b->scanner.size - at < literal_size) return false;
+  if (!memory_is_same(b->scanner.text + at, literal, literal_size)) return false;
+  return _json_build_is_end_of_scalar(b, at + literal_size);
+}
+
+// @note: Returns how many characters at the start of 'text' make a
+// number, or 0 if they don't.
+//   -?(0|[1-9][0-9]*)(\.[0-9]+)?([eE][+-]?[0-9]+)?
+static usz_t
+_json_number_size(const u8_t* text, usz_t size) {
+  usz_t at = 0;
+  if (at < size && text[at] == '-') ++at;
+  if (at >= size || !u8_is_digit(text[at])) return 0;
+  if (text[at] == '0') ++at;
+  else while (at < size && u8_is_digit(text[at])) ++at;
+
+  if (at < size && text[at] == '.') {
+    ++at;
+    if (at >= size || !u8_is_digit(text[at])) return 0;
+    while (at < size && u8_is_digit(text[at])) ++at;
+  }
+  if (at < size && (text[at] == 'e' || text[at] == 'E')) {
+    ++at;
+    if (at < size && (text[at] == '+' || text[at] == '-')) ++at;
+    if (at >= size || !u8_is_digit(text[at])) return 0;
+    while (at < size && u8_is_digit(text[at])) ++at;
+  }
+  return at;
+}
+
+static usz_t
+_json_build_number(_json_builder_t* b, usz_t at) {
+  usz_t size = _json_number_size(b->scanner.text + at, b->scanner.size - at);
+  if (size == 0 || !_json_build_is_end_of_scalar(b, at + size)) return 0;
+  return size;
+}
+
+static b32_t _json_build_value(_json_builder_t* b, usz_t at, json_value_t* value, u32_t depth);
+
+static b32_t
+_json_build_string(_json_builder_t* b, usz_t at, json_element_t* element) {
+  usz_t close = _json_scan_next(&b->scanner);
+  if (close >= b->scanner.size) return _json_build_fail(b, at);
+  element->at = (u8_t*)b->scanner.text + at + 1;
+  element->size = close - at - 1;
+  return true;
+}
+
+static b32_t
+_json_build_array(_json_builder_t* b, json_array_t* arr, u32_t depth) {
+  *arr = {};
+  usz_t at = _json_scan_next(&b->scanner);
+  if (at < b->scanner.size && b->scanner.text[at] == ']') return true;
+
+  for (;;) {
+    json_array_node_t* node = arena_push_zero(json_array_node_t, b->arena);
+    if (!node) return _json_build_fail(b, at);
+    if (!_json_build_value(b, at, &node->value, depth)) return false;
+    _json_append_array(arr, node);
+    ++arr->count;
+
+    at = _json_scan_next(&b->scanner);
+    if (at >= b->scanner.size) return _json_build_fail(b, at);
+    if (b->scanner.text[at] == ']') return true;
+    if (b->scanner.text[at] != ',') return _json_build_fail(b, at);
+
+    at = _json_scan_next(&b->scanner);
+    if (at < b->scanner.size && b->scanner.text[at] == ']') return true; 
+  }
+}
+
+static b32_t
+_json_build_object_index(_json_builder_t* b, json_object_t* obj) {
+  auto* index = arena_push(_json_index_t, b->arena);
+  if (!index || !hashmap_init(index, b->arena, obj->count)) return false;
+  for (_json_entry_t* itr = obj->head; itr; itr = itr->next) {
+    buf_t key = buf_set(itr->key.at, itr->key.size);
+    // @note: the first of duplicate keys wins, same as without an index
+    if (!hashmap_get(index, key) && !hashmap_set(index, key, itr)) return false;
+  }
+  obj->index = index;
+  return true;
+}
+
+static b32_t
+_json_build_object(_json_builder_t* b, json_object_t* obj, u32_t depth) {
+  *obj = {};
+  usz_t at = _json_scan_next(&b->scanner);
+  if (at < b->scanner.size && b->scanner.text[at] == '}') return true;
+
+  for (;;) {
+    if (at >= b->scanner.size || b->scanner.text[at] != '"') return _json_build_fail(b, at);
+    _json_entry_t* entry = arena_push_zero(_json_entry_t, b->arena);
+    if (!entry) return _json_build_fail(b, at);
+    json_element_t key;
+    if (!_json_build_string(b, at, &key)) return false;
+    entry->key.at = key.at;
+    entry->key.size = key.size;
+
+    at = _json_scan_next(&b->scanner);
+    if (at >= b->scanner.size || b->scanner.text[at] != ':') return _json_build_fail(b, at);
+    at = _json_scan_next(&b->scanner);
+    if (!_json_build_value(b, at, &entry->value, depth)) return false;
+    sll_append(obj->head, obj->tail, entry);
+    ++obj->count;
+
+    at = _json_scan_next(&b->scanner);
+    if (at >= b->scanner.size) return _json_build_fail(b, at);
+    if (b->scanner.text[at] == '}') break;
+    if (b->scanner.text[at] != ',') return _json_build_fail(b, at);
+
+    at = _json_scan_next(&b->scanner);
+    if (at < b->scanner.size && b->scanner.text[at] == '}') break; 
+  }
+
+  if (obj->count > JSON_OBJECT_INDEX_THRESHOLD) {
+    if (!_json_build_object_index(b, obj)) return _json_build_fail(b, at);
+  }
+  return true;
+}
+
+static b32_t
+_json_build_value(_json_builder_t* b, usz_t at, json_value_t* value, u32_t depth) {
+  if (at >= b->scanner.size) return _json_build_fail(b, at);
+
+  value->element.at = (u8_t*)b->scanner.text + at;
+  switch(b->scanner.text[at]) {
+    case '{': {
+      if (depth >= _JSON_MAX_DEPTH) return _json_build_fail(b, at);
+      value->type = JSON_VALUE_TYPE_OBJECT;
+      return _json_build_object(b, &value->object, depth + 1);
+    } 
+    case '[': {
+      if (depth >= _JSON_MAX_DEPTH) return _json_build_fail(b, at);
+      value->type = JSON_VALUE_TYPE_ARRAY;
+      return _json_build_array(b, &value->array, depth + 1);
+    } 
+    case '"': {
+      value->type = JSON_VALUE_TYPE_STRING;
+      return _json_build_string(b, at, &value->element);
+    } 
+    case 't': {
+      value->type = JSON_VALUE_TYPE_TRUE;
+      value->element.size = 4;
+      return _json_build_literal(b, at, "true", 4) || _json_build_fail(b, at);
+    }
+    case 'f': {
+      value->type = JSON_VALUE_TYPE_FALSE;
+      value->element.size = 5;
+      return _json_build_literal(b, at, "false", 5) || _json_build_fail(b, at);
+    }
+    case 'n': {
+      value->type = JSON_VALUE_TYPE_NULL;
+      value->element.size = 4;
+      return _json_build_literal(b, at, "null", 4) || _json_build_fail(b, at);
+    }
+    default: {
+      value->type = JSON_VALUE_TYPE_NUMBER;
+      value->element.size = _json_build_number(b, at);
+      return value->element.size > 0 || _json_build_fail(b, at);
+    }
+  }
+}
+
+#if JSON_DEBUG 
+#include <stdio.h>
+
+static u32_t sccount = 0;
+static void _json_print_entries_in_order(json_t* t,  _json_entry_t* entry);
+
 static void
 _json_print_value(json_t* t, json_value_t* value) {
   switch(value->type) {
@@ -2551,14 +3475,8 @@ _json_print_value(json_t* t, json_value_t* value) {
 static void 
 _json_print_entries_in_order(json_t* t, _json_entry_t* entry) 
 {
-  if (entry == nullptr) 
-  {
-    return;
-  }
-  else 
+  for (; entry != nullptr; entry = entry->next) 
   {
-    _json_print_entries_in_order(t, entry->left);
-
     for(u32_t i = 0; i < sccount; ++i) 
     {
       printf(" ");
@@ -2573,31 +3491,21 @@ _json_print_entries_in_order(json_t* t, _json_entry_t* entry)
     _json_print_value(t, &entry->value);
 
     printf("\n");
-
-    _json_print_entries_in_order(t, entry->right);
   }
 }
 #endif // JSON_DEBUG
 
 static _json_entry_t* 
 _json_get(json_object_t* json_object, buf_t key) {
-  _json_entry_t* node = json_object->head;
-  while(node) {
-    buf_t lhs = buf_set(node->key.at, node->key.size);
-    buf_t rhs = buf_set(key.e, key.size);
-    smi_t cmp = buf_compare_lexographically(lhs, rhs); 
-    if (cmp > 0) {
-      node = node->left;
-    }
-    else if (cmp < 0) {
-      node = node->right;
-    }
-    else {
-      return node;
-    }
+  if (json_object->index) {
+    _json_entry_t** entry = hashmap_get(json_object->index, key);
+    return entry ? *entry : nullptr;
   }
-
-  return node;
+  for (_json_entry_t* itr = json_object->head; itr; itr = itr->next) {
+    if (itr->key.size == key.size && memory_is_same(itr->key.at, key.e, key.size)) 
+      return itr;
+  }
+  return nullptr;
 }
 
 static json_value_t* 
@@ -2662,15 +3570,38 @@ static json_object_t* json_get_object(json_value_t* val) {
 static json_object_t*
 json_read(
     json_t* j, 
-    u8_t* json_string, 
+    const u8_t* json_string, 
     u32_t json_string_size, 
     arena_t* ba) 
 {
-  j->text = buf_set(json_string, json_string_size);
-  j->at = 0;
-  _json_token_t token = _json_next_token(j);
-  if (token.type != _JSON_TOKEN_TYPE_OPEN_BRACE) return nullptr;
-  if (!_json_parse_object(&j->root, j, ba)) return nullptr;
+  while (json_string_size > 0 && json_string[json_string_size-1] == 0) 
+    --json_string_size;
+  j->text = buf_set((u8_t*)json_string, json_string_size);
+  j->root = {};
+  j->error_at = 0;
+
+  u32_t* indices = arena_push_arr(u32_t, ba, _JSON_SCAN_INDEX_CAP);
+  if (!indices) return nullptr;
+
+  _json_builder_t b = {};
+  b.arena = ba;
+  _json_scan_begin(&b.scanner, json_string, json_string_size, indices);
+
+  usz_t at = _json_scan_next(&b.scanner);
+  if (at >= json_string_size || json_string[at] != '{') {
+    _json_build_fail(&b, at);
+  }
+  else if (_json_build_object(&b, &j->root, 1)) {
+    // @note: nothing but whitespace and comments after the root
+    at = _json_scan_next(&b.scanner);
+    if (at != json_string_size) _json_build_fail(&b, at);
+  }
+
+  if (b.is_error || b.scanner.is_error) {
+    if (b.is_error && b.scanner.is_error) j->error_at = min_of(b.error_at, b.scanner.error_at);
+    else j->error_at = b.is_error ? b.error_at : b.scanner.error_at;
+    return nullptr;
+  }
 
   // print the node in order
 #if JSON_DEBUG
@@ -2680,42 +3611,458 @@ json_read(
   return &j->root;
 }
 
+//
+// @note: json_reader_t goes through the text byte by byte (except for 
+// the insides of strings) and keeps just enough state to pick up where
+// it left off when a chunk ends in the middle of a token.
+//
+enum {
+  _JSON_READER_TOKEN_NONE,
+  _JSON_READER_TOKEN_STRING,
+  _JSON_READER_TOKEN_SCALAR,             // number or literal
+  _JSON_READER_TOKEN_SLASH,              // has to be followed by '/' or '*'
+  _JSON_READER_TOKEN_LINE_COMMENT,
+  _JSON_READER_TOKEN_BLOCK_COMMENT,
+  _JSON_READER_TOKEN_BLOCK_COMMENT_STAR, // a '*' that could end the comment
+};
 
-static void
-_clex_eat_ignorables(clex_tokenizer_t* t) {
-  for (;;) {
-    if(u8_is_whitespace(t->text.e[t->at])) {
-      ++t->at;
-    }
-    else if(t->text.e[t->at] == '/' && t->text.e[t->at+1] == '/')  // line comments
-    {
-      while(t->text.e[t->at] != '\n') {
-        ++t->at;
-      }
-    }
-    else if(t->text.e[t->at] == '/' && t->text.e[t->at+1] == '*')  // block comments
-    {
-      t->at += 3;
-      while(t->text.e[t->at] != '*' && t->text.e[t->at+1] != '/') {
-        ++t->at;
-      }
+enum {
+  _JSON_READER_EXPECT_VALUE,
+  _JSON_READER_EXPECT_VALUE_OR_CLOSE,  // after '[' or ',' in an array
+  _JSON_READER_EXPECT_KEY_OR_CLOSE,    // after '{' or ',' in an object
+  _JSON_READER_EXPECT_COLON,
+  _JSON_READER_EXPECT_COMMA_OR_CLOSE,
+  _JSON_READER_EXPECT_NOTHING,         // the root is done
+  _JSON_READER_EXPECT_ERROR,
+};
 
-    }
-    else {
-      break;
-    }
-  }
+enum {
+  _JSON_READER_SCAN_MORE,
+  _JSON_READER_SCAN_DONE,
+  _JSON_READER_SCAN_ERROR,
+};
 
+static json_event_t
+_json_reader_event(json_event_type_t type, buf_t str = {}) {
+  json_event_t ret;
+  ret.type = type;
+  ret.str = str;
+  return ret;
 }
 
-static b32_t 
-_clex_is_accepted_character_for_number(char c) {
-  return c == '-' || c == '.' ||
-    c == 'b' || c == 'x' || c == 'l' || c == 'f' || c == 'p' || c == 'e' ||
-    c == 'B' || c == 'X' || c == 'L' || c == 'F' || c == 'P' || c == 'E';
+static json_event_t
+_json_reader_fail(json_reader_t* r) {
+  if (r->expect != _JSON_READER_EXPECT_ERROR) {
+    r->expect = _JSON_READER_EXPECT_ERROR;
+    r->error_at = r->chunk_offset + r->chunk_at;
+  }
+  return _json_reader_event(JSON_EVENT_TYPE_ERROR);
 }
 
-
+static b32_t
+_json_reader_is_in_object(json_reader_t* r) {
+  u32_t level = r->depth - 1;
+  return r->depth > 0 && (r->is_object[level / 64] >> (level % 64)) & 1;
+}
+
+static b32_t
+_json_reader_is_value_expected(json_reader_t* r) {
+  return r->expect == _JSON_READER_EXPECT_VALUE || r->expect == _JSON_READER_EXPECT_VALUE_OR_CLOSE;
+}
+
+static void
+_json_reader_end_value(json_reader_t* r) {
+  r->expect = r->depth == 0 ? _JSON_READER_EXPECT_NOTHING : _JSON_READER_EXPECT_COMMA_OR_CLOSE;
+}
+
+static json_event_t
+_json_reader_open(json_reader_t* r, b32_t is_object) {
+  if (!_json_reader_is_value_expected(r) || r->depth >= JSON_READER_MAX_DEPTH) 
+    return _json_reader_fail(r);
+
+  u32_t level = r->depth++;
+  u64_t bit = 1ull << (level % 64);
+  if (is_object) r->is_object[level / 64] |= bit;
+  else r->is_object[level / 64] &= ~bit;
+
+  ++r->chunk_at;
+  r->expect = is_object ? _JSON_READER_EXPECT_KEY_OR_CLOSE : _JSON_READER_EXPECT_VALUE_OR_CLOSE;
+  return _json_reader_event(is_object ? JSON_EVENT_TYPE_BEGIN_OBJECT : JSON_EVENT_TYPE_BEGIN_ARRAY);
+}
+
+static json_event_t
+_json_reader_close(json_reader_t* r, b32_t is_object) {
+  if (r->depth == 0 || _json_reader_is_in_object(r) != is_object) 
+    return _json_reader_fail(r);
+  u32_t close_expect = is_object ? _JSON_READER_EXPECT_KEY_OR_CLOSE : _JSON_READER_EXPECT_VALUE_OR_CLOSE;
+  if (r->expect != close_expect && r->expect != _JSON_READER_EXPECT_COMMA_OR_CLOSE) 
+    return _json_reader_fail(r);
+
+  --r->depth;
+  ++r->chunk_at;
+  _json_reader_end_value(r);
+  return _json_reader_event(is_object ? JSON_EVENT_TYPE_END_OBJECT : JSON_EVENT_TYPE_END_ARRAY);
+}
+
+static void
+_json_reader_begin_token(json_reader_t* r, u32_t token, usz_t token_start) {
+  r->token = token;
+  r->token_start = token_start;
+  r->escape = 0;
+  r->is_split = false;
+  r->scratch_size = 0;
+}
+
+// @note: Moves what we have of the current token to the scratch buffer
+// before the chunk goes away.
+static b32_t
+_json_reader_save_token(json_reader_t* r) {
+  usz_t size = r->chunk_size - r->token_start;
+  if (r->scratch_size + size > r->scratch.size) return false;
+  memory_copy(r->scratch.e + r->scratch_size, r->chunk + r->token_start, size);
+  r->scratch_size += size;
+  r->token_start = r->chunk_size;
+  r->is_split = true;
+  return true;
+}
+
+// @note: The token, which ends right before 'end' in the current chunk.
+static b32_t
+_json_reader_get_token(json_reader_t* r, usz_t end, buf_t* out) {
+  if (!r->is_split) {
+    *out = buf_set((u8_t*)r->chunk + r->token_start, end - r->token_start);
+    return true;
+  }
+  usz_t size = end - r->token_start;
+  if (r->scratch_size + size > r->scratch.size) return false;
+  memory_copy(r->scratch.e + r->scratch_size, r->chunk + r->token_start, size);
+  r->scratch_size += size;
+  *out = buf_set(r->scratch.e, r->scratch_size);
+  return true;
+}
+
+// @note: finds the first '"', '\\' or control character
+static const u8_t*
+_json_reader_skip_string(const u8_t* p, const u8_t* end) {
+#if MOMO_SSE2
+  const __m128i quote = _mm_set1_epi8('"');
+  const __m128i backslash = _mm_set1_epi8('\\');
+  const __m128i max_control = _mm_set1_epi8(0x1F);
+  while (end - p >= 16) {
+    __m128i c = _mm_loadu_si128((const __m128i*)p);
+    __m128i special = _mm_or_si128(
+        _mm_or_si128(_mm_cmpeq_epi8(c, quote), _mm_cmpeq_epi8(c, backslash)),
+        _mm_cmpeq_epi8(_mm_max_epu8(c, max_control), max_control));
+    u32_t mask = (u32_t)_mm_movemask_epi8(special);
+    if (mask) return p + u32_ctz(mask);
+    p += 16;
+  }
+#endif
+  while (p < end && *p != '"' && *p != '\\' && *p >= 0x20) ++p;
+  return p;
+}
+
+static u32_t
+_json_reader_scan_string(json_reader_t* r) {
+  const u8_t* p = r->chunk + r->chunk_at;
+  const u8_t* end = r->chunk + r->chunk_size;
+  u32_t ret = _JSON_READER_SCAN_MORE;
+  while (p < end) {
+    if (r->escape == 0) {
+      p = _json_reader_skip_string(p, end);
+      if (p == end) break;
+      if (*p == '"') { 
+        ret = _JSON_READER_SCAN_DONE;
+        break;
+      }
+      if (*p != '\\') {
+        ret = _JSON_READER_SCAN_ERROR;
+        break;
+      }
+      r->escape = 1;
+    }
+    else if (r->escape == 1) {
+      switch(*p) {
+        case '"': case '\\': case '/': 
+        case 'b': case 'f': case 'n': case 'r': case 't': 
+          r->escape = 0; 
+          break;
+        case 'u':
+          r->escape = 2;
+          break;
+        default: 
+          r->chunk_at = p - r->chunk;
+          return _JSON_READER_SCAN_ERROR;
+      }
+    }
+    else {
+      if (!_json_is_hex(*p)) {
+        ret = _JSON_READER_SCAN_ERROR;
+        break;
+      }
+      r->escape = r->escape == 5 ? 0 : r->escape + 1;
+    }
+    ++p;
+  }
+  r->chunk_at = p - r->chunk;
+  return ret;
+}
+
+static b32_t
+_json_reader_is_end_of_scalar(u8_t c) {
+  return _json_is_whitespace(c) || _json_is_op(c) || c == '"' || c == '/';
+}
+
+static json_event_t
+_json_reader_end_scalar(json_reader_t* r, usz_t end) {
+  buf_t str;
+  if (!_json_reader_get_token(r, end, &str)) return _json_reader_fail(r);
+  r->token = _JSON_READER_TOKEN_NONE;
+
+  json_event_type_t type = JSON_EVENT_TYPE_NUMBER;
+  b32_t is_valid = false;
+  switch(str.e[0]) {
+    case 't': {
+      type = JSON_EVENT_TYPE_TRUE;
+      is_valid = str.size == 4 && memory_is_same(str.e, "true", 4);
+    } break;
+    case 'f': {
+      type = JSON_EVENT_TYPE_FALSE;
+      is_valid = str.size == 5 && memory_is_same(str.e, "false", 5);
+    } break;
+    case 'n': {
+      type = JSON_EVENT_TYPE_NULL;
+      is_valid = str.size == 4 && memory_is_same(str.e, "null", 4);
+    } break;
+    default: {
+      is_valid = _json_number_size(str.e, str.size) == str.size;
+    }
+  }
+  if (!is_valid) return _json_reader_fail(r);
+  _json_reader_end_value(r);
+  return _json_reader_event(type, str);
+}
+
+static b32_t
+_json_reader_pull_file(json_reader_t* r) {
+  usz_t size = (usz_t)min_of((u64_t)r->file_chunk.size, r->file_size - r->file_offset);
+  if (size > 0) {
+    if (!file_read(r->file, r->file_chunk.e, size, r->file_offset)) return false;
+    r->file_offset += size;
+    json_reader_feed(r, r->file_chunk.e, size);
+  }
+  if (r->file_offset == r->file_size) 
+    json_reader_finish(r);
+  return true;
+}
+
+static json_event_t
+_json_reader_end_of_input(json_reader_t* r) {
+  switch(r->token) {
+    case _JSON_READER_TOKEN_SCALAR: 
+      return _json_reader_end_scalar(r, r->chunk_size);
+    case _JSON_READER_TOKEN_LINE_COMMENT:
+      r->token = _JSON_READER_TOKEN_NONE;
+      break;
+    case _JSON_READER_TOKEN_NONE: 
+      break;
+    default: 
+      return _json_reader_fail(r);
+  }
+  if (r->expect != _JSON_READER_EXPECT_NOTHING) return _json_reader_fail(r);
+  return _json_reader_event(JSON_EVENT_TYPE_END);
+}
+
+static void
+json_reader_init(json_reader_t* r, buf_t scratch) {
+  *r = {};
+  r->scratch = scratch;
+  r->expect = _JSON_READER_EXPECT_VALUE;
+}
+
+// @note: Only call this after json_reader_next() said it needs more.
+static void
+json_reader_feed(json_reader_t* r, const u8_t* chunk, usz_t chunk_size) {
+  assert(r->chunk_at == r->chunk_size);
+  r->chunk_offset += r->chunk_size;
+  r->chunk = chunk;
+  r->chunk_size = chunk_size;
+  r->chunk_at = 0;
+  r->token_start = 0;
+}
+
+static void
+json_reader_finish(json_reader_t* r) {
+  r->is_finished = true;
+}
+
+// @note: The reader reads 'chunk_memory' sized chunks from the file 
+// by itself, so it never needs more.
+static b32_t
+json_reader_set_file(json_reader_t* r, file_t* file, buf_t chunk_memory) {
+  if (!buf_valid(chunk_memory) || chunk_memory.size == 0) return false;
+  r->file = file;
+  r->file_chunk = chunk_memory;
+  r->file_size = file_get_size(file);
+  r->file_offset = 0;
+  return true;
+}
+
+static json_event_t
+json_reader_next(json_reader_t* r) {
+  for (;;) {
+    if (r->expect == _JSON_READER_EXPECT_ERROR) 
+      return _json_reader_event(JSON_EVENT_TYPE_ERROR);
+
+    if (r->chunk_at == r->chunk_size) {
+      if (r->file && !r->is_finished) {
+        if (!_json_reader_pull_file(r)) return _json_reader_fail(r);
+      }
+      if (r->chunk_at == r->chunk_size) {
+        if (!r->is_finished) return _json_reader_event(JSON_EVENT_TYPE_NEED_MORE);
+        return _json_reader_end_of_input(r);
+      }
+    }
+
+    const u8_t* chunk = r->chunk;
+    switch(r->token) {
+      case _JSON_READER_TOKEN_STRING: {
+        u32_t result = _json_reader_scan_string(r);
+        if (result == _JSON_READER_SCAN_ERROR) return _json_reader_fail(r);
+        if (result == _JSON_READER_SCAN_MORE) {
+          if (!_json_reader_save_token(r)) return _json_reader_fail(r);
+          continue;
+        }
+
+        buf_t str;
+        if (!_json_reader_get_token(r, r->chunk_at, &str)) return _json_reader_fail(r);
+        ++r->chunk_at; // closing quote
+        r->token = _JSON_READER_TOKEN_NONE;
+        if (r->is_key) {
+          r->expect = _JSON_READER_EXPECT_COLON;
+          return _json_reader_event(JSON_EVENT_TYPE_KEY, str);
+        }
+        _json_reader_end_value(r);
+        return _json_reader_event(JSON_EVENT_TYPE_STRING, str);
+      } 
+      case _JSON_READER_TOKEN_SCALAR: {
+        usz_t at = r->chunk_at;
+        while (at < r->chunk_size && !_json_reader_is_end_of_scalar(chunk[at])) ++at;
+        r->chunk_at = at;
+        if (at == r->chunk_size) {
+          if (!_json_reader_save_token(r)) return _json_reader_fail(r);
+          continue;
+        }
+        return _json_reader_end_scalar(r, at);
+      } 
+      case _JSON_READER_TOKEN_SLASH: {
+        u8_t c = chunk[r->chunk_at++];
+        if (c == '/') r->token = _JSON_READER_TOKEN_LINE_COMMENT;
+        else if (c == '*') r->token = _JSON_READER_TOKEN_BLOCK_COMMENT;
+        else return _json_reader_fail(r);
+        continue;
+      } 
+      case _JSON_READER_TOKEN_LINE_COMMENT: {
+        while (r->chunk_at < r->chunk_size) {
+          u8_t c = chunk[r->chunk_at++];
+          if (c == '\n' || c == '\r') {
+            r->token = _JSON_READER_TOKEN_NONE;
+            break;
+          }
+        }
+        continue;
+      } 
+      case _JSON_READER_TOKEN_BLOCK_COMMENT:
+      case _JSON_READER_TOKEN_BLOCK_COMMENT_STAR: {
+        while (r->chunk_at < r->chunk_size) {
+          u8_t c = chunk[r->chunk_at++];
+          if (r->token == _JSON_READER_TOKEN_BLOCK_COMMENT_STAR && c == '/') {
+            r->token = _JSON_READER_TOKEN_NONE;
+            break;
+          }
+          r->token = c == '*' ? _JSON_READER_TOKEN_BLOCK_COMMENT_STAR : _JSON_READER_TOKEN_BLOCK_COMMENT;
+        }
+        continue;
+      }
+    }
+
+    // @note: in between tokens
+    while (r->chunk_at < r->chunk_size && _json_is_whitespace(chunk[r->chunk_at])) 
+      ++r->chunk_at;
+    if (r->chunk_at == r->chunk_size) continue;
+
+    u8_t c = chunk[r->chunk_at];
+    switch(c) {
+      case '{': return _json_reader_open(r, true);
+      case '[': return _json_reader_open(r, false);
+      case '}': return _json_reader_close(r, true);
+      case ']': return _json_reader_close(r, false);
+      case ':': {
+        if (r->expect != _JSON_READER_EXPECT_COLON) return _json_reader_fail(r);
+        r->expect = _JSON_READER_EXPECT_VALUE;
+        ++r->chunk_at;
+      } break;
+      case ',': {
+        if (r->expect != _JSON_READER_EXPECT_COMMA_OR_CLOSE) return _json_reader_fail(r);
+        r->expect = _json_reader_is_in_object(r) ? _JSON_READER_EXPECT_KEY_OR_CLOSE : _JSON_READER_EXPECT_VALUE_OR_CLOSE;
+        ++r->chunk_at;
+      } break;
+      case '/': {
+        _json_reader_begin_token(r, _JSON_READER_TOKEN_SLASH, r->chunk_at);
+        ++r->chunk_at;
+      } break;
+      case '"': {
+        b32_t is_key = r->expect == _JSON_READER_EXPECT_KEY_OR_CLOSE;
+        if (!is_key && !_json_reader_is_value_expected(r)) return _json_reader_fail(r);
+        ++r->chunk_at;
+        _json_reader_begin_token(r, _JSON_READER_TOKEN_STRING, r->chunk_at);
+        r->is_key = is_key;
+      } break;
+      default: {
+        if (!_json_reader_is_value_expected(r)) return _json_reader_fail(r);
+        if (c != '-' && !u8_is_digit(c) && c != 't' && c != 'f' && c != 'n') return _json_reader_fail(r);
+        _json_reader_begin_token(r, _JSON_READER_TOKEN_SCALAR, r->chunk_at);
+      }
+    }
+  }
+}
+
+
+static void
+_clex_eat_ignorables(clex_tokenizer_t* t) {
+  for (;;) {
+    if(u8_is_whitespace(t->text.e[t->at])) {
+      ++t->at;
+    }
+    else if(t->text.e[t->at] == '/' && t->text.e[t->at+1] == '/')  // line comments
+    {
+      while(t->text.e[t->at] != '\n') {
+        ++t->at;
+      }
+    }
+    else if(t->text.e[t->at] == '/' && t->text.e[t->at+1] == '*')  // block comments
+    {
+      t->at += 3;
+      while(t->text.e[t->at] != '*' && t->text.e[t->at+1] != '/') {
+        ++t->at;
+      }
+
+    }
+    else {
+      break;
+    }
+  }
+
+}
+
+static b32_t 
+_clex_is_accepted_character_for_number(char c) {
+  return c == '-' || c == '.' ||
+    c == 'b' || c == 'x' || c == 'l' || c == 'f' || c == 'p' || c == 'e' ||
+    c == 'B' || c == 'X' || c == 'L' || c == 'F' || c == 'P' || c == 'E';
+}
+
+
 static b32_t
 _clex_compare_token_with_string(clex_tokenizer_t* t, clex_token_t token, buf_t str) {
   if( str.size != (token.ope - token.begin)) {
@@ -3317,6 +4664,47 @@ u32_endian_swap(u32_t value) {
 
 }
 
+static u32_t
+u32_ctz(u32_t value) {
+  assert(value != 0);
+#if COMPILER_MSVC
+  unsigned long index;
+  _BitScanForward(&index, value);
+  return (u32_t)index;
+#else
+  return (u32_t)__builtin_ctz(value);
+#endif
+}
+
+static u32_t
+u32_clz(u32_t value) {
+  assert(value != 0);
+#if COMPILER_MSVC
+  unsigned long index;
+  _BitScanReverse(&index, value);
+  return 31 - (u32_t)index;
+#else
+  return (u32_t)__builtin_clz(value);
+#endif
+}
+
+static u32_t
+u64_ctz(u64_t value) {
+  assert(value != 0);
+#if COMPILER_MSVC && ARCH_X64
+  unsigned long index;
+  _BitScanForward64(&index, value);
+  return (u32_t)index;
+#elif COMPILER_MSVC
+  unsigned long index;
+  if (_BitScanForward(&index, (u32_t)value)) return (u32_t)index;
+  _BitScanForward(&index, (u32_t)(value >> 32));
+  return (u32_t)index + 32;
+#else
+  return (u32_t)__builtin_ctzll(value);
+#endif
+}
+
 
 static u32_t 
 u32_factorial(u32_t x) {
@@ -3349,73 +4737,463 @@ f64_factorial(f64_t x) {
   return ret;
 }
 
-static void
-memory_copy(void* dest, const void* src, usz_t size) {
-  u8_t *p = (u8_t*)dest;
-  const u8_t *q = (const u8_t*)src;
-  while(size--) {
-    *p++ = *q++;
-  }
+//
+// @note: Unaligned scalar loads/stores that does not violate strict aliasing.
+// Compilers will turn these into a single mov.
+//
+static u32_t 
+_memory_load_u32(const void* p) {
+#if COMPILER_MSVC
+  return *(const u32_t*)p;
+#else
+  u32_t ret; 
+  __builtin_memcpy(&ret, p, sizeof(ret)); 
+  return ret;
+#endif
+}
+
+static u64_t 
+_memory_load_u64(const void* p) {
+#if COMPILER_MSVC
+  return *(const u64_t*)p;
+#else
+  u64_t ret; 
+  __builtin_memcpy(&ret, p, sizeof(ret)); 
+  return ret;
+#endif
 }
 
 static void 
-memory_zero(void* dest, usz_t size) {
-  u8_t *p = (u8_t*)dest;
-  while(size--){
-    *p++ = 0;
-  }
+_memory_store_u32(void* p, u32_t v) {
+#if COMPILER_MSVC
+  *(u32_t*)p = v;
+#else
+  __builtin_memcpy(p, &v, sizeof(v)); 
+#endif
 }
 
-static b32_t
-memory_is_same(const void* lhs, const void* rhs, usz_t size) {
-  const u8_t *p = (const u8_t*)lhs;
-  const u8_t *q = (const u8_t*)rhs;
-  while(size--) {
-    if (*p != *q) {
-      return false;
+static void 
+_memory_store_u64(void* p, u64_t v) {
+#if COMPILER_MSVC
+  *(u64_t*)p = v;
+#else
+  __builtin_memcpy(p, &v, sizeof(v)); 
+#endif
+}
+
+// @note: Copies anything below 32 bytes. 
+// The idea is to copy the head and tail of the range with 
+// two (possibly overlapping) moves of the biggest size that fits.
+static void
+_memory_copy_small(u8_t* p, const u8_t* q, usz_t size) {
+#if MOMO_SSE2
+  if (size >= 16) {
+    __m128i head = _mm_loadu_si128((const __m128i*)q);
+    __m128i tail = _mm_loadu_si128((const __m128i*)(q + size - 16));
+    _mm_storeu_si128((__m128i*)p, head);
+    _mm_storeu_si128((__m128i*)(p + size - 16), tail);
+    return;
+  }
+#else
+  while (size > 16) {
+    _memory_store_u64(p, _memory_load_u64(q));
+    p += 8; q += 8; size -= 8;
+  }
+#endif
+  if (size >= 8) {
+    u64_t head = _memory_load_u64(q);
+    u64_t tail = _memory_load_u64(q + size - 8);
+    _memory_store_u64(p, head);
+    _memory_store_u64(p + size - 8, tail);
+  }
+  else if (size >= 4) {
+    u32_t head = _memory_load_u32(q);
+    u32_t tail = _memory_load_u32(q + size - 4);
+    _memory_store_u32(p, head);
+    _memory_store_u32(p + size - 4, tail);
+  }
+  else {
+    while(size--) {
+      *p++ = *q++;
     }
   }
-  return true;
-
 }
 
+static void
+memory_copy(void* dest, const void* src, usz_t size) {
+  u8_t *p = (u8_t*)dest;
+  const u8_t *q = (const u8_t*)src;
 
+  // @note: The wide copies read ahead of what they have written, 
+  // so overlapping ranges in either direction get garbled.
+  assert(size == 0 || p + size <= q || q + size <= p);
 
-static void 
-memory_swap(void* lhs, void* rhs, usz_t size) {
-  u8_t* l = (u8_t*)lhs;
-  u8_t* r = (u8_t*)rhs;
+#if MOMO_AVX2
+  if (size < 32) {
+    _memory_copy_small(p, q, size);
+    return;
+  }
 
-  while(size--) {
-    u8_t tmp = (*l);
-    *l++ = *r;
-    *r++ = tmp;
+  // @note: The first and last 32 bytes are copied with unaligned 
+  // moves. Everything in between is written to 32-byte aligned 
+  // destination addresses.
+  __m256i head = _mm256_loadu_si256((const __m256i*)q);
+  __m256i tail = _mm256_loadu_si256((const __m256i*)(q + size - 32));
+  u8_t* tail_dest = p + size - 32;
+  _mm256_storeu_si256((__m256i*)p, head);
+
+  usz_t adjust = 32 - ((umi_t)p & 31);
+  p += adjust; q += adjust; size -= adjust;
+
+  while (size >= 128) {
+    __m256i a = _mm256_loadu_si256((const __m256i*)(q + 0));
+    __m256i b = _mm256_loadu_si256((const __m256i*)(q + 32));
+    __m256i c = _mm256_loadu_si256((const __m256i*)(q + 64));
+    __m256i d = _mm256_loadu_si256((const __m256i*)(q + 96));
+    _mm256_store_si256((__m256i*)(p + 0), a);
+    _mm256_store_si256((__m256i*)(p + 32), b);
+    _mm256_store_si256((__m256i*)(p + 64), c);
+    _mm256_store_si256((__m256i*)(p + 96), d);
+    p += 128; q += 128; size -= 128;
+  }
+  while (size >= 32) {
+    _mm256_store_si256((__m256i*)p, _mm256_loadu_si256((const __m256i*)q));
+    p += 32; q += 32; size -= 32;
+  }
+  _mm256_storeu_si256((__m256i*)tail_dest, tail);
+
+#elif MOMO_SSE2
+  if (size < 32) {
+    _memory_copy_small(p, q, size);
+    return;
   }
-}
 
-static usz_t
-cstr_len(const c8_t* str) {
-  usz_t count = 0;
-  for(; (*str) != 0 ; ++count, ++str);
-  return count;
-}
+  __m128i head = _mm_loadu_si128((const __m128i*)q);
+  __m128i tail = _mm_loadu_si128((const __m128i*)(q + size - 16));
+  u8_t* tail_dest = p + size - 16;
+  _mm_storeu_si128((__m128i*)p, head);
 
-static u32_t 
-cstr_to_u32(const c8_t* str)
-{
-  u32_t ret = 0;
-  while(*str >= '0' && *str <= '9') {
-    ret *= 10;
-    ret += (*str - '0'); 
-    ++str; 
+  usz_t adjust = 16 - ((umi_t)p & 15);
+  p += adjust; q += adjust; size -= adjust;
+
+  while (size >= 64) {
+    __m128i a = _mm_loadu_si128((const __m128i*)(q + 0));
+    __m128i b = _mm_loadu_si128((const __m128i*)(q + 16));
+    __m128i c = _mm_loadu_si128((const __m128i*)(q + 32));
+    __m128i d = _mm_loadu_si128((const __m128i*)(q + 48));
+    _mm_store_si128((__m128i*)(p + 0), a);
+    _mm_store_si128((__m128i*)(p + 16), b);
+    _mm_store_si128((__m128i*)(p + 32), c);
+    _mm_store_si128((__m128i*)(p + 48), d);
+    p += 64; q += 64; size -= 64;
   }
-  return ret;
-}
+  while (size >= 16) {
+    _mm_store_si128((__m128i*)p, _mm_loadu_si128((const __m128i*)q));
+    p += 16; q += 16; size -= 16;
+  }
+  _mm_storeu_si128((__m128i*)tail_dest, tail);
 
-static u32_t 
-cstr_len_if(const char* str, b32_t (*pred)(char))
-{
-  // common strlen that counts what I care
+#else // word-at-a-time
+  if (size < 16) {
+    _memory_copy_small(p, q, size);
+    return;
+  }
+
+  u64_t head = _memory_load_u64(q);
+  u64_t tail = _memory_load_u64(q + size - 8);
+  u8_t* tail_dest = p + size - 8;
+  _memory_store_u64(p, head);
+
+  usz_t adjust = 8 - ((umi_t)p & 7);
+  p += adjust; q += adjust; size -= adjust;
+
+  while (size >= 8) {
+    _memory_store_u64(p, _memory_load_u64(q));
+    p += 8; q += 8; size -= 8;
+  }
+  _memory_store_u64(tail_dest, tail);
+#endif
+}
+
+static void
+memory_move(void* dest, const void* src, usz_t size) {
+  u8_t *p = (u8_t*)dest;
+  const u8_t *q = (const u8_t*)src;
+
+  if (p == q || size == 0) return;
+
+  // No overlap; take the fast path.
+  if (p + size <= q || q + size <= p) {
+    memory_copy(dest, src, size);
+    return;
+  }
+
+  // @note: For overlapping ranges, each block is fully loaded 
+  // before it is stored, and we walk in the direction that never 
+  // reads a byte that we have already written.
+  if (p < q) {
+#if MOMO_AVX2
+    while (size >= 32) {
+      _mm256_storeu_si256((__m256i*)p, _mm256_loadu_si256((const __m256i*)q));
+      p += 32; q += 32; size -= 32;
+    }
+#endif
+#if MOMO_SSE2
+    while (size >= 16) {
+      _mm_storeu_si128((__m128i*)p, _mm_loadu_si128((const __m128i*)q));
+      p += 16; q += 16; size -= 16;
+    }
+#endif
+    while (size >= 8) {
+      _memory_store_u64(p, _memory_load_u64(q));
+      p += 8; q += 8; size -= 8;
+    }
+    while (size--) {
+      *p++ = *q++;
+    }
+  }
+  else {
+    p += size;
+    q += size;
+#if MOMO_AVX2
+    while (size >= 32) {
+      p -= 32; q -= 32; size -= 32;
+      _mm256_storeu_si256((__m256i*)p, _mm256_loadu_si256((const __m256i*)q));
+    }
+#endif
+#if MOMO_SSE2
+    while (size >= 16) {
+      p -= 16; q -= 16; size -= 16;
+      _mm_storeu_si128((__m128i*)p, _mm_loadu_si128((const __m128i*)q));
+    }
+#endif
+    while (size >= 8) {
+      p -= 8; q -= 8; size -= 8;
+      _memory_store_u64(p, _memory_load_u64(q));
+    }
+    while (size--) {
+      *--p = *--q;
+    }
+  }
+}
+
+static void 
+memory_zero(void* dest, usz_t size) {
+  u8_t *p = (u8_t*)dest;
+
+#if MOMO_AVX2 
+  if (size >= 32) {
+    __m256i zero = _mm256_setzero_si256();
+    u8_t* tail_dest = p + size - 32;
+    _mm256_storeu_si256((__m256i*)p, zero);
+
+    usz_t adjust = 32 - ((umi_t)p & 31);
+    p += adjust; size -= adjust;
+
+    while (size >= 128) {
+      _mm256_store_si256((__m256i*)(p + 0), zero);
+      _mm256_store_si256((__m256i*)(p + 32), zero);
+      _mm256_store_si256((__m256i*)(p + 64), zero);
+      _mm256_store_si256((__m256i*)(p + 96), zero);
+      p += 128; size -= 128;
+    }
+    while (size >= 32) {
+      _mm256_store_si256((__m256i*)p, zero);
+      p += 32; size -= 32;
+    }
+    _mm256_storeu_si256((__m256i*)tail_dest, zero);
+    return;
+  }
+#elif MOMO_SSE2
+  if (size >= 32) {
+    __m128i zero = _mm_setzero_si128();
+    u8_t* tail_dest = p + size - 16;
+    _mm_storeu_si128((__m128i*)p, zero);
+
+    usz_t adjust = 16 - ((umi_t)p & 15);
+    p += adjust; size -= adjust;
+
+    while (size >= 64) {
+      _mm_store_si128((__m128i*)(p + 0), zero);
+      _mm_store_si128((__m128i*)(p + 16), zero);
+      _mm_store_si128((__m128i*)(p + 32), zero);
+      _mm_store_si128((__m128i*)(p + 48), zero);
+      p += 64; size -= 64;
+    }
+    while (size >= 16) {
+      _mm_store_si128((__m128i*)p, zero);
+      p += 16; size -= 16;
+    }
+    _mm_storeu_si128((__m128i*)tail_dest, zero);
+    return;
+  }
+#endif
+
+  // Small sizes (or no SIMD)
+#if MOMO_SSE2
+  if (size >= 16) {
+    _mm_storeu_si128((__m128i*)p, _mm_setzero_si128());
+    _mm_storeu_si128((__m128i*)(p + size - 16), _mm_setzero_si128());
+    return;
+  }
+#endif
+  if (size >= 8) {
+    u8_t* tail_dest = p + size - 8;
+    while (size >= 8) {
+      _memory_store_u64(p, 0);
+      p += 8; size -= 8;
+    }
+    _memory_store_u64(tail_dest, 0);
+  }
+  else if (size >= 4) {
+    _memory_store_u32(p, 0);
+    _memory_store_u32(p + size - 4, 0);
+  }
+  else {
+    while(size--){
+      *p++ = 0;
+    }
+  }
+}
+
+static b32_t
+memory_is_same(const void* lhs, const void* rhs, usz_t size) {
+  const u8_t *p = (const u8_t*)lhs;
+  const u8_t *q = (const u8_t*)rhs;
+
+  // @note: Alignment does not really matter for loads on 
+  // anything recent, so we just use unaligned loads throughout.
+  // The tail is handled by comparing the last block again.
+#if MOMO_AVX2
+  if (size >= 32) {
+    const u8_t* p_tail = p + size - 32;
+    const u8_t* q_tail = q + size - 32;
+    while (size >= 32) {
+      __m256i a = _mm256_loadu_si256((const __m256i*)p);
+      __m256i b = _mm256_loadu_si256((const __m256i*)q);
+      if ((u32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(a, b)) != 0xFFFFFFFF) 
+        return false;
+      p += 32; q += 32; size -= 32;
+    }
+    __m256i a = _mm256_loadu_si256((const __m256i*)p_tail);
+    __m256i b = _mm256_loadu_si256((const __m256i*)q_tail);
+    return (u32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(a, b)) == 0xFFFFFFFF;
+  }
+#endif
+#if MOMO_SSE2
+  if (size >= 16) {
+    const u8_t* p_tail = p + size - 16;
+    const u8_t* q_tail = q + size - 16;
+    while (size >= 16) {
+      __m128i a = _mm_loadu_si128((const __m128i*)p);
+      __m128i b = _mm_loadu_si128((const __m128i*)q);
+      if (_mm_movemask_epi8(_mm_cmpeq_epi8(a, b)) != 0xFFFF) 
+        return false;
+      p += 16; q += 16; size -= 16;
+    }
+    __m128i a = _mm_loadu_si128((const __m128i*)p_tail);
+    __m128i b = _mm_loadu_si128((const __m128i*)q_tail);
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(a, b)) == 0xFFFF;
+  }
+#endif
+  if (size >= 8) {
+    const u8_t* p_tail = p + size - 8;
+    const u8_t* q_tail = q + size - 8;
+    while (size >= 8) {
+      if (_memory_load_u64(p) != _memory_load_u64(q)) 
+        return false;
+      p += 8; q += 8; size -= 8;
+    }
+    return _memory_load_u64(p_tail) == _memory_load_u64(q_tail);
+  }
+  while(size--) {
+    if (*p++ != *q++) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static void 
+memory_swap(void* lhs, void* rhs, usz_t size) {
+  u8_t* l = (u8_t*)lhs;
+  u8_t* r = (u8_t*)rhs;
+
+  // @note: We can't do the overlapping head/tail trick here 
+  // because swapping a byte twice undoes the swap. For big 
+  // ranges, we go byte-by-byte until 'lhs' is aligned instead.
+#if MOMO_AVX2
+  if (size >= 256) {
+    while ((umi_t)l & 31) {
+      u8_t tmp = (*l);
+      *l++ = *r;
+      *r++ = tmp;
+      --size;
+    }
+  }
+  while (size >= 32) {
+    __m256i a = _mm256_loadu_si256((const __m256i*)l);
+    __m256i b = _mm256_loadu_si256((const __m256i*)r);
+    _mm256_storeu_si256((__m256i*)l, b);
+    _mm256_storeu_si256((__m256i*)r, a);
+    l += 32; r += 32; size -= 32;
+  }
+#elif MOMO_SSE2
+  if (size >= 128) {
+    while ((umi_t)l & 15) {
+      u8_t tmp = (*l);
+      *l++ = *r;
+      *r++ = tmp;
+      --size;
+    }
+  }
+#endif
+#if MOMO_SSE2
+  while (size >= 16) {
+    __m128i a = _mm_loadu_si128((const __m128i*)l);
+    __m128i b = _mm_loadu_si128((const __m128i*)r);
+    _mm_storeu_si128((__m128i*)l, b);
+    _mm_storeu_si128((__m128i*)r, a);
+    l += 16; r += 16; size -= 16;
+  }
+#endif
+  while (size >= 8) {
+    u64_t a = _memory_load_u64(l);
+    u64_t b = _memory_load_u64(r);
+    _memory_store_u64(l, b);
+    _memory_store_u64(r, a);
+    l += 8; r += 8; size -= 8;
+  }
+  while(size--) {
+    u8_t tmp = (*l);
+    *l++ = *r;
+    *r++ = tmp;
+  }
+}
+
+static usz_t
+cstr_len(const c8_t* str) {
+  usz_t count = 0;
+  for(; (*str) != 0 ; ++count, ++str);
+  return count;
+}
+
+static u32_t 
+cstr_to_u32(const c8_t* str)
+{
+  u32_t ret = 0;
+  while(*str >= '0' && *str <= '9') {
+    ret *= 10;
+    ret += (*str - '0'); 
+    ++str; 
+  }
+  return ret;
+}
+
+static u32_t 
+cstr_len_if(const char* str, b32_t (*pred)(char))
+{
+  // common strlen that counts what I care
   u32_t ret = 0;
   while(pred(*str)) 
   {
@@ -4331,6 +6109,123 @@ hash_djb2(const c8_t* str)
   return hash;
 }
 
+// @note: Based on wyhash (v4.2) by Wang Yi, which is public domain.
+// Fast and good enough for hash tables, but not for anything that 
+// has to be secure.
+static const u64_t _hash_wy_secret[4] = { 
+  0x2d358dccaa6c78a5ull, 0x8bb84b93962eacc9ull, 0x4b33a62ed433d4a3ull, 0x4d5a2da51de1aa47ull 
+};
+
+static inline void
+_hash_wy_mul(u64_t* a, u64_t* b) {
+#if COMPILER_MSVC && ARCH_X64
+  *a = _umul128(*a, *b, b);
+#elif COMPILER_GCC || COMPILER_CLANG
+  __uint128_t r = (__uint128_t)*a * *b;
+  *a = (u64_t)r;
+  *b = (u64_t)(r >> 64);
+#else
+  u64_t ha = *a >> 32, hb = *b >> 32, la = (u32_t)*a, lb = (u32_t)*b;
+  u64_t rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+  u64_t t = rl + (rm0 << 32), c = t < rl;
+  u64_t lo = t + (rm1 << 32); 
+  c += lo < t;
+  *a = lo;
+  *b = rh + (rm0 >> 32) + (rm1 >> 32) + c;
+#endif
+}
+
+static inline u64_t
+_hash_wy_mix(u64_t a, u64_t b) {
+  _hash_wy_mul(&a, &b);
+  return a ^ b;
+}
+
+// @note: unaligned little-endian reads; compilers turn these into a single load
+static inline u64_t
+_hash_wy_read8(const u8_t* p) {
+  return 
+    ((u64_t)p[0]) | ((u64_t)p[1] << 8) | ((u64_t)p[2] << 16) | ((u64_t)p[3] << 24) |
+    ((u64_t)p[4] << 32) | ((u64_t)p[5] << 40) | ((u64_t)p[6] << 48) | ((u64_t)p[7] << 56);
+}
+
+static inline u64_t
+_hash_wy_read4(const u8_t* p) {
+  return ((u64_t)p[0]) | ((u64_t)p[1] << 8) | ((u64_t)p[2] << 16) | ((u64_t)p[3] << 24);
+}
+
+static u64_t
+hash_wy64(const void* data, usz_t size, u64_t seed) 
+{
+  const u8_t* p = (const u8_t*)data;
+  const u64_t* secret = _hash_wy_secret;
+  seed ^= _hash_wy_mix(seed ^ secret[0], secret[1]);
+
+  u64_t a, b;
+  if (size <= 16) {
+    if (size >= 4) {
+      a = (_hash_wy_read4(p) << 32) | _hash_wy_read4(p + ((size >> 3) << 2));
+      b = (_hash_wy_read4(p + size - 4) << 32) | _hash_wy_read4(p + size - 4 - ((size >> 3) << 2));
+    }
+    else if (size > 0) {
+      a = ((u64_t)p[0] << 16) | ((u64_t)p[size >> 1] << 8) | p[size - 1];
+      b = 0;
+    }
+    else {
+      a = b = 0;
+    }
+  }
+  else {
+    usz_t i = size;
+    if (i >= 48) {
+      u64_t see1 = seed, see2 = seed;
+      do {
+        seed = _hash_wy_mix(_hash_wy_read8(p) ^ secret[1], _hash_wy_read8(p + 8) ^ seed);
+        see1 = _hash_wy_mix(_hash_wy_read8(p + 16) ^ secret[2], _hash_wy_read8(p + 24) ^ see1);
+        see2 = _hash_wy_mix(_hash_wy_read8(p + 32) ^ secret[3], _hash_wy_read8(p + 40) ^ see2);
+        p += 48; 
+        i -= 48;
+      } while(i >= 48);
+      seed ^= see1 ^ see2;
+    }
+    while (i > 16) {
+      seed = _hash_wy_mix(_hash_wy_read8(p) ^ secret[1], _hash_wy_read8(p + 8) ^ seed);
+      i -= 16; 
+      p += 16;
+    }
+    a = _hash_wy_read8(p + i - 16);
+    b = _hash_wy_read8(p + i - 8);
+  }
+  a ^= secret[1];
+  b ^= seed;
+  _hash_wy_mul(&a, &b);
+  return _hash_wy_mix(a ^ secret[0] ^ size, b ^ secret[1]);
+}
+
+// @note: For integer keys; every bit of the input affects every bit 
+// of the output.
+static u64_t
+hash_u64(u64_t value) 
+{
+  u64_t a = value ^ _hash_wy_secret[0];
+  u64_t b = value ^ _hash_wy_secret[1];
+  _hash_wy_mul(&a, &b);
+  return _hash_wy_mix(a ^ _hash_wy_secret[0], b ^ _hash_wy_secret[1]);
+}
+
+// @note: Pass the previous result as 'hash' to keep hashing 
+// more data into it.
+static u64_t
+hash_fnv1a_64(const void* data, usz_t size, u64_t hash)
+{
+  const u8_t* itr = (const u8_t*)data;
+  for (usz_t i = 0; i < size; ++i) {
+    hash ^= itr[i];
+    hash *= 0x100000001B3;
+  }
+  return hash;
+}
+
 #if COMPILER_MSVC
 #include <intrin.h>
 static u32_t 
@@ -4364,6 +6259,117 @@ u64_atomic_add(u64_t volatile* value, u64_t to_add) {
   return result;
 }
 
+static u64_t 
+u64_atomic_compare_assign(u64_t volatile* value,
+    u64_t new_value,
+    u64_t expected_value)
+{
+  u64_t ret = _InterlockedCompareExchange64((__int64 volatile*)value,
+      new_value,
+      expected_value);
+  return ret;
+}
+
+// @note: On x86/x64, aligned loads and stores are already atomic and
+// have acquire/release semantics, so we only need to stop the compiler
+// from reordering around them.
+static u32_t
+u32_atomic_load(u32_t volatile* value) {
+  u32_t result = *value;
+  _ReadWriteBarrier();
+  return result;
+}
+
+static void
+u32_atomic_store(u32_t volatile* value, u32_t new_value) {
+  _ReadWriteBarrier();
+  *value = new_value;
+}
+
+static u64_t
+u64_atomic_load(u64_t volatile* value) {
+  u64_t result = *value;
+  _ReadWriteBarrier();
+  return result;
+}
+
+static void
+u64_atomic_store(u64_t volatile* value, u64_t new_value) {
+  _ReadWriteBarrier();
+  *value = new_value;
+}
+
+static void
+atomic_fence() {
+  _ReadWriteBarrier();
+  _mm_mfence();
+  _ReadWriteBarrier();
+}
+
+#elif COMPILER_GCC || COMPILER_CLANG
+// @note: These return the initial value, just like the Interlocked functions.
+static u32_t 
+u32_atomic_compare_assign(u32_t volatile* value,
+    u32_t new_value,
+    u32_t expected_value)
+{
+  __atomic_compare_exchange_n(value, &expected_value, new_value, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+  return expected_value;
+}
+
+static u64_t 
+u64_atomic_assign(u64_t volatile* value,
+    u64_t new_value)
+{
+  u64_t ret = __atomic_exchange_n(value, new_value, __ATOMIC_SEQ_CST);
+  return ret;
+}
+
+static u32_t 
+u32_atomic_add(u32_t volatile* value, u32_t to_add) {
+  u32_t result = __atomic_fetch_add(value, to_add, __ATOMIC_SEQ_CST);
+  return result;
+}
+
+static u64_t 
+u64_atomic_add(u64_t volatile* value, u64_t to_add) {
+  u64_t result = __atomic_fetch_add(value, to_add, __ATOMIC_SEQ_CST);
+  return result;
+}
+
+static u64_t 
+u64_atomic_compare_assign(u64_t volatile* value,
+    u64_t new_value,
+    u64_t expected_value)
+{
+  __atomic_compare_exchange_n(value, &expected_value, new_value, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+  return expected_value;
+}
+
+static u32_t
+u32_atomic_load(u32_t volatile* value) {
+  return __atomic_load_n(value, __ATOMIC_ACQUIRE);
+}
+
+static void
+u32_atomic_store(u32_t volatile* value, u32_t new_value) {
+  __atomic_store_n(value, new_value, __ATOMIC_RELEASE);
+}
+
+static u64_t
+u64_atomic_load(u64_t volatile* value) {
+  return __atomic_load_n(value, __ATOMIC_ACQUIRE);
+}
+
+static void
+u64_atomic_store(u64_t volatile* value, u64_t new_value) {
+  __atomic_store_n(value, new_value, __ATOMIC_RELEASE);
+}
+
+static void
+atomic_fence() {
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
 #else
 # warning "[momo] Atomic functions are not implemented!"
 #endif
@@ -5757,491 +7763,3766 @@ static rgba_t hsla_to_rgba(hsla_t c) {
 //   It seems that we can presumably just flip the bits. 
 //
 
-static u32_t 
-_sort_key_to_u32(f32_t sort_key)
-{
-  u32_t result = *(u32_t*)&sort_key;
-  if (result & 0x80000000) 
-  {
-    // if signed bit is set, flip everything
-    result = ~result;
+static u32_t 
+_sort_key_to_u32(f32_t sort_key)
+{
+  u32_t result = *(u32_t*)&sort_key;
+  if (result & 0x80000000) 
+  {
+    // if signed bit is set, flip everything
+    result = ~result;
+  }
+  else 
+  {
+    // if signed bit is not set, set it
+    result |= 0x80000000;
+  }
+  return result;
+}
+
+// @note: The radix sorts below work on keys that have been turned into
+// unsigned integers that sort in the same order. For floats, this is
+// _sort_key_to_u32() without the branch. For signed integers, we only
+// need to flip the sign bit. This is done once before the first pass 
+// and undone after the last, instead of on every pass.
+//
+// Digits are 11 bits, so a 32-bit key takes 3 passes and a 64-bit key
+// takes 6. All the histograms are made in a single read of the keys,
+// and any pass where every key has the same digit is skipped since it
+// would not move anything.
+//
+// With a job system, the keys are split into one chunk per worker. Each
+// chunk counts its own digits, and the offsets are laid out so that
+// chunk 0 writes the first of every bucket, then chunk 1, etc. That way
+// every chunk can scatter at the same time and the sort stays stable.
+// 
+#define _SORT_RADIX_DIGIT_BITS         11
+#define _SORT_RADIX_BUCKET_COUNT       (1 << _SORT_RADIX_DIGIT_BITS)
+#define _SORT_RADIX_DIGIT_MASK         (_SORT_RADIX_BUCKET_COUNT - 1)
+#define _SORT_RADIX_MAX_PASSES         6
+#define _SORT_RADIX_MIN_CHUNK_SIZE     (1 << 16)
+#define _SORT_RADIX_INSERTION_COUNT    64
+
+enum _sort_radix_key_type_t {
+  _SORT_RADIX_KEY_TYPE_UNSIGNED,
+  _SORT_RADIX_KEY_TYPE_SIGNED,
+  _SORT_RADIX_KEY_TYPE_FLOAT,
+};
+
+template<typename U> static U 
+_sort_radix_encode(U bits, u32_t key_type) {
+  const U sign = (U)1 << (sizeof(U)*8-1);
+  if (key_type == _SORT_RADIX_KEY_TYPE_SIGNED) {
+    return bits ^ sign;
+  }
+  else if (key_type == _SORT_RADIX_KEY_TYPE_FLOAT) {
+    // negative: flip everything, positive: flip the sign bit
+    return bits ^ ((U)0 - (bits >> (sizeof(U)*8-1)) | sign);
+  }
+  return bits;
+}
+
+template<typename U> static U 
+_sort_radix_decode(U bits, u32_t key_type) {
+  const U sign = (U)1 << (sizeof(U)*8-1);
+  if (key_type == _SORT_RADIX_KEY_TYPE_SIGNED) {
+    return bits ^ sign;
+  }
+  else if (key_type == _SORT_RADIX_KEY_TYPE_FLOAT) {
+    // top bit set: was positive, top bit not set: was negative
+    return bits ^ (((bits >> (sizeof(U)*8-1)) - 1) | sign);
+  }
+  return bits;
+}
+
+// @note: Elements that can be radix sorted. 'E' is what gets moved
+// around and '_sort_radix_get_bits()' is the key it is sorted by.
+static u32_t _sort_radix_get_bits(const u32_t* e) { return *e; }
+static u64_t _sort_radix_get_bits(const u64_t* e) { return *e; }
+static u32_t _sort_radix_get_bits(const sort_entry_t* e) { u32_t bits; memory_copy(&bits, &e->key, sizeof(bits)); return bits; }
+static void _sort_radix_set_bits(u32_t* e, u32_t bits) { *e = bits; }
+static void _sort_radix_set_bits(u64_t* e, u64_t bits) { *e = bits; }
+static void _sort_radix_set_bits(sort_entry_t* e, u32_t bits) { memory_copy(&e->key, &bits, sizeof(bits)); }
+
+template<typename E> 
+struct _sort_radix_chunk_t {
+  E* src;
+  E* dest;
+  u32_t* src_values;
+  u32_t* dest_values;
+  u32_t begin;
+  u32_t end;
+  u32_t key_type;
+
+  // for counting
+  u32_t first_pass;
+  u32_t pass_count;
+
+  // for scattering
+  u32_t shift;
+
+  // counts[pass][bucket] when counting, offsets[bucket] when scattering
+  u32_t* counts;
+};
+
+// Encodes the keys in the chunk and counts the digits of every pass.
+template<typename E> static void
+_sort_radix_count_and_encode(void* data) {
+  auto* c = (_sort_radix_chunk_t<E>*)data;
+  for (u32_t i = c->begin; i < c->end; ++i) {
+    auto bits = _sort_radix_encode(_sort_radix_get_bits(c->src + i), c->key_type);
+    _sort_radix_set_bits(c->src + i, bits);
+    for (u32_t pass = 0; pass < c->pass_count; ++pass) {
+      u32_t digit = (u32_t)(bits >> (pass * _SORT_RADIX_DIGIT_BITS)) & _SORT_RADIX_DIGIT_MASK;
+      ++c->counts[pass * _SORT_RADIX_BUCKET_COUNT + digit];
+    }
+  }
+}
+
+// Counts the digits of a single pass, for chunks whose keys have 
+// been moved around since they were first counted.
+template<typename E> static void
+_sort_radix_count(void* data) {
+  auto* c = (_sort_radix_chunk_t<E>*)data;
+  memory_zero(c->counts, sizeof(u32_t) * _SORT_RADIX_BUCKET_COUNT);
+  for (u32_t i = c->begin; i < c->end; ++i) {
+    u32_t digit = (u32_t)(_sort_radix_get_bits(c->src + i) >> c->shift) & _SORT_RADIX_DIGIT_MASK;
+    ++c->counts[digit];
+  }
+}
+
+template<typename E> static void
+_sort_radix_scatter(void* data) {
+  auto* c = (_sort_radix_chunk_t<E>*)data;
+  u32_t* offsets = c->counts;
+  if (c->src_values) {
+    for (u32_t i = c->begin; i < c->end; ++i) {
+      u32_t digit = (u32_t)(_sort_radix_get_bits(c->src + i) >> c->shift) & _SORT_RADIX_DIGIT_MASK;
+      u32_t dest_index = offsets[digit]++;
+      c->dest[dest_index] = c->src[i];
+      c->dest_values[dest_index] = c->src_values[i];
+    }
+  }
+  else {
+    for (u32_t i = c->begin; i < c->end; ++i) {
+      u32_t digit = (u32_t)(_sort_radix_get_bits(c->src + i) >> c->shift) & _SORT_RADIX_DIGIT_MASK;
+      c->dest[offsets[digit]++] = c->src[i];
+    }
+  }
+}
+
+template<typename E> static void
+_sort_radix_decode_chunk(void* data) {
+  auto* c = (_sort_radix_chunk_t<E>*)data;
+  for (u32_t i = c->begin; i < c->end; ++i) {
+    _sort_radix_set_bits(c->src + i, _sort_radix_decode(_sort_radix_get_bits(c->src + i), c->key_type));
+  }
+}
+
+// Runs 'callback' on every chunk, on the job system if there is one.
+template<typename E> static void
+_sort_radix_run(job_system_t* js, job_callback_f* callback, _sort_radix_chunk_t<E>* chunks, u32_t chunk_count) {
+  if (chunk_count == 1) {
+    callback(chunks);
+    return;
+  }
+  job_counter_t counter = {};
+  for (u32_t chunk_index = 0; chunk_index < chunk_count; ++chunk_index) {
+    job_add(js, callback, chunks + chunk_index, &counter);
+  }
+  job_wait(js, &counter);
+}
+
+// @note: Small inputs are not worth 2048 buckets per pass.
+template<typename E> static void
+_sort_radix_insertion(E* elements, u32_t* values, u32_t count, u32_t key_type) {
+  for (u32_t i = 0; i < count; ++i) {
+    _sort_radix_set_bits(elements + i, _sort_radix_encode(_sort_radix_get_bits(elements + i), key_type));
+  }
+  for (u32_t i = 1; i < count; ++i) {
+    E e = elements[i];
+    u32_t value = values ? values[i] : 0;
+    auto bits = _sort_radix_get_bits(&e);
+    u32_t j = i;
+    for (; j > 0 && _sort_radix_get_bits(elements + j - 1) > bits; --j) {
+      elements[j] = elements[j-1];
+      if (values) values[j] = values[j-1];
+    }
+    elements[j] = e;
+    if (values) values[j] = value;
+  }
+  for (u32_t i = 0; i < count; ++i) {
+    _sort_radix_set_bits(elements + i, _sort_radix_decode(_sort_radix_get_bits(elements + i), key_type));
+  }
+}
+
+template<typename E> static b32_t
+_sort_radix(E* elements, u32_t* values, u32_t count, u32_t key_type, arena_t* arena, job_system_t* js) {
+  if (count < _SORT_RADIX_INSERTION_COUNT) {
+    _sort_radix_insertion(elements, values, count, key_type);
+    return true;
+  }
+
+  const u32_t key_bits = sizeof(_sort_radix_get_bits(elements)) * 8;
+  const u32_t pass_count = (key_bits + _SORT_RADIX_DIGIT_BITS - 1) / _SORT_RADIX_DIGIT_BITS;
+
+  u32_t chunk_count = 1;
+  if (js) {
+    chunk_count = clamp_of(count / _SORT_RADIX_MIN_CHUNK_SIZE, 1, js->worker_count);
+  }
+
+  arena_set_revert_point(arena);
+  E* tmp = arena_push_arr(E, arena, count);
+  u32_t* tmp_values = values ? arena_push_arr(u32_t, arena, count) : nullptr;
+  auto* chunks = arena_push_arr(_sort_radix_chunk_t<E>, arena, chunk_count);
+  u32_t* counts = arena_push_arr(u32_t, arena, chunk_count * pass_count * _SORT_RADIX_BUCKET_COUNT);
+  u32_t* totals = arena_push_arr(u32_t, arena, pass_count * _SORT_RADIX_BUCKET_COUNT);
+  if (!tmp || (values && !tmp_values) || !chunks || !counts || !totals) {
+    return false;
+  }
+  memory_zero(counts, sizeof(u32_t) * chunk_count * pass_count * _SORT_RADIX_BUCKET_COUNT);
+
+  u32_t chunk_size = count / chunk_count;
+  for (u32_t chunk_index = 0; chunk_index < chunk_count; ++chunk_index) {
+    _sort_radix_chunk_t<E>* c = chunks + chunk_index;
+    c->begin = chunk_index * chunk_size;
+    c->end = (chunk_index == chunk_count - 1) ? count : c->begin + chunk_size;
+    c->key_type = key_type;
+    c->pass_count = pass_count;
+    c->counts = counts + chunk_index * pass_count * _SORT_RADIX_BUCKET_COUNT;
+    c->src = elements;
+  }
+  _sort_radix_run(js, _sort_radix_count_and_encode<E>, chunks, chunk_count);
+
+  // Each bucket's total is the same on every pass, so we can
+  // sum up the chunks to find out which passes can be skipped.
+  memory_copy(totals, counts, sizeof(u32_t) * pass_count * _SORT_RADIX_BUCKET_COUNT);
+  for (u32_t chunk_index = 1; chunk_index < chunk_count; ++chunk_index) {
+    u32_t* chunk_counts = chunks[chunk_index].counts;
+    for (u32_t i = 0; i < pass_count * _SORT_RADIX_BUCKET_COUNT; ++i) {
+      totals[i] += chunk_counts[i];
+    }
+  }
+  b32_t should_do_pass[_SORT_RADIX_MAX_PASSES] = {};
+  for (u32_t pass = 0; pass < pass_count; ++pass) {
+    u32_t digit = (u32_t)(_sort_radix_get_bits(elements) >> (pass * _SORT_RADIX_DIGIT_BITS)) & _SORT_RADIX_DIGIT_MASK;
+    should_do_pass[pass] = totals[pass * _SORT_RADIX_BUCKET_COUNT + digit] != count;
+  }
+
+  E* src = elements;
+  E* dest = tmp;
+  u32_t* src_values = values;
+  u32_t* dest_values = tmp_values;
+  for (u32_t pass = 0; pass < pass_count; ++pass) {
+    if (!should_do_pass[pass]) continue;
+
+    // @note: From here on, each chunk only needs one pass worth of counts.
+    for (u32_t chunk_index = 0; chunk_index < chunk_count; ++chunk_index) {
+      _sort_radix_chunk_t<E>* c = chunks + chunk_index;
+      c->src = src;
+      c->dest = dest;
+      c->src_values = src_values;
+      c->dest_values = dest_values;
+      c->shift = pass * _SORT_RADIX_DIGIT_BITS;
+      c->counts = counts + chunk_index * _SORT_RADIX_BUCKET_COUNT;
+    }
+
+    if (chunk_count == 1) {
+      memory_copy(chunks->counts, totals + pass * _SORT_RADIX_BUCKET_COUNT, sizeof(u32_t) * _SORT_RADIX_BUCKET_COUNT);
+    }
+    else {
+      // The keys have moved between chunks since they were first counted.
+      _sort_radix_run(js, _sort_radix_count<E>, chunks, chunk_count);
+    }
+
+    // Turn counts into offsets: every chunk's part of a bucket comes 
+    // after the previous chunks' parts of it.
+    u32_t total = 0;
+    for (u32_t bucket = 0; bucket < _SORT_RADIX_BUCKET_COUNT; ++bucket) {
+      for (u32_t chunk_index = 0; chunk_index < chunk_count; ++chunk_index) {
+        u32_t* chunk_counts = chunks[chunk_index].counts;
+        u32_t bucket_count = chunk_counts[bucket];
+        chunk_counts[bucket] = total;
+        total += bucket_count;
+      }
+    }
+    _sort_radix_run(js, _sort_radix_scatter<E>, chunks, chunk_count);
+
+    swap(src, dest);
+    swap(src_values, dest_values);
+  }
+
+  if (src != elements) {
+    memory_copy(elements, src, sizeof(E) * count);
+    if (values) memory_copy(values, src_values, sizeof(u32_t) * count);
+  }
+
+  for (u32_t chunk_index = 0; chunk_index < chunk_count; ++chunk_index) {
+    chunks[chunk_index].src = elements;
+  }
+  if (key_type != _SORT_RADIX_KEY_TYPE_UNSIGNED) {
+    _sort_radix_run(js, _sort_radix_decode_chunk<E>, chunks, chunk_count);
+  }
+  return true;
+}
+
+static b32_t
+sort_radix_u32(u32_t* keys, u32_t* values, u32_t count, arena_t* arena, job_system_t* js) {
+  return _sort_radix(keys, values, count, _SORT_RADIX_KEY_TYPE_UNSIGNED, arena, js);
+}
+
+static b32_t
+sort_radix_s32(s32_t* keys, u32_t* values, u32_t count, arena_t* arena, job_system_t* js) {
+  return _sort_radix((u32_t*)keys, values, count, _SORT_RADIX_KEY_TYPE_SIGNED, arena, js);
+}
+
+static b32_t
+sort_radix_f32(f32_t* keys, u32_t* values, u32_t count, arena_t* arena, job_system_t* js) {
+  return _sort_radix((u32_t*)keys, values, count, _SORT_RADIX_KEY_TYPE_FLOAT, arena, js);
+}
+
+static b32_t
+sort_radix_u64(u64_t* keys, u32_t* values, u32_t count, arena_t* arena, job_system_t* js) {
+  return _sort_radix(keys, values, count, _SORT_RADIX_KEY_TYPE_UNSIGNED, arena, js);
+}
+
+static b32_t
+sort_radix_s64(s64_t* keys, u32_t* values, u32_t count, arena_t* arena, job_system_t* js) {
+  return _sort_radix((u64_t*)keys, values, count, _SORT_RADIX_KEY_TYPE_SIGNED, arena, js);
+}
+
+static b32_t
+sort_radix_f64(f64_t* keys, u32_t* values, u32_t count, arena_t* arena, job_system_t* js) {
+  return _sort_radix((u64_t*)keys, values, count, _SORT_RADIX_KEY_TYPE_FLOAT, arena, js);
+}
+
+static void 
+sort_radix(sort_entry_t* entries, u32_t entry_count, arena_t* arena, job_system_t* js)
+{
+  b32_t success = _sort_radix(entries, nullptr, entry_count, _SORT_RADIX_KEY_TYPE_FLOAT, arena, js);
+  assert(success);
+}
+
+//
+// Quick sort
+//
+// @note: This is pattern-defeating quicksort (pdqsort) by Orson Peters:
+// - Small ranges are insertion sorted.
+// - The pivot is the median of 3, or the median of 3 medians of 3 for 
+//   big ranges.
+// - Partitioning is done in blocks: the comparisons are first written
+//   into buffers of offsets, which are then swapped without branching
+//   on the result of the comparison.
+// - If the pivot equals an element to the left of the range, everything
+//   equal to it is put on the left and never looked at again, so inputs
+//   with lots of duplicates are fast.
+// - If a partition did no swaps, we try to finish with an insertion sort 
+//   that gives up after a few moves. This makes sorted inputs linear.
+// - Every badly unbalanced partition shuffles a few elements around to 
+//   break patterns. After too many of them, we give up and heap sort,
+//   which bounds the worst case to O(n log n).
+//
+// The comparator is a template argument so that it gets inlined.
+//
+#define _SORT_QUICK_INSERTION_COUNT         24
+#define _SORT_QUICK_NINTHER_COUNT           128
+#define _SORT_QUICK_PARTIAL_INSERTION_LIMIT 8
+#define _SORT_QUICK_BLOCK_SIZE              64
+
+template<typename T, typename F> static void
+_sort_quick_insertion(T* begin, T* end, F& less) {
+  if (begin == end) return;
+  for (T* cur = begin + 1; cur != end; ++cur) {
+    T* sift = cur;
+    T* sift_1 = cur - 1;
+    if (less(*sift, *sift_1)) {
+      T e = *sift;
+      do { *sift-- = *sift_1; } 
+      while (sift != begin && less(e, *--sift_1));
+      *sift = e;
+    }
+  }
+}
+
+// @note: Assumes that the element before 'begin' is not greater 
+// than anything in the range, so it can stop the sift.
+template<typename T, typename F> static void
+_sort_quick_insertion_unguarded(T* begin, T* end, F& less) {
+  if (begin == end) return;
+  for (T* cur = begin + 1; cur != end; ++cur) {
+    T* sift = cur;
+    T* sift_1 = cur - 1;
+    if (less(*sift, *sift_1)) {
+      T e = *sift;
+      do { *sift-- = *sift_1; } 
+      while (less(e, *--sift_1));
+      *sift = e;
+    }
+  }
+}
+
+// Insertion sort that gives up after moving too many elements.
+// Returns true if the range got sorted.
+template<typename T, typename F> static b32_t
+_sort_quick_insertion_partial(T* begin, T* end, F& less) {
+  if (begin == end) return true;
+  usz_t moves = 0;
+  for (T* cur = begin + 1; cur != end; ++cur) {
+    T* sift = cur;
+    T* sift_1 = cur - 1;
+    if (less(*sift, *sift_1)) {
+      T e = *sift;
+      do { *sift-- = *sift_1; } 
+      while (sift != begin && less(e, *--sift_1));
+      *sift = e;
+      moves += (usz_t)(cur - sift);
+    }
+    if (moves > _SORT_QUICK_PARTIAL_INSERTION_LIMIT) return false;
+  }
+  return true;
+}
+
+template<typename T, typename F> static void
+_sort_quick_sort2(T* a, T* b, F& less) {
+  if (less(*b, *a)) swap(*a, *b);
+}
+
+template<typename T, typename F> static void
+_sort_quick_sort3(T* a, T* b, T* c, F& less) {
+  _sort_quick_sort2(a, b, less);
+  _sort_quick_sort2(b, c, less);
+  _sort_quick_sort2(a, b, less);
+}
+
+template<typename T, typename F> static void
+_sort_heap_sift_down(T* a, usz_t index, usz_t count, F& less) {
+  T e = a[index];
+  while (true) {
+    usz_t child = index * 2 + 1;
+    if (child >= count) break;
+    if (child + 1 < count && less(a[child], a[child+1])) ++child;
+    if (!less(e, a[child])) break;
+    a[index] = a[child];
+    index = child;
+  }
+  a[index] = e;
+}
+
+template<typename T, typename F> static void
+_sort_heap(T* begin, T* end, F& less) {
+  usz_t count = (usz_t)(end - begin);
+  for (usz_t i = count / 2; i > 0; --i) {
+    _sort_heap_sift_down(begin, i - 1, count, less);
+  }
+  for (usz_t i = count; i > 1; --i) {
+    swap(begin[0], begin[i-1]);
+    _sort_heap_sift_down(begin, 0, i - 1, less);
+  }
+}
+
+// Swaps the elements at 'first + offsets_l[i]' with 'last - offsets_r[i]'.
+// If the counts were not the same, a cyclic permutation is enough,
+// which saves a copy per element.
+template<typename T> static void
+_sort_quick_swap_offsets(T* first, T* last, u8_t* offsets_l, u8_t* offsets_r, usz_t count, b32_t use_swaps) {
+  if (use_swaps) {
+    for (usz_t i = 0; i < count; ++i) {
+      swap(*(first + offsets_l[i]), *(last - offsets_r[i]));
+    }
+  }
+  else if (count > 0) {
+    T* l = first + offsets_l[0];
+    T* r = last - offsets_r[0];
+    T e = *l; 
+    *l = *r;
+    for (usz_t i = 1; i < count; ++i) {
+      l = first + offsets_l[i]; 
+      *r = *l;
+      r = last - offsets_r[i]; 
+      *l = *r;
+    }
+    *r = e;
+  }
+}
+
+// Partitions around the pivot at 'begin'. Everything equal to the
+// pivot goes to the right. Returns the pivot's final place and whether
+// nothing had to be moved.
+template<typename T, typename F> static T*
+_sort_quick_partition_right(T* begin, T* end, F& less, b32_t* out_already_partitioned) {
+  T pivot = *begin;
+  T* first = begin;
+  T* last = end;
+
+  // @note: The median selection put something that is not less than
+  // the pivot at the end, so the first search does not need a guard.
+  while (less(*++first, pivot));
+  if (first - 1 == begin) {
+    while (first < last && !less(*--last, pivot));
+  }
+  else {
+    while (!less(*--last, pivot));
+  }
+
+  b32_t already_partitioned = first >= last;
+  if (!already_partitioned) {
+    swap(*first, *last);
+    ++first;
+
+    alignas(64) u8_t offsets_l[_SORT_QUICK_BLOCK_SIZE];
+    alignas(64) u8_t offsets_r[_SORT_QUICK_BLOCK_SIZE];
+    T* offsets_l_base = first;
+    T* offsets_r_base = last;
+    usz_t num_l = 0, num_r = 0, start_l = 0, start_r = 0;
+
+    while (first < last) {
+      // Fill the offset buffers that are empty with elements that
+      // are on the wrong side.
+      usz_t num_unknown = (usz_t)(last - first);
+      usz_t left_split = num_l == 0 ? (num_r == 0 ? num_unknown / 2 : num_unknown) : 0;
+      usz_t right_split = num_r == 0 ? (num_unknown - left_split) : 0;
+
+      if (left_split >= _SORT_QUICK_BLOCK_SIZE) {
+        for (u32_t i = 0; i < _SORT_QUICK_BLOCK_SIZE;) {
+          offsets_l[num_l] = (u8_t)i++; num_l += !less(*first, pivot); ++first;
+          offsets_l[num_l] = (u8_t)i++; num_l += !less(*first, pivot); ++first;
+          offsets_l[num_l] = (u8_t)i++; num_l += !less(*first, pivot); ++first;
+          offsets_l[num_l] = (u8_t)i++; num_l += !less(*first, pivot); ++first;
+        }
+      }
+      else {
+        for (u32_t i = 0; i < left_split;) {
+          offsets_l[num_l] = (u8_t)i++; num_l += !less(*first, pivot); ++first;
+        }
+      }
+
+      if (right_split >= _SORT_QUICK_BLOCK_SIZE) {
+        for (u32_t i = 0; i < _SORT_QUICK_BLOCK_SIZE;) {
+          offsets_r[num_r] = (u8_t)++i; num_r += less(*--last, pivot);
+          offsets_r[num_r] = (u8_t)++i; num_r += less(*--last, pivot);
+          offsets_r[num_r] = (u8_t)++i; num_r += less(*--last, pivot);
+          offsets_r[num_r] = (u8_t)++i; num_r += less(*--last, pivot);
+        }
+      }
+      else {
+        for (u32_t i = 0; i < right_split;) {
+          offsets_r[num_r] = (u8_t)++i; num_r += less(*--last, pivot);
+        }
+      }
+
+      usz_t num = min_of(num_l, num_r);
+      _sort_quick_swap_offsets(offsets_l_base, offsets_r_base, offsets_l + start_l, offsets_r + start_r, num, num_l == num_r);
+      num_l -= num; 
+      num_r -= num;
+      start_l += num; 
+      start_r += num;
+      if (num_l == 0) {
+        start_l = 0;
+        offsets_l_base = first;
+      }
+      if (num_r == 0) {
+        start_r = 0;
+        offsets_r_base = last;
+      }
+    }
+
+    // One of the buffers may still have elements on the wrong side.
+    // Swap them to the middle.
+    if (num_l) {
+      u8_t* offsets = offsets_l + start_l;
+      while (num_l--) {
+        --last;
+        swap(*(offsets_l_base + offsets[num_l]), *last);
+      }
+      first = last;
+    }
+    if (num_r) {
+      u8_t* offsets = offsets_r + start_r;
+      while (num_r--) {
+        swap(*(offsets_r_base - offsets[num_r]), *first);
+        ++first;
+      }
+      last = first;
+    }
+  }
+
+  T* pivot_pos = first - 1;
+  *begin = *pivot_pos;
+  *pivot_pos = pivot;
+  *out_already_partitioned = already_partitioned;
+  return pivot_pos;
+}
+
+// Partitions around the pivot at 'begin' with everything equal to it
+// on the left. Only used when the pivot is known to be the smallest
+// element of the range, so the left side is all equal.
+template<typename T, typename F> static T*
+_sort_quick_partition_left(T* begin, T* end, F& less) {
+  T pivot = *begin;
+  T* first = begin;
+  T* last = end;
+
+  while (less(pivot, *--last));
+  if (last + 1 == end) {
+    while (first < last && !less(pivot, *++first));
+  }
+  else {
+    while (!less(pivot, *++first));
+  }
+
+  while (first < last) {
+    swap(*first, *last);
+    while (less(pivot, *--last));
+    while (!less(pivot, *++first));
+  }
+
+  T* pivot_pos = last;
+  *begin = *pivot_pos;
+  *pivot_pos = pivot;
+  return pivot_pos;
+}
+
+template<typename T, typename F> static void
+_sort_quick_loop(T* begin, T* end, F& less, u32_t bad_allowed, b32_t leftmost) {
+  while (true) {
+    usz_t size = (usz_t)(end - begin);
+    if (size < _SORT_QUICK_INSERTION_COUNT) {
+      if (leftmost) _sort_quick_insertion(begin, end, less);
+      else _sort_quick_insertion_unguarded(begin, end, less);
+      return;
+    }
+
+    // Move the pivot to 'begin'
+    usz_t s2 = size / 2;
+    if (size > _SORT_QUICK_NINTHER_COUNT) {
+      _sort_quick_sort3(begin, begin + s2, end - 1, less);
+      _sort_quick_sort3(begin + 1, begin + (s2 - 1), end - 2, less);
+      _sort_quick_sort3(begin + 2, begin + (s2 + 1), end - 3, less);
+      _sort_quick_sort3(begin + (s2 - 1), begin + s2, begin + (s2 + 1), less);
+      swap(*begin, *(begin + s2));
+    }
+    else {
+      _sort_quick_sort3(begin + s2, begin, end - 1, less);
+    }
+
+    // If the element before us is not less than the pivot, the pivot 
+    // is the smallest in the range, so all the elements equal to it 
+    // can be skipped.
+    if (!leftmost && !less(*(begin - 1), *begin)) {
+      begin = _sort_quick_partition_left(begin, end, less) + 1;
+      continue;
+    }
+
+    b32_t already_partitioned;
+    T* pivot_pos = _sort_quick_partition_right(begin, end, less, &already_partitioned);
+
+    usz_t l_size = (usz_t)(pivot_pos - begin);
+    usz_t r_size = (usz_t)(end - (pivot_pos + 1));
+    b32_t is_highly_unbalanced = l_size < size / 8 || r_size < size / 8;
+
+    if (is_highly_unbalanced) {
+      if (--bad_allowed == 0) {
+        _sort_heap(begin, end, less);
+        return;
+      }
+
+      // Shuffle a few elements to break up patterns
+      if (l_size >= _SORT_QUICK_INSERTION_COUNT) {
+        swap(*begin, *(begin + l_size / 4));
+        swap(*(pivot_pos - 1), *(pivot_pos - l_size / 4));
+        if (l_size > _SORT_QUICK_NINTHER_COUNT) {
+          swap(*(begin + 1), *(begin + (l_size / 4 + 1)));
+          swap(*(begin + 2), *(begin + (l_size / 4 + 2)));
+          swap(*(pivot_pos - 2), *(pivot_pos - (l_size / 4 + 1)));
+          swap(*(pivot_pos - 3), *(pivot_pos - (l_size / 4 + 2)));
+        }
+      }
+      if (r_size >= _SORT_QUICK_INSERTION_COUNT) {
+        swap(*(pivot_pos + 1), *(pivot_pos + (1 + r_size / 4)));
+        swap(*(end - 1), *(end - r_size / 4));
+        if (r_size > _SORT_QUICK_NINTHER_COUNT) {
+          swap(*(pivot_pos + 2), *(pivot_pos + (2 + r_size / 4)));
+          swap(*(pivot_pos + 3), *(pivot_pos + (3 + r_size / 4)));
+          swap(*(end - 2), *(end - (1 + r_size / 4)));
+          swap(*(end - 3), *(end - (2 + r_size / 4)));
+        }
+      }
+    }
+    else if (already_partitioned && 
+        _sort_quick_insertion_partial(begin, pivot_pos, less) &&
+        _sort_quick_insertion_partial(pivot_pos + 1, end, less)) 
+    {
+      return;
+    }
+
+    // Recurse on the left, loop on the right
+    _sort_quick_loop(begin, pivot_pos, less, bad_allowed, leftmost);
+    begin = pivot_pos + 1;
+    leftmost = false;
+  }
+}
+
+template<typename T, typename F> static void
+sort_quick(T* arr, u32_t count, F less) {
+  if (count < 2) return;
+  u32_t bad_allowed = 32 - u32_clz(count);
+  _sort_quick_loop(arr, arr + count, less, bad_allowed, true);
+}
+
+static void
+sort_quick(sort_entry_t* entries, u32_t entry_count) {
+  sort_quick(entries, entry_count, [](const sort_entry_t& lhs, const sort_entry_t& rhs) {
+    return lhs.key < rhs.key;
+  });
+}
+
+//
+// Merge sort
+//
+// @note: The array is cut into one chunk per worker and each chunk is
+// quick sorted as a job. Then pairs of sorted runs are merged until 
+// there is one left. So that all the workers stay busy when there are 
+// fewer pairs than workers, each merge is cut into parts: the output 
+// is split evenly and a binary search finds where each part starts in 
+// both runs.
+//
+#define _SORT_MERGE_MIN_CHUNK_SIZE (1 << 14)
+#define _SORT_MERGE_MIN_PART_SIZE  (1 << 14)
+
+template<typename T, typename F>
+struct _sort_merge_job_t {
+  F* less;
+  T* src;
+  T* dest;
+
+  // Sorting: [a_begin, a_end) of 'src' in place
+  // Merging: [a_begin, a_end) and [b_begin, b_end) of 'src' into 'dest' at 'dest_begin'
+  u32_t a_begin, a_end;
+  u32_t b_begin, b_end;
+  u32_t dest_begin;
+};
+
+template<typename T, typename F> static void
+_sort_merge_sort_job(void* data) {
+  auto* job = (_sort_merge_job_t<T,F>*)data;
+  sort_quick(job->src + job->a_begin, job->a_end - job->a_begin, *job->less);
+}
+
+template<typename T, typename F> static void
+_sort_merge_merge_job(void* data) {
+  auto* job = (_sort_merge_job_t<T,F>*)data;
+  F& less = *job->less;
+  T* a = job->src + job->a_begin;
+  T* a_end = job->src + job->a_end;
+  T* b = job->src + job->b_begin;
+  T* b_end = job->src + job->b_end;
+  T* dest = job->dest + job->dest_begin;
+
+  while (a != a_end && b != b_end) {
+    // @note: Take from 'a' on ties, so merging is stable
+    if (less(*b, *a)) *dest++ = *b++;
+    else *dest++ = *a++;
+  }
+  while (a != a_end) *dest++ = *a++;
+  while (b != b_end) *dest++ = *b++;
+}
+
+// Returns how many elements of 'a' are in the first 'index' 
+// elements of the merge of 'a' and 'b'.
+template<typename T, typename F> static u32_t
+_sort_merge_find_split(u32_t index, T* a, u32_t a_count, T* b, u32_t b_count, F& less) {
+  u32_t lo = index > b_count ? index - b_count : 0;
+  u32_t hi = min_of(index, a_count);
+  while (lo < hi) {
+    u32_t a_index = lo + (hi - lo) / 2;
+    u32_t b_index = index - a_index;
+    // a[a_index] comes before b[b_index-1], so more of 'a' is needed
+    if (!less(b[b_index-1], a[a_index])) lo = a_index + 1;
+    else hi = a_index;
+  }
+  return lo;
+}
+
+template<typename T, typename F> static b32_t
+sort_merge(T* arr, u32_t count, F less, arena_t* arena, job_system_t* js) {
+  u32_t worker_count = js ? js->worker_count : 1;
+  u32_t chunk_count = clamp_of(count / _SORT_MERGE_MIN_CHUNK_SIZE, 1, worker_count);
+  if (chunk_count == 1) {
+    sort_quick(arr, count, less);
+    return true;
+  }
+
+  arena_set_revert_point(arena);
+  T* tmp = arena_push_arr(T, arena, count);
+  u32_t* run_begins = arena_push_arr(u32_t, arena, chunk_count + 1);
+  u32_t max_jobs = max_of(chunk_count, worker_count);
+  typedef _sort_merge_job_t<T,F> merge_job_t;
+  merge_job_t* jobs = arena_push_arr(merge_job_t, arena, max_jobs);
+  if (!tmp || !run_begins || !jobs) {
+    return false;
+  }
+
+  // Sort the chunks
+  job_counter_t counter = {};
+  for (u32_t chunk_index = 0; chunk_index < chunk_count; ++chunk_index) {
+    run_begins[chunk_index] = (u32_t)((u64_t)count * chunk_index / chunk_count);
+  }
+  run_begins[chunk_count] = count;
+  for (u32_t chunk_index = 0; chunk_index < chunk_count; ++chunk_index) {
+    merge_job_t* job = jobs + chunk_index;
+    job->less = &less;
+    job->src = arr;
+    job->a_begin = run_begins[chunk_index];
+    job->a_end = run_begins[chunk_index + 1];
+    job_add(js, _sort_merge_sort_job<T,F>, job, &counter);
+  }
+  job_wait(js, &counter);
+
+  // Merge pairs of runs until there is one
+  T* src = arr;
+  T* dest = tmp;
+  u32_t run_count = chunk_count;
+  while (run_count > 1) {
+    u32_t pair_count = (run_count + 1) / 2;
+    u32_t parts_per_pair = max_of(worker_count / pair_count, 1);
+    u32_t job_count = 0;
+
+    for (u32_t pair_index = 0; pair_index < pair_count; ++pair_index) {
+      u32_t a_begin = run_begins[pair_index * 2];
+      u32_t b_begin = run_begins[min_of(pair_index * 2 + 1, run_count)];
+      u32_t b_end = run_begins[min_of(pair_index * 2 + 2, run_count)];
+      u32_t a_count = b_begin - a_begin;
+      u32_t b_count = b_end - b_begin;
+      u32_t pair_size = a_count + b_count;
+      u32_t part_count = clamp_of(pair_size / _SORT_MERGE_MIN_PART_SIZE, 1, parts_per_pair);
+
+      u32_t prev_index = 0;
+      u32_t prev_a = 0;
+      for (u32_t part_index = 1; part_index <= part_count; ++part_index) {
+        u32_t index = (u32_t)((u64_t)pair_size * part_index / part_count);
+        u32_t split_a = (part_index == part_count) ? a_count : 
+          _sort_merge_find_split(index, src + a_begin, a_count, src + b_begin, b_count, less);
+
+        assert(job_count < max_jobs);
+        merge_job_t* job = jobs + job_count++;
+        job->less = &less;
+        job->src = src;
+        job->dest = dest;
+        job->a_begin = a_begin + prev_a;
+        job->a_end = a_begin + split_a;
+        job->b_begin = b_begin + (prev_index - prev_a);
+        job->b_end = b_begin + (index - split_a);
+        job->dest_begin = a_begin + prev_index;
+        job_add(js, _sort_merge_merge_job<T,F>, job, &counter);
+
+        prev_index = index;
+        prev_a = split_a;
+      }
+    }
+    job_wait(js, &counter);
+
+    for (u32_t pair_index = 0; pair_index < pair_count; ++pair_index) {
+      run_begins[pair_index] = run_begins[pair_index * 2];
+    }
+    run_begins[pair_count] = count;
+    run_count = pair_count;
+    swap(src, dest);
+  }
+
+  if (src != arr) {
+    memory_copy(arr, src, sizeof(T) * count);
+  }
+  return true;
+}
+
+
+//
+// @mark:(Bonk)
+//
+static b32_t
+_bonk_tri2_pt2_parametric(v2f_t tp0, v2f_t tp1, v2f_t tp2, v2f_t pt) {
+  f32_t denominator = (tp0.x*(tp1.y - tp2.y) + 
+      tp0.y*(tp2.x - tp1.x) + 
+      tp1.x*tp2.y - tp1.y*tp2.x);
+
+  f32_t t1 = (pt.x*(tp2.y - tp0.y) + 
+      pt.y*(tp0.x - tp2.x) - 
+      tp0.x*tp2.y + tp0.y*tp2.x) / denominator;
+
+  f32_t t2 = (pt.x*(tp1.y - tp0.y) + 
+      pt.y*(tp0.x - tp1.x) - 
+      tp0.x*tp1.y + tp0.y*tp1.x) / -denominator;
+
+  f32_t s = t1 + t2;
+
+  return 0 <= t1 && t1 <= 1 && 0 <= t2 && t2 <= 1 && s <= 1;
+}
+
+// Unoptimized: ~72 cycles/hit
+// -O2: ~27 cycles/hit 
+static b32_t
+_bonk_tri2_pt2_barycentric(v2f_t tp0, v2f_t tp1, v2f_t tp2, v2f_t pt) {
+
+  f32_t denominator = ((tp1.y - tp2.y)*
+      (tp0.x - tp2.x) + (tp2.x - tp1.x)*
+      (tp0.y - tp2.y));
+
+  f32_t a = ((tp1.y - tp2.y)*
+      (pt.x - tp2.x) + (tp2.x - tp1.x)*
+      (pt.y - tp2.y)) / denominator;
+
+  f32_t b = ((tp2.y - tp0.y)*
+      (pt.x - tp2.x) + (tp0.x - tp2.x)*
+      (pt.y - tp2.y)) / denominator;
+
+  f32_t c = 1.f - a - b;
+
+  return 0.f <= a && a <= 1.f && 0.f <= b && b <= 1.f && 0.f <= c && c <= 1.f;
+
+}
+
+// Unoptimized: ~262 cycles/hit
+// -O2: ~27 cycles/hit 
+static b32_t
+_bonk_tri2_pt2_dot_product(v2f_t tp0, v2f_t tp1, v2f_t tp2, v2f_t pt) {
+  v2f_t vec0 = v2f_set(pt.x - tp0.x, pt.y - tp0.y);      
+  v2f_t vec1 = v2f_set(pt.x - tp1.x, pt.y - tp1.y);      
+  v2f_t vec2 = v2f_set(pt.x - tp2.x, pt.y - tp2.y);      
+
+  v2f_t n0 = v2f_set(tp1.y - tp0.y, -tp1.x + tp0.x);
+  v2f_t n1 = v2f_set(tp2.y - tp1.y, -tp2.x + tp1.x);
+  v2f_t n2 = v2f_set(tp0.y - tp2.y, -tp0.x + tp2.x);
+
+  b32_t side0 = v2f_dot(n0,vec0) < 0.f;
+  b32_t side1 = v2f_dot(n1,vec1) < 0.f;
+  b32_t side2 = v2f_dot(n2,vec2) < 0.f;
+
+  return side0 == side1 && side0 == side2;
+}
+
+
+static b32_t
+bonk_tri2_pt2(v2f_t tp0, v2f_t tp1, v2f_t tp2, v2f_t pt) {
+  // @note(momo): this is the fastest of the 3 apparently
+  return _bonk_tri2_pt2_barycentric(tp0, tp1, tp2, pt);
+}
+
+static b32_t
+seg2_soa_init(seg2_soa_t* segs, u32_t cap, arena_t* arena) {
+  cap = align_up_pow2(cap, 8);
+  segs->count = 0;
+  segs->cap = cap;
+  segs->start_x = arena_push_arr_align(f32_t, arena, cap, 32);
+  segs->start_y = arena_push_arr_align(f32_t, arena, cap, 32);
+  segs->delta_x = arena_push_arr_align(f32_t, arena, cap, 32);
+  segs->delta_y = arena_push_arr_align(f32_t, arena, cap, 32);
+  return segs->start_x && segs->start_y && segs->delta_x && segs->delta_y;
+}
+
+static void
+seg2_soa_set(seg2_soa_t* segs, u32_t index, v2f_t start, v2f_t end) {
+  assert(index < segs->cap);
+  segs->start_x[index] = start.x;
+  segs->start_y[index] = start.y;
+  segs->delta_x[index] = end.x - start.x;
+  segs->delta_y[index] = end.y - start.y;
+}
+
+// @note: Every multiply and add is its own statement so that the compiler 
+// cannot fuse them into FMAs, which would make the results differ from
+// the SIMD versions below.
+static f32_t
+bonk_ray2_seg2(v2f_t ray_origin, v2f_t ray_dir, v2f_t seg_start, v2f_t seg_delta, f32_t max_t) {
+  f32_t a = seg_delta.x * ray_dir.y;
+  f32_t b = seg_delta.y * ray_dir.x;
+  f32_t denom = a - b;
+
+  // parallel
+  if (f32_abs(denom) <= F32_EPSILON) return max_t;
+
+  f32_t c = ray_dir.x * (seg_start.y - ray_origin.y);
+  f32_t d = ray_dir.y * (ray_origin.x - seg_start.x);
+  f32_t t2 = (c + d) / denom;
+
+  f32_t e = seg_delta.x * t2;
+  f32_t t1 = ((seg_start.x + e) - ray_origin.x) / ray_dir.x;
+
+  if (0.f < t1 && 0.f < t2 && t2 < 1.f && t1 < max_t) {
+    return t1;
+  }
+  return max_t;
+}
+
+#if MOMO_AVX2
+// @note: Same math as bonk_ray2_seg2() on 8 lanes. Lanes that hit
+// something closer than 'best' are updated.
+static __m256
+_bonk_ray2_seg2_x8(__m256 ox, __m256 oy, __m256 rx, __m256 ry, 
+                   __m256 sx, __m256 sy, __m256 dx, __m256 dy, 
+                   __m256 best) 
+{
+  const __m256 zero = _mm256_setzero_ps();
+  const __m256 one = _mm256_set1_ps(1.f);
+  const __m256 epsilon = _mm256_set1_ps(F32_EPSILON);
+  const __m256 abs_mask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+
+  __m256 a = _mm256_mul_ps(dx, ry);
+  __m256 b = _mm256_mul_ps(dy, rx);
+  __m256 denom = _mm256_sub_ps(a, b);
+
+  __m256 c = _mm256_mul_ps(rx, _mm256_sub_ps(sy, oy));
+  __m256 d = _mm256_mul_ps(ry, _mm256_sub_ps(ox, sx));
+  __m256 t2 = _mm256_div_ps(_mm256_add_ps(c, d), denom);
+
+  __m256 e = _mm256_mul_ps(dx, t2);
+  __m256 t1 = _mm256_div_ps(_mm256_sub_ps(_mm256_add_ps(sx, e), ox), rx);
+
+  __m256 mask = _mm256_cmp_ps(_mm256_and_ps(denom, abs_mask), epsilon, _CMP_GT_OQ);
+  mask = _mm256_and_ps(mask, _mm256_cmp_ps(zero, t1, _CMP_LT_OQ));
+  mask = _mm256_and_ps(mask, _mm256_cmp_ps(zero, t2, _CMP_LT_OQ));
+  mask = _mm256_and_ps(mask, _mm256_cmp_ps(t2, one, _CMP_LT_OQ));
+  mask = _mm256_and_ps(mask, _mm256_cmp_ps(t1, best, _CMP_LT_OQ));
+  return _mm256_blendv_ps(best, t1, mask);
+}
+
+static f32_t
+_bonk_hmin_x8(__m256 v) {
+  __m128 m = _mm_min_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+  m = _mm_min_ps(m, _mm_movehl_ps(m, m));
+  m = _mm_min_ss(m, _mm_shuffle_ps(m, m, 1));
+  return _mm_cvtss_f32(m);
+}
+#endif // MOMO_AVX2
+
+#if MOMO_SSE2
+static __m128
+_bonk_ray2_seg2_x4(__m128 ox, __m128 oy, __m128 rx, __m128 ry, 
+                   __m128 sx, __m128 sy, __m128 dx, __m128 dy, 
+                   __m128 best) 
+{
+  const __m128 zero = _mm_setzero_ps();
+  const __m128 one = _mm_set1_ps(1.f);
+  const __m128 epsilon = _mm_set1_ps(F32_EPSILON);
+  const __m128 abs_mask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+
+  __m128 a = _mm_mul_ps(dx, ry);
+  __m128 b = _mm_mul_ps(dy, rx);
+  __m128 denom = _mm_sub_ps(a, b);
+
+  __m128 c = _mm_mul_ps(rx, _mm_sub_ps(sy, oy));
+  __m128 d = _mm_mul_ps(ry, _mm_sub_ps(ox, sx));
+  __m128 t2 = _mm_div_ps(_mm_add_ps(c, d), denom);
+
+  __m128 e = _mm_mul_ps(dx, t2);
+  __m128 t1 = _mm_div_ps(_mm_sub_ps(_mm_add_ps(sx, e), ox), rx);
+
+  __m128 mask = _mm_cmpgt_ps(_mm_and_ps(denom, abs_mask), epsilon);
+  mask = _mm_and_ps(mask, _mm_cmplt_ps(zero, t1));
+  mask = _mm_and_ps(mask, _mm_cmplt_ps(zero, t2));
+  mask = _mm_and_ps(mask, _mm_cmplt_ps(t2, one));
+  mask = _mm_and_ps(mask, _mm_cmplt_ps(t1, best));
+  return _mm_or_ps(_mm_and_ps(mask, t1), _mm_andnot_ps(mask, best));
+}
+
+static f32_t
+_bonk_hmin_x4(__m128 m) {
+  m = _mm_min_ps(m, _mm_movehl_ps(m, m));
+  m = _mm_min_ss(m, _mm_shuffle_ps(m, m, 1));
+  return _mm_cvtss_f32(m);
+}
+#endif // MOMO_SSE2
+
+static f32_t
+bonk_ray2_segs2(v2f_t ray_origin, v2f_t ray_dir, seg2_soa_t* segs, u32_t first, u32_t count, f32_t max_t) {
+  f32_t lowest_t1 = max_t;
+  u32_t i = first;
+  u32_t end = first + count;
+  assert(end <= segs->cap);
+
+#if MOMO_AVX2
+  if (i + 8 <= end) {
+    __m256 ox = _mm256_set1_ps(ray_origin.x);
+    __m256 oy = _mm256_set1_ps(ray_origin.y);
+    __m256 rx = _mm256_set1_ps(ray_dir.x);
+    __m256 ry = _mm256_set1_ps(ray_dir.y);
+    __m256 best = _mm256_set1_ps(lowest_t1);
+    for (; i + 8 <= end; i += 8) {
+      best = _bonk_ray2_seg2_x8(ox, oy, rx, ry,
+          _mm256_loadu_ps(segs->start_x + i),
+          _mm256_loadu_ps(segs->start_y + i),
+          _mm256_loadu_ps(segs->delta_x + i),
+          _mm256_loadu_ps(segs->delta_y + i),
+          best);
+    }
+    lowest_t1 = _bonk_hmin_x8(best);
+  }
+#endif // MOMO_AVX2
+
+#if MOMO_SSE2
+  if (i + 4 <= end) {
+    __m128 ox = _mm_set1_ps(ray_origin.x);
+    __m128 oy = _mm_set1_ps(ray_origin.y);
+    __m128 rx = _mm_set1_ps(ray_dir.x);
+    __m128 ry = _mm_set1_ps(ray_dir.y);
+    __m128 best = _mm_set1_ps(lowest_t1);
+    for (; i + 4 <= end; i += 4) {
+      best = _bonk_ray2_seg2_x4(ox, oy, rx, ry,
+          _mm_loadu_ps(segs->start_x + i),
+          _mm_loadu_ps(segs->start_y + i),
+          _mm_loadu_ps(segs->delta_x + i),
+          _mm_loadu_ps(segs->delta_y + i),
+          best);
+    }
+    lowest_t1 = _bonk_hmin_x4(best);
+  }
+#endif // MOMO_SSE2
+
+  for (; i < end; ++i) {
+    v2f_t start = v2f_set(segs->start_x[i], segs->start_y[i]);
+    v2f_t delta = v2f_set(segs->delta_x[i], segs->delta_y[i]);
+    lowest_t1 = bonk_ray2_seg2(ray_origin, ray_dir, start, delta, lowest_t1);
+  }
+  return lowest_t1;
+}
+
+static void
+bonk_rays2_segs2(v2f_t ray_origin, const v2f_t* ray_dirs, f32_t* ray_ts, u32_t ray_count, seg2_soa_t* segs) {
+  u32_t r = 0;
+
+#if MOMO_AVX2
+  {
+    __m256 ox = _mm256_set1_ps(ray_origin.x);
+    __m256 oy = _mm256_set1_ps(ray_origin.y);
+    for (; r + 8 <= ray_count; r += 8) {
+      // @note: deinterleave the 8 ray directions
+      __m256 lo = _mm256_loadu_ps(&ray_dirs[r].x);   // x0 y0 x1 y1 | x2 y2 x3 y3
+      __m256 hi = _mm256_loadu_ps(&ray_dirs[r+4].x); // x4 y4 x5 y5 | x6 y6 x7 y7
+      __m256 a = _mm256_permute2f128_ps(lo, hi, 0x20); // x0 y0 x1 y1 | x4 y4 x5 y5
+      __m256 b = _mm256_permute2f128_ps(lo, hi, 0x31); // x2 y2 x3 y3 | x6 y6 x7 y7
+      __m256 rx = _mm256_shuffle_ps(a, b, _MM_SHUFFLE(2,0,2,0)); // x0 x1 x2 x3 | x4 x5 x6 x7
+      __m256 ry = _mm256_shuffle_ps(a, b, _MM_SHUFFLE(3,1,3,1));
+      __m256 best = _mm256_loadu_ps(ray_ts + r);
+      for (u32_t i = 0; i < segs->count; ++i) {
+        best = _bonk_ray2_seg2_x8(ox, oy, rx, ry,
+            _mm256_broadcast_ss(segs->start_x + i),
+            _mm256_broadcast_ss(segs->start_y + i),
+            _mm256_broadcast_ss(segs->delta_x + i),
+            _mm256_broadcast_ss(segs->delta_y + i),
+            best);
+      }
+      _mm256_storeu_ps(ray_ts + r, best);
+    }
+  }
+#endif // MOMO_AVX2
+
+#if MOMO_SSE2
+  {
+    __m128 ox = _mm_set1_ps(ray_origin.x);
+    __m128 oy = _mm_set1_ps(ray_origin.y);
+    for (; r + 4 <= ray_count; r += 4) {
+      __m128 lo = _mm_loadu_ps(&ray_dirs[r].x);   // x0 y0 x1 y1
+      __m128 hi = _mm_loadu_ps(&ray_dirs[r+2].x); // x2 y2 x3 y3
+      __m128 rx = _mm_shuffle_ps(lo, hi, _MM_SHUFFLE(2,0,2,0));
+      __m128 ry = _mm_shuffle_ps(lo, hi, _MM_SHUFFLE(3,1,3,1));
+      __m128 best = _mm_loadu_ps(ray_ts + r);
+      for (u32_t i = 0; i < segs->count; ++i) {
+        best = _bonk_ray2_seg2_x4(ox, oy, rx, ry,
+            _mm_set1_ps(segs->start_x[i]),
+            _mm_set1_ps(segs->start_y[i]),
+            _mm_set1_ps(segs->delta_x[i]),
+            _mm_set1_ps(segs->delta_y[i]),
+            best);
+      }
+      _mm_storeu_ps(ray_ts + r, best);
+    }
+  }
+#endif // MOMO_SSE2
+
+  for (; r < ray_count; ++r) {
+    ray_ts[r] = bonk_ray2_segs2(ray_origin, ray_dirs[r], segs, 0, segs->count, ray_ts[r]);
+  }
+}
+
+//
+// @mark:(BVH2)
+//
+#define BVH2_BIN_COUNT       16
+#define BVH2_MAX_LEAF_SIZE   4 // must be 4; leaves are tested with the 4-wide kernel
+#define BVH2_MAX_SAH_DEPTH   40
+#define BVH2_MAX_STACK       128
+#define BVH2_REBUILD_RATIO   2.f // rebuild once refitting makes the tree this much worse
+
+static b32_t
+bvh2_init(bvh2_t* bvh, u32_t segment_cap, arena_t* arena) {
+  bvh->segment_cap = segment_cap;
+  bvh->starts = arena_push_arr(v2f_t, arena, segment_cap);
+  bvh->ends = arena_push_arr(v2f_t, arena, segment_cap);
+  bvh->indices = arena_push_arr(u32_t, arena, segment_cap);
+  bvh->nodes = arena_push_arr(bvh2_node_t, arena, segment_cap * 2);
+  bvh->leaf_seg_indices = arena_push_arr(u32_t, arena, segment_cap * BVH2_MAX_LEAF_SIZE);
+  if (!bvh->starts || !bvh->ends || !bvh->indices || !bvh->nodes || !bvh->leaf_seg_indices) 
+    return false;
+  if (!seg2_soa_init(&bvh->leaf_segs, segment_cap * BVH2_MAX_LEAF_SIZE, arena))
+    return false;
+  bvh->build_count = 0;
+  bvh->refit_count = 0;
+  bvh2_clear(bvh);
+  return true;
+}
+
+static void
+bvh2_clear(bvh2_t* bvh) {
+  bvh->segment_count = 0;
+  bvh->node_count = 0;
+  bvh->leaf_segs.count = 0;
+  bvh->is_built = false;
+  bvh->is_dirty = false;
+}
+
+static void
+bvh2_set_segment(bvh2_t* bvh, u32_t index, v2f_t start, v2f_t end) {
+  assert(index < bvh->segment_cap);
+  if (index >= bvh->segment_count) {
+    // @note: new segments can't be refitted into the tree 
+    bvh->segment_count = index + 1;
+    bvh->is_built = false;
+  }
+  else if (bvh->starts[index].x == start.x && bvh->starts[index].y == start.y &&
+           bvh->ends[index].x == end.x && bvh->ends[index].y == end.y) 
+  {
+    return;
+  }
+  bvh->starts[index] = start;
+  bvh->ends[index] = end;
+  bvh->is_dirty = true;
+}
+
+// @note: Boxes are padded a little so that hits computed by 
+// bvh2_raycast() that land right on the edge of a box are not culled. 
+static f32_t
+_bvh2_pad(f32_t v) {
+  return 1e-3f + f32_abs(v) * 1e-5f;
+}
+
+static void
+_bvh2_get_segment_box(bvh2_t* bvh, u32_t segment_index, v2f_t* min, v2f_t* max) {
+  v2f_t s = bvh->starts[segment_index];
+  v2f_t e = bvh->ends[segment_index];
+  min->x = min_of(s.x, e.x);
+  min->y = min_of(s.y, e.y);
+  max->x = max_of(s.x, e.x);
+  max->y = max_of(s.y, e.y);
+  min->x -= _bvh2_pad(min->x);
+  min->y -= _bvh2_pad(min->y);
+  max->x += _bvh2_pad(max->x);
+  max->y += _bvh2_pad(max->y);
+}
+
+static f32_t 
+_bvh2_perimeter(v2f_t min, v2f_t max) {
+  return (max.x - min.x) + (max.y - min.y);
+}
+
+static void
+_bvh2_fit_segments(bvh2_t* bvh, bvh2_node_t* node, u32_t* segment_indices, u32_t count) {
+  node->min = v2f_set(F32_INFINITY, F32_INFINITY);
+  node->max = v2f_set(-F32_INFINITY, -F32_INFINITY);
+  for (u32_t i = 0; i < count; ++i) {
+    v2f_t min, max;
+    _bvh2_get_segment_box(bvh, segment_indices[i], &min, &max);
+    node->min.x = min_of(node->min.x, min.x);
+    node->min.y = min_of(node->min.y, min.y);
+    node->max.x = max_of(node->max.x, max.x);
+    node->max.y = max_of(node->max.y, max.y);
+  }
+}
+
+// Moves the node's segments into its own 4 slots in 'leaf_segs'.
+static void
+_bvh2_make_leaf(bvh2_t* bvh, bvh2_node_t* node) {
+  assert(node->count <= BVH2_MAX_LEAF_SIZE);
+  u32_t slot = bvh->leaf_segs.count;
+  bvh->leaf_segs.count += BVH2_MAX_LEAF_SIZE;
+  for (u32_t i = 0; i < BVH2_MAX_LEAF_SIZE; ++i) {
+    if (i < node->count) {
+      u32_t s = bvh->indices[node->first + i];
+      bvh->leaf_seg_indices[slot + i] = s;
+      seg2_soa_set(&bvh->leaf_segs, slot + i, bvh->starts[s], bvh->ends[s]);
+    }
+    else {
+      // @note: zero-length segments are 'parallel' to everything
+      bvh->leaf_seg_indices[slot + i] = U32_MAX;
+      seg2_soa_set(&bvh->leaf_segs, slot + i, v2f_zero(), v2f_zero());
+    }
+  }
+  node->first = slot;
+}
+
+static void
+_bvh2_refit_leaf(bvh2_t* bvh, bvh2_node_t* node) {
+  for (u32_t i = 0; i < node->count; ++i) {
+    u32_t s = bvh->leaf_seg_indices[node->first + i];
+    seg2_soa_set(&bvh->leaf_segs, node->first + i, bvh->starts[s], bvh->ends[s]);
+  }
+  _bvh2_fit_segments(bvh, node, bvh->leaf_seg_indices + node->first, node->count);
+}
+
+static void
+_bvh2_fit_internal(bvh2_node_t* node, bvh2_node_t* left, bvh2_node_t* right) {
+  node->min.x = min_of(left->min.x, right->min.x);
+  node->min.y = min_of(left->min.y, right->min.y);
+  node->max.x = max_of(left->max.x, right->max.x);
+  node->max.y = max_of(left->max.y, right->max.y);
+}
+
+// Binned SAH build (with perimeter instead of surface area, since we are in 2D).
+// Children are always allocated after their parents, which bvh2_refit() relies on.
+static void
+_bvh2_build_node(bvh2_t* bvh, u32_t node_index, u32_t depth) {
+  bvh2_node_t* node = bvh->nodes + node_index;
+  _bvh2_fit_segments(bvh, node, bvh->indices + node->first, node->count);
+  if (node->count <= BVH2_MAX_LEAF_SIZE) {
+    _bvh2_make_leaf(bvh, node);
+    return;
+  }
+
+  u32_t first = node->first;
+  u32_t count = node->count;
+
+  // Find centroid bounds
+  v2f_t cmin = v2f_set(F32_INFINITY, F32_INFINITY);
+  v2f_t cmax = v2f_set(-F32_INFINITY, -F32_INFINITY);
+  for (u32_t i = first; i < first + count; ++i) {
+    u32_t s = bvh->indices[i];
+    v2f_t c = (bvh->starts[s] + bvh->ends[s]) * 0.5f;
+    cmin.x = min_of(cmin.x, c.x); cmin.y = min_of(cmin.y, c.y);
+    cmax.x = max_of(cmax.x, c.x); cmax.y = max_of(cmax.y, c.y);
+  }
+  u32_t axis = (cmax.x - cmin.x) >= (cmax.y - cmin.y) ? 0 : 1;
+  f32_t axis_min = axis == 0 ? cmin.x : cmin.y;
+  f32_t axis_extent = axis == 0 ? (cmax.x - cmin.x) : (cmax.y - cmin.y);
+
+  u32_t left_count = 0;
+  if (axis_extent > 0.f && depth < BVH2_MAX_SAH_DEPTH) {
+    struct { v2f_t min, max; u32_t count; } bins[BVH2_BIN_COUNT];
+    for_arr(i, bins) {
+      bins[i].min = v2f_set(F32_INFINITY, F32_INFINITY);
+      bins[i].max = v2f_set(-F32_INFINITY, -F32_INFINITY);
+      bins[i].count = 0;
+    }
+    f32_t bin_scale = BVH2_BIN_COUNT / axis_extent;
+    for (u32_t i = first; i < first + count; ++i) {
+      u32_t s = bvh->indices[i];
+      v2f_t c = (bvh->starts[s] + bvh->ends[s]) * 0.5f;
+      u32_t b = min_of((u32_t)(((axis == 0 ? c.x : c.y) - axis_min) * bin_scale), (u32_t)BVH2_BIN_COUNT - 1);
+      v2f_t min, max;
+      _bvh2_get_segment_box(bvh, s, &min, &max);
+      bins[b].min.x = min_of(bins[b].min.x, min.x); bins[b].min.y = min_of(bins[b].min.y, min.y);
+      bins[b].max.x = max_of(bins[b].max.x, max.x); bins[b].max.y = max_of(bins[b].max.y, max.y);
+      ++bins[b].count;
+    }
+
+    // Sweep from the right to get the cost of every right side...
+    f32_t right_costs[BVH2_BIN_COUNT];
+    {
+      v2f_t min = v2f_set(F32_INFINITY, F32_INFINITY);
+      v2f_t max = v2f_set(-F32_INFINITY, -F32_INFINITY);
+      u32_t n = 0;
+      for (u32_t b = BVH2_BIN_COUNT - 1; b > 0; --b) {
+        min.x = min_of(min.x, bins[b].min.x); min.y = min_of(min.y, bins[b].min.y);
+        max.x = max_of(max.x, bins[b].max.x); max.y = max_of(max.y, bins[b].max.y);
+        n += bins[b].count;
+        right_costs[b] = n ? _bvh2_perimeter(min, max) * n : 0.f;
+      }
+    }
+
+    // ...then from the left to find the best split
+    f32_t best_cost = F32_INFINITY;
+    u32_t best_split = 0;
+    {
+      v2f_t min = v2f_set(F32_INFINITY, F32_INFINITY);
+      v2f_t max = v2f_set(-F32_INFINITY, -F32_INFINITY);
+      u32_t n = 0;
+      for (u32_t b = 0; b < BVH2_BIN_COUNT - 1; ++b) {
+        min.x = min_of(min.x, bins[b].min.x); min.y = min_of(min.y, bins[b].min.y);
+        max.x = max_of(max.x, bins[b].max.x); max.y = max_of(max.y, bins[b].max.y);
+        n += bins[b].count;
+        if (n == 0 || n == count) continue;
+        f32_t cost = _bvh2_perimeter(min, max) * n + right_costs[b+1];
+        if (cost < best_cost) {
+          best_cost = cost;
+          best_split = b + 1;
+        }
+      }
+    }
+
+    // @note: best_split is 0 if everything landed in one bin
+    if (best_split > 0) {
+      // Partition
+      u32_t i = first;
+      u32_t j = first + count;
+      while (i < j) {
+        u32_t s = bvh->indices[i];
+        v2f_t c = (bvh->starts[s] + bvh->ends[s]) * 0.5f;
+        u32_t b = min_of((u32_t)(((axis == 0 ? c.x : c.y) - axis_min) * bin_scale), (u32_t)BVH2_BIN_COUNT - 1);
+        if (b < best_split) {
+          ++i;
+        }
+        else {
+          --j;
+          swap(bvh->indices[i], bvh->indices[j]);
+        }
+      }
+      left_count = i - first;
+    }
+  }
+
+  if (left_count == 0 || left_count == count) {
+    // @note: Can't split spatially (or too deep); just halve it.
+    left_count = count / 2;
+  }
+
+  u32_t left_index = bvh->node_count;
+  bvh->node_count += 2;
+
+  bvh2_node_t* left = bvh->nodes + left_index;
+  left->first = first;
+  left->count = left_count;
+
+  bvh2_node_t* right = left + 1;
+  right->first = first + left_count;
+  right->count = count - left_count;
+
+  node->first = left_index;
+  node->count = 0;
+
+  _bvh2_build_node(bvh, left_index, depth + 1);
+  _bvh2_build_node(bvh, left_index + 1, depth + 1);
+}
+
+// Sums the perimeters of all nodes; used to tell how much a refit has degraded the tree.
+static f32_t
+_bvh2_get_cost(bvh2_t* bvh) {
+  f32_t cost = 0.f;
+  for (u32_t i = 0; i < bvh->node_count; ++i) {
+    cost += _bvh2_perimeter(bvh->nodes[i].min, bvh->nodes[i].max);
+  }
+  return cost;
+}
+
+static void
+bvh2_build(bvh2_t* bvh) {
+  for (u32_t i = 0; i < bvh->segment_count; ++i) {
+    bvh->indices[i] = i;
+  }
+  bvh->node_count = 0;
+  bvh->leaf_segs.count = 0;
+  if (bvh->segment_count > 0) {
+    bvh2_node_t* root = bvh->nodes + bvh->node_count++;
+    root->first = 0;
+    root->count = bvh->segment_count;
+    _bvh2_build_node(bvh, 0, 0);
+  }
+  bvh->built_cost = _bvh2_get_cost(bvh);
+  bvh->is_built = true;
+  bvh->is_dirty = false;
+  ++bvh->build_count;
+}
+
+static void
+bvh2_refit(bvh2_t* bvh) {
+  // @note: children always come after their parents
+  for (u32_t i = bvh->node_count; i-- > 0;) {
+    bvh2_node_t* node = bvh->nodes + i;
+    if (node->count) {
+      _bvh2_refit_leaf(bvh, node);
+    }
+    else {
+      _bvh2_fit_internal(node, bvh->nodes + node->first, bvh->nodes + node->first + 1);
+    }
+  }
+  bvh->is_dirty = false;
+  ++bvh->refit_count;
+}
+
+static void
+bvh2_update(bvh2_t* bvh) {
+  if (!bvh->is_built) {
+    bvh2_build(bvh);
+  }
+  else if (bvh->is_dirty) {
+    bvh2_refit(bvh);
+    if (_bvh2_get_cost(bvh) > bvh->built_cost * BVH2_REBUILD_RATIO) {
+      bvh2_build(bvh);
+    }
+  }
+}
+
+// Returns the time the ray enters the box, or F32_INFINITY if it misses.
+static f32_t
+_bvh2_ray_box(v2f_t ray_origin, v2f_t ray_dir, v2f_t inv_dir, bvh2_node_t* node, f32_t max_t) {
+  f32_t t_enter = 0.f;
+  f32_t t_exit = max_t;
+  for (u32_t axis = 0; axis < 2; ++axis) {
+    f32_t o = ray_origin.e[axis];
+    f32_t min = node->min.e[axis];
+    f32_t max = node->max.e[axis];
+    if (ray_dir.e[axis] == 0.f) {
+      if (o < min || o > max) return F32_INFINITY;
+    }
+    else {
+      f32_t ta = (min - o) * inv_dir.e[axis];
+      f32_t tb = (max - o) * inv_dir.e[axis];
+      if (ta > tb) swap(ta, tb);
+      t_enter = max_of(t_enter, ta);
+      t_exit = min_of(t_exit, tb);
+      if (t_enter > t_exit) return F32_INFINITY;
+    }
+  }
+  return t_enter;
+}
+
+static f32_t
+bvh2_raycast(bvh2_t* bvh, v2f_t ray_origin, v2f_t ray_dir, f32_t max_t) {
+  assert(bvh->is_built && !bvh->is_dirty);
+  f32_t lowest_t1 = max_t;
+  if (bvh->node_count == 0) return lowest_t1;
+
+  v2f_t inv_dir = v2f_set(1.f / ray_dir.x, 1.f / ray_dir.y);
+
+  struct { u32_t node_index; f32_t t_enter; } stack[BVH2_MAX_STACK];
+  u32_t stack_count = 0;
+
+  f32_t root_t = _bvh2_ray_box(ray_origin, ray_dir, inv_dir, bvh->nodes, lowest_t1);
+  if (root_t == F32_INFINITY) return lowest_t1;
+  stack[stack_count++] = { 0, root_t };
+
+  while(stack_count > 0) {
+    auto entry = stack[--stack_count];
+    if (entry.t_enter > lowest_t1) continue;
+
+    bvh2_node_t* node = bvh->nodes + entry.node_index;
+    if (node->count) {
+      lowest_t1 = bonk_ray2_segs2(ray_origin, ray_dir, &bvh->leaf_segs, node->first, BVH2_MAX_LEAF_SIZE, lowest_t1);
+    }
+    else {
+      u32_t l = node->first;
+      u32_t r = node->first + 1;
+      f32_t tl = _bvh2_ray_box(ray_origin, ray_dir, inv_dir, bvh->nodes + l, lowest_t1);
+      f32_t tr = _bvh2_ray_box(ray_origin, ray_dir, inv_dir, bvh->nodes + r, lowest_t1);
+
+      // @note: push the farther child first so that we visit the nearer one first
+      if (tl > tr) {
+        swap(l, r);
+        swap(tl, tr);
+      }
+      assert(stack_count + 2 <= BVH2_MAX_STACK);
+      if (tr != F32_INFINITY) stack[stack_count++] = { r, tr };
+      if (tl != F32_INFINITY) stack[stack_count++] = { l, tl };
+    }
+  }
+  return lowest_t1;
+}
+
+//
+// @mark:(Hashmap)
+//
+#define _HASHMAP_CTRL_EMPTY   ((u8_t)0x80)
+#define _HASHMAP_CTRL_DELETED ((u8_t)0xFE)
+
+static u64_t hashmap_hash(u32_t key) { return hash_u64(key); }
+static u64_t hashmap_hash(s32_t key) { return hash_u64((u32_t)key); }
+static u64_t hashmap_hash(u64_t key) { return hash_u64(key); }
+static u64_t hashmap_hash(s64_t key) { return hash_u64((u64_t)key); }
+static u64_t hashmap_hash(const c8_t* key) { return hash_wy64(key, cstr_len(key)); }
+static u64_t hashmap_hash(buf_t key) { return hash_wy64(key.e, key.size); }
+
+static b32_t hashmap_is_same_key(u32_t lhs, u32_t rhs) { return lhs == rhs; }
+static b32_t hashmap_is_same_key(s32_t lhs, s32_t rhs) { return lhs == rhs; }
+static b32_t hashmap_is_same_key(u64_t lhs, u64_t rhs) { return lhs == rhs; }
+static b32_t hashmap_is_same_key(s64_t lhs, s64_t rhs) { return lhs == rhs; }
+static b32_t hashmap_is_same_key(const c8_t* lhs, const c8_t* rhs) { 
+  return lhs == rhs || (cstr_len(lhs) == cstr_len(rhs) && cstr_compare(lhs, rhs)); 
+}
+static b32_t hashmap_is_same_key(buf_t lhs, buf_t rhs) { 
+  return lhs.size == rhs.size && memory_is_same(lhs.e, rhs.e, lhs.size);
+}
+
+// @note: Each of these returns a mask with a bit set for each of the 
+// HASHMAP_GROUP_SIZE control bytes at 'ctrls' that matches.
+static inline u32_t
+_hashmap_match(const u8_t* ctrls, u8_t h2) {
+#if MOMO_SSE2
+  __m128i group = _mm_loadu_si128((const __m128i*)ctrls);
+  return (u32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8((c8_t)h2)));
+#else
+  u32_t ret = 0;
+  for (u32_t i = 0; i < HASHMAP_GROUP_SIZE; ++i) 
+    ret |= (u32_t)(ctrls[i] == h2) << i;
+  return ret;
+#endif
+}
+
+static inline u32_t
+_hashmap_match_empty(const u8_t* ctrls) {
+  return _hashmap_match(ctrls, _HASHMAP_CTRL_EMPTY);
+}
+
+// @note: empty and deleted are the only control bytes with the top bit set
+static inline u32_t
+_hashmap_match_free(const u8_t* ctrls) {
+#if MOMO_SSE2
+  return (u32_t)_mm_movemask_epi8(_mm_loadu_si128((const __m128i*)ctrls));
+#else
+  u32_t ret = 0;
+  for (u32_t i = 0; i < HASHMAP_GROUP_SIZE; ++i) 
+    ret |= (u32_t)(ctrls[i] >> 7) << i;
+  return ret;
+#endif
+}
+
+template<typename K, typename V>
+static inline void
+_hashmap_set_ctrl(hashmap_t<K,V>* m, u32_t slot, u8_t ctrl) {
+  m->ctrls[slot] = ctrl;
+  if (slot < HASHMAP_GROUP_SIZE - 1) 
+    m->ctrls[m->cap + slot] = ctrl;
+}
+
+// @note: The groups are probed at triangular offsets, which visits 
+// every slot when cap is a power of 2.
+template<typename K, typename V>
+static u32_t
+_hashmap_find(hashmap_t<K,V>* m, K key, u64_t hash) 
+{
+  u8_t h2 = (u8_t)(hash & 0x7F);
+  u32_t mask = m->cap - 1;
+  u32_t pos = (u32_t)(hash >> 7) & mask;
+  for (u32_t stride = HASHMAP_GROUP_SIZE; ; stride += HASHMAP_GROUP_SIZE) {
+    const u8_t* group = m->ctrls + pos;
+    for (u32_t bits = _hashmap_match(group, h2); bits; bits &= bits - 1) {
+      u32_t slot = (pos + u32_ctz(bits)) & mask;
+      if (hashmap_is_same_key(m->keys[slot], key)) 
+        return slot;
+    }
+    if (_hashmap_match_empty(group)) 
+      return U32_MAX;
+    pos = (pos + stride) & mask;
+  }
+}
+
+template<typename K, typename V>
+static u32_t
+_hashmap_find_free(hashmap_t<K,V>* m, u64_t hash) 
+{
+  u32_t mask = m->cap - 1;
+  u32_t pos = (u32_t)(hash >> 7) & mask;
+  for (u32_t stride = HASHMAP_GROUP_SIZE; ; stride += HASHMAP_GROUP_SIZE) {
+    u32_t bits = _hashmap_match_free(m->ctrls + pos);
+    if (bits) 
+      return (pos + u32_ctz(bits)) & mask;
+    pos = (pos + stride) & mask;
+  }
+}
+
+template<typename K, typename V>
+static b32_t
+_hashmap_alloc(hashmap_t<K,V>* m, u32_t cap) 
+{
+  u8_t* ctrls = arena_push_arr_align(u8_t, m->arena, cap + HASHMAP_GROUP_SIZE - 1, HASHMAP_GROUP_SIZE);
+  K* keys = arena_push_arr(K, m->arena, cap);
+  V* values = arena_push_arr(V, m->arena, cap);
+  if (!ctrls || !keys || !values) 
+    return false;
+
+  for (u32_t i = 0; i < cap + HASHMAP_GROUP_SIZE - 1; ++i) 
+    ctrls[i] = _HASHMAP_CTRL_EMPTY;
+  m->ctrls = ctrls;
+  m->keys = keys;
+  m->values = values;
+  m->cap = cap;
+  m->count = 0;
+  m->growth_left = cap - cap/8;
+  return true;
+}
+
+// @note: Moves everything into new arrays of 'new_cap' slots, which 
+// also gets rid of the deleted slots.
+template<typename K, typename V>
+static b32_t
+_hashmap_rehash(hashmap_t<K,V>* m, u32_t new_cap) 
+{
+  hashmap_t<K,V> old = *m;
+  if (!_hashmap_alloc(m, new_cap)) {
+    *m = old;
+    return false;
+  }
+
+  for (u32_t slot = 0; slot < old.cap; ++slot) {
+    if (old.ctrls[slot] & 0x80) continue;
+    u32_t new_slot = _hashmap_find_free(m, hashmap_hash(old.keys[slot]));
+    _hashmap_set_ctrl(m, new_slot, old.ctrls[slot]);
+    m->keys[new_slot] = old.keys[slot];
+    m->values[new_slot] = old.values[slot];
+  }
+  m->count = old.count;
+  m->growth_left -= old.count;
+  return true;
+}
+
+template<typename K, typename V>
+static b32_t
+hashmap_init(hashmap_t<K,V>* m, arena_t* arena, u32_t initial_cap) 
+{
+  u32_t cap = HASHMAP_GROUP_SIZE;
+  while (cap - cap/8 < initial_cap) cap *= 2;
+  m->arena = arena;
+  return _hashmap_alloc(m, cap);
+}
+
+template<typename K, typename V>
+static V*
+hashmap_get(hashmap_t<K,V>* m, K key) 
+{
+  u32_t slot = _hashmap_find(m, key, hashmap_hash(key));
+  return slot == U32_MAX ? nullptr : m->values + slot;
+}
+
+template<typename K, typename V>
+static V*
+hashmap_set(hashmap_t<K,V>* m, K key, V value) 
+{
+  u64_t hash = hashmap_hash(key);
+  u32_t slot = _hashmap_find(m, key, hash);
+  if (slot != U32_MAX) {
+    m->values[slot] = value;
+    return m->values + slot;
+  }
+
+  slot = _hashmap_find_free(m, hash);
+  if (m->growth_left == 0 && m->ctrls[slot] == _HASHMAP_CTRL_EMPTY) {
+    // @note: If a lot of what's taking up space is deleted slots, 
+    // clean them up instead of growing. Same threshold as abseil, 
+    // so that there's always a fair amount of room after cleaning.
+    u32_t new_cap = (u64_t)m->count * 32 <= (u64_t)m->cap * 25 ? m->cap : m->cap * 2;
+    if (!_hashmap_rehash(m, new_cap))
+      return nullptr;
+    slot = _hashmap_find_free(m, hash);
+  }
+
+  if (m->ctrls[slot] == _HASHMAP_CTRL_EMPTY) 
+    --m->growth_left;
+  _hashmap_set_ctrl(m, slot, (u8_t)(hash & 0x7F));
+  m->keys[slot] = key;
+  m->values[slot] = value;
+  ++m->count;
+  return m->values + slot;
+}
+
+template<typename K, typename V>
+static b32_t
+hashmap_remove(hashmap_t<K,V>* m, K key) 
+{
+  u32_t slot = _hashmap_find(m, key, hashmap_hash(key));
+  if (slot == U32_MAX) 
+    return false;
+
+  // @note: A probe only moves past a group with no empty slots. If 
+  // there are fewer than HASHMAP_GROUP_SIZE used slots between the 
+  // empty slots around this one, no group that has this slot was ever
+  // full, so it can be emptied instead of being marked as deleted.
+  u32_t mask = m->cap - 1;
+  u32_t empty_before = _hashmap_match_empty(m->ctrls + ((slot - HASHMAP_GROUP_SIZE) & mask));
+  u32_t empty_after = _hashmap_match_empty(m->ctrls + slot);
+  if (empty_before && empty_after && 
+      u32_ctz(empty_after) + (u32_clz(empty_before) - (32 - HASHMAP_GROUP_SIZE)) < HASHMAP_GROUP_SIZE) 
+  {
+    _hashmap_set_ctrl(m, slot, _HASHMAP_CTRL_EMPTY);
+    ++m->growth_left;
+  }
+  else {
+    _hashmap_set_ctrl(m, slot, _HASHMAP_CTRL_DELETED);
+  }
+  --m->count;
+  return true;
+}
+
+template<typename K, typename V>
+static void
+hashmap_clear(hashmap_t<K,V>* m) 
+{
+  for (u32_t i = 0; i < m->cap + HASHMAP_GROUP_SIZE - 1; ++i) 
+    m->ctrls[i] = _HASHMAP_CTRL_EMPTY;
+  m->count = 0;
+  m->growth_left = m->cap - m->cap/8;
+}
+
+template<typename K, typename V>
+static b32_t
+hashmap_is_slot_used(hashmap_t<K,V>* m, u32_t slot) 
+{
+  return (m->ctrls[slot] & 0x80) == 0;
+}
+
+//
+// @mark:(RNG)
+//
+
+static void 
+rng_init(rng_t* r, u32_t seed)
+{
+  r->seed = seed;
+}
+
+static u32_t
+rng_next(rng_t* r)
+{
+  u32_t result = r->seed;
+  result ^= result << 13;
+  result ^= result >> 17;
+  result ^= result << 5;
+  r->seed = result;
+  return result;
+}
+
+static u32_t 
+rng_choice(rng_t* r, u32_t choice_count) {
+  return rng_next(r) % choice_count;
+}
+
+// Get number within [0, 1]
+static f32_t 
+rng_unilateral(rng_t* r)
+{
+  f32_t divisor = 1.0f / (f32_t)U32_MAX;
+  f32_t result = divisor*(f32_t)rng_next(r);
+
+  return result;
+}
+
+
+// Get number within [-1, 1]
+static f32_t 
+rng_bilateral(rng_t* r)
+{
+  f32_t result = 2.0f * rng_unilateral(r) - 1.0f;  
+  return(result);
+}
+
+// Get number within [min, max]
+static f32_t 
+rng_range_f32(rng_t* r, f32_t min, f32_t max)
+{
+  f32_t result = f32_lerp(min, rng_unilateral(r), max);
+  return(result);
+}
+
+// Get number within [min, max)
+static s32_t 
+rng_range_s32(rng_t* r, s32_t min, s32_t max)
+{
+  s32_t result = min + (s32_t)(rng_next(r)%(max  - min));
+  return(result);
+}
+
+// Get number within [min, max)
+static u32_t
+rng_range_u32(rng_t* r, u32_t min, u32_t max)
+{
+  u32_t result = min + (u32_t)(rng_next(r)%(max - min));
+  return(result);
+}
+
+// Get number within [min, max)
+static u8_t
+rng_range_u8(rng_t* r, u8_t min, u8_t max)
+{
+  u8_t result = min + (u8_t)(rng_next(r)%(max - min));
+  return(result);
+}
+
+static v2f_t 
+rng_unit_circle(rng_t* r) {
+  f32_t rand_angle = 2.f * PI_32 * rng_unilateral(r);
+  v2f_t ret = {0};
+  ret.x = f32_cos(rand_angle);
+  ret.y = f32_sin(rand_angle);
+
+  return ret;
+}
+
+//
+// @mark:(CRC)
+//
+
+//
+// Slow versions
+//
+// These are for quick and easy use. 
+// Try not to use this for production
+//
+static u32_t
+crc32_slow(u8_t* data, u32_t data_size, u32_t start_register, u32_t polynomial) {
+  u32_t r = start_register;
+  for (u32_t i = 0; i < data_size; ++i ){
+    r ^= data[i] <<  24;
+    for (u32_t j = 0; j < 8; ++j) {
+      if((r & 0x80000000) != 0) {
+        r = (u32_t)((r << 1) ^ polynomial);
+      }
+      else {
+        r <<= 1;
+      }
+    }
+  }
+  return r;
+}
+
+
+static u32_t
+crc16_slow(u8_t* data, u32_t data_size, u16_t start_register, u16_t polynomial) {
+  u32_t r = start_register;
+  for (u32_t i = 0; i < data_size; ++i ){
+    r ^= data[i] << 8;
+    for (u32_t j = 0; j < 8; ++j) {
+      if((r & 0x8000) != 0) {
+        r = (u32_t)((r << 1) ^ polynomial);
+      }
+      else {
+        r <<= 1;
+      }
+    }
+  }
+  return r;
+}
+
+static u32_t
+crc8_slow(u8_t* data, u32_t data_size, u16_t start_register, u16_t polynomial) {
+  u32_t r = start_register;
+  for (u32_t i = 0; i < data_size; ++i ){
+    r ^= data[i];
+    for (u32_t j = 0; j < 8; ++j) {
+      if((r & 0x80) != 0) {
+        r = (u32_t)((r << 1) ^ polynomial);
+      }
+      else {
+        r <<= 1;
+      }
+    }
+  }
+  return r;
+}
+
+//
+// Table generation
+//
+static void 
+crc32_init_table(crc32_table_t* table, u32_t polynomial) {
+  for (u32_t divident = 0; divident < 256; ++divident) {
+    u32_t remainder = divident <<  24;
+    for (u32_t j = 0; j < 8; ++j) {
+      if((remainder & 0x80000000) != 0) {
+        remainder = (u32_t)((remainder << 1) ^ polynomial);
+      }
+      else {
+        remainder <<= 1;
+      }
+    }
+    table->remainders[divident] = remainder;
+  }
+}
+
+static void
+crc16_init_table(crc16_table_t* table, u16_t polynomial) {
+  for (u32_t divident = 0; divident < 256; ++divident) {
+    u32_t remainder = divident << 8;
+    for (u32_t j = 0; j < 8; ++j) {
+      if((remainder & 0x8000) != 0) {
+        remainder = (u16_t)((remainder << 1) ^ polynomial);
+      }
+      else {
+        remainder <<= 1;
+      }
+    }
+    table->remainders[divident] = (u16_t)remainder;
+  }
+}
+
+static void 
+crc8_init_table(crc8_table_t* table, u8_t polynomial) {
+  for (u32_t divident = 0; divident < 256; ++divident) {
+    u32_t remainder = divident;
+    for (u32_t j = 0; j < 8; ++j) {
+      if((remainder & 0x80) != 0) {
+        remainder = (u8_t)((remainder << 1) ^ polynomial);
+      }
+      else {
+        remainder <<= 1;
+      }
+    }
+    table->remainders[divident] = (u8_t)remainder;
+  }
+}
+
+//
+// Faster version
+//
+static u32_t
+crc32(u8_t* data, u32_t data_size, u32_t start_register, crc32_table_t* table) {
+  u32_t crc = start_register;
+  for (u32_t i = 0; i < data_size; ++i) {
+    u32_t divident = (u32_t)((crc ^ (data[i] << 24)) >> 24);
+    crc = (u32_t)((crc << 8) ^ (u32_t)(table->remainders[divident]));
+  }
+  return crc;
+}
+
+static u32_t
+crc16(u8_t* data, u32_t data_size, u16_t start_register, crc16_table_t* table) {
+  u16_t crc = start_register;
+  for (u32_t i = 0; i < data_size; ++i) {
+    u16_t divident = (u16_t)((crc ^ (data[i] << 8)) >> 8);
+    crc = (u16_t)((crc << 8) ^ (u16_t)(table->remainders[divident]));
+  }
+  return crc;
+}
+
+static u32_t
+crc8(u8_t* data, u32_t data_size, u8_t start_register, crc8_table_t* table) {
+  u8_t crc = start_register;
+  for (u32_t i = 0; i < data_size; ++i) {
+    u8_t divident = (u8_t)(crc ^ data[i]);
+    crc = table->remainders[divident];
+  }
+  return crc;
+}
+
+//
+// CRC-32 (IEEE) and CRC-32C
+//
+// @note: Both are the reflected kind: bits go in from the bottom and the
+// polynomials (0x04C11DB7 and 0x1EDC6F41) are bit reversed. There are
+// three ways to get them:
+// - Slicing-by-16. This works everywhere. Table k holds what a byte does
+//   to the CRC when k more zero bytes follow it. With those, 16 bytes
+//   can be looked up at once and the results xor'ed together. 
+// - For CRC-32C, SSE4.2 has an instruction that does 8 bytes at a time.
+// - For CRC-32, PCLMULQDQ multiplies 64-bit polynomials. We can use it 
+//   to 'fold' 64 bytes of data into the next 64 bytes, and reduce the 
+//   last 16 bytes down to 32 bits at the end. The constants come from 
+//   Intel's "Fast CRC Computation for Generic Polynomials Using PCLMULQDQ".
+//
+// The hardware paths are picked with CPUID on the first call. They are
+// compiled even when the compiler is not told to target those 
+// instructions, so they must only be called after checking.
+//
+struct _crc32_slice_tables_t {
+  u32_t e[16][256];
+};
+
+static constexpr _crc32_slice_tables_t
+_crc32_make_slice_tables(u32_t polynomial) {
+  _crc32_slice_tables_t t = {};
+  for (u32_t i = 0; i < 256; ++i) {
+    u32_t r = i;
+    for (u32_t j = 0; j < 8; ++j) {
+      r = (r >> 1) ^ (polynomial & (0u - (r & 1)));
+    }
+    t.e[0][i] = r;
+  }
+  for (u32_t k = 1; k < 16; ++k) {
+    for (u32_t i = 0; i < 256; ++i) {
+      u32_t r = t.e[k-1][i];
+      t.e[k][i] = (r >> 8) ^ t.e[0][r & 0xFF];
+    }
+  }
+  return t;
+}
+
+static constexpr _crc32_slice_tables_t _crc32_ieee_tables = _crc32_make_slice_tables(0xEDB88320);
+static constexpr _crc32_slice_tables_t _crc32c_tables = _crc32_make_slice_tables(0x82F63B78);
+
+// @note: 'r' is the CRC register, i.e. before the final inversion.
+static u32_t
+_crc32_slice16(const _crc32_slice_tables_t* t, const u8_t* p, usz_t size, u32_t r) {
+  while (size >= 16) {
+    u32_t a = _memory_load_u32(p) ^ r;
+    u32_t b = _memory_load_u32(p + 4);
+    u32_t c = _memory_load_u32(p + 8);
+    u32_t d = _memory_load_u32(p + 12);
+    r = t->e[15][a & 0xFF] ^ t->e[14][(a >> 8) & 0xFF] ^ t->e[13][(a >> 16) & 0xFF] ^ t->e[12][a >> 24] ^
+        t->e[11][b & 0xFF] ^ t->e[10][(b >> 8) & 0xFF] ^ t->e[9][(b >> 16) & 0xFF]  ^ t->e[8][b >> 24] ^
+        t->e[7][c & 0xFF]  ^ t->e[6][(c >> 8) & 0xFF]  ^ t->e[5][(c >> 16) & 0xFF]  ^ t->e[4][c >> 24] ^
+        t->e[3][d & 0xFF]  ^ t->e[2][(d >> 8) & 0xFF]  ^ t->e[1][(d >> 16) & 0xFF]  ^ t->e[0][d >> 24];
+    p += 16;
+    size -= 16;
+  }
+  while (size--) {
+    r = (r >> 8) ^ t->e[0][(r ^ *p++) & 0xFF];
+  }
+  return r;
+}
+
+#if (ARCH_X64 || ARCH_X86) && MOMO_SSE2
+# define _CRC_HARDWARE 1
+# if COMPILER_MSVC
+#  define _crc_target(s)
+# else
+#  include <cpuid.h>
+#  define _crc_target(s) __attribute__((target(s)))
+# endif
+#else
+# define _CRC_HARDWARE 0
+#endif
+
+#if _CRC_HARDWARE
+
+enum _crc_cpu_flags_t {
+  _CRC_CPU_FLAG_SSE42  = (1 << 0),
+  _CRC_CPU_FLAG_PCLMUL = (1 << 1),
+  _CRC_CPU_FLAG_DETECTED = (1 << 31),
+};
+
+static u32_t volatile _crc_cpu_flags = 0;
+
+static u32_t
+_crc_get_cpu_flags() {
+  u32_t flags = _crc_cpu_flags;
+  if (!flags) {
+    u32_t ecx = 0;
+# if COMPILER_MSVC
+    int regs[4];
+    __cpuid(regs, 1);
+    ecx = (u32_t)regs[2];
+# else
+    u32_t eax, ebx, edx;
+    if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx)) ecx = 0;
+# endif
+    flags = _CRC_CPU_FLAG_DETECTED;
+    if (ecx & (1 << 20)) flags |= _CRC_CPU_FLAG_SSE42;
+    if (ecx & (1 << 1)) flags |= _CRC_CPU_FLAG_PCLMUL;
+    // @note: Every thread gets the same answer, so racing here is fine.
+    _crc_cpu_flags = flags;
+  }
+  return flags;
+}
+
+_crc_target("sse4.2") static u32_t
+_crc32c_sse42(const u8_t* p, usz_t size, u32_t r) {
+  // align to 8 bytes
+  while (size && ((usz_t)p & 7)) {
+    r = _mm_crc32_u8(r, *p++);
+    --size;
+  }
+# if ARCH_X64
+  u64_t r64 = r;
+  while (size >= 32) {
+    r64 = _mm_crc32_u64(r64, _memory_load_u64(p));
+    r64 = _mm_crc32_u64(r64, _memory_load_u64(p + 8));
+    r64 = _mm_crc32_u64(r64, _memory_load_u64(p + 16));
+    r64 = _mm_crc32_u64(r64, _memory_load_u64(p + 24));
+    p += 32;
+    size -= 32;
+  }
+  while (size >= 8) {
+    r64 = _mm_crc32_u64(r64, _memory_load_u64(p));
+    p += 8;
+    size -= 8;
+  }
+  r = (u32_t)r64;
+# endif
+  while (size >= 4) {
+    r = _mm_crc32_u32(r, _memory_load_u32(p));
+    p += 4;
+    size -= 4;
+  }
+  while (size--) {
+    r = _mm_crc32_u8(r, *p++);
+  }
+  return r;
+}
+
+// @note: 'size' must be at least 64 and a multiple of 16.
+_crc_target("pclmul") static u32_t
+_crc32_ieee_pclmul_blocks(const u8_t* p, usz_t size, u32_t r) {
+  alignas(16) static const u64_t k1k2[2] = { 0x0154442bd4, 0x01c6e41596 };
+  alignas(16) static const u64_t k3k4[2] = { 0x01751997d0, 0x00ccaa009e };
+  alignas(16) static const u64_t k5k0[2] = { 0x0163cd6124, 0x0000000000 };
+  alignas(16) static const u64_t poly[2] = { 0x01db710641, 0x01f7011641 };
+
+  __m128i x1 = _mm_loadu_si128((const __m128i*)(p + 0x00));
+  __m128i x2 = _mm_loadu_si128((const __m128i*)(p + 0x10));
+  __m128i x3 = _mm_loadu_si128((const __m128i*)(p + 0x20));
+  __m128i x4 = _mm_loadu_si128((const __m128i*)(p + 0x30));
+  x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128((int)r));
+  p += 64;
+  size -= 64;
+
+  // Fold 64 bytes at a time
+  __m128i k = _mm_load_si128((const __m128i*)k1k2);
+  while (size >= 64) {
+    __m128i x5 = _mm_clmulepi64_si128(x1, k, 0x00);
+    __m128i x6 = _mm_clmulepi64_si128(x2, k, 0x00);
+    __m128i x7 = _mm_clmulepi64_si128(x3, k, 0x00);
+    __m128i x8 = _mm_clmulepi64_si128(x4, k, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, k, 0x11);
+    x2 = _mm_clmulepi64_si128(x2, k, 0x11);
+    x3 = _mm_clmulepi64_si128(x3, k, 0x11);
+    x4 = _mm_clmulepi64_si128(x4, k, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x5), _mm_loadu_si128((const __m128i*)(p + 0x00)));
+    x2 = _mm_xor_si128(_mm_xor_si128(x2, x6), _mm_loadu_si128((const __m128i*)(p + 0x10)));
+    x3 = _mm_xor_si128(_mm_xor_si128(x3, x7), _mm_loadu_si128((const __m128i*)(p + 0x20)));
+    x4 = _mm_xor_si128(_mm_xor_si128(x4, x8), _mm_loadu_si128((const __m128i*)(p + 0x30)));
+    p += 64;
+    size -= 64;
+  }
+
+  // Fold the 4 lanes into 1
+  k = _mm_load_si128((const __m128i*)k3k4);
+  __m128i x5 = _mm_clmulepi64_si128(x1, k, 0x00);
+  x1 = _mm_clmulepi64_si128(x1, k, 0x11);
+  x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+  x5 = _mm_clmulepi64_si128(x1, k, 0x00);
+  x1 = _mm_clmulepi64_si128(x1, k, 0x11);
+  x1 = _mm_xor_si128(_mm_xor_si128(x1, x3), x5);
+  x5 = _mm_clmulepi64_si128(x1, k, 0x00);
+  x1 = _mm_clmulepi64_si128(x1, k, 0x11);
+  x1 = _mm_xor_si128(_mm_xor_si128(x1, x4), x5);
+
+  // Fold 16 bytes at a time
+  while (size >= 16) {
+    x5 = _mm_clmulepi64_si128(x1, k, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, k, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, _mm_loadu_si128((const __m128i*)p)), x5);
+    p += 16;
+    size -= 16;
+  }
+
+  // 128 bits to 64
+  __m128i mask32 = _mm_setr_epi32(~0, 0, ~0, 0);
+  x2 = _mm_clmulepi64_si128(x1, k, 0x10);
+  x1 = _mm_xor_si128(_mm_srli_si128(x1, 8), x2);
+  k = _mm_loadl_epi64((const __m128i*)k5k0);
+  x2 = _mm_srli_si128(x1, 4);
+  x1 = _mm_clmulepi64_si128(_mm_and_si128(x1, mask32), k, 0x00);
+  x1 = _mm_xor_si128(x1, x2);
+
+  // Barrett reduction to 32 bits
+  k = _mm_load_si128((const __m128i*)poly);
+  x2 = _mm_clmulepi64_si128(_mm_and_si128(x1, mask32), k, 0x10);
+  x2 = _mm_clmulepi64_si128(_mm_and_si128(x2, mask32), k, 0x00);
+  x1 = _mm_xor_si128(x1, x2);
+  return (u32_t)_mm_cvtsi128_si32(_mm_srli_si128(x1, 4));
+}
+
+#endif // _CRC_HARDWARE
+
+static u32_t
+_crc32_ieee_table(const u8_t* p, usz_t size, u32_t r) {
+  return _crc32_slice16(&_crc32_ieee_tables, p, size, r);
+}
+
+static u32_t
+_crc32c_table(const u8_t* p, usz_t size, u32_t r) {
+  return _crc32_slice16(&_crc32c_tables, p, size, r);
+}
+
+static u32_t
+crc32_ieee(const void* data, usz_t size, u32_t crc) {
+  const u8_t* p = (const u8_t*)data;
+  u32_t r = ~crc;
+#if _CRC_HARDWARE
+  if (size >= 64 && (_crc_get_cpu_flags() & _CRC_CPU_FLAG_PCLMUL)) {
+    usz_t block_size = size & ~(usz_t)15;
+    r = _crc32_ieee_pclmul_blocks(p, block_size, r);
+    p += block_size;
+    size -= block_size;
+  }
+#endif
+  return ~_crc32_ieee_table(p, size, r);
+}
+
+static u32_t
+crc32c(const void* data, usz_t size, u32_t crc) {
+  const u8_t* p = (const u8_t*)data;
+  u32_t r = ~crc;
+#if _CRC_HARDWARE
+  if (_crc_get_cpu_flags() & _CRC_CPU_FLAG_SSE42) {
+    return ~_crc32c_sse42(p, size, r);
+  }
+#endif
+  return ~_crc32c_table(p, size, r);
+}
+
+//
+// @mark:(Zlib)
+//
+
+// @note: Decoding tables work like zlib's. Looking up the next N bits of
+// input gives an entry that is either the answer, or points to a subtable
+// that resolves the remaining bits of a longer code. Each entry is a u32_t:
+//   bits 0-3:   number of code bits to consume
+//   bits 4-7:   number of extra bits that follow, or the bits of a subtable
+//   bits 8-11:  the flags below
+//   bits 16-31: literal, base length/distance or subtable offset
+#define _ZLIB_ENTRY_LITERAL  (1 << 8)
+#define _ZLIB_ENTRY_END      (1 << 9)
+#define _ZLIB_ENTRY_SUBTABLE (1 << 10)
+#define _ZLIB_ENTRY_INVALID  (1 << 11)
+
+#define _ZLIB_LITLEN_SYMBOLS  288
+#define _ZLIB_DIST_SYMBOLS    32
+#define _ZLIB_PRECODE_SYMBOLS 19
+
+#define _ZLIB_LITLEN_TABLE_BITS  11
+#define _ZLIB_DIST_TABLE_BITS    8
+#define _ZLIB_PRECODE_TABLE_BITS 7
+
+// @note: Worst case sizes including subtables, as counted by zlib's
+// 'enough' program for the symbol counts and table bits above.
+#define _ZLIB_LITLEN_TABLE_SIZE  2342
+#define _ZLIB_DIST_TABLE_SIZE    402
+#define _ZLIB_PRECODE_TABLE_SIZE 128
+
+// @note: The table entry of each symbol, without the code bits.
+struct _zlib_symbols_t {
+  u32_t litlen[_ZLIB_LITLEN_SYMBOLS];
+  u32_t dist[_ZLIB_DIST_SYMBOLS];
+  u32_t precode[_ZLIB_PRECODE_SYMBOLS];
+};
+
+static constexpr u16_t _zlib_len_bases[29] = {
+  3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+  35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+static constexpr u8_t _zlib_len_extra_bits[29] = {
+  0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+  3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+};
+static constexpr u16_t _zlib_dist_bases[30] = {
+  1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+  257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145,
+  8193, 12289, 16385, 24577
+};
+static constexpr u8_t _zlib_dist_extra_bits[30] = {
+  0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+  7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+};
+
+static constexpr _zlib_symbols_t
+_zlib_make_symbols() {
+  _zlib_symbols_t s = {};
+  for (u32_t i = 0; i < 256; ++i) {
+    s.litlen[i] = _ZLIB_ENTRY_LITERAL | (i << 16);
   }
-  else 
-  {
-    // if signed bit is not set, set it
-    result |= 0x80000000;
+  s.litlen[256] = _ZLIB_ENTRY_END;
+  for (u32_t i = 0; i < 29; ++i) {
+    s.litlen[257 + i] = ((u32_t)_zlib_len_bases[i] << 16) | ((u32_t)_zlib_len_extra_bits[i] << 4);
   }
-  return result;
+  s.litlen[286] = _ZLIB_ENTRY_INVALID;
+  s.litlen[287] = _ZLIB_ENTRY_INVALID;
+
+  for (u32_t i = 0; i < 30; ++i) {
+    s.dist[i] = ((u32_t)_zlib_dist_bases[i] << 16) | ((u32_t)_zlib_dist_extra_bits[i] << 4);
+  }
+  s.dist[30] = _ZLIB_ENTRY_INVALID;
+  s.dist[31] = _ZLIB_ENTRY_INVALID;
+
+  for (u32_t i = 0; i < _ZLIB_PRECODE_SYMBOLS; ++i) {
+    s.precode[i] = i << 16;
+  }
+  return s;
 }
 
-static void 
-sort_radix(sort_entry_t* entries, u32_t entry_count, arena_t* arena)
-{
-  arena_set_revert_point(arena);
-  sort_entry_t* tmp = arena_push_arr(sort_entry_t, arena, entry_count);
-  assert(tmp);
+static constexpr _zlib_symbols_t _zlib_symbols = _zlib_make_symbols();
 
-  sort_entry_t* src = entries;
-  sort_entry_t* dest = tmp;
+// @note: Bits are read from a 64-bit buffer that is topped up 8 bytes at
+// a time, so a whole length/distance pair (at most 48 bits) can be decoded
+// after one refill. Near the end of the input, zeros are fed in instead and
+// counted in 'overrun', so that using them can be caught later.
+//
+// Input can also come in pieces, like the IDAT chunks of a PNG. When one
+// runs out, 'next_piece' is asked for the next, and returns false when
+// there are no more.
+typedef b32_t _zlib_next_piece_f(void* user, const u8_t** next, const u8_t** end);
 
-  for(u32_t byte_index = 0;
-      byte_index < 32;
-      byte_index += 8)
-  {
-    u32_t offsets[256] = {};
+struct _zlib_input_t {
+  const u8_t* next;
+  const u8_t* end;
+  u64_t bits;
+  u32_t count;
+  u32_t overrun;
 
-    // Counting pass: count how many of each key
-    for(u32_t i = 0;
-        i < entry_count;
-        ++i) 
-    {
-      u32_t value = _sort_key_to_u32(src[i].key);
-      u32_t piece = (value >> byte_index) & 0xFF;
-      ++offsets[piece];
-    }
+  _zlib_next_piece_f* next_piece;
+  void* user;
+};
 
-    // Cumulative sum pass: change counts to offsets
-    // Basically at the end of this pass, each item
-    // in offsets[] should contain the index of dest
-    // where the first item of that value to go.
-    u32_t total = 0;
-    for_arr(offset_index, offsets) 
-    {
-      u32_t count = offsets[offset_index];
-      offsets[offset_index] = total;
-      total += count;
-    }
+enum _zlib_status_t {
+  _ZLIB_STATUS_BAD,  // bad or truncated data, or no room left
+  _ZLIB_STATUS_DONE, // the last block has ended
+  _ZLIB_STATUS_FULL, // stopped to make room, call again to carry on
+};
 
-    for(u32_t i = 0l;
-        i < entry_count;
-        ++i)
-    {
-      u32_t value = _sort_key_to_u32(src[i].key);
-      u32_t piece = (value >> byte_index) & 0xFF;
-      dest[offsets[piece]++] = src[i];
-    }
+enum {
+  _ZLIB_STATE_HEADER,
+  _ZLIB_STATE_STORED,
+  _ZLIB_STATE_HUFFMAN,
+  _ZLIB_STATE_DONE,
+};
 
-    swap(src, dest);
+struct _zlib_inflater_t {
+  _zlib_input_t in;
 
-  }
+  // Where we are, so that inflating can stop when out of room and go on
+  // from there later.
+  u32_t state;
+  u32_t BFINAL;
+  u32_t stored_size;
+  b32_t is_fixed_built;
 
+  u32_t litlen_table[_ZLIB_LITLEN_TABLE_SIZE];
+  u32_t dist_table[_ZLIB_DIST_TABLE_SIZE];
+  u32_t precode_table[_ZLIB_PRECODE_TABLE_SIZE];
+};
 
+static void
+_zlib_input_init(_zlib_input_t* in, const u8_t* data, usz_t size) {
+  in->next = data;
+  in->end = data + size;
+  in->bits = 0;
+  in->count = 0;
+  in->overrun = 0;
+  in->next_piece = nullptr;
+  in->user = nullptr;
 }
 
-// Generic version of sort_quick
-typedef b32_t _sort_quick_generic_cmp_t(const void* lhs, const void* rhs);
+static void
+_zlib_inflater_init(_zlib_inflater_t* z, const u8_t* data, usz_t size) {
+  _zlib_input_init(&z->in, data, size);
+  z->state = _ZLIB_STATE_HEADER;
+  z->BFINAL = 0;
+  z->stored_size = 0;
+  z->is_fixed_built = false;
+}
 
-static u32_t 
-_sort_quick_generic_partition(
-    void* a,
-    u32_t start, 
-    u32_t ope,
-    u32_t element_size,
-    _sort_quick_generic_cmp_t cmp) 
-{
+// @note: Skips to the next piece of input that is not empty.
+static b32_t
+_zlib_next_piece(_zlib_input_t* in) {
+  while (in->next == in->end) {
+    if (!in->next_piece || !in->next_piece(in->user, &in->next, &in->end)) return false;
+  }
+  return true;
+}
 
-  // Save the rightmost index as pivot
-  // This frees up the right most index as a slot
-  u32_t pivot_idx = ope-1;
-  u32_t eventual_pivot_idx = start;
+// @note: Leaves at least 56 bits in the buffer. The fast version needs 8
+// bytes of input left. It loads all of them but only takes the whole bytes
+// that fit; the bits above 'count' are then the same as the next load's.
+// They never go past the end of a piece, so the slow version can safely
+// carry on into the next one.
+static inline void
+_zlib_refill_fast(_zlib_input_t* in) {
+  in->bits |= _memory_load_u64(in->next) << in->count;
+  in->next += (63 - in->count) >> 3;
+  in->count |= 56;
+}
 
-  for (u32_t i = start; i < ope-1; ++i)
-  {
-    u8_t* i_ptr = (u8_t*)a + (i * element_size);
-    u8_t* pivot_ptr = (u8_t*)a + (pivot_idx * element_size);
-    if (cmp(i_ptr, pivot_ptr)) 
-    {
-      u8_t* eventual_pivot_ptr = (u8_t*)a + (eventual_pivot_idx * element_size);
-      memory_swap(i_ptr, eventual_pivot_ptr, element_size);
-      ++eventual_pivot_idx;
+static inline void
+_zlib_refill(_zlib_input_t* in) {
+  if (in->end - in->next >= 8) {
+    _zlib_refill_fast(in);
+  }
+  else {
+    while (in->count <= 56) {
+      if (in->next < in->end || _zlib_next_piece(in)) {
+        in->bits |= (u64_t)(*in->next++) << in->count;
+      }
+      else {
+        ++in->overrun;
+      }
+      in->count += 8;
     }
   }
-  memory_swap((u8_t*)a+(eventual_pivot_idx*element_size), (u8_t*)a+(pivot_idx*element_size), element_size);
-  return eventual_pivot_idx;
 }
 
-// @note: This is done inplace
-static void
-_sort_quick_generic_range(
-    void* a, 
-    u32_t start, 
-    u32_t ope,
-    u32_t element_size,
-    _sort_quick_generic_cmp_t cmp) 
-{
-  if (ope - start <= 1) {
-    return;
+static inline u32_t
+_zlib_consume(_zlib_input_t* in, u32_t bits) {
+  u32_t ret = (u32_t)(in->bits & (((u64_t)1 << bits) - 1));
+  in->bits >>= bits;
+  in->count -= bits;
+  return ret;
+}
+
+// @note: True if any of the zeros fed in past the end of the input were
+// used. They are the last bytes in the buffer.
+static inline b32_t
+_zlib_input_is_overrun(_zlib_input_t* in) {
+  return in->overrun > (in->count >> 3);
+}
+
+// @note: Reads whole bytes, which must start on a byte boundary. Bytes
+// still in the bit buffer go first, then the rest is copied straight from
+// the input.
+static b32_t
+_zlib_read_bytes(_zlib_input_t* in, u8_t* dest, usz_t size) {
+  for (; size > 0 && in->count > 0; --size) {
+    *dest++ = (u8_t)_zlib_consume(in, 8);
+  }
+  if (_zlib_input_is_overrun(in)) return false;
+  if (size == 0) return true;
+
+  // The buffer is empty, but may hold bits that a fast refill loaded
+  // ahead. 'next' moves on without them, so they have to go.
+  in->bits = 0;
+  while (size > 0) {
+    if (!_zlib_next_piece(in)) return false;
+    usz_t n = min_of(size, (usz_t)(in->end - in->next));
+    memory_copy(dest, in->next, n);
+    in->next += n;
+    dest += n;
+    size -= n;
   }
-  u32_t pivot = _sort_quick_generic_partition(a, start, ope, element_size, cmp);
-  _sort_quick_generic_range(a, start, pivot, element_size, cmp);
-  _sort_quick_generic_range(a, pivot+1, ope, element_size, cmp);
+  return true;
 }
 
+// @note: Reads the 2 byte zlib header (RFC 1950).
+// Bytes[0]:
+// - bit 0-3: Compression Method (CM), 8 for DEFLATE
+// - bit 4-7: Compression Info (CINFO), log2 of the window size minus 8
+// Bytes[1]:
+// - bit 0-4: FCHECK, which makes the header a multiple of 31
+// - bit 5: Preset dictionary (FDICT)
+// - bit 6-7: Compression level (FLEVEL)
+static b32_t
+_zlib_read_header(_zlib_input_t* in) {
+  u8_t header[2];
+  if (!_zlib_read_bytes(in, header, sizeof(header))) return false;
+  u32_t CMF = header[0];
+  u32_t FLG = header[1];
+  return (CMF & 0x0F) == 8 && (CMF >> 4) <= 7 && ((CMF << 8) | FLG) % 31 == 0 && !(FLG & 0x20);
+}
 
-static void
-_sort_quick_generic(void* entries, u32_t entry_count, u32_t element_size, _sort_quick_generic_cmp_t cmp) {
-  _sort_quick_generic_range(entries, 0, entry_count, element_size, cmp);
+// @note: The Adler-32 of the output ends the stream, big endian. PNGs from
+// older versions of png_write() end without it, so a missing one is let
+// through, but a wrong one is not.
+static b32_t
+_zlib_check_trailer(_zlib_input_t* in, u32_t adler) {
+  _zlib_consume(in, in->count & 7);
+  if ((in->count >> 3) == in->overrun && !_zlib_next_piece(in)) return true;
+
+  u8_t trailer[4];
+  if (!_zlib_read_bytes(in, trailer, sizeof(trailer))) return false;
+  return u32_endian_swap(_memory_load_u32(trailer)) == adler;
 }
 
-static void
-_sort_swap_entries(sort_entry_t* a, sort_entry_t* b) {
-  sort_entry_t temp = *b;
-  *b = *a;
-  *a = temp;
+static inline u32_t
+_zlib_decode(_zlib_input_t* in, const u32_t* table, u32_t table_bits) {
+  u32_t e = table[in->bits & ((1u << table_bits) - 1)];
+  if (e & _ZLIB_ENTRY_SUBTABLE) {
+    _zlib_consume(in, table_bits);
+    e = table[(e >> 16) + (in->bits & ((1u << ((e >> 4) & 0xF)) - 1))];
+  }
+  _zlib_consume(in, e & 0xF);
+  return e;
 }
 
-//
-// Quick sort
-//
 static u32_t
-_sort_quick_partition(sort_entry_t* a,
-    u32_t start, 
-    u32_t ope) 
+_zlib_reverse_bits(u32_t code, u32_t bits) {
+  u32_t ret = 0;
+  for (u32_t i = 0; i < bits; ++i) {
+    ret = (ret << 1) | (code & 1);
+    code >>= 1;
+  }
+  return ret;
+}
+
+// @note: Builds a decoding table from code lengths (RFC 1951, 3.2.2).
+// Fails if the lengths are over-subscribed. Incomplete codes are let
+// through and their unused entries are marked invalid.
+static b32_t
+_zlib_build_table(u32_t* table,
+                  u32_t table_size,
+                  u32_t table_bits,
+                  const u8_t* lengths,
+                  u32_t count,
+                  const u32_t* symbols)
 {
-  // Save the rightmost index as pivot
-  // This frees up the right most index as a slot
-  u32_t pivot_idx = ope-1;
-  u32_t eventual_pivot_idx = start;
+  u32_t counts[16] = {};
+  for (u32_t i = 0; i < count; ++i) {
+    ++counts[lengths[i]];
+  }
+  counts[0] = 0;
 
-  for (u32_t i = start; i < ope-1; ++i) {
-    sort_entry_t* i_ptr = a + i;
-    sort_entry_t* pivot_ptr = a + pivot_idx;
-    if (i_ptr->key < pivot_ptr->key) {
-      sort_entry_t* eventual_pivot_ptr = a + eventual_pivot_idx;
-      _sort_swap_entries(i_ptr, eventual_pivot_ptr);
-      ++eventual_pivot_idx;
-    }
+  u32_t max_len = 0;
+  s32_t left = 1;
+  for (u32_t len = 1; len < 16; ++len) {
+    left = (left << 1) - (s32_t)counts[len];
+    if (left < 0) return false;
+    if (counts[len]) max_len = len;
+  }
 
+  // Symbols in canonical order: by length, then by value
+  u32_t offsets[16] = {};
+  for (u32_t len = 1; len < 15; ++len) {
+    offsets[len + 1] = offsets[len] + counts[len];
+  }
+  u16_t sorted[_ZLIB_LITLEN_SYMBOLS];
+  for (u32_t i = 0; i < count; ++i) {
+    if (lengths[i]) sorted[offsets[lengths[i]]++] = (u16_t)i;
   }
 
-  _sort_swap_entries(a + eventual_pivot_idx, a + pivot_idx);
+  u32_t root_size = 1u << table_bits;
+  for (u32_t i = 0; i < root_size; ++i) {
+    table[i] = _ZLIB_ENTRY_INVALID;
+  }
 
-  return eventual_pivot_idx;
+  // Codes are read starting from their first bit, which is the lowest
+  // bit of the input, so they are reversed before being used as indices.
+  u32_t remaining[16];
+  memory_copy(remaining, counts, sizeof(remaining));
+  u32_t code = 0;
+  u32_t index = 0;
+  u32_t next_subtable = root_size;
+  u32_t subtable_prefix = (u32_t)-1;
+  u32_t subtable_base = 0;
+  u32_t subtable_bits = 0;
+  for (u32_t len = 1; len <= max_len; ++len) {
+    for (u32_t n = 0; n < counts[len]; ++n) {
+      u32_t entry = symbols[sorted[index++]];
+      u32_t reversed = _zlib_reverse_bits(code, len);
+      if (len <= table_bits) {
+        for (u32_t i = reversed; i < root_size; i += 1u << len) {
+          table[i] = entry | len;
+        }
+      }
+      else {
+        u32_t prefix = reversed & (root_size - 1);
+        if (prefix != subtable_prefix) {
+          // Make the subtable just big enough for every code left that
+          // starts with this prefix.
+          subtable_bits = len - table_bits;
+          s32_t room = 1 << subtable_bits;
+          while (subtable_bits + table_bits < max_len) {
+            room -= (s32_t)remaining[subtable_bits + table_bits];
+            if (room <= 0) break;
+            ++subtable_bits;
+            room <<= 1;
+          }
+          subtable_base = next_subtable;
+          next_subtable += 1u << subtable_bits;
+          if (next_subtable > table_size) return false;
+          for (u32_t i = subtable_base; i < next_subtable; ++i) {
+            table[i] = _ZLIB_ENTRY_INVALID;
+          }
+          table[prefix] = _ZLIB_ENTRY_SUBTABLE | (subtable_base << 16) | (subtable_bits << 4) | table_bits;
+          subtable_prefix = prefix;
+        }
+        u32_t sub_len = len - table_bits;
+        for (u32_t i = reversed >> table_bits; i < (1u << subtable_bits); i += 1u << sub_len) {
+          table[subtable_base + i] = entry | sub_len;
+        }
+      }
+      --remaining[len];
+      ++code;
+    }
+    code <<= 1;
+  }
+  return true;
 }
 
-// @note: This is done inplace
-static void
-_sort_quick_range(sort_entry_t* a, 
-    u32_t start, 
-    u32_t ope) 
-{
-  if (ope - start <= 1) {
-    return;
+static b32_t
+_zlib_build_fixed_tables(_zlib_inflater_t* z) {
+  u8_t lengths[_ZLIB_LITLEN_SYMBOLS + _ZLIB_DIST_SYMBOLS];
+  u32_t i = 0;
+  for (; i < 144; ++i) lengths[i] = 8;
+  for (; i < 256; ++i) lengths[i] = 9;
+  for (; i < 280; ++i) lengths[i] = 7;
+  for (; i < 288; ++i) lengths[i] = 8;
+  for (; i < array_count(lengths); ++i) lengths[i] = 5;
+
+  return _zlib_build_table(z->litlen_table, _ZLIB_LITLEN_TABLE_SIZE, _ZLIB_LITLEN_TABLE_BITS,
+                           lengths, _ZLIB_LITLEN_SYMBOLS, _zlib_symbols.litlen) &&
+         _zlib_build_table(z->dist_table, _ZLIB_DIST_TABLE_SIZE, _ZLIB_DIST_TABLE_BITS,
+                           lengths + _ZLIB_LITLEN_SYMBOLS, _ZLIB_DIST_SYMBOLS, _zlib_symbols.dist);
+}
+
+// @note: The order that dynamic block headers send precode lengths in
+static constexpr u8_t _zlib_precode_order[_ZLIB_PRECODE_SYMBOLS] = {
+  16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15
+};
+
+static b32_t
+_zlib_read_dynamic_tables(_zlib_inflater_t* z) {
+  _zlib_input_t* in = &z->in;
+
+  _zlib_refill(in);
+  u32_t HLIT = _zlib_consume(in, 5) + 257;
+  u32_t HDIST = _zlib_consume(in, 5) + 1;
+  u32_t HCLEN = _zlib_consume(in, 4) + 4;
+  if (HLIT > 286 || HDIST > 30) return false;
+
+  // The code lengths are themselves Huffman coded with the 'precode'
+  u8_t precode_lengths[_ZLIB_PRECODE_SYMBOLS] = {};
+  for (u32_t i = 0; i < HCLEN; ++i) {
+    _zlib_refill(in);
+    precode_lengths[_zlib_precode_order[i]] = (u8_t)_zlib_consume(in, 3);
+  }
+  if (!_zlib_build_table(z->precode_table, _ZLIB_PRECODE_TABLE_SIZE, _ZLIB_PRECODE_TABLE_BITS,
+                         precode_lengths, _ZLIB_PRECODE_SYMBOLS, _zlib_symbols.precode))
+  {
+    return false;
   }
-  u32_t pivot = _sort_quick_partition(a, start, ope);
-  _sort_quick_range(a, start, pivot);
-  _sort_quick_range(a, pivot+1, ope);
-}
 
-static void
-sort_quick(sort_entry_t* entries, u32_t entry_count) {
-  _sort_quick_range(entries, 0, entry_count);
+  u8_t lengths[_ZLIB_LITLEN_SYMBOLS + _ZLIB_DIST_SYMBOLS] = {};
+  u32_t total = HLIT + HDIST;
+  for (u32_t i = 0; i < total;) {
+    _zlib_refill(in);
+    u32_t e = _zlib_decode(in, z->precode_table, _ZLIB_PRECODE_TABLE_BITS);
+    if (e & _ZLIB_ENTRY_INVALID) return false;
 
+    u32_t sym = e >> 16;
+    if (sym < 16) {
+      lengths[i++] = (u8_t)sym;
+      continue;
+    }
+
+    u8_t length_to_repeat = 0;
+    u32_t times_to_repeat = 0;
+    if (sym == 16) {
+      // Copy the previous code length 3-6 times
+      if (i == 0) return false;
+      length_to_repeat = lengths[i - 1];
+      times_to_repeat = 3 + _zlib_consume(in, 2);
+    }
+    else if (sym == 17) {
+      // Repeat a code length of 0 for 3-10 times
+      times_to_repeat = 3 + _zlib_consume(in, 3);
+    }
+    else {
+      // Repeat a code length of 0 for 11-138 times
+      times_to_repeat = 11 + _zlib_consume(in, 7);
+    }
+    if (times_to_repeat > total - i) return false;
+    while (times_to_repeat--) {
+      lengths[i++] = length_to_repeat;
+    }
+  }
+
+  // A block without an end-of-block code can never end
+  if (lengths[256] == 0) return false;
+
+  return _zlib_build_table(z->litlen_table, _ZLIB_LITLEN_TABLE_SIZE, _ZLIB_LITLEN_TABLE_BITS,
+                           lengths, HLIT, _zlib_symbols.litlen) &&
+         _zlib_build_table(z->dist_table, _ZLIB_DIST_TABLE_SIZE, _ZLIB_DIST_TABLE_BITS,
+                           lengths + HLIT, HDIST, _zlib_symbols.dist);
+}
+
+static inline void
+_zlib_copy_16(u8_t* dest, const u8_t* src) {
+  u64_t lo = _memory_load_u64(src);
+  u64_t hi = _memory_load_u64(src + 8);
+  _memory_store_u64(dest, lo);
+  _memory_store_u64(dest + 8, hi);
+}
+
+// @note: Copies a match in 8 or 16 byte pieces, so it may write up to 31
+// bytes past the end of it. Most matches are short, so the first 32 bytes
+// go without a loop. Matches closer than 8 bytes are a repeating pattern,
+// which is stored 16 bytes at a time, stepping by a whole number of
+// repeats.
+static inline void
+_zlib_copy_match_fast(u8_t* out, u32_t dist, u32_t len) {
+  const u8_t* src = out - dist;
+  u8_t* end = out + len;
+  if (dist >= 16) {
+    _zlib_copy_16(out, src);
+    _zlib_copy_16(out + 16, src + 16);
+    out += 32;
+    src += 32;
+    while (out < end) {
+      _zlib_copy_16(out, src);
+      out += 16;
+      src += 16;
+    }
+  }
+  else if (dist >= 8) {
+    do {
+      _memory_store_u64(out, _memory_load_u64(src));
+      out += 8;
+      src += 8;
+    } while (out < end);
+  }
+  else {
+    static const u8_t steps[8] = { 0, 16, 16, 15, 16, 15, 12, 14 };
+    u8_t pattern[16];
+    for (u32_t i = 0; i < dist; ++i) {
+      pattern[i] = src[i];
+    }
+    for (u32_t i = dist; i < 16; ++i) {
+      pattern[i] = pattern[i - dist];
+    }
+    u32_t step = steps[dist];
+    do {
+      _zlib_copy_16(out, pattern);
+      out += step;
+    } while (out < end);
+  }
 }
 
+static void
+_zlib_copy_match_slow(u8_t* out, u32_t dist, u32_t len) {
+  const u8_t* src = out - dist;
+  for (u32_t i = 0; i < len; ++i) {
+    out[i] = src[i];
+  }
+}
 
+// @note: Decodes the symbols of one compressed block. The input state is
+// kept in a local so that the compiler can keep it in registers, as the
+// byte stores to 'out' could otherwise alias it.
 //
-// @mark:(Bonk)
-//
-static b32_t
-_bonk_tri2_pt2_parametric(v2f_t tp0, v2f_t tp1, v2f_t tp2, v2f_t pt) {
-  f32_t denominator = (tp0.x*(tp1.y - tp2.y) + 
-      tp0.y*(tp2.x - tp1.x) + 
-      tp1.x*tp2.y - tp1.y*tp2.x);
+// Matches may reach back to 'window'. If 'pause_room' is not 0, this stops
+// before a symbol once there is less room than that, which must be enough
+// for whatever one turn of the loop writes.
+static _zlib_status_t
+_zlib_inflate_block(_zlib_inflater_t* z, u8_t* window, u8_t** out_p, u8_t* out_end, usz_t pause_room) {
+  _zlib_input_t in = z->in;
+  u8_t* out = *out_p;
+  const u32_t* litlen_table = z->litlen_table;
+  const u32_t* dist_table = z->dist_table;
+  _zlib_status_t status = _ZLIB_STATUS_DONE;
 
-  f32_t t1 = (pt.x*(tp2.y - tp0.y) + 
-      pt.y*(tp0.x - tp2.x) - 
-      tp0.x*tp2.y + tp0.y*tp2.x) / denominator;
+  for (;;) {
+    if ((usz_t)(out_end - out) < pause_room) {
+      status = _ZLIB_STATUS_FULL;
+      break;
+    }
 
-  f32_t t2 = (pt.x*(tp1.y - tp0.y) + 
-      pt.y*(tp0.x - tp1.x) - 
-      tp0.x*tp1.y + tp0.y*tp1.x) / -denominator;
+    u32_t e;
+    if (in.end - in.next >= 16 && out_end - out >= 2) {
+      // With 16 bytes of input left, refills need no checks and a second
+      // one can follow. Two codes fit in one refill, so two literals in a
+      // row are decoded without one in between.
+      _zlib_refill_fast(&in);
+      e = _zlib_decode(&in, litlen_table, _ZLIB_LITLEN_TABLE_BITS);
+      if (e & _ZLIB_ENTRY_LITERAL) {
+        *out++ = (u8_t)(e >> 16);
+        e = _zlib_decode(&in, litlen_table, _ZLIB_LITLEN_TABLE_BITS);
+        if (e & _ZLIB_ENTRY_LITERAL) {
+          *out++ = (u8_t)(e >> 16);
+          continue;
+        }
+        _zlib_refill_fast(&in);
+      }
+    }
+    else {
+      _zlib_refill(&in);
+      e = _zlib_decode(&in, litlen_table, _ZLIB_LITLEN_TABLE_BITS);
+      if (e & _ZLIB_ENTRY_LITERAL) {
+        if (out == out_end) return _ZLIB_STATUS_BAD;
+        *out++ = (u8_t)(e >> 16);
+        continue;
+      }
+    }
+    if (e & _ZLIB_ENTRY_END) {
+      if (_zlib_input_is_overrun(&in)) return _ZLIB_STATUS_BAD;
+      break;
+    }
+    if (e & _ZLIB_ENTRY_INVALID) return _ZLIB_STATUS_BAD;
 
-  f32_t s = t1 + t2;
+    u32_t len = (e >> 16) + _zlib_consume(&in, (e >> 4) & 0xF);
+    e = _zlib_decode(&in, dist_table, _ZLIB_DIST_TABLE_BITS);
+    if (e & _ZLIB_ENTRY_INVALID) return _ZLIB_STATUS_BAD;
+    u32_t dist = (e >> 16) + _zlib_consume(&in, (e >> 4) & 0xF);
+    if (dist > (usz_t)(out - window)) return _ZLIB_STATUS_BAD;
 
-  return 0 <= t1 && t1 <= 1 && 0 <= t2 && t2 <= 1 && s <= 1;
+    usz_t room = (usz_t)(out_end - out);
+    if (room >= len + 32) {
+      _zlib_copy_match_fast(out, dist, len);
+    }
+    else {
+      if (len > room) return _ZLIB_STATUS_BAD;
+      _zlib_copy_match_slow(out, dist, len);
+    }
+    out += len;
+  }
+
+  z->in = in;
+  *out_p = out;
+  return status;
 }
 
-// Unoptimized: ~72 cycles/hit
-// -O2: ~27 cycles/hit 
-static b32_t
-_bonk_tri2_pt2_barycentric(v2f_t tp0, v2f_t tp1, v2f_t tp2, v2f_t pt) {
+#define _ZLIB_WINDOW_SIZE kilobytes(32) // how far back matches can reach
+#define _ZLIB_PAUSE_ROOM  (258 + 1)       // a literal, then the longest match
 
-  f32_t denominator = ((tp1.y - tp2.y)*
-      (tp0.x - tp2.x) + (tp2.x - tp1.x)*
-      (tp0.y - tp2.y));
+// @note: Inflates into '*out_p' up to 'out_end', moving '*out_p' along.
+// Everything from 'window' up to '*out_p' must be earlier output, as
+// matches can reach back that far.
+//
+// With a 'pause_room' of 0, running out of room is an error. Otherwise
+// this returns _ZLIB_STATUS_FULL once less than that is left, and carries
+// on from there the next time it is called. The last _ZLIB_WINDOW_SIZE
+// bytes of output must still be in the window by then.
 
-  f32_t a = ((tp1.y - tp2.y)*
-      (pt.x - tp2.x) + (tp2.x - tp1.x)*
-      (pt.y - tp2.y)) / denominator;
+static _zlib_status_t
+_zlib_inflate(_zlib_inflater_t* z, u8_t* window, u8_t** out_p, u8_t* out_end, usz_t pause_room) {
+  _zlib_input_t* in = &z->in;
 
-  f32_t b = ((tp2.y - tp0.y)*
-      (pt.x - tp2.x) + (tp0.x - tp2.x)*
-      (pt.y - tp2.y)) / denominator;
+  for (;;) {
+    switch (z->state) {
+      case _ZLIB_STATE_HEADER: {
+        _zlib_refill(in);
+        z->BFINAL = _zlib_consume(in, 1);
+        u32_t BTYPE = _zlib_consume(in, 2);
+        if (BTYPE == 0b00) {
+          // Stored: byte aligned LEN and NLEN, then LEN raw bytes
+          _zlib_consume(in, in->count & 7);
+          u8_t sizes[4];
+          if (!_zlib_read_bytes(in, sizes, sizeof(sizes))) return _ZLIB_STATUS_BAD;
+          u32_t LEN = sizes[0] | (sizes[1] << 8);
+          u32_t NLEN = sizes[2] | (sizes[3] << 8);
+          if (LEN != (~NLEN & 0xFFFF)) return _ZLIB_STATUS_BAD;
+          z->stored_size = LEN;
+          z->state = _ZLIB_STATE_STORED;
+        }
+        else if (BTYPE == 0b01) {
+          if (!z->is_fixed_built) {
+            if (!_zlib_build_fixed_tables(z)) return _ZLIB_STATUS_BAD;
+            z->is_fixed_built = true;
+          }
+          z->state = _ZLIB_STATE_HUFFMAN;
+        }
+        else if (BTYPE == 0b10) {
+          z->is_fixed_built = false;
+          if (!_zlib_read_dynamic_tables(z)) return _ZLIB_STATUS_BAD;
+          z->state = _ZLIB_STATE_HUFFMAN;
+        }
+        else {
+          return _ZLIB_STATUS_BAD;
+        }
+      } break;
 
-  f32_t c = 1.f - a - b;
+      case _ZLIB_STATE_STORED: {
+        usz_t size = min_of((usz_t)z->stored_size, (usz_t)(out_end - *out_p));
+        if (!_zlib_read_bytes(in, *out_p, size)) return _ZLIB_STATUS_BAD;
+        *out_p += size;
+        z->stored_size -= (u32_t)size;
+        if (z->stored_size > 0) {
+          return pause_room ? _ZLIB_STATUS_FULL : _ZLIB_STATUS_BAD;
+        }
+        z->state = z->BFINAL ? _ZLIB_STATE_DONE : _ZLIB_STATE_HEADER;
+      } break;
 
-  return 0.f <= a && a <= 1.f && 0.f <= b && b <= 1.f && 0.f <= c && c <= 1.f;
+      case _ZLIB_STATE_HUFFMAN: {
+        _zlib_status_t status = _zlib_inflate_block(z, window, out_p, out_end, pause_room);
+        if (status != _ZLIB_STATUS_DONE) return status;
+        z->state = z->BFINAL ? _ZLIB_STATE_DONE : _ZLIB_STATE_HEADER;
+      } break;
 
+      default: {
+        return _ZLIB_STATUS_DONE;
+      }
+    }
+  }
 }
 
-// Unoptimized: ~262 cycles/hit
-// -O2: ~27 cycles/hit 
 static b32_t
-_bonk_tri2_pt2_dot_product(v2f_t tp0, v2f_t tp1, v2f_t tp2, v2f_t pt) {
-  v2f_t vec0 = v2f_set(pt.x - tp0.x, pt.y - tp0.y);      
-  v2f_t vec1 = v2f_set(pt.x - tp1.x, pt.y - tp1.y);      
-  v2f_t vec2 = v2f_set(pt.x - tp2.x, pt.y - tp2.y);      
-
-  v2f_t n0 = v2f_set(tp1.y - tp0.y, -tp1.x + tp0.x);
-  v2f_t n1 = v2f_set(tp2.y - tp1.y, -tp2.x + tp1.x);
-  v2f_t n2 = v2f_set(tp0.y - tp2.y, -tp0.x + tp2.x);
-
-  b32_t side0 = v2f_dot(n0,vec0) < 0.f;
-  b32_t side1 = v2f_dot(n1,vec1) < 0.f;
-  b32_t side2 = v2f_dot(n2,vec2) < 0.f;
-
-  return side0 == side1 && side0 == side2;
+zlib_inflate_raw(buf_t dest, buf_t src, usz_t* out_size) {
+  _zlib_inflater_t z;
+  _zlib_inflater_init(&z, src.e, src.size);
+  u8_t* out = dest.e;
+  if (_zlib_inflate(&z, dest.e, &out, dest.e + dest.size, 0) != _ZLIB_STATUS_DONE) return false;
+  if (out_size) *out_size = (usz_t)(out - dest.e);
+  return true;
 }
 
-
 static b32_t
-bonk_tri2_pt2(v2f_t tp0, v2f_t tp1, v2f_t tp2, v2f_t pt) {
-  // @note(momo): this is the fastest of the 3 apparently
-  return _bonk_tri2_pt2_barycentric(tp0, tp1, tp2, pt);
-}
+zlib_inflate(buf_t dest, buf_t src, usz_t* out_size) {
+  _zlib_inflater_t z;
+  _zlib_inflater_init(&z, src.e, src.size);
+  if (!_zlib_read_header(&z.in)) return false;
 
-//
-// @mark:(RNG)
-//
+  u8_t* out = dest.e;
+  if (_zlib_inflate(&z, dest.e, &out, dest.e + dest.size, 0) != _ZLIB_STATUS_DONE) return false;
+  usz_t size = (usz_t)(out - dest.e);
+  if (!_zlib_check_trailer(&z.in, adler32(dest.e, size))) return false;
 
-static void 
-rng_init(rng_t* r, u32_t seed)
-{
-  r->seed = seed;
+  if (out_size) *out_size = size;
+  return true;
 }
 
 static u32_t
-rng_next(rng_t* r)
-{
-  u32_t result = r->seed;
-  result ^= result << 13;
-  result ^= result >> 17;
-  result ^= result << 5;
-  r->seed = result;
-  return result;
-}
+adler32(const void* data, usz_t size, u32_t adler) {
+  const u8_t* p = (const u8_t*)data;
+  u32_t a = adler & 0xFFFF;
+  u32_t b = adler >> 16;
+  while (size > 0) {
+    // @note: 5552 is the most bytes we can sum before 'b' may overflow
+    usz_t n = min_of(size, (usz_t)5552);
+    size -= n;
+#if MOMO_SSE2
+    // @note: 16 bytes at a time. Each block adds its sum to 'a', and adds
+    // to 'b' the 'a' it started with times 16, plus its bytes weighted
+    // from 16 down to 1. The 'a's that blocks start with are summed up in
+    // 'prev_a' and multiplied at the end.
+    if (n >= 16) {
+      usz_t block_size = n & ~(usz_t)15;
+      __m128i zero = _mm_setzero_si128();
+      __m128i weights_lo = _mm_setr_epi16(16, 15, 14, 13, 12, 11, 10, 9);
+      __m128i weights_hi = _mm_setr_epi16(8, 7, 6, 5, 4, 3, 2, 1);
+      __m128i va = zero;
+      __m128i vprev_a = zero;
+      __m128i vb = zero;
+      for (usz_t i = 0; i < block_size; i += 16) {
+        __m128i bytes = _mm_loadu_si128((const __m128i*)(p + i));
+        vprev_a = _mm_add_epi32(vprev_a, va);
+        va = _mm_add_epi32(va, _mm_sad_epu8(bytes, zero));
+        vb = _mm_add_epi32(vb, _mm_madd_epi16(_mm_unpacklo_epi8(bytes, zero), weights_lo));
+        vb = _mm_add_epi32(vb, _mm_madd_epi16(_mm_unpackhi_epi8(bytes, zero), weights_hi));
+      }
+      u32_t lanes_a[4], lanes_prev_a[4], lanes_b[4];
+      _mm_storeu_si128((__m128i*)lanes_a, va);
+      _mm_storeu_si128((__m128i*)lanes_prev_a, vprev_a);
+      _mm_storeu_si128((__m128i*)lanes_b, vb);
+      u64_t sum_a = (u64_t)lanes_a[0] + lanes_a[2];
+      u64_t sum_prev_a = (u64_t)lanes_prev_a[0] + lanes_prev_a[2];
+      u64_t sum_b = (u64_t)lanes_b[0] + lanes_b[1] + lanes_b[2] + lanes_b[3];
+      b = (u32_t)((b + (u64_t)a * block_size + sum_prev_a * 16 + sum_b) % 65521);
+      a = (u32_t)((a + sum_a) % 65521);
+      p += block_size;
+      n -= block_size;
+    }
+#endif
+    for (; n >= 8; n -= 8, p += 8) {
+      a += p[0]; b += a;
+      a += p[1]; b += a;
+      a += p[2]; b += a;
+      a += p[3]; b += a;
+      a += p[4]; b += a;
+      a += p[5]; b += a;
+      a += p[6]; b += a;
+      a += p[7]; b += a;
+    }
+    for (; n > 0; --n) {
+      a += *p++;
+      b += a;
+    }
+    a %= 65521;
+    b %= 65521;
+  }
+  return (b << 16) | a;
+}
+
+//
+// Deflating
+//
+#define _ZLIB_DEFLATE_HASH_BITS   15
+#define _ZLIB_DEFLATE_HASH_SIZE   (1 << _ZLIB_DEFLATE_HASH_BITS)
+#define _ZLIB_DEFLATE_MAX_DIST    (_ZLIB_WINDOW_SIZE - 1)
+#define _ZLIB_DEFLATE_MAX_SYMBOLS 16384              // before a block is written out
+#define _ZLIB_DEFLATE_CHUNK_SIZE  kilobytes(256)     // what each job compresses
+#define _ZLIB_DEFLATE_TOO_FAR     4096               // for a match of 3 to be worth it
+#define _ZLIB_DEFLATE_LAZY_LEVEL  4
+
+// @note: zlib's settings for each level. Levels below
+// _ZLIB_DEFLATE_LAZY_LEVEL take the first match they find, and only add
+// the strings inside matches up to 'max_lazy' long to the hash chains.
+// Levels from there on see if the next byte starts a longer match first,
+// unless the match is at least 'max_lazy' long.
+struct _zlib_deflate_level_t {
+  u16_t good_length; // search a quarter of the chain after a match this long
+  u16_t max_lazy;
+  u16_t nice_length; // stop searching after a match this long
+  u16_t max_chain;   // most candidates looked at
+};
 
-static u32_t 
-rng_choice(rng_t* r, u32_t choice_count) {
-  return rng_next(r) % choice_count;
-}
+static const _zlib_deflate_level_t _zlib_deflate_levels[10] = {
+  { 0,   0,   0,    0 }, // stored only
+  { 4,   4,   8,    4 },
+  { 4,   5,  16,    8 },
+  { 4,   6,  32,   32 },
+  { 4,   4,  16,   16 },
+  { 8,  16,  32,   32 },
+  { 8,  16, 128,  128 },
+  { 8,  32, 128,  256 },
+  { 32, 128, 258, 1024 },
+  { 32, 258, 258, 4096 },
+};
 
-// Get number within [0, 1]
-static f32_t 
-rng_unilateral(rng_t* r)
-{
-  f32_t divisor = 1.0f / (f32_t)U32_MAX;
-  f32_t result = divisor*(f32_t)rng_next(r);
+// @note: Symbols of a block, waiting for their codes. Literals are their
+// byte, matches are their length with the distance in the top half.
+struct _zlib_deflater_t {
+  const _zlib_deflate_level_t* level;
+  b32_t is_lazy;
+
+  u32_t* head; // the last position + 1 of each hash, 0 for none
+  u32_t* prev; // the position + 1 before it with the same hash
+
+  u32_t* symbols;
+  u32_t symbol_count;
+  u32_t litlen_freqs[_ZLIB_LITLEN_SYMBOLS];
+  u32_t dist_freqs[_ZLIB_DIST_SYMBOLS];
+
+  u8_t* out;
+  u64_t bits;
+  u32_t count;
+};
 
-  return result;
-}
+struct _zlib_deflate_code_t {
+  u16_t codes[_ZLIB_LITLEN_SYMBOLS];
+  u8_t lengths[_ZLIB_LITLEN_SYMBOLS];
+};
 
+// @note: Length symbols minus 257 for lengths 0-258, and distance symbols
+// for distances 1-256 then for each 128 after.
+struct _zlib_deflate_symbols_t {
+  u8_t len[259];
+  u8_t dist[512];
+};
 
-// Get number within [-1, 1]
-static f32_t 
-rng_bilateral(rng_t* r)
-{
-  f32_t result = 2.0f * rng_unilateral(r) - 1.0f;  
-  return(result);
+static constexpr _zlib_deflate_symbols_t
+_zlib_make_deflate_symbols() {
+  _zlib_deflate_symbols_t s = {};
+  for (u32_t i = 0; i < 29; ++i) {
+    u32_t end = i < 28 ? _zlib_len_bases[i + 1] : 259;
+    for (u32_t len = _zlib_len_bases[i]; len < end; ++len) {
+      s.len[len] = (u8_t)i;
+    }
+  }
+  for (u32_t i = 0; i < 30; ++i) {
+    u32_t end = i < 29 ? _zlib_dist_bases[i + 1] : 32769;
+    for (u32_t dist = _zlib_dist_bases[i]; dist < end; ++dist) {
+      if (dist <= 256) s.dist[dist - 1] = (u8_t)i;
+      else s.dist[256 + ((dist - 1) >> 7)] = (u8_t)i;
+    }
+  }
+  return s;
 }
 
-// Get number within [min, max]
-static f32_t 
-rng_range_f32(rng_t* r, f32_t min, f32_t max)
-{
-  f32_t result = f32_lerp(min, rng_unilateral(r), max);
-  return(result);
-}
+static constexpr _zlib_deflate_symbols_t _zlib_deflate_symbols = _zlib_make_deflate_symbols();
 
-// Get number within [min, max)
-static s32_t 
-rng_range_s32(rng_t* r, s32_t min, s32_t max)
-{
-  s32_t result = min + (s32_t)(rng_next(r)%(max  - min));
-  return(result);
+static inline u32_t
+_zlib_deflate_dist_symbol(u32_t dist) {
+  return dist <= 256 ? _zlib_deflate_symbols.dist[dist - 1] : _zlib_deflate_symbols.dist[256 + ((dist - 1) >> 7)];
 }
 
-// Get number within [min, max)
-static u32_t
-rng_range_u32(rng_t* r, u32_t min, u32_t max)
-{
-  u32_t result = min + (u32_t)(rng_next(r)%(max - min));
-  return(result);
+// @note: Holds up to 63 bits and writes out 32 at a time. Writing at most
+// 32 at once keeps it from overflowing.
+static inline void
+_zlib_put_bits(_zlib_deflater_t* d, u32_t value, u32_t bit_count) {
+  d->bits |= (u64_t)value << d->count;
+  d->count += bit_count;
+  if (d->count >= 32) {
+    _memory_store_u32(d->out, (u32_t)d->bits);
+    d->out += 4;
+    d->bits >>= 32;
+    d->count -= 32;
+  }
 }
 
-// Get number within [min, max)
-static u8_t
-rng_range_u8(rng_t* r, u8_t min, u8_t max)
-{
-  u8_t result = min + (u8_t)(rng_next(r)%(max - min));
-  return(result);
+// Pads to a byte boundary and writes out every bit
+static void
+_zlib_put_align(_zlib_deflater_t* d) {
+  d->count = (d->count + 7) & ~7u;
+  while (d->count > 0) {
+    *d->out++ = (u8_t)d->bits;
+    d->bits >>= 8;
+    d->count -= 8;
+  }
+  d->bits = 0;
 }
 
-static v2f_t 
-rng_unit_circle(rng_t* r) {
-  f32_t rand_angle = 2.f * PI_32 * rng_unilateral(r);
-  v2f_t ret = {0};
-  ret.x = f32_cos(rand_angle);
-  ret.y = f32_sin(rand_angle);
-
-  return ret;
-}
+// @note: Code lengths of at most 'max_len' bits for 'freqs'. The lengths
+// come from Moffat and Katajainen's in-place Huffman algorithm. If some
+// are too long, lengths are moved around until the code fits, the way
+// miniz does it, and the most frequent symbols get the shortest.
+static void
+_zlib_deflate_build_lengths(const u32_t* freqs, u32_t count, u32_t max_len, u8_t* lengths) {
+  u32_t sorted[_ZLIB_LITLEN_SYMBOLS]; // frequency in the top bits, symbol in the bottom 9
+  u32_t n = 0;
+  for (u32_t i = 0; i < count; ++i) {
+    lengths[i] = 0;
+    if (freqs[i]) sorted[n++] = (freqs[i] << 9) | i;
+  }
+  // @note: zlib refuses codes that are not complete, which one code of
+  // 1 bit is not, so there are always at least two.
+  for (u32_t i = 0; n < 2; ++i) {
+    if (!freqs[i]) sorted[n++] = (1 << 9) | i;
+  }
+  sort_quick(sorted, n, [](u32_t lhs, u32_t rhs) { return lhs < rhs; });
+
+  u32_t A[_ZLIB_LITLEN_SYMBOLS];
+  for (u32_t i = 0; i < n; ++i) A[i] = sorted[i] >> 9;
+
+  // Pair up the two smallest of the leaves and the trees made so far.
+  // Trees go in the front of A, each pointing at its parent.
+  s32_t root = 0;
+  s32_t leaf = 2;
+  A[0] += A[1];
+  for (s32_t next = 1; next < (s32_t)n - 1; ++next) {
+    if (leaf >= (s32_t)n || A[root] < A[leaf]) {
+      A[next] = A[root];
+      A[root++] = next;
+    }
+    else {
+      A[next] = A[leaf++];
+    }
+    if (leaf >= (s32_t)n || (root < next && A[root] < A[leaf])) {
+      A[next] += A[root];
+      A[root++] = next;
+    }
+    else {
+      A[next] += A[leaf++];
+    }
+  }
 
-//
-// @mark:(CRC)
-//
+  // Parents to depths of the trees, then depths of the leaves
+  A[n - 2] = 0;
+  for (s32_t next = (s32_t)n - 3; next >= 0; --next) {
+    A[next] = A[A[next]] + 1;
+  }
+  s32_t available = 1;
+  s32_t used = 0;
+  u32_t depth = 0;
+  root = (s32_t)n - 2;
+  s32_t next = (s32_t)n - 1;
+  while (available > 0) {
+    while (root >= 0 && A[root] == depth) {
+      ++used;
+      --root;
+    }
+    while (available > used) {
+      A[next--] = depth;
+      --available;
+    }
+    available = 2 * used;
+    ++depth;
+    used = 0;
+  }
 
-//
-// Slow versions
-//
-// These are for quick and easy use. 
-// Try not to use this for production
-//
-static u32_t
-crc32_slow(u8_t* data, u32_t data_size, u32_t start_register, u32_t polynomial) {
-  u32_t r = start_register;
-  for (u32_t i = 0; i < data_size; ++i ){
-    r ^= data[i] <<  24;
-    for (u32_t j = 0; j < 8; ++j) {
-      if((r & 0x80000000) != 0) {
-        r = (u32_t)((r << 1) ^ polynomial);
-      }
-      else {
-        r <<= 1;
+  // A is now the lengths from longest to shortest
+  u32_t len_counts[_ZLIB_LITLEN_SYMBOLS + 1] = {};
+  for (u32_t i = 0; i < n; ++i) {
+    ++len_counts[min_of(A[i], max_len)];
+  }
+  u32_t total = 0;
+  for (u32_t len = 1; len <= max_len; ++len) {
+    total += len_counts[len] << (max_len - len);
+  }
+  while (total != (1u << max_len)) {
+    --len_counts[max_len];
+    for (u32_t len = max_len - 1; len > 0; --len) {
+      if (len_counts[len]) {
+        --len_counts[len];
+        len_counts[len + 1] += 2;
+        break;
       }
     }
+    --total;
+  }
+
+  u32_t index = 0;
+  for (u32_t len = max_len; len > 0; --len) {
+    for (u32_t i = 0; i < len_counts[len]; ++i) {
+      lengths[sorted[index++] & 511] = (u8_t)len;
+    }
+  }
+}
+
+// @note: Canonical codes from lengths (RFC 1951, 3.2.2), reversed as they
+// go out from their first bit.
+static void
+_zlib_deflate_build_codes(_zlib_deflate_code_t* c, u32_t count) {
+  u32_t len_counts[16] = {};
+  for (u32_t i = 0; i < count; ++i) {
+    ++len_counts[c->lengths[i]];
+  }
+  len_counts[0] = 0;
+  u32_t next_codes[16] = {};
+  u32_t code = 0;
+  for (u32_t len = 1; len < 16; ++len) {
+    code = (code + len_counts[len - 1]) << 1;
+    next_codes[len] = code;
+  }
+  for (u32_t i = 0; i < count; ++i) {
+    u32_t len = c->lengths[i];
+    c->codes[i] = len ? (u16_t)_zlib_reverse_bits(next_codes[len]++, len) : 0;
   }
-  return r;
 }
 
+static void
+_zlib_deflate_fixed_codes(_zlib_deflate_code_t* litlen, _zlib_deflate_code_t* dist) {
+  for (u32_t i = 0; i < _ZLIB_LITLEN_SYMBOLS; ++i) {
+    litlen->lengths[i] = i < 144 ? 8 : i < 256 ? 9 : i < 280 ? 7 : 8;
+  }
+  for (u32_t i = 0; i < _ZLIB_DIST_SYMBOLS; ++i) {
+    dist->lengths[i] = 5;
+  }
+  _zlib_deflate_build_codes(litlen, _ZLIB_LITLEN_SYMBOLS);
+  _zlib_deflate_build_codes(dist, _ZLIB_DIST_SYMBOLS);
+}
 
-static u32_t
-crc16_slow(u8_t* data, u32_t data_size, u16_t start_register, u16_t polynomial) {
-  u32_t r = start_register;
-  for (u32_t i = 0; i < data_size; ++i ){
-    r ^= data[i] << 8;
-    for (u32_t j = 0; j < 8; ++j) {
-      if((r & 0x8000) != 0) {
-        r = (u32_t)((r << 1) ^ polynomial);
-      }
-      else {
-        r <<= 1;
-      }
+// Bits that the symbols take with these codes, extra bits included
+static u64_t
+_zlib_deflate_symbols_cost(_zlib_deflater_t* d, _zlib_deflate_code_t* litlen, _zlib_deflate_code_t* dist) {
+  u64_t bits = 0;
+  for (u32_t i = 0; i < _ZLIB_LITLEN_SYMBOLS; ++i) {
+    u32_t extra = i >= 257 && i < 286 ? _zlib_len_extra_bits[i - 257] : 0;
+    bits += (u64_t)d->litlen_freqs[i] * (litlen->lengths[i] + extra);
+  }
+  for (u32_t i = 0; i < 30; ++i) {
+    bits += (u64_t)d->dist_freqs[i] * (dist->lengths[i] + _zlib_dist_extra_bits[i]);
+  }
+  return bits;
+}
+
+static void
+_zlib_deflate_put_symbols(_zlib_deflater_t* d, _zlib_deflate_code_t* litlen, _zlib_deflate_code_t* dist) {
+  for (u32_t i = 0; i < d->symbol_count; ++i) {
+    u32_t symbol = d->symbols[i];
+    u32_t match_dist = symbol >> 16;
+    if (match_dist == 0) {
+      _zlib_put_bits(d, litlen->codes[symbol], litlen->lengths[symbol]);
+      continue;
     }
+    u32_t len = symbol & 0xFFFF;
+    u32_t len_symbol = _zlib_deflate_symbols.len[len];
+    u32_t code_len = litlen->lengths[257 + len_symbol];
+    _zlib_put_bits(d, litlen->codes[257 + len_symbol] | ((len - _zlib_len_bases[len_symbol]) << code_len),
+                   code_len + _zlib_len_extra_bits[len_symbol]);
+    u32_t dist_symbol = _zlib_deflate_dist_symbol(match_dist);
+    code_len = dist->lengths[dist_symbol];
+    _zlib_put_bits(d, dist->codes[dist_symbol], code_len);
+    _zlib_put_bits(d, match_dist - _zlib_dist_bases[dist_symbol], _zlib_dist_extra_bits[dist_symbol]);
   }
-  return r;
+  _zlib_put_bits(d, litlen->codes[256], litlen->lengths[256]);
 }
 
-static u32_t
-crc8_slow(u8_t* data, u32_t data_size, u16_t start_register, u16_t polynomial) {
-  u32_t r = start_register;
-  for (u32_t i = 0; i < data_size; ++i ){
-    r ^= data[i];
-    for (u32_t j = 0; j < 8; ++j) {
-      if((r & 0x80) != 0) {
-        r = (u32_t)((r << 1) ^ polynomial);
+// Stored blocks of up to 64KB each
+static void
+_zlib_deflate_put_stored(_zlib_deflater_t* d, const u8_t* data, usz_t size, b32_t is_final) {
+  do {
+    u32_t len = (u32_t)min_of(size, (usz_t)65535);
+    size -= len;
+    _zlib_put_bits(d, is_final && size == 0, 1);
+    _zlib_put_bits(d, 0b00, 2);
+    _zlib_put_align(d);
+    _zlib_put_bits(d, len | ((~len & 0xFFFF) << 16), 32);
+    memory_copy(d->out, data, len);
+    d->out += len;
+    data += len;
+  } while (size > 0);
+}
+
+// @note: Writes out the symbols so far as one block, in whichever of the
+// three block types is smallest. 'data' is what they stand for, for a
+// stored block.
+static void
+_zlib_deflate_flush_block(_zlib_deflater_t* d, const u8_t* data, usz_t size, b32_t is_final) {
+  ++d->litlen_freqs[256];
+
+  _zlib_deflate_code_t litlen, dist;
+  _zlib_deflate_build_lengths(d->litlen_freqs, 286, 15, litlen.lengths);
+  _zlib_deflate_build_lengths(d->dist_freqs, 30, 15, dist.lengths);
+  litlen.lengths[286] = litlen.lengths[287] = 0;
+  dist.lengths[30] = dist.lengths[31] = 0;
+  _zlib_deflate_build_codes(&litlen, _ZLIB_LITLEN_SYMBOLS);
+  _zlib_deflate_build_codes(&dist, _ZLIB_DIST_SYMBOLS);
+
+  u32_t HLIT = 286;
+  while (HLIT > 257 && litlen.lengths[HLIT - 1] == 0) --HLIT;
+  u32_t HDIST = 30;
+  while (HDIST > 1 && dist.lengths[HDIST - 1] == 0) --HDIST;
+
+  // The code lengths, run length coded with the precode's 16, 17 and 18.
+  // Each entry has the extra bits above the symbol.
+  u8_t lengths[_ZLIB_LITLEN_SYMBOLS + _ZLIB_DIST_SYMBOLS];
+  memory_copy(lengths, litlen.lengths, HLIT);
+  memory_copy(lengths + HLIT, dist.lengths, HDIST);
+  u32_t total = HLIT + HDIST;
+  u16_t runs[_ZLIB_LITLEN_SYMBOLS + _ZLIB_DIST_SYMBOLS];
+  u32_t run_count = 0;
+  u32_t precode_freqs[_ZLIB_PRECODE_SYMBOLS] = {};
+  for (u32_t i = 0; i < total;) {
+    u32_t len = lengths[i];
+    u32_t repeat = 1;
+    while (i + repeat < total && lengths[i + repeat] == len) ++repeat;
+    i += repeat;
+    if (len == 0) {
+      while (repeat >= 11) {
+        u32_t n = min_of(repeat, 138u);
+        runs[run_count++] = (u16_t)(18 | ((n - 11) << 8));
+        repeat -= n;
       }
-      else {
-        r <<= 1;
+      if (repeat >= 3) {
+        runs[run_count++] = (u16_t)(17 | ((repeat - 3) << 8));
+        repeat = 0;
+      }
+    }
+    else {
+      runs[run_count++] = (u16_t)len;
+      --repeat;
+      while (repeat >= 3) {
+        u32_t n = min_of(repeat, 6u);
+        runs[run_count++] = (u16_t)(16 | ((n - 3) << 8));
+        repeat -= n;
       }
     }
+    while (repeat--) runs[run_count++] = (u16_t)len;
+  }
+  for (u32_t i = 0; i < run_count; ++i) {
+    ++precode_freqs[runs[i] & 0xFF];
   }
-  return r;
-}
 
-//
-// Table generation
-//
-static void 
-crc32_init_table(crc32_table_t* table, u32_t polynomial) {
-  for (u32_t divident = 0; divident < 256; ++divident) {
-    u32_t remainder = divident <<  24;
-    for (u32_t j = 0; j < 8; ++j) {
-      if((remainder & 0x80000000) != 0) {
-        remainder = (u32_t)((remainder << 1) ^ polynomial);
-      }
-      else {
-        remainder <<= 1;
+  _zlib_deflate_code_t precode;
+  _zlib_deflate_build_lengths(precode_freqs, _ZLIB_PRECODE_SYMBOLS, 7, precode.lengths);
+  _zlib_deflate_build_codes(&precode, _ZLIB_PRECODE_SYMBOLS);
+  u32_t HCLEN = _ZLIB_PRECODE_SYMBOLS;
+  while (HCLEN > 4 && precode.lengths[_zlib_precode_order[HCLEN - 1]] == 0) --HCLEN;
+
+  // What each block type costs, in bits
+  static const u8_t precode_extra_bits[3] = { 2, 3, 7 };
+  u64_t dynamic_cost = 3 + 5 + 5 + 4 + 3 * HCLEN + _zlib_deflate_symbols_cost(d, &litlen, &dist);
+  for (u32_t i = 0; i < _ZLIB_PRECODE_SYMBOLS; ++i) {
+    dynamic_cost += (u64_t)precode_freqs[i] * (precode.lengths[i] + (i >= 16 ? precode_extra_bits[i - 16] : 0));
+  }
+  _zlib_deflate_code_t fixed_litlen, fixed_dist;
+  _zlib_deflate_fixed_codes(&fixed_litlen, &fixed_dist);
+  u64_t fixed_cost = 3 + _zlib_deflate_symbols_cost(d, &fixed_litlen, &fixed_dist);
+  u64_t stored_cost = (size / 65535 + 1) * (3 + 7 + 32) + (u64_t)size * 8;
+
+  if (stored_cost <= dynamic_cost && stored_cost <= fixed_cost) {
+    _zlib_deflate_put_stored(d, data, size, is_final);
+  }
+  else if (fixed_cost <= dynamic_cost) {
+    _zlib_put_bits(d, is_final, 1);
+    _zlib_put_bits(d, 0b01, 2);
+    _zlib_deflate_put_symbols(d, &fixed_litlen, &fixed_dist);
+  }
+  else {
+    _zlib_put_bits(d, is_final, 1);
+    _zlib_put_bits(d, 0b10, 2);
+    _zlib_put_bits(d, HLIT - 257, 5);
+    _zlib_put_bits(d, HDIST - 1, 5);
+    _zlib_put_bits(d, HCLEN - 4, 4);
+    for (u32_t i = 0; i < HCLEN; ++i) {
+      _zlib_put_bits(d, precode.lengths[_zlib_precode_order[i]], 3);
+    }
+    for (u32_t i = 0; i < run_count; ++i) {
+      u32_t symbol = runs[i] & 0xFF;
+      _zlib_put_bits(d, precode.codes[symbol], precode.lengths[symbol]);
+      if (symbol >= 16) _zlib_put_bits(d, runs[i] >> 8, precode_extra_bits[symbol - 16]);
+    }
+    _zlib_deflate_put_symbols(d, &litlen, &dist);
+  }
+
+  d->symbol_count = 0;
+  memory_zero(d->litlen_freqs, sizeof(d->litlen_freqs));
+  memory_zero(d->dist_freqs, sizeof(d->dist_freqs));
+}
+
+// @note: Hashes the 3 bytes at 'p', but loads 4
+static inline u32_t
+_zlib_deflate_hash(const u8_t* p) {
+  return ((_memory_load_u32(p) & 0xFFFFFF) * 2654435761u) >> (32 - _ZLIB_DEFLATE_HASH_BITS);
+}
+
+static inline void
+_zlib_deflate_insert(_zlib_deflater_t* d, const u8_t* base, u32_t pos) {
+  u32_t hash = _zlib_deflate_hash(base + pos);
+  d->prev[pos & _ZLIB_DEFLATE_MAX_DIST] = d->head[hash];
+  d->head[hash] = pos + 1;
+}
+
+// @note: Looks down the hash chain of 'pos', which must already be
+// inserted, for a match longer than 'prev_len'. Returns its length, or
+// 'prev_len' if there is none.
+static inline u32_t
+_zlib_deflate_longest_match(_zlib_deflater_t* d, const u8_t* base, u32_t pos, u32_t end, u32_t prev_len, u32_t* out_dist) {
+  const _zlib_deflate_level_t* level = d->level;
+  u32_t chain = prev_len >= level->good_length ? level->max_chain >> 2 : level->max_chain;
+  u32_t max_len = min_of(end - pos, 258u);
+  u32_t nice_len = min_of((u32_t)level->nice_length, max_len);
+  u32_t limit = pos > _ZLIB_DEFLATE_MAX_DIST ? pos - _ZLIB_DEFLATE_MAX_DIST : 0;
+  u32_t best_len = prev_len;
+  if (best_len >= max_len) return best_len;
+
+  const u8_t* p = base + pos;
+  u32_t cand = d->prev[pos & _ZLIB_DEFLATE_MAX_DIST];
+  while (cand-- > limit && chain--) {
+    const u8_t* q = base + cand;
+    if (q[best_len] != p[best_len] || q[0] != p[0] || q[1] != p[1]) {
+      cand = d->prev[cand & _ZLIB_DEFLATE_MAX_DIST];
+      continue;
+    }
+
+    u32_t len = 0;
+    while (len + 8 <= max_len) {
+      u64_t diff = _memory_load_u64(p + len) ^ _memory_load_u64(q + len);
+      if (diff) {
+        len += u64_ctz(diff) >> 3;
+        goto found;
       }
+      len += 8;
     }
-    table->remainders[divident] = remainder;
+    while (len < max_len && p[len] == q[len]) ++len;
+  found:
+    if (len > best_len) {
+      best_len = len;
+      *out_dist = pos - cand;
+      if (len >= nice_len) break;
+    }
+    cand = d->prev[cand & _ZLIB_DEFLATE_MAX_DIST];
   }
+  return best_len;
+}
+
+static inline void
+_zlib_deflate_put_literal(_zlib_deflater_t* d, u8_t byte) {
+  d->symbols[d->symbol_count++] = byte;
+  ++d->litlen_freqs[byte];
+}
+
+static inline void
+_zlib_deflate_put_match(_zlib_deflater_t* d, u32_t len, u32_t dist) {
+  d->symbols[d->symbol_count++] = (dist << 16) | len;
+  ++d->litlen_freqs[257 + _zlib_deflate_symbols.len[len]];
+  ++d->dist_freqs[_zlib_deflate_dist_symbol(dist)];
 }
 
+// @note: Compresses src[start, end) as whole blocks, where 'src' begins
+// with up to 32KB of dictionary that matches may reach back into. The
+// last chunk gets the final block; the others end in a sync flush (an
+// empty stored block) so that their output can be put side by side.
 static void
-crc16_init_table(crc16_table_t* table, u16_t polynomial) {
-  for (u32_t divident = 0; divident < 256; ++divident) {
-    u32_t remainder = divident << 8;
-    for (u32_t j = 0; j < 8; ++j) {
-      if((remainder & 0x8000) != 0) {
-        remainder = (u16_t)((remainder << 1) ^ polynomial);
+_zlib_deflate_chunk(_zlib_deflater_t* d, const u8_t* src, u32_t start, u32_t end, u32_t avail, b32_t is_last) {
+  memory_zero(d->head, sizeof(u32_t) * _ZLIB_DEFLATE_HASH_SIZE);
+  // @note: Hashing a position reads 4 bytes, so the last 3 never start a match
+  u32_t hash_end = avail >= 3 ? avail - 3 : 0;
+  for (u32_t pos = 0; pos < start && pos < hash_end; ++pos) {
+    _zlib_deflate_insert(d, src, pos);
+  }
+
+  u32_t max_lazy = d->level->max_lazy;
+  u32_t block_start = start;
+  u32_t emitted = start;
+  u32_t pos = start;
+
+  if (!d->is_lazy) {
+    while (pos < end) {
+      u32_t len = 2, dist = 0;
+      if (pos < hash_end) {
+        _zlib_deflate_insert(d, src, pos);
+        len = _zlib_deflate_longest_match(d, src, pos, end, 2, &dist);
+        if (len == 3 && dist > _ZLIB_DEFLATE_TOO_FAR) len = 2;
+      }
+      if (len >= 3) {
+        _zlib_deflate_put_match(d, len, dist);
+        u32_t match_end = pos + len;
+        if (len <= max_lazy) {
+          for (++pos; pos < match_end && pos < hash_end; ++pos) {
+            _zlib_deflate_insert(d, src, pos);
+          }
+        }
+        pos = match_end;
       }
       else {
-        remainder <<= 1;
+        _zlib_deflate_put_literal(d, src[pos++]);
+      }
+      emitted = pos;
+      if (d->symbol_count == _ZLIB_DEFLATE_MAX_SYMBOLS) {
+        _zlib_deflate_flush_block(d, src + block_start, emitted - block_start, false);
+        block_start = emitted;
       }
     }
-    table->remainders[divident] = (u16_t)remainder;
   }
-}
-
-static void 
-crc8_init_table(crc8_table_t* table, u8_t polynomial) {
-  for (u32_t divident = 0; divident < 256; ++divident) {
-    u32_t remainder = divident;
-    for (u32_t j = 0; j < 8; ++j) {
-      if((remainder & 0x80) != 0) {
-        remainder = (u8_t)((remainder << 1) ^ polynomial);
+  else {
+    // @note: Like zlib's deflate_slow(). The match found at the previous
+    // position is only taken if this position has no longer one, otherwise
+    // the previous byte goes out as a literal.
+    u32_t prev_len = 2, prev_dist = 0;
+    b32_t has_prev = false;
+    while (pos < end) {
+      u32_t len = 2, dist = 0;
+      if (pos < hash_end) {
+        _zlib_deflate_insert(d, src, pos);
+        if (prev_len < max_lazy) {
+          len = _zlib_deflate_longest_match(d, src, pos, end, prev_len, &dist);
+          if (len == 3 && dist > _ZLIB_DEFLATE_TOO_FAR) len = 2;
+        }
+      }
+      if (prev_len >= 3 && len <= prev_len) {
+        _zlib_deflate_put_match(d, prev_len, prev_dist);
+        u32_t match_end = pos - 1 + prev_len;
+        for (++pos; pos < match_end && pos < hash_end; ++pos) {
+          _zlib_deflate_insert(d, src, pos);
+        }
+        pos = match_end;
+        emitted = pos;
+        has_prev = false;
+        prev_len = 2;
       }
       else {
-        remainder <<= 1;
+        if (has_prev) {
+          _zlib_deflate_put_literal(d, src[pos - 1]);
+          emitted = pos;
+        }
+        has_prev = true;
+        prev_len = len;
+        prev_dist = dist;
+        ++pos;
+      }
+      if (d->symbol_count == _ZLIB_DEFLATE_MAX_SYMBOLS) {
+        _zlib_deflate_flush_block(d, src + block_start, emitted - block_start, false);
+        block_start = emitted;
       }
     }
-    table->remainders[divident] = (u8_t)remainder;
+    if (has_prev) {
+      _zlib_deflate_put_literal(d, src[end - 1]);
+      emitted = end;
+    }
   }
-}
 
-//
-// Faster version
-//
-static u32_t
-crc32(u8_t* data, u32_t data_size, u16_t start_register, crc32_table_t* table) {
-  u32_t crc = start_register;
-  for (u32_t i = 0; i < data_size; ++i) {
-    u32_t divident = (u32_t)((crc ^ (data[i] << 24)) >> 24);
-    crc = (u32_t)((crc << 8) ^ (u32_t)(table->remainders[divident]));
+  _zlib_deflate_flush_block(d, src + block_start, end - block_start, is_last);
+  if (!is_last) {
+    _zlib_put_bits(d, 0, 3);
+    _zlib_put_align(d);
+    _zlib_put_bits(d, 0xFFFF0000, 32);
   }
-  return crc;
+  _zlib_put_align(d);
 }
 
-static u32_t
-crc16(u8_t* data, u32_t data_size, u16_t start_register, crc16_table_t* table) {
-  u16_t crc = start_register;
-  for (u32_t i = 0; i < data_size; ++i) {
-    u16_t divident = (u16_t)((crc ^ (data[i] << 8)) >> 8);
-    crc = (u16_t)((crc << 8) ^ (u16_t)(table->remainders[divident]));
+// @note: Worst case output for a chunk of 'size' bytes. Blocks that are
+// stored cost at most 5 bytes per 64KB and a few bytes each, and there is
+// a block for every _ZLIB_DEFLATE_MAX_SYMBOLS bytes at most.
+static usz_t
+_zlib_deflate_chunk_bound(usz_t size) {
+  return size + (size >> 11) + 32;
+}
+
+static b32_t
+_zlib_deflater_init(_zlib_deflater_t* d, u32_t level, arena_t* arena) {
+  d->level = _zlib_deflate_levels + level;
+  d->is_lazy = level >= _ZLIB_DEFLATE_LAZY_LEVEL;
+  d->head = arena_push_arr(u32_t, arena, _ZLIB_DEFLATE_HASH_SIZE);
+  d->prev = arena_push_arr(u32_t, arena, _ZLIB_WINDOW_SIZE);
+  d->symbols = arena_push_arr(u32_t, arena, _ZLIB_DEFLATE_MAX_SYMBOLS);
+  d->symbol_count = 0;
+  memory_zero(d->litlen_freqs, sizeof(d->litlen_freqs));
+  memory_zero(d->dist_freqs, sizeof(d->dist_freqs));
+  d->bits = 0;
+  d->count = 0;
+  return d->head && d->prev && d->symbols;
+}
+
+// Compresses the chunk at 'chunk_index' of 'src' into 'd->out'
+static void
+_zlib_deflate_chunk_at(_zlib_deflater_t* d, buf_t src, u32_t chunk_index, u32_t chunk_count) {
+  usz_t start = (usz_t)chunk_index * _ZLIB_DEFLATE_CHUNK_SIZE;
+  usz_t end = min_of(start + _ZLIB_DEFLATE_CHUNK_SIZE, src.size);
+  usz_t dict_size = min_of(start, (usz_t)_ZLIB_WINDOW_SIZE);
+  const u8_t* base = src.e + start - dict_size;
+  usz_t avail = min_of(src.size - (start - dict_size), (usz_t)U32_MAX);
+  _zlib_deflate_chunk(d, base, (u32_t)dict_size, (u32_t)(end - start + dict_size), (u32_t)avail,
+                      chunk_index == chunk_count - 1);
+}
+
+struct _zlib_deflate_job_t {
+  _zlib_deflater_t d;
+  buf_t src;
+  u8_t* regions; // every chunk gets _zlib_deflate_chunk_bound() bytes
+  usz_t* chunk_sizes;
+  u32_t chunk_count;
+  u32_t volatile* next_chunk;
+};
+
+static void
+_zlib_deflate_job(void* data) {
+  auto* job = (_zlib_deflate_job_t*)data;
+  for (;;) {
+    u32_t chunk_index = u32_atomic_add(job->next_chunk, 1);
+    if (chunk_index >= job->chunk_count) break;
+    u8_t* region = job->regions + chunk_index * _zlib_deflate_chunk_bound(_ZLIB_DEFLATE_CHUNK_SIZE);
+    job->d.out = region;
+    _zlib_deflate_chunk_at(&job->d, job->src, chunk_index, job->chunk_count);
+    job->chunk_sizes[chunk_index] = (usz_t)(job->d.out - region);
   }
-  return crc;
 }
 
-static u32_t
-crc8(u8_t* data, u32_t data_size, u8_t start_register, crc8_table_t* table) {
-  u8_t crc = start_register;
-  for (u32_t i = 0; i < data_size; ++i) {
-    u8_t divident = (u8_t)(crc ^ data[i]);
-    crc = table->remainders[divident];
+static usz_t
+zlib_deflate_bound(usz_t size) {
+  return size + (size >> 11) + (size / _ZLIB_DEFLATE_CHUNK_SIZE + 1) * 32 + 16;
+}
+
+static b32_t
+zlib_deflate(buf_t dest, buf_t src, u32_t level, arena_t* scratch, usz_t* out_size, job_system_t* js) {
+  if (level > 9 || dest.size < zlib_deflate_bound(src.size)) return false;
+  arena_set_revert_point(scratch);
+
+  // @note: FLEVEL as zlib sets it, then FCHECK to make CMF and FLG a
+  // multiple of 31.
+  u32_t flevel = level < 2 ? 0 : level < 6 ? 1 : level == 6 ? 2 : 3;
+  u32_t header = (0x78 << 8) | (flevel << 6);
+  header += 31 - header % 31;
+  dest.e[0] = (u8_t)(header >> 8);
+  dest.e[1] = (u8_t)header;
+  u8_t* out = dest.e + 2;
+
+  if (level == 0) {
+    _zlib_deflater_t d = {};
+    d.out = out;
+    _zlib_deflate_put_stored(&d, src.e, src.size, true);
+    out = d.out;
   }
-  return crc;
+  else {
+    u32_t chunk_count = (u32_t)max_of((src.size + _ZLIB_DEFLATE_CHUNK_SIZE - 1) / _ZLIB_DEFLATE_CHUNK_SIZE, (usz_t)1);
+    u32_t job_count = js ? min_of(js->worker_count, chunk_count) : 1;
+    if (job_count <= 1) {
+      _zlib_deflater_t d;
+      if (!_zlib_deflater_init(&d, level, scratch)) return false;
+      d.out = out;
+      for (u32_t chunk_index = 0; chunk_index < chunk_count; ++chunk_index) {
+        _zlib_deflate_chunk_at(&d, src, chunk_index, chunk_count);
+      }
+      out = d.out;
+    }
+    else {
+      // @note: Chunks are compressed into their own regions of 'dest',
+      // which the bound has room for, then moved together in order.
+      // Where a chunk is cut depends only on its size, so the output is
+      // the same however many workers there are.
+      usz_t* chunk_sizes = arena_push_arr(usz_t, scratch, chunk_count);
+      auto* jobs = arena_push_arr(_zlib_deflate_job_t, scratch, job_count);
+      if (!chunk_sizes || !jobs) return false;
+      u32_t volatile next_chunk = 0;
+      for (u32_t job_index = 0; job_index < job_count; ++job_index) {
+        _zlib_deflate_job_t* job = jobs + job_index;
+        if (!_zlib_deflater_init(&job->d, level, scratch)) return false;
+        job->src = src;
+        job->regions = out;
+        job->chunk_sizes = chunk_sizes;
+        job->chunk_count = chunk_count;
+        job->next_chunk = &next_chunk;
+      }
+      job_counter_t counter = {};
+      for (u32_t job_index = 0; job_index < job_count; ++job_index) {
+        job_add(js, _zlib_deflate_job, jobs + job_index, &counter);
+      }
+      job_wait(js, &counter);
+
+      u8_t* region = out;
+      for (u32_t chunk_index = 0; chunk_index < chunk_count; ++chunk_index) {
+        memory_move(out, region, chunk_sizes[chunk_index]);
+        out += chunk_sizes[chunk_index];
+        region += _zlib_deflate_chunk_bound(_ZLIB_DEFLATE_CHUNK_SIZE);
+      }
+    }
+  }
+
+  u32_t adler = adler32(src.e, src.size);
+  _memory_store_u32(out, u32_endian_swap(adler));
+  out += 4;
+  if (out_size) *out_size = (usz_t)(out - dest.e);
+  return true;
 }
 
 //
@@ -7802,7 +13083,7 @@ ttf_rasterize_glyph(const ttf_t* ttf, u32_t glyph_index, f32_t scale, u32_t* out
     return nullptr;
   }
 
-  pixels = arena_push_arr(u32_t, allocator, size);
+  pixels = arena_push_arr(u32_t, allocator, width * height);
   if (!pixels) {
     //ttf_log("[ttf] Unable to push bitmap pixel\n");
     return nullptr;
@@ -7994,24 +13275,7 @@ ttf_rasterize_glyph(const ttf_t* ttf, u32_t glyph_index, f32_t scale, u32_t* out
 //
 
 // We are only interested in 4-channel images in rgba_t format
-#define _PNG_CHANNELS 4 
-
-
-struct _png_context_t {
-  stream_t stream;
-  arena_t* arena; 
-
-  stream_t image_stream;
-  u32_t image_width;
-  u32_t image_height;
-
-  stream_t unfiltered_image_stream; // for filtering and deflating
-
-  // other useful info
-  u32_t bit_depth;
-
-  stream_t compressed_image_stream;
-};
+#define _PNG_CHANNELS 4 
 
 
 struct _png_chunk_t {
@@ -8059,359 +13323,9 @@ struct _png_idat_header_t {
 };
 
 
-struct _png_huffman_t {
-  // Canonical ordered symbols
-  u16_t* symbols; 
-  u32_t symbol_count;
-
-  // Number of symbols per length
-  // i.e. code_lengths[1] is the number of symbols with length 1.
-  u16_t* lengths;
-  u32_t length_count;
-};
-
-// Modified from Annex D of png_t specification:
-// https://www.w3.org/TR/2003/REC-png_t-20031110/#D-CRCAppendix
-// crc variable indicates the starting register
 static u32_t
 _png_calculate_crc32(u8_t* data, u32_t data_size) {
-static const u32_t crc_table[256] =
-  {
-    0x00000000, 0x77073096, 0xee0e612c, 0x990951ba, 0x076dc419, 0x706af48f, 0xe963a535, 0x9e6495a3,
-    0x0edb8832, 0x79dcb8a4, 0xe0d5e91e, 0x97d2d988, 0x09b64c2b, 0x7eb17cbd, 0xe7b82d07, 0x90bf1d91,
-    0x1db71064, 0x6ab020f2, 0xf3b97148, 0x84be41de, 0x1adad47d, 0x6ddde4eb, 0xf4d4b551, 0x83d385c7,
-    0x136c9856, 0x646ba8c0, 0xfd62f97a, 0x8a65c9ec, 0x14015c4f, 0x63066cd9, 0xfa0f3d63, 0x8d080df5,
-    0x3b6e20c8, 0x4c69105e, 0xd56041e4, 0xa2677172, 0x3c03e4d1, 0x4b04d447, 0xd20d85fd, 0xa50ab56b,
-    0x35b5a8fa, 0x42b2986c, 0xdbbbc9d6, 0xacbcf940, 0x32d86ce3, 0x45df5c75, 0xdcd60dcf, 0xabd13d59,
-    0x26d930ac, 0x51de003a, 0xc8d75180, 0xbfd06116, 0x21b4f4b5, 0x56b3c423, 0xcfba9599, 0xb8bda50f,
-    0x2802b89e, 0x5f058808, 0xc60cd9b2, 0xb10be924, 0x2f6f7c87, 0x58684c11, 0xc1611dab, 0xb6662d3d,
-    0x76dc4190, 0x01db7106, 0x98d220bc, 0xefd5102a, 0x71b18589, 0x06b6b51f, 0x9fbfe4a5, 0xe8b8d433,
-    0x7807c9a2, 0x0f00f934, 0x9609a88e, 0xe10e9818, 0x7f6a0dbb, 0x086d3d2d, 0x91646c97, 0xe6635c01,
-    0x6b6b51f4, 0x1c6c6162, 0x856530d8, 0xf262004e, 0x6c0695ed, 0x1b01a57b, 0x8208f4c1, 0xf50fc457,
-    0x65b0d9c6, 0x12b7e950, 0x8bbeb8ea, 0xfcb9887c, 0x62dd1ddf, 0x15da2d49, 0x8cd37cf3, 0xfbd44c65,
-    0x4db26158, 0x3ab551ce, 0xa3bc0074, 0xd4bb30e2, 0x4adfa541, 0x3dd895d7, 0xa4d1c46d, 0xd3d6f4fb,
-    0x4369e96a, 0x346ed9fc, 0xad678846, 0xda60b8d0, 0x44042d73, 0x33031de5, 0xaa0a4c5f, 0xdd0d7cc9,
-    0x5005713c, 0x270241aa, 0xbe0b1010, 0xc90c2086, 0x5768b525, 0x206f85b3, 0xb966d409, 0xce61e49f,
-    0x5edef90e, 0x29d9c998, 0xb0d09822, 0xc7d7a8b4, 0x59b33d17, 0x2eb40d81, 0xb7bd5c3b, 0xc0ba6cad,
-    0xedb88320, 0x9abfb3b6, 0x03b6e20c, 0x74b1d29a, 0xead54739, 0x9dd277af, 0x04db2615, 0x73dc1683,
-    0xe3630b12, 0x94643b84, 0x0d6d6a3e, 0x7a6a5aa8, 0xe40ecf0b, 0x9309ff9d, 0x0a00ae27, 0x7d079eb1,
-    0xf00f9344, 0x8708a3d2, 0x1e01f268, 0x6906c2fe, 0xf762575d, 0x806567cb, 0x196c3671, 0x6e6b06e7,
-    0xfed41b76, 0x89d32be0, 0x10da7a5a, 0x67dd4acc, 0xf9b9df6f, 0x8ebeeff9, 0x17b7be43, 0x60b08ed5,
-    0xd6d6a3e8, 0xa1d1937e, 0x38d8c2c4, 0x4fdff252, 0xd1bb67f1, 0xa6bc5767, 0x3fb506dd, 0x48b2364b,
-    0xd80d2bda, 0xaf0a1b4c, 0x36034af6, 0x41047a60, 0xdf60efc3, 0xa867df55, 0x316e8eef, 0x4669be79,
-    0xcb61b38c, 0xbc66831a, 0x256fd2a0, 0x5268e236, 0xcc0c7795, 0xbb0b4703, 0x220216b9, 0x5505262f,
-    0xc5ba3bbe, 0xb2bd0b28, 0x2bb45a92, 0x5cb36a04, 0xc2d7ffa7, 0xb5d0cf31, 0x2cd99e8b, 0x5bdeae1d,
-    0x9b64c2b0, 0xec63f226, 0x756aa39c, 0x026d930a, 0x9c0906a9, 0xeb0e363f, 0x72076785, 0x05005713,
-    0x95bf4a82, 0xe2b87a14, 0x7bb12bae, 0x0cb61b38, 0x92d28e9b, 0xe5d5be0d, 0x7cdcefb7, 0x0bdbdf21,
-    0x86d3d2d4, 0xf1d4e242, 0x68ddb3f8, 0x1fda836e, 0x81be16cd, 0xf6b9265b, 0x6fb077e1, 0x18b74777,
-    0x88085ae6, 0xff0f6a70, 0x66063bca, 0x11010b5c, 0x8f659eff, 0xf862ae69, 0x616bffd3, 0x166ccf45,
-    0xa00ae278, 0xd70dd2ee, 0x4e048354, 0x3903b3c2, 0xa7672661, 0xd06016f7, 0x4969474d, 0x3e6e77db,
-    0xaed16a4a, 0xd9d65adc, 0x40df0b66, 0x37d83bf0, 0xa9bcae53, 0xdebb9ec5, 0x47b2cf7f, 0x30b5ffe9,
-    0xbdbdf21c, 0xcabac28a, 0x53b39330, 0x24b4a3a6, 0xbad03605, 0xcdd70693, 0x54de5729, 0x23d967bf,
-    0xb3667a2e, 0xc4614ab8, 0x5d681b02, 0x2a6f2b94, 0xb40bbe37, 0xc30c8ea1, 0x5a05df1b, 0x2d02ef8d,
-  };
-
-  u32_t r = 0xFFFFFFFFL;
-  for (u32_t i = 0; i < data_size; ++i) {
-    r = crc_table[(r ^ data[i]) & 0xFF] ^ (r >> 8);
-  }
-  return r ^ 0xFFFFFFFFL;
-}
-
-
-
-
-static s32_t
-_png_huffman_decode(stream_t* src_stream, _png_huffman_t huffman) {
-  s32_t code = 0;
-  s32_t first = 0;
-  s32_t index = 0;
-
-  for (u32_t len = 1; 
-      len <= huffman.length_count - 1; 
-      ++len) 
-  {
-    u32_t bits = stream_consume_bits(src_stream, 1);
-    code |= bits;
-    s32_t count = huffman.lengths[len];
-    if(code - count < first) {
-      return huffman.symbols[index + (code - first)];
-    }
-    index += count;
-    first += count;
-    first <<= 1;
-    code <<= 1;
-  }
-
-  return -1;
-}
-
-// @note: 
-// https://datatracker.ietf.org/doc/html/rfc1951
-// Section 3.2.2
-static void
-_png_huffman_compute(_png_huffman_t* h,
-    arena_t* arena, 
-    u16_t* codes,
-    u32_t codes_size, 
-    u32_t max_lengths) 
-{
-  // Each code corresponds to a symbol
-  h->symbol_count = codes_size;
-  h->symbols = arena_push_arr(u16_t, arena, codes_size);
-  memory_zero(h->symbols, h->symbol_count * sizeof(u16_t));
-
-
-  // We add +1 because lengths[0] is not possible
-  h->length_count = max_lengths + 1;
-  h->lengths = arena_push_arr(u16_t, arena, max_lengths + 1);
-  memory_zero(h->lengths, h->length_count * sizeof(u16_t));
-
-  // 1. Count the number of codes for each code length
-  for (u32_t sym = 0; sym < codes_size; ++sym)  {
-    u16_t len = codes[sym];
-    ++h->lengths[len];
-  }
-
-  // 2. Numerical value of smallest code for each code length
-  arena_marker_t mark = arena_mark(arena);
-
-  u16_t* len_offset_table = arena_push_arr(u16_t, arena, max_lengths+1);
-  memory_zero(len_offset_table, (max_lengths+1) * sizeof(u16_t));
-
-  for (u32_t len = 1; len < max_lengths; ++len) {
-    len_offset_table[len+1] = len_offset_table[len] + h->lengths[len]; 
-  }
-
-  // 3. Assign numerical values to all codes
-  for (u32_t sym = 0; sym < codes_size; ++sym)
-  {
-    u16_t len = codes[sym];
-    if (len > 0) {
-      u16_t code = len_offset_table[len]++;
-      h->symbols[code] = (u16_t)sym;
-    }
-  }
-  arena_revert(mark); 
-
-}
-
-
-static b32_t
-_png_deflate(stream_t* src_stream, stream_t* dest_stream, arena_t* arena) 
-{
-
-static const u16_t lens[29] = { /* Size base for length codes 257..285 */
-    3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
-    35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
-static const u16_t len_ex_bits[29] = { /* Extra bits for length codes 257..285 */
-    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
-    3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
-static const u16_t dists[30] = { /* Offset base for distance codes 0..29 */
-    1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
-    257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145,
-    8193, 12289, 16385, 24577};
-static const u16_t dist_ex_bits[30] = { /* Extra bits for distance codes 0..29 */
-    0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
-    7, 7, 8, 8, 9, 9, 10, 10, 11, 11,
-    12, 12, 13, 13 };
-
-
-  u8_t BFINAL = 0;
-  while(BFINAL == 0){
-    arena_set_revert_point(arena);
-
-    BFINAL = (u8_t)stream_consume_bits(src_stream, 1);
-    u16_t BTYPE = (u8_t)stream_consume_bits(src_stream, 2);
-    switch(BTYPE) {
-      case 0b00: {
-        stream_flush_bits(src_stream);
-
-        stream_consume_bits(src_stream, 5);
-        u16_t LEN = (u16_t)stream_consume_bits(src_stream, 16);
-        u16_t NLEN = (u16_t)stream_consume_bits(src_stream, 16);
-        if ((u16_t)LEN != ~((u16_t)(NLEN))) {
-          return false; 
-        }
-        // @todo(Momo): support this type?
-        return false;
-      } break;
-      case 0b01: 
-      case 0b10: {
-        _png_huffman_t lit_huffman = {};
-        _png_huffman_t dist_huffman = {};
-
-        if (BTYPE == 0b01) {
-          // Fixed huffman
-          u16_t lit_codes[288] = {};
-          u16_t dist_codes[32] = {};
-
-          u32_t lit = 0;
-          for (; lit < 144; ++lit) {
-            lit_codes[lit] = 8;
-          }
-          for (; lit < 256; ++lit) {
-            lit_codes[lit] = 9;
-          }
-          for (; lit < 280; ++lit) {
-            lit_codes[lit] = 7;
-          }
-          for (; lit < array_count(lit_codes); ++lit) {
-            lit_codes[lit] = 8;
-          }
-          for (lit = 0; lit < array_count(dist_codes); ++lit) {
-            dist_codes[lit] = 5;
-          }
-
-
-          _png_huffman_compute(&lit_huffman,
-              arena, 
-              lit_codes, 
-              array_count(lit_codes),
-              15);
-          _png_huffman_compute(&dist_huffman,
-              arena,
-              dist_codes,
-              array_count(dist_codes),
-              15);
-
-        }
-        else // BTYPE == 0b10
-        {
-          u32_t HLIT = stream_consume_bits(src_stream, 5) + 257;
-          u32_t HDIST = stream_consume_bits(src_stream, 5) + 1;
-          u32_t HCLEN = stream_consume_bits(src_stream, 4) + 4;
-
-        static const u32_t order[] = {
-            16, 17, 18, 0, 8 ,7, 9, 6, 10, 5, 
-            11, 4, 12, 3, 13, 2, 14, 1, 15,
-          };
-
-          u16_t code_codes[19] = {};
-
-          for(u32_t i = 0; i < HCLEN; ++i) {
-            code_codes[order[i]] = (u16_t)stream_consume_bits(src_stream, 3);
-          }
-
-          _png_huffman_t code_huffman = {};
-          _png_huffman_compute(&code_huffman,
-              arena,
-              code_codes,
-              array_count(code_codes),
-              15); 
-
-
-          u16_t* lit_dist_codes = arena_push_arr(u16_t, arena, HDIST + HLIT);
-
-          // @note: Decode
-          // Loop until end of block code recognize
-          for(u32_t i = 0; i < (HDIST + HLIT);) {
-
-            s32_t sym = _png_huffman_decode(src_stream, code_huffman);
-
-            if(sym >= 0 && sym <= 15) {
-              lit_dist_codes[i++] = (u16_t)sym;
-            }
-            else 
-            {	
-              u32_t times_to_repeat = 0;
-              u16_t code_to_repeat = 0;
-              if (sym == 16) {
-                // Copy the previous code length 3-6 times
-                if (i == 0) return false;
-
-                times_to_repeat = 3 + stream_consume_bits(src_stream, 2);
-                code_to_repeat = lit_dist_codes[i-1];
-
-              }
-
-              else if (sym == 17) {
-                // Repeat a code length of 0 for 3-10 times
-                times_to_repeat = 3 + stream_consume_bits(src_stream, 3);
-              }
-              else if (sym == 18) {
-                // Repeat a code length of 0 for 11-138 times
-                times_to_repeat = 11 + stream_consume_bits(src_stream, 7);
-              }
-              else {
-                // Invalid symbol
-                return false;
-              }
-
-              while(times_to_repeat--) {
-                lit_dist_codes[i++] = code_to_repeat;
-              }
-
-            }
-
-          }
-
-          _png_huffman_compute(&lit_huffman,
-              arena, 
-              lit_dist_codes, 
-              HLIT,
-              15);
-          _png_huffman_compute(&dist_huffman,
-              arena,
-              lit_dist_codes + HLIT,
-              HDIST,
-              15);					
-        }
-
-      static int pass =0;
-        ++pass;
-
-        // @note: Actual decoding
-        for (;;) 
-        {
-
-          s32_t sym = _png_huffman_decode(src_stream, lit_huffman);
-          if (pass == 2) {
-            //test_log("%d\n", sym);
-          }
-          //_png_log("sym: %d\n", sym);
-
-          // @note: Normal case
-          if (sym <= 255) { 
-            u8_t byte_to_write = (u8_t)(sym & 0xFF); 
-            stream_write(dest_stream, byte_to_write);
-          }
-          // @note: Extra code case
-          else if (sym >= 257) {
-
-            sym -= 257;
-            if (sym >= 29) {
-              return false;
-            }
-            u32_t len = lens[sym];
-            if (len_ex_bits[sym]) len += stream_consume_bits(src_stream, len_ex_bits[sym]);
-
-            sym = _png_huffman_decode(src_stream, dist_huffman);
-            if (sym < 0) return false;
-
-            u32_t dist = dists[sym];
-            if (dist_ex_bits[sym]) dist += stream_consume_bits(src_stream, dist_ex_bits[sym]);
-
-
-            // test_log("%d\n", len);
-            while(len--) {
-              usz_t target_index = dest_stream->pos - dist;
-              u8_t byte_to_write = dest_stream->contents.e[target_index];
-              stream_write(dest_stream, byte_to_write);
-            }
-          }
-          else { 
-            // sym == 256
-            break;
-          }
-        }
-      } break;
-      default: {
-        return false;
-      }
-    }
-  }
-  return true;
+  return crc32_ieee(data, data_size);
 }
 
 
@@ -8475,319 +13389,399 @@ static const u8_t signature[] = {
 }
 
 //~ @note: Filtering
-static b32_t
-_png_filter_none(_png_context_t* c) {
-  u32_t bpl = c->image_width * _PNG_CHANNELS; // bytes per line
-  for (u32_t i = 0; i < bpl; ++i ){
-    u8_t* pixel_byte = stream_consume(u8_t, &c->unfiltered_image_stream);
-    if (pixel_byte == nullptr) {
-      return false;
-    }
-    stream_write(&c->image_stream, *pixel_byte);
-  }
-  return true;
-}
-
-static b32_t
-_png_filter_sub(_png_context_t* c) {
-  u32_t bpp = _PNG_CHANNELS; // bytes per pixel
-  u32_t bpl = c->image_width * _PNG_CHANNELS; // bytes per line
-  for (u32_t i = 0; i < bpl; ++i ){
-
-    u8_t* pixel_byte_p = stream_consume(u8_t, &c->unfiltered_image_stream);
-    if (pixel_byte_p == nullptr)return false;
-
-    u8_t pixel_byte = (*pixel_byte_p); // sub(x)
-    if (i < bpp) {
-      stream_write(&c->image_stream, pixel_byte);
-    }
-    else {
-      usz_t current_index = c->image_stream.pos;
-      u8_t left_reference = c->image_stream.contents.e[current_index - bpp]; // Raw(x-bpp)
-      u8_t pixel_byte_to_write = (pixel_byte + left_reference) % 256;  
-
-      stream_write(&c->image_stream, pixel_byte_to_write);
-    }
-
-  }    
+// https://www.w3.org/TR/PNG-Filters.html
+//
+// Each row is undone against the row above it, 'prior', which is all
+// zeros for the first row.
 
-  return true;
+// @note: Returns whichever of left (a), top (b) and top left (c) is nearest
+// to a + b - c, breaking ties in that order.
+static u8_t
+_png_paeth_predictor(s32_t a, s32_t b, s32_t c) {
+  s32_t p = a + b - c;
+  s32_t pa = s32_abs(p - a);
+  s32_t pb = s32_abs(p - b);
+  s32_t pc = s32_abs(p - c);
+  if (pa <= pb && pa <= pc) return (u8_t)a;
+  if (pb <= pc) return (u8_t)b;
+  return (u8_t)c;
+}
+
+#if MOMO_SSE2
+// @note: _png_paeth_predictor() for 8 bytes in 16-bit lanes, as a + b - c
+// needs more than 8 bits. With p = a + b - c, the distances are:
+//   |p - a| = |b - c|, |p - b| = |a - c|, |p - c| = |(a - c) + (b - c)|
+// AVX2 targets have SSSE3's abs and SSE4.1's blend.
+static inline __m128i
+_png_paeth_predictor_sse2(__m128i a, __m128i b, __m128i c) {
+  __m128i pa = _mm_sub_epi16(b, c);
+  __m128i pb = _mm_sub_epi16(a, c);
+  __m128i pc = _mm_add_epi16(pa, pb);
+# if MOMO_AVX2
+  pa = _mm_abs_epi16(pa);
+  pb = _mm_abs_epi16(pb);
+  pc = _mm_abs_epi16(pc);
+# else
+  const __m128i zero = _mm_setzero_si128();
+  pa = _mm_max_epi16(pa, _mm_sub_epi16(zero, pa));
+  pb = _mm_max_epi16(pb, _mm_sub_epi16(zero, pb));
+  pc = _mm_max_epi16(pc, _mm_sub_epi16(zero, pc));
+# endif
+  __m128i smallest = _mm_min_epi16(pc, _mm_min_epi16(pa, pb));
+
+  // Ties go to a, then b, then c
+  __m128i is_a = _mm_cmpeq_epi16(smallest, pa);
+  __m128i is_b = _mm_cmpeq_epi16(smallest, pb);
+# if MOMO_AVX2
+  __m128i nearest = _mm_blendv_epi8(c, b, is_b);
+  return _mm_blendv_epi8(nearest, a, is_a);
+# else
+  __m128i nearest = _mm_or_si128(_mm_and_si128(is_b, b), _mm_andnot_si128(is_b, c));
+  return _mm_or_si128(_mm_and_si128(is_a, a), _mm_andnot_si128(is_a, nearest));
+# endif
 }
+#endif
 
-static b32_t
-_png_filter_average(_png_context_t* c) {
-  u32_t bpp = _PNG_CHANNELS; // bytes per pixel
-  u32_t bpl = c->image_width * _PNG_CHANNELS; // bytes per line
-
-  for (u32_t i = 0; i < bpl; ++i ){
-
-    u8_t* pixel_byte_p = stream_consume(u8_t, &c->unfiltered_image_stream);
-    if (pixel_byte_p == nullptr) return false;
-
-    u8_t pixel_byte = (*pixel_byte_p); // sub(x)
-
-    usz_t current_index = c->image_stream.pos;
-    u8_t left = (i < bpp) ? 0 :  c->image_stream.contents.e[current_index - bpp]; // Raw(x-bpp)
-    u8_t top = (current_index < bpl) ? 0 : c->image_stream.contents.e[current_index - bpl]; // Prior(x)
-
-    // @note: Formula uses floor((left+top)/2). 
-    // Integer Truncation should do the job!
-    u8_t pixel_byte_to_write = (pixel_byte + (left + top)/2) % 256;  
-
-    stream_write(&c->image_stream, pixel_byte_to_write);
+// @note: Filters use the bytes of the pixel to the left, so the vector
+// versions below work on 4 byte pixels. The bytes that do not fill a
+// whole vector are done one at a time.
+static void
+_png_unfilter_sub(const u8_t* src, u8_t* dest, u32_t bpl) {
+  const u32_t bpp = _PNG_CHANNELS; // bytes per pixel
+  u32_t i = 0;
+#if MOMO_SSE2
+  // @note: Each pixel is a running sum of the pixels up to it. For 4 of
+  // them that is two shifted adds, then the sum so far is added on.
+  __m128i last = _mm_setzero_si128();
+  for (; i + 16 <= bpl; i += 16) {
+    __m128i x = _mm_loadu_si128((const __m128i*)(src + i));
+    x = _mm_add_epi8(x, _mm_slli_si128(x, 4));
+    x = _mm_add_epi8(x, _mm_slli_si128(x, 8));
+    x = _mm_add_epi8(x, last);
+    _mm_storeu_si128((__m128i*)(dest + i), x);
+    last = _mm_shuffle_epi32(x, _MM_SHUFFLE(3, 3, 3, 3));
+  }
+#endif
+  for (; i < bpp && i < bpl; ++i) {
+    dest[i] = src[i];
+  }
+  for (; i < bpl; ++i) {
+    dest[i] = (u8_t)(src[i] + dest[i - bpp]);
   }
-
-
-  return true;
 }
 
-static b32_t
-_png_filter_paeth(_png_context_t* cx) {
-  u32_t bpp = _PNG_CHANNELS; // bytes per pixel
-  u32_t bpl = cx->image_width * _PNG_CHANNELS; // bytes per line
-
-  for (u32_t i = 0; i < bpl; ++i ){
-    u8_t* pixel_byte_p = stream_consume(u8_t, &cx->unfiltered_image_stream);
-    if (pixel_byte_p == nullptr) return false;
-    u8_t pixel_byte = (*pixel_byte_p); // Paeth(x)
-
-    // @note: PaethPredictor
-    // https://www.w3.org/TR/png_t-Filters.html
-    u8_t paeth_predictor; 
-    {
-      usz_t current_index = cx->image_stream.pos;
-
-      // respectively: left, top, top left
-      s32_t a, b, c;
-
-      a = (i < bpp) ? 0 : (s32_t)(cx->image_stream.contents.e[current_index - bpp]); // Raw(x-bpp)
-      b = (current_index < bpl) ? 0 : (s32_t)(cx->image_stream.contents.e[current_index - bpl]); // Prior(x)
-      c = (i < bpp || current_index < bpl) ? 0 : (s32_t)(cx->image_stream.contents.e[current_index - bpl - bpp]); // Prior(x)
-
-      s32_t p = a + b - c; //initial estimate
-      s32_t pa = s32_abs(p - a);
-      s32_t pb = s32_abs(p - b);
-      s32_t pc = s32_abs(p - c);
-      // Return nearest of a,b,c
-      // breaking ties in order a, b,c
-      if (pa <= pb && pa <= pc) {
-        paeth_predictor = (u8_t)a;
-      }
-      else if (pb <= pc) {
-        paeth_predictor = (u8_t)b;
-      }
-      else {
-        paeth_predictor = (u8_t)c;
-      }
-    }
+static void
+_png_unfilter_up(const u8_t* src, const u8_t* prior, u8_t* dest, u32_t bpl) {
+  u32_t i = 0;
+#if MOMO_AVX2
+  for (; i + 32 <= bpl; i += 32) {
+    __m256i x = _mm256_loadu_si256((const __m256i*)(src + i));
+    __m256i b = _mm256_loadu_si256((const __m256i*)(prior + i));
+    _mm256_storeu_si256((__m256i*)(dest + i), _mm256_add_epi8(x, b));
+  }
+#endif
+#if MOMO_SSE2
+  for (; i + 16 <= bpl; i += 16) {
+    __m128i x = _mm_loadu_si128((const __m128i*)(src + i));
+    __m128i b = _mm_loadu_si128((const __m128i*)(prior + i));
+    _mm_storeu_si128((__m128i*)(dest + i), _mm_add_epi8(x, b));
+  }
+#endif
+  for (; i < bpl; ++i) {
+    dest[i] = (u8_t)(src[i] + prior[i]);
+  }
+}
 
-    u8_t pixel_byte_to_write = (pixel_byte + paeth_predictor)%256;  
+static void
+_png_unfilter_average(const u8_t* src, const u8_t* prior, u8_t* dest, u32_t bpl) {
+  const u32_t bpp = _PNG_CHANNELS; // bytes per pixel
+  u32_t i = 0;
+#if MOMO_SSE2
+  // @note: Rounding down makes this no sum, so it goes a pixel at a time.
+  // _mm_avg_epu8() rounds up, so the low bit of a ^ b is taken off.
+  const __m128i one = _mm_set1_epi8(1);
+  __m128i a = _mm_setzero_si128();
+  for (; i + 4 <= bpl; i += 4) {
+    __m128i b = _mm_cvtsi32_si128((s32_t)_memory_load_u32(prior + i));
+    __m128i x = _mm_cvtsi32_si128((s32_t)_memory_load_u32(src + i));
+    __m128i avg = _mm_sub_epi8(_mm_avg_epu8(a, b), _mm_and_si128(_mm_xor_si128(a, b), one));
+    a = _mm_add_epi8(x, avg);
+    _memory_store_u32(dest + i, (u32_t)_mm_cvtsi128_si32(a));
+  }
+#endif
+  for (; i < bpp && i < bpl; ++i) {
+    dest[i] = (u8_t)(src[i] + (prior[i] >> 1));
+  }
+  for (; i < bpl; ++i) {
+    dest[i] = (u8_t)(src[i] + ((dest[i - bpp] + prior[i]) >> 1));
+  }
+}
 
-    stream_write(&cx->image_stream, pixel_byte_to_write);
+static void
+_png_unfilter_paeth(const u8_t* src, const u8_t* prior, u8_t* dest, u32_t bpl) {
+  const u32_t bpp = _PNG_CHANNELS; // bytes per pixel
+  u32_t i = 0;
+#if MOMO_SSE2
+  // @note: One pixel at a time, as each depends on the one to its left.
+  const __m128i zero = _mm_setzero_si128();
+  __m128i a = zero;
+  __m128i c = zero;
+  for (; i + 4 <= bpl; i += 4) {
+    __m128i b = _mm_unpacklo_epi8(_mm_cvtsi32_si128((s32_t)_memory_load_u32(prior + i)), zero);
+    __m128i x = _mm_cvtsi32_si128((s32_t)_memory_load_u32(src + i));
+    __m128i nearest = _png_paeth_predictor_sse2(a, b, c);
+    x = _mm_add_epi8(x, _mm_packus_epi16(nearest, nearest));
+    _memory_store_u32(dest + i, (u32_t)_mm_cvtsi128_si32(x));
+
+    a = _mm_unpacklo_epi8(x, zero);
+    c = b;
+  }
+#endif
+  for (; i < bpp && i < bpl; ++i) {
+    dest[i] = (u8_t)(src[i] + prior[i]);
+  }
+  for (; i < bpl; ++i) {
+    dest[i] = (u8_t)(src[i] + _png_paeth_predictor(dest[i - bpp], prior[i], prior[i - bpp]));
   }
-  return true;
 }
 
 static b32_t
-_png_filter_up(_png_context_t* c) {
-  u32_t bpl = c->image_width * _PNG_CHANNELS; // bytes per line
-  for (u32_t i = 0; i < bpl; ++i ){
-    u8_t* pixel_byte_p = stream_consume(u8_t, &c->unfiltered_image_stream);
-    if (pixel_byte_p == nullptr) {
+_png_unfilter_row(u32_t filter_type, const u8_t* src, const u8_t* prior, u8_t* dest, u32_t bpl) {
+  switch(filter_type) {
+    case 0: { // None
+      memory_copy(dest, src, bpl);
+    } break;
+    case 1: { // Sub
+      _png_unfilter_sub(src, dest, bpl);
+    } break;
+    case 2: { // Up
+      _png_unfilter_up(src, prior, dest, bpl);
+    } break;
+    case 3: { // Average, of left and top rounded down
+      _png_unfilter_average(src, prior, dest, bpl);
+    } break;
+    case 4: { // Paeth, which is just top with nothing on the left
+      _png_unfilter_paeth(src, prior, dest, bpl);
+    } break;
+    default: {
       return false;
     }
-    u8_t pixel_byte = (*pixel_byte_p); // Up(x)
-
-    // @note: Ignore first scanline
-    if (c->image_stream.pos < bpl) {
-      stream_write(&c->image_stream, pixel_byte);
-    }
-    else {
-      usz_t current_index = c->image_stream.pos;
-      u8_t top = c->image_stream.contents.e[current_index - bpl]; 
-      u8_t pixel_byte_to_write = (pixel_byte + top) % 256;  
-
-      stream_write(&c->image_stream, pixel_byte_to_write);
-    }
   }
-
   return true;
 }
 
-
+// @note: Hands the inflater the data of the next IDAT chunk, so that the
+// IDATs never need to be joined up. 'user' is a stream over the file.
 static b32_t
-_png_filter(_png_context_t* c) {
-
-  stream_reset(&c->unfiltered_image_stream);
-
-  // @note: Filter
-  // data always starts with 1 byte indicating the type of filter
-  // followed by the rest of the chunk.
-  while(!stream_is_eos(&c->unfiltered_image_stream)) {
-    u8_t* filter_type_p = stream_consume(u8_t, &c->unfiltered_image_stream);
-    u8_t filter_type = (*filter_type_p);
-    // @note: https://www.w3.org/TR/png_t-Filters.html
-    switch(filter_type) {
-      case 0: { // None
-        if (!_png_filter_none(c)) return false;
-      } break;
-      case 1: { // Sub
-        if (!_png_filter_sub(c)) return false;
-      } break;
-      case 2: {
-        if (!_png_filter_up(c)) return false;
-      } break;
-      case 3: {
-        if (!_png_filter_average(c)) return false;
-      } break;
-      case 4: {
-        if (!_png_filter_paeth(c)) return false;
-      } break;
-      default: {
-        return false;
-      };
-    };
+_png_next_idat(void* user, const u8_t** next, const u8_t** end) {
+  stream_t* stream = (stream_t*)user;
+  while(!stream_is_eos(stream)) {
+    _png_chunk_header_t* chunk_header = stream_consume(_png_chunk_header_t, stream);
+    if (!chunk_header) return false;
+    u32_t chunk_length = u32_endian_swap(chunk_header->length);
+    u32_t chunk_type = u32_endian_swap(chunk_header->type_U32);
+    u8_t* chunk_data = stream_consume_block(stream, chunk_length);
+    if (!chunk_data) return false;
+    stream_consume(_png_chunk_footer_t, stream);
+    if (chunk_type == 'IDAT') {
+      *next = chunk_data;
+      *end = chunk_data + chunk_length;
+      return true;
+    }
   }
-  return true;
-
+  return false;
 }
 
+// @note: Inflating goes into a small window rather than a buffer for the
+// whole filtered image. It holds what matches can still reach back to, the
+// row waiting to be unfiltered, and this much room to inflate into.
+#define _PNG_INFLATE_ROOM kilobytes(64)
+
+// @note(momo): For the code here, we are going to assume that 
+// the PNG file we are reading is correct. i.e. we don't emphasize on 
+// checking correctness of the PNG outside of the most basic of checks (e.g. sig)
 static b32_t
-_png_decompress_zlib(_png_context_t* c, stream_t* zlib_stream) {
-  _png_idat_header_t* IDAT = stream_consume(_png_idat_header_t, zlib_stream);
+png_rasterize_into_buffer(png_t* png, u8_t* dest, u32_t pitch, arena_t* scratch) 
+{
+  u32_t bpl = png->width * _PNG_CHANNELS; // bytes per line
+  usz_t row_size = (usz_t)bpl + 1; // and the filter type in front
+  if (pitch == 0) pitch = bpl;
 
-  u32_t CM = IDAT->compression_flags & 0x0F;
-  u32_t CINFO = IDAT->compression_flags >> 4;
-  //u32_t FCHECK = IDAT->additional_flags & 0x1F; //not needed?
-  u32_t FDICT = (IDAT->additional_flags >> 5) & 0x01;
-  //u32_t FLEVEL = (IDAT->additional_flags >> 6); //useless?
+  arena_set_revert_point(scratch);
+  usz_t window_size = _ZLIB_WINDOW_SIZE + row_size + _PNG_INFLATE_ROOM;
+  u8_t* window = arena_push_arr(u8_t, scratch, window_size);
+  u8_t* zero_row = arena_push_arr_zero(u8_t, scratch, row_size);
+  _zlib_inflater_t* z = arena_push(_zlib_inflater_t, scratch);
+  if (!window || !zero_row || !z) return false;
+
+  stream_t stream;
+  stream_init(&stream, png->contents);
+  stream_consume(_png_chunk_t, &stream);
+
+  _zlib_inflater_init(z, nullptr, 0);
+  z->in.next_piece = _png_next_idat;
+  z->in.user = &stream;
+  if (!_zlib_read_header(&z->in)) return false;
+
+  u8_t* out = window;
+  u8_t* row = window; // the next row to unfilter
+  u32_t y = 0;
+  u32_t adler = adler32(nullptr, 0);
+  for (;;) {
+    u8_t* start = out;
+    _zlib_status_t status = _zlib_inflate(z, window, &out, window + window_size, _ZLIB_PAUSE_ROOM);
+    if (status == _ZLIB_STATUS_BAD) return false;
+    adler = adler32(start, (usz_t)(out - start), adler);
 
+    for (; (usz_t)(out - row) >= row_size; row += row_size, ++y) {
+      if (y == png->height) return false;
+      u8_t* dest_row = dest + (usz_t)y * pitch;
+      const u8_t* prior = y ? dest_row - pitch : zero_row;
+      if (!_png_unfilter_row(row[0], row + 1, prior, dest_row, bpl)) return false;
+    }
+    if (status == _ZLIB_STATUS_DONE) break;
 
-  if (CM != 8 || FDICT != 0 || CINFO > 7) {
-    return false;
+    // Out of room. Slide what is still needed back to the start.
+    usz_t history = min_of((usz_t)(out - window), (usz_t)_ZLIB_WINDOW_SIZE);
+    u8_t* keep = min_of(row, out - history);
+    usz_t shift = (usz_t)(keep - window);
+    memory_move(window, keep, (usz_t)(out - keep));
+    out -= shift;
+    row -= shift;
   }
 
-  return _png_deflate(zlib_stream, &c->unfiltered_image_stream, c->arena);
+  // Every row must be there, and nothing more
+  if (y != png->height || out != row) return false;
+  return _zlib_check_trailer(&z->in, adler);
 }
 
-
-// @note(momo): For the code here, we are going to assume that 
-// the PNG file we are reading is correct. i.e. we don't emphasize on 
-// checking correctness of the PNG outside of the most basic of checks (e.g. sig)
-//
-// @todo(momo): We should have a png_rasterize_into_buffer that directly rasterizes
-// into a buffer (or a img struct?)
 static u32_t* 
 png_rasterize(png_t* png, u32_t* out_w, u32_t* out_h, arena_t* arena) 
 {
-  stream_t zlib_stream;
-
-  _png_context_t ctx = {0};
-  ctx.arena = arena;
-  stream_init(&ctx.stream, png->contents);
-  ctx.image_width = png->width;
-  ctx.image_height = png->height;
-  ctx.bit_depth = png->bit_depth;
-
   u32_t image_size = png->width * png->height * _PNG_CHANNELS;
   buf_t image_buffer =  arena_push_buffer(arena, image_size, 32);
   if (!buf_valid(image_buffer)) return nullptr;
-  stream_init(&ctx.image_stream, image_buffer);
-
-  //arena_marker_t mark = arena_mark(arena);
-  arena_set_revert_point(arena);
 
-  u32_t unfiltered_size = png->width * png->height * _PNG_CHANNELS + png->height;
-  buf_t unfiltered_image_buffer = arena_push_buffer(arena, unfiltered_size);
-  if (!buf_valid(unfiltered_image_buffer)) return nullptr;
-  stream_init(&ctx.unfiltered_image_stream, unfiltered_image_buffer);
-
-  stream_consume(_png_chunk_t, &ctx.stream);
-
-  // @note: This is really lousy method.
-  // We will go through all the IDATs and push a giant contiguous 
-  // chunk of memory to DEFLATE.
-  usz_t zlib_size = 0;
-  {
-    stream_t stream = ctx.stream;
-    while(!stream_is_eos(&stream)) {
-      _png_chunk_header_t* chunk_header = stream_consume(_png_chunk_header_t, &stream);
-      if (!chunk_header) return nullptr;
-      u32_t chunk_length = u32_endian_swap(chunk_header->length);
-      u32_t chunk_type = u32_endian_swap(chunk_header->type_U32);
-      if (chunk_type == 'IDAT') {
-        zlib_size += chunk_length;
-      }
-      stream_consume_block(&stream, chunk_length);
-      stream_consume(_png_chunk_footer_t, &stream);
-    }
+  if (!png_rasterize_into_buffer(png, image_buffer.e, 0, arena)) {
+    return nullptr;
   }
 
-  buf_t zlib_data = arena_push_buffer(arena, zlib_size);
-  if (!buf_valid(zlib_data)) return nullptr;
-
-  stream_init(&zlib_stream, zlib_data);
-
-  // Second pass to push memory
-  while(!stream_is_eos(&ctx.stream)) {
-    _png_chunk_header_t* chunk_header = stream_consume(_png_chunk_header_t, &ctx.stream);
-    if (!chunk_header) return nullptr;
-    u32_t chunk_length = u32_endian_swap(chunk_header->length);
-    u32_t chunk_type = u32_endian_swap(chunk_header->type_U32);
-    if (chunk_type == 'IDAT') {
-      stream_write_block(&zlib_stream, 
-          ctx.stream.contents.e + ctx.stream.pos,
-          chunk_length);
-    }
-    stream_consume_block(&ctx.stream, chunk_length);
-    stream_consume(_png_chunk_footer_t, &ctx.stream);
-  }
-  stream_reset(&zlib_stream);
+  if (out_w) (*out_w) = png->width;
+  if (out_h) (*out_h) = png->height;
+  return (u32_t*)image_buffer.e;
+}
 
-  if (!_png_decompress_zlib(&ctx, &zlib_stream)) {
-    return nullptr;
+// @note: Filters a row the way png_write() stores it, with the filter
+// type in front. 'prior' is the row above, all zeros for the first row.
+// Unlike unfiltering, every input is known up front, so the vector
+// versions do 16 bytes at a time after the first pixel.
+static void
+_png_filter_row(u32_t filter_type, const u8_t* src, const u8_t* prior, u8_t* dest, u32_t bpl) {
+  const u32_t bpp = _PNG_CHANNELS; // bytes per pixel
+  dest[0] = (u8_t)filter_type;
+  ++dest;
+  u32_t i = 0;
+  switch(filter_type) {
+    case 0: { // None
+      memory_copy(dest, src, bpl);
+    } break;
+    case 1: { // Sub
+      for (; i < bpp && i < bpl; ++i) dest[i] = src[i];
+#if MOMO_SSE2
+      for (; i + 16 <= bpl; i += 16) {
+        __m128i x = _mm_loadu_si128((const __m128i*)(src + i));
+        __m128i a = _mm_loadu_si128((const __m128i*)(src + i - bpp));
+        _mm_storeu_si128((__m128i*)(dest + i), _mm_sub_epi8(x, a));
+      }
+#endif
+      for (; i < bpl; ++i) dest[i] = (u8_t)(src[i] - src[i - bpp]);
+    } break;
+    case 2: { // Up
+#if MOMO_SSE2
+      for (; i + 16 <= bpl; i += 16) {
+        __m128i x = _mm_loadu_si128((const __m128i*)(src + i));
+        __m128i b = _mm_loadu_si128((const __m128i*)(prior + i));
+        _mm_storeu_si128((__m128i*)(dest + i), _mm_sub_epi8(x, b));
+      }
+#endif
+      for (; i < bpl; ++i) dest[i] = (u8_t)(src[i] - prior[i]);
+    } break;
+    case 3: { // Average
+      for (; i < bpp && i < bpl; ++i) dest[i] = (u8_t)(src[i] - (prior[i] >> 1));
+#if MOMO_SSE2
+      const __m128i one = _mm_set1_epi8(1);
+      for (; i + 16 <= bpl; i += 16) {
+        __m128i x = _mm_loadu_si128((const __m128i*)(src + i));
+        __m128i a = _mm_loadu_si128((const __m128i*)(src + i - bpp));
+        __m128i b = _mm_loadu_si128((const __m128i*)(prior + i));
+        __m128i avg = _mm_sub_epi8(_mm_avg_epu8(a, b), _mm_and_si128(_mm_xor_si128(a, b), one));
+        _mm_storeu_si128((__m128i*)(dest + i), _mm_sub_epi8(x, avg));
+      }
+#endif
+      for (; i < bpl; ++i) dest[i] = (u8_t)(src[i] - ((src[i - bpp] + prior[i]) >> 1));
+    } break;
+    case 4: { // Paeth
+      for (; i < bpp && i < bpl; ++i) dest[i] = (u8_t)(src[i] - prior[i]);
+#if MOMO_SSE2
+      const __m128i zero = _mm_setzero_si128();
+      for (; i + 16 <= bpl; i += 16) {
+        __m128i x = _mm_loadu_si128((const __m128i*)(src + i));
+        __m128i a = _mm_loadu_si128((const __m128i*)(src + i - bpp));
+        __m128i b = _mm_loadu_si128((const __m128i*)(prior + i));
+        __m128i c = _mm_loadu_si128((const __m128i*)(prior + i - bpp));
+        __m128i lo = _png_paeth_predictor_sse2(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero), _mm_unpacklo_epi8(c, zero));
+        __m128i hi = _png_paeth_predictor_sse2(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero), _mm_unpackhi_epi8(c, zero));
+        _mm_storeu_si128((__m128i*)(dest + i), _mm_sub_epi8(x, _mm_packus_epi16(lo, hi)));
+      }
+#endif
+      for (; i < bpl; ++i) dest[i] = (u8_t)(src[i] - _png_paeth_predictor(src[i - bpp], prior[i], prior[i - bpp]));
+    } break;
   }
+}
 
-  if(!_png_filter(&ctx)) {					
-    return nullptr;
+// @note: The sum of the bytes as signed values, which is how libpng picks
+// filters: rows closer to zero tend to compress better. For a byte x,
+// min(x, -x) as unsigned bytes is |x| as a signed one.
+static u64_t
+_png_filter_score(const u8_t* p, u32_t size) {
+  u64_t score = 0;
+  u32_t i = 0;
+#if MOMO_SSE2
+  __m128i zero = _mm_setzero_si128();
+  __m128i sums = zero;
+  for (; i + 16 <= size; i += 16) {
+    __m128i x = _mm_loadu_si128((const __m128i*)(p + i));
+    sums = _mm_add_epi64(sums, _mm_sad_epu8(_mm_min_epu8(x, _mm_sub_epi8(zero, x)), zero));
+  }
+  score = (u64_t)_mm_cvtsi128_si32(sums) + (u64_t)_mm_cvtsi128_si32(_mm_srli_si128(sums, 8));
+#endif
+  for (; i < size; ++i) {
+    score += p[i] < 128 ? p[i] : 256 - p[i];
   }
-
-  if (out_w) (*out_w) = ctx.image_width;
-  if (out_h) (*out_h) = ctx.image_height;
-  return (u32_t*)ctx.image_stream.contents.e;
-
-
+  return score;
 }
-// @note: Really dumb way to write.
-// Just have a IHDR, IEND and a single IDAT that's not encoded lul
+
+// @note: Writes an IHDR, a single IDAT and an IEND. Each row gets the
+// filter that scores best in _png_filter_score(), except at level 0,
+// where every row is left unfiltered and stored.
 static buf_t
-png_write(u32_t* pixels, u32_t width, u32_t height, arena_t* arena) {
+png_write(u32_t* pixels, u32_t width, u32_t height, arena_t* arena, u32_t level, job_system_t* js) {
 static const u8_t signature[] = { 
     137, 80, 78, 71, 13, 10, 26, 10 
   };
   u32_t image_bpl = (width * 4);
   u32_t data_bpl = image_bpl + 1; // bytes per line
-  u32_t data_size = data_bpl * height;
-  u32_t max_chunk_size = 65535;
-  u32_t signature_size = sizeof(signature);
-  u32_t chunk_size = sizeof(_png_chunk_header_t) + sizeof(_png_chunk_footer_t);
-  u32_t IHDR_size = chunk_size + sizeof(_png_ihdr_t);
-  u32_t IEND_size = chunk_size;
-  u32_t IDAT_size = chunk_size + sizeof(_png_idat_header_t);
-  u32_t lines_per_chunk = max_chunk_size / data_bpl;
-  u32_t chunk_count = height / lines_per_chunk;
-
-  if (height % lines_per_chunk) {
-    chunk_count += 1;
-  }
-  u32_t IDAT_chunk_size = 5 * chunk_count;
-
-  u32_t expected_memory_required = (signature_size + 
+  usz_t data_size = (usz_t)data_bpl * height;
+  usz_t signature_size = sizeof(signature);
+  usz_t chunk_size = sizeof(_png_chunk_header_t) + sizeof(_png_chunk_footer_t);
+  usz_t IHDR_size = chunk_size + sizeof(_png_ihdr_t);
+  usz_t IEND_size = chunk_size;
+  usz_t IDAT_size = chunk_size + zlib_deflate_bound(data_size);
+
+  usz_t expected_memory_required = (signature_size + 
       IHDR_size + 
       IEND_size + 
-      IDAT_size + 
-      data_size + 
-      IDAT_chunk_size);
+      IDAT_size);
 
   buf_t stream_memory = arena_push_buffer(arena, expected_memory_required);
   if (!buf_valid(stream_memory)) return buf_bad();
@@ -8827,71 +13821,45 @@ static const u8_t signature[] = {
   }
 
   // @note: write IDAT
-  // @todo(Momo): Adler32
   {
-
-    u32_t chunk_overhead = sizeof(u16_t)*2 + sizeof(u8_t)*1;
-
-    u8_t* crc_start = nullptr;
+    arena_set_revert_point(arena);
+    u8_t* data = arena_push_arr(u8_t, arena, data_size);
+    u8_t* zero_row = arena_push_arr_zero(u8_t, arena, data_bpl);
+    u8_t* trial_row = arena_push_arr(u8_t, arena, data_bpl);
+    if (!data || !zero_row || !trial_row) return buf_bad();
+
+    const u8_t* prior = zero_row;
+    for (u32_t y = 0; y < height; ++y) {
+      const u8_t* row = (const u8_t*)pixels + (usz_t)y * image_bpl;
+      u8_t* best_row = data + (usz_t)y * data_bpl;
+      _png_filter_row(0, row, prior, best_row, image_bpl);
+      if (level > 0) {
+        u64_t best_score = _png_filter_score(best_row + 1, image_bpl);
+        for (u32_t filter_type = 1; filter_type <= 4; ++filter_type) {
+          _png_filter_row(filter_type, row, prior, trial_row, image_bpl);
+          u64_t score = _png_filter_score(trial_row + 1, image_bpl);
+          if (score < best_score) {
+            best_score = score;
+            memory_copy(best_row, trial_row, data_bpl);
+          }
+        }
+      }
+      prior = row;
+    }
 
     _png_chunk_header_t header = {};
     header.type_U32 = u32_endian_swap('IDAT');
-    header.length = sizeof(_png_idat_header_t) + (chunk_overhead*chunk_count) + data_size; 
-    header.length = u32_endian_swap(header.length);    
     stream_write(&stream, header);
-    crc_start = stream.contents.e + stream.pos - sizeof(header.type_U32);
-
-    // @note: Hardcoded IDAT chunk header header that fits our use-case
-    //
-    // CM = 8
-    // CINFO = any number < 7? 1?
-    // FCHECK = 23? if CM == 8 and CINFO == 1
-    // FDIC = 0;
-    // FLEVEL = 1? Documentation says it doesn't matter;
-    _png_idat_header_t IDAT;
-    IDAT.compression_flags = 8;
-    IDAT.additional_flags = 29;
-    stream_write(&stream, IDAT);
-
-
-    // @note: Deflate chunk header
-    //
-    // BFINAL = 1 (1 bit); // indicates if it's the final block
-    // BTYPE = 0 (2 bits); // indicates no compression
-    // 
-    u32_t lines_remaining = height;
-    u32_t current_line = 0;
-
-    for (u32_t chunk_index = 0; chunk_index < chunk_count; ++chunk_index){
-      u32_t lines_to_write = min_of(lines_remaining, lines_per_chunk);
-      lines_remaining -= lines_to_write;
-
-      u8_t BFINAL = ((chunk_index + 1) == chunk_count) ? 1 : 0;
-      stream_write(&stream, BFINAL);
-
-      u16_t LEN = (u16_t)(lines_to_write * data_bpl); // number of data bytes in the block
-      u16_t NLEN = ~LEN; // one's complement of LEN
-      stream_write(&stream, LEN);
-      stream_write(&stream, NLEN);
-
-      // @note: Output data here
-      // We have to do it row by row to add the filter byte at the front
-      for (u32_t line_index = 0; line_index < lines_to_write; ++line_index) 
-      {
-        u8_t no_filter = 0;
-        stream_write(&stream, no_filter); // Filter type: None
-
-        stream_write_block(&stream,
-            (u8_t*)pixels + (current_line * image_bpl),
-            image_bpl);
-
-        ++current_line;
-
-      }
-
+    u8_t* header_start = stream.contents.e + stream.pos - sizeof(header);
+    u8_t* crc_start = stream.contents.e + stream.pos - sizeof(header.type_U32);
 
+    buf_t idat = buf_set(stream.contents.e + stream.pos, zlib_deflate_bound(data_size));
+    usz_t idat_size = 0;
+    if (!zlib_deflate(idat, buf_set(data, data_size), level, arena, &idat_size, js)) {
+      return buf_bad();
     }
-
+    stream.pos += idat_size;
+    _memory_store_u32(header_start, u32_endian_swap((u32_t)idat_size));
 
     _png_chunk_footer_t footer = {};
     u32_t crc_size = (u32_t)(stream.contents.e + stream.pos - crc_start);
@@ -9086,7 +14054,7 @@ arena_push_size(arena_t* a, usz_t size, usz_t align) {
   usz_t imem = ptr_to_umi(a->memory);
   umi_t adjusted_pos = align_up_pow2(imem + a->pos, align) - imem;
 
-  if (imem + adjusted_pos + size >= imem + a->cap) {
+  if (adjusted_pos + size > a->cap) {
     return nullptr;
   }
 
@@ -74,6 +74,8 @@ enum pass_pack_atlas_context_type_t {
 struct pass_pack_atlas_font_glyph_context_t {
   struct pass_pack_atlas_font_t* font;
   u32_t codepoint;
+  u32_t ttf_glyph_index;
+  u32_t* pixels; // rasterized before packing
 };
 
 struct pass_pack_atlas_context_t {
@@ -91,6 +93,10 @@ struct pass_pack_atlas_font_t {
   eden_asset_font_id_t font_id;
   f32_t font_height;
 
+  // Read once in pass_pack_atlas_end()
+  ttf_t ttf;
+  f32_t scale;
+
   // Will be generated after packing
   rp_rect_t* glyph_rects;
   pass_pack_atlas_context_t* glyph_contexts;
@@ -101,6 +107,9 @@ struct pass_pack_atlas_sprite_t {
   const char* filename;
   eden_asset_sprite_id_t sprite_id;
 
+  // Read once in pass_pack_atlas_end()
+  png_t png;
+
   // Will be generated after packing
   rp_rect_t* rect;
   pass_pack_atlas_context_t* context;
@@ -145,6 +154,7 @@ struct pass_pack_shader_ext_t {
 
 struct pass_pack_t {
   arena_t* arena;
+  job_system_t* js; // optional, for building atlases
 
   u32_t bitmap_count;
   pass_pack_bitmap_ext_t* bitmap_exts;
@@ -327,6 +337,106 @@ pass_pack_atlas_begin(
 
 
 
+//
+// Atlas jobs
+//
+// @note: Glyphs are rasterized before packing and sprites are decoded
+// straight into the atlas after it, both spread over the job system if
+// there is one. Every job takes batches of contexts in turn and has its
+// own arena. What ends up in the atlas does not depend on which job did
+// what, so the pack is the same however many threads there are.
+//
+#define PASS_PACK_ATLAS_JOB_BATCH_SIZE 32
+
+struct pass_pack_atlas_job_t {
+  arena_t* arena;
+  arena_t own_arena;
+
+  pass_pack_atlas_context_t* contexts;
+  rp_rect_t* rects;
+  u32_t count;
+  u32_t volatile* next_batch;
+
+  // For blitting
+  u8_t* atlas;
+  u32_t atlas_width;
+};
+
+static void
+pass_pack_atlas_rasterize_job(void* data) {
+  auto* job = (pass_pack_atlas_job_t*)data;
+  for (;;) {
+    u32_t begin = u32_atomic_add(job->next_batch, 1) * PASS_PACK_ATLAS_JOB_BATCH_SIZE;
+    if (begin >= job->count) break;
+    u32_t end = min_of(begin + PASS_PACK_ATLAS_JOB_BATCH_SIZE, job->count);
+    for (u32_t i = begin; i < end; ++i) {
+      pass_pack_atlas_context_t* context = job->contexts + i;
+      if (context->type != PASS_PACK_ATLAS_CONTEXT_TYPE_FONT_GLYPH) continue;
+      pass_pack_atlas_font_glyph_context_t* glyph = &context->font_glyph;
+      glyph->pixels = ttf_rasterize_glyph(
+          &glyph->font->ttf, 
+          glyph->ttf_glyph_index, 
+          glyph->font->scale, 
+          nullptr, nullptr, 
+          job->arena);
+    }
+  }
+}
+
+static void
+pass_pack_atlas_blit_job(void* data) {
+  auto* job = (pass_pack_atlas_job_t*)data;
+  for (;;) {
+    u32_t begin = u32_atomic_add(job->next_batch, 1) * PASS_PACK_ATLAS_JOB_BATCH_SIZE;
+    if (begin >= job->count) break;
+    u32_t end = min_of(begin + PASS_PACK_ATLAS_JOB_BATCH_SIZE, job->count);
+    for (u32_t i = begin; i < end; ++i) {
+      rp_rect_t* rect = job->rects + i;
+      auto* context = (pass_pack_atlas_context_t*)(rect->user_data);
+      u32_t pitch = job->atlas_width * 4;
+      u8_t* dest = job->atlas + (usz_t)rect->x * 4 + (usz_t)rect->y * pitch;
+      switch(context->type) {
+        case PASS_PACK_ATLAS_CONTEXT_TYPE_SPRITE: {
+          // The rect is the size of the sprite, so it decodes straight into the atlas
+          arena_set_revert_point(job->arena);
+          b32_t ok = png_rasterize_into_buffer(&context->sprite->png, dest, pitch, job->arena);
+          assert(ok);
+        } break;
+        case PASS_PACK_ATLAS_CONTEXT_TYPE_FONT_GLYPH: {
+          u32_t* pixels = context->font_glyph.pixels;
+          if (!pixels) continue;
+          for (u32_t y = 0; y < rect->h; ++y) {
+            memory_copy(dest + (usz_t)y * pitch, pixels + (usz_t)y * rect->w, rect->w * 4);
+          }
+        } break;
+      }
+    }
+  }
+}
+
+// Runs 'callback' over 'jobs', on the job system if there is one
+static void
+pass_pack_atlas_run_jobs(pass_pack_t* p, job_callback_f* callback, pass_pack_atlas_job_t* jobs, u32_t job_count) {
+  u32_t volatile next_batch = 0;
+  for (u32_t job_index = 0; job_index < job_count; ++job_index) {
+    jobs[job_index].next_batch = &next_batch;
+  }
+  if (job_count == 1) {
+    callback(jobs);
+    return;
+  }
+  job_counter_t counter = {};
+  for (u32_t job_index = 0; job_index < job_count; ++job_index) {
+    job_add(p->js, callback, jobs + job_index, &counter);
+  }
+  job_wait(p->js, &counter);
+}
+
+static f64_t
+pass_elapsed_ms(u64_t start) {
+  return (f64_t)(clock_time() - start) * 1000.0 / clock_resolution();
+}
+
 static void 
 pass_pack_atlas_end(pass_pack_t* p, const char* opt_png_output = 0) 
 {
@@ -348,10 +458,37 @@ pass_pack_atlas_end(pass_pack_t* p, const char* opt_png_output = 0)
 
   auto* contexts = arena_push_arr(pass_pack_atlas_context_t, p->arena, rect_count);
   assert(contexts);
+
+  // Every job gets its own arena, except when there is only one
+  u32_t job_count = p->js ? p->js->worker_count : 1;
+  auto* jobs = arena_push_arr_zero(pass_pack_atlas_job_t, p->arena, job_count);
+  assert(jobs);
+  for (u32_t job_index = 0; job_index < job_count; ++job_index) {
+    pass_pack_atlas_job_t* job = jobs + job_index;
+    if (job_count == 1) {
+      job->arena = p->arena;
+    }
+    else {
+      b32_t ok = arena_alloc(&job->own_arena, gigabytes(1));
+      assert(ok);
+      job->arena = &job->own_arena;
+    }
+  }
+  defer {
+    if (job_count > 1) {
+      for (u32_t job_index = 0; job_index < job_count; ++job_index) {
+        arena_free(&jobs[job_index].own_arena);
+      }
+    }
+  };
+
+  pass_log("Building atlas %u with %u jobs\n", p->atlas_bitmap_id, job_count);
+  pass_create_log_section_until_scope;
   
   //
   // Prepare the rects and contexts with the correct info
   //
+  u64_t rasterize_start = clock_time();
   u32_t rect_index = 0;
   u32_t context_index = 0;
 
@@ -360,23 +497,21 @@ pass_pack_atlas_end(pass_pack_t* p, const char* opt_png_output = 0)
       sprite_index < p->atlas_sprite_count;
       ++sprite_index)
   {
-    arena_set_revert_point(p->arena);
     pass_pack_atlas_sprite_t* s = p->atlas_sprites + sprite_index;
 
     buf_t file_data = file_read_into_buffer(s->filename, p->arena);
     assert(buf_valid(file_data));
 
-    png_t png;
-    b32_t ok = png_read(&png, file_data);
-    assert(ok && png.width && png.height);
+    b32_t ok = png_read(&s->png, file_data);
+    assert(ok && s->png.width && s->png.height);
 
     pass_pack_atlas_context_t* context = contexts + context_index++;
     context->sprite = s;
     context->type = PASS_PACK_ATLAS_CONTEXT_TYPE_SPRITE;
 
     rp_rect_t* rect = rects + rect_index++;
-    rect->w = png.width;
-    rect->h = png.height;
+    rect->w = s->png.width;
+    rect->h = s->png.height;
     rect->user_data = context;
     
     s->rect = rect;
@@ -388,34 +523,33 @@ pass_pack_atlas_end(pass_pack_t* p, const char* opt_png_output = 0)
       atlas_font_id < p->atlas_font_count;
       ++atlas_font_id)
   {
-    arena_set_revert_point(p->arena);
     pass_pack_atlas_font_t* af = p->atlas_fonts + atlas_font_id;
     asset_file_font_t* ff = p->fonts + af->font_id;
-    pass_pack_font_ext_t* ffe = p->font_exts + atlas_font_id;
+    pass_pack_font_ext_t* ffe = p->font_exts + af->font_id;
 
-    ttf_t ttf;
-    b32_t ok = pass_read_font_from_file(&ttf, ffe->filename, p->arena); 
+    b32_t ok = pass_read_font_from_file(&af->ttf, ffe->filename, p->arena); 
     assert(ok);
 
-    f32_t scale = ttf_get_scale_for_pixel_height(&ttf, af->font_height);
+    af->scale = ttf_get_scale_for_pixel_height(&af->ttf, af->font_height);
 
     // Grab the slice of rp_rect_t that belongs to this font
     af->glyph_rects = rects + rect_index;
     af->glyph_contexts = contexts + context_index;
-    //f->glyph_rect_count = 0;
     
     for (u32_t glyph_index = 0;
         glyph_index < ff->glyph_count;
         ++glyph_index)
     {
       asset_file_font_glyph_t* fg = ffe->glyphs + glyph_index;
-      u32_t ttf_glyph_index = ttf_get_glyph_index(&ttf, fg->codepoint);
+      u32_t ttf_glyph_index = ttf_get_glyph_index(&af->ttf, fg->codepoint);
 
       s32_t x0, y0, x1, y1;
-      ttf_get_glyph_bitmap_box(&ttf, ttf_glyph_index, scale, &x0, &y0, &x1, &y1);
+      ttf_get_glyph_bitmap_box(&af->ttf, ttf_glyph_index, af->scale, &x0, &y0, &x1, &y1);
 
       pass_pack_atlas_context_t* context = contexts + context_index++;
       context->font_glyph.codepoint = fg->codepoint;
+      context->font_glyph.ttf_glyph_index = ttf_glyph_index;
+      context->font_glyph.pixels = nullptr;
       context->font_glyph.font = af;
       context->type = PASS_PACK_ATLAS_CONTEXT_TYPE_FONT_GLYPH;
       
@@ -424,12 +558,22 @@ pass_pack_atlas_end(pass_pack_t* p, const char* opt_png_output = 0)
       rect->h = y1 - y0;  
 
       rect->user_data = context;
-      
-      //++f->glyph_rect_count;
     }
   }
+
+  // Rasterization step
+  for (u32_t job_index = 0; job_index < job_count; ++job_index) {
+    jobs[job_index].contexts = contexts;
+    jobs[job_index].count = rect_count;
+  }
+  pass_pack_atlas_run_jobs(p, pass_pack_atlas_rasterize_job, jobs, job_count);
+  pass_log("rasterize: %9.2f ms (%u sprites, %u glyphs)\n", 
+           pass_elapsed_ms(rasterize_start), 
+           p->atlas_sprite_count,
+           rect_count - p->atlas_sprite_count);
   
   // Sort all the rects (and contexts)
+  u64_t pack_start = clock_time();
   asset_file_bitmap_t* fb = p->bitmaps + p->atlas_bitmap_id;
   pass_pack_bitmap_ext_t* fbe = p->bitmap_exts + p->atlas_bitmap_id;
   rp_pack(rects, rect_count, 1, 
@@ -437,62 +581,17 @@ pass_pack_atlas_end(pass_pack_t* p, const char* opt_png_output = 0)
           fb->height, 
           RP_SORT_TYPE_HEIGHT,
           p->arena);
+  pass_log("pack:      %9.2f ms\n", pass_elapsed_ms(pack_start));
   
-  // Rasterization step
-
-  for(u32_t i = 0;
-      i < rect_count;
-      ++i)
-  {
-    rp_rect_t* rect = rects + i;
-    auto* context = (pass_pack_atlas_context_t*)(rect->user_data);
-    switch(context->type) {
-      case PASS_PACK_ATLAS_CONTEXT_TYPE_SPRITE: {
-        arena_set_revert_point(p->arena);
-        pass_pack_atlas_sprite_t* related_entry = context->sprite;
-       
-        buf_t file_data = file_read_into_buffer(related_entry->filename, p->arena);
-        
-        png_t png;
-        b32_t ok = png_read(&png, file_data);
-        assert(ok);
-        
-        u32_t* pixels = png_rasterize(&png, nullptr, nullptr, p->arena);
-        for (usz_t y = rect->y, j = 0; y < rect->y + rect->h; ++y) {
-          for (usz_t x = rect->x; x < rect->x + rect->w; ++x) {
-            usz_t index = (x + y * fb->width);
-            ((u32_t*)(fbe->pixels))[index] = ((u32_t*)(pixels))[j++];
-          }
-        }
-        
-        
-      } break;
-      case PASS_PACK_ATLAS_CONTEXT_TYPE_FONT_GLYPH: {
-        pass_pack_atlas_font_t* related_entry = context->font_glyph.font;
-        pass_pack_atlas_font_glyph_context_t* related_context = &context->font_glyph;
-        pass_pack_font_ext_t* ffe = p->font_exts + related_entry->font_id;
-        
-        ttf_t ttf;
-        b32_t ok = pass_read_font_from_file(&ttf, ffe->filename, p->arena); 
-        assert(ok);
-
-        f32_t s = ttf_get_scale_for_pixel_height(&ttf, related_entry->font_height);
-        u32_t glyph_index = ttf_get_glyph_index(&ttf, related_context->codepoint);
-       
-        u32_t* pixels = ttf_rasterize_glyph(&ttf, glyph_index, s, nullptr, nullptr, p->arena);
-        if (!pixels) continue;
-        
-        for (usz_t y = rect->y, j = 0; y < rect->y + rect->h; ++y) {
-          for (usz_t x = rect->x; x < rect->x + rect->w; ++x) {
-            usz_t index = (x + y * fb->width);
-            ((u32_t*)(fbe->pixels))[index] = pixels[j++];
-          }
-        }
-        
-      } break;
-    }
-    
+  // Blit step. The rects do not overlap, so jobs can write to the atlas freely.
+  u64_t blit_start = clock_time();
+  for (u32_t job_index = 0; job_index < job_count; ++job_index) {
+    jobs[job_index].rects = rects;
+    jobs[job_index].atlas = (u8_t*)fbe->pixels;
+    jobs[job_index].atlas_width = fb->width;
   }
+  pass_pack_atlas_run_jobs(p, pass_pack_atlas_blit_job, jobs, job_count);
+  pass_log("blit:      %9.2f ms\n", pass_elapsed_ms(blit_start));
 
 
   //
@@ -500,12 +599,17 @@ pass_pack_atlas_end(pass_pack_t* p, const char* opt_png_output = 0)
   //
   if (opt_png_output)
   {
+    u64_t write_start = clock_time();
+    arena_set_revert_point(p->arena);
     buf_t png_to_write_mem  = 
       png_write(fbe->pixels, 
                 fb->width, 
                 fb->height, 
-                p->arena);
+                p->arena,
+                6,
+                p->js);
     file_write_from_buffer(opt_png_output, png_to_write_mem);
+    pass_log("write:     %9.2f ms (%u bytes)\n", pass_elapsed_ms(write_start), (u32_t)png_to_write_mem.size);
   }
 
   //
@@ -535,21 +639,14 @@ pass_pack_atlas_end(pass_pack_t* p, const char* opt_png_output = 0)
     pass_pack_atlas_font_t* af = p->atlas_fonts + atlas_font_id;
     asset_file_font_t* ff = p->fonts + af->font_id;
     pass_pack_font_ext_t* ffe = p->font_exts + af->font_id;
-    
-
-    // @todo: We already read the TTF earlier. Is there
-    // a way to not do this multiple times?
-    ttf_t ttf;
-    b32_t ok = pass_read_font_from_file(&ttf, ffe->filename, p->arena); 
-    assert(ok);
-    f32_t scale = ttf_get_scale_for_pixel_height(&ttf, 1.f);
+    f32_t scale = ttf_get_scale_for_pixel_height(&af->ttf, 1.f);
 
     // Vertical Advance
     {
       s16_t ascent = 0;
       s16_t descent = 0;
       s16_t line_gap = 0;
-      ttf_get_vertical_metrics(&ttf, 
+      ttf_get_vertical_metrics(&af->ttf, 
           &ascent, &descent, &line_gap);
       ff->ascent = (f32_t)ascent * scale;
       ff->descent = (f32_t)descent * scale;
@@ -566,7 +663,7 @@ pass_pack_atlas_end(pass_pack_t* p, const char* opt_png_output = 0)
 
       // @note: codepoint is should already be set!
 
-      u32_t ttf_glyph_index = ttf_get_glyph_index(&ttf, fg->codepoint);
+      u32_t ttf_glyph_index = ttf_get_glyph_index(&af->ttf, fg->codepoint);
 
       // Texel UV
       fg->texel_x0 = rect->x;
@@ -576,7 +673,7 @@ pass_pack_atlas_end(pass_pack_t* p, const char* opt_png_output = 0)
 
       // Glyph box
       s32_t x0, y0, x1, y1;
-      if (ttf_get_glyph_box(&ttf, ttf_glyph_index, &x0, &y0, &x1, &y1)){
+      if (ttf_get_glyph_box(&af->ttf, ttf_glyph_index, &x0, &y0, &x1, &y1)){
         fg->box_x0 = (f32_t)x0 * scale;
         fg->box_y0 = (f32_t)y0 * scale;
         fg->box_x1 = (f32_t)x1 * scale;
@@ -586,7 +683,7 @@ pass_pack_atlas_end(pass_pack_t* p, const char* opt_png_output = 0)
       // Horizontal dvance
       s16_t advance_width = 0;
       ttf_get_glyph_horizontal_metrics(
-          &ttf, ttf_glyph_index, 
+          &af->ttf, ttf_glyph_index, 
           &advance_width, nullptr);
       fg->horizontal_advance = (f32_t)advance_width * scale;
     }
@@ -606,9 +703,11 @@ pass_pack_begin(
   u32_t max_fonts,
   u32_t max_sounds,
   u32_t max_glyphs,
-  u32_t max_shaders)
+  u32_t max_shaders,
+  job_system_t* js = nullptr)
 {
   p->arena = arena;
+  p->js = js;
 
   p->bitmap_count = max_bitmaps;
   if (max_bitmaps > 0) {
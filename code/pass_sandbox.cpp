@@ -13,6 +13,11 @@ int main() {
   arena_alloc(&arena, gigabytes(1));
   defer { arena_free(&arena); };
 
+  // @note: The main thread is a worker too
+  job_system_t js = {};
+  b32_t has_js = job_system_init(&js, thread_get_hardware_count() - 1, 1024, &arena);
+  defer { if (has_js) job_system_free(&js); };
+
   pass_pack_t p;
 
 
@@ -28,7 +33,8 @@ int main() {
       ASSET_FONT_ID_MAX, 
       ASSET_SOUND_ID_MAX, 
       total_cp*2,
-      ASSET_SHADER_ID_MAX);
+      ASSET_SHADER_ID_MAX,
+      has_js ? &js : nullptr);
   {
     pass_pack_sound(&p, ASSET_SOUND_ID_TEST, sandbox_res_dir("bgm.wav"));
 
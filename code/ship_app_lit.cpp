@@ -425,6 +425,7 @@ if (!opengl->name) { return false; }
     wgl_set_opengl_function(glClear);
     wgl_set_opengl_function(glClearColor);
     wgl_set_opengl_function(glCreateBuffers);
+    wgl_set_opengl_function(glDeleteBuffers);
     wgl_set_opengl_function(glNamedBufferStorage);
     wgl_set_opengl_function(glCreateVertexArrays);
     wgl_set_opengl_function(glVertexArrayVertexBuffer);
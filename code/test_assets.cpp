@@ -0,0 +1,301 @@
+//
+// Load-time benchmark for eden_assets_init_from_file().
+//
+// Writes a synthetic ~500MB asset pack and compares loading it with
+// file_read() into the arena against memory-mapping it, with 
+// different amounts of worker threads.
+//
+// Build optimized, e.g.
+//   clang++ -std=c++17 -O2 -march=native -DEDEN_DEBUG=1 test_assets.cpp
+//
+
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "eden.h"
+
+#define TEST_ASSETS_FILE "test_assets.momo"
+
+#define TEST_ASSETS_SOUND_COUNT   96
+#define TEST_ASSETS_SOUND_SIZE    megabytes(4)
+#define TEST_ASSETS_BITMAP_COUNT  8
+#define TEST_ASSETS_BITMAP_WIDTH  2048
+#define TEST_ASSETS_BITMAP_HEIGHT 2048
+#define TEST_ASSETS_FONT_COUNT    4
+#define TEST_ASSETS_GLYPH_COUNT   1024
+#define TEST_ASSETS_SPRITE_COUNT  256
+#define TEST_ASSETS_SHADER_COUNT  2
+#define TEST_ASSETS_RUNS          3
+#define TEST_ASSETS_MAX_WORKERS   16
+
+//
+// Tasks run on momo's job system, just like the platform does.
+//
+static job_system_t test_assets_jobs = {};
+static job_counter_t test_assets_task_counter = {};
+
+static 
+eden_add_task_sig(test_assets_add_task)
+{
+  job_add(&test_assets_jobs, callback, data, &test_assets_task_counter);
+}
+
+static 
+eden_complete_all_tasks_sig(test_assets_complete_all_tasks)
+{
+  job_wait(&test_assets_jobs, &test_assets_task_counter);
+}
+
+static
+eden_debug_log_sig(test_assets_log)
+{
+  va_list args;
+  va_start(args, fmt);
+  vprintf(fmt, args);
+  va_end(args);
+}
+
+static void
+test_assets_write_chunk(FILE* file, arena_t* arena, usz_t size, u8_t seed)
+{
+  arena_set_revert_point(arena);
+  u8_t* data = arena_push_arr(u8_t, arena, size);
+  assert(data);
+  for (usz_t i = 0; i < size; ++i)
+    data[i] = (u8_t)(i + seed);
+  fwrite(data, size, 1, file);
+}
+
+//
+// Lays out the file the same way pass_pack_end() does.
+//
+static usz_t
+test_assets_write_pack(const char* filename, arena_t* arena)
+{
+  FILE* file = fopen(filename, "wb");
+  if (!file) return 0;
+  defer { fclose(file); };
+
+  asset_file_font_t fonts[TEST_ASSETS_FONT_COUNT] = {};
+  asset_file_sprite_t sprites[TEST_ASSETS_SPRITE_COUNT] = {};
+  asset_file_bitmap_t bitmaps[TEST_ASSETS_BITMAP_COUNT] = {};
+  asset_file_sound_t sounds[TEST_ASSETS_SOUND_COUNT] = {};
+  asset_file_shader_t shaders[TEST_ASSETS_SHADER_COUNT] = {};
+
+  asset_file_header_t header = {};
+  header.signature = ASSET_FILE_SIGNATURE;
+  header.font_count = TEST_ASSETS_FONT_COUNT;
+  header.sprite_count = TEST_ASSETS_SPRITE_COUNT;
+  header.bitmap_count = TEST_ASSETS_BITMAP_COUNT;
+  header.sound_count = TEST_ASSETS_SOUND_COUNT;
+  header.shader_count = TEST_ASSETS_SHADER_COUNT;
+  header.offset_to_fonts = sizeof(asset_file_header_t);
+  header.offset_to_sprites = header.offset_to_fonts + sizeof(fonts);
+  header.offset_to_bitmaps = header.offset_to_sprites + sizeof(sprites);
+  header.offset_to_sounds = header.offset_to_bitmaps + sizeof(bitmaps);
+  header.offset_to_shaders = header.offset_to_sounds + sizeof(sounds);
+
+  u32_t offset_to_data = header.offset_to_shaders + sizeof(shaders);
+  fseek(file, offset_to_data, SEEK_SET);
+
+  // Fonts
+  for_arr(font_index, fonts)
+  {
+    arena_set_revert_point(arena);
+    asset_file_font_t* ff = fonts + font_index;
+    ff->bitmap_asset_id = 0;
+    ff->glyph_count = TEST_ASSETS_GLYPH_COUNT;
+    ff->highest_codepoint = TEST_ASSETS_GLYPH_COUNT + 31;
+    ff->ascent = 0.8f;
+    ff->descent = -0.2f;
+    ff->line_gap = 0.1f;
+    ff->offset_to_data = offset_to_data;
+
+    auto* glyphs = arena_push_arr_zero(asset_file_font_glyph_t, arena, TEST_ASSETS_GLYPH_COUNT);
+    assert(glyphs);
+    for (u32_t glyph_index = 0; glyph_index < TEST_ASSETS_GLYPH_COUNT; ++glyph_index) {
+      glyphs[glyph_index].codepoint = glyph_index + 32;
+      glyphs[glyph_index].horizontal_advance = 0.5f;
+    }
+    fwrite(glyphs, sizeof(asset_file_font_glyph_t), TEST_ASSETS_GLYPH_COUNT, file);
+    test_assets_write_chunk(file, arena, sizeof(f32_t)*TEST_ASSETS_GLYPH_COUNT*TEST_ASSETS_GLYPH_COUNT, 0);
+    offset_to_data = ftell(file);
+  }
+
+  // Sprites
+  for_arr(sprite_index, sprites)
+  {
+    asset_file_sprite_t* fs = sprites + sprite_index;
+    fs->texel_x1 = 16;
+    fs->texel_y1 = 16;
+  }
+
+  // Bitmaps
+  for_arr(bitmap_index, bitmaps)
+  {
+    asset_file_bitmap_t* fb = bitmaps + bitmap_index;
+    fb->width = TEST_ASSETS_BITMAP_WIDTH;
+    fb->height = TEST_ASSETS_BITMAP_HEIGHT;
+    fb->offset_to_data = offset_to_data;
+    test_assets_write_chunk(file, arena, fb->width * fb->height * 4, (u8_t)bitmap_index);
+    offset_to_data = ftell(file);
+  }
+
+  // Sounds
+  for_arr(sound_index, sounds)
+  {
+    asset_file_sound_t* fs = sounds + sound_index;
+    fs->data_size = TEST_ASSETS_SOUND_SIZE;
+    fs->offset_to_data = offset_to_data;
+    test_assets_write_chunk(file, arena, fs->data_size, (u8_t)sound_index);
+    offset_to_data = ftell(file);
+  }
+
+  // Shaders
+  for_arr(shader_index, shaders)
+  {
+    asset_file_shader_t* fs = shaders + shader_index;
+    buf_t code = buf_from_lit("void main() {}");
+    fs->length = (u32_t)code.size;
+    fs->offset_to_data = offset_to_data;
+    fwrite(code.e, code.size, 1, file);
+    offset_to_data = ftell(file);
+  }
+
+  fseek(file, 0, SEEK_SET);
+  fwrite(&header, sizeof(header), 1, file);
+  fseek(file, header.offset_to_fonts, SEEK_SET);
+  fwrite(fonts, sizeof(fonts), 1, file);
+  fseek(file, header.offset_to_sprites, SEEK_SET);
+  fwrite(sprites, sizeof(sprites), 1, file);
+  fseek(file, header.offset_to_bitmaps, SEEK_SET);
+  fwrite(bitmaps, sizeof(bitmaps), 1, file);
+  fseek(file, header.offset_to_sounds, SEEK_SET);
+  fwrite(sounds, sizeof(sounds), 1, file);
+  fseek(file, header.offset_to_shaders, SEEK_SET);
+  fwrite(shaders, sizeof(shaders), 1, file);
+
+  return offset_to_data;
+}
+
+static void
+test_assets_reset(arena_t* arena)
+{
+  eden_assets_unmap_file();
+  arena_clear(arena);
+
+  eden_gfx_texture_queue_t* q = &eden->gfx.texture_queue;
+  q->transfer_memory_start = 0;
+  q->transfer_memory_end = 0;
+  q->first_payload_index = 0;
+  q->payload_count = 0;
+}
+
+// Reads one byte per page of every sound, which is what the mixer
+// would eventually do anyway.
+static u32_t
+test_assets_touch_sounds()
+{
+  u32_t sum = 0;
+  eden_assets_t* assets = &eden->assets;
+  for (u32_t sound_index = 0; sound_index < assets->sound_count; ++sound_index) {
+    eden_asset_sound_t* s = assets->sounds + sound_index;
+    for (u32_t i = 0; i < s->data_size; i += 4096)
+      sum += s->data[i];
+  }
+  return sum;
+}
+
+int main() {
+  static eden_t e = {};
+  eden_globalize(&e);
+
+  arena_t arena = {};
+  arena_alloc(&arena, gigabytes(2));
+  defer { arena_free(&arena); };
+
+  arena_t gfx_arena = {};
+  arena_alloc(&gfx_arena, gigabytes(1));
+  defer { arena_free(&gfx_arena); };
+
+  usz_t bitmap_bytes = (usz_t)TEST_ASSETS_BITMAP_COUNT * TEST_ASSETS_BITMAP_WIDTH * TEST_ASSETS_BITMAP_HEIGHT * 4;
+  if (!eden_gfx_init(&eden->gfx, &gfx_arena, bitmap_bytes, 16, TEST_ASSETS_BITMAP_COUNT, TEST_ASSETS_BITMAP_COUNT)) {
+    printf("Failed to init gfx\n");
+    return 1;
+  }
+
+  printf("Writing %s...\n", TEST_ASSETS_FILE);
+  usz_t pack_size = test_assets_write_pack(TEST_ASSETS_FILE, &arena);
+  if (pack_size == 0) {
+    printf("Failed to write pack\n");
+    return 1;
+  }
+  arena_clear(&arena);
+  printf("Pack size: %.2f MB\n\n", (f64_t)pack_size / megabytes(1));
+
+  u32_t max_workers = TEST_ASSETS_MAX_WORKERS;
+  arena_t jobs_arena = {};
+  arena_alloc(&jobs_arena, megabytes(16));
+  defer { arena_free(&jobs_arena); };
+
+  eden->add_task = test_assets_add_task;
+  eden->complete_all_tasks = test_assets_complete_all_tasks;
+  eden->debug_log = test_assets_log;
+
+  printf("%-8s %8s %12s %18s %14s\n", "mode", "workers", "load (ms)", "load+touch (ms)", "arena (MB)");
+  for (u32_t mode = 0; mode < 2; ++mode)
+  {
+    b32_t map_file = (mode == 1);
+    for (u32_t worker_count = 0; worker_count <= max_workers; worker_count = worker_count ? worker_count * 2 : 1) 
+    {
+      arena_clear(&jobs_arena);
+      if (!job_system_init(&test_assets_jobs, worker_count, 1024, &jobs_arena)) {
+        printf("Failed to init job system\n");
+        return 1;
+      }
+      defer { job_system_free(&test_assets_jobs); };
+
+      f64_t best_load = F64_INFINITY;
+      f64_t best_touch = F64_INFINITY;
+      usz_t arena_used = 0;
+      eden_assets_load_stats_t best_stats = {};
+
+      for (u32_t run = 0; run < TEST_ASSETS_RUNS; ++run)
+      {
+        test_assets_reset(&arena);
+
+        u64_t start = clock_time();
+        if (!eden_assets_init_from_file(TEST_ASSETS_FILE, &arena, map_file)) {
+          printf("Failed to load pack (map_file=%d)\n", map_file);
+          return 1;
+        }
+        u64_t loaded = clock_time();
+        volatile u32_t sum = test_assets_touch_sounds();
+        (void)sum;
+        u64_t touched = clock_time();
+
+        f64_t load = (f64_t)(loaded - start) * 1000.0 / clock_resolution();
+        if (load < best_load) {
+          best_load = load;
+          best_stats = eden->assets.load_stats;
+        }
+        best_touch = min_of(best_touch, (f64_t)(touched - start) * 1000.0 / clock_resolution());
+        arena_used = arena.pos;
+      }
+      printf("%-8s %8u %12.2f %18.2f %14.2f\n",
+          map_file ? "mapped" : "read",
+          worker_count,
+          best_load,
+          best_touch,
+          (f64_t)arena_used / megabytes(1));
+
+      // Per section report of the best run
+      eden->assets.load_stats = best_stats;
+      eden_assets_log_load_stats();
+    }
+  }
+  test_assets_reset(&arena);
+
+  remove(TEST_ASSETS_FILE);
+  return 0;
+}
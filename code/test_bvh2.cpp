@@ -0,0 +1,187 @@
+//
+// Benchmark for bvh2_t against brute-force raycasting.
+//
+// Mimics lit's light generation: every light casts 3 rays at every
+// edge's end point (the first one clamped to the end point) and each
+// ray is tested against the edges. 64 point lights, 1k to 20k edges.
+// A tenth of the edges move every frame to exercise bvh2_update().
+//
+// Brute force is far too slow to run in full at the high edge counts,
+// so it only runs a sample of the rays and the frame time is scaled up
+// from that. The sampled rays are also used to check that both paths
+// return exactly the same times.
+//
+// Build optimized, e.g.
+//   clang++ -std=c++17 -O2 -march=native test_bvh2.cpp
+//
+
+#include <stdio.h>
+
+#include "momo.h"
+
+#define TEST_BVH2_LIGHT_COUNT       64
+#define TEST_BVH2_WIDTH             1600.f
+#define TEST_BVH2_HEIGHT            900.f
+#define TEST_BVH2_MAX_BRUTE_TESTS   100000000ull
+#define TEST_BVH2_MOVING_RATIO      10
+
+struct test_bvh2_edge_t {
+  v2f_t start_pt;
+  v2f_t end_pt;
+};
+
+// @note: this is the same as lit_game_get_ray_intersection_time_wrt_edges()
+static f32_t
+test_bvh2_brute(v2f_t ray_origin, v2f_t ray_dir, test_bvh2_edge_t* edges, u32_t edge_count, f32_t max_t) {
+  f32_t lowest_t1 = max_t;
+  for(u32_t edge_index = 0; edge_index < edge_count; ++edge_index) {
+    test_bvh2_edge_t* edge = edges + edge_index;
+    lowest_t1 = bonk_ray2_seg2(ray_origin, ray_dir, edge->start_pt, edge->end_pt - edge->start_pt, lowest_t1);
+  }
+  return lowest_t1;
+}
+
+static void
+test_bvh2_gen_edges(rng_t* rng, test_bvh2_edge_t* edges, u32_t edge_count) {
+  // borders, like lit's levels
+  edges[0] = { v2f_set(0.f, 0.f), v2f_set(TEST_BVH2_WIDTH, 0.f) };
+  edges[1] = { v2f_set(TEST_BVH2_WIDTH, 0.f), v2f_set(TEST_BVH2_WIDTH, TEST_BVH2_HEIGHT) };
+  edges[2] = { v2f_set(TEST_BVH2_WIDTH, TEST_BVH2_HEIGHT), v2f_set(0.f, TEST_BVH2_HEIGHT) };
+  edges[3] = { v2f_set(0.f, TEST_BVH2_HEIGHT), v2f_set(0.f, 0.f) };
+  for (u32_t i = 4; i < edge_count; ++i) {
+    v2f_t start = v2f_set(rng_range_f32(rng, 10.f, TEST_BVH2_WIDTH - 10.f), rng_range_f32(rng, 10.f, TEST_BVH2_HEIGHT - 10.f));
+    f32_t angle = rng_range_f32(rng, 0.f, PI_32 * 2.f);
+    f32_t length = rng_range_f32(rng, 2.f, 12.f);
+    edges[i].start_pt = start;
+    edges[i].end_pt = start + v2f_set(f32_cos(angle), f32_sin(angle)) * length;
+  }
+}
+
+// Spins some of the edges around their start point, like lit's animators
+static void
+test_bvh2_animate(test_bvh2_edge_t* edges, u32_t edge_count, u32_t frame) {
+  f32_t angle = 0.05f;
+  for (u32_t i = 4 + (frame % TEST_BVH2_MOVING_RATIO); i < edge_count; i += TEST_BVH2_MOVING_RATIO) {
+    v2f_t d = edges[i].end_pt - edges[i].start_pt;
+    edges[i].end_pt = edges[i].start_pt + v2f_rotate(d, angle);
+  }
+}
+
+static void
+test_bvh2_sync(bvh2_t* bvh, test_bvh2_edge_t* edges, u32_t edge_count) {
+  for (u32_t i = 0; i < edge_count; ++i) {
+    bvh2_set_segment(bvh, i, edges[i].start_pt, edges[i].end_pt);
+  }
+  bvh2_update(bvh);
+}
+
+// @note: 'stride' lets us only do every n-th ray.
+// Returns the sum of times so that the work can't be optimized away.
+static f64_t
+test_bvh2_frame(bvh2_t* bvh, v2f_t* lights, test_bvh2_edge_t* edges, u32_t edge_count, u32_t stride, f32_t* out_times) {
+  static const f32_t offset_angles[] = {0.0f, 0.001f, -0.001f};
+  f64_t sum = 0.0;
+  u32_t ray_index = 0;
+  u32_t out_index = 0;
+  for (u32_t light_index = 0; light_index < TEST_BVH2_LIGHT_COUNT; ++light_index) {
+    v2f_t pos = lights[light_index];
+    for_arr(offset_index, offset_angles) {
+      for (u32_t edge_index = 0; edge_index < edge_count; ++edge_index, ++ray_index) {
+        if (ray_index % stride) continue;
+        v2f_t dir = v2f_rotate(edges[edge_index].end_pt - pos, offset_angles[offset_index]);
+        f32_t max_t = offset_index == 0 ? 1.f : F32_INFINITY;
+        f32_t t = bvh ?
+          bvh2_raycast(bvh, pos, dir, max_t) :
+          test_bvh2_brute(pos, dir, edges, edge_count, max_t);
+        if (out_times) out_times[out_index++] = t;
+        sum += t < F32_INFINITY ? t : 0.f;
+      }
+    }
+  }
+  return sum;
+}
+
+static b32_t
+test_bvh2_is_same(f32_t lhs, f32_t rhs) {
+  return lhs == rhs || (lhs != lhs && rhs != rhs);
+}
+
+int main() {
+  arena_t arena = {};
+  if (!arena_alloc(&arena, gigabytes(1))) {
+    printf("Failed to allocate arena\n");
+    return 1;
+  }
+  defer { arena_free(&arena); };
+
+  rng_t rng;
+  rng_init(&rng, 1234);
+
+  v2f_t lights[TEST_BVH2_LIGHT_COUNT];
+  for_arr(i, lights) {
+    lights[i] = v2f_set(rng_range_f32(&rng, 20.f, TEST_BVH2_WIDTH - 20.f), rng_range_f32(&rng, 20.f, TEST_BVH2_HEIGHT - 20.f));
+  }
+
+  u32_t edge_counts[] = { 256, 1000, 2000, 5000, 10000, 20000 };
+
+  printf("%8s %12s %14s %14s %10s %12s %8s %8s %12s\n",
+      "edges", "bvh (ms)", "brute (ms)", "sampled rays", "speedup", "update (ms)", "builds", "refits", "mismatches");
+  for_arr(count_index, edge_counts) {
+    u32_t edge_count = edge_counts[count_index];
+    arena_clear(&arena);
+
+    test_bvh2_edge_t* edges = arena_push_arr(test_bvh2_edge_t, &arena, edge_count);
+    bvh2_t bvh = {};
+    if (!edges || !bvh2_init(&bvh, edge_count, &arena)) {
+      printf("Failed to allocate\n");
+      return 1;
+    }
+    test_bvh2_gen_edges(&rng, edges, edge_count);
+    test_bvh2_sync(&bvh, edges, edge_count);
+
+    // Run a couple of animated frames with the BVH and take the best one
+    f64_t best_bvh = F64_INFINITY;
+    f64_t best_update = F64_INFINITY;
+    const u32_t frame_count = edge_count <= 2000 ? 8 : 2;
+    for (u32_t frame = 0; frame < frame_count; ++frame) {
+      test_bvh2_animate(edges, edge_count, frame);
+
+      u64_t start = clock_time();
+      test_bvh2_sync(&bvh, edges, edge_count);
+      u64_t synced = clock_time();
+      test_bvh2_frame(&bvh, lights, edges, edge_count, 1, nullptr);
+      u64_t end = clock_time();
+
+      best_update = min_of(best_update, (f64_t)(synced - start) * 1000.0 / clock_resolution());
+      best_bvh = min_of(best_bvh, (f64_t)(end - start) * 1000.0 / clock_resolution());
+    }
+
+    // Brute force on a sample of the rays of the last frame
+    u64_t total_rays = (u64_t)TEST_BVH2_LIGHT_COUNT * 3 * edge_count;
+    u32_t stride = (u32_t)max_of((u64_t)1, total_rays * edge_count / TEST_BVH2_MAX_BRUTE_TESTS);
+    u32_t sampled_rays = (u32_t)((total_rays + stride - 1) / stride);
+    f32_t* brute_times = arena_push_arr(f32_t, &arena, sampled_rays);
+    f32_t* bvh_times = arena_push_arr(f32_t, &arena, sampled_rays);
+
+    u64_t start = clock_time();
+    test_bvh2_frame(nullptr, lights, edges, edge_count, stride, brute_times);
+    u64_t end = clock_time();
+    f64_t brute = (f64_t)(end - start) * 1000.0 / clock_resolution() * stride;
+
+    test_bvh2_frame(&bvh, lights, edges, edge_count, stride, bvh_times);
+    u32_t mismatches = 0;
+    for (u32_t i = 0; i < sampled_rays; ++i) {
+      if (!test_bvh2_is_same(brute_times[i], bvh_times[i])) ++mismatches;
+    }
+
+    printf("%8u %12.2f %14.2f %14u %9.1fx %12.3f %8u %8u %12u\n",
+        edge_count, best_bvh, brute, sampled_rays, brute / best_bvh, best_update, bvh.build_count, bvh.refit_count, mismatches);
+
+    if (mismatches) {
+      printf("BVH results differ from brute force!\n");
+      return 1;
+    }
+  }
+
+  return 0;
+}
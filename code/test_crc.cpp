@@ -0,0 +1,169 @@
+//
+// Tests and benchmark for crc32_ieee() and crc32c().
+//
+// Every path (tables, PCLMULQDQ, SSE4.2) is checked against crc32_slow()
+// for every length up to 1KB at every alignment, and for checksums done
+// in pieces. Then each path's throughput is timed against the byte at a
+// time crc32().
+//
+// Build optimized, e.g.
+//   clang++ -std=c++17 -O2 test_crc.cpp
+//
+
+#include <stdio.h>
+
+#include "momo.h"
+
+#define TEST_CRC_MAX_SIZE   1024
+#define TEST_CRC_BENCH_SIZE megabytes(64)
+
+#define test_crc_check(cond) \
+  if (!(cond)) { printf("FAILED (line %d): %s\n", __LINE__, #cond); return false; }
+
+typedef u32_t test_crc_path_f(const u8_t* p, usz_t size, u32_t r);
+
+static u8_t
+test_crc_reverse_u8(u8_t v) {
+  u8_t ret = 0;
+  for (u32_t i = 0; i < 8; ++i) ret |= ((v >> i) & 1) << (7 - i);
+  return ret;
+}
+
+static u32_t
+test_crc_reverse_u32(u32_t v) {
+  u32_t ret = 0;
+  for (u32_t i = 0; i < 32; ++i) ret |= ((v >> i) & 1) << (31 - i);
+  return ret;
+}
+
+// crc32_slow() shifts bits in from the top, but these CRCs are
+// reflected. Reflecting the input and output makes them the same.
+static u32_t
+test_crc_reference(u8_t* data, u32_t size, u32_t polynomial, u8_t* scratch) {
+  for (u32_t i = 0; i < size; ++i) scratch[i] = test_crc_reverse_u8(data[i]);
+  return ~test_crc_reverse_u32(crc32_slow(scratch, size, 0xFFFFFFFF, polynomial));
+}
+
+static b32_t
+test_crc_path(const char* name, test_crc_path_f* path, u32_t polynomial, u32_t check) {
+  static u8_t data[TEST_CRC_MAX_SIZE + 16];
+  static u8_t scratch[TEST_CRC_MAX_SIZE + 16];
+  rng_t rng;
+  rng_init(&rng, polynomial);
+  for_arr(i, data) data[i] = (u8_t)rng_next(&rng);
+
+  // the usual check value
+  test_crc_check(~path((const u8_t*)"123456789", 9, ~0u) == check);
+
+  for (u32_t size = 0; size <= TEST_CRC_MAX_SIZE; ++size) {
+    for (u32_t align = 0; align < 16; ++align) {
+      u32_t expected = test_crc_reference(data + align, size, polynomial, scratch);
+      test_crc_check(~path(data + align, size, ~0u) == expected);
+    }
+  }
+
+  // in pieces
+  for (u32_t split = 0; split <= TEST_CRC_MAX_SIZE; split += 7) {
+    u32_t expected = test_crc_reference(data, TEST_CRC_MAX_SIZE, polynomial, scratch);
+    u32_t r = path(data, split, ~0u);
+    r = path(data + split, TEST_CRC_MAX_SIZE - split, r);
+    test_crc_check(~r == expected);
+  }
+
+  printf("%s: OK\n", name);
+  return true;
+}
+
+static b32_t
+test_crc_public() {
+  u8_t data[300];
+  for_arr(i, data) data[i] = (u8_t)(i * 7);
+  test_crc_check(crc32_ieee("123456789", 9) == 0xCBF43926);
+  test_crc_check(crc32c("123456789", 9) == 0xE3069283);
+  test_crc_check(crc32_ieee(data, 0) == 0);
+  test_crc_check(crc32c(data, 0) == 0);
+
+  // chaining
+  u32_t whole = crc32_ieee(data, sizeof(data));
+  u32_t piece = crc32_ieee(data, 100);
+  test_crc_check(crc32_ieee(data + 100, sizeof(data) - 100, piece) == whole);
+  whole = crc32c(data, sizeof(data));
+  piece = crc32c(data, 77);
+  test_crc_check(crc32c(data + 77, sizeof(data) - 77, piece) == whole);
+
+  // PNG's IEND chunk
+  u8_t iend[] = { 'I', 'E', 'N', 'D' };
+  test_crc_check(_png_calculate_crc32(iend, sizeof(iend)) == 0xAE426082);
+
+  printf("crc32_ieee and crc32c: OK\n");
+  return true;
+}
+
+static void
+test_crc_bench_path(const char* name, test_crc_path_f* path, u8_t* data, usz_t size) {
+  u64_t start = clock_time();
+  volatile u32_t r = path(data, size, ~0u);
+  u64_t end = clock_time();
+  f64_t secs = (f64_t)(end - start) / clock_resolution();
+  printf("  %-28s %8.1f MB/s (%08x)\n", name, size / secs / (1024.0 * 1024.0), ~r);
+}
+
+static u32_t
+test_crc_bytewise(const u8_t* p, usz_t size, u32_t r) {
+  static crc32_table_t table;
+  static b32_t is_table_ready = false;
+  if (!is_table_ready) {
+    crc32_init_table(&table, 0x04C11DB7);
+    is_table_ready = true;
+  }
+  return crc32((u8_t*)p, (u32_t)size, r, &table);
+}
+
+int main() {
+#if _CRC_HARDWARE
+  u32_t cpu_flags = _crc_get_cpu_flags();
+  b32_t has_sse42 = (cpu_flags & _CRC_CPU_FLAG_SSE42) != 0;
+  b32_t has_pclmul = (cpu_flags & _CRC_CPU_FLAG_PCLMUL) != 0;
+#else
+  b32_t has_sse42 = false;
+  b32_t has_pclmul = false;
+#endif
+  printf("cpu: sse4.2 %s, pclmulqdq %s\n", has_sse42 ? "yes" : "no", has_pclmul ? "yes" : "no");
+
+  if (!test_crc_path("crc32 ieee, slicing-by-16", _crc32_ieee_table, 0x04C11DB7, 0xCBF43926)) return 1;
+  if (!test_crc_path("crc32c, slicing-by-16", _crc32c_table, 0x1EDC6F41, 0xE3069283)) return 1;
+#if _CRC_HARDWARE
+  if (has_pclmul && !test_crc_path("crc32 ieee, pclmul", [](const u8_t* p, usz_t size, u32_t r) {
+    if (size >= 64) {
+      usz_t block_size = size & ~(usz_t)15;
+      r = _crc32_ieee_pclmul_blocks(p, block_size, r);
+      p += block_size;
+      size -= block_size;
+    }
+    return _crc32_ieee_table(p, size, r);
+  }, 0x04C11DB7, 0xCBF43926)) return 1;
+  if (has_sse42 && !test_crc_path("crc32c, sse4.2", _crc32c_sse42, 0x1EDC6F41, 0xE3069283)) return 1;
+#endif
+  if (!test_crc_public()) return 1;
+
+  arena_t arena = {};
+  if (!arena_alloc(&arena, TEST_CRC_BENCH_SIZE + kilobytes(4))) {
+    printf("Failed to allocate arena\n");
+    return 1;
+  }
+  defer { arena_free(&arena); };
+  u8_t* data = arena_push_arr(u8_t, &arena, TEST_CRC_BENCH_SIZE);
+  rng_t rng;
+  rng_init(&rng, 42);
+  for (usz_t i = 0; i < TEST_CRC_BENCH_SIZE; ++i) data[i] = (u8_t)rng_next(&rng);
+
+  printf("\n%u MB:\n", (u32_t)(TEST_CRC_BENCH_SIZE / megabytes(1)));
+  test_crc_bench_path("crc32 (byte at a time)", test_crc_bytewise, data, TEST_CRC_BENCH_SIZE);
+  test_crc_bench_path("crc32 ieee, slicing-by-16", _crc32_ieee_table, data, TEST_CRC_BENCH_SIZE);
+  test_crc_bench_path("crc32c, slicing-by-16", _crc32c_table, data, TEST_CRC_BENCH_SIZE);
+#if _CRC_HARDWARE
+  if (has_pclmul) test_crc_bench_path("crc32 ieee, pclmul", _crc32_ieee_pclmul_blocks, data, TEST_CRC_BENCH_SIZE);
+  if (has_sse42) test_crc_bench_path("crc32c, sse4.2", _crc32c_sse42, data, TEST_CRC_BENCH_SIZE);
+#endif
+  return 0;
+}
@@ -0,0 +1,146 @@
+//
+// Tests for eden_debug's record buffers.
+//
+// Workers on momo's job system call eden_inspect() at the same time.
+// Every record must show up after the swap, or be counted as dropped
+// if the buffer is full. A buffer that overflowed has to grow at a
+// later swap so that the same load no longer drops anything.
+//
+// Build e.g.
+//   clang++ -std=c++17 -O2 -DEDEN_DEBUG=1 test_debug_records.cpp -lpthread
+//
+
+#include <stdio.h>
+
+#include "eden.h"
+
+#define TEST_DEBUG_RECORDS_TASKS 16
+
+#define test_debug_records_check(cond) \
+  if (!(cond)) { printf("FAILED (line %d): %s\n", __LINE__, #cond); return false; }
+
+static const char* test_debug_records_names[TEST_DEBUG_RECORDS_TASKS] = {
+  "t0", "t1", "t2", "t3", "t4", "t5", "t6", "t7",
+  "t8", "t9", "t10", "t11", "t12", "t13", "t14", "t15",
+};
+
+struct test_debug_records_task_t {
+  u32_t task_index;
+  u32_t record_count;
+};
+
+static void
+test_debug_records_task(void* data) {
+  auto* task = (test_debug_records_task_t*)data;
+  for (u32_t i = 0; i < task->record_count; ++i)
+    eden_inspect(test_debug_records_names[task->task_index], i);
+}
+
+// Adds 'records_per_task' records from each task, swaps and checks
+// that every record is either there or dropped.
+static b32_t
+test_debug_records_frame(job_system_t* js, u32_t records_per_task, u32_t* out_dropped) {
+  eden_debug_t* d = &eden->debug;
+
+  test_debug_records_task_t tasks[TEST_DEBUG_RECORDS_TASKS];
+  job_counter_t counter = {};
+  for_arr(i, tasks) {
+    tasks[i].task_index = i;
+    tasks[i].record_count = records_per_task;
+    job_add(js, test_debug_records_task, tasks + i, &counter);
+  }
+  job_wait(js, &counter);
+  eden_debug_end_frame(d);
+
+  // the read buffer is the one that was written to
+  eden_debug_record_buffer_t* buffer = d->record_buffers + (d->write_buffer_index ^ 1);
+  u32_t total = TEST_DEBUG_RECORDS_TASKS * records_per_task;
+  u32_t kept = min_of(buffer->record_count, buffer->record_cap);
+  test_debug_records_check(buffer->record_count == total);
+  test_debug_records_check(kept + d->overflow_count == total);
+
+  // every task's values are there once and only once
+  u32_t seen[TEST_DEBUG_RECORDS_TASKS] = {};
+  u64_t value_sum[TEST_DEBUG_RECORDS_TASKS] = {};
+  for (u32_t record_index = 0; record_index < kept; ++record_index) {
+    eden_debug_record_t* record = buffer->records + record_index;
+    test_debug_records_check(record->is_ready);
+    test_debug_records_check(record->type == EDEN_DEBUG_TYPE_U32);
+
+    u32_t task_index = 0;
+    while (test_debug_records_names[task_index] != record->guid) ++task_index;
+    test_debug_records_check(record->inspect_u32 < records_per_task);
+    ++seen[task_index];
+    value_sum[task_index] += record->inspect_u32;
+  }
+  if (d->overflow_count == 0) {
+    for_arr(i, seen) {
+      test_debug_records_check(seen[i] == records_per_task);
+      test_debug_records_check(value_sum[i] == (u64_t)records_per_task * (records_per_task - 1) / 2);
+    }
+  }
+
+  // processing makes one element per name, which stays around
+  eden_debug_process_records(d);
+  for_arr(i, test_debug_records_names) {
+    u32_t found = 0;
+    for (eden_debug_element_t* itr = d->linked_elements; itr; itr = itr->next_in_link)
+      found += itr->guid == test_debug_records_names[i];
+    test_debug_records_check(found <= 1 && (found == 1 || !seen[i]));
+  }
+
+  *out_dropped = d->overflow_count;
+  return true;
+}
+
+int main() {
+  static eden_t e = {};
+  eden_globalize(&e);
+
+  arena_t arena = {};
+  if (!arena_alloc(&arena, megabytes(16))) {
+    printf("Failed to allocate arena\n");
+    return 1;
+  }
+  defer { arena_free(&arena); };
+
+  if (!eden_debug_init(&eden->debug)) {
+    printf("Failed to init debug\n");
+    return 1;
+  }
+  defer { arena_free(&eden->debug.arena); };
+
+  job_system_t js = {};
+  if (!job_system_init(&js, 4, 1024, &arena)) {
+    printf("Failed to init job system\n");
+    return 1;
+  }
+  defer { job_system_free(&js); };
+
+  // fits
+  u32_t dropped = 0;
+  if (!test_debug_records_frame(&js, 32, &dropped)) return 1;
+  if (dropped != 0) { printf("FAILED: dropped %u records that fit\n", dropped); return 1; }
+  printf("fits: OK\n");
+
+  // overflows, then both buffers grow over the next two swaps
+  u32_t heavy = EDEN_DEBUG_INITIAL_RECORD_CAP;
+  if (!test_debug_records_frame(&js, heavy, &dropped)) return 1;
+  if (dropped == 0) { printf("FAILED: nothing dropped\n"); return 1; }
+  printf("overflow: OK (%u dropped)\n", dropped);
+
+  for (u32_t frame = 0; frame < 4; ++frame) {
+    if (!test_debug_records_frame(&js, heavy, &dropped)) return 1;
+  }
+  if (dropped != 0) { printf("FAILED: still dropping %u records after growing\n", dropped); return 1; }
+  printf("growth: OK (caps %u and %u, %u dropped in total)\n",
+      eden->debug.record_buffers[0].record_cap,
+      eden->debug.record_buffers[1].record_cap,
+      (u32_t)eden->debug.total_overflow_count);
+
+  // empty frame
+  if (!test_debug_records_frame(&js, 0, &dropped)) return 1;
+  printf("empty: OK\n");
+
+  return 0;
+}
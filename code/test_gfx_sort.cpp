@@ -0,0 +1,314 @@
+//
+// CPU-side benchmark for eden_gfx_sort_commands().
+//
+// Runs the OpenGL backend's eden_opengl_end_frame() with stubbed out
+// GL functions, so no GPU (or window) is needed. Builds a mixed stream
+// of ~50k commands that looks like a UI-heavy frame: panels (rects),
+// icons (sprites from one atlas), text (sprites from a font atlas)
+// and some additive glows (triangles), all interleaved.
+//
+// Reports the flush and draw call counts with and without sorting,
+// and checks that the sorted order keeps barriers, blend states and
+// submission order where it has to.
+//
+// Build optimized, e.g.
+//   clang++ -std=c++17 -O2 -march=native -DEDEN_DEBUG=1 -DEDEN_USE_OPENGL=1 test_gfx_sort.cpp
+//
+
+#include <stdio.h>
+
+#include "eden.h"
+
+#define TEST_GFX_SORT_COMMAND_COUNT   50000
+#define TEST_GFX_SORT_MAX_ELEMENTS    65536
+#define TEST_GFX_SORT_TEXTURE_COUNT   4
+#define TEST_GFX_SORT_RUNS            10
+
+#define TEST_GFX_SORT_BLANK_TEXTURE   0
+#define TEST_GFX_SORT_ICON_TEXTURE    1
+#define TEST_GFX_SORT_FONT_TEXTURE    2
+
+//
+// GL stubs
+//
+static void test_gfx_sort_glScissor(GLint x, GLint y, GLsizei width, GLsizei height) {}
+static void test_gfx_sort_glViewport(GLint x, GLint y, GLsizei width, GLsizei height) {}
+static void test_gfx_sort_glClearColor(GLclampf r, GLclampf g, GLclampf b, GLclampf a) {}
+static void test_gfx_sort_glClear(GLbitfield mask) {}
+static void test_gfx_sort_glNamedBufferData(GLuint buffer, GLsizeiptr size, const void* data, GLenum usage) {}
+static void test_gfx_sort_glNamedBufferSubData(GLuint buffer, GLintptr offset, GLsizeiptr size, const void* data) {}
+static void test_gfx_sort_glUseProgram(GLuint program) {}
+static void test_gfx_sort_glBindVertexArray(GLuint array) {}
+static void test_gfx_sort_glBindTexture(GLenum target, GLuint texture) {}
+static void test_gfx_sort_glTexParameteri(GLenum target, GLenum pname, GLint param) {}
+static void test_gfx_sort_glDrawElements(GLenum mode, GLsizei count, GLenum type, const void* indices) {}
+static void test_gfx_sort_glDrawArrays(GLenum mode, GLint first, GLsizei count) {}
+static void test_gfx_sort_glProgramUniformMatrix4fv(GLuint program, GLint location, GLsizei count, GLboolean transpose, const GLfloat* value) {}
+static void test_gfx_sort_glBlendFunc(GLenum sfactor, GLenum dfactor) {}
+
+// Does what eden_opengl_init() does, minus the GL calls.
+static b32_t
+test_gfx_sort_init(eden_gfx_t* gfx, eden_opengl_t* ogl, arena_t* arena)
+{
+  gfx->platform_data = ogl;
+  if (!eden_gfx_init(gfx, arena, kilobytes(1), TEST_GFX_SORT_COMMAND_COUNT + 64, TEST_GFX_SORT_TEXTURE_COUNT, 4))
+    return false;
+
+  ogl->glScissor = test_gfx_sort_glScissor;
+  ogl->glViewport = test_gfx_sort_glViewport;
+  ogl->glClearColor = test_gfx_sort_glClearColor;
+  ogl->glClear = test_gfx_sort_glClear;
+  ogl->glNamedBufferData = test_gfx_sort_glNamedBufferData;
+  ogl->glNamedBufferSubData = test_gfx_sort_glNamedBufferSubData;
+  ogl->glUseProgram = test_gfx_sort_glUseProgram;
+  ogl->glBindVertexArray = test_gfx_sort_glBindVertexArray;
+  ogl->glBindTexture = test_gfx_sort_glBindTexture;
+  ogl->glTexParameteri = test_gfx_sort_glTexParameteri;
+  ogl->glDrawElements = test_gfx_sort_glDrawElements;
+  ogl->glDrawArrays = test_gfx_sort_glDrawArrays;
+  ogl->glProgramUniformMatrix4fv = test_gfx_sort_glProgramUniformMatrix4fv;
+  ogl->glBlendFunc = test_gfx_sort_glBlendFunc;
+
+  ogl->textures = arena_push_arr(eden_opengl_texture_t, arena, TEST_GFX_SORT_TEXTURE_COUNT);
+  if (!ogl->textures) return false;
+  ogl->texture_cap = TEST_GFX_SORT_TEXTURE_COUNT;
+  for (u32_t i = 0; i < TEST_GFX_SORT_TEXTURE_COUNT; ++i) {
+    ogl->textures[i].handle = i + 1;
+    ogl->textures[i].width = 1024;
+    ogl->textures[i].height = 1024;
+  }
+  ogl->blank_texture = ogl->textures[TEST_GFX_SORT_BLANK_TEXTURE];
+
+  eden_opengl_batch_t* batch = &ogl->batch;
+  batch->element_count = TEST_GFX_SORT_MAX_ELEMENTS;
+  batch->vertex_count = batch->element_count*4;
+  batch->frames_in_flight = 1;
+  batch->staging = arena_push_arr(eden_opengl_vertex_t, arena, batch->vertex_count);
+  if (!batch->staging)
+    return false;
+
+  ogl->render_wh = v2u_set(1600, 900);
+  ogl->region_x1 = 1600;
+  ogl->region_y1 = 900;
+  return true;
+}
+
+//
+// The command stream
+//
+static void
+test_gfx_sort_push_text(eden_gfx_t* gfx, rng_t* rng, v2f_t pos, u32_t length)
+{
+  for (u32_t i = 0; i < length; ++i) {
+    u32_t glyph = rng_range_u32(rng, 0, 64);
+    eden_gfx_push_sprite_command(gfx,
+        pos + v2f_set(8.f * i, 0.f), v2f_set(8.f, 12.f), v2f_set(0.f, 0.f),
+        TEST_GFX_SORT_FONT_TEXTURE,
+        (glyph % 8) * 16, (glyph / 8) * 16, (glyph % 8) * 16 + 16, (glyph / 8) * 16 + 16,
+        rgba_hex(0xFFFFFFFF));
+  }
+}
+
+// Panels with an icon and some text each, where every now and then
+// a panel has some additive glow and a new window starts.
+static void
+test_gfx_sort_build_frame(eden_gfx_t* gfx, u32_t command_count)
+{
+  rng_t rng;
+  rng_init(&rng, 1234);
+
+  eden_gfx_clear_commands(gfx);
+  eden_gfx_push_clear_command(gfx, rgba_hex(0x000000FF));
+  eden_gfx_push_view_command(gfx, 0.f, 1600.f, 0.f, 900.f, 0.f, 0.f);
+  eden_gfx_push_blend_command(gfx, EDEN_GFX_BLEND_TYPE_SRC_ALPHA, EDEN_GFX_BLEND_TYPE_INV_SRC_ALPHA);
+
+  u32_t panel_index = 0;
+  while (gfx->command_count + 32 < command_count)
+  {
+    v2f_t pos = v2f_set(rng_range_f32(&rng, 0.f, 1500.f), rng_range_f32(&rng, 0.f, 850.f));
+
+    // a new window every 64 panels
+    if (panel_index % 64 == 63) {
+      eden_gfx_push_barrier_command(gfx);
+    }
+
+    eden_gfx_set_layer(gfx, 0);
+    eden_gfx_push_rect_command(gfx, pos, 0.f, v2f_set(100.f, 40.f), rgba_hex(0x333333CC));
+
+    eden_gfx_set_layer(gfx, 1);
+    eden_gfx_push_sprite_command(gfx,
+        pos, v2f_set(32.f, 32.f), v2f_set(0.f, 0.f),
+        TEST_GFX_SORT_ICON_TEXTURE, 0, 0, 32, 32, rgba_hex(0xFFFFFFFF));
+
+    eden_gfx_set_layer(gfx, 2);
+    test_gfx_sort_push_text(gfx, &rng, pos + v2f_set(36.f, 4.f), rng_range_u32(&rng, 4, 16));
+
+    if (panel_index % 16 == 0) {
+      eden_gfx_push_blend_command(gfx, EDEN_GFX_BLEND_TYPE_SRC_ALPHA, EDEN_GFX_BLEND_TYPE_ONE);
+      for (u32_t i = 0; i < 4; ++i) {
+        eden_gfx_push_triangle_command(gfx,
+            pos, pos + v2f_set(50.f, 10.f * i), pos + v2f_set(10.f * i, 50.f),
+            rgba_hex(0x88440044));
+      }
+      eden_gfx_push_blend_command(gfx, EDEN_GFX_BLEND_TYPE_SRC_ALPHA, EDEN_GFX_BLEND_TYPE_INV_SRC_ALPHA);
+    }
+    ++panel_index;
+  }
+}
+
+//
+// Checks that the sorted order is something we are allowed to draw.
+//
+static b32_t
+test_gfx_sort_is_draw(eden_gfx_command_t* cmd) {
+  return
+    cmd->type == EDEN_GFX_COMMAND_TYPE_TRIANGLE ||
+    cmd->type == EDEN_GFX_COMMAND_TYPE_RECT ||
+    cmd->type == EDEN_GFX_COMMAND_TYPE_SPRITE;
+}
+
+static b32_t
+test_gfx_sort_validate(eden_gfx_t* gfx, arena_t* arena)
+{
+  arena_set_revert_point(arena);
+  eden_gfx_sorter_t* s = &gfx->sorter;
+
+  // For each command in submission order: which run (between barriers)
+  // it is in and which blend command it was submitted under.
+  u32_t* runs = arena_push_arr(u32_t, arena, gfx->command_count);
+  u32_t* blends = arena_push_arr(u32_t, arena, gfx->command_count);
+  u32_t* seen = arena_push_arr_zero(u32_t, arena, gfx->command_count);
+  assert(runs && blends && seen);
+
+  u32_t run = 0;
+  u32_t blend = U32_MAX;
+  for (u32_t i = 0; i < gfx->command_count; ++i) {
+    eden_gfx_command_t* cmd = gfx->commands + i;
+    if (cmd->type == EDEN_GFX_COMMAND_TYPE_BLEND) blend = i;
+    else if (!test_gfx_sort_is_draw(cmd)) ++run;
+    runs[i] = run;
+    blends[i] = blend;
+  }
+  u32_t submitted_final_blend = blend;
+
+  run = 0;
+  blend = U32_MAX;
+  u32_t prev_draw = U32_MAX;
+  for (u32_t order_index = 0; order_index < s->order_count; ++order_index) {
+    u32_t i = s->order[order_index];
+    eden_gfx_command_t* cmd = gfx->commands + i;
+    if (cmd->type == EDEN_GFX_COMMAND_TYPE_BLEND) {
+      blend = i;
+      continue;
+    }
+    ++seen[i];
+
+    if (!test_gfx_sort_is_draw(cmd)) {
+      ++run;
+      if (runs[i] != run) {
+        printf("barrier %u moved\n", i);
+        return false;
+      }
+      prev_draw = U32_MAX;
+      continue;
+    }
+
+    if (runs[i] != run) {
+      printf("command %u moved across a barrier\n", i);
+      return false;
+    }
+    if (!_eden_gfx_is_same_blend(gfx, blend, blends[i])) {
+      printf("command %u drawn with the wrong blend state\n", i);
+      return false;
+    }
+    if (prev_draw != U32_MAX) {
+      eden_gfx_command_t* prev = gfx->commands + prev_draw;
+      if (prev->layer > cmd->layer) {
+        printf("command %u is on a lower layer than the one before it\n", i);
+        return false;
+      }
+      f32_t prev_key = _eden_gfx_get_sort_key(gfx, prev, blends[prev_draw]);
+      f32_t key = _eden_gfx_get_sort_key(gfx, cmd, blends[i]);
+      if (prev_key == key && prev_draw > i) {
+        printf("commands %u and %u swapped even though they have the same key\n", prev_draw, i);
+        return false;
+      }
+    }
+    prev_draw = i;
+  }
+
+  for (u32_t i = 0; i < gfx->command_count; ++i) {
+    if (gfx->commands[i].type != EDEN_GFX_COMMAND_TYPE_BLEND && seen[i] != 1) {
+      printf("command %u was emitted %u times\n", i, seen[i]);
+      return false;
+    }
+  }
+  if (!_eden_gfx_is_same_blend(gfx, blend, submitted_final_blend)) {
+    printf("blend state at the end of the frame is different\n");
+    return false;
+  }
+  return true;
+}
+
+int main() {
+  static eden_t e = {};
+  eden_globalize(&e);
+
+  arena_t arena = {};
+  if (!arena_alloc(&arena, megabytes(256))) {
+    printf("Failed to allocate arena\n");
+    return 1;
+  }
+  defer { arena_free(&arena); };
+
+  if (!eden_profiler_init(&eden->profiler, &arena, 16, 4, 0, 0)) {
+    printf("Failed to init profiler\n");
+    return 1;
+  }
+
+  static eden_opengl_t ogl = {};
+  eden_gfx_t* gfx = &eden->gfx;
+  if (!test_gfx_sort_init(gfx, &ogl, &arena)) {
+    printf("Failed to init gfx\n");
+    return 1;
+  }
+
+  test_gfx_sort_build_frame(gfx, TEST_GFX_SORT_COMMAND_COUNT);
+  u32_t command_count = gfx->command_count;
+  printf("commands: %u\n\n", command_count);
+
+  printf("%-10s %10s %10s %16s %16s\n", "mode", "flushes", "draws", "end_frame (ms)", "sort (ms)");
+  for (u32_t mode = 0; mode < 2; ++mode)
+  {
+    b32_t sort = (mode == 1);
+    f64_t best_frame = F64_INFINITY;
+    f64_t best_sort = F64_INFINITY;
+    for (u32_t run = 0; run < TEST_GFX_SORT_RUNS; ++run)
+    {
+      // @note: eden_opengl_end_frame() doesn't touch the commands,
+      // so they can be reused every run.
+      gfx->is_sorting_enabled = sort;
+      u64_t start = clock_time();
+      eden_opengl_end_frame(gfx);
+      u64_t end = clock_time();
+      best_frame = min_of(best_frame, (f64_t)(end - start) * 1000.0 / clock_resolution());
+
+      if (sort) {
+        start = clock_time();
+        eden_gfx_sort_commands(gfx);
+        end = clock_time();
+        best_sort = min_of(best_sort, (f64_t)(end - start) * 1000.0 / clock_resolution());
+      }
+    }
+
+    if (sort && !test_gfx_sort_validate(gfx, &arena)) {
+      return 1;
+    }
+
+    printf("%-10s %10u %10u %16.3f ", sort ? "sorted" : "unsorted", ogl.flush_count, ogl.draw_count, best_frame);
+    if (sort) printf("%16.3f\n", best_sort);
+    else printf("%16s\n", "-");
+  }
+
+  return 0;
+}
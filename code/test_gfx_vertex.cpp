@@ -0,0 +1,446 @@
+//
+// Tests for the OpenGL backend's interleaved vertex format and its
+// streaming vertex buffer.
+//
+// eden_opengl_pack_quad() and eden_opengl_pack_triangle() are tested
+// as they are since they don't touch GL. The streaming buffer is tested
+// by running eden_opengl_batch_init() and eden_opengl_end_frame() with
+// stubbed out GL functions, once with a persistently mapped buffer
+// (where the stubs pretend to be a GPU that lags behind) and with the
+// orphaning fallback, both when mapping is not there and when it fails.
+//
+// Build e.g.
+//   clang++ -std=c++17 -O2 -DEDEN_DEBUG=1 -DEDEN_USE_OPENGL=1 test_gfx_vertex.cpp
+//
+
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "eden.h"
+
+#define TEST_GFX_VERTEX_MAX_ELEMENTS  64
+#define TEST_GFX_VERTEX_FRAMES        12
+
+#define test_gfx_vertex_check(cond) \
+  if (!(cond)) { printf("FAILED (line %d): %s\n", __LINE__, #cond); return false; }
+
+//
+// A pretend GPU and driver
+//
+struct test_gfx_vertex_gl_t {
+  // vertex buffer
+  eden_opengl_vertex_t* storage;
+  usz_t storage_size;
+  GLuint persistent_buffer;
+  GLuint deleted_buffer;
+  u32_t deleted_buffer_count;
+  b32_t is_map_failing;
+  u32_t orphan_count;
+  u32_t upload_count;
+  GLintptr bound_offset;
+  GLuint attrib_offsets[3];
+  GLint attrib_sizes[3];
+
+  // fences are just increasing numbers and the GPU is done with
+  // everything up to 'completed_fence'
+  u64_t issued_fence;
+  u64_t completed_fence;
+  u32_t live_fence_count;
+  b32_t is_gpu_lagging;
+
+  u32_t draw_count;
+};
+static test_gfx_vertex_gl_t test_gfx_vertex_gl;
+
+static void test_gfx_vertex_glScissor(GLint x, GLint y, GLsizei width, GLsizei height) {}
+static void test_gfx_vertex_glViewport(GLint x, GLint y, GLsizei width, GLsizei height) {}
+static void test_gfx_vertex_glClearColor(GLclampf r, GLclampf g, GLclampf b, GLclampf a) {}
+static void test_gfx_vertex_glClear(GLbitfield mask) {}
+static void test_gfx_vertex_glUseProgram(GLuint program) {}
+static void test_gfx_vertex_glBindVertexArray(GLuint array) {}
+static void test_gfx_vertex_glBindTexture(GLenum target, GLuint texture) {}
+static void test_gfx_vertex_glTexParameteri(GLenum target, GLenum pname, GLint param) {}
+static void test_gfx_vertex_glProgramUniformMatrix4fv(GLuint program, GLint location, GLsizei count, GLboolean transpose, const GLfloat* value) {}
+static void test_gfx_vertex_glBlendFunc(GLenum sfactor, GLenum dfactor) {}
+static GLuint test_gfx_vertex_glCreateProgram() { return 1; }
+static GLuint test_gfx_vertex_glCreateShader(GLenum type) { return 1; }
+static void test_gfx_vertex_glShaderSource(GLuint shader, GLsizei count, GLchar** string, GLint* length) {}
+static void test_gfx_vertex_glCompileShader(GLuint shader) {}
+static void test_gfx_vertex_glAttachShader(GLuint program, GLuint shader) {}
+static void test_gfx_vertex_glDeleteShader(GLuint shader) {}
+static void test_gfx_vertex_glLinkProgram(GLuint program) {}
+static void test_gfx_vertex_glGetProgramiv(GLuint program, GLenum pname, GLint* params) { *params = GL_TRUE; }
+static GLint test_gfx_vertex_glGetUniformLocation(GLuint program, const GLchar* name) { return 0; }
+static void test_gfx_vertex_glCreateVertexArrays(GLsizei n, GLuint* arrays) { *arrays = 1; }
+static void test_gfx_vertex_glEnableVertexArrayAttrib(GLuint vaobj, GLuint index) {}
+static void test_gfx_vertex_glVertexArrayAttribBinding(GLuint vaobj, GLuint attribindex, GLuint bindingindex) {}
+static void test_gfx_vertex_glVertexArrayElementBuffer(GLuint vaobj, GLuint buffer) {}
+
+static void
+test_gfx_vertex_glCreateBuffers(GLsizei n, GLuint* buffers) {
+  static GLuint next = 1;
+  *buffers = next++;
+}
+
+static void
+test_gfx_vertex_glNamedBufferStorage(GLuint buffer, GLsizeiptr size, const void* data, GLbitfield flags) {
+  // @note: only the vertex buffer is mapped
+  if (flags & GL_MAP_PERSISTENT_BIT) {
+    test_gfx_vertex_gl.storage = (eden_opengl_vertex_t*)malloc(size);
+    test_gfx_vertex_gl.storage_size = size;
+    test_gfx_vertex_gl.persistent_buffer = buffer;
+  }
+}
+
+static void*
+test_gfx_vertex_glMapNamedBufferRange(GLuint buffer, GLintptr offset, GLsizeiptr length, GLbitfield access) {
+  if (test_gfx_vertex_gl.is_map_failing)
+    return nullptr;
+  return test_gfx_vertex_gl.storage;
+}
+
+static void
+test_gfx_vertex_glDeleteBuffers(GLsizei n, const GLuint* buffers) {
+  assert(n == 1);
+  if (buffers[0] == test_gfx_vertex_gl.persistent_buffer) {
+    free(test_gfx_vertex_gl.storage);
+    test_gfx_vertex_gl.storage = nullptr;
+    test_gfx_vertex_gl.storage_size = 0;
+  }
+  test_gfx_vertex_gl.deleted_buffer = buffers[0];
+  ++test_gfx_vertex_gl.deleted_buffer_count;
+}
+
+static void
+test_gfx_vertex_glNamedBufferData(GLuint buffer, GLsizeiptr size, const void* data, GLenum usage) {
+  if (!test_gfx_vertex_gl.storage) {
+    test_gfx_vertex_gl.storage = (eden_opengl_vertex_t*)malloc(size);
+    test_gfx_vertex_gl.storage_size = size;
+  }
+  ++test_gfx_vertex_gl.orphan_count;
+}
+
+static void
+test_gfx_vertex_glNamedBufferSubData(GLuint buffer, GLintptr offset, GLsizeiptr size, const void* data) {
+  assert(offset + size <= (GLintptr)test_gfx_vertex_gl.storage_size);
+  memory_copy((u8_t*)test_gfx_vertex_gl.storage + offset, data, size);
+  ++test_gfx_vertex_gl.upload_count;
+}
+
+static void
+test_gfx_vertex_glVertexArrayVertexBuffer(GLuint vaobj, GLuint bindingindex, GLuint buffer, GLintptr offset, GLsizei stride) {
+  assert(stride == sizeof(eden_opengl_vertex_t));
+  test_gfx_vertex_gl.bound_offset = offset;
+}
+
+static void
+test_gfx_vertex_glVertexArrayAttribFormat(GLuint vaobj, GLuint attribindex, GLint size, GLenum type, GLboolean normalized, GLuint relativeoffset) {
+  assert(attribindex < 3);
+  test_gfx_vertex_gl.attrib_offsets[attribindex] = relativeoffset;
+  test_gfx_vertex_gl.attrib_sizes[attribindex] = size;
+}
+
+static void
+test_gfx_vertex_glDrawElements(GLenum mode, GLsizei count, GLenum type, const void* indices) {
+  ++test_gfx_vertex_gl.draw_count;
+}
+
+static void
+test_gfx_vertex_glDrawArrays(GLenum mode, GLint first, GLsizei count) {
+  ++test_gfx_vertex_gl.draw_count;
+}
+
+static GLsync
+test_gfx_vertex_glFenceSync(GLenum condition, GLbitfield flags) {
+  ++test_gfx_vertex_gl.live_fence_count;
+  u64_t fence = ++test_gfx_vertex_gl.issued_fence;
+
+  // a GPU that keeps up finishes the frame right away
+  if (!test_gfx_vertex_gl.is_gpu_lagging)
+    test_gfx_vertex_gl.completed_fence = fence;
+  return (GLsync)(umi_t)fence;
+}
+
+static GLenum
+test_gfx_vertex_glClientWaitSync(GLsync sync, GLbitfield flags, GLuint64 timeout) {
+  u64_t fence = (u64_t)(umi_t)sync;
+  if (fence <= test_gfx_vertex_gl.completed_fence)
+    return GL_ALREADY_SIGNALED;
+  if (timeout == 0)
+    return GL_TIMEOUT_EXPIRED;
+
+  // a lagging GPU catches up when we wait for it
+  test_gfx_vertex_gl.completed_fence = fence;
+  return GL_CONDITION_SATISFIED;
+}
+
+static void
+test_gfx_vertex_glDeleteSync(GLsync sync) {
+  assert(test_gfx_vertex_gl.live_fence_count > 0);
+  --test_gfx_vertex_gl.live_fence_count;
+}
+
+static b32_t
+test_gfx_vertex_init(eden_gfx_t* gfx, eden_opengl_t* ogl, arena_t* arena, b32_t can_map, u32_t frames_in_flight, b32_t is_map_failing = false)
+{
+  free(test_gfx_vertex_gl.storage);
+  test_gfx_vertex_gl = {};
+  test_gfx_vertex_gl.is_map_failing = is_map_failing;
+  *ogl = {};
+  arena_clear(arena);
+
+  gfx->platform_data = ogl;
+  if (!eden_gfx_init(gfx, arena, kilobytes(1), 256, 1, 1))
+    return false;
+
+  ogl->glScissor = test_gfx_vertex_glScissor;
+  ogl->glViewport = test_gfx_vertex_glViewport;
+  ogl->glClearColor = test_gfx_vertex_glClearColor;
+  ogl->glClear = test_gfx_vertex_glClear;
+  ogl->glUseProgram = test_gfx_vertex_glUseProgram;
+  ogl->glBindVertexArray = test_gfx_vertex_glBindVertexArray;
+  ogl->glBindTexture = test_gfx_vertex_glBindTexture;
+  ogl->glTexParameteri = test_gfx_vertex_glTexParameteri;
+  ogl->glProgramUniformMatrix4fv = test_gfx_vertex_glProgramUniformMatrix4fv;
+  ogl->glBlendFunc = test_gfx_vertex_glBlendFunc;
+  ogl->glCreateProgram = test_gfx_vertex_glCreateProgram;
+  ogl->glCreateShader = test_gfx_vertex_glCreateShader;
+  ogl->glShaderSource = test_gfx_vertex_glShaderSource;
+  ogl->glCompileShader = test_gfx_vertex_glCompileShader;
+  ogl->glAttachShader = test_gfx_vertex_glAttachShader;
+  ogl->glDeleteShader = test_gfx_vertex_glDeleteShader;
+  ogl->glLinkProgram = test_gfx_vertex_glLinkProgram;
+  ogl->glGetProgramiv = test_gfx_vertex_glGetProgramiv;
+  ogl->glGetUniformLocation = test_gfx_vertex_glGetUniformLocation;
+  ogl->glCreateBuffers = test_gfx_vertex_glCreateBuffers;
+  ogl->glDeleteBuffers = test_gfx_vertex_glDeleteBuffers;
+  ogl->glNamedBufferStorage = test_gfx_vertex_glNamedBufferStorage;
+  ogl->glNamedBufferData = test_gfx_vertex_glNamedBufferData;
+  ogl->glNamedBufferSubData = test_gfx_vertex_glNamedBufferSubData;
+  ogl->glCreateVertexArrays = test_gfx_vertex_glCreateVertexArrays;
+  ogl->glVertexArrayVertexBuffer = test_gfx_vertex_glVertexArrayVertexBuffer;
+  ogl->glEnableVertexArrayAttrib = test_gfx_vertex_glEnableVertexArrayAttrib;
+  ogl->glVertexArrayAttribFormat = test_gfx_vertex_glVertexArrayAttribFormat;
+  ogl->glVertexArrayAttribBinding = test_gfx_vertex_glVertexArrayAttribBinding;
+  ogl->glVertexArrayElementBuffer = test_gfx_vertex_glVertexArrayElementBuffer;
+  ogl->glDrawElements = test_gfx_vertex_glDrawElements;
+  ogl->glDrawArrays = test_gfx_vertex_glDrawArrays;
+  if (can_map) {
+    ogl->glMapNamedBufferRange = test_gfx_vertex_glMapNamedBufferRange;
+    ogl->glFenceSync = test_gfx_vertex_glFenceSync;
+    ogl->glClientWaitSync = test_gfx_vertex_glClientWaitSync;
+    ogl->glDeleteSync = test_gfx_vertex_glDeleteSync;
+  }
+
+  ogl->textures = arena_push_arr(eden_opengl_texture_t, arena, 1);
+  if (!ogl->textures) return false;
+  ogl->texture_cap = 1;
+  ogl->textures[0].handle = 1;
+  ogl->textures[0].width = 16;
+  ogl->textures[0].height = 16;
+  ogl->blank_texture = ogl->textures[0];
+
+  ogl->render_wh = v2u_set(1600, 900);
+  ogl->region_x1 = 1600;
+  ogl->region_y1 = 900;
+
+  return eden_opengl_batch_init(ogl, arena, TEST_GFX_VERTEX_MAX_ELEMENTS, frames_in_flight);
+}
+
+//
+// Tests
+//
+static b32_t
+test_gfx_vertex_is_same(eden_opengl_vertex_t* v, v3f_t pos, v2f_t uv, rgba_t color)
+{
+  return
+    v->pos.x == pos.x && v->pos.y == pos.y && v->pos.z == pos.z &&
+    v->uv.x == uv.x && v->uv.y == uv.y &&
+    v->color.r == color.r && v->color.g == color.g && v->color.b == color.b && v->color.a == color.a;
+}
+
+static b32_t
+test_gfx_vertex_pack()
+{
+  // layout that the shader expects
+  test_gfx_vertex_check(sizeof(eden_opengl_vertex_t) == 36);
+  test_gfx_vertex_check(offset_of(eden_opengl_vertex_t, pos) == 0);
+  test_gfx_vertex_check(offset_of(eden_opengl_vertex_t, uv) == 12);
+  test_gfx_vertex_check(offset_of(eden_opengl_vertex_t, color) == 20);
+
+  eden_opengl_vertex_t v[8] = {};
+  eden_opengl_pack_quad(v + 1,
+      v3f_set(1,2,3), v3f_set(4,5,6), v3f_set(7,8,9), v3f_set(10,11,12),
+      v2f_set(0.1f,0.2f), v2f_set(0.3f,0.4f), v2f_set(0.5f,0.6f), v2f_set(0.7f,0.8f),
+      rgba_set(1,0,0,1), rgba_set(0,1,0,1), rgba_set(0,0,1,1), rgba_set(1,1,1,0.5f));
+  test_gfx_vertex_check(test_gfx_vertex_is_same(v + 1, v3f_set(1,2,3), v2f_set(0.1f,0.2f), rgba_set(1,0,0,1)));
+  test_gfx_vertex_check(test_gfx_vertex_is_same(v + 2, v3f_set(4,5,6), v2f_set(0.3f,0.4f), rgba_set(0,1,0,1)));
+  test_gfx_vertex_check(test_gfx_vertex_is_same(v + 3, v3f_set(7,8,9), v2f_set(0.5f,0.6f), rgba_set(0,0,1,1)));
+  test_gfx_vertex_check(test_gfx_vertex_is_same(v + 4, v3f_set(10,11,12), v2f_set(0.7f,0.8f), rgba_set(1,1,1,0.5f)));
+
+  eden_opengl_pack_triangle(v + 5,
+      v3f_set(-1,-2,-3), v3f_set(-4,-5,-6), v3f_set(-7,-8,-9),
+      v2f_set(1,0), v2f_set(0,1), v2f_set(1,1),
+      rgba_set(0.25f,0,0,1), rgba_set(0,0.25f,0,1), rgba_set(0,0,0.25f,1));
+  test_gfx_vertex_check(test_gfx_vertex_is_same(v + 5, v3f_set(-1,-2,-3), v2f_set(1,0), rgba_set(0.25f,0,0,1)));
+  test_gfx_vertex_check(test_gfx_vertex_is_same(v + 6, v3f_set(-4,-5,-6), v2f_set(0,1), rgba_set(0,0.25f,0,1)));
+  test_gfx_vertex_check(test_gfx_vertex_is_same(v + 7, v3f_set(-7,-8,-9), v2f_set(1,1), rgba_set(0,0,0.25f,1)));
+
+  // neighbours are untouched
+  eden_opengl_vertex_t zero = {};
+  test_gfx_vertex_check(memory_is_same(v + 0, &zero, sizeof(zero)));
+
+  return true;
+}
+
+// Every frame draws one rect (4 vertices) and one triangle (3 vertices)
+// whose positions depend on the frame.
+static void
+test_gfx_vertex_build_frame(eden_gfx_t* gfx, u32_t frame)
+{
+  f32_t x = (f32_t)(frame * 10);
+  eden_gfx_clear_commands(gfx);
+  eden_gfx_push_view_command(gfx, 0.f, 1600.f, 0.f, 900.f, 0.f, 0.f);
+  eden_gfx_push_rect_command(gfx, v2f_set(x + 2.f, 3.f), 0.f, v2f_set(4.f, 6.f), rgba_set(1.f, 0.f, 0.f, 1.f));
+  eden_gfx_push_triangle_command(gfx, v2f_set(x, 0.f), v2f_set(x + 1.f, 0.f), v2f_set(x, 1.f), rgba_set(0.f, 1.f, 0.f, 1.f));
+}
+
+static b32_t
+test_gfx_vertex_check_frame(eden_opengl_vertex_t* v, u32_t frame)
+{
+  f32_t x = (f32_t)(frame * 10);
+  rgba_t red = rgba_set(1.f, 0.f, 0.f, 1.f);
+  rgba_t green = rgba_set(0.f, 1.f, 0.f, 1.f);
+  test_gfx_vertex_check(test_gfx_vertex_is_same(v + 0, v3f_set(x + 0.f, 0.f, 0.f), v2f_set(0.f, 0.f), red));
+  test_gfx_vertex_check(test_gfx_vertex_is_same(v + 1, v3f_set(x + 4.f, 0.f, 0.f), v2f_set(1.f, 0.f), red));
+  test_gfx_vertex_check(test_gfx_vertex_is_same(v + 2, v3f_set(x + 4.f, 6.f, 0.f), v2f_set(1.f, 1.f), red));
+  test_gfx_vertex_check(test_gfx_vertex_is_same(v + 3, v3f_set(x + 0.f, 6.f, 0.f), v2f_set(0.f, 1.f), red));
+  test_gfx_vertex_check(test_gfx_vertex_is_same(v + 4, v3f_set(x, 0.f, 0.f), v2f_set(0.f, 0.f), green));
+  test_gfx_vertex_check(test_gfx_vertex_is_same(v + 5, v3f_set(x + 1.f, 0.f, 0.f), v2f_set(1.f, 0.f), green));
+  test_gfx_vertex_check(test_gfx_vertex_is_same(v + 6, v3f_set(x, 1.f, 0.f), v2f_set(1.f, 1.f), green));
+  return true;
+}
+
+static b32_t
+test_gfx_vertex_init_layout(eden_opengl_t* ogl)
+{
+  test_gfx_vertex_check(test_gfx_vertex_gl.attrib_offsets[0] == offset_of(eden_opengl_vertex_t, pos));
+  test_gfx_vertex_check(test_gfx_vertex_gl.attrib_offsets[1] == offset_of(eden_opengl_vertex_t, uv));
+  test_gfx_vertex_check(test_gfx_vertex_gl.attrib_offsets[2] == offset_of(eden_opengl_vertex_t, color));
+  test_gfx_vertex_check(test_gfx_vertex_gl.attrib_sizes[0] == 3);
+  test_gfx_vertex_check(test_gfx_vertex_gl.attrib_sizes[1] == 2);
+  test_gfx_vertex_check(test_gfx_vertex_gl.attrib_sizes[2] == 4);
+  return true;
+}
+
+static b32_t
+test_gfx_vertex_persistent(eden_gfx_t* gfx, eden_opengl_t* ogl, arena_t* arena, u32_t frames_in_flight, b32_t is_gpu_lagging)
+{
+  test_gfx_vertex_check(test_gfx_vertex_init(gfx, ogl, arena, true, frames_in_flight));
+  test_gfx_vertex_check(test_gfx_vertex_init_layout(ogl));
+
+  eden_opengl_batch_t* batch = &ogl->batch;
+  u32_t expected_fif = clamp_of(frames_in_flight, 1, EDEN_OPENGL_MAX_FRAMES_IN_FLIGHT);
+  usz_t region_vertex_count = TEST_GFX_VERTEX_MAX_ELEMENTS*4;
+  test_gfx_vertex_check(batch->is_persistent);
+  test_gfx_vertex_check(batch->frames_in_flight == expected_fif);
+  test_gfx_vertex_check(test_gfx_vertex_gl.storage_size == sizeof(eden_opengl_vertex_t)*region_vertex_count*expected_fif);
+
+  test_gfx_vertex_gl.is_gpu_lagging = is_gpu_lagging;
+  for (u32_t frame = 0; frame < TEST_GFX_VERTEX_FRAMES; ++frame)
+  {
+    test_gfx_vertex_build_frame(gfx, frame);
+    eden_opengl_end_frame(gfx);
+
+    u32_t region = frame % expected_fif;
+    eden_opengl_vertex_t* region_vertices = test_gfx_vertex_gl.storage + region*region_vertex_count;
+    test_gfx_vertex_check(test_gfx_vertex_gl.bound_offset == (GLintptr)(region*region_vertex_count*sizeof(eden_opengl_vertex_t)));
+    test_gfx_vertex_check(test_gfx_vertex_check_frame(region_vertices, frame));
+
+    // the regions of the frames still in flight are untouched
+    for (u32_t i = 1; i < expected_fif && i <= frame; ++i) {
+      u32_t older_frame = frame - i;
+      eden_opengl_vertex_t* older = test_gfx_vertex_gl.storage + (older_frame % expected_fif)*region_vertex_count;
+      test_gfx_vertex_check(test_gfx_vertex_check_frame(older, older_frame));
+    }
+
+    test_gfx_vertex_check(test_gfx_vertex_gl.live_fence_count == min_of(frame + 1, expected_fif));
+  }
+
+  test_gfx_vertex_check(test_gfx_vertex_gl.orphan_count == 0);
+  test_gfx_vertex_check(test_gfx_vertex_gl.upload_count == 0);
+  test_gfx_vertex_check(test_gfx_vertex_gl.draw_count == 2*TEST_GFX_VERTEX_FRAMES);
+
+  // a lagging GPU makes us wait once every region has been used
+  u32_t expected_waits = is_gpu_lagging ? TEST_GFX_VERTEX_FRAMES - expected_fif : 0;
+  test_gfx_vertex_check(batch->fence_wait_count == expected_waits);
+
+  printf("persistent: frames_in_flight=%u (asked %u) lagging=%u waits=%u OK\n",
+      expected_fif, frames_in_flight, is_gpu_lagging, batch->fence_wait_count);
+  return true;
+}
+
+static b32_t
+test_gfx_vertex_orphan(eden_gfx_t* gfx, eden_opengl_t* ogl, arena_t* arena, b32_t is_map_failing)
+{
+  test_gfx_vertex_check(test_gfx_vertex_init(gfx, ogl, arena, is_map_failing, 3, is_map_failing));
+  test_gfx_vertex_check(test_gfx_vertex_init_layout(ogl));
+
+  eden_opengl_batch_t* batch = &ogl->batch;
+  test_gfx_vertex_check(!batch->is_persistent);
+  test_gfx_vertex_check(batch->frames_in_flight == 1);
+
+  // the buffer that could not be mapped must not be leaked
+  if (is_map_failing) {
+    test_gfx_vertex_check(test_gfx_vertex_gl.deleted_buffer_count == 1);
+    test_gfx_vertex_check(test_gfx_vertex_gl.deleted_buffer == test_gfx_vertex_gl.persistent_buffer);
+    test_gfx_vertex_check(batch->vbo != test_gfx_vertex_gl.persistent_buffer);
+  }
+  else {
+    test_gfx_vertex_check(test_gfx_vertex_gl.deleted_buffer_count == 0);
+  }
+
+  for (u32_t frame = 0; frame < TEST_GFX_VERTEX_FRAMES; ++frame)
+  {
+    test_gfx_vertex_build_frame(gfx, frame);
+    eden_opengl_end_frame(gfx);
+    test_gfx_vertex_check(test_gfx_vertex_gl.bound_offset == 0);
+    test_gfx_vertex_check(test_gfx_vertex_check_frame(test_gfx_vertex_gl.storage, frame));
+  }
+
+  // one orphan per frame (plus the initial allocation) and one upload per draw
+  test_gfx_vertex_check(test_gfx_vertex_gl.orphan_count == TEST_GFX_VERTEX_FRAMES + 1);
+  test_gfx_vertex_check(test_gfx_vertex_gl.upload_count == 2*TEST_GFX_VERTEX_FRAMES);
+  test_gfx_vertex_check(test_gfx_vertex_gl.draw_count == 2*TEST_GFX_VERTEX_FRAMES);
+
+  printf("orphan%s: OK\n", is_map_failing ? " (map failed)" : "");
+  return true;
+}
+
+int main() {
+  static eden_t e = {};
+  eden_globalize(&e);
+
+  arena_t arena = {};
+  if (!arena_alloc(&arena, megabytes(16))) {
+    printf("Failed to allocate arena\n");
+    return 1;
+  }
+  defer { arena_free(&arena); };
+
+  static eden_opengl_t ogl = {};
+
+  if (!test_gfx_vertex_pack()) return 1;
+  printf("pack: OK\n");
+
+  u32_t frames_in_flight[] = { 0, 1, 2, 3, 4, 8 };
+  for_arr(i, frames_in_flight) {
+    if (!test_gfx_vertex_persistent(&eden->gfx, &ogl, &arena, frames_in_flight[i], false)) return 1;
+    if (!test_gfx_vertex_persistent(&eden->gfx, &ogl, &arena, frames_in_flight[i], true)) return 1;
+  }
+  if (!test_gfx_vertex_orphan(&eden->gfx, &ogl, &arena, false)) return 1;
+  if (!test_gfx_vertex_orphan(&eden->gfx, &ogl, &arena, true)) return 1;
+
+  free(test_gfx_vertex_gl.storage);
+  return 0;
+}
@@ -0,0 +1,326 @@
+//
+// Tests and benchmark for hashmap_t.
+//
+// Random inserts, overwrites and removes are checked against
+// std::unordered_map, including enough churn to fill the map with
+// deleted slots. Then 1M u32 and string keys are timed against
+// std::unordered_map.
+//
+// Build optimized, e.g.
+//   clang++ -std=c++17 -O2 test_hashmap.cpp
+//
+
+#include <stdio.h>
+#include <string>
+#include <unordered_map>
+
+#include "momo.h"
+
+#define TEST_HASHMAP_OPS        200000
+#define TEST_HASHMAP_BENCH_KEYS 1000000
+
+#define test_hashmap_check(cond) \
+  if (!(cond)) { printf("FAILED (line %d): %s\n", __LINE__, #cond); return false; }
+
+static f64_t
+test_hashmap_ns_per_op(u64_t start, u64_t end, u32_t count) {
+  return (f64_t)(end - start) * 1000000000.0 / clock_resolution() / count;
+}
+
+template<typename K, typename V, typename R>
+static b32_t
+test_hashmap_is_same(hashmap_t<K,V>* m, R* ref) {
+  test_hashmap_check(m->count == ref->size());
+  u32_t used = 0;
+  for (u32_t slot = 0; slot < m->cap; ++slot) {
+    if (!hashmap_is_slot_used(m, slot)) continue;
+    ++used;
+    auto itr = ref->find(m->keys[slot]);
+    test_hashmap_check(itr != ref->end());
+    test_hashmap_check(itr->second == m->values[slot]);
+  }
+  test_hashmap_check(used == m->count);
+
+  // the tail of the control bytes mirrors the head
+  for (u32_t i = 0; i < HASHMAP_GROUP_SIZE - 1; ++i)
+    test_hashmap_check(m->ctrls[m->cap + i] == m->ctrls[i]);
+  return true;
+}
+
+static b32_t
+test_hashmap_random(arena_t* arena, u32_t key_range) {
+  arena_set_revert_point(arena);
+
+  rng_t rng;
+  rng_init(&rng, key_range);
+
+  hashmap_t<u32_t, u32_t> m;
+  test_hashmap_check(hashmap_init(&m, arena));
+  std::unordered_map<u32_t, u32_t> ref;
+
+  for (u32_t op = 0; op < TEST_HASHMAP_OPS; ++op) {
+    u32_t key = rng_range_u32(&rng, 0, key_range);
+    u32_t what = rng_range_u32(&rng, 0, 3);
+    if (what == 0) {
+      u32_t value = rng_range_u32(&rng, 0, U32_MAX);
+      u32_t* v = hashmap_set(&m, key, value);
+      test_hashmap_check(v && *v == value);
+      ref[key] = value;
+    }
+    else if (what == 1) {
+      b32_t removed = hashmap_remove(&m, key);
+      test_hashmap_check(removed == (ref.erase(key) == 1));
+      test_hashmap_check(!hashmap_get(&m, key));
+    }
+    else {
+      u32_t* v = hashmap_get(&m, key);
+      auto itr = ref.find(key);
+      test_hashmap_check((v == nullptr) == (itr == ref.end()));
+      test_hashmap_check(!v || *v == itr->second);
+    }
+  }
+  if (!test_hashmap_is_same(&m, &ref)) return false;
+
+  // remove everything; the map shouldn't find anything after
+  for (auto& kv : ref)
+    test_hashmap_check(hashmap_remove(&m, kv.first));
+  test_hashmap_check(m.count == 0);
+  for (u32_t key = 0; key < min_of(key_range, 10000u); ++key)
+    test_hashmap_check(!hashmap_get(&m, key));
+
+  printf("random (%u keys): OK (cap %u)\n", key_range, m.cap);
+  return true;
+}
+
+// @note: Keeps the count the same while using new keys, so the map
+// has to clean up deleted slots without growing forever.
+static b32_t
+test_hashmap_churn(arena_t* arena) {
+  arena_set_revert_point(arena);
+
+  hashmap_t<u64_t, u32_t> m;
+  test_hashmap_check(hashmap_init(&m, arena, 1000));
+  u32_t cap = m.cap;
+  usz_t arena_pos = arena->pos;
+
+  const u32_t live = 1000;
+  for (u64_t key = 0; key < 200000; ++key) {
+    test_hashmap_check(hashmap_set(&m, key, (u32_t)key));
+    if (key >= live) test_hashmap_check(hashmap_remove(&m, key - live));
+  }
+  test_hashmap_check(m.count == live);
+  test_hashmap_check(m.cap == cap);
+  for (u64_t key = 200000 - live; key < 200000; ++key) {
+    u32_t* v = hashmap_get(&m, key);
+    test_hashmap_check(v && *v == (u32_t)key);
+  }
+
+  printf("churn: OK (cap %u, %u bytes of rehashes)\n", m.cap, (u32_t)(arena->pos - arena_pos));
+  return true;
+}
+
+static b32_t
+test_hashmap_strings(arena_t* arena) {
+  arena_set_revert_point(arena);
+
+  hashmap_t<const c8_t*, u32_t> m;
+  test_hashmap_check(hashmap_init(&m, arena));
+
+  // keys with the same content but at different addresses are the same key
+  c8_t a[] = "position";
+  c8_t b[] = "position";
+  test_hashmap_check(hashmap_set(&m, (const c8_t*)a, 1u));
+  test_hashmap_check(hashmap_set(&m, (const c8_t*)b, 2u));
+  test_hashmap_check(m.count == 1);
+  test_hashmap_check(*hashmap_get(&m, (const c8_t*)"position") == 2);
+  test_hashmap_check(!hashmap_get(&m, (const c8_t*)"positio"));
+  test_hashmap_check(!hashmap_get(&m, (const c8_t*)""));
+  test_hashmap_check(hashmap_set(&m, (const c8_t*)"", 3u));
+  test_hashmap_check(*hashmap_get(&m, (const c8_t*)"") == 3);
+
+  hashmap_clear(&m);
+  test_hashmap_check(m.count == 0);
+  test_hashmap_check(!hashmap_get(&m, (const c8_t*)"position"));
+
+  // every length up to a few blocks of hash_wy64
+  c8_t text[200];
+  for (u32_t i = 0; i < array_count(text) - 1; ++i) text[i] = 'a' + (i % 26);
+  hashmap_t<buf_t, u32_t> prefixes;
+  test_hashmap_check(hashmap_init(&prefixes, arena));
+  for (u32_t len = 0; len < array_count(text); ++len)
+    test_hashmap_check(hashmap_set(&prefixes, buf_set((u8_t*)text, len), len));
+  for (u32_t len = 0; len < array_count(text); ++len) {
+    u32_t* v = hashmap_get(&prefixes, buf_set((u8_t*)text, len));
+    test_hashmap_check(v && *v == len);
+  }
+
+  printf("strings: OK\n");
+  return true;
+}
+
+static b32_t
+test_hashmap_out_of_memory() {
+  arena_t small = {};
+  u8_t memory[1024];
+  arena_init(&small, buf_set(memory, sizeof(memory)));
+
+  hashmap_t<u32_t, u32_t> m;
+  test_hashmap_check(hashmap_init(&m, &small));
+  u32_t key = 0;
+  for (; key < 10000; ++key) {
+    if (!hashmap_set(&m, key, key)) break;
+  }
+  test_hashmap_check(key < 10000);
+
+  // the map is still usable after failing to grow
+  test_hashmap_check(m.count == key);
+  for (u32_t i = 0; i < key; ++i)
+    test_hashmap_check(hashmap_get(&m, i) && *hashmap_get(&m, i) == i);
+
+  printf("out of memory: OK (%u keys fit)\n", key);
+  return true;
+}
+
+// @note: The low 7 bits go into the control bytes and the rest picks
+// the group, so both halves need to be spread out even for keys that
+// are close together.
+static b32_t
+test_hashmap_distribution() {
+  u32_t low_bins[128] = {};
+  u32_t high_bins[128] = {};
+  const u32_t count = 128 * 1024;
+  for (u32_t i = 0; i < count; ++i) {
+    u64_t hash = hash_u64(i);
+    ++low_bins[hash & 0x7F];
+    ++high_bins[hash >> 57];
+  }
+  // @note: expected 1024 per bin; this is very loose
+  for_arr(i, low_bins) {
+    test_hashmap_check(low_bins[i] > 850 && low_bins[i] < 1200);
+    test_hashmap_check(high_bins[i] > 850 && high_bins[i] < 1200);
+  }
+
+  // different seeds and one bit of difference give different hashes
+  const c8_t* str = "hello world";
+  test_hashmap_check(hash_wy64(str, 11) != hash_wy64(str, 11, 1));
+  test_hashmap_check(hash_wy64(str, 11) != hash_wy64("hello worle", 11));
+  test_hashmap_check(hash_wy64(str, 11) != hash_wy64(str, 10));
+
+  printf("distribution: OK\n");
+  return true;
+}
+
+static void
+test_hashmap_bench_u32(arena_t* arena) {
+  arena_set_revert_point(arena);
+
+  rng_t rng;
+  rng_init(&rng, 42);
+  u32_t* keys = arena_push_arr(u32_t, arena, TEST_HASHMAP_BENCH_KEYS);
+  u32_t* misses = arena_push_arr(u32_t, arena, TEST_HASHMAP_BENCH_KEYS);
+  for (u32_t i = 0; i < TEST_HASHMAP_BENCH_KEYS; ++i) {
+    // @note: evens are in the map, odds are not
+    keys[i] = rng_range_u32(&rng, 0, U32_MAX) & ~1u;
+    misses[i] = rng_range_u32(&rng, 0, U32_MAX) | 1u;
+  }
+
+  volatile u32_t sink = 0;
+
+  hashmap_t<u32_t, u32_t> m;
+  hashmap_init(&m, arena);
+  u64_t t0 = clock_time();
+  for (u32_t i = 0; i < TEST_HASHMAP_BENCH_KEYS; ++i) hashmap_set(&m, keys[i], i);
+  u64_t t1 = clock_time();
+  for (u32_t i = 0; i < TEST_HASHMAP_BENCH_KEYS; ++i) sink = sink + *hashmap_get(&m, keys[i]);
+  u64_t t2 = clock_time();
+  for (u32_t i = 0; i < TEST_HASHMAP_BENCH_KEYS; ++i) sink = sink + (hashmap_get(&m, misses[i]) != nullptr);
+  u64_t t3 = clock_time();
+
+  std::unordered_map<u32_t, u32_t> ref;
+  u64_t r0 = clock_time();
+  for (u32_t i = 0; i < TEST_HASHMAP_BENCH_KEYS; ++i) ref[keys[i]] = i;
+  u64_t r1 = clock_time();
+  for (u32_t i = 0; i < TEST_HASHMAP_BENCH_KEYS; ++i) sink = sink + ref.find(keys[i])->second;
+  u64_t r2 = clock_time();
+  for (u32_t i = 0; i < TEST_HASHMAP_BENCH_KEYS; ++i) sink = sink + (ref.find(misses[i]) != ref.end());
+  u64_t r3 = clock_time();
+
+  const u32_t n = TEST_HASHMAP_BENCH_KEYS;
+  printf("u32 keys (ns/op)      insert   hit      miss\n");
+  printf("  hashmap_t           %-8.1f %-8.1f %-8.1f\n", test_hashmap_ns_per_op(t0, t1, n), test_hashmap_ns_per_op(t1, t2, n), test_hashmap_ns_per_op(t2, t3, n));
+  printf("  std::unordered_map  %-8.1f %-8.1f %-8.1f\n", test_hashmap_ns_per_op(r0, r1, n), test_hashmap_ns_per_op(r1, r2, n), test_hashmap_ns_per_op(r2, r3, n));
+}
+
+static void
+test_hashmap_bench_strings(arena_t* arena) {
+  arena_set_revert_point(arena);
+
+  // @note: keys look like identifiers of 8 to 24 characters
+  rng_t rng;
+  rng_init(&rng, 43);
+  buf_t* keys = arena_push_arr(buf_t, arena, TEST_HASHMAP_BENCH_KEYS);
+  buf_t* misses = arena_push_arr(buf_t, arena, TEST_HASHMAP_BENCH_KEYS);
+  for (u32_t i = 0; i < TEST_HASHMAP_BENCH_KEYS * 2; ++i) {
+    u32_t len = rng_range_u32(&rng, 8, 25);
+    u8_t* str = arena_push_arr(u8_t, arena, len);
+    for (u32_t c = 0; c < len - 1; ++c) str[c] = (u8_t)('a' + rng_range_u32(&rng, 0, 26));
+    // @note: the last character keeps the hits and misses apart
+    str[len - 1] = i < TEST_HASHMAP_BENCH_KEYS ? '0' : '1';
+    if (i < TEST_HASHMAP_BENCH_KEYS) keys[i] = buf_set(str, len);
+    else misses[i - TEST_HASHMAP_BENCH_KEYS] = buf_set(str, len);
+  }
+  std::string* ref_keys = new std::string[TEST_HASHMAP_BENCH_KEYS];
+  std::string* ref_misses = new std::string[TEST_HASHMAP_BENCH_KEYS];
+  defer { delete[] ref_keys; delete[] ref_misses; };
+  for (u32_t i = 0; i < TEST_HASHMAP_BENCH_KEYS; ++i) {
+    ref_keys[i].assign((const char*)keys[i].e, keys[i].size);
+    ref_misses[i].assign((const char*)misses[i].e, misses[i].size);
+  }
+
+  volatile u32_t sink = 0;
+
+  hashmap_t<buf_t, u32_t> m;
+  hashmap_init(&m, arena);
+  u64_t t0 = clock_time();
+  for (u32_t i = 0; i < TEST_HASHMAP_BENCH_KEYS; ++i) hashmap_set(&m, keys[i], i);
+  u64_t t1 = clock_time();
+  for (u32_t i = 0; i < TEST_HASHMAP_BENCH_KEYS; ++i) sink = sink + *hashmap_get(&m, keys[i]);
+  u64_t t2 = clock_time();
+  for (u32_t i = 0; i < TEST_HASHMAP_BENCH_KEYS; ++i) sink = sink + (hashmap_get(&m, misses[i]) != nullptr);
+  u64_t t3 = clock_time();
+
+  std::unordered_map<std::string, u32_t> ref;
+  u64_t r0 = clock_time();
+  for (u32_t i = 0; i < TEST_HASHMAP_BENCH_KEYS; ++i) ref[ref_keys[i]] = i;
+  u64_t r1 = clock_time();
+  for (u32_t i = 0; i < TEST_HASHMAP_BENCH_KEYS; ++i) sink = sink + ref.find(ref_keys[i])->second;
+  u64_t r2 = clock_time();
+  for (u32_t i = 0; i < TEST_HASHMAP_BENCH_KEYS; ++i) sink = sink + (ref.find(ref_misses[i]) != ref.end());
+  u64_t r3 = clock_time();
+
+  const u32_t n = TEST_HASHMAP_BENCH_KEYS;
+  printf("string keys (ns/op)   insert   hit      miss\n");
+  printf("  hashmap_t           %-8.1f %-8.1f %-8.1f\n", test_hashmap_ns_per_op(t0, t1, n), test_hashmap_ns_per_op(t1, t2, n), test_hashmap_ns_per_op(t2, t3, n));
+  printf("  std::unordered_map  %-8.1f %-8.1f %-8.1f\n", test_hashmap_ns_per_op(r0, r1, n), test_hashmap_ns_per_op(r1, r2, n), test_hashmap_ns_per_op(r2, r3, n));
+}
+
+int main() {
+  arena_t arena = {};
+  if (!arena_alloc(&arena, megabytes(512))) {
+    printf("Failed to allocate arena\n");
+    return 1;
+  }
+  defer { arena_free(&arena); };
+
+  if (!test_hashmap_random(&arena, 100)) return 1;
+  if (!test_hashmap_random(&arena, 5000)) return 1;
+  if (!test_hashmap_random(&arena, 1000000)) return 1;
+  if (!test_hashmap_churn(&arena)) return 1;
+  if (!test_hashmap_strings(&arena)) return 1;
+  if (!test_hashmap_out_of_memory()) return 1;
+  if (!test_hashmap_distribution()) return 1;
+
+  test_hashmap_bench_u32(&arena);
+  test_hashmap_bench_strings(&arena);
+  return 0;
+}
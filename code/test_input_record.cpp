@@ -0,0 +1,216 @@
+//
+// Tests for recording and playing back eden_input_t.
+//
+// Random input is fed through a recorder the way a platform would
+// update it, then played back and compared frame by frame. Also checks
+// that idle frames stay small, that a full recorder stops cleanly and
+// that bad recordings are rejected.
+//
+// Build e.g.
+//   clang++ -std=c++17 -O2 -DEDEN_DEBUG=1 test_input_record.cpp
+//
+
+#include <stdio.h>
+
+#include "eden.h"
+
+#define TEST_INPUT_RECORD_FRAMES 5000
+
+#define test_input_record_check(cond) \
+  if (!(cond)) { printf("FAILED (line %d): %s\n", __LINE__, #cond); return false; }
+
+// @note: like w32_update_input(), but someone is mashing everything
+static void
+test_input_record_update(eden_input_t* input, rng_t* rng, f32_t delta_time) {
+  for_arr(i, input->buttons) {
+    input->buttons[i].before = input->buttons[i].now;
+    if (rng_range_u32(rng, 0, 20) == 0)
+      input->buttons[i].now = !input->buttons[i].now;
+  }
+  input->char_count = 0;
+  input->mouse_scroll_delta = 0;
+  input->delta_time = delta_time;
+
+  if (rng_range_u32(rng, 0, 4) == 0)
+    input->mouse_pos = v2f_set(rng_range_f32(rng, 0.f, 1600.f), rng_range_f32(rng, 0.f, 900.f));
+  if (rng_range_u32(rng, 0, 10) == 0)
+    input->mouse_scroll_delta = (s32_t)rng_range_u32(rng, 0, 5) - 2;
+  if (rng_range_u32(rng, 0, 10) == 0) {
+    input->char_count = rng_range_u32(rng, 0, array_count(input->chars) + 1);
+    for (u32_t i = 0; i < input->char_count; ++i)
+      input->chars[i] = (u8_t)rng_range_u32(rng, 0, 256);
+  }
+  if (rng_range_u32(rng, 0, 100) == 0)
+    input->delta_time = rng_range_f32(rng, 0.001f, 0.1f);
+}
+
+static b32_t
+test_input_record_is_same(eden_input_t* lhs, eden_input_t* rhs) {
+  for_arr(i, lhs->buttons) {
+    if (!lhs->buttons[i].before != !rhs->buttons[i].before) return false;
+    if (!lhs->buttons[i].now != !rhs->buttons[i].now) return false;
+  }
+  if (lhs->char_count != rhs->char_count) return false;
+  if (!memory_is_same(lhs->chars, rhs->chars, lhs->char_count)) return false;
+  return
+    lhs->mouse_pos.x == rhs->mouse_pos.x &&
+    lhs->mouse_pos.y == rhs->mouse_pos.y &&
+    lhs->mouse_scroll_delta == rhs->mouse_scroll_delta &&
+    lhs->delta_time == rhs->delta_time;
+}
+
+static b32_t
+test_input_record_round_trip(arena_t* arena) {
+  arena_set_revert_point(arena);
+
+  eden_input_t* inputs = arena_push_arr_zero(eden_input_t, arena, TEST_INPUT_RECORD_FRAMES);
+  buf_t memory = arena_push_buffer(arena, megabytes(4), 16);
+  test_input_record_check(inputs && buf_valid(memory));
+
+  rng_t rng;
+  rng_init(&rng, 1234);
+
+  eden_input_recorder_t rec = {};
+  eden_input_recorder_init(&rec, memory);
+  eden_input_t input = {};
+  for (u32_t frame = 0; frame < TEST_INPUT_RECORD_FRAMES; ++frame) {
+    test_input_record_update(&input, &rng, 1/60.f);
+    inputs[frame] = input;
+    test_input_record_check(eden_input_recorder_record(&rec, &input));
+  }
+  buf_t recording = eden_input_recorder_get_recording(&rec);
+
+  eden_input_player_t player = {};
+  test_input_record_check(eden_input_player_init(&player, recording));
+  test_input_record_check(player.frame_count == TEST_INPUT_RECORD_FRAMES);
+
+  // @note: start with garbage to make sure playback overwrites everything
+  eden_input_t played;
+  for (usz_t i = 0; i < sizeof(played); ++i) ((u8_t*)&played)[i] = 0xAB;
+  for (u32_t frame = 0; frame < TEST_INPUT_RECORD_FRAMES; ++frame) {
+    test_input_record_check(eden_input_player_play(&player, &played));
+    test_input_record_check(test_input_record_is_same(&played, inputs + frame));
+  }
+  test_input_record_check(eden_input_player_is_done(&player));
+  test_input_record_check(!eden_input_player_play(&player, &played));
+  test_input_record_check(stream_is_eos(&player.stream));
+
+  printf("round trip: OK (%u frames, %u bytes, %.1f bytes per frame)\n",
+      TEST_INPUT_RECORD_FRAMES, (u32_t)recording.size, (f64_t)recording.size / TEST_INPUT_RECORD_FRAMES);
+  return true;
+}
+
+static b32_t
+test_input_record_idle(arena_t* arena) {
+  arena_set_revert_point(arena);
+  buf_t memory = arena_push_buffer(arena, kilobytes(4), 16);
+  test_input_record_check(buf_valid(memory));
+
+  eden_input_recorder_t rec = {};
+  eden_input_recorder_init(&rec, memory);
+  eden_input_t input = {};
+  input.delta_time = 1/60.f;
+  for (u32_t frame = 0; frame < 1000; ++frame)
+    test_input_record_check(eden_input_recorder_record(&rec, &input));
+
+  // the first frame has the delta time, the rest are a byte each
+  buf_t recording = eden_input_recorder_get_recording(&rec);
+  test_input_record_check(recording.size == sizeof(eden_input_record_header_t) + 1000 + sizeof(f32_t));
+
+  printf("idle: OK\n");
+  return true;
+}
+
+static b32_t
+test_input_record_full(arena_t* arena) {
+  arena_set_revert_point(arena);
+  buf_t memory = arena_push_buffer(arena, 256, 16);
+  test_input_record_check(buf_valid(memory));
+
+  rng_t rng;
+  rng_init(&rng, 5678);
+
+  eden_input_recorder_t rec = {};
+  eden_input_recorder_init(&rec, memory);
+  eden_input_t input = {};
+  u32_t recorded = 0;
+  for (u32_t frame = 0; frame < 1000; ++frame) {
+    test_input_record_update(&input, &rng, 1/60.f);
+    if (!eden_input_recorder_record(&rec, &input)) break;
+    ++recorded;
+  }
+  test_input_record_check(rec.is_full);
+  test_input_record_check(recorded == rec.frame_count);
+  test_input_record_check(!eden_input_recorder_record(&rec, &input));
+
+  // whatever made it in should still play
+  eden_input_player_t player = {};
+  test_input_record_check(eden_input_player_init(&player, eden_input_recorder_get_recording(&rec)));
+  for (u32_t frame = 0; frame < recorded; ++frame)
+    test_input_record_check(eden_input_player_play(&player, &input));
+  test_input_record_check(eden_input_player_is_done(&player));
+
+  printf("full: OK (%u frames)\n", recorded);
+  return true;
+}
+
+static b32_t
+test_input_record_bad(arena_t* arena) {
+  arena_set_revert_point(arena);
+  buf_t memory = arena_push_buffer(arena, kilobytes(4), 16);
+  test_input_record_check(buf_valid(memory));
+
+  eden_input_recorder_t rec = {};
+  eden_input_recorder_init(&rec, memory);
+  eden_input_t input = {};
+  input.buttons[EDEN_BUTTON_CODE_A].now = true;
+  input.mouse_pos = v2f_set(1.f, 2.f);
+  test_input_record_check(eden_input_recorder_record(&rec, &input));
+  buf_t recording = eden_input_recorder_get_recording(&rec);
+
+  eden_input_player_t player = {};
+  auto* header = (eden_input_record_header_t*)recording.e;
+
+  // too small for a header
+  test_input_record_check(!eden_input_player_init(&player, buf_set(recording.e, sizeof(*header) - 1)));
+
+  header->signature = 0;
+  test_input_record_check(!eden_input_player_init(&player, recording));
+  header->signature = EDEN_INPUT_RECORD_SIGNATURE;
+
+  header->version = EDEN_INPUT_RECORD_VERSION + 1;
+  test_input_record_check(!eden_input_player_init(&player, recording));
+  header->version = EDEN_INPUT_RECORD_VERSION;
+
+  header->button_count = EDEN_BUTTON_CODE_MAX + 1;
+  test_input_record_check(!eden_input_player_init(&player, recording));
+  header->button_count = EDEN_BUTTON_CODE_MAX;
+
+  // cut off in the middle of a frame
+  test_input_record_check(eden_input_player_init(&player, buf_set(recording.e, recording.size - 1)));
+  test_input_record_check(!eden_input_player_play(&player, &input));
+
+  // says there are more frames than there are
+  header->frame_count = 2;
+  test_input_record_check(eden_input_player_init(&player, recording));
+  test_input_record_check(eden_input_player_play(&player, &input));
+  test_input_record_check(!eden_input_player_play(&player, &input));
+
+  printf("bad recordings: OK\n");
+  return true;
+}
+
+int main() {
+  arena_t arena = {};
+  if (!arena_alloc(&arena, megabytes(16))) {
+    printf("Failed to allocate arena\n");
+    return 1;
+  }
+  defer { arena_free(&arena); };
+
+  if (!test_input_record_round_trip(&arena)) return 1;
+  if (!test_input_record_idle(&arena)) return 1;
+  if (!test_input_record_full(&arena)) return 1;
+  if (!test_input_record_bad(&arena)) return 1;
+  return 0;
+}
@@ -0,0 +1,218 @@
+//
+// Stress test and throughput benchmark for the job system in momo.h.
+//
+// The stress test runs fork-join trees (jobs that add child jobs and
+// wait on them) and big flat batches, and checks that every job ran
+// exactly once. It also checks that a thread outside the job system
+// runs jobs while it waits. The benchmark measures jobs per second for empty jobs,
+// tiny jobs and fork-join trees with different amounts of threads.
+//
+// Build optimized, e.g.
+//   clang++ -std=c++17 -O2 -march=native test_jobs.cpp
+//
+
+#include <stdio.h>
+
+#include "momo.h"
+
+#define TEST_JOBS_MAX_THREADS     16
+#define TEST_JOBS_PER_WORKER      65536
+#define TEST_JOBS_FLAT_COUNT      60000
+#define TEST_JOBS_TREE_DEPTH      14
+#define TEST_JOBS_STRESS_RUNS     20
+#define TEST_JOBS_BENCH_RUNS      5
+
+static job_system_t test_jobs_system;
+
+//
+// Fork-join tree
+//
+struct test_jobs_node_t {
+  u32_t depth;
+  u32_t volatile* leaf_count;
+};
+
+static void
+test_jobs_tree(void* data) {
+  test_jobs_node_t* node = (test_jobs_node_t*)data;
+  if (node->depth == 0) {
+    u32_atomic_add(node->leaf_count, 1);
+    return;
+  }
+
+  // @note: the children live on this job's stack, which is fine
+  // because we don't return until they are done.
+  test_jobs_node_t children[2];
+  job_counter_t counter = {};
+  for_arr(i, children) {
+    children[i].depth = node->depth - 1;
+    children[i].leaf_count = node->leaf_count;
+    job_add(&test_jobs_system, test_jobs_tree, children + i, &counter);
+  }
+  job_wait(&test_jobs_system, &counter);
+}
+
+//
+// Flat batch
+//
+static u32_t volatile test_jobs_hits[TEST_JOBS_FLAT_COUNT];
+
+static void
+test_jobs_hit(void* data) {
+  u32_atomic_add(&test_jobs_hits[(umi_t)data], 1);
+}
+
+static void
+test_jobs_empty(void* data) {
+}
+
+static void
+test_jobs_tiny(void* data) {
+  // @note: roughly 100 dependent multiplies
+  u32_t x = (u32_t)(umi_t)data | 1;
+  for (u32_t i = 0; i < 100; ++i) {
+    x = x * 1664525 + 1013904223;
+  }
+  test_jobs_hits[(umi_t)data] = x;
+}
+
+static b32_t
+test_jobs_stress(u32_t thread_count) {
+  for (u32_t run = 0; run < TEST_JOBS_STRESS_RUNS; ++run) {
+    // fork-join
+    {
+      u32_t volatile leaf_count = 0;
+      test_jobs_node_t root = { TEST_JOBS_TREE_DEPTH, &leaf_count };
+      job_counter_t counter = {};
+      job_add(&test_jobs_system, test_jobs_tree, &root, &counter);
+      job_wait(&test_jobs_system, &counter);
+      if (leaf_count != (1u << TEST_JOBS_TREE_DEPTH)) {
+        printf("fork-join failed: threads=%u run=%u leaves=%u\n", thread_count, run, leaf_count);
+        return false;
+      }
+    }
+
+    // flat
+    {
+      for (u32_t i = 0; i < TEST_JOBS_FLAT_COUNT; ++i) test_jobs_hits[i] = 0;
+      job_counter_t counter = {};
+      for (u32_t i = 0; i < TEST_JOBS_FLAT_COUNT; ++i) {
+        job_add(&test_jobs_system, test_jobs_hit, (void*)(umi_t)i, &counter);
+      }
+      job_wait(&test_jobs_system, &counter);
+      for (u32_t i = 0; i < TEST_JOBS_FLAT_COUNT; ++i) {
+        if (test_jobs_hits[i] != 1) {
+          printf("flat failed: threads=%u run=%u job=%u ran %u times\n", thread_count, run, i, test_jobs_hits[i]);
+          return false;
+        }
+      }
+    }
+  }
+  return true;
+}
+
+//
+// Waiting from outside
+//
+struct test_jobs_outsider_t {
+  job_counter_t* counter;
+};
+
+static void
+test_jobs_outsider_wait(void* ctx) {
+  auto* outsider = (test_jobs_outsider_t*)ctx;
+  job_wait(&test_jobs_system, outsider->counter);
+}
+
+// @note: The jobs sit on worker 0's deque while worker 0 (us) is 
+// stuck in thread_join(). With no other threads, the outsider has to 
+// steal them all or this never returns.
+static b32_t
+test_jobs_outsider(u32_t thread_count) {
+  for (u32_t i = 0; i < TEST_JOBS_FLAT_COUNT; ++i) test_jobs_hits[i] = 0;
+  job_counter_t counter = {};
+  for (u32_t i = 0; i < TEST_JOBS_FLAT_COUNT; ++i) {
+    job_add(&test_jobs_system, test_jobs_hit, (void*)(umi_t)i, &counter);
+  }
+
+  test_jobs_outsider_t outsider = { &counter };
+  thread_t thread;
+  if (!thread_begin(&thread, test_jobs_outsider_wait, &outsider)) {
+    printf("outsider failed: threads=%u cannot start thread\n", thread_count);
+    return false;
+  }
+  thread_join(&thread);
+
+  for (u32_t i = 0; i < TEST_JOBS_FLAT_COUNT; ++i) {
+    if (test_jobs_hits[i] != 1) {
+      printf("outsider failed: threads=%u job=%u ran %u times\n", thread_count, i, test_jobs_hits[i]);
+      return false;
+    }
+  }
+  return true;
+}
+
+// Returns millions of jobs per second
+static f64_t
+test_jobs_bench_flat(job_callback_f* callback) {
+  f64_t best = F64_INFINITY;
+  for (u32_t run = 0; run < TEST_JOBS_BENCH_RUNS; ++run) {
+    job_counter_t counter = {};
+    u64_t start = clock_time();
+    for (u32_t i = 0; i < TEST_JOBS_FLAT_COUNT; ++i) {
+      job_add(&test_jobs_system, callback, (void*)(umi_t)i, &counter);
+    }
+    job_wait(&test_jobs_system, &counter);
+    u64_t end = clock_time();
+    best = min_of(best, (f64_t)(end - start) / clock_resolution());
+  }
+  return TEST_JOBS_FLAT_COUNT / best / 1000000.0;
+}
+
+static f64_t
+test_jobs_bench_tree() {
+  f64_t best = F64_INFINITY;
+  for (u32_t run = 0; run < TEST_JOBS_BENCH_RUNS; ++run) {
+    u32_t volatile leaf_count = 0;
+    test_jobs_node_t root = { TEST_JOBS_TREE_DEPTH, &leaf_count };
+    job_counter_t counter = {};
+    u64_t start = clock_time();
+    job_add(&test_jobs_system, test_jobs_tree, &root, &counter);
+    job_wait(&test_jobs_system, &counter);
+    u64_t end = clock_time();
+    best = min_of(best, (f64_t)(end - start) / clock_resolution());
+  }
+  u32_t job_count = (2u << TEST_JOBS_TREE_DEPTH) - 1;
+  return job_count / best / 1000000.0;
+}
+
+int main() {
+  arena_t arena = {};
+  if (!arena_alloc(&arena, gigabytes(1))) {
+    printf("Failed to allocate arena\n");
+    return 1;
+  }
+  defer { arena_free(&arena); };
+
+  printf("hardware threads: %u\n\n", thread_get_hardware_count());
+  printf("%8s %10s %14s %14s %14s\n", "threads", "stress", "empty (M/s)", "tiny (M/s)", "tree (M/s)");
+  for (u32_t thread_count = 0; thread_count <= TEST_JOBS_MAX_THREADS; thread_count = thread_count ? thread_count * 2 : 1) {
+    arena_clear(&arena);
+    if (!job_system_init(&test_jobs_system, thread_count, TEST_JOBS_PER_WORKER, &arena)) {
+      printf("Failed to init job system with %u threads\n", thread_count);
+      return 1;
+    }
+    defer { job_system_free(&test_jobs_system); };
+
+    if (!test_jobs_stress(thread_count) || !test_jobs_outsider(thread_count)) {
+      return 1;
+    }
+
+    f64_t empty = test_jobs_bench_flat(test_jobs_empty);
+    f64_t tiny = test_jobs_bench_flat(test_jobs_tiny);
+    f64_t tree = test_jobs_bench_tree();
+    printf("%8u %10s %14.2f %14.2f %14.2f\n", thread_count, "OK", empty, tiny, tree);
+  }
+
+  return 0;
+}
@@ -1,75 +1,511 @@
-#include <stdlib.h>
+//
+// Conformance tests and benchmark for json_read().
+//
+// Runs a list of documents that have to be accepted or rejected, most
+// of them from the cases in JSONTestSuite (RFC 8259), plus the comment
+// and trailing comma extensions. Checks that the SIMD scanner finds the
+// same structural characters as the byte by byte one on random text,
+// and that large objects are looked up through their hashmap. Then
+// times json_read() in MB/s on generated files of a few megabytes.
+//
+// Build optimized, e.g.
+//   clang++ -std=c++17 -O2 test_json.cpp
+//
+
 #include <stdio.h>
 
-#define FOOLISH
 #include "momo.h"
 
-int main() {
-  const char json_str[] = "{\
+#define TEST_JSON_BENCH_SIZE megabytes(8)
+
+#define test_json_check(cond) \
+  if (!(cond)) { printf("FAILED (line %d): %s\n", __LINE__, #cond); return false; }
+
+struct test_json_case_t {
+  const char* text;
+  b32_t is_valid;
+};
+
+static test_json_case_t test_json_cases[] = {
+  // objects and arrays
+  { "{}", true },
+  { " \t\r\n{ \t\r\n} \t\r\n", true },
+  { "{\"a\":1}", true },
+  { "{\"\":0}", true },
+  { "{\"a\":[]}", true },
+  { "{\"a\":[[[]]]}", true },
+  { "{\"a\":{\"b\":{\"c\":{}}}}", true },
+  { "{\"a\":[1,\"2\",true,false,null,{},[]]}", true },
+  { "{\"a\":1,\"a\":2}", true },
+  { "{\"a\" : 1 , \"b\" : 2}", true },
+  { "", false },
+  { "   ", false },
+  { "{", false },
+  { "}", false },
+  { "{\"a\":1", false },
+  { "{\"a\":1}}", false },
+  { "{\"a\":1} x", false },
+  { "{\"a\":1}{}", false },
+  { "{\"a\" 1}", false },
+  { "{\"a\":}", false },
+  { "{\"a\"}", false },
+  { "{\"a\":1 \"b\":2}", false },
+  { "{\"a\":1,,\"b\":2}", false },
+  { "{,}", false },
+  { "{:1}", false },
+  { "{a:1}", false },
+  { "{'a':1}", false },
+  { "{1:1}", false },
+  { "{\"a\"::1}", false },
+  { "{\"a\":[1,2}", false },
+  { "{\"a\":[1 2]}", false },
+  { "{\"a\":[,1]}", false },
+  { "{\"a\":[1,,2]}", false },
+  { "{\"a\":]}", false },
+  { "{\"a\":[}", false },
+
+  // the root has to be an object
+  { "[]", false },
+  { "1", false },
+  { "\"a\"", false },
+  { "null", false },
+
+  // numbers
+  { "{\"a\":0}", true },
+  { "{\"a\":-0}", true },
+  { "{\"a\":123}", true },
+  { "{\"a\":-123}", true },
+  { "{\"a\":1.5}", true },
+  { "{\"a\":-0.0}", true },
+  { "{\"a\":1e10}", true },
+  { "{\"a\":1E10}", true },
+  { "{\"a\":1e+10}", true },
+  { "{\"a\":1e-10}", true },
+  { "{\"a\":0.5e-3}", true },
+  { "{\"a\":123456789012345678901234567890}", true },
+  { "{\"a\":[0,1]}", true },
+  { "{\"a\":01}", false },
+  { "{\"a\":-01}", false },
+  { "{\"a\":1.}", false },
+  { "{\"a\":.5}", false },
+  { "{\"a\":+1}", false },
+  { "{\"a\":-}", false },
+  { "{\"a\":1e}", false },
+  { "{\"a\":1e+}", false },
+  { "{\"a\":1.2.3}", false },
+  { "{\"a\":1.e5}", false },
+  { "{\"a\":0x10}", false },
+  { "{\"a\":1x}", false },
+  { "{\"a\":- 1}", false },
+  { "{\"a\":NaN}", false },
+  { "{\"a\":Infinity}", false },
+  { "{\"a\":-Infinity}", false },
+
+  // literals
+  { "{\"a\":true}", true },
+  { "{\"a\":false}", true },
+  { "{\"a\":null}", true },
+  { "{\"a\":tru}", false },
+  { "{\"a\":truex}", false },
+  { "{\"a\":True}", false },
+  { "{\"a\":nul}", false },
+  { "{\"a\":nulll}", false },
+  { "{\"a\":fals}", false },
+
+  // strings
+  { "{\"a\":\"\"}", true },
+  { "{\"a\":\"hello\"}", true },
+  { "{\"a\":\"\\\"\\\\\\/\\b\\f\\n\\r\\t\"}", true },
+  { "{\"a\":\"\\u00e9\\uD834\\uDD1E\"}", true },
+  { "{\"a\":\"\\uABCD\\uabcd\"}", true },
+  { "{\"a\":\"\xc3\xa9\xe2\x82\xac\"}", true },
+  { "{\"a\":\"{}[]:,\"}", true },
+  { "{\"a\":\"\\\\\"}", true },
+  { "{\"a\":\"\\\\\\\\\"}", true },
+  { "{\"a\":\"\\\"}", false },
+  { "{\"a\":\"\\x\"}", false },
+  { "{\"a\":\"\\a\"}", false },
+  { "{\"a\":\"\\u12\"}", false },
+  { "{\"a\":\"\\u12G4\"}", false },
+  { "{\"a\":\"\\U1234\"}", false },
+  { "{\"a\":\"tab\there\"}", false },
+  { "{\"a\":\"new\nline\"}", false },
+  { "{\"a\":\"unterminated}", false },
+  { "{\"a\":'single'}", false },
+  { "{\"a\":\"a\"\"b\"}", false },
+  { "{\"a\":\\\"a\\\"}", false },
+
+  // whitespace that isn't
+  { "{\"a\":\v1}", false },
+  { "{\"a\":\f1}", false },
+  { "{\"a\":1\x01}", false },
+
+  // extensions: comments and trailing commas
+  { "{\"a\":1,}", true },
+  { "{\"a\":[1,2,],}", true },
+  { "// hello\n{\"a\":1}", true },
+  { "{\"a\": /* hello */ 1}", true },
+  { "{\"a\":1} // bye", true },
+  { "{\"a\":1 /* } */}", true },
+  { "/**/{/**/\"a\"/**/:/**/1/**/}/**/", true },
+  { "{\"a\":\"// not a comment\"}", true },
+  { "{\"a\":\"/* not a comment\"}", true },
+  { "{\"a\":1}//", true },
+  { "{\"a\":[,]}", false },
+  { "{,\"a\":1}", false },
+  { "{\"a\":1/}", false },
+  { "{\"a\":1 / 2}", false },
+  { "{\"a\":1 /* unterminated }", false },
+  { "{\"a\":1}\n/", false },
+};
+
+static b32_t
+test_json_is_valid(const char* text, arena_t* arena) {
+  arena_set_revert_point(arena);
+  json_t j = {};
+  return json_read(&j, (const u8_t*)text, (u32_t)cstr_len(text), arena) != nullptr;
+}
+
+static b32_t
+test_json_conformance(arena_t* arena) {
+  u32_t failed = 0;
+  for_arr(i, test_json_cases) {
+    test_json_case_t* c = test_json_cases + i;
+    if (test_json_is_valid(c->text, arena) != c->is_valid) {
+      printf("  expected %s: %s\n", c->is_valid ? "valid" : "invalid", c->text);
+      ++failed;
+    }
+  }
+  test_json_check(failed == 0);
+  printf("conformance: OK (%u cases)\n", (u32_t)array_count(test_json_cases));
+  return true;
+}
+
+static b32_t
+test_json_is_element(json_object_t* obj, const char* key, json_value_type_t type, const char* str) {
+  json_value_t* val = json_get_value(obj, buf_set((u8_t*)key, cstr_len(key)));
+  if (!val || val->type != type) return false;
+  return val->element.size == cstr_len(str) && memory_is_same(val->element.at, str, val->element.size);
+}
+
+static b32_t
+test_json_values(arena_t* arena) {
+  arena_set_revert_point(arena);
+
+  const char text[] = "{\
     \"car\": 23, \
     \"bus\": [1,2,3], \
     \"str\": \"hello\", \
+    \"escaped\": \"say \\\"hi\\\"\", \
     \"student\": { \
       \"id\": 12345, \
       \"name\": \"Gerald\", \
-    }\
+    },\
+    \"yes\": true, \"no\": false, \"nothing\": null, \
+    \"float\": -1.5e3, \
+    \"dup\": 1, \"dup\": 2, \
   }";
 
-  arena_t ba = {}; 
-  arena_alloc(&ba, gigabytes(1));
+  // @note: passes the null terminator too, which is ignored
+  json_t j = {};
+  json_object_t* obj = json_read(&j, (const u8_t*)text, array_count(text), arena);
+  test_json_check(obj);
+  test_json_check(obj->count == 11);
+  test_json_check(obj->index);
 
-  make(json_t, json);
-  auto* obj =  json_read(json, (u8_t*)json_str, array_count(json_str), &ba);
+  test_json_check(test_json_is_element(obj, "car", JSON_VALUE_TYPE_NUMBER, "23"));
+  test_json_check(test_json_is_element(obj, "str", JSON_VALUE_TYPE_STRING, "hello"));
+  test_json_check(test_json_is_element(obj, "escaped", JSON_VALUE_TYPE_STRING, "say \\\"hi\\\""));
+  test_json_check(test_json_is_element(obj, "yes", JSON_VALUE_TYPE_TRUE, "true"));
+  test_json_check(test_json_is_element(obj, "no", JSON_VALUE_TYPE_FALSE, "false"));
+  test_json_check(test_json_is_element(obj, "nothing", JSON_VALUE_TYPE_NULL, "null"));
+  test_json_check(test_json_is_element(obj, "float", JSON_VALUE_TYPE_NUMBER, "-1.5e3"));
+  test_json_check(test_json_is_element(obj, "dup", JSON_VALUE_TYPE_NUMBER, "1"));
+  test_json_check(!json_get_value(obj, buf_from_lit("ca")));
+  test_json_check(!json_get_value(obj, buf_from_lit("cars")));
 
-  // Printing "car"
-  {
-    auto* val = json_get_value(obj, str_from_lit("car"));
-    if(val) {
-      auto* element = json_get_element(val);
-      s32_t out = 0;
-      str_to_s32(element->str, &out);
-      printf("%d\n", out);
-    }
+  json_value_t* bus = json_get_value(obj, buf_from_lit("bus"));
+  test_json_check(bus && json_is_array(bus));
+  json_array_t* arr = json_get_array(bus);
+  test_json_check(arr->count == 3);
+  u32_t expected = 1;
+  for (json_array_node_t* itr = arr->head; itr; itr = itr->next) {
+    test_json_check(json_is_number(&itr->value));
+    s32_t out = 0;
+    test_json_check(buf_to_s32(itr->value.element.str, &out) && out == (s32_t)expected);
+    ++expected;
   }
 
-  // Printing "str"
-  {
-    auto* val = json_get_value(obj, str_from_lit("str"));
-    if(val) {
-      auto* element = json_get_element(val);
-      s32_t out = 0;
-      buf_to_s32(element->str, &out);
-      for(i, element->str.size) {
-        printf("%c", element->str.e[i]);
+  json_value_t* student = json_get_value(obj, buf_from_lit("student"));
+  test_json_check(student && json_is_object(student));
+  test_json_check(json_get_object(student)->count == 2 && !json_get_object(student)->index);
+  test_json_check(test_json_is_element(json_get_object(student), "id", JSON_VALUE_TYPE_NUMBER, "12345"));
+  test_json_check(test_json_is_element(json_get_object(student), "name", JSON_VALUE_TYPE_STRING, "Gerald"));
+
+  // errors say roughly where they are
+  const char* bad = "{\"a\":1, \"b\":01}";
+  test_json_check(!json_read(&j, (const u8_t*)bad, (u32_t)cstr_len(bad), arena));
+  test_json_check(j.error_at == 12);
+
+  printf("values: OK\n");
+  return true;
+}
+
+static void
+test_json_push_key(bufio_t* b, u32_t i) {
+  bufio_push_cstr(b, "key");
+  for (u32_t div = 10000000; div > 0; div /= 10) 
+    bufio_push_c8(b, (c8_t)('0' + (i / div) % 10));
+}
+
+static b32_t
+test_json_large_object(arena_t* arena) {
+  arena_set_revert_point(arena);
+
+  // @note: sorted keys, which used to make a linked list out of the BST
+  const u32_t key_count = 100000;
+  buf_t memory = arena_push_buffer(arena, megabytes(4), 16);
+  test_json_check(buf_valid(memory));
+  bufio_t b;
+  bufio_init(&b, memory);
+  bufio_push_c8(&b, '{');
+  for (u32_t i = 0; i < key_count; ++i) {
+    bufio_push_c8(&b, '"');
+    test_json_push_key(&b, i);
+    bufio_push_cstr(&b, "\":");
+    bufio_push_u32(&b, i);
+    bufio_push_c8(&b, ',');
+  }
+  bufio_push_cstr(&b, "\"key00000000\":\"duplicate\"}");
+
+  json_t j = {};
+  json_object_t* obj = json_read(&j, b.str.e, (u32_t)b.str.size, arena);
+  test_json_check(obj);
+  test_json_check(obj->count == key_count + 1);
+  test_json_check(obj->index);
+
+  u8_t key[32];
+  u8_t value[32];
+  for (u32_t i = 0; i < key_count; ++i) {
+    bufio_t kb, vb;
+    bufio_init(&kb, buf_set(key, sizeof(key)));
+    bufio_init(&vb, buf_set(value, sizeof(value)));
+    test_json_push_key(&kb, i);
+    bufio_push_u32(&vb, i);
+
+    json_value_t* val = json_get_value(obj, kb.str);
+    test_json_check(val && json_is_number(val));
+    test_json_check(val->element.size == vb.str.size && memory_is_same(val->element.at, value, vb.str.size));
+  }
+  test_json_check(!json_get_value(obj, buf_from_lit("key")));
+  test_json_check(!json_get_value(obj, buf_from_lit("key99999999")));
+
+  printf("large object: OK (%u keys)\n", key_count);
+  return true;
+}
+
+// @note: nesting is limited so that bad input can't blow the stack
+static b32_t
+test_json_depth(arena_t* arena) {
+  arena_set_revert_point(arena);
+
+  buf_t memory = arena_push_buffer(arena, kilobytes(8), 16);
+  test_json_check(buf_valid(memory));
+  bufio_t b;
+  bufio_init(&b, memory);
+
+  for (u32_t depth = 1024; depth <= 1025; ++depth) {
+    bufio_clear(&b);
+    bufio_push_cstr(&b, "{\"a\":");
+    for (u32_t i = 1; i < depth; ++i) bufio_push_c8(&b, '[');
+    for (u32_t i = 1; i < depth; ++i) bufio_push_c8(&b, ']');
+    bufio_push_c8(&b, '}');
+
+    json_t j = {};
+    b32_t ok = json_read(&j, b.str.e, (u32_t)b.str.size, arena) != nullptr;
+    test_json_check(ok == (depth <= 1024));
+  }
+
+  bufio_clear(&b);
+  bufio_push_cstr(&b, "{\"a\":");
+  for (u32_t i = 0; i < 2000; ++i) bufio_push_c8(&b, '[');
+  json_t j = {};
+  test_json_check(!json_read(&j, b.str.e, (u32_t)b.str.size, arena));
+
+  printf("depth: OK\n");
+  return true;
+}
+
+// @note: scans the whole text and writes out every structural index
+static u32_t
+test_json_scan_all(const u8_t* text, usz_t size, b32_t is_byte_by_byte, u32_t* out, u32_t out_cap, b32_t* out_is_error) {
+  u32_t indices[_JSON_SCAN_INDEX_CAP];
+  _json_scanner_t s;
+  _json_scan_begin(&s, text, size, indices);
+  s.is_byte_by_byte = is_byte_by_byte;
+
+  u32_t count = 0;
+  for (;;) {
+    usz_t at = _json_scan_next(&s);
+    if (at == size || count == out_cap) break;
+    out[count++] = (u32_t)at;
+  }
+  *out_is_error = s.is_error;
+  return count;
+}
+
+static b32_t
+test_json_scanner(arena_t* arena) {
+  arena_set_revert_point(arena);
+
+  // @note: mostly the characters that the scanner cares about, with
+  // long runs of backslashes every now and then
+  static const char alphabet[] = "\"\"\"\\\\{}[]:, \t\n\r\x01" "abc01e-";
+  const u32_t size = 20000;
+  u8_t* text = arena_push_arr(u8_t, arena, size);
+  u32_t* simd = arena_push_arr(u32_t, arena, size + 1);
+  u32_t* bytes = arena_push_arr(u32_t, arena, size + 1);
+  test_json_check(text && simd && bytes);
+
+  rng_t rng;
+  rng_init(&rng, 1);
+  u32_t error_count = 0;
+  for (u32_t round = 0; round < 200; ++round) {
+    u32_t len = rng_range_u32(&rng, 0, size);
+    // @note: odd rounds only have valid escapes and no control 
+    // characters, so that we also compare texts without errors
+    b32_t is_clean = round % 2;
+    for (u32_t i = 0; i < len; ++i) {
+      if (rng_range_u32(&rng, 0, 200) == 0) {
+        u32_t run = min_of(rng_range_u32(&rng, 1, 80), len - i);
+        if (is_clean) run &= ~1u;
+        for (u32_t r = 0; r < run; ++r) text[i + r] = '\\';
+        if (run) i += run - 1;
+        continue;
+      }
+      u32_t c = rng_range_u32(&rng, 0, array_count(alphabet) - 1);
+      text[i] = (u8_t)alphabet[c];
+      if (is_clean && text[i] < 0x20) text[i] = ' ';
+      if (is_clean && text[i] == '\\') {
+        if (i + 1 < len) text[++i] = (u8_t)"\"\\n"[rng_range_u32(&rng, 0, 3)];
+        else text[i] = ' ';
       }
-      printf("\n");
     }
+
+    b32_t simd_error, bytes_error;
+    u32_t simd_count = test_json_scan_all(text, len, false, simd, size + 1, &simd_error);
+    u32_t bytes_count = test_json_scan_all(text, len, true, bytes, size + 1, &bytes_error);
+    test_json_check(simd_count == bytes_count);
+    test_json_check(memory_is_same(simd, bytes, simd_count * sizeof(u32_t)));
+    test_json_check(simd_error == bytes_error);
+    error_count += simd_error;
   }
 
-#if 0
-    json_array_t* arr = json_get_array(val);
-    if (arr) {
-      for(json_array_node_t* itr = arr->head;
-          itr != 0; 
-          itr = itr->next) 
-      {
-        json_value_t* val2 = &itr->value; 
-        if (json_is_number(val2)) {
-          json_element_t* element = json_get_element(val2);
-          s32_t out = 0;
-          str_to_s32(element->str, &out);
-          printf("%d\n", out);
-        }
-      }
+  printf("scanner: OK (%u of 200 texts had errors)\n", error_count);
+  return true;
+}
+
+// @note: An array of records that look like exported telemetry, with
+// some escapes and numbers of all shapes.
+static buf_t
+test_json_generate(arena_t* arena, usz_t size, b32_t with_comments) {
+  buf_t memory = arena_push_buffer(arena, size + kilobytes(4), 16);
+  if (!buf_valid(memory)) return buf_bad();
+  bufio_t b;
+  bufio_init(&b, memory);
+
+  rng_t rng;
+  rng_init(&rng, 2);
+  bufio_push_cstr(&b, "{\n  \"records\": [\n");
+  for (u32_t i = 0; b.str.size < size; ++i) {
+    if (with_comments) {
+      bufio_push_cstr(&b, "    // record ");
+      bufio_push_u32(&b, i);
+      bufio_push_c8(&b, '\n');
     }
-#endif
+    bufio_push_cstr(&b, "    {\"id\": ");
+    bufio_push_u32(&b, i);
+    bufio_push_cstr(&b, ", \"name\": \"entity_");
+    bufio_push_u32(&b, rng_range_u32(&rng, 0, 100000));
+    bufio_push_cstr(&b, "\", \"pos\": [");
+    bufio_push_s32(&b, (s32_t)rng_range_u32(&rng, 0, 2000) - 1000);
+    bufio_push_c8(&b, '.');
+    bufio_push_u32(&b, rng_range_u32(&rng, 0, 1000));
+    bufio_push_cstr(&b, ", ");
+    bufio_push_u32(&b, rng_range_u32(&rng, 0, 1000));
+    bufio_push_cstr(&b, ", -");
+    bufio_push_u32(&b, rng_range_u32(&rng, 0, 100));
+    bufio_push_cstr(&b, ".5e-3], \"alive\": ");
+    bufio_push_cstr(&b, rng_range_u32(&rng, 0, 2) ? "true" : "false");
+    bufio_push_cstr(&b, ", \"parent\": null, \"note\": \"line\\nbreak \\\"quoted\\\" \\u00e9\", "
+        "\"tags\": [\"a\", \"bb\", \"ccc\"], \"stats\": {\"hp\": ");
+    bufio_push_u32(&b, rng_range_u32(&rng, 0, 1000));
+    bufio_push_cstr(&b, ", \"mp\": ");
+    bufio_push_u32(&b, rng_range_u32(&rng, 0, 1000));
+    bufio_push_cstr(&b, "}},\n");
+  }
+  bufio_push_cstr(&b, "    {}\n  ]\n}\n");
+  return b.str;
+}
 
+static b32_t
+test_json_bench(arena_t* arena, b32_t with_comments) {
+  arena_set_revert_point(arena);
+  buf_t text = test_json_generate(arena, TEST_JSON_BENCH_SIZE, with_comments);
+  test_json_check(buf_valid(text));
 
+  // @note: the first stage on its own
+  u32_t indices[_JSON_SCAN_INDEX_CAP];
+  u64_t structural_count = 0;
+  u64_t scan_start = clock_time();
+  {
+    _json_scanner_t s;
+    _json_scan_begin(&s, text.e, text.size, indices);
+    while (_json_scan_next(&s) != text.size) ++structural_count;
+    test_json_check(!s.is_error);
+  }
+  u64_t scan_end = clock_time();
+
+  const u32_t runs = 5;
+  f64_t best = 0.0;
+  for (u32_t run = 0; run < runs; ++run) {
+    arena_set_revert_point(arena);
+    json_t j = {};
+    u64_t start = clock_time();
+    json_object_t* obj = json_read(&j, text.e, (u32_t)text.size, arena);
+    u64_t end = clock_time();
+    test_json_check(obj);
 
-  //json_object_t* one = json_get_object(json, str8_from_lit("obj"));
-  //u32_t* two = json_get_u32(one, str8_from_lit("item3"));
+    json_value_t* records = json_get_value(obj, buf_from_lit("records"));
+    test_json_check(records && json_is_array(records) && records->array.count > 1000);
 
-  //printf("hello: %d", *two);
+    f64_t secs = (f64_t)(end - start) / clock_resolution();
+    if (run == 0 || secs < best) best = secs;
+  }
 
+  f64_t mb = (f64_t)text.size / megabytes(1);
+  f64_t scan_secs = (f64_t)(scan_end - scan_start) / clock_resolution();
+  printf("bench%s: %.1f MB, %llu structurals; scan %.0f MB/s, json_read %.0f MB/s\n",
+      with_comments ? " (with comments)" : "",
+      mb, (unsigned long long)structural_count, mb / scan_secs, mb / best);
+  return true;
 }
 
+int main() {
+  arena_t arena = {};
+  if (!arena_alloc(&arena, megabytes(512))) {
+    printf("Failed to allocate arena\n");
+    return 1;
+  }
+  defer { arena_free(&arena); };
+
+  if (!test_json_conformance(&arena)) return 1;
+  if (!test_json_values(&arena)) return 1;
+  if (!test_json_large_object(&arena)) return 1;
+  if (!test_json_depth(&arena)) return 1;
+  if (!test_json_scanner(&arena)) return 1;
+
+  if (!test_json_bench(&arena, false)) return 1;
+  if (!test_json_bench(&arena, true)) return 1;
+  return 0;
+}
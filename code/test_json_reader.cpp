@@ -0,0 +1,363 @@
+//
+// Tests and benchmark for json_reader_t.
+//
+// Every document is read whole, split in two at every position and
+// fed a byte at a time, and has to give the same events every time.
+// Valid documents have to give the same values as json_read(), and
+// invalid ones have to fail in both. Then a generated file of a few
+// tens of MB is read through a small chunk and scratch buffer.
+//
+// Build optimized, e.g.
+//   clang++ -std=c++17 -O2 test_json_reader.cpp
+//
+
+#include <stdio.h>
+
+#include "momo.h"
+
+#define TEST_JSON_READER_MAX_EVENTS 1024
+#define TEST_JSON_READER_FILE_SIZE  megabytes(64)
+
+#define test_json_reader_check(cond) \
+  if (!(cond)) { printf("FAILED (line %d): %s\n", __LINE__, #cond); return false; }
+
+struct test_json_reader_events_t {
+  json_event_type_t types[TEST_JSON_READER_MAX_EVENTS];
+  buf_t strs[TEST_JSON_READER_MAX_EVENTS];
+  u32_t count;
+
+  // @note: event strings don't last, so they are copied here
+  u8_t pool[kilobytes(16)];
+  usz_t pool_size;
+};
+
+static void
+test_json_reader_push(test_json_reader_events_t* events, json_event_type_t type, buf_t str) {
+  assert(events->count < TEST_JSON_READER_MAX_EVENTS);
+  assert(events->pool_size + str.size <= sizeof(events->pool));
+  u8_t* copy = events->pool + events->pool_size;
+  memory_copy(copy, str.e, str.size);
+  events->pool_size += str.size;
+
+  events->types[events->count] = type;
+  events->strs[events->count] = buf_set(copy, str.size);
+  ++events->count;
+}
+
+static b32_t
+test_json_reader_is_same(test_json_reader_events_t* lhs, test_json_reader_events_t* rhs) {
+  if (lhs->count != rhs->count) return false;
+  for (u32_t i = 0; i < lhs->count; ++i) {
+    if (lhs->types[i] != rhs->types[i]) return false;
+    if (lhs->strs[i].size != rhs->strs[i].size) return false;
+    if (!memory_is_same(lhs->strs[i].e, rhs->strs[i].e, lhs->strs[i].size)) return false;
+  }
+  return true;
+}
+
+// @note: Feeds 'text' in chunks of 'chunk_size', except for the first
+// chunk, which is 'first_chunk_size'. The last event is END or ERROR.
+static void
+test_json_reader_read(const char* text, usz_t first_chunk_size, usz_t chunk_size, test_json_reader_events_t* out) {
+  out->count = 0;
+  out->pool_size = 0;
+
+  u8_t scratch[256];
+  json_reader_t r;
+  json_reader_init(&r, buf_set(scratch, sizeof(scratch)));
+
+  usz_t size = cstr_len(text);
+  usz_t at = 0;
+  usz_t next_chunk_size = first_chunk_size;
+  for (;;) {
+    json_event_t e = json_reader_next(&r);
+    if (e.type == JSON_EVENT_TYPE_NEED_MORE) {
+      usz_t n = min_of(next_chunk_size, size - at);
+      json_reader_feed(&r, (const u8_t*)text + at, n);
+      at += n;
+      next_chunk_size = chunk_size;
+      if (at == size) json_reader_finish(&r);
+      continue;
+    }
+    test_json_reader_push(out, e.type, e.str);
+    if (e.type == JSON_EVENT_TYPE_END || e.type == JSON_EVENT_TYPE_ERROR) break;
+  }
+}
+
+static void
+test_json_reader_flatten(json_value_t* value, test_json_reader_events_t* out) {
+  switch(value->type) {
+    case JSON_VALUE_TYPE_OBJECT: {
+      test_json_reader_push(out, JSON_EVENT_TYPE_BEGIN_OBJECT, {});
+      for (_json_entry_t* itr = value->object.head; itr; itr = itr->next) {
+        test_json_reader_push(out, JSON_EVENT_TYPE_KEY, buf_set(itr->key.at, itr->key.size));
+        test_json_reader_flatten(&itr->value, out);
+      }
+      test_json_reader_push(out, JSON_EVENT_TYPE_END_OBJECT, {});
+    } break;
+    case JSON_VALUE_TYPE_ARRAY: {
+      test_json_reader_push(out, JSON_EVENT_TYPE_BEGIN_ARRAY, {});
+      for (json_array_node_t* itr = value->array.head; itr; itr = itr->next)
+        test_json_reader_flatten(&itr->value, out);
+      test_json_reader_push(out, JSON_EVENT_TYPE_END_ARRAY, {});
+    } break;
+    case JSON_VALUE_TYPE_STRING: test_json_reader_push(out, JSON_EVENT_TYPE_STRING, value->element.str); break;
+    case JSON_VALUE_TYPE_NUMBER: test_json_reader_push(out, JSON_EVENT_TYPE_NUMBER, value->element.str); break;
+    case JSON_VALUE_TYPE_TRUE: test_json_reader_push(out, JSON_EVENT_TYPE_TRUE, value->element.str); break;
+    case JSON_VALUE_TYPE_FALSE: test_json_reader_push(out, JSON_EVENT_TYPE_FALSE, value->element.str); break;
+    case JSON_VALUE_TYPE_NULL: test_json_reader_push(out, JSON_EVENT_TYPE_NULL, value->element.str); break;
+  }
+}
+
+static const char* test_json_reader_docs[] = {
+  "{}",
+  "{\"a\":1}",
+  " {\"id\": 12345, \"name\": \"Gerald\", \"pos\": [-1.5e3, 0, 2.25], \"ok\": true, \"no\": false, \"none\": null} ",
+  "{\"nested\":{\"a\":[[],[{}],{\"b\":[1,[2,[3]]]}]}}",
+  "{\"escapes\":\"\\\"\\\\\\/\\b\\f\\n\\r\\t\\u00e9\\uD834\\uDD1E\", \"\\\\key\\\"\":\"\"}",
+  "{\"utf8\":\"\xc3\xa9\xe2\x82\xac\"}",
+  "{\"dup\":1,\"dup\":2}",
+  "{\"long number\":-123456789012345678901234567890.123456789e-100}",
+  "// comment\n{\"a\": /* block ** comment */ 1, /**/ \"b\":[1,2,],} // bye",
+  "{\"a\":1}/* end */",
+  "{\"a\":\"// not /* a comment\"}",
+
+  "",
+  "{",
+  "{\"a\":1",
+  "{\"a\":1}}",
+  "{\"a\":1} x",
+  "{\"a\" 1}",
+  "{\"a\":}",
+  "{\"a\":1 \"b\":2}",
+  "{,}",
+  "{\"a\":[,1]}",
+  "{\"a\":[1,,2]}",
+  "{\"a\":[1}",
+  "{\"a\":{]}",
+  "{a:1}",
+  "{\"a\":01}",
+  "{\"a\":1.}",
+  "{\"a\":-}",
+  "{\"a\":1e+}",
+  "{\"a\":truex}",
+  "{\"a\":nul}",
+  "{\"a\":\"\\x\"}",
+  "{\"a\":\"\\u12G4\"}",
+  "{\"a\":\"tab\there\"}",
+  "{\"a\":\"unterminated}",
+  "{\"a\":1/}",
+  "{\"a\":1 /* unterminated }",
+  "{\"a\":1}/",
+};
+
+static b32_t
+test_json_reader_docs_against_json_read(arena_t* arena) {
+  static test_json_reader_events_t whole, split, expected;
+
+  u32_t valid_count = 0;
+  for_arr(doc_index, test_json_reader_docs) {
+    const char* text = test_json_reader_docs[doc_index];
+    usz_t size = cstr_len(text);
+
+    test_json_reader_read(text, size, size, &whole);
+    b32_t is_valid = whole.types[whole.count - 1] == JSON_EVENT_TYPE_END;
+
+    // same answer as json_read()
+    arena_set_revert_point(arena);
+    json_t j = {};
+    json_object_t* obj = json_read(&j, (const u8_t*)text, (u32_t)size, arena);
+    if ((obj != nullptr) != is_valid) {
+      printf("  json_read() and json_reader_t disagree on: %s\n", text);
+      return false;
+    }
+    if (obj) {
+      expected.count = 0;
+      expected.pool_size = 0;
+      json_value_t root = {};
+      root.type = JSON_VALUE_TYPE_OBJECT;
+      root.object = *obj;
+      test_json_reader_flatten(&root, &expected);
+      test_json_reader_push(&expected, JSON_EVENT_TYPE_END, {});
+      test_json_reader_check(test_json_reader_is_same(&whole, &expected));
+    }
+    valid_count += is_valid;
+
+    // split anywhere, and a byte at a time
+    for (usz_t first = 0; first <= size; ++first) {
+      test_json_reader_read(text, first, size, &split);
+      test_json_reader_check(test_json_reader_is_same(&whole, &split));
+    }
+    test_json_reader_read(text, 1, 1, &split);
+    test_json_reader_check(test_json_reader_is_same(&whole, &split));
+  }
+
+  printf("documents: OK (%u valid, %u invalid)\n", valid_count, (u32_t)array_count(test_json_reader_docs) - valid_count);
+  return true;
+}
+
+static b32_t
+test_json_reader_roots() {
+  static test_json_reader_events_t events;
+  const char* valid[] = { "[1,2]", "1", " -0.5 ", "\"a\"", "true", "null", "[]//" };
+  const char* invalid[] = { "1 2", "[] []", "\"a\" 1", "]", ":", "," };
+
+  for_arr(i, valid) {
+    test_json_reader_read(valid[i], 1, 1, &events);
+    test_json_reader_check(events.types[events.count - 1] == JSON_EVENT_TYPE_END);
+  }
+  for_arr(i, invalid) {
+    test_json_reader_read(invalid[i], 1, 1, &events);
+    test_json_reader_check(events.types[events.count - 1] == JSON_EVENT_TYPE_ERROR);
+  }
+
+  // a number that ends with the input
+  test_json_reader_read("123", 2, 2, &events);
+  test_json_reader_check(events.count == 2 && events.types[0] == JSON_EVENT_TYPE_NUMBER);
+  test_json_reader_check(events.strs[0].size == 3 && memory_is_same(events.strs[0].e, "123", 3));
+
+  printf("roots: OK\n");
+  return true;
+}
+
+// @note: Only split tokens go through the scratch buffer, so a long
+// token is fine as long as it's inside a chunk.
+static b32_t
+test_json_reader_scratch() {
+  u8_t text[128];
+  u32_t size = 0;
+  text[size++] = '[';
+  text[size++] = '"';
+  for (u32_t i = 0; i < 100; ++i) text[size++] = 'x';
+  text[size++] = '"';
+  text[size++] = ']';
+
+  u8_t scratch[16];
+  for (u32_t split = 0; split < 2; ++split) {
+    json_reader_t r;
+    json_reader_init(&r, buf_set(scratch, sizeof(scratch)));
+    json_reader_feed(&r, text, split ? 50 : size);
+    if (!split) json_reader_finish(&r);
+
+    json_event_t e = json_reader_next(&r);
+    test_json_reader_check(e.type == JSON_EVENT_TYPE_BEGIN_ARRAY);
+    e = json_reader_next(&r);
+    if (split) {
+      test_json_reader_check(e.type == JSON_EVENT_TYPE_ERROR);
+      test_json_reader_check(r.error_at == 50);
+    }
+    else {
+      test_json_reader_check(e.type == JSON_EVENT_TYPE_STRING && e.str.size == 100);
+      test_json_reader_check(e.str.e == text + 2);
+    }
+  }
+
+  printf("scratch: OK\n");
+  return true;
+}
+
+// @note: Writes records like the ones in test_json, a chunk at a time,
+// so that the file never has to be in memory.
+static u32_t
+test_json_reader_write_file(const char* filename, usz_t size, arena_t* arena) {
+  arena_set_revert_point(arena);
+  buf_t memory = arena_push_buffer(arena, megabytes(1), 16);
+  if (!buf_valid(memory)) return 0;
+
+  file_t file = {};
+  if (!file_open(&file, filename, FILE_ACCESS_CREATE)) return 0;
+  defer { file_close(&file); };
+
+  rng_t rng;
+  rng_init(&rng, 3);
+  bufio_t b;
+  bufio_init(&b, memory);
+  bufio_push_cstr(&b, "{\"records\": [\n");
+  usz_t offset = 0;
+  u32_t record_count = 0;
+  while (offset + b.str.size < size) {
+    bufio_push_cstr(&b, "  {\"id\": ");
+    bufio_push_u32(&b, record_count++);
+    bufio_push_cstr(&b, ", \"name\": \"entity_");
+    bufio_push_u32(&b, rng_range_u32(&rng, 0, 100000));
+    bufio_push_cstr(&b, "\", \"pos\": [");
+    bufio_push_s32(&b, (s32_t)rng_range_u32(&rng, 0, 2000) - 1000);
+    bufio_push_cstr(&b, ".5, ");
+    bufio_push_u32(&b, rng_range_u32(&rng, 0, 1000));
+    bufio_push_cstr(&b, ", -1.5e-3], \"alive\": ");
+    bufio_push_cstr(&b, rng_range_u32(&rng, 0, 2) ? "true" : "false");
+    bufio_push_cstr(&b, ", \"parent\": null, \"note\": \"line\\nbreak \\\"quoted\\\" \\u00e9\"},\n");
+
+    if (bufio_remaining(&b) < 512) {
+      if (!file_write(&file, b.str.e, b.str.size, offset)) return 0;
+      offset += b.str.size;
+      bufio_clear(&b);
+    }
+  }
+  bufio_push_cstr(&b, "  {}\n]}\n");
+  if (!file_write(&file, b.str.e, b.str.size, offset)) return 0;
+  return record_count;
+}
+
+static b32_t
+test_json_reader_file(arena_t* arena) {
+  const char* filename = "test_json_reader.json";
+  u32_t record_count = test_json_reader_write_file(filename, TEST_JSON_READER_FILE_SIZE, arena);
+  test_json_reader_check(record_count > 0);
+
+  arena_set_revert_point(arena);
+  buf_t chunk = arena_push_buffer(arena, kilobytes(64), 16);
+  buf_t scratch = arena_push_buffer(arena, kilobytes(1), 16);
+  test_json_reader_check(buf_valid(chunk) && buf_valid(scratch));
+
+  // @note: it's big, so don't leave it lying around
+  defer { remove(filename); };
+
+  file_t file = {};
+  test_json_reader_check(file_open(&file, filename, FILE_ACCESS_READ));
+  defer { file_close(&file); };
+
+  json_reader_t r;
+  json_reader_init(&r, scratch);
+  test_json_reader_check(json_reader_set_file(&r, &file, chunk));
+
+  // @note: every record has an "id" key, inside the root object and the array
+  u32_t ids = 0;
+  u64_t event_count = 0;
+  u64_t start = clock_time();
+  for (;;) {
+    json_event_t e = json_reader_next(&r);
+    ++event_count;
+    if (e.type == JSON_EVENT_TYPE_KEY && r.depth == 3 && e.str.size == 2 && e.str.e[0] == 'i' && e.str.e[1] == 'd')
+      ++ids;
+    if (e.type == JSON_EVENT_TYPE_END || e.type == JSON_EVENT_TYPE_ERROR) {
+      test_json_reader_check(e.type == JSON_EVENT_TYPE_END);
+      break;
+    }
+    test_json_reader_check(e.type != JSON_EVENT_TYPE_NEED_MORE);
+  }
+  u64_t end = clock_time();
+  test_json_reader_check(ids == record_count);
+
+  f64_t mb = (f64_t)r.file_size / megabytes(1);
+  f64_t secs = (f64_t)(end - start) / clock_resolution();
+  printf("file: OK (%.0f MB, %u records, %llu events, %.0f MB/s, %u bytes of memory)\n",
+      mb, record_count, (unsigned long long)event_count, mb / secs,
+      (u32_t)(chunk.size + scratch.size + sizeof(json_reader_t)));
+  return true;
+}
+
+int main() {
+  arena_t arena = {};
+  if (!arena_alloc(&arena, megabytes(64))) {
+    printf("Failed to allocate arena\n");
+    return 1;
+  }
+  defer { arena_free(&arena); };
+
+  if (!test_json_reader_docs_against_json_read(&arena)) return 1;
+  if (!test_json_reader_roots()) return 1;
+  if (!test_json_reader_scratch()) return 1;
+  if (!test_json_reader_file(&arena)) return 1;
+  return 0;
+}
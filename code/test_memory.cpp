@@ -0,0 +1,232 @@
+//
+// Microbenchmark for memory_copy/memory_zero/memory_is_same/memory_swap/memory_move.
+//
+// Compares the momo.h versions against the old byte-at-a-time loops
+// and libc for sizes from 16B to 64MB. Results are in GB/s.
+//
+// Build optimized, e.g.
+//   clang++ -std=c++17 -O2 -march=native test_memory.cpp
+//
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "momo.h"
+
+//
+// The original byte-at-a-time loops
+//
+static void
+test_memory_copy_bytewise(void* dest, const void* src, usz_t size) {
+  u8_t *p = (u8_t*)dest;
+  const u8_t *q = (const u8_t*)src;
+  while(size--) {
+    *p++ = *q++;
+  }
+}
+
+static void
+test_memory_zero_bytewise(void* dest, usz_t size) {
+  u8_t *p = (u8_t*)dest;
+  while(size--){
+    *p++ = 0;
+  }
+}
+
+static b32_t
+test_memory_is_same_bytewise(const void* lhs, const void* rhs, usz_t size) {
+  const u8_t *p = (const u8_t*)lhs;
+  const u8_t *q = (const u8_t*)rhs;
+  while(size--) {
+    if (*p++ != *q++) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static void
+test_memory_swap_bytewise(void* lhs, void* rhs, usz_t size) {
+  u8_t* l = (u8_t*)lhs;
+  u8_t* r = (u8_t*)rhs;
+  while(size--) {
+    u8_t tmp = (*l);
+    *l++ = *r;
+    *r++ = tmp;
+  }
+}
+
+//
+// Correctness checks against libc for every size in [0, 300] and
+// every (mis)alignment in [0, 32).
+//
+static b32_t
+test_memory_correctness(u8_t* a, u8_t* b, u8_t* c)
+{
+  for (usz_t size = 0; size <= 300; ++size) {
+    for (usz_t offset = 0; offset < 32; ++offset) {
+      for (usz_t i = 0; i < 400; ++i) {
+        a[i] = (u8_t)(i * 7 + 3);
+        b[i] = (u8_t)(i * 13 + 1);
+        c[i] = b[i];
+      }
+
+      // copy
+      memory_copy(b + offset, a + (31 - offset), size);
+      memcpy(c + offset, a + (31 - offset), size);
+      if (memcmp(b, c, 400) != 0) {
+        printf("memory_copy failed: size=%zu offset=%zu\n", size, offset);
+        return false;
+      }
+
+      // is_same
+      if (!memory_is_same(b + offset, a + (31 - offset), size)) {
+        printf("memory_is_same failed (same): size=%zu offset=%zu\n", size, offset);
+        return false;
+      }
+      if (size) {
+        b[offset + size - 1] ^= 0x1;
+        if (memory_is_same(b + offset, a + (31 - offset), size)) {
+          printf("memory_is_same failed (different): size=%zu offset=%zu\n", size, offset);
+          return false;
+        }
+        b[offset + size - 1] ^= 0x1;
+      }
+
+      // zero
+      memory_zero(b + offset, size);
+      memset(c + offset, 0, size);
+      if (memcmp(b, c, 400) != 0) {
+        printf("memory_zero failed: size=%zu offset=%zu\n", size, offset);
+        return false;
+      }
+
+      // move (both directions, overlapping)
+      for (usz_t i = 0; i < 400; ++i) b[i] = c[i] = (u8_t)(i * 5 + 9);
+      memory_move(b + offset, b + 32, size);
+      memmove(c + offset, c + 32, size);
+      if (memcmp(b, c, 400) != 0) {
+        printf("memory_move (forward) failed: size=%zu offset=%zu\n", size, offset);
+        return false;
+      }
+      memory_move(b + 32, b + offset, size);
+      memmove(c + 32, c + offset, size);
+      if (memcmp(b, c, 400) != 0) {
+        printf("memory_move (backward) failed: size=%zu offset=%zu\n", size, offset);
+        return false;
+      }
+
+      // swap
+      for (usz_t i = 0; i < 400; ++i) c[i] = b[i];
+      memory_swap(b + offset, a + 31, size);
+      if (memcmp(a + 31, c + offset, size) != 0) {
+        printf("memory_swap failed: size=%zu offset=%zu\n", size, offset);
+        return false;
+      }
+      memory_swap(b + offset, a + 31, size);
+      if (memcmp(b, c, 400) != 0) {
+        printf("memory_swap (back) failed: size=%zu offset=%zu\n", size, offset);
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+//
+// Benchmarks
+//
+static volatile u32_t test_memory_sink = 0;
+
+#define test_memory_bench(name, size, expr) { \
+  usz_t iterations = max_of((usz_t)megabytes(256) / (size), (usz_t)4); \
+  u64_t start = clock_time(); \
+  for (usz_t iteration = 0; iteration < iterations; ++iteration) { expr; } \
+  u64_t end = clock_time(); \
+  f64_t secs = (f64_t)(end - start) / clock_resolution(); \
+  f64_t gbps = ((f64_t)(size) * iterations) / secs / (1024.0 * 1024.0 * 1024.0); \
+  printf(" %10.2f", gbps); \
+}
+
+static void
+test_memory_print_size(usz_t size) {
+  if (size >= megabytes(1)) printf("%6zuMB", (usz_t)(size / megabytes(1)));
+  else if (size >= kilobytes(1)) printf("%6zuKB", (usz_t)(size / kilobytes(1)));
+  else printf("%6zuB ", size);
+}
+
+int main() {
+  // Correctness first
+  {
+    u8_t a[400], b[400], c[400];
+    if (!test_memory_correctness(a, b, c)) {
+      return 1;
+    }
+    printf("correctness: OK\n");
+  }
+
+  printf("SSE2: %d, AVX2: %d\n\n", MOMO_SSE2, MOMO_AVX2);
+
+  const usz_t max_size = megabytes(64);
+  buf_t src = memory_allocate(max_size);
+  buf_t dest = memory_allocate(max_size);
+  defer { memory_free(src); memory_free(dest); };
+  if (!buf_valid(src) || !buf_valid(dest)) {
+    printf("Failed to allocate memory\n");
+    return 1;
+  }
+  for (usz_t i = 0; i < max_size; ++i) src.e[i] = (u8_t)i;
+  memcpy(dest.e, src.e, max_size);
+
+  printf("copy (GB/s)\n");
+  printf("%8s %10s %10s %10s\n", "size", "bytewise", "momo", "libc");
+  for (usz_t size = 16; size <= max_size; size *= 4) {
+    test_memory_print_size(size);
+    test_memory_bench("bytewise", size, test_memory_copy_bytewise(dest.e, src.e, size));
+    test_memory_bench("momo", size, memory_copy(dest.e, src.e, size));
+    test_memory_bench("libc", size, memcpy(dest.e, src.e, size));
+    printf("\n");
+  }
+
+  printf("\nmove, overlapping by 1 byte (GB/s)\n");
+  printf("%8s %10s %10s\n", "size", "momo", "libc");
+  for (usz_t size = 16; size < max_size; size *= 4) {
+    test_memory_print_size(size);
+    test_memory_bench("momo", size, memory_move(dest.e + 1, dest.e, size));
+    test_memory_bench("libc", size, memmove(dest.e + 1, dest.e, size));
+    printf("\n");
+  }
+
+  printf("\nzero (GB/s)\n");
+  printf("%8s %10s %10s %10s\n", "size", "bytewise", "momo", "libc");
+  for (usz_t size = 16; size <= max_size; size *= 4) {
+    test_memory_print_size(size);
+    test_memory_bench("bytewise", size, test_memory_zero_bytewise(dest.e, size));
+    test_memory_bench("momo", size, memory_zero(dest.e, size));
+    test_memory_bench("libc", size, memset(dest.e, 0, size));
+    printf("\n");
+  }
+
+  memcpy(dest.e, src.e, max_size);
+  printf("\nis_same (GB/s)\n");
+  printf("%8s %10s %10s %10s\n", "size", "bytewise", "momo", "libc");
+  for (usz_t size = 16; size <= max_size; size *= 4) {
+    test_memory_print_size(size);
+    test_memory_bench("bytewise", size, test_memory_sink += test_memory_is_same_bytewise(dest.e, src.e, size));
+    test_memory_bench("momo", size, test_memory_sink += memory_is_same(dest.e, src.e, size));
+    test_memory_bench("libc", size, test_memory_sink += (memcmp(dest.e, src.e, size) == 0));
+    printf("\n");
+  }
+
+  printf("\nswap (GB/s)\n");
+  printf("%8s %10s %10s\n", "size", "bytewise", "momo");
+  for (usz_t size = 16; size <= max_size; size *= 4) {
+    test_memory_print_size(size);
+    test_memory_bench("bytewise", size, test_memory_swap_bytewise(dest.e, src.e, size));
+    test_memory_bench("momo", size, memory_swap(dest.e, src.e, size));
+    printf("\n");
+  }
+
+  return 0;
+}
@@ -0,0 +1,1296 @@
+//
+// Tests and benchmark for png_rasterize(), png_rasterize_into_buffer() and
+// png_write().
+//
+// PNGs are made here from pixels that this test can make again, with every
+// filter type, with stored or fixed Huffman blocks, and with the IDAT data
+// cut into pieces of many sizes. Each must decode exactly, into a packed
+// image and into part of a bigger one, and broken ones must fail cleanly.
+//
+// Row unfiltering must match what was done before byte for byte, for any
+// width and every filter type, and is timed on a 4096x4096 atlas.
+//
+// png_write() must round trip at every level, with and without jobs.
+//
+// The benchmark decodes the PNGs given on the command line, or else some
+// made here, row by row as png_rasterize() does, and the way it did before:
+// joining the IDATs, inflating all of it, then unfiltering. Then it writes
+// them back out with png_write() at a few levels, against the old writer
+// that only stored.
+//
+// Build optimized, e.g.
+//   clang++ -std=c++17 -O2 test_png.cpp
+//   ./a.out atlas.png
+//
+
+#include <stdio.h>
+
+#include "momo.h"
+
+#define test_png_check(cond) \
+  if (!(cond)) { printf("FAILED (line %d): %s\n", __LINE__, #cond); return false; }
+
+static f64_t
+test_png_seconds(u64_t start, u64_t end) {
+  return (f64_t)(end - start) / clock_resolution();
+}
+
+// Something with gradients, flat areas and noise, so that every filter
+// gets a mix of values.
+static void
+test_png_make_pixels(u8_t* out, u32_t w, u32_t h, u32_t seed) {
+  rng_t rng;
+  rng_init(&rng, seed);
+  for (u32_t y = 0; y < h; ++y) {
+    for (u32_t x = 0; x < w; ++x) {
+      u8_t* p = out + ((usz_t)y * w + x) * 4;
+      if ((x / 16 + y / 16) % 3 == 0) {
+        u32_t r = rng_next(&rng);
+        p[0] = (u8_t)r;
+        p[1] = (u8_t)(r >> 8);
+        p[2] = (u8_t)(r >> 16);
+        p[3] = (u8_t)(r >> 24);
+      }
+      else if ((x / 16 + y / 16) % 3 == 1) {
+        p[0] = (u8_t)(x * 3 + y);
+        p[1] = (u8_t)(x ^ y);
+        p[2] = (u8_t)(y * 5);
+        p[3] = (u8_t)(255 - x);
+      }
+      else {
+        p[0] = p[1] = p[2] = 0;
+        p[3] = 255;
+      }
+    }
+  }
+}
+
+//
+// Making PNGs
+//
+#define TEST_PNG_FILTER_MIXED 5 // row 'y' uses filter 'y % 5'
+
+enum test_png_blocks_t {
+  TEST_PNG_BLOCKS_STORED,
+  TEST_PNG_BLOCKS_FIXED,
+};
+
+static u8_t
+test_png_paeth(s32_t a, s32_t b, s32_t c) {
+  s32_t p = a + b - c;
+  s32_t pa = s32_abs(p - a);
+  s32_t pb = s32_abs(p - b);
+  s32_t pc = s32_abs(p - c);
+  if (pa <= pb && pa <= pc) return (u8_t)a;
+  if (pb <= pc) return (u8_t)b;
+  return (u8_t)c;
+}
+
+// Filters 'h' rows of 'pixels' into 'out', each with its filter type in front
+static void
+test_png_filter(u8_t* out, const u8_t* pixels, u32_t w, u32_t h, u32_t filter) {
+  u32_t bpl = w * 4;
+  for (u32_t y = 0; y < h; ++y) {
+    const u8_t* row = pixels + (usz_t)y * bpl;
+    const u8_t* prior = y ? row - bpl : nullptr;
+    u32_t type = filter == TEST_PNG_FILTER_MIXED ? y % 5 : filter;
+    *out++ = (u8_t)type;
+    for (u32_t i = 0; i < bpl; ++i) {
+      s32_t a = i >= 4 ? row[i - 4] : 0;
+      s32_t b = prior ? prior[i] : 0;
+      s32_t c = (prior && i >= 4) ? prior[i - 4] : 0;
+      s32_t predicted = 0;
+      switch (type) {
+        case 1: predicted = a; break;
+        case 2: predicted = b; break;
+        case 3: predicted = (a + b) / 2; break;
+        case 4: predicted = test_png_paeth(a, b, c); break;
+      }
+      *out++ = (u8_t)(row[i] - predicted);
+    }
+  }
+}
+
+struct test_png_writer_t {
+  u8_t* e;
+  usz_t size;
+  u64_t bits;
+  u32_t count;
+};
+
+static void
+test_png_put_bits(test_png_writer_t* w, u32_t value, u32_t bit_count) {
+  w->bits |= (u64_t)value << w->count;
+  w->count += bit_count;
+  while (w->count >= 8) {
+    w->e[w->size++] = (u8_t)w->bits;
+    w->bits >>= 8;
+    w->count -= 8;
+  }
+}
+
+// Huffman codes go out from their first bit, which is their highest
+static void
+test_png_put_code(test_png_writer_t* w, u32_t code, u32_t bit_count) {
+  u32_t reversed = 0;
+  for (u32_t i = 0; i < bit_count; ++i) reversed |= ((code >> i) & 1) << (bit_count - 1 - i);
+  test_png_put_bits(w, reversed, bit_count);
+}
+
+static void
+test_png_put_fixed_symbol(test_png_writer_t* w, u32_t symbol) {
+  if (symbol < 144)      test_png_put_code(w, 0x30 + symbol, 8);
+  else if (symbol < 256) test_png_put_code(w, 0x190 + symbol - 144, 9);
+  else if (symbol < 280) test_png_put_code(w, symbol - 256, 7);
+  else                   test_png_put_code(w, 0xC0 + symbol - 280, 8);
+}
+
+static void
+test_png_put_fixed_match(test_png_writer_t* w, u32_t len, u32_t dist) {
+  static const u16_t len_bases[29] = {
+    3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+    35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+  };
+  static const u8_t len_extra_bits[29] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+    3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+  };
+  static const u16_t dist_bases[30] = {
+    1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+    257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145,
+    8193, 12289, 16385, 24577
+  };
+  static const u8_t dist_extra_bits[30] = {
+    0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+    7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+  };
+  u32_t i = 28;
+  while (len_bases[i] > len) --i;
+  test_png_put_fixed_symbol(w, 257 + i);
+  test_png_put_bits(w, len - len_bases[i], len_extra_bits[i]);
+  u32_t j = 29;
+  while (dist_bases[j] > dist) --j;
+  test_png_put_code(w, j, 5);
+  test_png_put_bits(w, dist - dist_bases[j], dist_extra_bits[j]);
+}
+
+// @note: A zlib stream of 'data'. Fixed blocks only look for matches one
+// pixel and one row back, which is most of what PNG encoders find anyway.
+static buf_t
+test_png_deflate(const u8_t* data, usz_t size, u32_t row_size, test_png_blocks_t blocks, b32_t has_trailer, arena_t* arena) {
+  usz_t cap = size + size / 4 + 1024;
+  test_png_writer_t w = {};
+  w.e = arena_push_arr(u8_t, arena, cap);
+  if (!w.e) return buf_bad();
+
+  test_png_put_bits(&w, 0x78, 8);
+  test_png_put_bits(&w, 0x01, 8);
+  if (blocks == TEST_PNG_BLOCKS_STORED) {
+    usz_t pos = 0;
+    do {
+      u32_t len = (u32_t)min_of(size - pos, (usz_t)65535);
+      test_png_put_bits(&w, pos + len == size, 1);
+      test_png_put_bits(&w, 0, 2);
+      if (w.count) test_png_put_bits(&w, 0, 8 - w.count);
+      test_png_put_bits(&w, len, 16);
+      test_png_put_bits(&w, ~len & 0xFFFF, 16);
+      memory_copy(w.e + w.size, data + pos, len);
+      w.size += len;
+      pos += len;
+    } while (pos < size);
+  }
+  else {
+    test_png_put_bits(&w, 1, 1);
+    test_png_put_bits(&w, 1, 2);
+    const u32_t dists[] = { 4, row_size, row_size + 4 };
+    for (usz_t pos = 0; pos < size;) {
+      u32_t best_len = 0, best_dist = 0;
+      for_arr(d, dists) {
+        u32_t dist = dists[d];
+        if (dist > pos || dist > 32768) continue;
+        u32_t len = 0;
+        while (len < 258 && pos + len < size && data[pos + len] == data[pos + len - dist]) ++len;
+        if (len > best_len) {
+          best_len = len;
+          best_dist = dist;
+        }
+      }
+      if (best_len >= 3) {
+        test_png_put_fixed_match(&w, best_len, best_dist);
+        pos += best_len;
+      }
+      else {
+        test_png_put_fixed_symbol(&w, data[pos++]);
+      }
+    }
+    test_png_put_fixed_symbol(&w, 256);
+  }
+  if (w.count) test_png_put_bits(&w, 0, 8 - w.count);
+
+  if (has_trailer) {
+    u32_t adler = adler32(data, size);
+    for (u32_t i = 0; i < 4; ++i) test_png_put_bits(&w, (adler >> (24 - i * 8)) & 0xFF, 8);
+  }
+  return buf_set(w.e, w.size);
+}
+
+static void
+test_png_put_chunk(stream_t* s, u32_t type, const u8_t* data, u32_t size) {
+  u8_t* start = s->contents.e + s->pos;
+  _memory_store_u32(start, u32_endian_swap(size));
+  _memory_store_u32(start + 4, u32_endian_swap(type));
+  if (size) memory_copy(start + 8, data, size);
+  _memory_store_u32(start + 8 + size, u32_endian_swap(crc32_ieee(start + 4, size + 4)));
+  s->pos += 12 + size;
+}
+
+struct test_png_desc_t {
+  u32_t w, h;
+  u32_t rows;  // how many rows of data there really are
+  u32_t extra; // bytes of junk after the rows
+  u32_t filter;
+  test_png_blocks_t blocks;
+  u32_t piece_size; // of each IDAT, 0 for one
+  b32_t has_trailer;
+};
+
+static buf_t
+test_png_make(test_png_desc_t* d, const u8_t* pixels, arena_t* arena) {
+  u32_t row_size = d->w * 4 + 1;
+  usz_t filtered_size = (usz_t)row_size * d->rows + d->extra;
+  u8_t* filtered = arena_push_arr_zero(u8_t, arena, filtered_size + 1);
+  if (!filtered) return buf_bad();
+  test_png_filter(filtered, pixels, d->w, d->rows, d->filter);
+
+  buf_t zlib = test_png_deflate(filtered, filtered_size, row_size, d->blocks, d->has_trailer, arena);
+  if (!buf_valid(zlib)) return buf_bad();
+
+  usz_t piece_size = d->piece_size ? d->piece_size : zlib.size;
+  usz_t piece_count = (zlib.size + piece_size - 1) / piece_size;
+  buf_t file = arena_push_buffer(arena, zlib.size + piece_count * 12 + 256);
+  if (!buf_valid(file)) return buf_bad();
+  stream_t s;
+  stream_init(&s, file);
+
+  static const u8_t signature[] = { 137, 80, 78, 71, 13, 10, 26, 10 };
+  memory_copy(file.e, signature, sizeof(signature));
+  s.pos += sizeof(signature);
+
+  u8_t IHDR[13] = {};
+  _memory_store_u32(IHDR, u32_endian_swap(d->w));
+  _memory_store_u32(IHDR + 4, u32_endian_swap(d->h));
+  IHDR[8] = 8;
+  IHDR[9] = 6;
+  test_png_put_chunk(&s, 'IHDR', IHDR, sizeof(IHDR));
+
+  // Decoding must skip what is not IDAT
+  test_png_put_chunk(&s, 'tEXt', (const u8_t*)"Comment\0momo", 12);
+  for (usz_t pos = 0; pos < zlib.size; pos += piece_size) {
+    test_png_put_chunk(&s, 'IDAT', zlib.e + pos, (u32_t)min_of(piece_size, zlib.size - pos));
+  }
+  test_png_put_chunk(&s, 'IEND', nullptr, 0);
+  return buf_set(file.e, s.pos);
+}
+
+//
+// Tests
+//
+static b32_t
+test_png_decodes(test_png_desc_t* d, const u8_t* pixels, arena_t* arena) {
+  arena_set_revert_point(arena);
+  buf_t file = test_png_make(d, pixels, arena);
+  test_png_check(buf_valid(file));
+  png_t png;
+  test_png_check(png_read(&png, file));
+
+  u32_t w = 0, h = 0;
+  u32_t* out = png_rasterize(&png, &w, &h, arena);
+  test_png_check(out && w == d->w && h == d->h);
+  test_png_check(memory_is_same(out, pixels, (usz_t)w * h * 4));
+
+  // Into the middle of a bigger image, which must not be touched elsewhere
+  u32_t pitch = (w + 9) * 4;
+  usz_t canvas_size = (usz_t)pitch * (h + 7);
+  u8_t* canvas = arena_push_arr(u8_t, arena, canvas_size);
+  test_png_check(canvas);
+  for (usz_t i = 0; i < canvas_size; ++i) canvas[i] = 0xCD;
+  u8_t* origin = canvas + 3 * pitch + 5 * 4;
+  test_png_check(png_rasterize_into_buffer(&png, origin, pitch, arena));
+  for (usz_t i = 0; i < canvas_size; ++i) {
+    usz_t offset = i - (usz_t)(origin - canvas);
+    b32_t is_inside = i >= (usz_t)(origin - canvas) && offset / pitch < h && offset % pitch < w * 4;
+    if (is_inside) {
+      test_png_check(canvas[i] == pixels[offset / pitch * w * 4 + offset % pitch]);
+    }
+    else {
+      test_png_check(canvas[i] == 0xCD);
+    }
+  }
+  return true;
+}
+
+static b32_t
+test_png_fails(test_png_desc_t* d, const u8_t* pixels, arena_t* arena) {
+  arena_set_revert_point(arena);
+  buf_t file = test_png_make(d, pixels, arena);
+  test_png_check(buf_valid(file));
+  png_t png;
+  test_png_check(png_read(&png, file));
+  test_png_check(!png_rasterize(&png, nullptr, nullptr, arena));
+  return true;
+}
+
+static b32_t
+test_png_valid(arena_t* arena) {
+  static const u32_t sizes[][2] = {
+    { 173, 151 }, // several times the inflate window
+    { 1, 300 },   // no pixel to the left, ever
+    { 17000, 3 }, // rows longer than the inflate window
+  };
+  static const u32_t piece_sizes[] = { 0, 1, 7, 1000 };
+  for_arr(size_index, sizes) {
+    arena_set_revert_point(arena);
+    u32_t w = sizes[size_index][0];
+    u32_t h = sizes[size_index][1];
+    u8_t* pixels = arena_push_arr(u8_t, arena, (usz_t)w * (h + 1) * 4);
+    test_png_check(pixels);
+    test_png_make_pixels(pixels, w, h + 1, w);
+
+    for (u32_t filter = 0; filter <= TEST_PNG_FILTER_MIXED; ++filter) {
+      for (u32_t blocks = 0; blocks < 2; ++blocks) {
+        for_arr(piece_index, piece_sizes) {
+          test_png_desc_t d = {};
+          d.w = w;
+          d.h = d.rows = h;
+          d.filter = filter;
+          d.blocks = (test_png_blocks_t)blocks;
+          d.piece_size = piece_sizes[piece_index];
+          d.has_trailer = true;
+          if (!test_png_decodes(&d, pixels, arena)) {
+            printf("  %ux%u, filter %u, blocks %u, pieces of %u\n", w, h, filter, blocks, d.piece_size);
+            return false;
+          }
+        }
+      }
+    }
+
+    // Older png_write() ended without an Adler-32
+    test_png_desc_t d = {};
+    d.w = w;
+    d.h = d.rows = h;
+    d.filter = TEST_PNG_FILTER_MIXED;
+    d.blocks = TEST_PNG_BLOCKS_STORED;
+    test_png_check(test_png_decodes(&d, pixels, arena));
+  }
+  printf("valid PNGs: OK\n");
+  return true;
+}
+
+static b32_t
+test_png_invalid(arena_t* arena) {
+  arena_set_revert_point(arena);
+  u32_t w = 173, h = 151;
+  u8_t* pixels = arena_push_arr(u8_t, arena, (usz_t)w * (h + 1) * 4);
+  test_png_check(pixels);
+  test_png_make_pixels(pixels, w, h + 1, 7);
+
+  for (u32_t blocks = 0; blocks < 2; ++blocks) {
+    test_png_desc_t good = {};
+    good.w = w;
+    good.h = good.rows = h;
+    good.filter = TEST_PNG_FILTER_MIXED;
+    good.blocks = (test_png_blocks_t)blocks;
+    good.piece_size = 4000;
+    good.has_trailer = true;
+
+    test_png_desc_t d = good;
+    d.rows = h - 1;
+    test_png_check(test_png_fails(&d, pixels, arena));
+
+    d = good;
+    d.rows = h + 1;
+    test_png_check(test_png_fails(&d, pixels, arena));
+
+    d = good;
+    d.extra = 3;
+    test_png_check(test_png_fails(&d, pixels, arena));
+
+    // Cut short anywhere in the IDATs
+    {
+      arena_set_revert_point(arena);
+      buf_t file = test_png_make(&good, pixels, arena);
+      test_png_check(buf_valid(file));
+      for (usz_t size = 60; size < file.size - 12; size += 997) {
+        png_t png;
+        test_png_check(png_read(&png, buf_set(file.e, size)));
+        test_png_check(!png_rasterize(&png, nullptr, nullptr, arena));
+      }
+    }
+
+    // Filter types past Paeth
+    {
+      arena_set_revert_point(arena);
+      u32_t row_size = w * 4 + 1;
+      usz_t filtered_size = (usz_t)row_size * h;
+      u8_t* filtered = arena_push_arr(u8_t, arena, filtered_size);
+      test_png_check(filtered);
+      test_png_filter(filtered, pixels, w, h, TEST_PNG_FILTER_MIXED);
+      filtered[row_size * 100] = 5;
+      buf_t zlib = test_png_deflate(filtered, filtered_size, row_size, good.blocks, true, arena);
+      test_png_check(buf_valid(zlib));
+      buf_t file = arena_push_buffer(arena, zlib.size + 256);
+      test_png_check(buf_valid(file));
+
+      // Swap the stream into a good file of the same layout
+      buf_t model = test_png_make(&good, pixels, arena);
+      test_png_check(buf_valid(model));
+      usz_t idat = 8 + 25 + 24;
+      memory_copy(file.e, model.e, idat);
+      stream_t s;
+      stream_init(&s, file);
+      s.pos = idat;
+      test_png_put_chunk(&s, 'IDAT', zlib.e, (u32_t)zlib.size);
+      test_png_put_chunk(&s, 'IEND', nullptr, 0);
+      png_t png;
+      test_png_check(png_read(&png, buf_set(file.e, s.pos)));
+      test_png_check(!png_rasterize(&png, nullptr, nullptr, arena));
+
+      // The same, with the right filter type, is fine
+      filtered[row_size * 100] = 0;
+      zlib = test_png_deflate(filtered, filtered_size, row_size, good.blocks, true, arena);
+      test_png_check(buf_valid(zlib));
+      s.pos = idat;
+      test_png_put_chunk(&s, 'IDAT', zlib.e, (u32_t)zlib.size);
+      test_png_put_chunk(&s, 'IEND', nullptr, 0);
+      test_png_check(png_read(&png, buf_set(file.e, s.pos)));
+      test_png_check(png_rasterize(&png, nullptr, nullptr, arena));
+    }
+
+    // A wrong Adler-32
+    {
+      arena_set_revert_point(arena);
+      buf_t file = test_png_make(&good, pixels, arena);
+      test_png_check(buf_valid(file));
+      file.e[file.size - 12 - 4 - 1] ^= 1;
+      png_t png;
+      test_png_check(png_read(&png, file));
+      test_png_check(!png_rasterize(&png, nullptr, nullptr, arena));
+    }
+  }
+
+  printf("invalid PNGs: OK\n");
+  return true;
+}
+
+// @note: Decoding must not need scratch memory that grows with the image
+static b32_t
+test_png_scratch(arena_t* arena) {
+  arena_set_revert_point(arena);
+  u32_t w = 1024, h = 1024;
+  u8_t* pixels = arena_push_arr(u8_t, arena, (usz_t)w * h * 4);
+  u8_t* out = arena_push_arr(u8_t, arena, (usz_t)w * h * 4);
+  test_png_check(pixels && out);
+  test_png_make_pixels(pixels, w, h, 11);
+
+  for (u32_t blocks = 0; blocks < 2; ++blocks) {
+    test_png_desc_t d = {};
+    d.w = w;
+    d.h = d.rows = h;
+    d.filter = TEST_PNG_FILTER_MIXED;
+    d.blocks = (test_png_blocks_t)blocks;
+    d.piece_size = 8192;
+    d.has_trailer = true;
+    buf_t file = test_png_make(&d, pixels, arena);
+    test_png_check(buf_valid(file));
+    png_t png;
+    test_png_check(png_read(&png, file));
+
+    usz_t scratch_size = _ZLIB_WINDOW_SIZE + _PNG_INFLATE_ROOM + 2 * (w * 4 + 1) + sizeof(_zlib_inflater_t) + 256;
+    arena_t scratch = {};
+    test_png_check(arena_init(&scratch, arena_push_buffer(arena, scratch_size)));
+    test_png_check(png_rasterize_into_buffer(&png, out, 0, &scratch));
+    test_png_check(scratch.pos == 0);
+    test_png_check(memory_is_same(out, pixels, (usz_t)w * h * 4));
+  }
+
+  printf("scratch memory: OK\n");
+  return true;
+}
+
+//
+// Unfiltering
+//
+
+// @note: How unfiltering was done before, a byte at a time through
+// streams, as the reference that every row kernel must match exactly.
+struct test_png_old_context_t {
+  stream_t image_stream;
+  u32_t image_width;
+
+  stream_t unfiltered_image_stream;
+};
+
+static b32_t
+test_png_old_filter_none(test_png_old_context_t* c) {
+  u32_t bpl = c->image_width * 4; // bytes per line
+  for (u32_t i = 0; i < bpl; ++i ){
+    u8_t* pixel_byte = stream_consume(u8_t, &c->unfiltered_image_stream);
+    if (pixel_byte == nullptr) {
+      return false;
+    }
+    stream_write(&c->image_stream, *pixel_byte);
+  }
+  return true;
+}
+
+static b32_t
+test_png_old_filter_sub(test_png_old_context_t* c) {
+  u32_t bpp = 4; // bytes per pixel
+  u32_t bpl = c->image_width * 4; // bytes per line
+  for (u32_t i = 0; i < bpl; ++i ){
+
+    u8_t* pixel_byte_p = stream_consume(u8_t, &c->unfiltered_image_stream);
+    if (pixel_byte_p == nullptr)return false;
+
+    u8_t pixel_byte = (*pixel_byte_p); // sub(x)
+    if (i < bpp) {
+      stream_write(&c->image_stream, pixel_byte);
+    }
+    else {
+      usz_t current_index = c->image_stream.pos;
+      u8_t left_reference = c->image_stream.contents.e[current_index - bpp]; // Raw(x-bpp)
+      u8_t pixel_byte_to_write = (pixel_byte + left_reference) % 256;  
+
+      stream_write(&c->image_stream, pixel_byte_to_write);
+    }
+
+  }    
+
+  return true;
+}
+
+static b32_t
+test_png_old_filter_average(test_png_old_context_t* c) {
+  u32_t bpp = 4; // bytes per pixel
+  u32_t bpl = c->image_width * 4; // bytes per line
+
+  for (u32_t i = 0; i < bpl; ++i ){
+
+    u8_t* pixel_byte_p = stream_consume(u8_t, &c->unfiltered_image_stream);
+    if (pixel_byte_p == nullptr) return false;
+
+    u8_t pixel_byte = (*pixel_byte_p); // sub(x)
+
+    usz_t current_index = c->image_stream.pos;
+    u8_t left = (i < bpp) ? 0 :  c->image_stream.contents.e[current_index - bpp]; // Raw(x-bpp)
+    u8_t top = (current_index < bpl) ? 0 : c->image_stream.contents.e[current_index - bpl]; // Prior(x)
+
+    // @note: Formula uses floor((left+top)/2). 
+    // Integer Truncation should do the job!
+    u8_t pixel_byte_to_write = (pixel_byte + (left + top)/2) % 256;  
+
+    stream_write(&c->image_stream, pixel_byte_to_write);
+  }
+
+
+  return true;
+}
+
+static b32_t
+test_png_old_filter_paeth(test_png_old_context_t* cx) {
+  u32_t bpp = 4; // bytes per pixel
+  u32_t bpl = cx->image_width * 4; // bytes per line
+
+  for (u32_t i = 0; i < bpl; ++i ){
+    u8_t* pixel_byte_p = stream_consume(u8_t, &cx->unfiltered_image_stream);
+    if (pixel_byte_p == nullptr) return false;
+    u8_t pixel_byte = (*pixel_byte_p); // Paeth(x)
+
+    // @note: PaethPredictor
+    // https://www.w3.org/TR/png_t-Filters.html
+    u8_t paeth_predictor; 
+    {
+      usz_t current_index = cx->image_stream.pos;
+
+      // respectively: left, top, top left
+      s32_t a, b, c;
+
+      a = (i < bpp) ? 0 : (s32_t)(cx->image_stream.contents.e[current_index - bpp]); // Raw(x-bpp)
+      b = (current_index < bpl) ? 0 : (s32_t)(cx->image_stream.contents.e[current_index - bpl]); // Prior(x)
+      c = (i < bpp || current_index < bpl) ? 0 : (s32_t)(cx->image_stream.contents.e[current_index - bpl - bpp]); // Prior(x)
+
+      s32_t p = a + b - c; //initial estimate
+      s32_t pa = s32_abs(p - a);
+      s32_t pb = s32_abs(p - b);
+      s32_t pc = s32_abs(p - c);
+      // Return nearest of a,b,c
+      // breaking ties in order a, b,c
+      if (pa <= pb && pa <= pc) {
+        paeth_predictor = (u8_t)a;
+      }
+      else if (pb <= pc) {
+        paeth_predictor = (u8_t)b;
+      }
+      else {
+        paeth_predictor = (u8_t)c;
+      }
+    }
+
+    u8_t pixel_byte_to_write = (pixel_byte + paeth_predictor)%256;  
+
+    stream_write(&cx->image_stream, pixel_byte_to_write);
+  }
+  return true;
+}
+
+static b32_t
+test_png_old_filter_up(test_png_old_context_t* c) {
+  u32_t bpl = c->image_width * 4; // bytes per line
+  for (u32_t i = 0; i < bpl; ++i ){
+    u8_t* pixel_byte_p = stream_consume(u8_t, &c->unfiltered_image_stream);
+    if (pixel_byte_p == nullptr) {
+      return false;
+    }
+    u8_t pixel_byte = (*pixel_byte_p); // Up(x)
+
+    // @note: Ignore first scanline
+    if (c->image_stream.pos < bpl) {
+      stream_write(&c->image_stream, pixel_byte);
+    }
+    else {
+      usz_t current_index = c->image_stream.pos;
+      u8_t top = c->image_stream.contents.e[current_index - bpl]; 
+      u8_t pixel_byte_to_write = (pixel_byte + top) % 256;  
+
+      stream_write(&c->image_stream, pixel_byte_to_write);
+    }
+  }
+
+  return true;
+}
+
+
+static b32_t
+test_png_old_filter(test_png_old_context_t* c) {
+
+  stream_reset(&c->unfiltered_image_stream);
+
+  // @note: Filter
+  // data always starts with 1 byte indicating the type of filter
+  // followed by the rest of the chunk.
+  while(!stream_is_eos(&c->unfiltered_image_stream)) {
+    u8_t* filter_type_p = stream_consume(u8_t, &c->unfiltered_image_stream);
+    u8_t filter_type = (*filter_type_p);
+    // @note: https://www.w3.org/TR/png_t-Filters.html
+    switch(filter_type) {
+      case 0: { // None
+        if (!test_png_old_filter_none(c)) return false;
+      } break;
+      case 1: { // Sub
+        if (!test_png_old_filter_sub(c)) return false;
+      } break;
+      case 2: {
+        if (!test_png_old_filter_up(c)) return false;
+      } break;
+      case 3: {
+        if (!test_png_old_filter_average(c)) return false;
+      } break;
+      case 4: {
+        if (!test_png_old_filter_paeth(c)) return false;
+      } break;
+      default: {
+        return false;
+      };
+    };
+  }
+  return true;
+
+}
+
+// @note: The row at a time kernel before it was vectorised
+static b32_t
+test_png_scalar_unfilter_row(u32_t filter_type, const u8_t* src, const u8_t* prior, u8_t* dest, u32_t bpl) {
+  const u32_t bpp = 4; // bytes per pixel
+  switch(filter_type) {
+    case 0: { // None
+      memory_copy(dest, src, bpl);
+    } break;
+    case 1: { // Sub
+      for (u32_t i = 0; i < bpp; ++i) {
+        dest[i] = src[i];
+      }
+      for (u32_t i = bpp; i < bpl; ++i) {
+        dest[i] = (u8_t)(src[i] + dest[i - bpp]);
+      }
+    } break;
+    case 2: { // Up
+      for (u32_t i = 0; i < bpl; ++i) {
+        dest[i] = (u8_t)(src[i] + prior[i]);
+      }
+    } break;
+    case 3: { // Average, of left and top rounded down
+      for (u32_t i = 0; i < bpp; ++i) {
+        dest[i] = (u8_t)(src[i] + (prior[i] >> 1));
+      }
+      for (u32_t i = bpp; i < bpl; ++i) {
+        dest[i] = (u8_t)(src[i] + ((dest[i - bpp] + prior[i]) >> 1));
+      }
+    } break;
+    case 4: { // Paeth, which is just top with nothing on the left
+      for (u32_t i = 0; i < bpp; ++i) {
+        dest[i] = (u8_t)(src[i] + prior[i]);
+      }
+      for (u32_t i = bpp; i < bpl; ++i) {
+        dest[i] = (u8_t)(src[i] + _png_paeth_predictor(dest[i - bpp], prior[i], prior[i - bpp]));
+      }
+    } break;
+    default: {
+      return false;
+    }
+  }
+  return true;
+}
+
+typedef b32_t test_png_unfilter_row_f(u32_t filter_type, const u8_t* src, const u8_t* prior, u8_t* dest, u32_t bpl);
+
+static b32_t
+test_png_unfilter_rows(test_png_unfilter_row_f* unfilter_row, const u8_t* filtered, u8_t* out, u32_t w, u32_t h, const u8_t* zero_row) {
+  u32_t bpl = w * 4;
+  for (u32_t y = 0; y < h; ++y) {
+    const u8_t* row = filtered + (usz_t)y * (bpl + 1);
+    u8_t* dest = out + (usz_t)y * bpl;
+    if (!unfilter_row(row[0], row + 1, y ? dest - bpl : zero_row, dest, bpl)) return false;
+  }
+  return true;
+}
+
+static b32_t
+test_png_unfilter_old(const u8_t* filtered, u8_t* out, u32_t w, u32_t h) {
+  test_png_old_context_t c = {};
+  c.image_width = w;
+  stream_init(&c.image_stream, buf_set(out, (usz_t)w * h * 4));
+  stream_init(&c.unfiltered_image_stream, buf_set((u8_t*)filtered, (usz_t)(w * 4 + 1) * h));
+  return test_png_old_filter(&c);
+}
+
+// Random filtered rows, with and without lots of small and large values,
+// which is where the 16-bit maths and the ties of Paeth are tested.
+static void
+test_png_make_filtered(u8_t* out, u32_t w, u32_t h, u32_t filter, rng_t* rng, b32_t is_extreme) {
+  static const u8_t extremes[] = { 0, 1, 2, 127, 128, 129, 253, 254, 255 };
+  for (u32_t y = 0; y < h; ++y) {
+    *out++ = (u8_t)(filter == TEST_PNG_FILTER_MIXED ? rng_next(rng) % 5 : filter);
+    for (u32_t i = 0; i < w * 4; ++i) {
+      u32_t r = rng_next(rng);
+      *out++ = is_extreme ? extremes[r % array_count(extremes)] : (u8_t)r;
+    }
+  }
+}
+
+static b32_t
+test_png_unfilter(arena_t* arena) {
+  arena_set_revert_point(arena);
+  const u32_t max_w = 1031;
+  const u32_t h = 6;
+  u8_t* filtered = arena_push_arr(u8_t, arena, (max_w * 4 + 1) * h);
+  u8_t* expected = arena_push_arr(u8_t, arena, max_w * 4 * h);
+  u8_t* scalar = arena_push_arr(u8_t, arena, max_w * 4 * h);
+  u8_t* out = arena_push_arr(u8_t, arena, max_w * 4 * h);
+  u8_t* zero_row = arena_push_arr_zero(u8_t, arena, max_w * 4);
+  test_png_check(filtered && expected && scalar && out && zero_row);
+
+  rng_t rng;
+  rng_init(&rng, 5);
+  for (u32_t w = 1; w <= max_w; w = w < 40 ? w + 1 : w * 2 - 9) {
+    for (u32_t filter = 0; filter <= TEST_PNG_FILTER_MIXED; ++filter) {
+      for (u32_t is_extreme = 0; is_extreme < 2; ++is_extreme) {
+        test_png_make_filtered(filtered, w, h, filter, &rng, is_extreme);
+        test_png_check(test_png_unfilter_old(filtered, expected, w, h));
+        test_png_check(test_png_unfilter_rows(test_png_scalar_unfilter_row, filtered, scalar, w, h, zero_row));
+        test_png_check(test_png_unfilter_rows(_png_unfilter_row, filtered, out, w, h, zero_row));
+        if (!memory_is_same(out, expected, w * 4 * h) || !memory_is_same(scalar, expected, w * 4 * h)) {
+          printf("FAILED: width %u, filter %u%s\n", w, filter, is_extreme ? ", extremes" : "");
+          return false;
+        }
+      }
+    }
+  }
+
+  // Filter types past Paeth
+  test_png_make_filtered(filtered, 8, 1, 0, &rng, false);
+  filtered[0] = 5;
+  test_png_check(!_png_unfilter_row(filtered[0], filtered + 1, zero_row, out, 8 * 4));
+
+  printf("unfiltering: OK\n");
+  return true;
+}
+
+// @note: Each filter type on every row of a big atlas, done the old way,
+// by the scalar row kernel and by _png_unfilter_row().
+static b32_t
+test_png_unfilter_bench(arena_t* arena) {
+  arena_set_revert_point(arena);
+  const u32_t w = 4096, h = 4096;
+  usz_t image_size = (usz_t)w * h * 4;
+  u8_t* pixels = arena_push_arr(u8_t, arena, image_size);
+  u8_t* filtered = arena_push_arr(u8_t, arena, image_size + h);
+  u8_t* out = arena_push_arr(u8_t, arena, image_size);
+  u8_t* zero_row = arena_push_arr_zero(u8_t, arena, w * 4);
+  test_png_check(pixels && filtered && out && zero_row);
+  test_png_make_pixels(pixels, w, h, 13);
+
+  static const char* names[] = { "none", "sub", "up", "average", "paeth" };
+  printf("\n%ux%u %-14s %14s %14s %14s %8s\n", w, h, "", "old", "scalar", "current", "speedup");
+  for (u32_t filter = 0; filter < 5; ++filter) {
+    test_png_filter(filtered, pixels, w, h, filter);
+
+    u64_t start = clock_time();
+    test_png_check(test_png_unfilter_old(filtered, out, w, h));
+    f64_t old_secs = test_png_seconds(start, clock_time());
+    test_png_check(memory_is_same(out, pixels, image_size));
+
+    const u32_t rounds = 4;
+    start = clock_time();
+    for (u32_t i = 0; i < rounds; ++i) {
+      test_png_check(test_png_unfilter_rows(test_png_scalar_unfilter_row, filtered, out, w, h, zero_row));
+    }
+    f64_t scalar_secs = test_png_seconds(start, clock_time()) / rounds;
+    test_png_check(memory_is_same(out, pixels, image_size));
+
+    memory_zero(out, image_size);
+    start = clock_time();
+    for (u32_t i = 0; i < rounds; ++i) {
+      test_png_check(test_png_unfilter_rows(_png_unfilter_row, filtered, out, w, h, zero_row));
+    }
+    f64_t secs = test_png_seconds(start, clock_time()) / rounds;
+    test_png_check(memory_is_same(out, pixels, image_size));
+
+    f64_t mb = (f64_t)image_size / (1024.0 * 1024.0);
+    printf("%-24s %9.1f MB/s %9.1f MB/s %9.1f MB/s %7.1fx\n",
+           names[filter], mb / old_secs, mb / scalar_secs, mb / secs, scalar_secs / secs);
+  }
+  return true;
+}
+
+//
+// Writing
+//
+
+// @note: png_write() must give a PNG that decodes to the same pixels at
+// every level, and the same file with a job system as without.
+static b32_t
+test_png_write(job_system_t* js, arena_t* arena) {
+  static const u32_t sizes[][2] = {
+    { 1, 1 }, { 3, 5 }, { 173, 301 }, { 300, 200 }, { 1024, 300 },
+  };
+  for_arr(size_index, sizes) {
+    u32_t w = sizes[size_index][0];
+    u32_t h = sizes[size_index][1];
+    for (u32_t level = 0; level <= 9; ++level) {
+      arena_set_revert_point(arena);
+      u32_t* pixels = arena_push_arr(u32_t, arena, w * h);
+      test_png_check(pixels);
+      test_png_make_pixels((u8_t*)pixels, w, h, w + level);
+
+      buf_t file = png_write(pixels, w, h, arena, level);
+      buf_t js_file = png_write(pixels, w, h, arena, level, js);
+      test_png_check(buf_valid(file) && buf_valid(js_file));
+      test_png_check(file.size == js_file.size && memory_is_same(file.e, js_file.e, file.size));
+
+      png_t png;
+      test_png_check(png_read(&png, file));
+      u32_t out_w = 0, out_h = 0;
+      u32_t* out = png_rasterize(&png, &out_w, &out_h, arena);
+      test_png_check(out && out_w == w && out_h == h);
+      test_png_check(memory_is_same(out, pixels, w * h * 4));
+    }
+  }
+  printf("png_write: OK\n");
+  return true;
+}
+
+// @note: png_write() as it was: no filtering and only stored blocks
+static buf_t
+test_png_old_write(u32_t* pixels, u32_t width, u32_t height, arena_t* arena) {
+static const u8_t signature[] = { 
+    137, 80, 78, 71, 13, 10, 26, 10 
+  };
+  u32_t image_bpl = (width * 4);
+  u32_t data_bpl = image_bpl + 1; // bytes per line
+  u32_t data_size = data_bpl * height;
+  u32_t max_chunk_size = 65535;
+  u32_t signature_size = sizeof(signature);
+  u32_t chunk_size = sizeof(_png_chunk_header_t) + sizeof(_png_chunk_footer_t);
+  u32_t IHDR_size = chunk_size + sizeof(_png_ihdr_t);
+  u32_t IEND_size = chunk_size;
+  u32_t IDAT_size = chunk_size + sizeof(_png_idat_header_t) + sizeof(u32_t); // and Adler-32
+  u32_t lines_per_chunk = max_chunk_size / data_bpl;
+  u32_t chunk_count = height / lines_per_chunk;
+
+  if (height % lines_per_chunk) {
+    chunk_count += 1;
+  }
+  u32_t IDAT_chunk_size = 5 * chunk_count;
+
+  u32_t expected_memory_required = (signature_size + 
+      IHDR_size + 
+      IEND_size + 
+      IDAT_size + 
+      data_size + 
+      IDAT_chunk_size);
+
+  buf_t stream_memory = arena_push_buffer(arena, expected_memory_required);
+  if (!buf_valid(stream_memory)) return buf_bad();
+
+  stream_t stream;
+  stream_init(&stream, stream_memory);
+  stream_write_block(&stream, (void*)signature, sizeof(signature));
+
+
+  // @note: write IHDR
+  {
+    u8_t* crc_start = nullptr;
+
+    _png_chunk_header_t header = {};
+    header.type_U32 = u32_endian_swap('IHDR');
+    header.length = sizeof(_png_ihdr_t);
+    header.length = u32_endian_swap(header.length);
+    stream_write(&stream, header);
+    crc_start = stream.contents.e + stream.pos - sizeof(header.type_U32);
+
+    _png_ihdr_t IHDR = {};
+    IHDR.width = u32_endian_swap(width);
+    IHDR.height = u32_endian_swap(height);
+    IHDR.bit_depth = 8; // ??
+    IHDR.colour_type = 6;
+    IHDR.compression_method = 0;
+    IHDR.filter_method = 0;
+    IHDR.interlace_method = 0;
+    stream_write(&stream, IHDR);
+
+    _png_chunk_footer_t footer = {};
+    u32_t crc_size = (u32_t)(stream.contents.e + stream.pos - crc_start);
+    footer.crc = _png_calculate_crc32(crc_start, crc_size); 
+    footer.crc = u32_endian_swap(footer.crc);
+    stream_write(&stream, footer);
+
+  }
+
+  // @note: write IDAT
+  {
+
+    u32_t chunk_overhead = sizeof(u16_t)*2 + sizeof(u8_t)*1;
+
+    u8_t* crc_start = nullptr;
+
+    _png_chunk_header_t header = {};
+    header.type_U32 = u32_endian_swap('IDAT');
+    header.length = sizeof(_png_idat_header_t) + (chunk_overhead*chunk_count) + data_size + sizeof(u32_t); 
+    header.length = u32_endian_swap(header.length);    
+    stream_write(&stream, header);
+    crc_start = stream.contents.e + stream.pos - sizeof(header.type_U32);
+
+    // @note: Hardcoded IDAT chunk header header that fits our use-case
+    //
+    // CM = 8
+    // CINFO = any number < 7? 1?
+    // FCHECK = 23? if CM == 8 and CINFO == 1
+    // FDIC = 0;
+    // FLEVEL = 1? Documentation says it doesn't matter;
+    _png_idat_header_t IDAT;
+    IDAT.compression_flags = 8;
+    IDAT.additional_flags = 29;
+    stream_write(&stream, IDAT);
+
+
+    // @note: Deflate chunk header
+    //
+    // BFINAL = 1 (1 bit); // indicates if it's the final block
+    // BTYPE = 0 (2 bits); // indicates no compression
+    // 
+    u32_t lines_remaining = height;
+    u32_t current_line = 0;
+    u32_t adler = adler32(nullptr, 0);
+
+    for (u32_t chunk_index = 0; chunk_index < chunk_count; ++chunk_index){
+      u32_t lines_to_write = min_of(lines_remaining, lines_per_chunk);
+      lines_remaining -= lines_to_write;
+
+      u8_t BFINAL = ((chunk_index + 1) == chunk_count) ? 1 : 0;
+      stream_write(&stream, BFINAL);
+
+      u16_t LEN = (u16_t)(lines_to_write * data_bpl); // number of data bytes in the block
+      u16_t NLEN = ~LEN; // one's complement of LEN
+      stream_write(&stream, LEN);
+      stream_write(&stream, NLEN);
+
+      // @note: Output data here
+      // We have to do it row by row to add the filter byte at the front
+      for (u32_t line_index = 0; line_index < lines_to_write; ++line_index) 
+      {
+        u8_t no_filter = 0;
+        stream_write(&stream, no_filter); // Filter type: None
+
+        u8_t* line = (u8_t*)pixels + (current_line * image_bpl);
+        stream_write_block(&stream, line, image_bpl);
+        adler = adler32(&no_filter, 1, adler);
+        adler = adler32(line, image_bpl, adler);
+
+        ++current_line;
+
+      }
+
+
+    }
+
+    // @note: zlib ends with the Adler-32 of the data, big endian
+    adler = u32_endian_swap(adler);
+    stream_write(&stream, adler);
+
+    _png_chunk_footer_t footer = {};
+    u32_t crc_size = (u32_t)(stream.contents.e + stream.pos - crc_start);
+    footer.crc = _png_calculate_crc32(crc_start, crc_size); 
+    footer.crc = u32_endian_swap(footer.crc);
+    stream_write(&stream, footer);
+  }
+
+  // @note: stream_write IEND
+  {
+    u8_t* crc_start = nullptr;
+
+    _png_chunk_header_t header = {};
+    header.type_U32 = u32_endian_swap('IEND');
+    header.length = 0;
+    stream_write(&stream, header);
+    crc_start = stream.contents.e + stream.pos - sizeof(header.type_U32);
+
+
+    _png_chunk_footer_t footer = {};
+    u32_t crc_size = (u32_t)(stream.contents.e + stream.pos - crc_start);
+    footer.crc = _png_calculate_crc32(crc_start, crc_size); 
+    footer.crc = u32_endian_swap(footer.crc);
+    stream_write(&stream, footer);
+  }
+
+
+
+  return buf_set(stream.contents.e, stream.pos);
+}
+
+static b32_t
+test_png_write_bench(u32_t* pixels, u32_t w, u32_t h, const char* name, job_system_t* js, arena_t* arena) {
+  arena_set_revert_point(arena);
+  usz_t image_size = (usz_t)w * h * 4;
+  u32_t rounds = (u32_t)clamp_of(megabytes(64) / image_size, (usz_t)1, (usz_t)100);
+
+  u64_t start = clock_time();
+  buf_t old_file = {};
+  for (u32_t i = 0; i < rounds; ++i) {
+    arena_set_revert_point(arena);
+    old_file = test_png_old_write(pixels, w, h, arena);
+    test_png_check(buf_valid(old_file));
+  }
+  f64_t old_secs = test_png_seconds(start, clock_time());
+  usz_t old_size = old_file.size;
+  f64_t old_mbps = (f64_t)image_size * rounds / old_secs / (1024.0 * 1024.0);
+  printf("%-24s %-10s %10u %7.3f %7.1f MB/s\n", name, "old", (u32_t)old_size, 1.0, old_mbps);
+
+  static const u32_t levels[] = { 0, 1, 6, 9 };
+  for (u32_t pass = 0; pass < array_count(levels) + 1; ++pass) {
+    b32_t is_parallel = pass == array_count(levels);
+    u32_t level = is_parallel ? 6 : levels[pass];
+    // Slower levels get fewer rounds
+    u32_t level_rounds = level <= 1 ? rounds : max_of(rounds / 8, 1u);
+
+    start = clock_time();
+    buf_t file = {};
+    for (u32_t i = 0; i < level_rounds; ++i) {
+      arena_set_revert_point(arena);
+      file = png_write(pixels, w, h, arena, level, is_parallel ? js : nullptr);
+      test_png_check(buf_valid(file));
+    }
+    f64_t secs = test_png_seconds(start, clock_time());
+    f64_t mbps = (f64_t)image_size * level_rounds / secs / (1024.0 * 1024.0);
+    char label[32];
+    snprintf(label, sizeof(label), is_parallel ? "%u, jobs" : "%u", level);
+    printf("%-24s %-10s %10u %7.3f %7.1f MB/s\n", "", label, (u32_t)file.size, (f64_t)file.size / old_size, mbps);
+  }
+  return true;
+}
+
+//
+// Benchmark
+//
+struct test_png_bench_t {
+  const char* name;
+  buf_t file;
+};
+
+// Concatenates the IDAT chunks of a PNG
+static buf_t
+test_png_idat(buf_t file, arena_t* arena) {
+  usz_t size = 0;
+  for (u32_t pass = 0; pass < 2; ++pass) {
+    buf_t ret = {};
+    if (pass == 1) {
+      ret = arena_push_buffer(arena, size);
+      if (!buf_valid(ret)) return buf_bad();
+    }
+    usz_t pos = 8;
+    size = 0;
+    while (pos + 12 <= file.size) {
+      u32_t length = u32_endian_swap(_memory_load_u32(file.e + pos));
+      u32_t type = u32_endian_swap(_memory_load_u32(file.e + pos + 4));
+      if (pos + 12 + length > file.size) return buf_bad();
+      if (type == 'IDAT') {
+        if (pass == 1) memory_copy(ret.e + size, file.e + pos + 8, length);
+        size += length;
+      }
+      pos += 12 + length;
+    }
+    if (pass == 1) return ret;
+  }
+  return buf_bad();
+}
+
+// @note: How png_rasterize() worked before: it joined the IDATs, inflated
+// all of them, then unfiltered. 'scratch_size' gets what that took on top
+// of the image.
+static b32_t
+test_png_rasterize_joined(png_t* png, u8_t* dest, arena_t* arena, usz_t* scratch_size) {
+  arena_set_revert_point(arena);
+  u32_t bpl = png->width * 4;
+  u32_t row_size = bpl + 1;
+  buf_t zlib = test_png_idat(png->contents, arena);
+  buf_t unfiltered = arena_push_buffer(arena, (usz_t)row_size * png->height);
+  if (!buf_valid(zlib) || !buf_valid(unfiltered)) return false;
+  *scratch_size = zlib.size + unfiltered.size;
+
+  usz_t size = 0;
+  if (!zlib_inflate(unfiltered, zlib, &size) || size != unfiltered.size) return false;
+  u8_t* zero_row = arena_push_arr_zero(u8_t, arena, bpl);
+  if (!zero_row) return false;
+  for (u32_t y = 0; y < png->height; ++y) {
+    u8_t* row = unfiltered.e + (usz_t)y * row_size;
+    u8_t* out = dest + (usz_t)y * bpl;
+    if (!_png_unfilter_row(row[0], row + 1, y ? out - bpl : zero_row, out, bpl)) return false;
+  }
+  return true;
+}
+
+static b32_t
+test_png_bench(test_png_bench_t* benches, u32_t bench_count, arena_t* arena) {
+  printf("\n%-24s %10s %18s %18s %8s\n", "", "pixels", "streaming", "joined", "speedup");
+  for (u32_t bench_index = 0; bench_index < bench_count; ++bench_index) {
+    arena_set_revert_point(arena);
+    test_png_bench_t* b = benches + bench_index;
+    png_t png;
+    test_png_check(png_read(&png, b->file));
+    usz_t image_size = (usz_t)png.width * png.height * 4;
+    u8_t* out = arena_push_arr(u8_t, arena, image_size);
+    u8_t* joined_out = arena_push_arr(u8_t, arena, image_size);
+    test_png_check(out && joined_out);
+
+    u32_t rounds = (u32_t)clamp_of(megabytes(256) / image_size, (usz_t)1, (usz_t)1000);
+
+    usz_t pos = arena->pos;
+    u64_t start = clock_time();
+    for (u32_t i = 0; i < rounds; ++i) {
+      test_png_check(png_rasterize_into_buffer(&png, out, 0, arena));
+    }
+    f64_t secs = test_png_seconds(start, clock_time());
+    test_png_check(arena->pos == pos);
+
+    usz_t joined_scratch_size = 0;
+    start = clock_time();
+    for (u32_t i = 0; i < rounds; ++i) {
+      test_png_check(test_png_rasterize_joined(&png, joined_out, arena, &joined_scratch_size));
+    }
+    f64_t joined_secs = test_png_seconds(start, clock_time());
+    test_png_check(memory_is_same(out, joined_out, image_size));
+
+    // What the window and the inflater take
+    u32_t row_size = png.width * 4 + 1;
+    usz_t scratch_size = _ZLIB_WINDOW_SIZE + _PNG_INFLATE_ROOM + 2 * row_size + sizeof(_zlib_inflater_t);
+    f64_t mbps = (f64_t)image_size * rounds / secs / (1024.0 * 1024.0);
+    f64_t joined_mbps = (f64_t)image_size * rounds / joined_secs / (1024.0 * 1024.0);
+    printf("%-24s %4ux%-5u %7.1f MB/s %6u KB %7.1f MB/s %6u KB %7.1fx\n",
+           b->name, png.width, png.height,
+           mbps, (u32_t)(scratch_size / 1024),
+           joined_mbps, (u32_t)(joined_scratch_size / 1024),
+           mbps / joined_mbps);
+  }
+  return true;
+}
+
+int main(int argc, char** argv) {
+  arena_t arena = {};
+  if (!arena_alloc(&arena, megabytes(512))) {
+    printf("Failed to allocate arena\n");
+    return 1;
+  }
+  defer { arena_free(&arena); };
+
+  if (!test_png_valid(&arena)) return 1;
+  if (!test_png_invalid(&arena)) return 1;
+  if (!test_png_scratch(&arena)) return 1;
+  if (!test_png_unfilter(&arena)) return 1;
+  if (!test_png_unfilter_bench(&arena)) return 1;
+
+  job_system_t js = {};
+  if (!job_system_init(&js, 3, 256, &arena)) {
+    printf("Failed to start the job system\n");
+    return 1;
+  }
+  defer { job_system_free(&js); };
+  if (!test_png_write(&js, &arena)) return 1;
+
+  // PNGs on the command line must decode, and are what gets benchmarked
+  test_png_bench_t benches[64];
+  u32_t bench_count = 0;
+  for (s32_t i = 1; i < argc && bench_count < array_count(benches); ++i) {
+    buf_t file = file_read_into_buffer(argv[i], &arena);
+    png_t png;
+    if (!buf_valid(file) || !png_read(&png, file) || !png_rasterize(&png, nullptr, nullptr, &arena)) {
+      printf("FAILED: cannot decode %s\n", argv[i]);
+      return 1;
+    }
+    benches[bench_count++] = { argv[i], file };
+  }
+  if (bench_count == 0) {
+    static const u32_t sizes[] = { 1024, 2048 };
+    for_arr(i, sizes) {
+      u32_t w = sizes[i];
+      u8_t* pixels = arena_push_arr(u8_t, &arena, (usz_t)w * w * 4);
+      if (!pixels) return 1;
+      test_png_make_pixels(pixels, w, w, w);
+      test_png_desc_t d = {};
+      d.w = d.h = d.rows = w;
+      d.filter = TEST_PNG_FILTER_MIXED;
+      d.blocks = TEST_PNG_BLOCKS_FIXED;
+      d.piece_size = 8192;
+      d.has_trailer = true;
+      benches[bench_count].name = i == 0 ? "made 1024x1024" : "made 2048x2048";
+      benches[bench_count].file = test_png_make(&d, pixels, &arena);
+      if (!buf_valid(benches[bench_count].file)) return 1;
+      ++bench_count;
+    }
+  }
+  if (!test_png_bench(benches, bench_count, &arena)) return 1;
+
+  // The same images written back out
+  printf("\n%-24s %-10s %10s %7s %12s\n", "png_write", "level", "bytes", "ratio", "");
+  for (u32_t bench_index = 0; bench_index < bench_count; ++bench_index) {
+    arena_set_revert_point(&arena);
+    png_t png;
+    u32_t w = 0, h = 0;
+    u32_t* pixels = nullptr;
+    if (png_read(&png, benches[bench_index].file)) {
+      pixels = png_rasterize(&png, &w, &h, &arena);
+    }
+    if (!pixels) return 1;
+    if (!test_png_write_bench(pixels, w, h, benches[bench_index].name, &js, &arena)) return 1;
+  }
+
+  return 0;
+}
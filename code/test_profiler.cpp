@@ -0,0 +1,234 @@
+//
+// Tests and overhead benchmark for eden's profiler.
+//
+// Checks that nested blocks form a tree, that every thread gets its
+// own ring, that blocks overwritten by a wrapping ring are dropped
+// instead of corrupting the ring, and that the Chrome trace has every
+// event. Then times an empty block with and without tracing.
+//
+// Build optimized, e.g.
+//   clang++ -std=c++17 -O2 -DEDEN_DEBUG=1 test_profiler.cpp -lpthread
+//
+
+#include <stdio.h>
+
+#include "eden.h"
+
+#define TEST_PROFILER_TASKS       64
+#define TEST_PROFILER_BENCH_COUNT 1000000
+
+#define test_profiler_check(cond) \
+  if (!(cond)) { printf("FAILED (line %d): %s\n", __LINE__, #cond); return false; }
+
+static eden_profiler_event_t*
+test_profiler_get_event(eden_profiler_t* p, eden_profiler_thread_t* t, u64_t event) {
+  return t->events + (event & (p->event_cap - 1));
+}
+
+static b32_t
+test_profiler_nesting(eden_profiler_t* p) {
+  eden_profiler_clear_trace(p);
+  eden_profile_frame();
+  {
+    eden_profile_block(outer);
+    {
+      eden_profile_block(middle);
+      eden_profile_block(inner);
+    }
+    eden_profile_block(sibling);
+  }
+
+  eden_profiler_thread_t* t = _eden_profiler_get_thread(p);
+  test_profiler_check(t);
+  test_profiler_check(t->os_thread_id == thread_get_id());
+  test_profiler_check(t->event_count == 5);
+  test_profiler_check(t->depth == 0 && t->open_event == U64_MAX);
+
+  eden_profiler_event_t* frame = test_profiler_get_event(p, t, 0);
+  eden_profiler_event_t* outer = test_profiler_get_event(p, t, 1);
+  eden_profiler_event_t* middle = test_profiler_get_event(p, t, 2);
+  eden_profiler_event_t* inner = test_profiler_get_event(p, t, 3);
+  eden_profiler_event_t* sibling = test_profiler_get_event(p, t, 4);
+
+  test_profiler_check(frame->name == nullptr);
+  test_profiler_check(outer->depth == 0 && outer->parent == U64_MAX);
+  test_profiler_check(middle->depth == 1 && middle->parent == 1);
+  test_profiler_check(inner->depth == 2 && inner->parent == 2);
+  test_profiler_check(sibling->depth == 1 && sibling->parent == 1);
+
+  // children are inside their parents
+  test_profiler_check(outer->begin <= middle->begin && middle->end <= outer->end);
+  test_profiler_check(middle->begin <= inner->begin && inner->end <= middle->end);
+  test_profiler_check(middle->end <= sibling->begin && sibling->end <= outer->end);
+
+  printf("nesting: OK\n");
+  return true;
+}
+
+static void
+test_profiler_task(void* data) {
+  eden_profile_block(task);
+  volatile u32_t sum = 0;
+  for (u32_t i = 0; i < 100000; ++i) sum += i;
+}
+
+static b32_t
+test_profiler_threads(eden_profiler_t* p, job_system_t* js) {
+  eden_profiler_clear_trace(p);
+
+  job_counter_t counter = {};
+  for (u32_t i = 0; i < TEST_PROFILER_TASKS; ++i)
+    job_add(js, test_profiler_task, nullptr, &counter);
+  job_wait(js, &counter);
+
+  // every task is an event on exactly one thread
+  u64_t task_count = 0;
+  u32_t threads_with_tasks = 0;
+  u32_t thread_count = eden_profiler_get_thread_count(p);
+  for (u32_t thread_index = 0; thread_index < thread_count; ++thread_index) {
+    eden_profiler_thread_t* t = p->threads + thread_index;
+    for (u32_t other_index = 0; other_index < thread_index; ++other_index)
+      test_profiler_check(p->threads[other_index].os_thread_id != t->os_thread_id);
+
+    for (u64_t event = 0; event < t->event_count; ++event) {
+      eden_profiler_event_t* e = test_profiler_get_event(p, t, event);
+      test_profiler_check(e->name && e->end >= e->begin && e->depth == 0);
+    }
+    task_count += t->event_count;
+    threads_with_tasks += t->event_count > 0;
+  }
+  test_profiler_check(task_count == TEST_PROFILER_TASKS);
+
+  printf("threads: OK (%u tasks over %u threads)\n", TEST_PROFILER_TASKS, threads_with_tasks);
+  return true;
+}
+
+static b32_t
+test_profiler_wrap(eden_profiler_t* p) {
+  eden_profiler_clear_trace(p);
+  eden_profiler_thread_t* t = _eden_profiler_get_thread(p);
+  test_profiler_check(t);
+
+  // the outer block's event gets overwritten by its children
+  {
+    eden_profile_block(long_block);
+    for (u32_t i = 0; i < p->event_cap + 10; ++i) {
+      eden_profile_block(short_block);
+    }
+  }
+  test_profiler_check(t->dropped_count == 1);
+  test_profiler_check(t->depth == 0 && t->open_event == U64_MAX);
+
+  for (u64_t event = t->event_count - p->event_cap; event < t->event_count; ++event) {
+    eden_profiler_event_t* e = test_profiler_get_event(p, t, event);
+    test_profiler_check(e->depth == 1 && e->parent == 0 && e->end >= e->begin);
+  }
+
+  printf("wrap: OK\n");
+  return true;
+}
+
+static u32_t
+test_profiler_count(buf_t str, const char* what) {
+  usz_t what_len = cstr_len(what);
+  u32_t count = 0;
+  for (usz_t i = 0; i + what_len <= str.size; ++i) {
+    if (cstr_compare_n((const c8_t*)str.e + i, what, what_len)) ++count;
+  }
+  return count;
+}
+
+static b32_t
+test_profiler_export(eden_profiler_t* p, job_system_t* js, arena_t* arena) {
+  eden_profiler_clear_trace(p);
+  for (u32_t frame = 0; frame < 3; ++frame) {
+    eden_profile_frame();
+    eden_profile_block(frame_block);
+    job_counter_t counter = {};
+    for (u32_t i = 0; i < TEST_PROFILER_TASKS; ++i)
+      job_add(js, test_profiler_task, nullptr, &counter);
+    job_wait(js, &counter);
+  }
+
+  const char* filename = "test_profiler_trace.json";
+  test_profiler_check(eden_profiler_export_trace(p, filename, arena));
+
+  arena_set_revert_point(arena);
+  buf_t trace = file_read_into_buffer(filename, arena);
+  test_profiler_check(buf_valid(trace));
+  test_profiler_check(trace.size > 0 && trace.e[0] == '{');
+  test_profiler_check(test_profiler_count(trace, "\"ph\":\"i\"") == 3);
+  test_profiler_check(test_profiler_count(trace, "\"name\":\"task\"") == TEST_PROFILER_TASKS * 3);
+  test_profiler_check(test_profiler_count(trace, "\"name\":\"frame_block\"") == 3);
+
+  printf("export: OK (%u bytes in %s)\n", (u32_t)trace.size, filename);
+  return true;
+}
+
+// @note: A block reads clock_cycles() twice, so this is the floor.
+// It can be a lot slower in a VM.
+static f64_t
+test_profiler_bench_clock(u32_t count) {
+  volatile u64_t sink = 0;
+  u64_t start = clock_time();
+  for (u32_t i = 0; i < count; ++i) {
+    sink = sink + clock_cycles();
+  }
+  u64_t end = clock_time();
+  return (f64_t)(end - start) * 1000000000.0 / clock_resolution() / count;
+}
+
+static f64_t
+test_profiler_bench(u32_t count) {
+  u64_t start = clock_time();
+  for (u32_t i = 0; i < count; ++i) {
+    eden_profile_block(bench);
+  }
+  u64_t end = clock_time();
+  return (f64_t)(end - start) * 1000000000.0 / clock_resolution() / count;
+}
+
+int main() {
+  static eden_t e = {};
+  eden_globalize(&e);
+
+  arena_t arena = {};
+  if (!arena_alloc(&arena, megabytes(64))) {
+    printf("Failed to allocate arena\n");
+    return 1;
+  }
+  defer { arena_free(&arena); };
+
+  if (!eden_profiler_init(&eden->profiler, &arena, 16, 4, 16, 1024)) {
+    printf("Failed to init profiler\n");
+    return 1;
+  }
+
+  job_system_t js = {};
+  if (!job_system_init(&js, 4, 1024, &arena)) {
+    printf("Failed to init job system\n");
+    return 1;
+  }
+  defer { job_system_free(&js); };
+
+  if (!test_profiler_nesting(&eden->profiler)) return 1;
+  if (!test_profiler_threads(&eden->profiler, &js)) return 1;
+  if (!test_profiler_wrap(&eden->profiler)) return 1;
+  if (!test_profiler_export(&eden->profiler, &js, &arena)) return 1;
+
+  // Overhead
+  f64_t traced = test_profiler_bench(TEST_PROFILER_BENCH_COUNT);
+
+  static eden_t untraced_eden = {};
+  eden_globalize(&untraced_eden);
+  if (!eden_profiler_init(&eden->profiler, &arena, 16, 4, 0, 0)) {
+    printf("Failed to init profiler\n");
+    return 1;
+  }
+  f64_t untraced = test_profiler_bench(TEST_PROFILER_BENCH_COUNT);
+
+  f64_t clock = test_profiler_bench_clock(TEST_PROFILER_BENCH_COUNT);
+
+  printf("overhead per block: %.1f ns traced, %.1f ns untraced (clock_cycles() is %.1f ns)\n", traced, untraced, clock);
+  return 0;
+}
@@ -0,0 +1,295 @@
+//
+// Golden test and benchmark for the SIMD ray-vs-segment kernels.
+//
+// The golden test checks that bonk_ray2_segs2() (1 ray vs many segments),
+// bonk_rays2_segs2() (packets of rays vs 1 segment) and bvh2_raycast()
+// give exactly the same times as testing segments one by one with
+// bonk_ray2_seg2(), which is what lit's scalar path does. It covers random
+// segments plus nasty ones: axis aligned, parallel to the ray,
+// zero length, and rays that go through end points.
+//
+// The benchmark mimics lit's light generation on level-sized inputs
+// (16 to 256 edges, a handful of lights, 3 rays per edge end point).
+//
+// Build optimized, e.g.
+//   clang++ -std=c++17 -O2 -march=native test_seg2.cpp
+//
+
+#include <stdio.h>
+
+#include "momo.h"
+
+#define TEST_SEG2_MAX_SEGS    300
+#define TEST_SEG2_MAX_RAYS    1024
+#define TEST_SEG2_LIGHT_COUNT 6
+#define TEST_SEG2_WIDTH       800.f
+#define TEST_SEG2_HEIGHT      800.f
+
+struct test_seg2_edge_t {
+  v2f_t start_pt;
+  v2f_t end_pt;
+};
+
+// @note: the scalar path, like lit_game_get_ray_intersection_time_wrt_edges()
+static f32_t
+test_seg2_scalar(v2f_t ray_origin, v2f_t ray_dir, test_seg2_edge_t* edges, u32_t edge_count, f32_t max_t) {
+  f32_t lowest_t1 = max_t;
+  for (u32_t i = 0; i < edge_count; ++i) {
+    lowest_t1 = bonk_ray2_seg2(ray_origin, ray_dir, edges[i].start_pt, edges[i].end_pt - edges[i].start_pt, lowest_t1);
+  }
+  return lowest_t1;
+}
+
+static b32_t
+test_seg2_is_same(f32_t lhs, f32_t rhs) {
+  union { f32_t f; u32_t u; } l, r;
+  l.f = lhs; r.f = rhs;
+  return l.u == r.u || (lhs != lhs && rhs != rhs);
+}
+
+static v2f_t
+test_seg2_rand_pt(rng_t* rng) {
+  return v2f_set(rng_range_f32(rng, 0.f, TEST_SEG2_WIDTH), rng_range_f32(rng, 0.f, TEST_SEG2_HEIGHT));
+}
+
+// Mostly grid-snapped boxes and lines like lit's levels, with some
+// degenerate segments thrown in.
+static void
+test_seg2_gen_edges(rng_t* rng, test_seg2_edge_t* edges, u32_t edge_count) {
+  for (u32_t i = 0; i < edge_count;) {
+    u32_t kind = rng_choice(rng, 6);
+    if (kind == 0 && i + 4 <= edge_count) {
+      f32_t x0 = (f32_t)rng_range_s32(rng, 1, 30) * 25.f;
+      f32_t y0 = (f32_t)rng_range_s32(rng, 1, 30) * 25.f;
+      f32_t x1 = x0 + (f32_t)rng_range_s32(rng, 1, 4) * 25.f;
+      f32_t y1 = y0 + (f32_t)rng_range_s32(rng, 1, 4) * 25.f;
+      edges[i++] = { v2f_set(x0, y0), v2f_set(x1, y0) };
+      edges[i++] = { v2f_set(x1, y0), v2f_set(x1, y1) };
+      edges[i++] = { v2f_set(x1, y1), v2f_set(x0, y1) };
+      edges[i++] = { v2f_set(x0, y1), v2f_set(x0, y0) };
+    }
+    else if (kind == 1) {
+      // zero length
+      v2f_t p = test_seg2_rand_pt(rng);
+      edges[i++] = { p, p };
+    }
+    else if (kind == 2 && i > 0) {
+      // same segment, reversed
+      edges[i] = { edges[i-1].end_pt, edges[i-1].start_pt };
+      ++i;
+    }
+    else {
+      edges[i++] = { test_seg2_rand_pt(rng), test_seg2_rand_pt(rng) };
+    }
+  }
+}
+
+// Rays like lit's: towards every end point (clamped to it) and slightly
+// off to either side, plus some random and axis aligned ones.
+static u32_t
+test_seg2_gen_rays(rng_t* rng, v2f_t origin, test_seg2_edge_t* edges, u32_t edge_count, v2f_t* dirs, f32_t* max_ts) {
+  static const f32_t offset_angles[] = {0.0f, 0.001f, -0.001f};
+  u32_t ray_count = 0;
+  for_arr(offset_index, offset_angles) {
+    for (u32_t i = 0; i < edge_count && ray_count < TEST_SEG2_MAX_RAYS; ++i) {
+      dirs[ray_count] = v2f_rotate(edges[i].end_pt - origin, offset_angles[offset_index]);
+      max_ts[ray_count] = offset_index == 0 ? 1.f : F32_INFINITY;
+      ++ray_count;
+    }
+  }
+  const v2f_t axis_dirs[] = { {1.f, 0.f}, {-1.f, 0.f}, {0.f, 1.f}, {0.f, -1.f} };
+  for_arr(i, axis_dirs) {
+    if (ray_count >= TEST_SEG2_MAX_RAYS) break;
+    dirs[ray_count] = axis_dirs[i];
+    max_ts[ray_count++] = F32_INFINITY;
+  }
+  while (ray_count < TEST_SEG2_MAX_RAYS && (ray_count % 13) != 0) {
+    dirs[ray_count] = test_seg2_rand_pt(rng) - origin;
+    max_ts[ray_count++] = F32_INFINITY;
+  }
+  return ray_count;
+}
+
+static b32_t
+test_seg2_golden(arena_t* arena) {
+  rng_t rng;
+  rng_init(&rng, 42);
+
+  test_seg2_edge_t* edges = arena_push_arr(test_seg2_edge_t, arena, TEST_SEG2_MAX_SEGS);
+  v2f_t* dirs = arena_push_arr(v2f_t, arena, TEST_SEG2_MAX_RAYS);
+  f32_t* max_ts = arena_push_arr(f32_t, arena, TEST_SEG2_MAX_RAYS);
+  f32_t* packet_ts = arena_push_arr(f32_t, arena, TEST_SEG2_MAX_RAYS);
+  seg2_soa_t segs = {};
+  bvh2_t bvh = {};
+  if (!seg2_soa_init(&segs, TEST_SEG2_MAX_SEGS, arena) || !bvh2_init(&bvh, TEST_SEG2_MAX_SEGS, arena)) {
+    printf("Failed to allocate\n");
+    return false;
+  }
+
+  u64_t checked = 0;
+  for (u32_t round = 0; round < 200; ++round) {
+    // every count from 0 to 40 to catch off-by-ones in the tails, then bigger ones
+    u32_t edge_count = round <= 40 ? round : rng_range_s32(&rng, 41, TEST_SEG2_MAX_SEGS);
+    test_seg2_gen_edges(&rng, edges, edge_count);
+
+    segs.count = edge_count;
+    bvh2_clear(&bvh);
+    for (u32_t i = 0; i < edge_count; ++i) {
+      seg2_soa_set(&segs, i, edges[i].start_pt, edges[i].end_pt);
+      bvh2_set_segment(&bvh, i, edges[i].start_pt, edges[i].end_pt);
+    }
+    bvh2_update(&bvh);
+
+    // from a random spot, and from exactly an end point
+    v2f_t origins[2] = { test_seg2_rand_pt(&rng), edge_count ? edges[0].start_pt : v2f_zero() };
+    for_arr(origin_index, origins) {
+      v2f_t origin = origins[origin_index];
+      u32_t ray_count = test_seg2_gen_rays(&rng, origin, edges, edge_count, dirs, max_ts);
+
+      for (u32_t r = 0; r < ray_count; ++r) packet_ts[r] = max_ts[r];
+      bonk_rays2_segs2(origin, dirs, packet_ts, ray_count, &segs);
+
+      for (u32_t r = 0; r < ray_count; ++r) {
+        f32_t expected = test_seg2_scalar(origin, dirs[r], edges, edge_count, max_ts[r]);
+        f32_t soa = bonk_ray2_segs2(origin, dirs[r], &segs, 0, edge_count, max_ts[r]);
+        f32_t bvh_t = bvh2_raycast(&bvh, origin, dirs[r], max_ts[r]);
+        if (!test_seg2_is_same(expected, soa) ||
+            !test_seg2_is_same(expected, packet_ts[r]) ||
+            !test_seg2_is_same(expected, bvh_t))
+        {
+          printf("mismatch: round=%u edges=%u ray=%u scalar=%.9g soa=%.9g packet=%.9g bvh=%.9g\n",
+              round, edge_count, r, expected, soa, packet_ts[r], bvh_t);
+          return false;
+        }
+        ++checked;
+      }
+    }
+  }
+  printf("golden: OK (%llu rays)\n", (unsigned long long)checked);
+  return true;
+}
+
+//
+// Benchmark
+//
+enum test_seg2_path_t {
+  TEST_SEG2_PATH_SCALAR,
+  TEST_SEG2_PATH_SOA,
+  TEST_SEG2_PATH_PACKET,
+  TEST_SEG2_PATH_BVH,
+  TEST_SEG2_PATH_COUNT,
+};
+
+static volatile f32_t test_seg2_sink;
+
+static f64_t
+test_seg2_bench(test_seg2_path_t path, v2f_t* lights, test_seg2_edge_t* edges, u32_t edge_count,
+                seg2_soa_t* segs, bvh2_t* bvh, v2f_t* dirs, f32_t* ts, f32_t* max_ts)
+{
+  const u32_t frame_count = 200;
+  u64_t best = (u64_t)-1;
+  for (u32_t frame = 0; frame < frame_count; ++frame) {
+    u64_t start = clock_time();
+    for (u32_t light_index = 0; light_index < TEST_SEG2_LIGHT_COUNT; ++light_index) {
+      v2f_t origin = lights[light_index];
+
+      // @note: ray setup is the same as in lit, and part of the timing
+      static const f32_t offset_angles[] = {0.0f, 0.001f, -0.001f};
+      u32_t ray_count = 0;
+      for_arr(offset_index, offset_angles) {
+        for (u32_t i = 0; i < edge_count; ++i) {
+          dirs[ray_count] = v2f_rotate(edges[i].end_pt - origin, offset_angles[offset_index]);
+          ts[ray_count] = max_ts[ray_count] = offset_index == 0 ? 1.f : F32_INFINITY;
+          ++ray_count;
+        }
+      }
+
+      switch(path) {
+        case TEST_SEG2_PATH_SCALAR: {
+          for (u32_t r = 0; r < ray_count; ++r)
+            ts[r] = test_seg2_scalar(origin, dirs[r], edges, edge_count, max_ts[r]);
+        } break;
+        case TEST_SEG2_PATH_SOA: {
+          for (u32_t r = 0; r < ray_count; ++r)
+            ts[r] = bonk_ray2_segs2(origin, dirs[r], segs, 0, edge_count, max_ts[r]);
+        } break;
+        case TEST_SEG2_PATH_PACKET: {
+          bonk_rays2_segs2(origin, dirs, ts, ray_count, segs);
+        } break;
+        case TEST_SEG2_PATH_BVH: {
+          for (u32_t r = 0; r < ray_count; ++r)
+            ts[r] = bvh2_raycast(bvh, origin, dirs[r], max_ts[r]);
+        } break;
+        default: {}
+      }
+      test_seg2_sink = ts[ray_count / 2];
+    }
+    u64_t end = clock_time();
+    best = min_of(best, end - start);
+  }
+  return (f64_t)best * 1000000.0 / clock_resolution();
+}
+
+int main() {
+  arena_t arena = {};
+  if (!arena_alloc(&arena, gigabytes(1))) {
+    printf("Failed to allocate arena\n");
+    return 1;
+  }
+  defer { arena_free(&arena); };
+
+  if (!test_seg2_golden(&arena)) {
+    return 1;
+  }
+  arena_clear(&arena);
+
+  printf("SSE2: %d, AVX2: %d\n\n", MOMO_SSE2, MOMO_AVX2);
+
+  rng_t rng;
+  rng_init(&rng, 7);
+
+  v2f_t lights[TEST_SEG2_LIGHT_COUNT];
+  for_arr(i, lights) lights[i] = test_seg2_rand_pt(&rng);
+
+  test_seg2_edge_t* edges = arena_push_arr(test_seg2_edge_t, &arena, TEST_SEG2_MAX_SEGS);
+  v2f_t* dirs = arena_push_arr(v2f_t, &arena, TEST_SEG2_MAX_SEGS * 3);
+  f32_t* ts = arena_push_arr(f32_t, &arena, TEST_SEG2_MAX_SEGS * 3);
+  f32_t* max_ts = arena_push_arr(f32_t, &arena, TEST_SEG2_MAX_SEGS * 3);
+  seg2_soa_t segs = {};
+  bvh2_t bvh = {};
+  if (!seg2_soa_init(&segs, TEST_SEG2_MAX_SEGS, &arena) || !bvh2_init(&bvh, TEST_SEG2_MAX_SEGS, &arena)) {
+    printf("Failed to allocate\n");
+    return 1;
+  }
+
+  printf("light generation, %u lights (us per frame)\n", TEST_SEG2_LIGHT_COUNT);
+  printf("%8s %10s %10s %10s %10s %10s %10s %10s\n", "edges", "scalar", "soa", "packet", "bvh", "soa x", "packet x", "bvh x");
+  u32_t edge_counts[] = { 16, 32, 64, 128, 256 };
+  for_arr(count_index, edge_counts) {
+    u32_t edge_count = edge_counts[count_index];
+    test_seg2_gen_edges(&rng, edges, edge_count);
+    segs.count = edge_count;
+    bvh2_clear(&bvh);
+    for (u32_t i = 0; i < edge_count; ++i) {
+      seg2_soa_set(&segs, i, edges[i].start_pt, edges[i].end_pt);
+      bvh2_set_segment(&bvh, i, edges[i].start_pt, edges[i].end_pt);
+    }
+    bvh2_update(&bvh);
+
+    f64_t times[TEST_SEG2_PATH_COUNT];
+    for (u32_t path = 0; path < TEST_SEG2_PATH_COUNT; ++path) {
+      times[path] = test_seg2_bench((test_seg2_path_t)path, lights, edges, edge_count, &segs, &bvh, dirs, ts, max_ts);
+    }
+    printf("%8u %10.1f %10.1f %10.1f %10.1f %9.1fx %9.1fx %9.1fx\n",
+        edge_count,
+        times[TEST_SEG2_PATH_SCALAR],
+        times[TEST_SEG2_PATH_SOA],
+        times[TEST_SEG2_PATH_PACKET],
+        times[TEST_SEG2_PATH_BVH],
+        times[TEST_SEG2_PATH_SCALAR] / times[TEST_SEG2_PATH_SOA],
+        times[TEST_SEG2_PATH_SCALAR] / times[TEST_SEG2_PATH_PACKET],
+        times[TEST_SEG2_PATH_SCALAR] / times[TEST_SEG2_PATH_BVH]);
+  }
+
+  return 0;
+}
@@ -0,0 +1,288 @@
+//
+// Tests and benchmark for sort_quick() and sort_merge().
+//
+// Each input pattern is sorted and checked against std::sort, and the
+// number of comparisons is checked to stay O(n log n) so that sorted,
+// reversed and duplicate heavy inputs cannot go quadratic. Then ints,
+// sort entries and a bigger struct are timed against std::sort and
+// the old recursive sort_quick().
+//
+// Build optimized, e.g.
+//   clang++ -std=c++17 -O2 test_sort_quick.cpp -lpthread
+//
+
+#include <stdio.h>
+#include <algorithm>
+
+#include "momo.h"
+
+#define TEST_SORT_QUICK_THREADS     4
+#define TEST_SORT_QUICK_BENCH_COUNT 1000000
+
+#define test_sort_quick_check(cond) \
+  if (!(cond)) { printf("FAILED (line %d): %s\n", __LINE__, #cond); return false; }
+
+struct test_sort_quick_item_t {
+  u32_t key;
+  u32_t id;
+  f32_t payload[6];
+};
+
+enum test_sort_quick_pattern_t {
+  TEST_SORT_QUICK_PATTERN_RANDOM,
+  TEST_SORT_QUICK_PATTERN_SORTED,
+  TEST_SORT_QUICK_PATTERN_REVERSED,
+  TEST_SORT_QUICK_PATTERN_EQUAL,
+  TEST_SORT_QUICK_PATTERN_FEW_UNIQUE,
+  TEST_SORT_QUICK_PATTERN_ORGAN_PIPE,
+  TEST_SORT_QUICK_PATTERN_SAWTOOTH,
+  TEST_SORT_QUICK_PATTERN_SORTED_TAIL,
+  TEST_SORT_QUICK_PATTERN_COUNT,
+};
+
+static const char* test_sort_quick_pattern_names[] = {
+  "random", "sorted", "reversed", "equal", "few unique", "organ pipe", "sawtooth", "sorted + random tail",
+};
+
+static void
+test_sort_quick_fill(u32_t* keys, u32_t count, u32_t pattern, u32_t seed) {
+  rng_t rng;
+  rng_init(&rng, seed);
+  for (u32_t i = 0; i < count; ++i) {
+    switch(pattern) {
+      case TEST_SORT_QUICK_PATTERN_RANDOM:      keys[i] = rng_next(&rng); break;
+      case TEST_SORT_QUICK_PATTERN_SORTED:      keys[i] = i; break;
+      case TEST_SORT_QUICK_PATTERN_REVERSED:    keys[i] = count - i; break;
+      case TEST_SORT_QUICK_PATTERN_EQUAL:       keys[i] = 7; break;
+      case TEST_SORT_QUICK_PATTERN_FEW_UNIQUE:  keys[i] = rng_next(&rng) % 4; break;
+      case TEST_SORT_QUICK_PATTERN_ORGAN_PIPE:  keys[i] = i < count / 2 ? i : count - i; break;
+      case TEST_SORT_QUICK_PATTERN_SAWTOOTH:    keys[i] = i % 1000; break;
+      case TEST_SORT_QUICK_PATTERN_SORTED_TAIL: keys[i] = i < count - count / 100 ? i : rng_next(&rng); break;
+    }
+  }
+}
+
+static u64_t test_sort_quick_compares = 0;
+
+static b32_t
+test_sort_quick_pattern(arena_t* arena, job_system_t* js, u32_t count, u32_t pattern) {
+  arena_set_revert_point(arena);
+  u32_t* keys = arena_push_arr(u32_t, arena, count + 1);
+  auto* items = arena_push_arr(test_sort_quick_item_t, arena, count + 1);
+  auto* expected = arena_push_arr(test_sort_quick_item_t, arena, count + 1);
+  test_sort_quick_check(keys && items && expected);
+
+  test_sort_quick_fill(keys, count, pattern, count + pattern);
+  for (u32_t i = 0; i < count; ++i) {
+    items[i] = {};
+    items[i].key = keys[i];
+    items[i].id = i;
+  }
+  memory_copy(expected, items, sizeof(*items) * count);
+
+  auto by_key = [](const test_sort_quick_item_t& lhs, const test_sort_quick_item_t& rhs) {
+    ++test_sort_quick_compares;
+    return lhs.key < rhs.key;
+  };
+  auto by_key_and_id = [](const test_sort_quick_item_t& lhs, const test_sort_quick_item_t& rhs) {
+    return lhs.key < rhs.key || (lhs.key == rhs.key && lhs.id < rhs.id);
+  };
+  std::sort(expected, expected + count, by_key_and_id);
+
+  // sort_quick
+  test_sort_quick_compares = 0;
+  sort_quick(items, count, by_key);
+  u32_t log2_count = count > 1 ? 32 - u32_clz(count) : 1;
+  test_sort_quick_check(test_sort_quick_compares <= (u64_t)count * log2_count * 3 + 64);
+  for (u32_t i = 0; i < count; ++i)
+    test_sort_quick_check(items[i].key == expected[i].key);
+
+  // nothing was lost or duplicated
+  std::sort(items, items + count, by_key_and_id);
+  for (u32_t i = 0; i < count; ++i)
+    test_sort_quick_check(items[i].id == expected[i].id);
+
+  // sort_merge, with and without threads
+  for (u32_t use_js = 0; use_js < 2; ++use_js) {
+    for (u32_t i = 0; i < count; ++i) {
+      items[i].key = keys[i];
+      items[i].id = i;
+    }
+    test_sort_quick_check(sort_merge(items, count, by_key, arena, use_js ? js : nullptr));
+    for (u32_t i = 0; i < count; ++i)
+      test_sort_quick_check(items[i].key == expected[i].key);
+    std::sort(items, items + count, by_key_and_id);
+    for (u32_t i = 0; i < count; ++i)
+      test_sort_quick_check(items[i].id == expected[i].id);
+  }
+
+  // plain keys and the old function pointer interface
+  sort_quick(keys, count, [](u32_t lhs, u32_t rhs) { return lhs < rhs; });
+  for (u32_t i = 0; i < count; ++i)
+    test_sort_quick_check(keys[i] == expected[i].key);
+
+  return true;
+}
+
+static
+sort_quick_generic_predicate_sig(test_sort_quick_generic_pred) {
+  return dref((const u8_t*)lhs) > dref((const u8_t*)rhs);
+}
+
+static b32_t
+test_sort_quick_generic() {
+  u8_t str[] = "the quick brown fox jumps over the lazy dog";
+  u32_t count = sizeof(str) - 1;
+  sort_quick_generic(str, count, test_sort_quick_generic_pred);
+  for (u32_t i = 1; i < count; ++i)
+    test_sort_quick_check(str[i-1] >= str[i]);
+  printf("sort_quick_generic: OK\n");
+  return true;
+}
+
+static b32_t
+test_sort_quick_heap() {
+  u32_t keys[1000];
+  test_sort_quick_fill(keys, array_count(keys), TEST_SORT_QUICK_PATTERN_RANDOM, 99);
+  auto less = [](u32_t lhs, u32_t rhs) { return lhs < rhs; };
+  _sort_heap(keys, keys + array_count(keys), less);
+  for (u32_t i = 1; i < array_count(keys); ++i)
+    test_sort_quick_check(keys[i-1] <= keys[i]);
+  printf("heap sort fallback: OK\n");
+  return true;
+}
+
+static b32_t
+test_sort_quick_merge_out_of_memory(job_system_t* js) {
+  static u32_t keys[1 << 17];
+  test_sort_quick_fill(keys, array_count(keys), TEST_SORT_QUICK_PATTERN_RANDOM, 5);
+
+  u8_t memory[256];
+  arena_t small = {};
+  arena_init(&small, buf_set(memory, sizeof(memory)));
+  test_sort_quick_check(!sort_merge(keys, array_count(keys), [](u32_t lhs, u32_t rhs) { return lhs < rhs; }, &small, js));
+  printf("sort_merge out of memory: OK\n");
+  return true;
+}
+
+//
+// Benchmarks
+//
+
+// The sort_quick() that this replaced: last element as the pivot and
+// recursion on both sides. Only timed on random input, since sorted
+// input is quadratic.
+static u32_t
+test_sort_quick_old_partition(sort_entry_t* a, u32_t start, u32_t ope) {
+  u32_t pivot_idx = ope-1;
+  u32_t eventual_pivot_idx = start;
+  for (u32_t i = start; i < ope-1; ++i) {
+    if (a[i].key < a[pivot_idx].key) {
+      swap(a[i], a[eventual_pivot_idx]);
+      ++eventual_pivot_idx;
+    }
+  }
+  swap(a[eventual_pivot_idx], a[pivot_idx]);
+  return eventual_pivot_idx;
+}
+
+static void
+test_sort_quick_old(sort_entry_t* a, u32_t start, u32_t ope) {
+  if (ope - start <= 1) return;
+  u32_t pivot = test_sort_quick_old_partition(a, start, ope);
+  test_sort_quick_old(a, start, pivot);
+  test_sort_quick_old(a, pivot+1, ope);
+}
+
+static f64_t
+test_sort_quick_ms(u64_t start, u64_t end) {
+  return (f64_t)(end - start) * 1000.0 / clock_resolution();
+}
+
+#define test_sort_quick_time(ms, reset, run) { \
+  reset; \
+  u64_t start = clock_time(); \
+  run; \
+  ms = test_sort_quick_ms(start, clock_time()); \
+}
+
+static void
+test_sort_quick_bench(arena_t* arena, job_system_t* js, u32_t count, u32_t pattern) {
+  arena_set_revert_point(arena);
+  u32_t* input = arena_push_arr(u32_t, arena, count);
+  u32_t* keys = arena_push_arr(u32_t, arena, count);
+  sort_entry_t* entries = arena_push_arr(sort_entry_t, arena, count);
+  auto* items = arena_push_arr(test_sort_quick_item_t, arena, count);
+  assert(input && keys && entries && items);
+  test_sort_quick_fill(input, count, pattern, 1);
+
+  auto u32_less = [](u32_t lhs, u32_t rhs) { return lhs < rhs; };
+  auto entry_less = [](const sort_entry_t& lhs, const sort_entry_t& rhs) { return lhs.key < rhs.key; };
+  auto item_less = [](const test_sort_quick_item_t& lhs, const test_sort_quick_item_t& rhs) { return lhs.key < rhs.key; };
+  auto reset_keys = [&]() { memory_copy(keys, input, sizeof(u32_t) * count); };
+  auto reset_entries = [&]() { for (u32_t i = 0; i < count; ++i) entries[i] = { (f32_t)input[i], i }; };
+  auto reset_items = [&]() { for (u32_t i = 0; i < count; ++i) { items[i] = {}; items[i].key = input[i]; items[i].id = i; } };
+
+  f64_t quick_ms, merge_ms, std_ms, old_ms;
+  printf("%-22s", test_sort_quick_pattern_names[pattern]);
+
+  test_sort_quick_time(quick_ms, reset_keys(), sort_quick(keys, count, u32_less));
+  test_sort_quick_time(merge_ms, reset_keys(), sort_merge(keys, count, u32_less, arena, js));
+  test_sort_quick_time(std_ms, reset_keys(), std::sort(keys, keys + count, u32_less));
+  printf("| %8.2f %8.2f %8.2f ", quick_ms, merge_ms, std_ms);
+
+  test_sort_quick_time(quick_ms, reset_entries(), sort_quick(entries, count));
+  test_sort_quick_time(merge_ms, reset_entries(), sort_merge(entries, count, entry_less, arena, js));
+  test_sort_quick_time(std_ms, reset_entries(), std::sort(entries, entries + count, entry_less));
+  if (pattern == TEST_SORT_QUICK_PATTERN_RANDOM) {
+    test_sort_quick_time(old_ms, reset_entries(), test_sort_quick_old(entries, 0, count));
+    printf("| %8.2f %8.2f %8.2f %8.2f ", quick_ms, merge_ms, std_ms, old_ms);
+  }
+  else {
+    printf("| %8.2f %8.2f %8.2f %8s ", quick_ms, merge_ms, std_ms, "-");
+  }
+
+  test_sort_quick_time(quick_ms, reset_items(), sort_quick(items, count, item_less));
+  test_sort_quick_time(merge_ms, reset_items(), sort_merge(items, count, item_less, arena, js));
+  test_sort_quick_time(std_ms, reset_items(), std::sort(items, items + count, item_less));
+  printf("| %8.2f %8.2f %8.2f\n", quick_ms, merge_ms, std_ms);
+}
+
+int main() {
+  arena_t arena = {};
+  if (!arena_alloc(&arena, megabytes(512))) {
+    printf("Failed to allocate arena\n");
+    return 1;
+  }
+  defer { arena_free(&arena); };
+
+  job_system_t js = {};
+  if (!job_system_init(&js, TEST_SORT_QUICK_THREADS, 1024, &arena)) {
+    printf("Failed to init job system\n");
+    return 1;
+  }
+  defer { job_system_free(&js); };
+
+  static const u32_t counts[] = { 0, 1, 2, 23, 24, 25, 128, 129, 1000, 50000, 200001 };
+  for (u32_t pattern = 0; pattern < TEST_SORT_QUICK_PATTERN_COUNT; ++pattern) {
+    for_arr(count_index, counts) {
+      if (!test_sort_quick_pattern(&arena, &js, counts[count_index], pattern)) {
+        printf("  ...with %u elements, %s\n", counts[count_index], test_sort_quick_pattern_names[pattern]);
+        return 1;
+      }
+    }
+    printf("%s: OK\n", test_sort_quick_pattern_names[pattern]);
+  }
+  if (!test_sort_quick_generic()) return 1;
+  if (!test_sort_quick_heap()) return 1;
+  if (!test_sort_quick_merge_out_of_memory(&js)) return 1;
+
+  printf("\nms to sort %u elements, merge uses %u workers\n", TEST_SORT_QUICK_BENCH_COUNT, js.worker_count);
+  printf("%-22s| %-26s| %-35s| %s\n", "", "u32", "sort_entry_t", "32 byte struct");
+  printf("%-22s| %8s %8s %8s | %8s %8s %8s %8s | %8s %8s %8s\n", "",
+      "quick", "merge", "std", "quick", "merge", "std", "old", "quick", "merge", "std");
+  for (u32_t pattern = 0; pattern < TEST_SORT_QUICK_PATTERN_COUNT; ++pattern) {
+    test_sort_quick_bench(&arena, &js, TEST_SORT_QUICK_BENCH_COUNT, pattern);
+  }
+  return 0;
+}
@@ -0,0 +1,282 @@
+//
+// Tests and benchmark for the radix sorts.
+//
+// Every key type is checked against std::stable_sort for a range of
+// sizes, with and without values and with and without the job system.
+// Inputs whose keys share digits make sure that skipping passes does
+// not change the result. Then sort entries and u32/u64 keys are timed
+// against the old 8-bit sort_radix(), sort_quick() and std::sort.
+//
+// Build optimized, e.g.
+//   clang++ -std=c++17 -O2 test_sort_radix.cpp -lpthread
+//
+// Pass the largest benchmark size as the first argument to go past
+// 10M entries (100M needs about 6GB of memory).
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+
+#include "momo.h"
+
+#define TEST_SORT_RADIX_THREADS    4
+#define TEST_SORT_RADIX_BENCH_MAX  10000000
+
+#define test_sort_radix_check(cond) \
+  if (!(cond)) { printf("FAILED (line %d): %s\n", __LINE__, #cond); return false; }
+
+//
+// The sort_radix() that this replaced: 4 passes of 8 bits,
+// single threaded, converting the key on every pass.
+//
+static void
+test_sort_radix_old(sort_entry_t* entries, u32_t entry_count, arena_t* arena)
+{
+  arena_set_revert_point(arena);
+  sort_entry_t* tmp = arena_push_arr(sort_entry_t, arena, entry_count);
+  assert(tmp);
+
+  sort_entry_t* src = entries;
+  sort_entry_t* dest = tmp;
+
+  for(u32_t byte_index = 0; byte_index < 32; byte_index += 8)
+  {
+    u32_t offsets[256] = {};
+    for(u32_t i = 0; i < entry_count; ++i)
+    {
+      u32_t piece = (_sort_key_to_u32(src[i].key) >> byte_index) & 0xFF;
+      ++offsets[piece];
+    }
+
+    u32_t total = 0;
+    for_arr(offset_index, offsets)
+    {
+      u32_t count = offsets[offset_index];
+      offsets[offset_index] = total;
+      total += count;
+    }
+
+    for(u32_t i = 0; i < entry_count; ++i)
+    {
+      u32_t piece = (_sort_key_to_u32(src[i].key) >> byte_index) & 0xFF;
+      dest[offsets[piece]++] = src[i];
+    }
+    swap(src, dest);
+  }
+}
+
+//
+// Key generation. 'spread' is how many bits of randomness
+// the keys have, so that small spreads skip passes.
+//
+static void test_sort_radix_make_key(rng_t* rng, u32_t spread, u32_t* out) { *out = rng_next(rng) >> (32 - spread); }
+static void test_sort_radix_make_key(rng_t* rng, u32_t spread, s32_t* out) { *out = (s32_t)(rng_next(rng) >> (32 - spread)) - (s32_t)(((u64_t)1 << spread) >> 1); }
+static void test_sort_radix_make_key(rng_t* rng, u32_t spread, f32_t* out) { *out = (rng_bilateral(rng) * 1000.f) / (f32_t)(1 << (32 - spread)); }
+static void test_sort_radix_make_key(rng_t* rng, u32_t spread, u64_t* out) {
+  u64_t bits = ((u64_t)rng_next(rng) << 32) | rng_next(rng);
+  *out = spread >= 32 ? bits : bits >> (64 - spread);
+}
+static void test_sort_radix_make_key(rng_t* rng, u32_t spread, s64_t* out) {
+  u64_t key; test_sort_radix_make_key(rng, spread, &key);
+  *out = (s64_t)key - (s64_t)(spread >= 32 ? 0 : (1ull << spread) >> 1);
+}
+static void test_sort_radix_make_key(rng_t* rng, u32_t spread, f64_t* out) { *out = (rng_bilateral(rng) * 1e12) / (f64_t)(1ull << (32 - spread)); }
+
+static b32_t test_sort_radix_call(u32_t* k, u32_t* v, u32_t n, arena_t* a, job_system_t* js) { return sort_radix_u32(k, v, n, a, js); }
+static b32_t test_sort_radix_call(s32_t* k, u32_t* v, u32_t n, arena_t* a, job_system_t* js) { return sort_radix_s32(k, v, n, a, js); }
+static b32_t test_sort_radix_call(f32_t* k, u32_t* v, u32_t n, arena_t* a, job_system_t* js) { return sort_radix_f32(k, v, n, a, js); }
+static b32_t test_sort_radix_call(u64_t* k, u32_t* v, u32_t n, arena_t* a, job_system_t* js) { return sort_radix_u64(k, v, n, a, js); }
+static b32_t test_sort_radix_call(s64_t* k, u32_t* v, u32_t n, arena_t* a, job_system_t* js) { return sort_radix_s64(k, v, n, a, js); }
+static b32_t test_sort_radix_call(f64_t* k, u32_t* v, u32_t n, arena_t* a, job_system_t* js) { return sort_radix_f64(k, v, n, a, js); }
+
+template<typename K> static b32_t
+test_sort_radix_keys(arena_t* arena, job_system_t* js, u32_t count, u32_t spread, b32_t with_values) {
+  arena_set_revert_point(arena);
+  rng_t rng;
+  rng_init(&rng, count * 31 + spread);
+
+  K* keys = arena_push_arr(K, arena, count + 1);
+  K* expected = arena_push_arr(K, arena, count + 1);
+  u32_t* values = arena_push_arr(u32_t, arena, count + 1);
+  u32_t* order = arena_push_arr(u32_t, arena, count + 1);
+  test_sort_radix_check(keys && expected && values && order);
+
+  for (u32_t i = 0; i < count; ++i) {
+    test_sort_radix_make_key(&rng, spread, keys + i);
+    values[i] = i;
+    order[i] = i;
+  }
+  // sprinkle in some signed zeroes
+  if (count > 4) {
+    keys[1] = (K)0;
+    keys[3] = (K)-0.0;
+  }
+
+  std::stable_sort(order, order + count, [&](u32_t lhs, u32_t rhs) { return keys[lhs] < keys[rhs]; });
+  for (u32_t i = 0; i < count; ++i) expected[i] = keys[order[i]];
+
+  usz_t used_before = arena->pos;
+  test_sort_radix_check(test_sort_radix_call(keys, with_values ? values : nullptr, count, arena, js));
+  test_sort_radix_check(arena->pos == used_before);
+
+  for (u32_t i = 0; i < count; ++i) {
+    test_sort_radix_check(keys[i] == expected[i]);
+    if (i > 0) test_sort_radix_check(!(keys[i] < keys[i-1]));
+    // -0 and 0 compare equal, so their order is only checked through the values
+    if (with_values && keys[i] != (K)0) test_sort_radix_check(values[i] == order[i]);
+  }
+  return true;
+}
+
+template<typename K> static b32_t
+test_sort_radix_type(const char* name, arena_t* arena, job_system_t* js, u32_t key_bits) {
+  static const u32_t counts[] = { 0, 1, 2, 3, 63, 64, 65, 1000, 4097, 200000, 300001 };
+  u32_t spreads[] = { 1, 11, 12, 22, 24, key_bits };
+  for_arr(count_index, counts) {
+    for_arr(spread_index, spreads) {
+      u32_t spread = min_of(spreads[spread_index], 32);
+      for (u32_t with_values = 0; with_values < 2; ++with_values) {
+        if (!test_sort_radix_keys<K>(arena, nullptr, counts[count_index], spread, with_values)) return false;
+        if (!test_sort_radix_keys<K>(arena, js, counts[count_index], spread, with_values)) return false;
+      }
+    }
+  }
+  printf("%s: OK\n", name);
+  return true;
+}
+
+static b32_t
+test_sort_radix_entries(arena_t* arena, job_system_t* js) {
+  arena_set_revert_point(arena);
+  u32_t count = 250000;
+  rng_t rng;
+  rng_init(&rng, 1234);
+
+  sort_entry_t* entries = arena_push_arr(sort_entry_t, arena, count);
+  sort_entry_t* old_entries = arena_push_arr(sort_entry_t, arena, count);
+  test_sort_radix_check(entries && old_entries);
+  for (u32_t i = 0; i < count; ++i) {
+    // few distinct keys so that there are lots of ties
+    entries[i].key = (f32_t)rng_range_s32(&rng, -500, 500) * 0.25f;
+    entries[i].index = i;
+  }
+  memory_copy(old_entries, entries, sizeof(sort_entry_t) * count);
+  sort_radix(entries, count, arena, js);
+  test_sort_radix_old(old_entries, count, arena);
+
+  // both are stable, so they have to agree exactly
+  test_sort_radix_check(memory_is_same(entries, old_entries, sizeof(sort_entry_t) * count));
+  for (u32_t i = 1; i < count; ++i)
+    test_sort_radix_check(entries[i-1].key < entries[i].key ||
+        (entries[i-1].key == entries[i].key && entries[i-1].index < entries[i].index));
+
+  printf("sort entries: OK\n");
+  return true;
+}
+
+//
+// Benchmarks
+//
+static f64_t
+test_sort_radix_ms(u64_t start, u64_t end) {
+  return (f64_t)(end - start) * 1000.0 / clock_resolution();
+}
+
+#define test_sort_radix_time(ms, reps, reset, run) { \
+  ms = 0.0; \
+  for (u32_t rep = 0; rep < reps; ++rep) { \
+    reset; \
+    u64_t start = clock_time(); \
+    run; \
+    ms += test_sort_radix_ms(start, clock_time()); \
+  } \
+  ms /= reps; \
+}
+
+static void
+test_sort_radix_bench(arena_t* arena, job_system_t* js, u32_t count) {
+  arena_set_revert_point(arena);
+  rng_t rng;
+  rng_init(&rng, count);
+  u32_t reps = max_of(1, 1000000 / count);
+
+  sort_entry_t* input = arena_push_arr(sort_entry_t, arena, count);
+  sort_entry_t* entries = arena_push_arr(sort_entry_t, arena, count);
+  assert(input && entries);
+  for (u32_t i = 0; i < count; ++i) {
+    input[i].key = rng_bilateral(&rng) * 10000.f;
+    input[i].index = i;
+  }
+
+  f64_t old_ms, radix_ms, radix_mt_ms, quick_ms, std_ms;
+  usz_t entries_size = sizeof(sort_entry_t) * count;
+  test_sort_radix_time(old_ms, reps, memory_copy(entries, input, entries_size), test_sort_radix_old(entries, count, arena));
+  test_sort_radix_time(radix_ms, reps, memory_copy(entries, input, entries_size), sort_radix(entries, count, arena));
+  test_sort_radix_time(radix_mt_ms, reps, memory_copy(entries, input, entries_size), sort_radix(entries, count, arena, js));
+  test_sort_radix_time(quick_ms, reps, memory_copy(entries, input, entries_size), sort_quick(entries, count));
+  test_sort_radix_time(std_ms, reps, memory_copy(entries, input, entries_size),
+      std::sort(entries, entries + count, [](const sort_entry_t& l, const sort_entry_t& r) { return l.key < r.key; }));
+  printf("%10u entries | old radix %9.2f | radix %9.2f | radix mt %9.2f | sort_quick %9.2f | std::sort %9.2f\n",
+      count, old_ms, radix_ms, radix_mt_ms, quick_ms, std_ms);
+
+  // u32 and u64 keys with a separate array of values
+  u32_t* values = arena_push_arr(u32_t, arena, count);
+  u64_t* input_keys = arena_push_arr(u64_t, arena, count);
+  u64_t* keys = arena_push_arr(u64_t, arena, count);
+  assert(values && input_keys && keys);
+  for (u32_t i = 0; i < count; ++i)
+    input_keys[i] = ((u64_t)rng_next(&rng) << 32) | rng_next(&rng);
+
+  u32_t* keys32 = (u32_t*)keys;
+  u32_t* input32 = (u32_t*)input_keys;
+  auto reset32 = [&]() { memory_copy(keys32, input32, sizeof(u32_t) * count); for (u32_t i = 0; i < count; ++i) values[i] = i; };
+  auto reset64 = [&]() { memory_copy(keys, input_keys, sizeof(u64_t) * count); for (u32_t i = 0; i < count; ++i) values[i] = i; };
+
+  b32_t sorted = true;
+  test_sort_radix_time(radix_ms, reps, reset32(), sorted &= sort_radix_u32(keys32, values, count, arena));
+  test_sort_radix_time(radix_mt_ms, reps, reset32(), sorted &= sort_radix_u32(keys32, values, count, arena, js));
+  test_sort_radix_time(std_ms, reps, reset32(), std::sort(keys32, keys32 + count));
+  printf("%10u u32 keys | radix %9.2f | radix mt %9.2f | std::sort (keys only) %9.2f\n",
+      count, radix_ms, radix_mt_ms, std_ms);
+
+  test_sort_radix_time(radix_ms, reps, reset64(), sorted &= sort_radix_u64(keys, values, count, arena));
+  test_sort_radix_time(radix_mt_ms, reps, reset64(), sorted &= sort_radix_u64(keys, values, count, arena, js));
+  test_sort_radix_time(std_ms, reps, reset64(), std::sort(keys, keys + count));
+  if (!sorted) printf("FAILED: radix sort ran out of scratch memory\n");
+  printf("%10u u64 keys | radix %9.2f | radix mt %9.2f | std::sort (keys only) %9.2f\n",
+      count, radix_ms, radix_mt_ms, std_ms);
+}
+
+int main(int argc, char** argv) {
+  u32_t bench_max = argc > 1 ? (u32_t)atoi(argv[1]) : TEST_SORT_RADIX_BENCH_MAX;
+
+  arena_t arena = {};
+  usz_t arena_size = max_of((usz_t)megabytes(256), (usz_t)bench_max * 64);
+  if (!arena_alloc(&arena, arena_size)) {
+    printf("Failed to allocate arena\n");
+    return 1;
+  }
+  defer { arena_free(&arena); };
+
+  job_system_t js = {};
+  if (!job_system_init(&js, TEST_SORT_RADIX_THREADS, 1024, &arena)) {
+    printf("Failed to init job system\n");
+    return 1;
+  }
+  defer { job_system_free(&js); };
+
+  if (!test_sort_radix_type<u32_t>("u32", &arena, &js, 32)) return 1;
+  if (!test_sort_radix_type<s32_t>("s32", &arena, &js, 32)) return 1;
+  if (!test_sort_radix_type<f32_t>("f32", &arena, &js, 32)) return 1;
+  if (!test_sort_radix_type<u64_t>("u64", &arena, &js, 64)) return 1;
+  if (!test_sort_radix_type<s64_t>("s64", &arena, &js, 64)) return 1;
+  if (!test_sort_radix_type<f64_t>("f64", &arena, &js, 64)) return 1;
+  if (!test_sort_radix_entries(&arena, &js)) return 1;
+
+  printf("\nms per sort, mt uses %u workers:\n", js.worker_count);
+  for (u32_t count = 10000; count <= bench_max; count *= 10) {
+    test_sort_radix_bench(&arena, &js, count);
+  }
+  return 0;
+}
@@ -0,0 +1,1432 @@
+//
+// Tests and benchmark for zlib_inflate(), and tests for zlib_deflate().
+//
+// The corpus is:
+// - zlib streams made with Python's zlib module (zlib 1.2.13) from data
+//   that this test can make again. Each is named after the level and
+//   strategy used, and together they have stored, fixed and dynamic blocks,
+//   and codes long enough to need subtables.
+// - Streams written here bit by bit, for what an encoder rarely makes:
+//   the longest codes in both tables, the farthest distances, matches that
+//   overlap themselves at every distance, and malformed data.
+// - png_write() round trips.
+// - Any PNGs given on the command line.
+//
+// Every valid stream must also fail cleanly when cut short anywhere or
+// when 'dest' is a byte too small, and must not crash when bits are flipped.
+//
+// zlib_deflate() must round trip the made data at every level and size
+// around its blocks and chunks, giving the same stream with a job system.
+//
+// The benchmark inflates the IDAT data of the PNGs given, or else the
+// corpus, with zlib_inflate() and with the bit-at-a-time decoder that PNG
+// loading used before.
+//
+// Build optimized, e.g.
+//   clang++ -std=c++17 -O2 test_zlib.cpp
+//   ./a.out atlas.png
+//
+
+#include <stdio.h>
+
+#include "momo.h"
+
+#define test_zlib_check(cond) \
+  if (!(cond)) { printf("FAILED (line %d): %s\n", __LINE__, #cond); return false; }
+
+//
+// The corpus
+//
+static const u8_t test_zlib_text_stored[] = {
+  0x78, 0x01, 0x01, 0x2c, 0x01, 0xd3, 0xfe, 0x65, 0x64, 0x65, 0x6e, 0x20, 0x67, 0x6c, 0x79, 0x70,
+  0x68, 0x20, 0x65, 0x64, 0x65, 0x6e, 0x20, 0x7a, 0x6c, 0x69, 0x62, 0x20, 0x6f, 0x66, 0x20, 0x74,
+  0x68, 0x65, 0x20, 0x70, 0x6e, 0x67, 0x20, 0x61, 0x6e, 0x64, 0x20, 0x6f, 0x66, 0x20, 0x74, 0x68,
+  0x65, 0x20, 0x70, 0x69, 0x78, 0x65, 0x6c, 0x20, 0x7a, 0x6c, 0x69, 0x62, 0x20, 0x70, 0x6e, 0x67,
+  0x20, 0x73, 0x70, 0x72, 0x69, 0x74, 0x65, 0x20, 0x6f, 0x66, 0x20, 0x65, 0x64, 0x65, 0x6e, 0x20,
+  0x74, 0x68, 0x65, 0x20, 0x61, 0x74, 0x6c, 0x61, 0x73, 0x20, 0x65, 0x64, 0x65, 0x6e, 0x20, 0x67,
+  0x6c, 0x79, 0x70, 0x68, 0x20, 0x7a, 0x6c, 0x69, 0x62, 0x20, 0x6f, 0x66, 0x20, 0x61, 0x20, 0x7a,
+  0x6c, 0x69, 0x62, 0x20, 0x61, 0x6e, 0x64, 0x20, 0x67, 0x6c, 0x79, 0x70, 0x68, 0x20, 0x67, 0x6c,
+  0x79, 0x70, 0x68, 0x20, 0x74, 0x68, 0x65, 0x20, 0x61, 0x20, 0x61, 0x6e, 0x64, 0x20, 0x7a, 0x6c,
+  0x69, 0x62, 0x20, 0x74, 0x68, 0x65, 0x20, 0x6f, 0x66, 0x20, 0x74, 0x68, 0x65, 0x20, 0x6d, 0x6f,
+  0x6d, 0x6f, 0x20, 0x61, 0x74, 0x6c, 0x61, 0x73, 0x20, 0x70, 0x6e, 0x67, 0x20, 0x61, 0x6e, 0x64,
+  0x20, 0x73, 0x70, 0x72, 0x69, 0x74, 0x65, 0x20, 0x61, 0x20, 0x6f, 0x66, 0x20, 0x73, 0x70, 0x72,
+  0x69, 0x74, 0x65, 0x20, 0x61, 0x20, 0x70, 0x69, 0x78, 0x65, 0x6c, 0x20, 0x70, 0x69, 0x78, 0x65,
+  0x6c, 0x20, 0x67, 0x6c, 0x79, 0x70, 0x68, 0x20, 0x65, 0x64, 0x65, 0x6e, 0x20, 0x6d, 0x6f, 0x6d,
+  0x6f, 0x20, 0x65, 0x64, 0x65, 0x6e, 0x20, 0x67, 0x6c, 0x79, 0x70, 0x68, 0x20, 0x70, 0x69, 0x78,
+  0x65, 0x6c, 0x20, 0x61, 0x20, 0x61, 0x74, 0x6c, 0x61, 0x73, 0x20, 0x67, 0x6c, 0x79, 0x70, 0x68,
+  0x20, 0x61, 0x74, 0x6c, 0x61, 0x73, 0x20, 0x74, 0x68, 0x65, 0x20, 0x74, 0x68, 0x65, 0x20, 0x6d,
+  0x6f, 0x6d, 0x6f, 0x20, 0x61, 0x20, 0x65, 0x64, 0x65, 0x6e, 0x20, 0x6f, 0x66, 0x20, 0x61, 0x6e,
+  0x64, 0x20, 0x61, 0x74, 0x6c, 0x61, 0x73, 0x20, 0x61, 0x20, 0x61, 0x74, 0x6c, 0x61, 0x73, 0x20,
+  0x61, 0x74, 0x6c, 0x91, 0x2c, 0x6a, 0x5a,
+};
+static const u8_t test_zlib_text_fixed[] = {
+  0x78, 0x01, 0x4b, 0x4d, 0x49, 0xcd, 0x53, 0x48, 0xcf, 0xa9, 0x2c, 0xc8, 0x50, 0x48, 0x05, 0x31,
+  0xab, 0x72, 0x32, 0x93, 0x14, 0xf2, 0xd3, 0x14, 0x4a, 0x32, 0x52, 0x15, 0x0a, 0xf2, 0xd2, 0x15,
+  0x12, 0xf3, 0x52, 0xe0, 0xdc, 0xcc, 0x8a, 0xd4, 0x1c, 0x88, 0x02, 0x90, 0x4c, 0x71, 0x41, 0x51,
+  0x66, 0x49, 0x2a, 0x48, 0x12, 0xac, 0x11, 0xa4, 0x22, 0xb1, 0x24, 0x27, 0xb1, 0x18, 0xc2, 0x85,
+  0x18, 0x09, 0x33, 0x2d, 0x11, 0xc2, 0x02, 0x19, 0x06, 0x91, 0x80, 0x90, 0x60, 0x3d, 0x60, 0x51,
+  0xb0, 0x34, 0x88, 0x0b, 0xb5, 0x2b, 0x37, 0x3f, 0x37, 0x1f, 0x6a, 0x1c, 0xcc, 0x15, 0x50, 0xfb,
+  0x12, 0x41, 0x4a, 0xe0, 0x6c, 0x88, 0x9b, 0x20, 0x24, 0x92, 0x2f, 0xc0, 0xda, 0x91, 0xdc, 0x01,
+  0x51, 0x90, 0x08, 0x35, 0x11, 0x22, 0x06, 0x61, 0x83, 0x2c, 0x43, 0x58, 0x08, 0xd1, 0x03, 0x72,
+  0x30, 0xd0, 0x42, 0x88, 0x02, 0x98, 0x26, 0x84, 0x72, 0xa8, 0xe5, 0x10, 0x53, 0x20, 0xfa, 0x80,
+  0xaa, 0xe1, 0x81, 0x00, 0xc3, 0x60, 0x01, 0x90, 0xe3, 0xc1, 0x8c, 0x44, 0x98, 0xef, 0xe0, 0x1a,
+  0x20, 0x06, 0x82, 0xb9, 0x88, 0xd0, 0x85, 0x90, 0x40, 0x65, 0xe0, 0x00, 0x01, 0x4b, 0xc2, 0x38,
+  0xc8, 0xae, 0x06, 0x19, 0x0b, 0x51, 0x0a, 0x31, 0x1c, 0xea, 0x52, 0x64, 0xeb, 0xc1, 0xc1, 0x06,
+  0xf3, 0x38, 0xba, 0xfb, 0x80, 0x66, 0xc2, 0xe2, 0x0d, 0x62, 0x2c, 0xc8, 0xcb, 0x70, 0x0f, 0x82,
+  0x94, 0x43, 0x34, 0xc2, 0xc2, 0x19, 0x11, 0xfc, 0xc8, 0xbe, 0x86, 0xd8, 0x0a, 0x52, 0x0c, 0xb4,
+  0x0b, 0x1a, 0xd0, 0x30, 0xff, 0xc2, 0x8d, 0x85, 0x59, 0x09, 0x51, 0x0d, 0x49, 0x3d, 0x70, 0x47,
+  0x81, 0x1d, 0x89, 0x1e, 0xb0, 0x89, 0x30, 0x06, 0xc2, 0x58, 0x98, 0x5a, 0xb0, 0xd1, 0x10, 0x2f,
+  0x43, 0xd2, 0x25, 0xd8, 0x21, 0x48, 0x89, 0x09, 0x16, 0x65, 0xa8, 0xce, 0x85, 0x79, 0x0a, 0x44,
+  0x43, 0x12, 0x22, 0xb2, 0x97, 0xe0, 0xd6, 0x22, 0x14, 0x83, 0xec, 0x82, 0xba, 0x1d, 0x9e, 0x32,
+  0x11, 0xe9, 0x1d, 0xa6, 0x01, 0x6b, 0x6a, 0x87, 0x27, 0x74, 0x24, 0x09, 0x68, 0xa4, 0x21, 0xc5,
+  0x30, 0x2c, 0x41, 0x42, 0x5d, 0x03, 0x8e, 0x4f, 0x70, 0x84, 0xc1, 0x93, 0x07, 0x52, 0x9c, 0xc3,
+  0x92, 0x01, 0x12, 0x0f, 0x29, 0x84, 0xc0, 0x7c, 0xb4, 0x54, 0x05, 0x0f, 0x07, 0x90, 0x08, 0xd4,
+  0xe3, 0xf0, 0xf4, 0x88, 0x9c, 0x09, 0x0a, 0x00, 0x26, 0x64, 0x6c, 0x54,
+};
+static const u8_t test_zlib_text_default[] = {
+  0x78, 0x9c, 0x6d, 0x55, 0x5b, 0x72, 0xc3, 0x40, 0x08, 0xbb, 0x8a, 0xaf, 0xb6, 0x9d, 0xb8, 0x89,
+  0x67, 0x1c, 0x27, 0xd3, 0xf8, 0xa3, 0xed, 0xe9, 0x6b, 0x10, 0x08, 0xe1, 0xe6, 0x23, 0x9b, 0x7d,
+  0xf0, 0x10, 0x20, 0xf0, 0x7c, 0x99, 0xb7, 0xe9, 0xba, 0xfe, 0x3c, 0x6f, 0xd3, 0x6c, 0xdb, 0xdf,
+  0x75, 0xf9, 0x98, 0x1e, 0x9f, 0xd3, 0x7e, 0x9b, 0xa7, 0xe7, 0x76, 0x9d, 0xc6, 0x76, 0xe1, 0x71,
+  0xf9, 0x9e, 0x57, 0x08, 0xd8, 0xcb, 0xeb, 0xf9, 0xb5, 0xec, 0xb3, 0x3d, 0xba, 0xa2, 0x49, 0x8c,
+  0x7d, 0x1d, 0x2f, 0x1c, 0x61, 0x32, 0xad, 0x0d, 0xec, 0xcc, 0x18, 0x1e, 0xb0, 0xba, 0x8e, 0xdf,
+  0xfa, 0xb3, 0x1d, 0xc3, 0xd7, 0xfd, 0x71, 0x7f, 0x84, 0xb9, 0x44, 0x11, 0xfe, 0x86, 0x89, 0x70,
+  0x0f, 0x4c, 0x58, 0x25, 0x0a, 0x57, 0x17, 0x1c, 0x10, 0x18, 0x61, 0x11, 0x77, 0xd8, 0x9b, 0xb3,
+  0x72, 0x08, 0x1d, 0x03, 0x7c, 0x38, 0x84, 0x40, 0x2a, 0x95, 0x78, 0x38, 0x87, 0x15, 0xe8, 0x1d,
+  0xd2, 0x4c, 0x42, 0xfe, 0xfc, 0xc2, 0xc0, 0xfb, 0x66, 0x64, 0x74, 0x54, 0x80, 0x41, 0x3f, 0x56,
+  0x76, 0xb1, 0x1e, 0x62, 0x9e, 0x10, 0x7f, 0xcc, 0x83, 0xa2, 0x36, 0xb3, 0x10, 0x85, 0xf1, 0x40,
+  0xaa, 0xee, 0x3d, 0x6d, 0x19, 0xf8, 0x19, 0xdf, 0x61, 0x33, 0xeb, 0x06, 0xb3, 0x16, 0x32, 0x03,
+  0x34, 0x71, 0x28, 0x66, 0x9e, 0x2b, 0xfd, 0x1a, 0x35, 0xbc, 0x9a, 0xf0, 0xe1, 0x2b, 0x12, 0x9d,
+  0xf1, 0xd2, 0x6c, 0xba, 0x84, 0x34, 0xd8, 0x43, 0x50, 0x0e, 0xf2, 0x9c, 0xd8, 0x91, 0x9b, 0x32,
+  0x9b, 0xb2, 0x6e, 0x1a, 0x21, 0x83, 0x97, 0x0e, 0x44, 0xc8, 0x94, 0x25, 0xeb, 0x70, 0x33, 0x28,
+  0xfb, 0x07, 0x11, 0x35, 0x24, 0xba, 0x2d, 0x61, 0xf3, 0x15, 0xd8, 0xc9, 0xcc, 0xe2, 0x7b, 0x2a,
+  0xbc, 0x65, 0x3b, 0x89, 0x2e, 0x0f, 0x51, 0x34, 0xa9, 0x70, 0x12, 0x32, 0xd0, 0x78, 0x3d, 0xbd,
+  0x60, 0xa4, 0x87, 0xd4, 0x3c, 0x69, 0x20, 0x27, 0xc9, 0x90, 0x9f, 0x4f, 0xac, 0x62, 0x1e, 0xec,
+  0x26, 0x02, 0x27, 0x1f, 0xb5, 0x09, 0x7a, 0x99, 0xe3, 0xe8, 0xc6, 0x4c, 0x92, 0xb1, 0x90, 0x96,
+  0xd5, 0x5d, 0x55, 0x98, 0xb7, 0xcd, 0x58, 0xe4, 0xa8, 0xb1, 0xe2, 0xcb, 0xdb, 0x36, 0xee, 0x5c,
+  0x18, 0x1d, 0x56, 0xf9, 0x2c, 0x15, 0x19, 0x40, 0x9d, 0x4d, 0xd9, 0x2d, 0x24, 0x09, 0x83, 0xa9,
+  0x2c, 0x2b, 0x0e, 0x66, 0xa5, 0xc8, 0xc6, 0xab, 0x98, 0x09, 0x31, 0xa5, 0xca, 0x12, 0x7b, 0xd6,
+  0x25, 0x05, 0x91, 0xb4, 0xd0, 0x3f, 0x47, 0x2a, 0x96, 0x59, 0x39, 0x4d, 0x39, 0xcd, 0x1c, 0xc7,
+  0xac, 0x59, 0x93, 0x26, 0xa8, 0x19, 0x1c, 0x06, 0x73, 0xc4, 0x66, 0x82, 0xbc, 0xe4, 0x51, 0x39,
+  0x76, 0x83, 0xe4, 0xb6, 0xa6, 0x4e, 0x92, 0x43, 0x64, 0xd3, 0x61, 0xc7, 0x2c, 0x37, 0x9d, 0xe2,
+  0x1c, 0x9c, 0x92, 0xe4, 0xde, 0x44, 0x38, 0x9d, 0x3a, 0x8c, 0xfa, 0xac, 0x0f, 0xa3, 0x25, 0x9e,
+  0x23, 0x12, 0x9d, 0xea, 0x82, 0xa4, 0x4f, 0x05, 0x19, 0x42, 0xd1, 0x52, 0x02, 0x00, 0x7c, 0xa4,
+  0x7c, 0x2f, 0xa0, 0xb6, 0x66, 0x11, 0x4b, 0x1c, 0x49, 0x21, 0x32, 0xb9, 0x52, 0xb0, 0x20, 0x87,
+  0x44, 0x74, 0xea, 0x41, 0x2d, 0x52, 0xef, 0xa8, 0xc6, 0xa1, 0x62, 0x4b, 0x8c, 0xb4, 0xf8, 0x5c,
+  0xe8, 0x17, 0x71, 0x68, 0x96, 0xb4, 0xbd, 0xa4, 0x1e, 0xc5, 0x7a, 0x81, 0xd4, 0xc9, 0xa3, 0x9f,
+  0x86, 0xec, 0xf4, 0x3f, 0x86, 0x07, 0xda, 0xc1,
+};
+static const u8_t test_zlib_text_rle[] = {
+  0x78, 0x01, 0x05, 0xc1, 0xd1, 0x8d, 0xc5, 0x30, 0x08, 0x45, 0xc1, 0x56, 0x4e, 0x6b, 0x3c, 0xf9,
+  0xc6, 0x58, 0x22, 0x18, 0xad, 0xf9, 0x48, 0x52, 0xfd, 0xce, 0x68, 0x28, 0x99, 0xf1, 0x96, 0xa3,
+  0xa1, 0xe4, 0x8b, 0xf5, 0x63, 0x5f, 0xb4, 0x8b, 0xca, 0x89, 0xe5, 0x60, 0x5f, 0xb4, 0x8b, 0x5a,
+  0x8f, 0x82, 0x2f, 0xd6, 0x8f, 0xca, 0xc9, 0xa9, 0xbf, 0xd5, 0x62, 0x5f, 0x68, 0x28, 0x69, 0x17,
+  0xd6, 0x61, 0x07, 0x0d, 0x25, 0x33, 0xde, 0x72, 0xbe, 0x58, 0x3f, 0xf6, 0x85, 0xf1, 0xc5, 0xfa,
+  0x61, 0x39, 0x98, 0xf1, 0x96, 0x33, 0xe3, 0x2d, 0xa7, 0x5d, 0x18, 0x96, 0x83, 0x2f, 0xd6, 0x8f,
+  0x76, 0xb1, 0x2f, 0xda, 0xc5, 0xbd, 0xef, 0x8d, 0x75, 0xd8, 0xa1, 0x72, 0x62, 0x39, 0x38, 0xf5,
+  0xb7, 0x5a, 0x18, 0xfb, 0xe2, 0xd4, 0xdf, 0x6a, 0x61, 0xd4, 0x7a, 0x14, 0xd4, 0x7a, 0x14, 0xcc,
+  0x78, 0xcb, 0xd1, 0x50, 0x72, 0xef, 0x7b, 0xa3, 0xa1, 0x64, 0xc6, 0x5b, 0x4e, 0xad, 0x47, 0x81,
+  0x61, 0x1d, 0x76, 0x98, 0xf1, 0x96, 0x63, 0x1d, 0x76, 0x68, 0x17, 0xed, 0xe2, 0xde, 0xf7, 0xc6,
+  0xd0, 0x50, 0xb2, 0x2f, 0x2c, 0x07, 0xd6, 0x61, 0x07, 0xc3, 0x3a, 0xec, 0x60, 0x1d, 0x76, 0x68,
+  0x17, 0xa7, 0xfe, 0x56, 0x8b, 0x19, 0x6f, 0x39, 0xf7, 0xbe, 0x37, 0x96, 0x03, 0x0d, 0x25, 0xed,
+  0xa2, 0x5d, 0xb4, 0x0b, 0x0d, 0x25, 0x95, 0x13, 0x0d, 0x25, 0x46, 0xbb, 0xd8, 0x17, 0xf7, 0xbe,
+  0x37, 0x96, 0x03, 0xeb, 0xb0, 0xc3, 0xbd, 0xef, 0x4d, 0xbb, 0xa8, 0xf5, 0x28, 0xa8, 0xf5, 0x28,
+  0xd8, 0x17, 0x5f, 0xac, 0x1f, 0xf7, 0xbe, 0x37, 0xfb, 0xe2, 0x8b, 0xf5, 0x63, 0xc6, 0x5b, 0x8e,
+  0x75, 0xd8, 0xa1, 0x72, 0x52, 0xeb, 0x51, 0xa0, 0xa1, 0xc4, 0x3a, 0xec, 0x60, 0xb4, 0x8b, 0x76,
+  0xd1, 0x2e, 0x2a, 0x27, 0x46, 0xad, 0x47, 0x81, 0xe5, 0x40, 0x43, 0x49, 0xbb, 0x68, 0x17, 0xfb,
+  0x62, 0x5f, 0x68, 0x28, 0xff, 0x01, 0xf3, 0xe7, 0xb5, 0x1d,
+};
+static const u8_t test_zlib_pixels_default[] = {
+  0x78, 0x9c, 0xed, 0xd0, 0xc1, 0x0d, 0x00, 0x20, 0x08, 0x43, 0x51, 0xf6, 0x5f, 0x5a, 0x4f, 0x5e,
+  0x4c, 0x8c, 0x04, 0x51, 0x84, 0xf6, 0x4d, 0xd0, 0x5f, 0x11, 0xa2, 0x77, 0x9a, 0x42, 0xf4, 0x46,
+  0x0b, 0x4d, 0x97, 0x37, 0xb4, 0xde, 0x1d, 0xc4, 0xe6, 0x15, 0xd4, 0xee, 0x19, 0x72, 0xfb, 0xc0,
+  0x7e, 0xf6, 0xa3, 0x7e, 0x70, 0xda, 0x9e, 0xf5, 0x07, 0xcf, 0xee, 0x2c, 0x5f, 0xdc, 0x6e, 0xfe,
+  0xed, 0x8f, 0xc8, 0x5e, 0xab, 0xaa, 0x5d, 0x59, 0x75, 0x49, 0xe8, 0x6c, 0xf6,
+};
+static const u8_t test_zlib_skewed_best[] = {
+  0x78, 0xda, 0x15, 0x57, 0xd9, 0x72, 0x5c, 0x49, 0x6e, 0x05, 0x32, 0x81, 0x44, 0xee, 0x77, 0xaf,
+  0xf5, 0x72, 0x2d, 0x92, 0x92, 0xa8, 0x51, 0x6b, 0x3a, 0x66, 0xc6, 0xea, 0x70, 0x84, 0xa7, 0xc3,
+  0x76, 0xcc, 0x8b, 0x5f, 0xfd, 0x27, 0xfe, 0xff, 0x07, 0x9f, 0xe2, 0x13, 0x83, 0xcc, 0xca, 0x42,
+  0x02, 0x67, 0x83, 0x59, 0xcc, 0x9d, 0x2d, 0x25, 0x97, 0x8c, 0x16, 0x2b, 0xe6, 0x88, 0xaf, 0xe7,
+  0x12, 0xfc, 0xd8, 0xe5, 0xdd, 0x4c, 0x48, 0xc8, 0x9a, 0x73, 0x36, 0xa8, 0x75, 0xe3, 0x65, 0x18,
+  0x43, 0x7a, 0x19, 0xbb, 0xea, 0x9b, 0x04, 0xcf, 0xb4, 0xa4, 0xbe, 0xa7, 0xaa, 0xe2, 0x6d, 0xcc,
+  0x44, 0x14, 0xb9, 0x8f, 0xd5, 0xaa, 0x13, 0x16, 0x17, 0x8f, 0x64, 0xf6, 0x5b, 0xa6, 0x9d, 0x55,
+  0x82, 0x6d, 0x26, 0xe5, 0x99, 0x3d, 0x1d, 0x85, 0x17, 0xe3, 0x90, 0xcd, 0x98, 0x4c, 0x16, 0x23,
+  0xe7, 0x65, 0x4f, 0xac, 0xf8, 0x90, 0xc5, 0x16, 0x53, 0xd3, 0xeb, 0x71, 0x38, 0x45, 0xcd, 0x4b,
+  0x36, 0xe5, 0xb1, 0x48, 0xf8, 0x7b, 0x38, 0x34, 0x23, 0xad, 0xd5, 0x57, 0x3b, 0x76, 0x0b, 0xab,
+  0x33, 0x3f, 0xa4, 0x16, 0x1e, 0xbb, 0x7a, 0x6f, 0x55, 0x5b, 0xa7, 0xd3, 0x5b, 0x25, 0x73, 0x21,
+  0xe5, 0xee, 0x71, 0x71, 0xdd, 0xaf, 0x0f, 0x16, 0xfa, 0xdf, 0x79, 0x63, 0xc7, 0xb3, 0xb1, 0x4f,
+  0xf2, 0x1e, 0x93, 0x5f, 0x4f, 0x46, 0x7f, 0xf5, 0xc9, 0x9c, 0xe7, 0x3f, 0xc5, 0xde, 0xba, 0x3c,
+  0xd8, 0xca, 0xd2, 0xeb, 0xf9, 0x81, 0x1e, 0x7d, 0xf6, 0x5c, 0x16, 0x7e, 0x1f, 0x5d, 0x9b, 0xbc,
+  0x0f, 0x76, 0xd1, 0xd5, 0x42, 0xb9, 0xb5, 0x16, 0xcc, 0xe9, 0xda, 0x6d, 0xe7, 0x5f, 0x41, 0x4d,
+  0xcc, 0xd4, 0x25, 0x9f, 0xe7, 0xde, 0x9d, 0x1f, 0x03, 0xab, 0x8b, 0x52, 0x2f, 0x91, 0xd8, 0x35,
+  0xf4, 0x29, 0xb8, 0x7e, 0x16, 0x75, 0x93, 0x0f, 0xc1, 0x69, 0xe0, 0x6e, 0x3e, 0xb8, 0xe5, 0x93,
+  0x6c, 0x3b, 0x1c, 0x82, 0xa4, 0x2e, 0x28, 0xbc, 0x73, 0x9c, 0x2c, 0x70, 0x33, 0xed, 0xcf, 0x1c,
+  0xa2, 0x0c, 0x83, 0x8b, 0x63, 0x8f, 0x7d, 0xf3, 0xce, 0xa6, 0x60, 0x7a, 0x55, 0xb3, 0x9d, 0x4c,
+  0xeb, 0x74, 0xb6, 0xe0, 0xad, 0xf9, 0xfe, 0x25, 0xbb, 0xcd, 0xbc, 0xeb, 0xab, 0x8b, 0x41, 0x6b,
+  0x78, 0x12, 0xe5, 0xb5, 0xe3, 0x17, 0xaf, 0xce, 0x91, 0x06, 0x8a, 0x8a, 0x49, 0xe9, 0x3f, 0xad,
+  0x85, 0x12, 0x83, 0x13, 0xff, 0xc3, 0xd5, 0x7c, 0xe5, 0xc1, 0x85, 0xc5, 0x5a, 0x1f, 0x9c, 0xe0,
+  0x4a, 0xef, 0x5c, 0x91, 0xd7, 0x6f, 0x41, 0xb7, 0xd0, 0x7b, 0x94, 0x4b, 0x96, 0x31, 0x49, 0x7b,
+  0x56, 0xb7, 0x4b, 0x60, 0x6f, 0x54, 0x47, 0x2e, 0x83, 0x78, 0x9a, 0x88, 0xbd, 0xb2, 0xb6, 0xc5,
+  0x7b, 0x97, 0x32, 0x6f, 0xae, 0xa5, 0x36, 0x8a, 0x0f, 0x8d, 0x35, 0xb7, 0x8a, 0x46, 0x86, 0xee,
+  0x37, 0x0e, 0xe6, 0xff, 0x63, 0x29, 0xb3, 0xd9, 0x89, 0x55, 0xe7, 0xbe, 0xf7, 0x6e, 0xf3, 0xec,
+  0xa3, 0x9b, 0x67, 0xb9, 0xc3, 0xa7, 0x39, 0xbf, 0xe6, 0x1c, 0x2c, 0xb1, 0x04, 0xa2, 0xcf, 0x98,
+  0x68, 0xb9, 0xe6, 0xa8, 0xd3, 0xd6, 0x3f, 0x9f, 0x03, 0xde, 0x84, 0xbe, 0x5c, 0x25, 0x8e, 0xd2,
+  0x92, 0x59, 0x12, 0xef, 0xa9, 0x3f, 0x95, 0x78, 0xd6, 0xbd, 0x16, 0xe7, 0xbc, 0x7b, 0x4a, 0xfe,
+  0x9b, 0xa3, 0x1e, 0xc9, 0x2f, 0x8e, 0x24, 0xa7, 0x83, 0x1f, 0x4d, 0xb6, 0xd0, 0xd0, 0xbd, 0x76,
+  0xd8, 0x63, 0xc8, 0x6a, 0x5a, 0xb2, 0xf9, 0x52, 0x9b, 0xbf, 0xce, 0x2e, 0xd8, 0xb5, 0x49, 0x71,
+  0xf1, 0x07, 0x9a, 0xbb, 0x70, 0x89, 0x28, 0x85, 0xdf, 0xc9, 0xe9, 0x65, 0xe7, 0x4e, 0xb6, 0xa2,
+  0xd8, 0x7e, 0x0b, 0xe1, 0x12, 0x86, 0x25, 0xa6, 0x90, 0xbd, 0x1c, 0xd1, 0x39, 0xb4, 0x0e, 0x73,
+  0x13, 0x29, 0xec, 0xcc, 0xfd, 0xe9, 0xbe, 0x5a, 0x48, 0x4c, 0xfb, 0xa5, 0x48, 0xef, 0x0f, 0x98,
+  0x58, 0x59, 0xa6, 0xb5, 0xb4, 0x53, 0x2d, 0xcf, 0x8e, 0xc6, 0x60, 0x23, 0x4f, 0x81, 0x8b, 0x53,
+  0xdf, 0xa2, 0x6c, 0xc6, 0x5c, 0x4a, 0x2d, 0x93, 0x44, 0x3d, 0xd4, 0xd6, 0xee, 0xb5, 0x94, 0x6d,
+  0xf2, 0x8f, 0x20, 0x81, 0x32, 0x6d, 0x42, 0x0e, 0x28, 0xd8, 0x88, 0x17, 0x2f, 0x01, 0x84, 0x30,
+  0xd1, 0x01, 0x00, 0x3a, 0xab, 0xdb, 0x82, 0x5c, 0x87, 0x4f, 0xd7, 0x28, 0xc9, 0xc5, 0xb3, 0xf3,
+  0xe6, 0xfa, 0x47, 0xe2, 0x4d, 0x3d, 0x89, 0x8f, 0xcb, 0xf1, 0x22, 0xd4, 0xa8, 0x0b, 0x79, 0x66,
+  0xff, 0x7a, 0x1e, 0xf1, 0x09, 0x2a, 0x8f, 0xc0, 0x0a, 0x77, 0x49, 0xe6, 0x85, 0x96, 0x3c, 0x97,
+  0x3c, 0xa5, 0x4a, 0xdf, 0x34, 0x7d, 0xa0, 0xcd, 0x19, 0x2d, 0xb4, 0x2e, 0x5f, 0xac, 0x2e, 0x98,
+  0xbd, 0xe0, 0x64, 0xb3, 0x85, 0xa7, 0xd3, 0xd3, 0x65, 0x55, 0x01, 0xcd, 0x00, 0xd2, 0x63, 0x04,
+  0x0d, 0x36, 0x55, 0x57, 0x8d, 0x3e, 0xdf, 0x63, 0x06, 0xfa, 0xb5, 0x90, 0xc4, 0xa6, 0x63, 0x4f,
+  0x16, 0xdf, 0x0b, 0xea, 0xd5, 0xc9, 0xbd, 0x6c, 0x83, 0xea, 0xe3, 0xbe, 0xfe, 0xa0, 0x8b, 0xd4,
+  0xc9, 0x06, 0xfa, 0x5b, 0xd4, 0x1e, 0x1b, 0x48, 0x31, 0xd8, 0x92, 0x39, 0x9c, 0x30, 0xa6, 0xe0,
+  0xc0, 0x66, 0x9d, 0x68, 0x01, 0xc9, 0xa7, 0x18, 0x52, 0x27, 0xd7, 0xf6, 0xa7, 0xe0, 0xc2, 0xd6,
+  0x96, 0x07, 0xda, 0x00, 0x16, 0xc7, 0x31, 0x7d, 0x33, 0xf5, 0x5f, 0xc4, 0xeb, 0x73, 0xa1, 0x34,
+  0x6d, 0x5b, 0x5d, 0x89, 0xc0, 0xef, 0x5f, 0xfc, 0x73, 0x1e, 0xd5, 0xf9, 0x37, 0x3d, 0xde, 0x31,
+  0x96, 0xb5, 0xb1, 0x5b, 0x3d, 0x48, 0xba, 0x83, 0x64, 0x9b, 0xf5, 0x75, 0x53, 0x1b, 0xba, 0x45,
+  0x66, 0x28, 0x81, 0x9b, 0x43, 0x98, 0x89, 0x82, 0x74, 0x68, 0x50, 0x07, 0xfe, 0x02, 0xde, 0xfa,
+  0x17, 0x7f, 0x0c, 0x02, 0xfc, 0x81, 0x34, 0x9b, 0x86, 0x8f, 0xb5, 0xbc, 0x1a, 0xf5, 0xd2, 0x03,
+  0x3b, 0x74, 0xf5, 0x83, 0xc5, 0xaa, 0xd8, 0x71, 0xb8, 0x4b, 0x54, 0x64, 0x9b, 0x74, 0xe1, 0xbf,
+  0x3d, 0x6b, 0x14, 0x03, 0x9e, 0xc3, 0xe8, 0x43, 0xb7, 0x72, 0x9f, 0x43, 0x08, 0x83, 0x14, 0x6d,
+  0x77, 0x01, 0x9b, 0x2a, 0x11, 0x98, 0x59, 0xf5, 0x16, 0x2e, 0x5b, 0x8a, 0xfe, 0xdc, 0xd5, 0x20,
+  0x6e, 0x7b, 0x90, 0xf8, 0xdd, 0x1d, 0x15, 0x13, 0x2c, 0x13, 0x2f, 0x4b, 0xe8, 0xca, 0x2e, 0xb4,
+  0x9a, 0x6e, 0xd5, 0x01, 0xdb, 0xe7, 0x04, 0x8d, 0x23, 0x7f, 0x97, 0x2c, 0xc3, 0x1c, 0xb4, 0xb7,
+  0x45, 0xeb, 0xe6, 0xf3, 0xaa, 0x8e, 0x86, 0xec, 0x4b, 0x60, 0x0c, 0x2a, 0x08, 0xa7, 0xe0, 0x89,
+  0xd1, 0xfe, 0x1e, 0x84, 0x40, 0x0f, 0xb7, 0xf4, 0x10, 0xff, 0x00, 0x8f, 0x2f, 0x78, 0x82, 0x44,
+  0x00, 0xba, 0x38, 0x9e, 0x1e, 0x7e, 0x8c, 0xb9, 0x41, 0x9a, 0x20, 0x89, 0xd9, 0xce, 0x38, 0xfd,
+  0x34, 0xf0, 0x46, 0x93, 0x83, 0x1c, 0x4a, 0xbd, 0x8e, 0x1c, 0x46, 0xdb, 0x4e, 0x3d, 0x00, 0x52,
+  0xf6, 0x73, 0xb7, 0xdc, 0x3c, 0x05, 0x83, 0xfe, 0xdd, 0x82, 0x3c, 0x67, 0xfc, 0x8f, 0x73, 0x53,
+  0x87, 0xbb, 0x21, 0x13, 0x36, 0x81, 0xcf, 0x47, 0xa8, 0xab, 0xff, 0x71, 0xfa, 0xb1, 0xe9, 0x6b,
+  0xb1, 0xbc, 0xbb, 0x21, 0xdf, 0xdf, 0x17, 0x77, 0xd2, 0xc3, 0x98, 0x9a, 0x03, 0x46, 0xa1, 0x20,
+  0x6d, 0x8d, 0xf6, 0x7f, 0x40, 0xb0, 0xd9, 0x75, 0x39, 0xf8, 0x0e, 0x98, 0x3c, 0x91, 0xc5, 0x99,
+  0x5a, 0xba, 0x57, 0xee, 0xec, 0xd5, 0x8e, 0x4d, 0xbb, 0xa6, 0xe0, 0xea, 0x6a, 0x5f, 0x40, 0x91,
+  0xec, 0x8a, 0x8a, 0xf4, 0x70, 0xa9, 0x54, 0x65, 0x48, 0xc4, 0xf8, 0x39, 0x05, 0x09, 0x3d, 0x3a,
+  0xcc, 0x5b, 0x3a, 0x49, 0xf2, 0x44, 0xcd, 0x42, 0x95, 0x93, 0x0b, 0x03, 0x4a, 0xfa, 0xe9, 0x73,
+  0x45, 0x87, 0x29, 0xf1, 0x40, 0x9f, 0x1f, 0x21, 0xde, 0x48, 0x74, 0x1f, 0x54, 0xda, 0x5c, 0xfd,
+  0x67, 0x2f, 0xa7, 0x7b, 0x7f, 0x30, 0x65, 0xe8, 0x4c, 0xd2, 0x21, 0x1e, 0x82, 0xbf, 0xd8, 0xeb,
+  0x23, 0xdb, 0xee, 0x5b, 0x90, 0x83, 0x07, 0x29, 0xa0, 0x19, 0xae, 0x09, 0x3b, 0xb9, 0x40, 0xb8,
+  0xd1, 0xd5, 0x3b, 0xe1, 0x80, 0xbd, 0x91, 0xb2, 0xd5, 0x8b, 0xf0, 0x0b, 0x60, 0x48, 0x9d, 0x77,
+  0x07, 0x56, 0x0f, 0xb6, 0x6d, 0x02, 0x72, 0xf4, 0x52, 0xb8, 0x18, 0xa4, 0xa4, 0xd9, 0xe1, 0x76,
+  0x84, 0x8d, 0xe4, 0xac, 0xbf, 0xeb, 0x5b, 0xbb, 0xa1, 0xb2, 0xdf, 0x74, 0x69, 0xcd, 0x59, 0xd2,
+  0xa4, 0xb5, 0xe4, 0xd0, 0x93, 0xeb, 0x53, 0xc9, 0xb8, 0x8d, 0x37, 0x50, 0x3e, 0x68, 0xbb, 0xfa,
+  0x0f, 0x1b, 0x2c, 0x53, 0x35, 0x9f, 0x9b, 0x6c, 0xae, 0x7b, 0x3b, 0x86, 0x26, 0xd2, 0xdc, 0x6b,
+  0x36, 0xbe, 0xd0, 0xab, 0x4c, 0x79, 0x50, 0x5c, 0xfe, 0xeb, 0xdf, 0xa8, 0xd4, 0xa0, 0xa0, 0x7d,
+  0xeb, 0x82, 0xa6, 0xc8, 0x96, 0xa9, 0x87, 0x3f, 0x7a, 0x39, 0x47, 0x8d, 0x85, 0xd1, 0xd3, 0x8c,
+  0xfa, 0x27, 0xeb, 0x9a, 0x57, 0x08, 0xea, 0x5d, 0x44, 0x2e, 0x06, 0x23, 0x54, 0x40, 0x15, 0x43,
+  0xac, 0x04, 0xff, 0x3a, 0x6d, 0x80, 0x8e, 0x32, 0x7f, 0x4f, 0x38, 0xb1, 0x3a, 0x2a, 0x41, 0xa3,
+  0x43, 0x79, 0x43, 0x03, 0x72, 0x1b, 0xe5, 0xf9, 0x70, 0xe3, 0xfd, 0x02, 0x11, 0xb2, 0x01, 0x78,
+  0xeb, 0x8e, 0x07, 0x63, 0xf1, 0x0e, 0xd6, 0x49, 0xbe, 0x8e, 0xc9, 0xaa, 0x9d, 0xca, 0x9d, 0xdc,
+  0x6e, 0x0f, 0x74, 0x3b, 0x12, 0x50, 0x0a, 0xdf, 0x2c, 0x1c, 0x28, 0xe9, 0x45, 0x77, 0x69, 0x52,
+  0xdf, 0xdd, 0x5d, 0xcc, 0x63, 0xe0, 0x9c, 0xd8, 0x8a, 0x43, 0x43, 0x9c, 0x69, 0xc4, 0x09, 0xdf,
+  0xce, 0x07, 0xf9, 0x5a, 0x3c, 0x7e, 0x81, 0xc0, 0xe7, 0xee, 0x36, 0xde, 0x43, 0xa0, 0xfa, 0x68,
+  0x0a, 0x8a, 0xf8, 0x15, 0xde, 0xdf, 0xf1, 0xf6, 0x5c, 0xb2, 0x40, 0xd3, 0xfb, 0x18, 0x1e, 0x6c,
+  0xb1, 0x0e, 0x8b, 0xef, 0x2d, 0x69, 0xcb, 0xd1, 0x63, 0xd4, 0xde, 0x2f, 0x2b, 0xf5, 0x2b, 0x70,
+  0x8e, 0x3c, 0xd0, 0x0c, 0xbe, 0x67, 0x6e, 0xa9, 0xb4, 0xd9, 0x41, 0xef, 0x55, 0x85, 0xbb, 0xec,
+  0xc8, 0x53, 0xe3, 0xad, 0x57, 0x40, 0xc0, 0x97, 0x63, 0x5d, 0x3e, 0xfc, 0xc3, 0x70, 0xe6, 0x09,
+  0x6f, 0xde, 0xf2, 0x09, 0x04, 0x5d, 0x58, 0x2f, 0x73, 0xbd, 0xb0, 0x96, 0xb8, 0x5b, 0x43, 0xa1,
+  0xdd, 0xac, 0x77, 0x9a, 0x8d, 0xf8, 0xe2, 0xfd, 0x7f, 0x43, 0x1e, 0x75, 0x31, 0x9b, 0x83, 0xe3,
+  0x37, 0x74, 0x8a, 0x14, 0xaf, 0xa3, 0x73, 0x01, 0x5a, 0xee, 0x7d, 0x0c, 0xf9, 0xa5, 0xc7, 0x0f,
+  0xa4, 0x8e, 0xce, 0x10, 0x1c, 0xd0, 0x3f, 0x70, 0xf5, 0xfe, 0xc5, 0x5e, 0x87, 0x6c, 0x23, 0x26,
+  0xf7, 0x02, 0x7b, 0xda, 0xa0, 0x98, 0x67, 0x7c, 0x8b, 0x9d, 0x28, 0x9c, 0xd7, 0x7f, 0x10, 0x9d,
+  0x36, 0x79, 0x39, 0x59, 0xae, 0x61, 0x19, 0xc3, 0x09, 0xb2, 0xd7, 0xeb, 0xb2, 0x14, 0x51, 0xbb,
+  0xe9, 0xcc, 0x71, 0xe9, 0xee, 0xa7, 0x06, 0x0c, 0x10, 0x99, 0x62, 0x75, 0xf0, 0x42, 0x93, 0x59,
+  0xe5, 0x6c, 0x06, 0xef, 0xb2, 0x2f, 0x18, 0x5b, 0xb8, 0xba, 0x99, 0x10, 0x89, 0x8a, 0x30, 0x82,
+  0x09, 0x92, 0x8f, 0x47, 0x48, 0xf8, 0xeb, 0x0e, 0x63, 0x8a, 0xe6, 0xef, 0x41, 0x80, 0x45, 0xf8,
+  0xcb, 0x29, 0xd9, 0x5c, 0xe0, 0xbb, 0xbe, 0xe7, 0x96, 0xfe, 0xe5, 0x15, 0xd9, 0x01, 0x53, 0x85,
+  0x07, 0xc9, 0xb1, 0xb2, 0x4c, 0xd0, 0x83, 0x57, 0x85, 0xb5, 0x85, 0x54, 0xde, 0xed, 0x77, 0xf4,
+  0xce, 0x24, 0x7f, 0xbd, 0x59, 0x79, 0xe8, 0xeb, 0x08, 0x1d, 0xf7, 0x26, 0xff, 0x6e, 0x48, 0x04,
+  0xd0, 0x06, 0x3c, 0x11, 0x6e, 0x88, 0xc4, 0xa3, 0xca, 0xd0, 0xdc, 0x18, 0x71, 0x49, 0xce, 0x99,
+  0x87, 0x67, 0x79, 0x73, 0xd1, 0x34, 0xf8, 0x6b, 0x6d, 0x6f, 0xe3, 0x6c, 0x5f, 0x41, 0x57, 0x58,
+  0x0f, 0xc4, 0xe8, 0xb6, 0xb3, 0xc4, 0xda, 0x61, 0x1e, 0x99, 0x66, 0x61, 0xbc, 0xd8, 0x3f, 0x23,
+  0xe3, 0x9c, 0xa3, 0x87, 0x36, 0x21, 0x07, 0x04, 0x99, 0x12, 0xed, 0x48, 0x47, 0xa5, 0x3e, 0xc3,
+  0x8f, 0x02, 0x41, 0xe8, 0x2a, 0xda, 0x8c, 0xc2, 0xe4, 0x7b, 0xf0, 0x4d, 0xee, 0xe5, 0xc2, 0x75,
+  0x3d, 0xdc, 0x84, 0x08, 0x2c, 0x80, 0x81, 0xdd, 0x23, 0x05, 0x12, 0x5f, 0x8a, 0x93, 0x3b, 0x0d,
+  0x37, 0x84, 0x97, 0xb1, 0x50, 0x5c, 0x23, 0x0e, 0xe5, 0x2a, 0x69, 0x07, 0x7d, 0x74, 0x2c, 0x0d,
+  0x65, 0x36, 0x45, 0x62, 0x72, 0x6d, 0xb0, 0x52, 0xd9, 0xd6, 0xf8, 0x67, 0xd8, 0x99, 0xae, 0xc3,
+  0x40, 0x03, 0x6a, 0x3d, 0x3e, 0xba, 0xfb, 0xb0, 0x60, 0x12, 0x19, 0x20, 0x5e, 0x00, 0xd2, 0x3b,
+  0xfa, 0x20, 0x7f, 0x4f, 0x19, 0xfd, 0xcf, 0xdb, 0x0d, 0xf1, 0x21, 0x56, 0xd6, 0xa7, 0xb2, 0x5f,
+  0xb9, 0x00, 0x1d, 0x9d, 0xb3, 0x1d, 0x10, 0xe0, 0x1e, 0xa1, 0x87, 0xff, 0xec, 0x14, 0x74, 0xe5,
+  0xad, 0x5a, 0x86, 0xec, 0x08, 0x0d, 0xcf, 0x6f, 0xcc, 0xfb, 0xeb, 0x05, 0x44, 0xf3, 0x0b, 0xe2,
+  0x57, 0xd3, 0xb0, 0x80, 0x66, 0xc9, 0x47, 0xb5, 0x79, 0xc1, 0x93, 0x96, 0x15, 0xd5, 0x9d, 0x91,
+  0x63, 0x30, 0xad, 0x32, 0xa6, 0xc5, 0x02, 0x92, 0xd5, 0x64, 0xf3, 0xaa, 0x59, 0x4f, 0xa7, 0x02,
+  0x1c, 0x2d, 0xf3, 0x0d, 0xd2, 0x77, 0x0f, 0x13, 0x43, 0x42, 0x24, 0x32, 0x19, 0xed, 0x0d, 0xe1,
+  0x29, 0x4c, 0x23, 0x22, 0x04, 0xd2, 0x85, 0xfd, 0xa1, 0x0d, 0x30, 0x4a, 0x50, 0x7c, 0x17, 0x4f,
+  0xbe, 0x2e, 0xdb, 0xca, 0xbc, 0x02, 0x8a, 0x5b, 0xec, 0x4f, 0xf9, 0xb0, 0x8e, 0x7d, 0xea, 0x13,
+  0x22, 0x11, 0x4e, 0xf7, 0xe6, 0xef, 0xef, 0x3e, 0xda, 0x09, 0x23, 0x06, 0x5e, 0x5b, 0x05, 0xfa,
+  0x27, 0x87, 0x3c, 0x18, 0x2a, 0x71, 0xc6, 0xa3, 0x0f, 0x13, 0x6e, 0x76, 0x07, 0x6b, 0x62, 0xff,
+  0x99, 0xf1, 0x10, 0x28, 0x1b, 0x21, 0x3f, 0xd6, 0x00, 0x67, 0x73, 0x40, 0xf0, 0x27, 0xbc, 0x21,
+  0x24, 0xb7, 0x75, 0xaf, 0x30, 0xe7, 0x80, 0x58, 0x09, 0x35, 0x92, 0x15, 0x9a, 0x83, 0xc8, 0x72,
+  0x57, 0x27, 0xfb, 0xb4, 0xdf, 0x9d, 0x57, 0xdb, 0x63, 0xcf, 0x05, 0xfa, 0x0a, 0xa4, 0x43, 0x57,
+  0x8f, 0x84, 0x2f, 0x36, 0xbf, 0x75, 0x07, 0xee, 0x42, 0xf9, 0x4f, 0xc0, 0x4d, 0x12, 0x5c, 0x05,
+  0x2b, 0x50, 0xea, 0xf8, 0xd3, 0x8f, 0x38, 0xf2, 0x68, 0x9e, 0xc3, 0xd9, 0x75, 0x7c, 0x72, 0x1e,
+  0x07, 0x11, 0x37, 0x57, 0x0d, 0x29, 0xc0, 0xbd, 0x2b, 0xce, 0x1f, 0x01, 0x5c, 0xb7, 0x1d, 0x5c,
+  0xc6, 0xd8, 0xd1, 0x9f, 0x24, 0xe7, 0x34, 0xbb, 0x09, 0x12, 0xd2, 0x69, 0x4d, 0x75, 0x76, 0xdb,
+  0xa8, 0x53, 0x75, 0x27, 0xab, 0xfc, 0xb1, 0x04, 0x47, 0xa7, 0xf0, 0x20, 0x34, 0xfd, 0x86, 0x87,
+  0xc2, 0x22, 0x15, 0x6d, 0x9a, 0x9d, 0x43, 0xa8, 0xa0, 0x72, 0x43, 0xba, 0xcc, 0x2d, 0xf3, 0x6a,
+  0x1d, 0x4a, 0x89, 0xf0, 0xa3, 0xf5, 0xe2, 0xee, 0x87, 0x9e, 0x19, 0x6b, 0x80, 0x46, 0x18, 0x09,
+  0x6c, 0xa2, 0x9a, 0x8d, 0xdb, 0xa9, 0x3a, 0x0f, 0x97, 0x08, 0xaf, 0xd1, 0x2d, 0xda, 0xe8, 0xc3,
+  0x10, 0x93, 0x10, 0xc1, 0x6b, 0xce, 0x9f, 0x23, 0x0c, 0xfd, 0xa1, 0x0d, 0x25, 0x3d, 0x40, 0x82,
+  0xa1, 0x74, 0x5b, 0x73, 0xe9, 0x07, 0xbc, 0x6b, 0x23, 0x7f, 0x16, 0x86, 0x47, 0x2d, 0xec, 0x37,
+  0x2f, 0xea, 0xb1, 0x9d, 0xdc, 0xea, 0xd1, 0xe2, 0xb2, 0x4a, 0x15, 0xe7, 0xe1, 0x07, 0xcd, 0xaf,
+  0x98, 0x71, 0x4b, 0xd4, 0xeb, 0xdc, 0x40, 0xff, 0x11, 0x47, 0x9e, 0xb9, 0xc3, 0x2d, 0xac, 0x9f,
+  0x20, 0x6a, 0xf4, 0x06, 0x7f, 0x22, 0x00, 0xb3, 0x43, 0xa3, 0x00, 0xf2, 0xd9, 0x3a, 0x26, 0x90,
+  0x3f, 0xc1, 0x37, 0xb4, 0xcb, 0x46, 0xdc, 0xb1, 0x21, 0xf8, 0x85, 0xfb, 0x6a, 0xd0, 0x4f, 0x78,
+  0x12, 0x80, 0x0f, 0x01, 0x8f, 0x71, 0xb6, 0xe5, 0xeb, 0xb4, 0x41, 0x9e, 0x8d, 0x81, 0x7b, 0x1c,
+  0x16, 0x5c, 0xe9, 0x2b, 0xc4, 0xc3, 0xfb, 0x3b, 0x28, 0x11, 0x86, 0xfb, 0x9d, 0xe1, 0x2f, 0x04,
+  0xa3, 0x1f, 0x38, 0x6f, 0x7d, 0xe0, 0xa3, 0x73, 0xd7, 0x51, 0x5e, 0xee, 0xde, 0x7e, 0x07, 0x55,
+  0x2b, 0x08, 0x5b, 0x8f, 0x21, 0x5e, 0x15, 0xec, 0xd9, 0x80, 0xcb, 0x5f, 0x00, 0xc4, 0xb3, 0x5c,
+  0xd3, 0xe9, 0x53, 0x13, 0xb7, 0x1d, 0xab, 0x40, 0x23, 0x3e, 0x98, 0x3c, 0x7a, 0x27, 0x83, 0x3d,
+  0x14, 0x04, 0x74, 0x72, 0xf0, 0xd2, 0x09, 0x02, 0x3e, 0x23, 0xce, 0xd0, 0xef, 0x4e, 0xa2, 0x55,
+  0x24, 0x38, 0x2c, 0x63, 0x51, 0xd9, 0x7f, 0x3f, 0xad, 0xd0, 0x42, 0x17, 0xf9, 0x74, 0x8f, 0xf2,
+  0xfd, 0x0e, 0x5f, 0x7e, 0x2c, 0xf0, 0xcb, 0xb1, 0x77, 0xa9, 0x5d, 0x74, 0x29, 0xc0, 0x06, 0x0f,
+  0xb7, 0xcd, 0x77, 0x8a, 0x1d, 0xc2, 0x2d, 0x80, 0x0a, 0xbc, 0x02, 0xc4, 0x84, 0x64, 0x6f, 0x0e,
+  0xaa, 0x86, 0x69, 0x05, 0x30, 0x31, 0x67, 0x64, 0xec, 0x73, 0x82, 0x56, 0x0d, 0x6b, 0x1a, 0x7e,
+  0x58, 0x86, 0xa9, 0xf6, 0x3c, 0x62, 0x33, 0x08, 0xdb, 0xd4, 0xe7, 0x5a, 0x10, 0xb6, 0x20, 0xbd,
+  0xf3, 0xb6, 0xf6, 0x99, 0x18, 0x30, 0xc5, 0x5e, 0x26, 0x58, 0x7b, 0xe8, 0x40, 0xdb, 0x14, 0xd6,
+  0x50, 0xed, 0x67, 0xbb, 0xde, 0x35, 0x92, 0x26, 0x48, 0xfa, 0xed, 0x00, 0x35, 0xc6, 0x0a, 0x07,
+  0x31, 0x2a, 0x51, 0x13, 0xa2, 0x78, 0xc3, 0x8a, 0x11, 0xc6, 0xb1, 0x3f, 0x61, 0x44, 0x90, 0x12,
+  0x24, 0xf5, 0xad, 0x43, 0xe8, 0x35, 0x88, 0xcc, 0x85, 0xae, 0x1e, 0x58, 0x2e, 0xeb, 0x1c, 0xef,
+  0x76, 0xca, 0x90, 0x9d, 0xa4, 0x7e, 0x39, 0x59, 0x81, 0x33, 0xbc, 0x71, 0xa6, 0xe1, 0xb0, 0xea,
+  0x4d, 0x97, 0xba, 0xed, 0xa1, 0x7f, 0x20, 0x0a, 0xe8, 0x27, 0x76, 0x0e, 0xf3, 0x69, 0xcd, 0x29,
+  0x87, 0xd7, 0xd4, 0x7c, 0x45, 0xd4, 0x02, 0x0f, 0xc7, 0xbe, 0x02, 0x6b, 0x47, 0xf1, 0x9f, 0xf0,
+  0x45, 0x2c, 0x2e, 0x41, 0x5e, 0x57, 0xe0, 0x3f, 0xfb, 0x9b, 0xed, 0x9b, 0x7c, 0xde, 0xf3, 0x1c,
+  0xd6, 0x37, 0xd7, 0x65, 0x59, 0x7e, 0xbe, 0xb8, 0x16, 0xad, 0x14, 0x9f, 0xb0, 0x7f, 0xc6, 0x2a,
+  0x78, 0x5f, 0xe6, 0xbb, 0xce, 0x46, 0x58, 0xd6, 0xfb, 0xff, 0xc0, 0xfb, 0xae, 0xcd, 0x1f, 0x00,
+  0xd4, 0x8c, 0xb1, 0x6e, 0xdf, 0x06, 0x56, 0x12, 0xf7, 0xd9, 0xe1, 0x2d, 0x03, 0x44, 0x1b, 0x2e,
+  0xd3, 0xa0, 0x17, 0x5e, 0x37, 0x4a, 0xd8, 0x1a, 0xc0, 0xff, 0x09, 0x9b, 0x10, 0x28, 0x77, 0x70,
+  0xb2, 0xf9, 0x67, 0x76, 0xb5, 0x58, 0xb9, 0x12, 0x4d, 0xdb, 0xee, 0x46, 0x58, 0xd7, 0x91, 0xf6,
+  0x17, 0xbe, 0x5c, 0x9c, 0x9f, 0x23, 0x42, 0x6a, 0x39, 0xb0, 0x1e, 0xd4, 0x23, 0x7c, 0x70, 0x3b,
+  0x34, 0xff, 0x27, 0xc4, 0x10, 0x8a, 0xa4, 0xff, 0x1b, 0xb1, 0xab, 0xf2, 0x82, 0xbb, 0xbb, 0x1b,
+  0x88, 0x31, 0x18, 0xc2, 0x17, 0xfd, 0x17, 0x3b, 0x6a, 0xf2, 0x1d, 0xf1, 0x57, 0x89, 0x56, 0xcb,
+  0xe7, 0x57, 0x33, 0xbf, 0xb6, 0xa7, 0x0b, 0xda, 0x84, 0xdc, 0xb3, 0x60, 0xdc, 0x2e, 0x25, 0xec,
+  0x8d, 0x01, 0xc2, 0xcd, 0x9c, 0x72, 0x05, 0x5b, 0x31, 0x21, 0xaf, 0xd0, 0xc5, 0x5f, 0x78, 0x0d,
+  0x72, 0x42, 0xdc, 0x0b, 0xcc, 0xe3, 0x1e, 0x9b, 0xc2, 0x19, 0x32, 0x05, 0x6f, 0xcf, 0x94, 0x6f,
+  0x65, 0x76, 0x5f, 0xb5, 0xc3, 0x77, 0x6d, 0xfb, 0x0c, 0x27, 0x6c, 0x0f, 0xc3, 0x13, 0xc2, 0x47,
+  0xc1, 0x6a, 0x5d, 0x36, 0x99, 0x7a, 0xf8, 0x7f, 0xc9, 0x22, 0xa7, 0x32,
+};
+static const u8_t test_zlib_noise_default[] = {
+  0x78, 0x9c, 0x01, 0x00, 0x01, 0xff, 0xfe, 0x63, 0x03, 0x47, 0x49, 0xcb, 0xf3, 0x43, 0x04, 0x0f,
+  0x4f, 0x01, 0x0a, 0x83, 0x8a, 0xcb, 0x4f, 0xb7, 0xf7, 0xa4, 0x82, 0xbb, 0x51, 0x61, 0xd6, 0x15,
+  0x4d, 0xa1, 0xd1, 0xfb, 0xe7, 0x94, 0x63, 0xd0, 0x53, 0xdd, 0x9e, 0xd8, 0x45, 0x9b, 0xda, 0xa5,
+  0x9f, 0x56, 0x91, 0x95, 0xea, 0x19, 0x60, 0xe1, 0x76, 0xa1, 0xc3, 0x80, 0x7f, 0x43, 0x57, 0xb4,
+  0x2d, 0x42, 0x74, 0xa0, 0xa9, 0x7c, 0x05, 0x46, 0x80, 0x56, 0x1c, 0xf4, 0x41, 0x69, 0xe2, 0xcc,
+  0xfe, 0xe9, 0x3e, 0x6b, 0x57, 0x4e, 0x06, 0x89, 0xb6, 0x85, 0x6a, 0xd9, 0xcf, 0x54, 0x1e, 0xd6,
+  0xf5, 0x60, 0xea, 0x40, 0x7b, 0x80, 0x98, 0xd6, 0xa9, 0xad, 0x30, 0x03, 0x8b, 0xa5, 0x4e, 0x3a,
+  0x84, 0xe0, 0x31, 0xb7, 0x09, 0xc8, 0x05, 0x8c, 0x36, 0x95, 0x82, 0x81, 0x23, 0x25, 0x45, 0xff,
+  0x13, 0x7a, 0xdb, 0xc9, 0x8a, 0xdb, 0xc4, 0xb9, 0x1e, 0x5c, 0x9d, 0x52, 0x87, 0xbd, 0x49, 0x55,
+  0x97, 0x85, 0x0a, 0x92, 0x58, 0xed, 0xbc, 0xaf, 0xdd, 0xaa, 0x6e, 0x01, 0x5f, 0xf9, 0x93, 0x1c,
+  0x3f, 0x0d, 0xb1, 0xe6, 0xbb, 0x00, 0x14, 0x85, 0xa2, 0x2b, 0xc7, 0x5d, 0x4b, 0xc1, 0x61, 0xd1,
+  0xef, 0x9f, 0x28, 0x53, 0x80, 0xfd, 0xd2, 0x25, 0xe9, 0x51, 0x59, 0x8e, 0x75, 0xf5, 0xfd, 0x95,
+  0x29, 0xa5, 0xe7, 0x52, 0x74, 0xf9, 0xb9, 0x9e, 0xad, 0xb4, 0xa5, 0x8b, 0x58, 0xb8, 0xe8, 0x80,
+  0x99, 0xde, 0x3b, 0x32, 0x5e, 0x33, 0x16, 0xd6, 0xec, 0x36, 0x38, 0x5f, 0xd2, 0xd9, 0x39, 0x81,
+  0xf6, 0xf5, 0x19, 0x1a, 0x49, 0xd4, 0x67, 0xf5, 0x01, 0x60, 0x38, 0x40, 0x55, 0xb3, 0xea, 0xf6,
+  0x6a, 0xbe, 0x9e, 0x34, 0x9b, 0xcd, 0x34, 0x06, 0x4c, 0x2e, 0x0f, 0x2b, 0x1c, 0xe7, 0xeb, 0xe8,
+  0xaf, 0x6c, 0xdc, 0x27, 0xf5, 0x8e, 0xd2, 0x34, 0x16, 0x83, 0x6d,
+};
+static const u8_t test_zlib_zeros_best[] = {
+  0x78, 0xda, 0xed, 0xc1, 0x31, 0x01, 0x00, 0x00, 0x00, 0xc2, 0xa0, 0xf5, 0x4f, 0x6d, 0x09, 0x4f,
+  0xa0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x80, 0xb7, 0x01, 0x11, 0x7f, 0x00, 0x01,
+};
+static const u8_t test_zlib_empty[] = {
+  0x78, 0x9c, 0x03, 0x00, 0x00, 0x00, 0x00, 0x01,
+};
+
+typedef void test_zlib_make_f(u8_t* out, u32_t size);
+
+static u32_t
+test_zlib_xorshift(u32_t* x) {
+  *x ^= *x << 13;
+  *x ^= *x >> 17;
+  *x ^= *x << 5;
+  return *x;
+}
+
+static void
+test_zlib_make_text(u8_t* out, u32_t size) {
+  static const char* words[] = {
+    "atlas", "glyph", "sprite", "pixel", "the", "of",
+    "and", "a", "momo", "eden", "png", "zlib"
+  };
+  u32_t x = 1;
+  u32_t i = 0;
+  while (i < size) {
+    const char* word = words[test_zlib_xorshift(&x) % array_count(words)];
+    for (; *word && i < size; ++word) out[i++] = (u8_t)*word;
+    if (i < size) out[i++] = ' ';
+  }
+}
+
+// A 64x16 white disc on a transparent background
+static void
+test_zlib_make_pixels(u8_t* out, u32_t size) {
+  assert(size == 64 * 16 * 4);
+  for (s32_t y = 0; y < 16; ++y) {
+    for (s32_t x = 0; x < 64; ++x) {
+      b32_t inside = (x - 32) * (x - 32) + (y - 8) * (y - 8) * 16 < 600;
+      u8_t v = inside ? 255 : 0;
+      u8_t* p = out + (y * 64 + x) * 4;
+      p[0] = p[1] = p[2] = p[3] = v;
+    }
+  }
+}
+
+// Byte frequencies that halve every 8 values or so, which makes long codes
+static void
+test_zlib_make_skewed(u8_t* out, u32_t size) {
+  u32_t x = 2;
+  for (u32_t i = 0; i < size; ++i) {
+    u32_t v = test_zlib_xorshift(&x);
+    u32_t trailing_zeros = 0;
+    while (trailing_zeros < 32 && !((v >> trailing_zeros) & 1)) ++trailing_zeros;
+    out[i] = (u8_t)(trailing_zeros * 7 + (v >> 29));
+  }
+}
+
+static void
+test_zlib_make_noise(u8_t* out, u32_t size) {
+  u32_t x = 3;
+  for (u32_t i = 0; i < size; ++i) out[i] = (u8_t)test_zlib_xorshift(&x);
+}
+
+static void
+test_zlib_make_zeros(u8_t* out, u32_t size) {
+  memory_zero(out, size);
+}
+
+struct test_zlib_case_t {
+  const char* name;
+  const u8_t* stream;
+  u32_t stream_size;
+  test_zlib_make_f* make;
+  u32_t size;
+};
+
+#define test_zlib_case(name, make, size) { #name, test_zlib_##name, sizeof(test_zlib_##name), make, size }
+
+static const test_zlib_case_t test_zlib_cases[] = {
+  test_zlib_case(text_stored, test_zlib_make_text, 300),
+  test_zlib_case(text_fixed, test_zlib_make_text, 1024),
+  test_zlib_case(text_default, test_zlib_make_text, 2048),
+  test_zlib_case(text_rle, test_zlib_make_text, 512),
+  test_zlib_case(pixels_default, test_zlib_make_pixels, 4096),
+  test_zlib_case(skewed_best, test_zlib_make_skewed, 4096),
+  test_zlib_case(noise_default, test_zlib_make_noise, 256),
+  test_zlib_case(zeros_best, test_zlib_make_zeros, 70000),
+  test_zlib_case(empty, test_zlib_make_zeros, 0),
+};
+
+//
+// Checks that every stream should pass
+//
+
+// @note: A valid stream must decode to exactly 'expected', and fail when
+// cut short, when 'dest' is a byte short, and with corrupted trailers.
+// Flipping bits anywhere else must not crash, whatever it decodes to.
+static b32_t
+test_zlib_check_stream(buf_t stream, buf_t expected, b32_t is_raw, arena_t* arena) {
+  arena_set_revert_point(arena);
+  buf_t dest = arena_push_buffer(arena, expected.size + 1);
+  test_zlib_check(buf_valid(dest));
+  dest.size = expected.size;
+
+  auto inflate = [&](buf_t d, buf_t s, usz_t* out_size) {
+    return is_raw ? zlib_inflate_raw(d, s, out_size) : zlib_inflate(d, s, out_size);
+  };
+
+  usz_t size = 0;
+  test_zlib_check(inflate(dest, stream, &size));
+  test_zlib_check(size == expected.size);
+  test_zlib_check(memory_is_same(dest.e, expected.e, expected.size));
+
+  // Extra room is fine
+  dest.size = expected.size + 1;
+  test_zlib_check(inflate(dest, stream, &size));
+  test_zlib_check(size == expected.size);
+
+  if (expected.size > 0) {
+    dest.size = expected.size - 1;
+    test_zlib_check(!inflate(dest, stream, &size));
+  }
+  dest.size = expected.size;
+
+  // Long streams get every few bytes, and all of their last ones
+  usz_t step = max_of(stream.size / 2048, (usz_t)1);
+  auto next = [&](usz_t i) { return i + 32 < stream.size ? i + step : i + 1; };
+
+  // Cut short. A zlib stream cut right before its trailer is let through.
+  for (usz_t cut = 0; cut < stream.size; cut = next(cut)) {
+    if (!is_raw && cut == stream.size - 4) continue;
+    test_zlib_check(!inflate(dest, buf_set(stream.e, cut), &size));
+  }
+
+  // Bit flips, which must not crash
+  buf_t corrupt = arena_push_buffer(arena, stream.size);
+  test_zlib_check(buf_valid(corrupt) || stream.size == 0);
+  for (usz_t i = 0; i < stream.size; i = next(i)) {
+    for (u32_t bit = 0; bit < 8; bit += 3) {
+      memory_copy(corrupt.e, stream.e, stream.size);
+      corrupt.e[i] ^= (u8_t)(1 << bit);
+      if (inflate(dest, corrupt, &size) && !is_raw && i >= stream.size - 4) {
+        // A flipped trailer can only be caught by the Adler-32
+        test_zlib_check(!"bad Adler-32 was let through");
+      }
+    }
+  }
+
+  return true;
+}
+
+static b32_t
+test_zlib_corpus(arena_t* arena) {
+  for_arr(case_index, test_zlib_cases) {
+    const test_zlib_case_t* c = test_zlib_cases + case_index;
+    arena_set_revert_point(arena);
+
+    buf_t expected = arena_push_buffer(arena, c->size + 1);
+    test_zlib_check(buf_valid(expected));
+    expected.size = c->size;
+    c->make(expected.e, c->size);
+
+    buf_t stream = buf_set((u8_t*)c->stream, c->stream_size);
+    if (!test_zlib_check_stream(stream, expected, false, arena)) {
+      printf("  in %s\n", c->name);
+      return false;
+    }
+
+    // The same without the zlib header and trailer
+    buf_t raw = buf_set(stream.e + 2, stream.size - 6);
+    if (!test_zlib_check_stream(raw, expected, true, arena)) {
+      printf("  in %s (raw)\n", c->name);
+      return false;
+    }
+    printf("corpus %-16s %6u -> %6u: OK\n", c->name, c->stream_size, c->size);
+  }
+  return true;
+}
+
+//
+// Writing streams by hand
+//
+static const u16_t test_zlib_len_bases[29] = {
+  3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+  35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+static const u8_t test_zlib_len_extra_bits[29] = {
+  0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+  3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+};
+static const u16_t test_zlib_dist_bases[30] = {
+  1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+  257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145,
+  8193, 12289, 16385, 24577
+};
+static const u8_t test_zlib_dist_extra_bits[30] = {
+  0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+  7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+};
+
+// Canonical Huffman codes from code lengths, as in RFC 1951 3.2.2
+struct test_zlib_code_t {
+  u8_t lengths[288];
+  u16_t codes[288];
+};
+
+static void
+test_zlib_code_init(test_zlib_code_t* c, const u8_t* lengths, u32_t count) {
+  memory_zero(c, sizeof(*c));
+  memory_copy(c->lengths, lengths, count);
+  u32_t counts[16] = {};
+  for (u32_t i = 0; i < count; ++i) ++counts[lengths[i]];
+  counts[0] = 0;
+  u32_t next[16] = {};
+  u32_t code = 0;
+  for (u32_t len = 1; len < 16; ++len) {
+    code = (code + counts[len - 1]) << 1;
+    next[len] = code;
+  }
+  for (u32_t i = 0; i < count; ++i) {
+    if (lengths[i]) c->codes[i] = (u16_t)next[lengths[i]]++;
+  }
+}
+
+static void
+test_zlib_fixed_codes(test_zlib_code_t* litlen, test_zlib_code_t* dist) {
+  u8_t lengths[288];
+  for (u32_t i = 0; i < 288; ++i) {
+    lengths[i] = i < 144 ? 8 : i < 256 ? 9 : i < 280 ? 7 : 8;
+  }
+  test_zlib_code_init(litlen, lengths, 288);
+  for (u32_t i = 0; i < 32; ++i) lengths[i] = 5;
+  test_zlib_code_init(dist, lengths, 32);
+}
+
+// @note: Keeps what the stream should decode to in 'expected'.
+struct test_zlib_writer_t {
+  u8_t* data;
+  usz_t size;
+  usz_t cap;
+  u64_t bits;
+  u32_t bit_count;
+
+  u8_t* expected;
+  usz_t expected_size;
+  usz_t expected_cap;
+};
+
+static void
+test_zlib_writer_init(test_zlib_writer_t* w, arena_t* arena, usz_t cap) {
+  memory_zero(w, sizeof(*w));
+  w->data = arena_push_arr(u8_t, arena, cap);
+  w->cap = cap;
+  w->expected = arena_push_arr(u8_t, arena, cap);
+  w->expected_cap = cap;
+  assert(w->data && w->expected);
+}
+
+static void
+test_zlib_put_bits(test_zlib_writer_t* w, u32_t value, u32_t bit_count) {
+  w->bits |= (u64_t)value << w->bit_count;
+  w->bit_count += bit_count;
+  while (w->bit_count >= 8) {
+    assert(w->size < w->cap);
+    w->data[w->size++] = (u8_t)w->bits;
+    w->bits >>= 8;
+    w->bit_count -= 8;
+  }
+}
+
+static void
+test_zlib_align(test_zlib_writer_t* w) {
+  if (w->bit_count) test_zlib_put_bits(w, 0, 8 - w->bit_count);
+}
+
+static void
+test_zlib_put_symbol(test_zlib_writer_t* w, test_zlib_code_t* c, u32_t symbol) {
+  u32_t len = c->lengths[symbol];
+  assert(len > 0);
+  // Huffman codes go out from their first bit
+  for (u32_t i = len; i > 0; --i) {
+    test_zlib_put_bits(w, (c->codes[symbol] >> (i - 1)) & 1, 1);
+  }
+}
+
+static void
+test_zlib_put_block_header(test_zlib_writer_t* w, u32_t is_final, u32_t type) {
+  test_zlib_put_bits(w, is_final, 1);
+  test_zlib_put_bits(w, type, 2);
+}
+
+static void
+test_zlib_put_stored(test_zlib_writer_t* w, u32_t is_final, const u8_t* bytes, u32_t size) {
+  test_zlib_put_block_header(w, is_final, 0);
+  test_zlib_align(w);
+  test_zlib_put_bits(w, size, 16);
+  test_zlib_put_bits(w, ~size & 0xFFFF, 16);
+  for (u32_t i = 0; i < size; ++i) {
+    test_zlib_put_bits(w, bytes[i], 8);
+    w->expected[w->expected_size++] = bytes[i];
+  }
+}
+
+static void
+test_zlib_put_literal(test_zlib_writer_t* w, test_zlib_code_t* litlen, u8_t byte) {
+  test_zlib_put_symbol(w, litlen, byte);
+  w->expected[w->expected_size++] = byte;
+}
+
+static void
+test_zlib_put_match(test_zlib_writer_t* w, test_zlib_code_t* litlen, test_zlib_code_t* dist_code, u32_t len, u32_t dist) {
+  // Use the last length code that fits, so that 258 gets its own code
+  for (s32_t i = 28; i >= 0; --i) {
+    u32_t base = test_zlib_len_bases[i];
+    u32_t extra_bits = test_zlib_len_extra_bits[i];
+    if (len >= base && len < base + (1u << extra_bits) && litlen->lengths[257 + i]) {
+      test_zlib_put_symbol(w, litlen, 257 + i);
+      test_zlib_put_bits(w, len - base, extra_bits);
+      break;
+    }
+  }
+  for (u32_t i = 0; i < 30; ++i) {
+    u32_t base = test_zlib_dist_bases[i];
+    u32_t extra_bits = test_zlib_dist_extra_bits[i];
+    if (dist >= base && dist < base + (1u << extra_bits)) {
+      test_zlib_put_symbol(w, dist_code, i);
+      test_zlib_put_bits(w, dist - base, extra_bits);
+      break;
+    }
+  }
+  assert(dist <= w->expected_size);
+  for (u32_t i = 0; i < len; ++i) {
+    w->expected[w->expected_size] = w->expected[w->expected_size - dist];
+    ++w->expected_size;
+  }
+}
+
+// @note: Sends the code lengths with a precode that gives every length
+// 0-15 a 4-bit code, so they can be written as they are.
+static void
+test_zlib_put_dynamic_header(test_zlib_writer_t* w, const u8_t* lengths, u32_t HLIT, u32_t HDIST) {
+  test_zlib_put_bits(w, HLIT - 257, 5);
+  test_zlib_put_bits(w, HDIST - 1, 5);
+  test_zlib_put_bits(w, 19 - 4, 4);
+  static const u8_t order[19] = {
+    16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15
+  };
+  for_arr(i, order) {
+    test_zlib_put_bits(w, order[i] < 16 ? 4 : 0, 3);
+  }
+  u8_t precode_lengths[19] = {};
+  for (u32_t i = 0; i < 16; ++i) precode_lengths[i] = 4;
+  test_zlib_code_t precode;
+  test_zlib_code_init(&precode, precode_lengths, 19);
+  for (u32_t i = 0; i < HLIT + HDIST; ++i) {
+    test_zlib_put_symbol(w, &precode, lengths[i]);
+  }
+}
+
+// Wraps the raw stream in a zlib header and trailer
+static buf_t
+test_zlib_wrap(test_zlib_writer_t* w, arena_t* arena) {
+  test_zlib_align(w);
+  buf_t ret = arena_push_buffer(arena, w->size + 6);
+  assert(buf_valid(ret));
+  ret.e[0] = 0x78;
+  ret.e[1] = 0x01;
+  memory_copy(ret.e + 2, w->data, w->size);
+  u32_t adler = adler32(w->expected, w->expected_size);
+  for (u32_t i = 0; i < 4; ++i) {
+    ret.e[2 + w->size + i] = (u8_t)(adler >> (24 - i * 8));
+  }
+  return ret;
+}
+
+static b32_t
+test_zlib_check_written(const char* name, test_zlib_writer_t* w, arena_t* arena) {
+  buf_t expected = buf_set(w->expected, w->expected_size);
+  buf_t zlib = test_zlib_wrap(w, arena);
+  if (!test_zlib_check_stream(zlib, expected, false, arena) ||
+      !test_zlib_check_stream(buf_set(w->data, w->size), expected, true, arena))
+  {
+    printf("  in %s\n", name);
+    return false;
+  }
+  printf("written %-15s %6u -> %6u: OK\n", name, (u32_t)zlib.size, (u32_t)w->expected_size);
+  return true;
+}
+
+static b32_t
+test_zlib_written(arena_t* arena) {
+  arena_set_revert_point(arena);
+  u8_t noise[32768];
+  test_zlib_make_noise(noise, sizeof(noise));
+  test_zlib_code_t fixed_litlen, fixed_dist;
+  test_zlib_fixed_codes(&fixed_litlen, &fixed_dist);
+
+  // Stored blocks, empty ones included, between fixed blocks, and
+  // matches that overlap themselves at every short distance
+  {
+    test_zlib_writer_t w;
+    test_zlib_writer_init(&w, arena, kilobytes(64));
+    test_zlib_put_stored(&w, 0, noise, 0);
+    test_zlib_put_stored(&w, 0, noise, 1000);
+    test_zlib_put_block_header(&w, 0, 1);
+    for (u32_t i = 0; i < 5; ++i) test_zlib_put_literal(&w, &fixed_litlen, "hello"[i]);
+    for (u32_t dist = 1; dist <= 40; ++dist) {
+      for (u32_t len = 3; len <= 258; len += 51) {
+        test_zlib_put_match(&w, &fixed_litlen, &fixed_dist, len, dist);
+        test_zlib_put_literal(&w, &fixed_litlen, (u8_t)(len + dist));
+      }
+    }
+    test_zlib_put_symbol(&w, &fixed_litlen, 256);
+    test_zlib_put_stored(&w, 0, noise + 1000, 0);
+    test_zlib_put_block_header(&w, 1, 1);
+    test_zlib_put_match(&w, &fixed_litlen, &fixed_dist, 258, 1);
+    test_zlib_put_symbol(&w, &fixed_litlen, 256);
+    if (!test_zlib_check_written("mixed", &w, arena)) return false;
+  }
+
+  // The farthest distance, and a final stored block
+  {
+    test_zlib_writer_t w;
+    test_zlib_writer_init(&w, arena, kilobytes(64));
+    test_zlib_put_stored(&w, 0, noise, sizeof(noise));
+    test_zlib_put_block_header(&w, 0, 1);
+    test_zlib_put_match(&w, &fixed_litlen, &fixed_dist, 258, 32768);
+    test_zlib_put_match(&w, &fixed_litlen, &fixed_dist, 3, 32768);
+    test_zlib_put_match(&w, &fixed_litlen, &fixed_dist, 258, 32768);
+    test_zlib_put_symbol(&w, &fixed_litlen, 256);
+    test_zlib_put_stored(&w, 1, (const u8_t*)"end", 3);
+    if (!test_zlib_check_written("far", &w, arena)) return false;
+  }
+
+  // Codes of every length up to 15 in both tables, so that both need
+  // subtables, with matches of every distance code in them
+  {
+    static const u16_t litlen_symbols[16] = {
+      'a', 257, 'b', 285, 'c', 264, 'd', 256, 265, 'e', 280, 'f', 284, 'g', 'h', 'z'
+    };
+    static const u16_t dist_symbols[16] = {
+      0, 29, 1, 28, 2, 27, 3, 26, 4, 20, 5, 10, 6, 9, 7, 8
+    };
+    u8_t lengths[286 + 30] = {};
+    for (u32_t i = 0; i < 16; ++i) {
+      lengths[litlen_symbols[i]] = (u8_t)min_of(i + 1, 15u);
+      lengths[286 + dist_symbols[i]] = (u8_t)min_of(i + 1, 15u);
+    }
+    test_zlib_code_t litlen, dist;
+    test_zlib_code_init(&litlen, lengths, 286);
+    test_zlib_code_init(&dist, lengths + 286, 30);
+
+    test_zlib_writer_t w;
+    test_zlib_writer_init(&w, arena, kilobytes(128));
+    test_zlib_put_stored(&w, 0, noise, sizeof(noise));
+    test_zlib_put_block_header(&w, 1, 2);
+    test_zlib_put_dynamic_header(&w, lengths, 286, 30);
+
+    static const u32_t match_lens[] = { 3, 10, 12, 130, 257, 258 };
+    for (u32_t i = 0; i < 16; ++i) {
+      u32_t code = dist_symbols[i];
+      u32_t far = test_zlib_dist_bases[code] + (1u << test_zlib_dist_extra_bits[code]) - 1;
+      for_arr(j, match_lens) {
+        test_zlib_put_match(&w, &litlen, &dist, match_lens[j], test_zlib_dist_bases[code]);
+        test_zlib_put_match(&w, &litlen, &dist, match_lens[j], far);
+        test_zlib_put_literal(&w, &litlen, "abcdefghz"[(i + j) % 9]);
+      }
+    }
+    test_zlib_put_symbol(&w, &litlen, 256);
+    if (!test_zlib_check_written("long codes", &w, arena)) return false;
+  }
+
+  return true;
+}
+
+//
+// Malformed streams
+//
+static b32_t
+test_zlib_bad(const char* name, buf_t stream, b32_t is_raw, arena_t* arena) {
+  arena_set_revert_point(arena);
+  buf_t dest = arena_push_buffer(arena, kilobytes(64));
+  usz_t size = 0;
+  b32_t ok = is_raw ? zlib_inflate_raw(dest, stream, &size) : zlib_inflate(dest, stream, &size);
+  if (ok) {
+    printf("FAILED: %s was let through\n", name);
+    return false;
+  }
+  return true;
+}
+
+static b32_t
+test_zlib_malformed(arena_t* arena) {
+  arena_set_revert_point(arena);
+  test_zlib_code_t fixed_litlen, fixed_dist;
+  test_zlib_fixed_codes(&fixed_litlen, &fixed_dist);
+  u8_t hello[] = { 'h', 'e', 'l', 'l', 'o' };
+
+#define test_zlib_bad_written(name, ...) do {                               \
+    test_zlib_writer_t w;                                                   \
+    test_zlib_writer_init(&w, arena, kilobytes(1));                         \
+    __VA_ARGS__;                                                            \
+    test_zlib_align(&w);                                                    \
+    if (!test_zlib_bad(name, buf_set(w.data, w.size), true, arena)) return false; \
+  } while(0)
+
+  test_zlib_bad_written("reserved block type", test_zlib_put_block_header(&w, 1, 3));
+  test_zlib_bad_written("stored block with bad NLEN", {
+    test_zlib_put_block_header(&w, 1, 0);
+    test_zlib_align(&w);
+    test_zlib_put_bits(&w, 5, 16);
+    test_zlib_put_bits(&w, 5, 16);
+    for_arr(i, hello) test_zlib_put_bits(&w, hello[i], 8);
+  });
+  test_zlib_bad_written("stored block longer than the input", {
+    test_zlib_put_block_header(&w, 1, 0);
+    test_zlib_align(&w);
+    test_zlib_put_bits(&w, 100, 16);
+    test_zlib_put_bits(&w, ~100u & 0xFFFF, 16);
+    for_arr(i, hello) test_zlib_put_bits(&w, hello[i], 8);
+  });
+  for (u32_t symbol = 286; symbol <= 287; ++symbol) {
+    test_zlib_bad_written("length symbol 286 or 287", {
+      test_zlib_put_block_header(&w, 1, 1);
+      test_zlib_put_literal(&w, &fixed_litlen, 'a');
+      test_zlib_put_symbol(&w, &fixed_litlen, symbol);
+      test_zlib_put_symbol(&w, &fixed_dist, 0);
+      test_zlib_put_symbol(&w, &fixed_litlen, 256);
+    });
+  }
+  for (u32_t symbol = 30; symbol <= 31; ++symbol) {
+    test_zlib_bad_written("distance symbol 30 or 31", {
+      test_zlib_put_block_header(&w, 1, 1);
+      test_zlib_put_literal(&w, &fixed_litlen, 'a');
+      test_zlib_put_symbol(&w, &fixed_litlen, 257);
+      test_zlib_put_symbol(&w, &fixed_dist, symbol);
+      test_zlib_put_symbol(&w, &fixed_litlen, 256);
+    });
+  }
+  test_zlib_bad_written("distance before the start", {
+    test_zlib_put_block_header(&w, 1, 1);
+    test_zlib_put_literal(&w, &fixed_litlen, 'a');
+    test_zlib_put_symbol(&w, &fixed_litlen, 257);
+    test_zlib_put_symbol(&w, &fixed_dist, 1);
+    test_zlib_put_symbol(&w, &fixed_litlen, 256);
+  });
+  test_zlib_bad_written("too many length codes", {
+    test_zlib_put_block_header(&w, 1, 2);
+    test_zlib_put_bits(&w, 30, 5);
+    test_zlib_put_bits(&w, 0, 5);
+    test_zlib_put_bits(&w, 0, 4);
+  });
+  test_zlib_bad_written("too many distance codes", {
+    test_zlib_put_block_header(&w, 1, 2);
+    test_zlib_put_bits(&w, 0, 5);
+    test_zlib_put_bits(&w, 30, 5);
+    test_zlib_put_bits(&w, 0, 4);
+  });
+  test_zlib_bad_written("over-subscribed precode", {
+    test_zlib_put_block_header(&w, 1, 2);
+    test_zlib_put_bits(&w, 0, 5);
+    test_zlib_put_bits(&w, 0, 5);
+    test_zlib_put_bits(&w, 15, 4);
+    for (u32_t i = 0; i < 19; ++i) test_zlib_put_bits(&w, 1, 3);
+    for (u32_t i = 0; i < 64; ++i) test_zlib_put_bits(&w, 0, 8);
+  });
+
+  // A precode where 0 is '0' and either 16 or 18 is '1'
+  u8_t precode_lengths[19] = {};
+  test_zlib_code_t precode;
+  auto put_precode_header = [&](test_zlib_writer_t* w, u32_t repeat_symbol) {
+    test_zlib_put_block_header(w, 1, 2);
+    test_zlib_put_bits(w, 0, 5);
+    test_zlib_put_bits(w, 0, 5);
+    test_zlib_put_bits(w, 15, 4);
+    memory_zero(precode_lengths, sizeof(precode_lengths));
+    precode_lengths[0] = 1;
+    precode_lengths[repeat_symbol] = 1;
+    static const u8_t order[19] = {
+      16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15
+    };
+    for_arr(i, order) test_zlib_put_bits(w, precode_lengths[order[i]], 3);
+    test_zlib_code_init(&precode, precode_lengths, 19);
+  };
+  test_zlib_bad_written("repeat with nothing before it", {
+    put_precode_header(&w, 16);
+    test_zlib_put_symbol(&w, &precode, 16);
+    test_zlib_put_bits(&w, 0, 2);
+  });
+  test_zlib_bad_written("repeat past the last length", {
+    put_precode_header(&w, 18);
+    for (u32_t i = 0; i < 3; ++i) {
+      test_zlib_put_symbol(&w, &precode, 18);
+      test_zlib_put_bits(&w, 127, 7);
+    }
+  });
+  test_zlib_bad_written("no end of block code", {
+    // 138 + 120 zeros for 257 literal/length codes and 1 distance code
+    put_precode_header(&w, 18);
+    test_zlib_put_symbol(&w, &precode, 18);
+    test_zlib_put_bits(&w, 127, 7);
+    test_zlib_put_symbol(&w, &precode, 18);
+    test_zlib_put_bits(&w, 109, 7);
+    for (u32_t i = 0; i < 64; ++i) test_zlib_put_bits(&w, 0, 8);
+  });
+  test_zlib_bad_written("over-subscribed literal/length code", {
+    u8_t lengths[257 + 1];
+    for_arr(i, lengths) lengths[i] = 1;
+    test_zlib_put_block_header(&w, 1, 2);
+    test_zlib_put_dynamic_header(&w, lengths, 257, 1);
+    for (u32_t i = 0; i < 64; ++i) test_zlib_put_bits(&w, 0, 8);
+  });
+  test_zlib_bad_written("no final block", {
+    test_zlib_put_stored(&w, 0, hello, sizeof(hello));
+  });
+#undef test_zlib_bad_written
+
+  // zlib headers, each followed by a valid empty stream
+  static const u8_t bad_headers[][2] = {
+    { 0x79, 0x18 }, // CM is not 8
+    { 0x88, 0x1C }, // 64KB window
+    { 0x78, 0x02 }, // FCHECK is wrong
+    { 0x78, 0xBB }, // FDICT is set
+  };
+  for_arr(i, bad_headers) {
+    u8_t stream[] = { bad_headers[i][0], bad_headers[i][1], 0x03, 0x00, 0x00, 0x00, 0x00, 0x01 };
+    test_zlib_check((((stream[0] << 8) | stream[1]) % 31 == 0) == (i != 2));
+    if (!test_zlib_bad("bad zlib header", buf_set(stream, sizeof(stream)), false, arena)) return false;
+  }
+  u8_t good[] = { 0x78, 0x9C, 0x03, 0x00, 0x00, 0x00, 0x00, 0x01 };
+  usz_t size = 1;
+  test_zlib_check(zlib_inflate(buf_set(nullptr, 0), buf_set(good, sizeof(good)), &size) && size == 0);
+  good[7] = 0x02;
+  if (!test_zlib_bad("wrong Adler-32", buf_set(good, sizeof(good)), false, arena)) return false;
+  if (!test_zlib_bad("one byte", buf_set(good, 1), false, arena)) return false;
+
+  printf("malformed streams: OK\n");
+  return true;
+}
+
+//
+// Adler-32
+//
+static b32_t
+test_zlib_adler32(arena_t* arena) {
+  arena_set_revert_point(arena);
+  test_zlib_check(adler32(nullptr, 0) == 1);
+  test_zlib_check(adler32("Wikipedia", 9) == 0x11E60398);
+
+  // All 0xFF is the worst case for the deferred modulo
+  u32_t size = 100000;
+  u8_t* data = arena_push_arr(u8_t, arena, size);
+  test_zlib_check(data);
+  for (u32_t i = 0; i < size; ++i) data[i] = 0xFF;
+  u32_t a = 1, b = 0;
+  for (u32_t i = 0; i < size; ++i) {
+    a = (a + data[i]) % 65521;
+    b = (b + a) % 65521;
+  }
+  test_zlib_check(adler32(data, size) == ((b << 16) | a));
+  u32_t piece = adler32(data, 7777);
+  test_zlib_check(adler32(data + 7777, size - 7777, piece) == ((b << 16) | a));
+
+  printf("adler32: OK\n");
+  return true;
+}
+
+//
+// Deflating
+//
+
+// @note: Every level must give a stream that inflates back to the input,
+// and the same stream with a job system as without. Small streams also go
+// through test_zlib_check_stream().
+static b32_t
+test_zlib_deflate_one(buf_t src, u32_t level, job_system_t* js, arena_t* arena) {
+  arena_set_revert_point(arena);
+  usz_t bound = zlib_deflate_bound(src.size);
+  buf_t stream = arena_push_buffer(arena, bound);
+  buf_t js_stream = arena_push_buffer(arena, bound);
+  buf_t dest = arena_push_buffer(arena, src.size + 1);
+  test_zlib_check(buf_valid(stream) && buf_valid(js_stream) && buf_valid(dest));
+
+  usz_t size = 0;
+  test_zlib_check(zlib_deflate(stream, src, level, arena, &size));
+  test_zlib_check(size <= bound);
+  stream.size = size;
+
+  usz_t js_size = 0;
+  test_zlib_check(zlib_deflate(js_stream, src, level, arena, &js_size, js));
+  test_zlib_check(js_size == size);
+  test_zlib_check(memory_is_same(js_stream.e, stream.e, size));
+
+  usz_t out_size = 0;
+  test_zlib_check(zlib_inflate(buf_set(dest.e, src.size), stream, &out_size));
+  test_zlib_check(out_size == src.size);
+  test_zlib_check(memory_is_same(dest.e, src.e, src.size));
+  if (src.size <= 4096 && (level == 0 || level == 1 || level == 6 || level == 9)) {
+    if (!test_zlib_check_stream(stream, src, false, arena)) return false;
+  }
+
+  // 'dest' must have room for the worst case
+  test_zlib_check(!zlib_deflate(buf_set(stream.e, bound - 1), src, level, arena, &size));
+  return true;
+}
+
+static b32_t
+test_zlib_deflate(job_system_t* js, arena_t* arena) {
+  struct {
+    const char* name;
+    test_zlib_make_f* make;
+  } makers[] = {
+    { "text", test_zlib_make_text },
+    { "skewed", test_zlib_make_skewed },
+    { "noise", test_zlib_make_noise },
+    { "zeros", test_zlib_make_zeros },
+  };
+  // Around the edges of matches, blocks and chunks
+  static const u32_t sizes[] = {
+    0, 1, 2, 3, 4, 5, 258, 300, 4096, 70000, kilobytes(256), kilobytes(256) + 1, kilobytes(700),
+  };
+  for_arr(maker_index, makers) {
+    for_arr(size_index, sizes) {
+      arena_set_revert_point(arena);
+      u32_t size = sizes[size_index];
+      buf_t src = arena_push_buffer(arena, size + 1);
+      test_zlib_check(buf_valid(src));
+      src.size = size;
+      makers[maker_index].make(src.e, size);
+      for (u32_t level = 0; level <= 9; ++level) {
+        if (!test_zlib_deflate_one(src, level, js, arena)) {
+          printf("  in %s, %u bytes, level %u\n", makers[maker_index].name, size, level);
+          return false;
+        }
+      }
+    }
+    printf("zlib_deflate %-10s: OK\n", makers[maker_index].name);
+  }
+
+  // The disc, and the longest matches and farthest distances there are
+  {
+    arena_set_revert_point(arena);
+    u32_t size = kilobytes(200);
+    buf_t src = arena_push_buffer(arena, size);
+    test_zlib_check(buf_valid(src));
+    test_zlib_make_pixels(src.e, 4096);
+    test_zlib_make_noise(src.e + 4096, 32768);
+    memory_copy(src.e + 4096 + 32768, src.e + 4096, 32768);
+    for (u32_t i = 4096 + 65536; i < size; ++i) src.e[i] = src.e[i - 32767];
+    for (u32_t level = 0; level <= 9; ++level) {
+      test_zlib_check(test_zlib_deflate_one(buf_set(src.e, 4096), level, js, arena));
+      test_zlib_check(test_zlib_deflate_one(src, level, js, arena));
+    }
+  }
+
+  test_zlib_check(!zlib_deflate(buf_set(nullptr, 0), buf_set(nullptr, 0), 6, arena));
+  u8_t dest[64];
+  test_zlib_check(!zlib_deflate(buf_set(dest, sizeof(dest)), buf_set(nullptr, 0), 10, arena));
+  printf("zlib_deflate: OK\n");
+  return true;
+}
+
+//
+// PNGs
+//
+static b32_t
+test_zlib_png_round_trip(arena_t* arena) {
+  arena_set_revert_point(arena);
+
+  // Tall enough for several stored blocks
+  u32_t w = 173, h = 301;
+  u32_t* pixels = arena_push_arr(u32_t, arena, w * h);
+  test_zlib_check(pixels);
+  test_zlib_make_noise((u8_t*)pixels, w * h * 4);
+
+  buf_t file = png_write(pixels, w, h, arena);
+  test_zlib_check(buf_valid(file));
+  png_t png;
+  test_zlib_check(png_read(&png, file));
+  u32_t out_w = 0, out_h = 0;
+  u32_t* out = png_rasterize(&png, &out_w, &out_h, arena);
+  test_zlib_check(out && out_w == w && out_h == h);
+  test_zlib_check(memory_is_same(out, pixels, w * h * 4));
+
+  printf("png_write round trip: OK\n");
+  return true;
+}
+
+// Concatenates the IDAT chunks of a PNG
+static buf_t
+test_zlib_png_idat(buf_t file, arena_t* arena) {
+  usz_t size = 0;
+  for (u32_t pass = 0; pass < 2; ++pass) {
+    buf_t ret = {};
+    if (pass == 1) {
+      ret = arena_push_buffer(arena, size);
+      if (!buf_valid(ret)) return buf_bad();
+    }
+    usz_t pos = 8;
+    size = 0;
+    while (pos + 12 <= file.size) {
+      u32_t length = u32_endian_swap(_memory_load_u32(file.e + pos));
+      u32_t type = u32_endian_swap(_memory_load_u32(file.e + pos + 4));
+      if (pos + 12 + length > file.size) return buf_bad();
+      if (type == 'IDAT') {
+        if (pass == 1) memory_copy(ret.e + size, file.e + pos + 8, length);
+        size += length;
+      }
+      pos += 12 + length;
+    }
+    if (pass == 1) return ret;
+  }
+  return buf_bad();
+}
+
+//
+// What PNG loading used before, for the benchmark
+//
+struct test_zlib_old_huffman_t {
+  u16_t* symbols;
+  u32_t symbol_count;
+  u16_t* lengths;
+  u32_t length_count;
+};
+
+static s32_t
+test_zlib_old_huffman_decode(stream_t* src_stream, test_zlib_old_huffman_t huffman) {
+  s32_t code = 0;
+  s32_t first = 0;
+  s32_t index = 0;
+  for (u32_t len = 1; len <= huffman.length_count - 1; ++len) {
+    u32_t bits = stream_consume_bits(src_stream, 1);
+    code |= bits;
+    s32_t count = huffman.lengths[len];
+    if(code - count < first) {
+      return huffman.symbols[index + (code - first)];
+    }
+    index += count;
+    first += count;
+    first <<= 1;
+    code <<= 1;
+  }
+  return -1;
+}
+
+static void
+test_zlib_old_huffman_compute(test_zlib_old_huffman_t* h, arena_t* arena, u16_t* codes, u32_t codes_size, u32_t max_lengths) {
+  h->symbol_count = codes_size;
+  h->symbols = arena_push_arr(u16_t, arena, codes_size);
+  memory_zero(h->symbols, h->symbol_count * sizeof(u16_t));
+  h->length_count = max_lengths + 1;
+  h->lengths = arena_push_arr(u16_t, arena, max_lengths + 1);
+  memory_zero(h->lengths, h->length_count * sizeof(u16_t));
+  for (u32_t sym = 0; sym < codes_size; ++sym)  {
+    ++h->lengths[codes[sym]];
+  }
+  arena_marker_t mark = arena_mark(arena);
+  u16_t* len_offset_table = arena_push_arr(u16_t, arena, max_lengths+1);
+  memory_zero(len_offset_table, (max_lengths+1) * sizeof(u16_t));
+  for (u32_t len = 1; len < max_lengths; ++len) {
+    len_offset_table[len+1] = len_offset_table[len] + h->lengths[len];
+  }
+  for (u32_t sym = 0; sym < codes_size; ++sym) {
+    u16_t len = codes[sym];
+    if (len > 0) {
+      u16_t code = len_offset_table[len]++;
+      h->symbols[code] = (u16_t)sym;
+    }
+  }
+  arena_revert(mark);
+}
+
+// @note: Only handles what it did then, so no stored blocks
+static b32_t
+test_zlib_old_inflate(stream_t* src_stream, stream_t* dest_stream, arena_t* arena) {
+  u8_t BFINAL = 0;
+  while(BFINAL == 0){
+    arena_set_revert_point(arena);
+    BFINAL = (u8_t)stream_consume_bits(src_stream, 1);
+    u16_t BTYPE = (u8_t)stream_consume_bits(src_stream, 2);
+    if (BTYPE != 0b01 && BTYPE != 0b10) return false;
+
+    test_zlib_old_huffman_t lit_huffman = {};
+    test_zlib_old_huffman_t dist_huffman = {};
+    if (BTYPE == 0b01) {
+      u16_t lit_codes[288] = {};
+      u16_t dist_codes[32] = {};
+      u32_t lit = 0;
+      for (; lit < 144; ++lit) lit_codes[lit] = 8;
+      for (; lit < 256; ++lit) lit_codes[lit] = 9;
+      for (; lit < 280; ++lit) lit_codes[lit] = 7;
+      for (; lit < array_count(lit_codes); ++lit) lit_codes[lit] = 8;
+      for (lit = 0; lit < array_count(dist_codes); ++lit) dist_codes[lit] = 5;
+      test_zlib_old_huffman_compute(&lit_huffman, arena, lit_codes, array_count(lit_codes), 15);
+      test_zlib_old_huffman_compute(&dist_huffman, arena, dist_codes, array_count(dist_codes), 15);
+    }
+    else {
+      u32_t HLIT = stream_consume_bits(src_stream, 5) + 257;
+      u32_t HDIST = stream_consume_bits(src_stream, 5) + 1;
+      u32_t HCLEN = stream_consume_bits(src_stream, 4) + 4;
+      static const u32_t order[] = {
+        16, 17, 18, 0, 8 ,7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15,
+      };
+      u16_t code_codes[19] = {};
+      for(u32_t i = 0; i < HCLEN; ++i) {
+        code_codes[order[i]] = (u16_t)stream_consume_bits(src_stream, 3);
+      }
+      test_zlib_old_huffman_t code_huffman = {};
+      test_zlib_old_huffman_compute(&code_huffman, arena, code_codes, array_count(code_codes), 15);
+      u16_t* lit_dist_codes = arena_push_arr(u16_t, arena, HDIST + HLIT);
+      for(u32_t i = 0; i < (HDIST + HLIT);) {
+        s32_t sym = test_zlib_old_huffman_decode(src_stream, code_huffman);
+        if(sym >= 0 && sym <= 15) {
+          lit_dist_codes[i++] = (u16_t)sym;
+        }
+        else {
+          u32_t times_to_repeat = 0;
+          u16_t code_to_repeat = 0;
+          if (sym == 16) {
+            if (i == 0) return false;
+            times_to_repeat = 3 + stream_consume_bits(src_stream, 2);
+            code_to_repeat = lit_dist_codes[i-1];
+          }
+          else if (sym == 17) {
+            times_to_repeat = 3 + stream_consume_bits(src_stream, 3);
+          }
+          else if (sym == 18) {
+            times_to_repeat = 11 + stream_consume_bits(src_stream, 7);
+          }
+          else {
+            return false;
+          }
+          while(times_to_repeat--) {
+            lit_dist_codes[i++] = code_to_repeat;
+          }
+        }
+      }
+      test_zlib_old_huffman_compute(&lit_huffman, arena, lit_dist_codes, HLIT, 15);
+      test_zlib_old_huffman_compute(&dist_huffman, arena, lit_dist_codes + HLIT, HDIST, 15);
+    }
+
+    for (;;) {
+      s32_t sym = test_zlib_old_huffman_decode(src_stream, lit_huffman);
+      if (sym >= 0 && sym <= 255) {
+        u8_t byte_to_write = (u8_t)(sym & 0xFF);
+        stream_write(dest_stream, byte_to_write);
+      }
+      else if (sym >= 257) {
+        sym -= 257;
+        if (sym >= 29) return false;
+        u32_t len = test_zlib_len_bases[sym];
+        if (test_zlib_len_extra_bits[sym]) len += stream_consume_bits(src_stream, test_zlib_len_extra_bits[sym]);
+        sym = test_zlib_old_huffman_decode(src_stream, dist_huffman);
+        if (sym < 0) return false;
+        u32_t dist = test_zlib_dist_bases[sym];
+        if (test_zlib_dist_extra_bits[sym]) dist += stream_consume_bits(src_stream, test_zlib_dist_extra_bits[sym]);
+        while(len--) {
+          usz_t target_index = dest_stream->pos - dist;
+          u8_t byte_to_write = dest_stream->contents.e[target_index];
+          stream_write(dest_stream, byte_to_write);
+        }
+      }
+      else if (sym == 256) {
+        break;
+      }
+      else {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+//
+// Benchmark
+//
+struct test_zlib_bench_t {
+  const char* name;
+  buf_t stream;
+  usz_t size;
+};
+
+static f64_t
+test_zlib_seconds(u64_t start, u64_t end) {
+  return (f64_t)(end - start) / clock_resolution();
+}
+
+static b32_t
+test_zlib_bench(test_zlib_bench_t* benches, u32_t bench_count, arena_t* arena) {
+  printf("\n%-24s %10s %12s %12s %8s\n", "", "size", "zlib_inflate", "old", "speedup");
+  for (u32_t bench_index = 0; bench_index < bench_count; ++bench_index) {
+    test_zlib_bench_t* b = benches + bench_index;
+    arena_set_revert_point(arena);
+    buf_t dest = arena_push_buffer(arena, b->size + 1);
+    buf_t old_dest = arena_push_buffer(arena, b->size + 1);
+    test_zlib_check(buf_valid(dest) && buf_valid(old_dest));
+    dest.size = old_dest.size = b->size;
+
+    // Enough rounds to take a while
+    u32_t rounds = (u32_t)clamp_of(megabytes(256) / (b->size + 1), (usz_t)1, (usz_t)10000);
+
+    u64_t start = clock_time();
+    for (u32_t i = 0; i < rounds; ++i) {
+      usz_t size = 0;
+      test_zlib_check(zlib_inflate(dest, b->stream, &size) && size == b->size);
+    }
+    f64_t secs = test_zlib_seconds(start, clock_time());
+    f64_t mbps = (f64_t)b->size * rounds / secs / (1024.0 * 1024.0);
+
+    // The old decoder is slow, so it gets fewer rounds
+    u32_t old_rounds = max_of(rounds / 16, 1u);
+    b32_t is_old_ok = true;
+    start = clock_time();
+    for (u32_t i = 0; i < old_rounds && is_old_ok; ++i) {
+      stream_t src, out;
+      stream_init(&src, buf_set(b->stream.e + 2, b->stream.size - 2));
+      stream_init(&out, old_dest);
+      is_old_ok = test_zlib_old_inflate(&src, &out, arena) && out.pos == b->size;
+    }
+    f64_t old_secs = test_zlib_seconds(start, clock_time());
+    if (is_old_ok) {
+      test_zlib_check(memory_is_same(dest.e, old_dest.e, b->size));
+      f64_t old_mbps = (f64_t)b->size * old_rounds / old_secs / (1024.0 * 1024.0);
+      // An empty stream has no throughput to compare
+      if (b->size > 0) 
+        printf("%-24s %10u %7.1f MB/s %7.1f MB/s %7.1fx\n", b->name, (u32_t)b->size, mbps, old_mbps, mbps / old_mbps);
+      else 
+        printf("%-24s %10u %7.1f MB/s %7.1f MB/s %8s\n", b->name, (u32_t)b->size, mbps, old_mbps, "n/a");
+    }
+    else {
+      printf("%-24s %10u %7.1f MB/s %12s\n", b->name, (u32_t)b->size, mbps, "n/a");
+    }
+  }
+  return true;
+}
+
+int main(int argc, char** argv) {
+  arena_t arena = {};
+  if (!arena_alloc(&arena, megabytes(512))) {
+    printf("Failed to allocate arena\n");
+    return 1;
+  }
+  defer { arena_free(&arena); };
+
+  if (!test_zlib_adler32(&arena)) return 1;
+  if (!test_zlib_corpus(&arena)) return 1;
+  if (!test_zlib_written(&arena)) return 1;
+  if (!test_zlib_malformed(&arena)) return 1;
+
+  job_system_t js = {};
+  if (!job_system_init(&js, 3, 256, &arena)) {
+    printf("Failed to start the job system\n");
+    return 1;
+  }
+  defer { job_system_free(&js); };
+  if (!test_zlib_deflate(&js, &arena)) return 1;
+  if (!test_zlib_png_round_trip(&arena)) return 1;
+
+  // PNGs on the command line must decode, and are what gets benchmarked
+  test_zlib_bench_t benches[64];
+  u32_t bench_count = 0;
+  for (s32_t i = 1; i < argc && bench_count < array_count(benches); ++i) {
+    buf_t file = file_read_into_buffer(argv[i], &arena);
+    png_t png;
+    if (!buf_valid(file) || !png_read(&png, file)) {
+      printf("FAILED: cannot read %s as a PNG\n", argv[i]);
+      return 1;
+    }
+    u32_t w = 0, h = 0;
+    if (!png_rasterize(&png, &w, &h, &arena)) {
+      printf("FAILED: cannot decode %s\n", argv[i]);
+      return 1;
+    }
+    printf("%s (%ux%u): OK\n", argv[i], w, h);
+
+    test_zlib_bench_t* b = benches + bench_count++;
+    b->name = argv[i];
+    b->stream = test_zlib_png_idat(file, &arena);
+    b->size = (usz_t)(w * 4 + 1) * h;
+  }
+  if (bench_count == 0) {
+    for_arr(i, test_zlib_cases) {
+      test_zlib_bench_t* b = benches + bench_count++;
+      b->name = test_zlib_cases[i].name;
+      b->stream = buf_set((u8_t*)test_zlib_cases[i].stream, test_zlib_cases[i].stream_size);
+      b->size = test_zlib_cases[i].size;
+    }
+  }
+  if (!test_zlib_bench(benches, bench_count, &arena)) return 1;
+
+  return 0;
+}
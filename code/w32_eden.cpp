@@ -39,25 +39,6 @@
 #pragma comment(lib, "ole32.lib")
 #pragma comment(lib, "imm32.lib")
 
-//
-// MARK:(Work Queue)
-//
-struct w32_work_t {
-  void* data;
-  eden_task_callback_f* callback;
-};
-
-struct w32_work_queue_t {
-  u32_t entry_cap;
-  w32_work_t entries[256];
-  u32_t volatile next_entry_to_read;
-  u32_t volatile next_entry_to_write;
-  
-  u32_t volatile completion_count;
-  u32_t volatile completion_goal;
-  HANDLE semaphore; 
-};
-
 //
 // MARK:(Hot Reload)
 //
@@ -98,7 +79,10 @@ struct w32_state_t {
   POINT cursor_pt_to_lock_to;
   
   
-  w32_work_queue_t work_queue;
+  // @note: eden's tasks are run on momo's job system. 
+  // Only the main thread adds tasks, so one counter is enough.
+  job_system_t jobs;
+  job_counter_t task_counter;
   
   HWND window;
 
@@ -223,121 +207,6 @@ w32_get_file_last_write_time(const char* filename) {
   return w32_file_time_to_large_integer(last_write_time); 
 }
 
-// @note: This function is accessed by multiple threads!
-static b32_t
-w32_do_next_work_entry(w32_work_queue_t* wq) {
-  b32_t should_sleep = false;
-  
-  // @note: Generally, we want to do: 
-  // 1. Get index of next work to do
-  // 2. Update index of next work to do
-  // 3. Do work
-  // 
-  // HOWEVER, the thread that is running this
-  // function might go into coma at ANY TIME 
-  // between these steps, that's why we need to do 
-  // the way we are doing below. 
-  //
-  // ONLY when this thread successfully updated the work 
-  // queue's next-work index to the value that this thread
-  // THINKS it should be updated to, THEN we do the work.
-  
-  u32_t old_next_entry_to_read = wq->next_entry_to_read;
-  u32_t new_next_entry_to_read = (old_next_entry_to_read + 1) % array_count(wq->entries);
-  
-  if (old_next_entry_to_read != wq->next_entry_to_write) {
-    DWORD initial_value = 
-      InterlockedCompareExchange((LONG volatile*)&wq->next_entry_to_read,
-                                 new_next_entry_to_read,
-                                 old_next_entry_to_read);
-    if (initial_value == old_next_entry_to_read) {
-      w32_work_t work = wq->entries[old_next_entry_to_read];
-      work.callback(work.data);
-      InterlockedIncrement((LONG volatile*)&wq->completion_count);
-    }
-    
-  }
-  else {
-    should_sleep = true;
-  }
-  return should_sleep;
-}
-
-// @note: This makes the main thread
-// participate in the work queue.
-//
-// In some sense, calling this will simulate 'async' 
-// feature in modern languages, where we 'wait' until all
-// work in the work queue is done!
-//
-static void
-w32_complete_all_tasks_entries(w32_work_queue_t* wq) {
-  while(wq->completion_goal != wq->completion_count) {
-    w32_do_next_work_entry(wq);
-  }
-  wq->completion_goal = 0;
-  wq->completion_count = 0;
-}
-
-
-
-static DWORD WINAPI 
-w32_worker_func(LPVOID ctx) {
-  w32_work_queue_t* wq = (w32_work_queue_t*)ctx;
-  
-  while(true) {
-    if (w32_do_next_work_entry(wq)){
-      WaitForSingleObjectEx(wq->semaphore, INFINITE, FALSE);
-    }
-    
-  }
-}
-
-
-static b32_t
-w32_init_work_queue(w32_work_queue_t* wq, u32_t thread_count) {
-  wq->semaphore = CreateSemaphoreEx(0,
-                                    0,                                
-                                    thread_count,
-                                    0, 0, SEMAPHORE_ALL_ACCESS);
-  
-  if (wq->semaphore == NULL) return false;
-  
-  for (u32_t i = 0; i < thread_count; ++i) {
-    DWORD thread_id;
-    HANDLE thread = CreateThread(NULL, 0, 
-                                 w32_worker_func, 
-                                 wq, 
-                                 0, //CREATE_SUSPENDED, 
-                                 &thread_id);
-    if (thread == NULL) {
-      return false;
-    }
-    CloseHandle(thread);
-  }
-  
-  return true;
-}
-
-// @note: This is not very thread safe. Other threads shouldn't call this.
-static void
-w32_add_task_entry(w32_work_queue_t* wq, void (*callback)(void* ctx), void *data) {
-  u32_t old_next_entry_to_write = wq->next_entry_to_write;
-  u32_t new_next_entry_to_write = (old_next_entry_to_write + 1) % array_count(wq->entries);
-  assert(wq->next_entry_to_read != new_next_entry_to_write);  
-  
-  w32_work_t* entry = wq->entries + old_next_entry_to_write;
-  entry->callback = callback;
-  entry->data = data;
-  ++wq->completion_goal;
-  
-  _ReadWriteBarrier();
-  
-  wq->next_entry_to_write = new_next_entry_to_write; // this MUST not be reordered
-  ReleaseSemaphore(wq->semaphore, 1, 0);
-}
-
-
 static void 
 w32_shutdown() {
   w32_state->is_running = false;
@@ -633,19 +502,43 @@ w32_window_callback(HWND window,
 static 
 eden_add_task_sig(w32_add_task)
 {
-  w32_add_task_entry(&w32_state->work_queue, callback, data);
+  job_add(&w32_state->jobs, callback, data, &w32_state->task_counter);
 }
 
 static 
 eden_complete_all_tasks_sig(w32_complete_all_tasks) 
 {
-  w32_complete_all_tasks_entries(&w32_state->work_queue);
+  // @note: This makes the main thread participate in the work
+  // until every task added so far is done.
+  job_wait(&w32_state->jobs, &w32_state->task_counter);
 }
 
 
 //
 // Entry Point
 //
+// @note: Splits the command line on spaces in place. 
+// There's no support for quotes; we don't need them yet.
+static u32_t
+w32_split_command_line(char* command_line, char** args, u32_t max_args) 
+{
+  u32_t arg_count = 0;
+  char* itr = command_line;
+  while(*itr && arg_count < max_args) {
+    while(*itr == ' ') *itr++ = 0;
+    if (!*itr) break;
+    args[arg_count++] = itr;
+    while(*itr && *itr != ' ') ++itr;
+  }
+  return arg_count;
+}
+
+static b32_t
+w32_is_arg(const char* arg, const char* name) 
+{
+  return cstr_len(arg) == cstr_len(name) && cstr_compare(arg, name);
+}
+
 int CALLBACK
 WinMain(HINSTANCE instance, 
         HINSTANCE prev_instance, 
@@ -667,6 +560,30 @@ WinMain(HINSTANCE instance,
     w32_state->eden_height = 1.f;  
   }
   arena_t* platform_arena = &w32_state->arena;
+
+  //
+  // Command line
+  //
+  // -record <file>: records every frame's input into <file> on exit
+  // -play <file>:   replays the input in <file> as fast as possible, 
+  //                 then exits
+  // -trace <file>:  writes the last frames as a Chrome trace on exit
+  //
+  const char* record_filename = nullptr;
+  const char* play_filename = nullptr;
+  const char* trace_filename = nullptr;
+  {
+    char* args[16];
+    u32_t arg_count = w32_split_command_line(command_line, args, array_count(args));
+    for (u32_t arg_index = 0; arg_index + 1 < arg_count; ++arg_index) {
+      if (w32_is_arg(args[arg_index], "-record")) 
+        record_filename = args[++arg_index];
+      else if (w32_is_arg(args[arg_index], "-play")) 
+        play_filename = args[++arg_index];
+      else if (w32_is_arg(args[arg_index], "-trace")) 
+        trace_filename = args[++arg_index];
+    }
+  }
   
 
   //
@@ -692,6 +609,8 @@ WinMain(HINSTANCE instance,
   eden_config_t config = eden_functions.get_config();
 
   eden_t* eden = arena_push_zero(eden_t, &w32_state->arena);
+  // @note: the gfx backend profiles itself through the global
+  eden_globalize(eden);
   eden->is_running = true;
   eden->show_cursor = w32_show_cursor;
   eden->lock_cursor = w32_lock_cursor;
@@ -702,10 +621,14 @@ WinMain(HINSTANCE instance,
   eden->complete_all_tasks = w32_complete_all_tasks;
   eden->set_design_dimensions = w32_set_eden_dims;
 
-  if (!w32_init_work_queue(&w32_state->work_queue, config.max_workers)) {
-    w32_log("Cannot create worker queue");
+  // @note: The main thread is a worker too, and there is no point
+  // having more workers than there are cores.
+  u32_t worker_count = min_of(config.max_workers, thread_get_hardware_count() - 1);
+  if (!job_system_init(&w32_state->jobs, worker_count, 1024, platform_arena)) {
+    w32_log("Cannot create job system");
     return 1;
   }
+  defer { job_system_free(&w32_state->jobs); };
 
   //
   // Create window in the middle of the screen
@@ -789,7 +712,8 @@ WinMain(HINSTANCE instance,
       config.max_commands,
       config.max_textures,
       config.max_texture_payloads,
-      config.max_elements))
+      config.max_elements,
+      config.gfx_frames_in_flight))
   {
     w32_log("Cannot load gfx");
     return 1;
@@ -833,7 +757,9 @@ WinMain(HINSTANCE instance,
         &eden->profiler, 
         platform_arena, 
         config.profiler_max_entries, 
-        config.profiler_max_snapshots_per_entry))
+        config.profiler_max_snapshots_per_entry,
+        config.profiler_max_threads,
+        config.profiler_max_events_per_thread))
   {
     w32_log("Cannot init profiler");
     return 1;
@@ -847,9 +773,41 @@ WinMain(HINSTANCE instance,
     w32_log("Cannot init inspector");
     return 1;
   }
+
+  defer {
+    if (trace_filename && !eden_profiler_export_trace(&eden->profiler, trace_filename, platform_arena))
+      w32_log("Cannot write trace to %s\n", trace_filename);
+  };
 #endif // EDEN_DEBUG
 
 
+  //
+  // Input recording
+  //
+  eden_input_recorder_t recorder = {};
+  if (record_filename) {
+    buf_t memory = arena_push_buffer(platform_arena, megabytes(64), 16);
+    if (!buf_valid(memory)) {
+      w32_log("Cannot allocate input recording");
+      return 1;
+    }
+    eden_input_recorder_init(&recorder, memory);
+  }
+  defer {
+    if (record_filename && !eden_input_recorder_save(&recorder, record_filename)) 
+      w32_log("Cannot save input recording to %s\n", record_filename);
+  };
+
+  eden_input_player_t player = {};
+  eden_input_t scratch_input = {};
+  if (play_filename) {
+    if (!eden_input_player_load(&player, play_filename, platform_arena)) {
+      w32_log("Cannot load input recording from %s\n", play_filename);
+      return 1;
+    }
+  }
+
+
   //
   // Game setup
   //
@@ -869,6 +827,8 @@ WinMain(HINSTANCE instance,
 #if EDEN_DEBUG
     if (eden->is_dll_reloaded) {
       eden_profiler_reset(&eden->profiler);
+      // @note: the old dll's block names are gone
+      eden_profiler_clear_trace(&eden->profiler);
     }
 #endif // EDEN_DEBUG
 #else  // HOT_RELOAD
@@ -876,6 +836,7 @@ WinMain(HINSTANCE instance,
     eden_profiler_reset(&eden->profiler);
 #endif  // EDEN_DEBUG
 #endif // HOT_RELOAD
+    eden_profile_frame();
 
     // Begin frame
     if (config.speaker_enabled) w32_speaker_begin_frame(&eden->speaker);
@@ -891,7 +852,20 @@ WinMain(HINSTANCE instance,
        
     //Process messages and input
     eden_profile_begin(input);
-    w32_update_input(&eden->input, window, target_secs_per_frame, rr);
+    if (play_filename) {
+      // @note: We still have to pump messages so that the window works
+      w32_update_input(&scratch_input, window, target_secs_per_frame, rr);
+      if (!eden_input_player_play(&player, &eden->input)) {
+        break;
+      }
+    }
+    else {
+      w32_update_input(&eden->input, window, target_secs_per_frame, rr);
+    }
+    if (record_filename && !recorder.is_full) {
+      if (!eden_input_recorder_record(&recorder, &eden->input)) 
+        w32_log("Input recording is full; recording stopped\n");
+    }
     eden_profile_end(input);
     
     eden_functions.update_and_render(eden);
@@ -907,6 +881,8 @@ WinMain(HINSTANCE instance,
 
     if (config.inspector_enabled) 
       eden_inspector_clear(&eden->inspector);
+
+    eden_debug_end_frame(&eden->debug);
 #endif // EDEN_DEBUG
 
 
@@ -929,7 +905,8 @@ WinMain(HINSTANCE instance,
                            w32_get_performance_counter(),
                            performance_frequency);
     
-    if(target_secs_per_frame > secs_elapsed_after_update) {
+    // @note: Playback runs as fast as it can
+    if(!play_filename && target_secs_per_frame > secs_elapsed_after_update) {
       if (is_sleep_granular) {
         DWORD ms_to_sleep 
           = (DWORD)(1000 * (target_secs_per_frame - secs_elapsed_after_update));
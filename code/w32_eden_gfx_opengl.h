@@ -208,6 +208,7 @@ if (!opengl->name) { return false; }
     wgl_set_opengl_function(glClear);
     wgl_set_opengl_function(glClearColor);
     wgl_set_opengl_function(glCreateBuffers);
+    wgl_set_opengl_function(glDeleteBuffers);
     wgl_set_opengl_function(glNamedBufferStorage);
     wgl_set_opengl_function(glCreateVertexArrays);
     wgl_set_opengl_function(glVertexArrayVertexBuffer);
@@ -247,6 +248,17 @@ if (!opengl->name) { return false; }
     wgl_set_opengl_function(glDrawElements);
     wgl_set_opengl_function(glBufferSubData);
     wgl_set_opengl_function(glClearDepth);
+    wgl_set_opengl_function(glNamedBufferData);
+
+    // @note: optional
+#define wgl_try_set_opengl_function(name) \
+opengl->name = (eden_opengl_##name*)_w32_try_get_wgl_function(#name, module);
+    wgl_try_set_opengl_function(glMapNamedBufferRange);
+    wgl_try_set_opengl_function(glUnmapNamedBuffer);
+    wgl_try_set_opengl_function(glFenceSync);
+    wgl_try_set_opengl_function(glClientWaitSync);
+    wgl_try_set_opengl_function(glDeleteSync);
+#undef wgl_try_set_opengl_function
   }
 #undef wgl_set_opengl_function
   
@@ -256,7 +268,8 @@ if (!opengl->name) { return false; }
         max_commands,
         max_textures,
         max_payloads,
-        max_elements)) 
+        max_elements,
+        frames_in_flight)) 
   {
     return false;
   }